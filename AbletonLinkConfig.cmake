@@ -31,6 +31,10 @@ elseif(WIN32)
     INTERFACE_COMPILE_DEFINITIONS
     LINK_PLATFORM_WINDOWS=1
   )
+  set_property(TARGET Ableton::Link APPEND PROPERTY
+    INTERFACE_LINK_LIBRARIES
+    avrt
+  )
 elseif(CMAKE_SYSTEM_NAME MATCHES "Linux|kFreeBSD|GNU")
   set_property(TARGET Ableton::Link APPEND PROPERTY
     INTERFACE_COMPILE_DEFINITIONS
@@ -53,3 +57,14 @@ set_property(TARGET Ableton::Link APPEND PROPERTY
   INTERFACE_SOURCES
   ${CMAKE_CURRENT_LIST_DIR}/include/ableton/Link.hpp
 )
+
+# Link and SharedLink compiled into a static library, for projects with many
+# translation units or binaries that use them. Linking Ableton::LinkCompiled instead
+# of Ableton::Link defines LINK_COMPILED, so that Link.hpp only declares their
+# instantiations, see Link.hpp. The library is only built for targets that link it.
+add_library(AbletonLinkCompiled STATIC EXCLUDE_FROM_ALL
+  ${CMAKE_CURRENT_LIST_DIR}/src/ableton/Link.cpp
+)
+target_link_libraries(AbletonLinkCompiled PUBLIC Ableton::Link)
+target_compile_definitions(AbletonLinkCompiled PUBLIC LINK_COMPILED=1)
+add_library(Ableton::LinkCompiled ALIAS AbletonLinkCompiled)
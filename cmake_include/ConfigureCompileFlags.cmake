@@ -19,6 +19,12 @@ if(UNIX)
   set(build_flags_RELEASE_LIST
     "-DNDEBUG=1"
   )
+  if(LINK_LINUX_TSC_CLOCK)
+    add_definitions("-DLINK_LINUX_TSC_CLOCK")
+  endif()
+  if(LINK_LINUX_PACKET_FILTER)
+    add_definitions("-DLINK_LINUX_PACKET_FILTER")
+  endif()
 
   # Clang-specific flags
   if(${CMAKE_CXX_COMPILER_ID} MATCHES Clang)
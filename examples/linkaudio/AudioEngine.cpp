@@ -23,6 +23,7 @@
 #ifdef LINK_PLATFORM_WINDOWS
 #define _USE_MATH_DEFINES
 #endif
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
@@ -35,10 +36,14 @@ AudioEngine::AudioEngine(Link& link)
   : mLink(link)
   , mSampleRate(44100.)
   , mOutputLatency(std::chrono::microseconds{0})
-  , mSharedEngineData({0., false, false, 4., false})
-  , mLockfreeEngineData(mSharedEngineData)
+  , mAudioQuantum(4.)
+  , mQuantum(4.)
   , mTimeAtLastClick{}
   , mIsPlaying(false)
+  , mNumCallbacks(0)
+  , mTotalCallbackNanos(0)
+  , mMaxCallbackNanos(0)
+  , mNumDroppedCommands(0)
 {
   if (!mOutputLatency.is_lock_free())
   {
@@ -48,14 +53,12 @@ AudioEngine::AudioEngine(Link& link)
 
 void AudioEngine::startPlaying()
 {
-  std::lock_guard<std::mutex> lock(mEngineDataGuard);
-  mSharedEngineData.requestStart = true;
+  pushCommand({Command::Type::StartPlaying, 0.});
 }
 
 void AudioEngine::stopPlaying()
 {
-  std::lock_guard<std::mutex> lock(mEngineDataGuard);
-  mSharedEngineData.requestStop = true;
+  pushCommand({Command::Type::StopPlaying, 0.});
 }
 
 bool AudioEngine::isPlaying() const
@@ -66,24 +69,23 @@ bool AudioEngine::isPlaying() const
 double AudioEngine::beatTime() const
 {
   const auto sessionState = mLink.captureAppSessionState();
-  return sessionState.beatAtTime(mLink.clock().micros(), mSharedEngineData.quantum);
+  return sessionState.beatAtTime(mLink.clock().micros(), mQuantum);
 }
 
 void AudioEngine::setTempo(double tempo)
 {
-  std::lock_guard<std::mutex> lock(mEngineDataGuard);
-  mSharedEngineData.requestedTempo = tempo;
+  pushCommand({Command::Type::SetTempo, tempo});
 }
 
 double AudioEngine::quantum() const
 {
-  return mSharedEngineData.quantum;
+  return mQuantum;
 }
 
 void AudioEngine::setQuantum(double quantum)
 {
-  std::lock_guard<std::mutex> lock(mEngineDataGuard);
-  mSharedEngineData.quantum = quantum;
+  mQuantum = quantum;
+  mAudioQuantum.write(quantum);
 }
 
 bool AudioEngine::isStartStopSyncEnabled() const
@@ -96,9 +98,34 @@ void AudioEngine::setStartStopSyncEnabled(const bool enabled)
   mLink.enableStartStopSync(enabled);
 }
 
+AudioEngine::CallbackStats AudioEngine::callbackStats() const
+{
+  return {mNumCallbacks.load(std::memory_order_relaxed),
+    std::chrono::nanoseconds{mTotalCallbackNanos.load(std::memory_order_relaxed)},
+    std::chrono::nanoseconds{mMaxCallbackNanos.load(std::memory_order_relaxed)}};
+}
+
+std::uint64_t AudioEngine::numDroppedCommands() const
+{
+  return mNumDroppedCommands.load(std::memory_order_relaxed);
+}
+
+void AudioEngine::pushCommand(const Command command)
+{
+  // The audio thread drains the queue with every buffer, so it only fills up if
+  // audio isn't running. Requests made meanwhile are dropped and counted.
+  if (!mCommands.write(command))
+  {
+    mNumDroppedCommands.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
 void AudioEngine::setBufferSize(std::size_t size)
 {
   mBuffer = std::vector<double>(size, 0.);
+  mBeats = std::vector<double>(size, 0.);
+  mPhases = std::vector<double>(size, 0.);
+  mClicks = std::vector<std::size_t>(size, 0);
 }
 
 void AudioEngine::setSampleRate(double sampleRate)
@@ -108,23 +135,24 @@ void AudioEngine::setSampleRate(double sampleRate)
 
 AudioEngine::EngineData AudioEngine::pullEngineData()
 {
-  auto engineData = EngineData{};
-  if (mEngineDataGuard.try_lock())
+  auto engineData = EngineData{0., false, false, mAudioQuantum.readInPlace()};
+  while (const auto command = mCommands.read())
   {
-    engineData.requestedTempo = mSharedEngineData.requestedTempo;
-    mSharedEngineData.requestedTempo = 0;
-    engineData.requestStart = mSharedEngineData.requestStart;
-    mSharedEngineData.requestStart = false;
-    engineData.requestStop = mSharedEngineData.requestStop;
-    mSharedEngineData.requestStop = false;
-
-    mLockfreeEngineData.quantum = mSharedEngineData.quantum;
-    mLockfreeEngineData.startStopSyncOn = mSharedEngineData.startStopSyncOn;
-
-    mEngineDataGuard.unlock();
+    switch (command->type)
+    {
+    case Command::Type::StartPlaying:
+      engineData.requestStart = true;
+      engineData.requestStop = false;
+      break;
+    case Command::Type::StopPlaying:
+      engineData.requestStop = true;
+      engineData.requestStart = false;
+      break;
+    case Command::Type::SetTempo:
+      engineData.requestedTempo = command->tempo;
+      break;
+    }
   }
-  engineData.quantum = mLockfreeEngineData.quantum;
-
   return engineData;
 }
 
@@ -144,23 +172,34 @@ void AudioEngine::renderMetronomeIntoBuffer(const Link::SessionState sessionStat
   // The number of microseconds that elapse between samples
   const auto microsPerSample = 1e6 / mSampleRate;
 
-  for (std::size_t i = 0; i < numSamples; ++i)
+  // Evaluate the timeline for the whole buffer at once. The clicks
+  // occur at the samples where the phase wraps around with respect to
+  // a 1 beat quantum.
+  sessionState.beatsAndPhasesAtTimes(beginHostTime, microsPerSample, numSamples,
+    quantum, mBeats.data(), mPhases.data(), nullptr);
+  const auto numClicks = sessionState.beatsAndPhasesAtTimes(
+    beginHostTime, microsPerSample, numSamples, 1., nullptr, nullptr, mClicks.data());
+
+  // Tracks the host time of the samples without per sample rounding
+  auto sampleClock =
+    util::SampleClock{beginHostTime, static_cast<std::uint32_t>(llround(mSampleRate))};
+
+  std::size_t nextClick = 0;
+  for (std::size_t i = 0; i < numSamples; ++i, sampleClock.advance())
   {
     double amplitude = 0.;
-    // Compute the host time for this sample and the last.
-    const auto hostTime =
-      beginHostTime + microseconds(llround(static_cast<double>(i) * microsPerSample));
-    const auto lastSampleHostTime = hostTime - microseconds(llround(microsPerSample));
+    const auto hostTime = sampleClock.time();
+    const auto isClick = nextClick < numClicks && mClicks[nextClick] == i;
+    if (isClick)
+    {
+      ++nextClick;
+    }
 
     // Only make sound for positive beat magnitudes. Negative beat
     // magnitudes are count-in beats.
-    if (sessionState.beatAtTime(hostTime, quantum) >= 0.)
+    if (mBeats[i] >= 0.)
     {
-      // If the phase wraps around between the last sample and the
-      // current one with respect to a 1 beat quantum, then a click
-      // should occur.
-      if (sessionState.phaseAtTime(hostTime, 1)
-          < sessionState.phaseAtTime(lastSampleHostTime, 1))
+      if (isClick)
       {
         mTimeAtLastClick = hostTime;
       }
@@ -176,8 +215,7 @@ void AudioEngine::renderMetronomeIntoBuffer(const Link::SessionState sessionStat
         // quantum was zero, then it was at a quantum boundary and we
         // want to use the high tone. For other beats within the
         // quantum, use the low tone.
-        const auto freq =
-          floor(sessionState.phaseAtTime(hostTime, quantum)) == 0 ? highTone : lowTone;
+        const auto freq = floor(mPhases[i]) == 0 ? highTone : lowTone;
 
         // Simple cosine synth
         amplitude = cos(2 * M_PI * secondsAfterClick.count() * freq)
@@ -190,6 +228,28 @@ void AudioEngine::renderMetronomeIntoBuffer(const Link::SessionState sessionStat
 
 void AudioEngine::audioCallback(
   const std::chrono::microseconds hostTime, const std::size_t numSamples)
+{
+  using namespace std::chrono;
+
+  const auto begin = steady_clock::now();
+  renderAudio(hostTime, numSamples);
+  const auto nanos =
+    static_cast<std::uint64_t>(duration_cast<nanoseconds>(steady_clock::now() - begin)
+                                 .count());
+
+  // Only the audio thread writes the stats
+  mNumCallbacks.store(
+    mNumCallbacks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  mTotalCallbackNanos.store(
+    mTotalCallbackNanos.load(std::memory_order_relaxed) + nanos,
+    std::memory_order_relaxed);
+  mMaxCallbackNanos.store(
+    (std::max)(mMaxCallbackNanos.load(std::memory_order_relaxed), nanos),
+    std::memory_order_relaxed);
+}
+
+void AudioEngine::renderAudio(
+  const std::chrono::microseconds hostTime, const std::size_t numSamples)
 {
   const auto engineData = pullEngineData();
 
@@ -22,8 +22,12 @@
 // Make sure to define this before <cmath> is included for Windows
 #define _USE_MATH_DEFINES
 #include <ableton/Link.hpp>
+#include <ableton/link/SpscRingBuffer.hpp>
+#include <ableton/link/TripleBuffer.hpp>
+#include <ableton/util/SampleClock.hpp>
 #include <atomic>
-#include <mutex>
+#include <chrono>
+#include <cstdint>
 
 namespace ableton
 {
@@ -33,6 +37,14 @@ namespace linkaudio
 class AudioEngine
 {
 public:
+  // The time spent in the audio callback since the engine was created
+  struct CallbackStats
+  {
+    std::uint64_t numCallbacks;
+    std::chrono::nanoseconds totalTime;
+    std::chrono::nanoseconds maxTime;
+  };
+
   AudioEngine(Link& link);
   void startPlaying();
   void stopPlaying();
@@ -43,15 +55,32 @@ public:
   void setQuantum(double quantum);
   bool isStartStopSyncEnabled() const;
   void setStartStopSyncEnabled(bool enabled);
+  CallbackStats callbackStats() const;
+  // The number of requests that were dropped because the audio thread wasn't
+  // running to apply them
+  std::uint64_t numDroppedCommands() const;
 
 private:
+  // Requests of the application thread, which the audio thread applies in order
+  struct Command
+  {
+    enum class Type
+    {
+      StartPlaying,
+      StopPlaying,
+      SetTempo
+    };
+
+    Type type;
+    double tempo;
+  };
+
   struct EngineData
   {
     double requestedTempo;
     bool requestStart;
     bool requestStop;
     double quantum;
-    bool startStopSyncOn;
   };
 
   void setBufferSize(std::size_t size);
@@ -62,16 +91,25 @@ private:
     std::chrono::microseconds beginHostTime,
     std::size_t numSamples);
   void audioCallback(const std::chrono::microseconds hostTime, std::size_t numSamples);
+  void renderAudio(const std::chrono::microseconds hostTime, std::size_t numSamples);
+  void pushCommand(Command command);
 
   Link& mLink;
   double mSampleRate;
   std::atomic<std::chrono::microseconds> mOutputLatency;
   std::vector<double> mBuffer;
-  EngineData mSharedEngineData;
-  EngineData mLockfreeEngineData;
+  std::vector<double> mBeats;
+  std::vector<double> mPhases;
+  std::vector<std::size_t> mClicks;
+  link::SpscRingBuffer<Command, 64> mCommands;
+  link::TripleBuffer<double> mAudioQuantum;
+  std::atomic<double> mQuantum;
   std::chrono::microseconds mTimeAtLastClick;
   bool mIsPlaying;
-  std::mutex mEngineDataGuard;
+  std::atomic<std::uint64_t> mNumCallbacks;
+  std::atomic<std::uint64_t> mTotalCallbackNanos;
+  std::atomic<std::uint64_t> mMaxCallbackNanos;
+  std::atomic<std::uint64_t> mNumDroppedCommands;
 
   friend class AudioPlatform;
 };
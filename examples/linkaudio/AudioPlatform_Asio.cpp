@@ -108,7 +108,7 @@ void AudioPlatform::audioCallback(ASIOTime* timeInfo, long index)
   auto hostTime = std::chrono::microseconds(0);
   if (timeInfo->timeInfo.flags & kSystemTimeValid)
   {
-    hostTime = mHostTimeFilter.sampleTimeToHostTime(
+    hostTime = mHostTimeSource.fromSampleTime(
       asioSamplesToDouble(timeInfo->timeInfo.samplePosition));
   }
 
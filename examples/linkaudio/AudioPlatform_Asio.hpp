@@ -23,6 +23,7 @@
 
 #include <ableton/Link.hpp>
 #include <ableton/link/HostTimeFilter.hpp>
+#include <ableton/util/HostTimeSource.hpp>
 
 #include "asiosys.h" // Should be included before asio.h
 
@@ -94,7 +95,9 @@ private:
 
   DriverInfo mDriverInfo;
   ASIOCallbacks mAsioCallbacks;
-  link::HostTimeFilter<platforms::windows::Clock> mHostTimeFilter;
+  util::HostTimeSource<platforms::windows::Clock,
+    link::IncrementalHostTimeFilter<platforms::windows::Clock>>
+    mHostTimeSource;
 
   static AudioPlatform* _singleton;
 };
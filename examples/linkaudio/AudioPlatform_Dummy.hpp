@@ -19,93 +19,62 @@
 
 #pragma once
 
+#include "AudioEngine.hpp"
 #include <ableton/Link.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 namespace ableton
 {
 namespace linkaudio
 {
 
+// Runs the engine on a thread that calls it at the rate of a sound card without
+// producing any output
 class AudioPlatform
 {
-  class AudioEngine
+public:
+  AudioPlatform(Link& link)
+    : mEngine(link)
+    , mLink(link)
+    , mIsRunning(true)
   {
-  public:
-    AudioEngine(Link& link)
-      : mLink(link)
-      , mQuantum(4.)
-    {
-    }
-
-    void startPlaying()
-    {
-      auto sessionState = mLink.captureAppSessionState();
-      sessionState.setIsPlayingAndRequestBeatAtTime(true, now(), 0., mQuantum);
-      mLink.commitAppSessionState(sessionState);
-    }
-
-    void stopPlaying()
-    {
-      auto sessionState = mLink.captureAppSessionState();
-      sessionState.setIsPlaying(false, now());
-      mLink.commitAppSessionState(sessionState);
-    }
-
-    bool isPlaying() const
-    {
-      return mLink.captureAppSessionState().isPlaying();
-    }
-
-    double beatTime() const
-    {
-      auto sessionState = mLink.captureAppSessionState();
-      return sessionState.beatAtTime(now(), mQuantum);
-    }
-
-    void setTempo(double tempo)
-    {
-      auto sessionState = mLink.captureAppSessionState();
-      sessionState.setTempo(tempo, now());
-      mLink.commitAppSessionState(sessionState);
-    }
+    mEngine.setSampleRate(kSampleRate);
+    mEngine.setBufferSize(kBufferSize);
+    mThread = std::thread([this] { run(); });
+  }
 
-    double quantum() const
-    {
-      return mQuantum;
-    }
+  ~AudioPlatform()
+  {
+    mIsRunning = false;
+    mThread.join();
+  }
 
-    void setQuantum(double quantum)
-    {
-      mQuantum = quantum;
-    }
+  AudioEngine mEngine;
 
-    bool isStartStopSyncEnabled() const
-    {
-      return mLink.isStartStopSyncEnabled();
-    }
+private:
+  static constexpr double kSampleRate = 44100.;
+  static constexpr std::size_t kBufferSize = 512;
 
-    void setStartStopSyncEnabled(bool enabled)
-    {
-      mLink.enableStartStopSync(enabled);
-    }
+  void run()
+  {
+    using namespace std::chrono;
 
-  private:
-    std::chrono::microseconds now() const
+    const auto bufferDuration = duration_cast<steady_clock::duration>(
+      duration<double>{static_cast<double>(kBufferSize) / kSampleRate});
+    auto nextCallback = steady_clock::now();
+    while (mIsRunning)
     {
-      return mLink.clock().micros();
+      mEngine.audioCallback(mLink.clock().micros(), kBufferSize);
+      nextCallback += bufferDuration;
+      std::this_thread::sleep_until(nextCallback);
     }
-
-    Link& mLink;
-    double mQuantum;
-  };
-
-public:
-  AudioPlatform(Link& link)
-    : mEngine(link)
-  {
   }
 
-  AudioEngine mEngine;
+  Link& mLink;
+  std::atomic<bool> mIsRunning;
+  std::thread mThread;
 };
 
 } // namespace linkaudio
@@ -68,7 +68,19 @@ int AudioPlatform::audioCallback(jack_nframes_t nframes)
   using namespace std::chrono;
   AudioEngine& engine = mEngine;
 
-  const auto hostTime = mHostTimeFilter.sampleTimeToHostTime(mSampleTime);
+  // JACK stamps the beginning of each cycle on its own clock
+  jack_nframes_t cycleFrames;
+  jack_time_t cycleMicros;
+  jack_time_t nextCycleMicros;
+  float periodMicros;
+  const auto hostTime =
+    jack_get_cycle_times(
+      mpJackClient, &cycleFrames, &cycleMicros, &nextCycleMicros, &periodMicros)
+        == 0
+      ? mHostTimeSource.fromDriverTime(
+          microseconds{static_cast<microseconds::rep>(cycleMicros)},
+          microseconds{static_cast<microseconds::rep>(jack_get_time())})
+      : mHostTimeSource.fromSampleTime(mSampleTime);
 
   mSampleTime += nframes;
 
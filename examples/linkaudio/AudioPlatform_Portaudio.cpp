@@ -45,7 +45,7 @@ AudioPlatform::~AudioPlatform()
 int AudioPlatform::audioCallback(const void* /*inputBuffer*/,
   void* outputBuffer,
   unsigned long inNumFrames,
-  const PaStreamCallbackTimeInfo* /*timeInfo*/,
+  const PaStreamCallbackTimeInfo* timeInfo,
   PaStreamCallbackFlags /*statusFlags*/,
   void* userData)
 {
@@ -54,13 +54,20 @@ int AudioPlatform::audioCallback(const void* /*inputBuffer*/,
   AudioPlatform& platform = *static_cast<AudioPlatform*>(userData);
   AudioEngine& engine = platform.mEngine;
 
-  const auto hostTime =
-    platform.mHostTimeFilter.sampleTimeToHostTime(platform.mSampleTime);
+  // The time at which the buffer reaches the DAC includes the output latency. Not
+  // all host APIs provide it.
+  const auto toMicros = [](const PaTime time) {
+    return duration_cast<microseconds>(duration<double>{time});
+  };
+  const auto bufferBeginAtOutput =
+    timeInfo->outputBufferDacTime > 0.
+      ? platform.mHostTimeSource.fromDriverTime(
+          toMicros(timeInfo->outputBufferDacTime), toMicros(timeInfo->currentTime))
+      : platform.mHostTimeSource.fromSampleTime(platform.mSampleTime)
+          + engine.mOutputLatency.load();
 
   platform.mSampleTime += static_cast<double>(inNumFrames);
 
-  const auto bufferBeginAtOutput = hostTime + engine.mOutputLatency.load();
-
   engine.audioCallback(bufferBeginAtOutput, inNumFrames);
 
   for (unsigned long i = 0; i < inNumFrames; ++i)
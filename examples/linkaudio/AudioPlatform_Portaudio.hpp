@@ -22,6 +22,7 @@
 #include "AudioEngine.hpp"
 #include <ableton/link/HostTimeFilter.hpp>
 #include <ableton/platforms/Config.hpp>
+#include <ableton/util/HostTimeSource.hpp>
 #include <portaudio.h>
 
 namespace ableton
@@ -50,7 +51,9 @@ private:
   void start();
   void stop();
 
-  link::HostTimeFilter<link::platform::Clock> mHostTimeFilter;
+  util::HostTimeSource<link::platform::Clock,
+    link::IncrementalHostTimeFilter<link::platform::Clock>>
+    mHostTimeSource;
   double mSampleTime;
   PaStream* pStream;
 };
@@ -35,6 +35,7 @@ static const IID kMMDeviceEnumeratorId = __uuidof(MMDeviceEnumerator);
 static const IID kIMMDeviceEnumeratorId = __uuidof(IMMDeviceEnumerator);
 static const IID kAudioClientId = __uuidof(IAudioClient);
 static const IID kAudioRenderClientId = __uuidof(IAudioRenderClient);
+static const IID kAudioClockId = __uuidof(IAudioClock);
 
 // Controls how large the driver's ring buffer will be, expressed in terms of
 // 100-nanosecond units. This value also influences the overall driver latency.
@@ -71,6 +72,8 @@ AudioPlatform::AudioPlatform(Link& link)
   , mDevice(nullptr)
   , mAudioClient(nullptr)
   , mRenderClient(nullptr)
+  , mAudioClock(nullptr)
+  , mClockFrequency(0)
   , mStreamFormat(nullptr)
   , mEventHandle(nullptr)
   , mAudioThreadHandle(nullptr)
@@ -102,6 +105,10 @@ AudioPlatform::~AudioPlatform()
   {
     mRenderClient->Release();
   }
+  if (mAudioClock != nullptr)
+  {
+    mAudioClock->Release();
+  }
   CoTaskMemFree(mStreamFormat);
 }
 
@@ -191,6 +198,18 @@ void AudioPlatform::initialize()
     fatalError(result, "Could not get audio render service");
   }
 
+  result = mAudioClient->GetService(kAudioClockId, (void**)&(mAudioClock));
+  if (FAILED(result))
+  {
+    fatalError(result, "Could not get audio clock service");
+  }
+
+  result = mAudioClock->GetFrequency(&mClockFrequency);
+  if (FAILED(result))
+  {
+    fatalError(result, "Could not get audio clock frequency");
+  }
+
   mIsRunning = true;
   LPTHREAD_START_ROUTINE threadEntryPoint =
     reinterpret_cast<LPTHREAD_START_ROUTINE>(renderAudioRunloop);
@@ -216,6 +235,8 @@ void AudioPlatform::start()
   {
     fatalError(result, "Could not release buffer");
   }
+  // The silence is played before the first buffer of the engine
+  mSampleTime = bufSize;
 
   result = mAudioClient->SetEventHandle(mEventHandle);
   if (FAILED(result))
@@ -274,12 +295,23 @@ DWORD AudioPlatform::audioRunloop()
     const auto bufferDuration =
       duration_cast<microseconds>(duration<double>{numSamples / sampleRate});
 
-    const auto hostTime = mHostTimeFilter.sampleTimeToHostTime(mSampleTime);
+    // The audio clock reports which frame is currently playing and when, in units
+    // of 100ns of the performance counter that the clock of Link reads
+    UINT64 position;
+    UINT64 qpcPosition;
+    const auto bufferBeginAtOutput =
+      SUCCEEDED(mAudioClock->GetPosition(&position, &qpcPosition))
+        ? mHostTimeSource.fromHostTime(
+          microseconds{static_cast<microseconds::rep>(qpcPosition / 10)}
+          + duration_cast<microseconds>(duration<double>{
+            (mSampleTime
+              - static_cast<double>(position) / static_cast<double>(mClockFrequency)
+                  * sampleRate)
+            / sampleRate}))
+        : mHostTimeSource.fromSampleTime(mSampleTime) + mEngine.mOutputLatency.load();
 
     mSampleTime += numSamples;
 
-    const auto bufferBeginAtOutput = hostTime + mEngine.mOutputLatency.load();
-
     mEngine.audioCallback(bufferBeginAtOutput, numSamples);
 
     float* floatBuffer = reinterpret_cast<float*>(buffer);
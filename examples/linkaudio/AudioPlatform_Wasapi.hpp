@@ -23,6 +23,7 @@
 #include <Audioclient.h>
 #include <Mmdeviceapi.h>
 #include <ableton/link/HostTimeFilter.hpp>
+#include <ableton/util/HostTimeSource.hpp>
 #include <atomic>
 
 // WARNING: This file provides an audio driver for Windows using WASAPI. This driver is
@@ -56,12 +57,16 @@ private:
   void initialize();
   void start();
 
-  link::HostTimeFilter<platforms::windows::Clock> mHostTimeFilter;
+  util::HostTimeSource<platforms::windows::Clock,
+    link::IncrementalHostTimeFilter<platforms::windows::Clock>>
+    mHostTimeSource;
   double mSampleTime;
 
   IMMDevice* mDevice;
   IAudioClient* mAudioClient;
   IAudioRenderClient* mRenderClient;
+  IAudioClock* mAudioClock;
+  UINT64 mClockFrequency;
   WAVEFORMATEX* mStreamFormat;
   HANDLE mEventHandle;
   HANDLE mAudioThreadHandle;
@@ -24,6 +24,7 @@
 #include <chrono>
 #include <iomanip>
 #include <iostream>
+#include <string>
 #include <thread>
 #if defined(LINK_PLATFORM_UNIX)
 #include <termios.h>
@@ -82,6 +83,9 @@ void printHelp()
   std::cout << "  decrease / increase quantum: r / t" << std::endl;
   std::cout << "  enable / disable start stop sync: s" << std::endl;
   std::cout << "  quit: q" << std::endl << std::endl;
+  std::cout << "options:" << std::endl;
+  std::cout << "  --benchmark: report the time spent in the audio callback" << std::endl
+            << std::endl;
 }
 
 void printStateHeader()
@@ -122,6 +126,30 @@ void printState(const std::chrono::microseconds time,
   clearLine();
 }
 
+void printBenchmarkHeader()
+{
+  std::cout << "callbacks/s | mean [us] | max [us] | load [%]" << std::endl;
+}
+
+// Prints the callbacks since the previous stats, and the longest callback so far
+void printBenchmark(const ableton::linkaudio::AudioEngine::CallbackStats& previous,
+  const ableton::linkaudio::AudioEngine::CallbackStats& current,
+  const std::chrono::nanoseconds elapsed)
+{
+  using namespace std;
+  const auto numCallbacks = current.numCallbacks - previous.numCallbacks;
+  const auto totalTime =
+    static_cast<double>((current.totalTime - previous.totalTime).count());
+  const auto perSecond = static_cast<double>(numCallbacks) * 1e9
+                         / static_cast<double>(elapsed.count());
+  const auto mean = numCallbacks > 0 ? totalTime / static_cast<double>(numCallbacks) : 0.;
+  const auto load = 100. * totalTime / static_cast<double>(elapsed.count());
+  cout << fixed << setprecision(1) << left << setw(11) << perSecond << " | " << setw(9)
+       << mean / 1e3 << " | " << setw(8)
+       << static_cast<double>(current.maxTime.count()) / 1e3 << " | " << setprecision(3)
+       << load << endl;
+}
+
 void input(State& state)
 {
   char in;
@@ -184,16 +212,40 @@ void input(State& state)
 
 } // namespace
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
+  const auto isBenchmark = argc > 1 && std::string{argv[1]} == "--benchmark";
+
   State state;
   printHelp();
-  printStateHeader();
+  if (isBenchmark)
+  {
+    printBenchmarkHeader();
+  }
+  else
+  {
+    printStateHeader();
+  }
   std::thread thread(input, std::ref(state));
   disableBufferedInput();
 
+  auto previousStats = state.audioPlatform.mEngine.callbackStats();
+  auto previousTime = std::chrono::steady_clock::now();
   while (state.running)
   {
+    if (isBenchmark)
+    {
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+      const auto stats = state.audioPlatform.mEngine.callbackStats();
+      const auto now = std::chrono::steady_clock::now();
+      printBenchmark(previousStats, stats,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - previousTime));
+      previousStats = stats;
+      previousTime = now;
+      continue;
+    }
+
+
     const auto time = state.link.clock().micros();
     auto sessionState = state.link.captureAppSessionState();
     printState(time, sessionState, state.link.isEnabled(), state.link.numPeers(),
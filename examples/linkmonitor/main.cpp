@@ -0,0 +1,232 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/Link.hpp>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Follows the Link session on the network without taking part in it and prints its
+// metrics as a JSON object per line, e.g.
+//
+//   LinkMonitor --interval 1000 --duration 3600 > show.ndjson
+//
+// Each line has the host time in microseconds, the number of peers, the tempo, beat
+// and play state of the session, the sessions seen with their peers and whether
+// they've been measured, the packet rates and failures over the interval, the sync
+// quality of the last measurement and the io load, the share of the interval that
+// the io threads spent handling received packets. The monitor runs in observer mode,
+// so it doesn't add to the traffic or the peer count of the session, unless --peer
+// is given. It stops after the duration, given in seconds, or when interrupted.
+
+namespace
+{
+
+std::atomic<bool> running{true};
+
+void stop(int)
+{
+  running = false;
+}
+
+void printUsage()
+{
+  std::cout
+    << "usage: LinkMonitor [--interval ms] [--duration s] [--quantum q] [--peer]\n";
+}
+
+std::string jsonString(const std::string& value)
+{
+  std::string result = "\"";
+  for (const auto c : value)
+  {
+    if (c == '"' || c == '\\')
+    {
+      result += '\\';
+      result += c;
+    }
+    else if (static_cast<unsigned char>(c) < 0x20)
+    {
+      char escaped[7];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      result += escaped;
+    }
+    else
+    {
+      result += c;
+    }
+  }
+  return result + "\"";
+}
+
+template <typename T>
+std::string jsonString(const T& value)
+{
+  std::ostringstream stream;
+  stream << value;
+  return jsonString(stream.str());
+}
+
+const char* jsonBool(const bool value)
+{
+  return value ? "true" : "false";
+}
+
+template <typename Count>
+double perSecond(const Count count, const std::chrono::microseconds elapsed)
+{
+  return static_cast<double>(count) * 1e6 / static_cast<double>(elapsed.count());
+}
+
+void printMetrics(ableton::Link& link,
+  const double quantum,
+  const ableton::Link::Stats& previous,
+  const ableton::Link::Stats& current,
+  const std::chrono::microseconds elapsed)
+{
+  using namespace std::chrono;
+
+  const auto time = link.clock().micros();
+  const auto sessionState = link.captureAppSessionState();
+  const auto pSessions = link.sessionList();
+  const auto quality = link.syncQuality();
+  const auto& traffic = current.traffic;
+  const auto& previousTraffic = previous.traffic;
+
+  std::ostringstream line;
+  line.precision(10);
+  line << "{\"time\":" << time.count() << ",\"peers\":" << link.numPeers()
+       << ",\"tempo\":" << sessionState.tempo()
+       << ",\"beat\":" << sessionState.beatAtTime(time, quantum)
+       << ",\"playing\":" << jsonBool(sessionState.isPlaying()) << ",\"sessions\":[";
+  for (auto it = pSessions->begin(); it != pSessions->end(); ++it)
+  {
+    line << (it == pSessions->begin() ? "" : ",")
+         << "{\"id\":" << jsonString(it->sessionId) << ",\"peers\":" << it->numPeers
+         << ",\"tempo\":" << it->timeline.tempo.bpm()
+         << ",\"current\":" << jsonBool(it->isCurrent)
+         << ",\"measured\":" << jsonBool(it->measurement.timestamp != microseconds{0})
+         << "}";
+  }
+  line << "],\"packets\":{\"sentPerSecond\":"
+       << perSecond(traffic.packetsSent - previousTraffic.packetsSent, elapsed)
+       << ",\"receivedPerSecond\":"
+       << perSecond(traffic.packetsReceived - previousTraffic.packetsReceived, elapsed)
+       << ",\"parseFailures\":" << traffic.parseFailures - previousTraffic.parseFailures
+       << ",\"sendFailures\":" << traffic.sendFailures - previousTraffic.sendFailures
+       << "},\"measurements\":{\"succeeded\":"
+       << current.measurementsSucceeded - previous.measurementsSucceeded
+       << ",\"failed\":" << current.measurementsFailed - previous.measurementsFailed
+       << "},\"sync\":{\"measured\":" << jsonBool(quality.isMeasured());
+  if (quality.isMeasured())
+  {
+    line << ",\"roundTripTime\":" << quality.roundTripTime.count()
+         << ",\"jitter\":" << quality.jitter.count()
+         << ",\"offsetVariance\":" << quality.offsetVariance
+         << ",\"age\":" << (time - quality.measurementTime).count();
+  }
+  const auto handlerTime =
+    duration_cast<microseconds>(traffic.handlerTime - previousTraffic.handlerTime);
+  line << "},\"ioLoad\":"
+       << static_cast<double>(handlerTime.count()) / static_cast<double>(elapsed.count())
+       << ",\"stateResets\":" << current.stateResets - previous.stateResets << "}\n";
+  std::cout << line.str() << std::flush;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  using namespace std::chrono;
+
+  auto interval = milliseconds{1000};
+  auto duration = seconds{0};
+  auto quantum = 4.;
+  auto isPeer = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    const auto hasValue = i + 1 < argc;
+    if (std::strcmp(argv[i], "--interval") == 0 && hasValue)
+    {
+      interval = milliseconds{std::strtoll(argv[++i], nullptr, 10)};
+    }
+    else if (std::strcmp(argv[i], "--duration") == 0 && hasValue)
+    {
+      duration = seconds{std::strtoll(argv[++i], nullptr, 10)};
+    }
+    else if (std::strcmp(argv[i], "--quantum") == 0 && hasValue)
+    {
+      quantum = std::strtod(argv[++i], nullptr);
+    }
+    else if (std::strcmp(argv[i], "--peer") == 0)
+    {
+      isPeer = true;
+    }
+    else
+    {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (interval <= milliseconds{0} || duration < seconds{0} || !(quantum > 0.))
+  {
+    printUsage();
+    return 1;
+  }
+
+  std::signal(SIGINT, stop);
+  std::signal(SIGTERM, stop);
+
+  ableton::Link link(120.);
+  link.enableObserverMode(!isPeer);
+  link.enableStartStopSync(true);
+  link.enable(true);
+
+  const auto start = steady_clock::now();
+  auto previousStats = link.stats();
+  auto previousTime = start;
+  // Wake up often enough to stop soon after an interrupt
+  const auto sleepPeriod = (std::min)(interval, milliseconds{100});
+  while (running)
+  {
+    std::this_thread::sleep_for(sleepPeriod);
+    const auto now = steady_clock::now();
+    if (now - previousTime >= interval)
+    {
+      const auto stats = link.stats();
+      printMetrics(link, quantum, previousStats, stats,
+        duration_cast<microseconds>(now - previousTime));
+      previousStats = stats;
+      previousTime = now;
+    }
+    if (duration > seconds{0} && now - start >= duration)
+    {
+      break;
+    }
+  }
+  return 0;
+}
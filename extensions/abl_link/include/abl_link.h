@@ -18,6 +18,7 @@
  */
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -72,6 +73,16 @@ extern "C"
    */
   abl_link abl_link_create(double bpm);
 
+  /*! @brief Construct a new abl_link instance with an initial tempo and a queue of
+   *  up to event_queue_size events for abl_link_poll_events.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion The queue is allocated here and never grows. The events are queued
+   *  in addition to the invocations of the registered callbacks.
+   */
+  abl_link abl_link_create_with_event_queue(double bpm, size_t event_queue_size);
+
   /*! @brief Delete an abl_link instance.
    *  Thread-safe: yes
    *  Realtime-safe: no
@@ -90,6 +101,15 @@ extern "C"
    */
   void abl_link_enable(abl_link link, bool enable);
 
+  /*! @brief Disable Link, but keep its sockets open for enabling it again.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Enabling a suspended Link is fast and announces it to the
+   *  peers right away. Disabling it releases the sockets.
+   */
+  void abl_link_suspend(abl_link link);
+
   /*! @brief: Is start/stop synchronization enabled?
    *  Thread-safe: yes
    *  Realtime-safe: no
@@ -102,12 +122,47 @@ extern "C"
    */
   void abl_link_enable_start_stop_sync(abl_link link, bool enabled);
 
+  /*! @brief: Only join sessions with the peers of the given group.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Peers of different groups ignore each other. The default group is 0,
+   *  which is the group of all peers that don't support groups.
+   */
+  void abl_link_set_session_group(abl_link link, uint16_t group_id);
+
+  /*! @brief: The group set with abl_link_set_session_group.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   */
+  uint16_t abl_link_session_group(abl_link link);
+
   /*! @brief How many peers are currently connected in a Link session?
    *  Thread-safe: yes
    *  Realtime-safe: yes
    */
   uint64_t abl_link_num_peers(abl_link link);
 
+  /*! @brief The quality of the clock synchronization with the current session.
+   *
+   *  @discussion The times are in microseconds and the offset variance is in square
+   *  microseconds. time_since_measurement is negative if the session hasn't been
+   *  measured because this instance founded it, e.g. when there are no other peers.
+   */
+  typedef struct abl_link_sync_quality
+  {
+    int64_t round_trip_time;
+    int64_t jitter;
+    double offset_variance;
+    int64_t time_since_measurement;
+  } abl_link_sync_quality;
+
+  /*! @brief Get the quality of the clock synchronization with the current session.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   */
+  abl_link_sync_quality abl_link_session_sync_quality(abl_link link);
+
   /*! @brief Register a callback to be notified when the number of
    *  peers in the Link session changes.
    *  Thread-safe: yes
@@ -141,6 +196,45 @@ extern "C"
   void abl_link_set_start_stop_callback(
     abl_link link, abl_link_start_stop_callback callback, void *context);
 
+  /*! @brief The kinds of abl_link_event. */
+  typedef enum abl_link_event_type
+  {
+    abl_link_event_num_peers,
+    abl_link_event_tempo,
+    abl_link_event_start_stop
+  } abl_link_event_type;
+
+  /*! @brief A change of the number of peers, the session tempo or the start/stop
+   *  state, as it is passed to the corresponding callback.
+   *
+   *  @discussion time is the Link clock time in microseconds at which the event was
+   *  queued. Only the field of the type of the event is meaningful.
+   */
+  typedef struct abl_link_event
+  {
+    abl_link_event_type type;
+    int64_t time;
+    uint64_t num_peers;
+    double tempo;
+    bool is_playing;
+  } abl_link_event;
+
+  /*! @brief Take up to max_events of the queued events, oldest first.
+   *  Thread-safe: no
+   *  Realtime-safe: yes
+   *
+   *  @discussion An alternative to the callbacks for bindings of runtimes that can't
+   *  be called on a Link-managed thread without attaching it or taking a lock, which
+   *  would delay the network handling of Link. Link queues the events without
+   *  waiting and they are taken on the thread of the caller. Returns the number of
+   *  events stored in events, which must hold at least max_events. Events are dropped
+   *  while the queue is full, so it must be polled often enough. The current values
+   *  are always available from abl_link_num_peers and the session state. Always
+   *  returns 0 for instances created without an event queue. Must not be called
+   *  concurrently for the same instance.
+   */
+  size_t abl_link_poll_events(abl_link link, abl_link_event *events, size_t max_events);
+
   /*! brief: Get the current link clock time in microseconds.
    *  Thread-safe: yes
    *  Realtime-safe: yes
@@ -184,6 +278,44 @@ extern "C"
    */
   void abl_link_destroy_session_state(abl_link_session_state abl_link_session_state);
 
+  /*! @brief Caller-allocated storage for a session_state.
+   *
+   *  @discussion Large and aligned enough to hold a session_state, so that one can be
+   *  created without allocating memory, see abl_link_init_session_state. The contents
+   *  are private to abl_link.
+   */
+  typedef struct abl_link_session_state_storage
+  {
+    union
+    {
+      unsigned char bytes[256];
+      int64_t align_int64;
+      double align_double;
+      void *align_pointer;
+    } impl;
+  } abl_link_session_state_storage;
+
+  /*! @brief Create a session_state instance in the given storage.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   *
+   *  @discussion Like abl_link_create_session_state, but doesn't allocate, so the
+   *  session_state can also be created on the audio thread, e.g. on the stack of the
+   *  audio callback. The session_state is valid as long as the storage is and must be
+   *  released with abl_link_deinit_session_state instead of
+   *  abl_link_destroy_session_state.
+   */
+  abl_link_session_state abl_link_init_session_state(
+    abl_link_session_state_storage *storage);
+
+  /*! @brief Release a session_state created by abl_link_init_session_state.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   *
+   *  @discussion The storage may be reused for another session_state afterwards.
+   */
+  void abl_link_deinit_session_state(abl_link_session_state session_state);
+
   /*! @brief Capture the current Link Session State from the audio thread.
    *  Thread-safe: no
    *  Realtime-safe: yes
@@ -196,6 +328,31 @@ extern "C"
   void abl_link_capture_audio_session_state(
     abl_link link, abl_link_session_state session_state);
 
+  /*! @brief Capture the Link Session State for rendering the given time from the audio
+   *  thread.
+   *  Thread-safe: no
+   *  Realtime-safe: yes
+   *
+   *  @discussion Like abl_link_capture_audio_session_state, but if the timeline has
+   *  changed since time_micros, the session_state holds the timeline that was valid
+   *  then. This suits engines that render audio for times in the past, e.g. delayed
+   *  for lookahead.
+   */
+  void abl_link_capture_audio_session_state_at(
+    abl_link link, abl_link_session_state session_state, int64_t time_micros);
+
+  /*! @brief Capture the current Link Session State from any of several audio threads.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   *
+   *  @discussion Like abl_link_capture_audio_session_state, but may be called from any
+   *  number of realtime threads concurrently. Session States committed with
+   *  abl_link_commit_audio_session_state are only reflected once Link has processed
+   *  them.
+   */
+  void abl_link_capture_shared_audio_session_state(
+    abl_link link, abl_link_session_state session_state);
+
   /*! @brief Commit the given Session State to the Link session from the
    *  audio thread.
    *  Thread-safe: no
@@ -208,6 +365,60 @@ extern "C"
   void abl_link_commit_audio_session_state(
     abl_link link, abl_link_session_state session_state);
 
+  /*! @brief Commit the given Session State to the Link session from any of several
+   *  audio threads.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   *
+   *  @discussion Like abl_link_commit_audio_session_state, but may be called from any
+   *  number of realtime threads concurrently. The timeline and the start/stop state
+   *  committed last win. The committed session_state is only reflected once Link has
+   *  processed it. Returns false if it was dropped because eight other threads are
+   *  committing at the same time.
+   */
+  bool abl_link_commit_shared_audio_session_state(
+    abl_link link, abl_link_session_state session_state);
+
+  /*! @brief Begin processing an audio block.
+   *  Thread-safe: no
+   *  Realtime-safe: yes
+   *
+   *  @discussion This function should ONLY be called in the audio thread, typically at
+   *  the start of the audio callback. Until abl_link_end_audio_block is called,
+   *  abl_link_capture_audio_session_state captures the Session State resolved here
+   *  without reading the clock again. Session States committed with
+   *  abl_link_commit_audio_session_state during the block are reflected by subsequent
+   *  captures.
+   */
+  void abl_link_begin_audio_block(abl_link link);
+
+  /*! @brief End processing an audio block.
+   *  Thread-safe: no
+   *  Realtime-safe: yes
+   *
+   *  @discussion Counterpart of abl_link_begin_audio_block.
+   */
+  void abl_link_end_audio_block(abl_link link);
+
+  /*! @brief Is freewheeling enabled?
+   *  Thread-safe: no
+   *  Realtime-safe: yes
+   *
+   *  @discussion This function should ONLY be called in the audio thread.
+   */
+  bool abl_link_is_freewheel_enabled(abl_link link);
+
+  /*! @brief Enable freewheeling, e.g. to render faster than real time.
+   *  Thread-safe: no
+   *  Realtime-safe: yes
+   *
+   *  @discussion This function should ONLY be called in the audio thread. While
+   *  freewheeling, abl_link_capture_audio_session_state returns a frozen Session
+   *  State, which abl_link_commit_audio_session_state replaces without passing it on
+   *  to the session. Disabling freewheeling follows the session again.
+   */
+  void abl_link_enable_freewheel(abl_link link, bool enable);
+
   /*! @brief Capture the current Link Session State from an application thread.
    *  Thread-safe: no
    *  Realtime-safe: yes
@@ -220,6 +431,16 @@ extern "C"
   void abl_link_capture_app_session_state(
     abl_link link, abl_link_session_state session_state);
 
+  /*! @brief A number that increases whenever the Session State captured by
+   *  abl_link_capture_app_session_state changes.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   *
+   *  @discussion Polling threads can skip capturing the Session State while the
+   *  version stays the same. Changes of the number of peers aren't counted.
+   */
+  uint64_t abl_link_app_session_state_version(abl_link link);
+
   /*! @brief Commit the given Session State to the Link session from an
    *  application thread.
    *  Thread-safe: yes
@@ -232,6 +453,15 @@ extern "C"
   void abl_link_commit_app_session_state(
     abl_link link, abl_link_session_state session_state);
 
+  /*! @brief Schedule a change of the session tempo from an application thread.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion At at_time the tempo changes to bpm, keeping the beat at that time.
+   *  All peers of the session switch at the same moment.
+   */
+  void abl_link_schedule_tempo(abl_link link, double bpm, int64_t at_time);
+
   /*! @brief: The tempo of the timeline, in Beats Per Minute.
    *
    *  @discussion This is a stable value that is appropriate for display to the user. Beat
@@ -246,6 +476,25 @@ extern "C"
   void abl_link_set_tempo(
     abl_link_session_state session_state, double bpm, int64_t at_time);
 
+  /*! @brief: Ramp the tempo from start_bpm to end_bpm over the given number of beats,
+   *  starting at the given time.
+   *
+   *  @discussion: The ramp is shared with the session as a whole. With exponential set,
+   *  the tempo changes by the same factor on every beat instead of by the same amount.
+   *  A non-positive length sets end_bpm at start_time.
+   */
+  void abl_link_set_tempo_ramp(abl_link_session_state session_state,
+    double start_bpm,
+    double end_bpm,
+    int64_t start_time,
+    double length_in_beats,
+    bool exponential);
+
+  /*! @brief: The tempo at the given time, which differs from abl_link_tempo before the
+   *  end of a tempo ramp.
+   */
+  double abl_link_tempo_at_time(abl_link_session_state session_state, int64_t time);
+
   /*! @brief: Get the beat value corresponding to the given time for the given quantum.
    *
    *  @discussion: The magnitude of the resulting beat value is unique to this Link
@@ -274,6 +523,44 @@ extern "C"
   int64_t abl_link_time_at_beat(
     abl_link_session_state session_state, double beat, double quantum);
 
+  /*! @brief: Get the beat values corresponding to the given times for the given
+   *  quantum.
+   *
+   *  @discussion: Equivalent to calling abl_link_beat_at_time for each of the count
+   *  times and storing the results in beats, but in a single call. This is useful to
+   *  bindings that pay for every call, e.g. when computing the beats of all events of
+   *  an audio buffer. Both arrays must hold at least count values.
+   */
+  void abl_link_beats_at_times(abl_link_session_state session_state,
+    const int64_t *times,
+    double *beats,
+    size_t count,
+    double quantum);
+
+  /*! @brief: Get the session phases at the given times for the given quantum.
+   *
+   *  @discussion: Equivalent to calling abl_link_phase_at_time for each of the count
+   *  times and storing the results in phases. Both arrays must hold at least count
+   *  values.
+   */
+  void abl_link_phases_at_times(abl_link_session_state session_state,
+    const int64_t *times,
+    double *phases,
+    size_t count,
+    double quantum);
+
+  /*! @brief: Get the times at which the given beats occur for the given quantum.
+   *
+   *  @discussion: Equivalent to calling abl_link_time_at_beat for each of the count
+   *  beats and storing the results in times. Both arrays must hold at least count
+   *  values.
+   */
+  void abl_link_times_at_beats(abl_link_session_state session_state,
+    const double *beats,
+    int64_t *times,
+    size_t count,
+    double quantum);
+
   /*! @brief: Attempt to map the given beat to the given time in the context of the given
    * quantum.
    *
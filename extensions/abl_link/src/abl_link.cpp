@@ -19,17 +19,139 @@
 
 #include <abl_link.h>
 #include <ableton/Link.hpp>
+#include <atomic>
+#include <new>
+#include <vector>
+
+static_assert(sizeof(ableton::Link::SessionState)
+                <= sizeof(abl_link_session_state_storage::impl.bytes),
+  "abl_link_session_state_storage is too small");
+static_assert(
+  alignof(ableton::Link::SessionState) <= alignof(abl_link_session_state_storage),
+  "abl_link_session_state_storage is not aligned enough");
+
+namespace
+{
+
+// Bounded lock-free queue of the events for abl_link_poll_events, written by the
+// thread that invokes the callbacks of Link and read by the thread that polls. Like
+// link::SpscRingBuffer, but sized at runtime. Writes fail instead of blocking if
+// the queue is full.
+class EventQueue
+{
+public:
+  explicit EventQueue(const size_t capacity)
+    : mEvents(capacity + 1)
+    , mWriteIndex(0)
+    , mReadIndex(0)
+  {
+  }
+
+  bool write(const abl_link_event &event)
+  {
+    const auto writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+    const auto nextIndex = next(writeIndex);
+    if (nextIndex == mReadIndex.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    mEvents[writeIndex] = event;
+    mWriteIndex.store(nextIndex, std::memory_order_release);
+    return true;
+  }
+
+  size_t read(abl_link_event *events, const size_t maxEvents)
+  {
+    auto readIndex = mReadIndex.load(std::memory_order_relaxed);
+    const auto writeIndex = mWriteIndex.load(std::memory_order_acquire);
+    auto numEvents = size_t{0};
+    for (; numEvents < maxEvents && readIndex != writeIndex; ++numEvents)
+    {
+      events[numEvents] = mEvents[readIndex];
+      readIndex = next(readIndex);
+    }
+    mReadIndex.store(readIndex, std::memory_order_release);
+    return numEvents;
+  }
+
+private:
+  size_t next(const size_t index) const
+  {
+    return (index + 1) % mEvents.size();
+  }
+
+  // One slot more than the capacity to distinguish a full from an empty queue
+  std::vector<abl_link_event> mEvents;
+  std::atomic<size_t> mWriteIndex;
+  std::atomic<size_t> mReadIndex;
+};
+
+// The impl of an abl_link points to the Link base, so the functions that don't
+// need the event queue just cast it back
+struct AblLink : ableton::Link
+{
+  AblLink(const double bpm, const size_t eventQueueSize)
+    : ableton::Link(bpm)
+    , events(eventQueueSize)
+  {
+  }
+
+  // Invoked on the thread of the callbacks, which is the only writer of the queue
+  void queueEvent(abl_link_event event)
+  {
+    event.time = clock().micros().count();
+    events.write(event);
+  }
+
+  void queueNumPeers(const std::size_t numPeers)
+  {
+    queueEvent({abl_link_event_num_peers, 0, static_cast<uint64_t>(numPeers), 0., false});
+  }
+
+  void queueTempo(const double tempo)
+  {
+    queueEvent({abl_link_event_tempo, 0, 0, tempo, false});
+  }
+
+  void queueIsPlaying(const bool isPlaying)
+  {
+    queueEvent({abl_link_event_start_stop, 0, 0, 0., isPlaying});
+  }
+
+  EventQueue events;
+};
+
+AblLink *toAblLink(abl_link link)
+{
+  return static_cast<AblLink *>(reinterpret_cast<ableton::Link *>(link.impl));
+}
+
+} // namespace
 
 extern "C"
 {
   abl_link abl_link_create(double bpm)
   {
-    return abl_link{reinterpret_cast<void *>(new ableton::Link(bpm))};
+    return abl_link_create_with_event_queue(bpm, 0);
+  }
+
+  abl_link abl_link_create_with_event_queue(double bpm, size_t event_queue_size)
+  {
+    const auto pLink = new AblLink(bpm, event_queue_size);
+    if (event_queue_size > 0)
+    {
+      pLink->setNumPeersCallback(
+        [pLink](const std::size_t numPeers) { pLink->queueNumPeers(numPeers); });
+      pLink->setTempoCallback([pLink](const double tempo) { pLink->queueTempo(tempo); });
+      pLink->setStartStopCallback(
+        [pLink](const bool isPlaying) { pLink->queueIsPlaying(isPlaying); });
+    }
+    return abl_link{reinterpret_cast<void *>(static_cast<ableton::Link *>(pLink))};
   }
 
   void abl_link_destroy(abl_link link)
   {
-    delete reinterpret_cast<ableton::Link *>(link.impl);
+    delete toAblLink(link);
   }
 
   bool abl_link_is_enabled(abl_link link)
@@ -42,6 +164,11 @@ extern "C"
     reinterpret_cast<ableton::Link *>(link.impl)->enable(enabled);
   }
 
+  void abl_link_suspend(abl_link link)
+  {
+    reinterpret_cast<ableton::Link *>(link.impl)->suspend();
+  }
+
   bool abl_link_is_start_stop_sync_enabled(abl_link link)
   {
     return reinterpret_cast<ableton::Link *>(link.impl)->isStartStopSyncEnabled();
@@ -52,31 +179,65 @@ extern "C"
     reinterpret_cast<ableton::Link *>(link.impl)->enableStartStopSync(enabled);
   }
 
+  void abl_link_set_session_group(abl_link link, uint16_t group_id)
+  {
+    reinterpret_cast<ableton::Link *>(link.impl)->setSessionGroup(group_id);
+  }
+
+  uint16_t abl_link_session_group(abl_link link)
+  {
+    return reinterpret_cast<ableton::Link *>(link.impl)->sessionGroup();
+  }
+
   uint64_t abl_link_num_peers(abl_link link)
   {
     return reinterpret_cast<ableton::Link *>(link.impl)->numPeers();
   }
 
+  abl_link_sync_quality abl_link_session_sync_quality(abl_link link)
+  {
+    const auto pLink = reinterpret_cast<ableton::Link *>(link.impl);
+    const auto quality = pLink->syncQuality();
+    return {quality.roundTripTime.count(), quality.jitter.count(), quality.offsetVariance,
+      quality.isMeasured()
+        ? (pLink->clock().micros() - quality.measurementTime).count()
+        : INT64_C(-1)};
+  }
+
+  // The callbacks keep queueing the events, if the instance has a queue
   void abl_link_set_num_peers_callback(
     abl_link link, abl_link_num_peers_callback callback, void *context)
   {
-    reinterpret_cast<ableton::Link *>(link.impl)->setNumPeersCallback(
-      [callback, context](
-        std::size_t numPeers) { (*callback)(static_cast<uint64_t>(numPeers), context); });
+    const auto pLink = toAblLink(link);
+    pLink->setNumPeersCallback([pLink, callback, context](std::size_t numPeers) {
+      pLink->queueNumPeers(numPeers);
+      (*callback)(static_cast<uint64_t>(numPeers), context);
+    });
   }
 
   void abl_link_set_tempo_callback(
     abl_link link, abl_link_tempo_callback callback, void *context)
   {
-    reinterpret_cast<ableton::Link *>(link.impl)->setTempoCallback(
-      [callback, context](double tempo) { (*callback)(tempo, context); });
+    const auto pLink = toAblLink(link);
+    pLink->setTempoCallback([pLink, callback, context](double tempo) {
+      pLink->queueTempo(tempo);
+      (*callback)(tempo, context);
+    });
   }
 
   void abl_link_set_start_stop_callback(
     abl_link link, abl_link_start_stop_callback callback, void *context)
   {
-    reinterpret_cast<ableton::Link *>(link.impl)->setStartStopCallback(
-      [callback, context](bool isPlaying) { (*callback)(isPlaying, context); });
+    const auto pLink = toAblLink(link);
+    pLink->setStartStopCallback([pLink, callback, context](bool isPlaying) {
+      pLink->queueIsPlaying(isPlaying);
+      (*callback)(isPlaying, context);
+    });
+  }
+
+  size_t abl_link_poll_events(abl_link link, abl_link_event *events, size_t max_events)
+  {
+    return toAblLink(link)->events.read(events, max_events);
   }
 
   int64_t abl_link_clock_micros(abl_link link)
@@ -95,6 +256,19 @@ extern "C"
     delete reinterpret_cast<ableton::Link::SessionState *>(session_state.impl);
   }
 
+  abl_link_session_state abl_link_init_session_state(
+    abl_link_session_state_storage *storage)
+  {
+    return abl_link_session_state{reinterpret_cast<void *>(new (storage->impl.bytes)
+        ableton::Link::SessionState{ableton::link::ApiState{}, {}})};
+  }
+
+  void abl_link_deinit_session_state(abl_link_session_state session_state)
+  {
+    using SessionState = ableton::Link::SessionState;
+    reinterpret_cast<SessionState *>(session_state.impl)->~SessionState();
+  }
+
   void abl_link_capture_app_session_state(
     abl_link link, abl_link_session_state session_state)
   {
@@ -102,6 +276,11 @@ extern "C"
       reinterpret_cast<ableton::Link *>(link.impl)->captureAppSessionState();
   }
 
+  uint64_t abl_link_app_session_state_version(abl_link link)
+  {
+    return reinterpret_cast<ableton::Link *>(link.impl)->appSessionStateVersion();
+  }
+
   void abl_link_commit_app_session_state(
     abl_link link, abl_link_session_state session_state)
   {
@@ -109,6 +288,12 @@ extern "C"
       *reinterpret_cast<ableton::Link::SessionState *>(session_state.impl));
   }
 
+  void abl_link_schedule_tempo(abl_link link, double bpm, int64_t at_time)
+  {
+    reinterpret_cast<ableton::Link *>(link.impl)->scheduleTempo(
+      bpm, std::chrono::microseconds{at_time});
+  }
+
   void abl_link_capture_audio_session_state(
     abl_link link, abl_link_session_state session_state)
   {
@@ -116,6 +301,21 @@ extern "C"
       reinterpret_cast<ableton::Link *>(link.impl)->captureAudioSessionState();
   }
 
+  void abl_link_capture_audio_session_state_at(
+    abl_link link, abl_link_session_state session_state, int64_t time_micros)
+  {
+    *reinterpret_cast<ableton::Link::SessionState *>(session_state.impl) =
+      reinterpret_cast<ableton::Link *>(link.impl)->captureAudioSessionStateAt(
+        std::chrono::microseconds{time_micros});
+  }
+
+  void abl_link_capture_shared_audio_session_state(
+    abl_link link, abl_link_session_state session_state)
+  {
+    *reinterpret_cast<ableton::Link::SessionState *>(session_state.impl) =
+      reinterpret_cast<ableton::Link *>(link.impl)->captureSharedAudioSessionState();
+  }
+
   void abl_link_commit_audio_session_state(
     abl_link link, abl_link_session_state session_state)
   {
@@ -123,6 +323,33 @@ extern "C"
       *reinterpret_cast<ableton::Link::SessionState *>(session_state.impl));
   }
 
+  bool abl_link_commit_shared_audio_session_state(
+    abl_link link, abl_link_session_state session_state)
+  {
+    return reinterpret_cast<ableton::Link *>(link.impl)->commitSharedAudioSessionState(
+      *reinterpret_cast<ableton::Link::SessionState *>(session_state.impl));
+  }
+
+  void abl_link_begin_audio_block(abl_link link)
+  {
+    reinterpret_cast<ableton::Link *>(link.impl)->beginAudioBlock();
+  }
+
+  void abl_link_end_audio_block(abl_link link)
+  {
+    reinterpret_cast<ableton::Link *>(link.impl)->endAudioBlock();
+  }
+
+  bool abl_link_is_freewheel_enabled(abl_link link)
+  {
+    return reinterpret_cast<ableton::Link *>(link.impl)->isFreewheelEnabled();
+  }
+
+  void abl_link_enable_freewheel(abl_link link, bool enable)
+  {
+    reinterpret_cast<ableton::Link *>(link.impl)->enableFreewheel(enable);
+  }
+
   double abl_link_tempo(abl_link_session_state session_state)
   {
     return reinterpret_cast<ableton::Link::SessionState *>(session_state.impl)->tempo();
@@ -135,6 +362,26 @@ extern "C"
       ->setTempo(bpm, std::chrono::microseconds{at_time});
   }
 
+  void abl_link_set_tempo_ramp(abl_link_session_state session_state,
+    double start_bpm,
+    double end_bpm,
+    int64_t start_time,
+    double length_in_beats,
+    bool exponential)
+  {
+    reinterpret_cast<ableton::Link::SessionState *>(session_state.impl)
+      ->setTempoRamp(start_bpm, end_bpm, std::chrono::microseconds{start_time},
+        length_in_beats,
+        exponential ? ableton::Link::TempoCurve::Exponential
+                    : ableton::Link::TempoCurve::Linear);
+  }
+
+  double abl_link_tempo_at_time(abl_link_session_state session_state, int64_t time)
+  {
+    return reinterpret_cast<ableton::Link::SessionState *>(session_state.impl)
+      ->tempoAtTime(std::chrono::microseconds{time});
+  }
+
   double abl_link_beat_at_time(
     abl_link_session_state session_state, int64_t time, double quantum)
   {
@@ -158,6 +405,48 @@ extern "C"
       .count();
   }
 
+  void abl_link_beats_at_times(abl_link_session_state session_state,
+    const int64_t *times,
+    double *beats,
+    size_t count,
+    double quantum)
+  {
+    const auto &state =
+      *reinterpret_cast<ableton::Link::SessionState *>(session_state.impl);
+    for (size_t i = 0; i < count; ++i)
+    {
+      beats[i] = state.beatAtTime(std::chrono::microseconds{times[i]}, quantum);
+    }
+  }
+
+  void abl_link_phases_at_times(abl_link_session_state session_state,
+    const int64_t *times,
+    double *phases,
+    size_t count,
+    double quantum)
+  {
+    const auto &state =
+      *reinterpret_cast<ableton::Link::SessionState *>(session_state.impl);
+    for (size_t i = 0; i < count; ++i)
+    {
+      phases[i] = state.phaseAtTime(std::chrono::microseconds{times[i]}, quantum);
+    }
+  }
+
+  void abl_link_times_at_beats(abl_link_session_state session_state,
+    const double *beats,
+    int64_t *times,
+    size_t count,
+    double quantum)
+  {
+    const auto &state =
+      *reinterpret_cast<ableton::Link::SessionState *>(session_state.impl);
+    for (size_t i = 0; i < count; ++i)
+    {
+      times[i] = state.timeAtBeat(beats[i], quantum).count();
+    }
+  }
+
   void abl_link_request_beat_at_time(
     abl_link_session_state session_state, double beat, int64_t time, double quantum)
   {
@@ -22,20 +22,39 @@
 
 #pragma once
 
+#include <ableton/link/BeatCursor.hpp>
+#include <ableton/link/CallbackMailbox.hpp>
+#include <ableton/link/CompiledTimeline.hpp>
+#include <ableton/link/PowerProfile.hpp>
+#include <ableton/link/SessionEvent.hpp>
+#include <ableton/link/SyncQuality.hpp>
+#include <ableton/link/TempoRamp.hpp>
 #include <ableton/platforms/Config.hpp>
+#include <ableton/util/RtSafety.hpp>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <future>
 #include <mutex>
+#include <vector>
 
 namespace ableton
 {
 
-/*! @class Link and BasicLink
+/*! @class Link, SharedLink and BasicLink
  *  @brief Classes representing a participant in a Link session.
- *  The BasicLink type allows to customize the clock. The Link type
- *  uses the recommended platform-dependent representation of the
+ *  The BasicLink type allows to customize the clock and the io context. The
+ *  Link type uses the recommended platform-dependent representation of the
  *  system clock as defined in platforms/Config.hpp.
  *  It's preferred to use Link instead of BasicLink.
  *
+ *  SharedLink instances behave like Link instances, but all SharedLink instances
+ *  of a process handle their network traffic on a single shared thread instead of
+ *  one thread each. This is useful for applications that contain many Link
+ *  instances, such as plugin hosts. Each instance is still a separate peer with
+ *  its own session state. A SharedLink instance must not be destroyed from within
+ *  a callback of another SharedLink instance.
+ *
  *  @discussion Each Link instance has its own session state which
  *  represents a beat timeline and a transport start/stop state. The
  *  timeline starts running from beat 0 at the initial tempo when
@@ -74,20 +93,71 @@ namespace ableton
  *  will require providing a custom Clock implementation. See the clock()
  *  documentation for details.
  */
-template <typename Clock>
+template <typename Clock, typename IoContext = link::platform::IoContext>
 class BasicLink
 {
 public:
   class SessionState;
+  using InterfaceFilter = discovery::InterfaceFilter;
+  using BeatCursor = link::BeatCursor;
+  using PeerInfo = link::PeerInfo;
+  using PeerList = link::PeerList;
+  using SessionInfo = link::SessionInfo;
+  using SessionList = link::SessionList;
+  using PowerProfile = link::PowerProfile;
+  using SessionEvent = link::SessionEvent;
+  using Stats = link::Stats;
+  using SyncQuality = link::SyncQuality;
+  using TempoCurve = link::TempoCurve;
+  using ThreadPolicy = platforms::ThreadPolicy;
+
+  /*! @brief The threads that the peer count, tempo and start/stop callbacks
+   *  are invoked on.
+   *  @discussion IoThread invokes them on the Link-managed thread that also
+   *  handles the network, which is delayed by callbacks that take long.
+   *  With NotifierThread and Polled, notifications are instead posted to a
+   *  lock-free mailbox and the callbacks are invoked on a separate thread
+   *  owned by Link or from processCallbacks, respectively. Notifications
+   *  that arrive before the previous one of the same callback was
+   *  delivered are coalesced into the latest value.
+   */
+  enum class CallbackDelivery
+  {
+    IoThread,
+    NotifierThread,
+    Polled
+  };
 
-  /*! @brief Construct with an initial tempo. */
+  /*! @brief Construct with an initial tempo.
+   *  @discussion The threads of Link aren't started until it's enabled for the
+   *  first time, so an instance that is never enabled costs none. Until then,
+   *  the session states committed from the app and the audio thread are handled
+   *  by the thread that commits or captures the app session state, which also
+   *  invokes the callbacks of the changes.
+   */
   BasicLink(double bpm);
 
+  /*! @brief Construct with an initial tempo. Network events are handled on the
+   *  given io_service instead of a thread owned by Link.
+   *  @discussion The io_service must not be run by more than one thread at a time
+   *  and must keep running until this instance is destroyed. Exceptions thrown
+   *  while handling network events propagate out of the function that runs the
+   *  io_service, after which it can be run again. The instance can be destroyed
+   *  from a handler of the io_service, which tears it down without waiting for
+   *  the io_service. The future returned by shutdown must not be waited for in
+   *  such a handler, as it's only ready once the io_service has handled it.
+   */
+  BasicLink(double bpm, ::asio::io_service& ioService);
+
   /*! @brief Link instances cannot be copied or moved */
-  BasicLink(const BasicLink<Clock>&) = delete;
-  BasicLink& operator=(const BasicLink<Clock>&) = delete;
-  BasicLink(BasicLink<Clock>&&) = delete;
-  BasicLink& operator=(BasicLink<Clock>&&) = delete;
+  BasicLink(const BasicLink<Clock, IoContext>&) = delete;
+  BasicLink& operator=(const BasicLink<Clock, IoContext>&) = delete;
+  BasicLink(BasicLink<Clock, IoContext>&&) = delete;
+  BasicLink& operator=(BasicLink<Clock, IoContext>&&) = delete;
+
+  // Defined out of line, so that it's instantiated along with the other members for
+  // LinkCompiled, see below
+  ~BasicLink();
 
   /*! @brief Is Link currently enabled?
    *  Thread-safe: yes
@@ -101,6 +171,32 @@ public:
    */
   void enable(bool bEnable);
 
+  /*! @brief Disable Link, but keep its network resources for enabling it again.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Like enable(false), suspending leaves the session, but the
+   *  sockets on the network interfaces stay open, so that enabling Link
+   *  again is fast and announces it to the peers right away. This suits
+   *  apps that toggle Link often, for example per document. Disabling a
+   *  suspended Link releases the network resources.
+   */
+  void suspend();
+
+  /*! @brief Disable Link and leave the session without waiting for it.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Destroying a Link instance blocks until it has left the
+   *  session on its network thread. shutdown starts this and returns right
+   *  away. The returned future becomes ready when Link has left the
+   *  session, after which destroying the instance no longer waits for the
+   *  network thread. Hosts that close many instances at once can shut all
+   *  of them down before destroying them, so that they leave their
+   *  sessions concurrently.
+   */
+  std::future<void> shutdown();
+
   /*! @brief: Is start/stop synchronization enabled?
    *  Thread-safe: yes
    *  Realtime-safe: no
@@ -113,6 +209,326 @@ public:
    */
   void enableStartStopSync(bool bEnable);
 
+  /*! @brief: Is the audio timeline commit queue enabled?
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   */
+  bool isAudioTimelineCommitQueueEnabled() const;
+
+  /*! @brief: Enable the audio timeline commit queue.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   *
+   *  @discussion By default, only the latest timeline committed with
+   *  commitAudioSessionState is passed on to the session when Link
+   *  processes the commits. With the queue enabled, every committed
+   *  timeline is applied in order, so that e.g. a tempo ramp committed
+   *  block by block reaches the session with all of its steps. The
+   *  resulting updates of the peers are rate limited.
+   */
+  void enableAudioTimelineCommitQueue(bool bEnable);
+
+  /*! @brief: Is the session event queue enabled?
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   */
+  bool isSessionEventQueueEnabled() const;
+
+  /*! @brief: Enable the session event queue.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   *
+   *  @discussion While enabled, Link queues a timestamped SessionEvent for
+   *  every change of the session tempo and, if start/stop sync is enabled,
+   *  of the start/stop state, including the changes made by this instance.
+   *  The events are read with readSessionEvent, so that an audio thread
+   *  learns about transitions without polling the Session State and without
+   *  a callback on a Link-managed thread. Events are dropped while 64 of
+   *  them are pending.
+   */
+  void enableSessionEventQueue(bool bEnable);
+
+  /*! @brief: Read the oldest pending session event.
+   *  Thread-safe: no
+   *  Realtime-safe: yes
+   *
+   *  @discussion Returns false if no event is pending. Must not be called
+   *  from more than one thread at a time. Never blocks.
+   */
+  bool readSessionEvent(SessionEvent& event);
+
+  /*! @brief: Select the network interfaces that Link communicates on.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion By default, Link communicates on all network interfaces
+   *  with an IPv4 address. Interfaces can be allowed or denied by name,
+   *  subnet or type, see discovery/InterfaceFilter.hpp. Excluding
+   *  interfaces that never carry Link peers, such as container bridges
+   *  or VPN tunnels, saves the sockets, timers and broadcasts that Link
+   *  maintains per interface. The filter takes effect immediately if
+   *  Link is enabled.
+   */
+  void setInterfaceFilter(InterfaceFilter filter);
+
+  /*! @brief: Set how the threads that Link handles the network on are scheduled.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion The io thread handles the replies to the measurements of other
+   *  peers, so any delay in scheduling it adds to the error of their
+   *  measurements. On machines that are loaded by render threads, it can be
+   *  given a real-time priority and be bound to CPUs that the render threads
+   *  don't use, see platforms/ThreadPolicy.hpp. Raising the priority may
+   *  need privileges and is skipped without them. The policy doesn't apply to
+   *  an io_service that is run by the application.
+   */
+  void setThreadPolicy(ThreadPolicy policy);
+
+  /*! @brief: Handle the traffic of each network interface on a thread of
+   *  its own.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion By default the discovery and the measurements of all
+   *  interfaces are handled on the io thread, so a busy interface delays
+   *  the replies to the measurements on the others. This is meant for
+   *  hosts that are connected to several networks, e.g. servers with an
+   *  interface for each of them. The threads are named after the address
+   *  of their interface and follow the policy set with setThreadPolicy.
+   *  Switching recreates the handling of the interfaces, which says bye
+   *  bye to the peers and announces this instance again.
+   */
+  void enableThreadPerInterface(bool bEnable);
+
+  /*! @brief: Whether each network interface is handled on a thread of its
+   *  own.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   */
+  bool isThreadPerInterfaceEnabled() const;
+
+  /*! @brief: Set how often Link wakes up to keep the session going.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Apps that are moved to the background or devices that run
+   *  on battery can switch to PowerProfile::Background, which broadcasts
+   *  the state of this instance and rescans the network interfaces at a
+   *  quarter of the usual rate and skips the periodic remeasurements of the
+   *  session. Peers keep this instance for as long as it announces, so it
+   *  stays in the session, but changes of other peers may take longer to
+   *  arrive when the app doesn't commit session states itself. Switching
+   *  back to PowerProfile::Full broadcasts the state right away.
+   */
+  void setPowerProfile(PowerProfile profile);
+
+  /*! @brief: The power profile that was set last.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   */
+  PowerProfile powerProfile() const;
+
+  /*! @brief: The addresses of the peers that have been in a session with
+   *  this instance, most recent last.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion The addresses can be stored and passed to
+   *  setKnownPeerAddresses on the next launch.
+   */
+  std::vector<::asio::ip::address> knownPeerAddresses() const;
+
+  /*! @brief: The peers that this instance sees, in any session.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Lists the node and session id, the timeline, the
+   *  interface and the measurement endpoint of each peer on each
+   *  interface it's visible on, along with the measured offset of its
+   *  session and the host time it was last seen at. Link publishes a new
+   *  list whenever a peer joins, leaves or changes sessions and refreshes
+   *  it every second while peers are around. The list is never modified
+   *  once published, so calling this is cheap and the result can be
+   *  kept and read by a UI thread while Link goes on.
+   */
+  std::shared_ptr<const PeerList> peerList() const;
+
+  /*! @brief: The sessions that this instance knows of.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Lists the session this instance is in first, followed
+   *  by the other sessions it has seen recently, each with its id, its
+   *  timeline, the number of its peers and the measured offset of its
+   *  ghost time. Other sessions with peers are competing ones, e.g. of a
+   *  device that can't reach the others. The list is published whenever
+   *  it changes and, like peerList, never modified afterwards. Listing
+   *  the sessions doesn't cause any traffic.
+   */
+  std::shared_ptr<const SessionList> sessionList() const;
+
+  /*! @brief: Limit the number of other sessions that are measured.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Each session that is seen is measured to find out
+   *  whether it should be joined. Sessions that are seen while at least
+   *  maxMeasured other sessions are known are still listed by
+   *  sessionList, but aren't measured and thus can't be joined, which
+   *  bounds the traffic caused by a flood of competing sessions. The
+   *  default doesn't limit the measurements.
+   */
+  void setMaxMeasuredOtherSessions(std::size_t maxMeasured);
+
+  /*! @brief: The limit set with setMaxMeasuredOtherSessions.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   */
+  std::size_t maxMeasuredOtherSessions() const;
+
+  /*! @brief: Restore the addresses of peers known from a previous run.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion When Link is enabled, it sends its state directly to the
+   *  peers at these addresses in addition to announcing it by multicast.
+   *  A peer that is still there answers with its own state right away, so
+   *  that the session is joined even if multicast messages are delayed or
+   *  lost. The session and the clock measurements are not restored, as
+   *  they don't outlive the processes of the peers. Only the most recent
+   *  64 addresses are kept.
+   */
+  void setKnownPeerAddresses(std::vector<::asio::ip::address> addresses);
+
+  /*! @brief: Send the state of this instance directly to the given peers.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Link discovers its peers by multicast, which some managed
+   *  or cloud networks drop or rate-limit. Every announcement and bye bye
+   *  of Link is also sent to these endpoints by unicast, and the peers or
+   *  relays there answer as if it had arrived by multicast. Link listens
+   *  on port 20808 of every interface, so that is the port to use for
+   *  peers. Replaces the previously set endpoints.
+   */
+  void setUnicastPeers(std::vector<::asio::ip::udp::endpoint> peers);
+
+  /*! @brief: Only join sessions with the peers of the given group.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Peers of different groups ignore each other, so that
+   *  independent setups that share a network, like the rooms of a studio,
+   *  neither join each other's sessions nor pay for each other's
+   *  discovery traffic. The default group is 0, which is the group of
+   *  all peers that don't support groups. Changing the group leaves the
+   *  peers of the previous one.
+   */
+  void setSessionGroup(std::uint16_t groupId);
+
+  /*! @brief: The group set with setSessionGroup.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   */
+  std::uint16_t sessionGroup() const;
+
+  /*! @brief: Follow the session of the peers without being one of them.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion An observer, like a monitoring display, only listens
+   *  to the state that its peers broadcast anyway. It neither announces
+   *  itself nor answers the peers, so they don't count it, don't measure
+   *  it and don't send it anything. Adding observers to a network
+   *  therefore doesn't add to the discovery traffic of the peers. An
+   *  observer joins the first session it measures and measures only one
+   *  of its peers. Session state that it commits is not seen by the
+   *  peers. As it doesn't announce itself, it doesn't receive the state
+   *  of unicast peers, see setUnicastPeers. Entering the mode leaves the
+   *  peers, leaving it announces this instance to them.
+   */
+  void enableObserverMode(bool bEnable);
+
+  /*! @brief: Whether observer mode is enabled.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   */
+  bool isObserverModeEnabled() const;
+
+  /*! @brief: Slew the clock of the session instead of letting it jump.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   *
+   *  @discussion Link remeasures the session every few seconds to follow
+   *  the drift of the host clock, and each result may move the session
+   *  time by some microseconds. By default these corrections apply at
+   *  once, so the beat time of the Session State jumps a little. With
+   *  slewing enabled, the session time approaches the new measurement
+   *  at a rate that differs by at most 0.1% from the nominal one, so the
+   *  tempo seen by the app varies by that much while the beat time stays
+   *  continuous. Corrections of more than 10 ms, joining a session and
+   *  resets still apply at once.
+   */
+  void enableClockSlewing(bool bEnable);
+
+  /*! @brief: Whether clock slewing is enabled.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   */
+  bool isClockSlewingEnabled() const;
+
+  /*! @brief: Discover the peers through a limited number of hubs.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion By default every instance announces itself to all
+   *  others, so the discovery traffic that each instance receives and
+   *  the number of peers it keeps track of grow with the size of the
+   *  network. With a non-zero number of hubs, only that many instances
+   *  on a network announce themselves to all others. The other
+   *  instances attach to one of the hubs and only exchange their state
+   *  with it, and the hubs tell the others how many instances they
+   *  serve, so that numPeers still counts all of them. This is meant
+   *  for installations with hundreds of devices on one network, where
+   *  16 hubs are a reasonable choice. All instances on a network should
+   *  use the same number, 0 switches back to announcing to all peers.
+   */
+  void setMaxDiscoveryHubs(std::size_t maxHubs);
+
+  /*! @brief: The number of hubs set with setMaxDiscoveryHubs.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   */
+  std::size_t maxDiscoveryHubs() const;
+
+  /*! @brief: The counters of this instance since it was created.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Counts the packets sent, received and rejected by the
+   *  gateways of every network interface along with the time spent
+   *  handling the received ones, the measurements of peers, the sessions
+   *  joined, the resets of the session state and the Session States
+   *  committed from the audio thread. Counting is wait-free and hardly
+   *  affects the cost it measures.
+   */
+  Stats stats() const;
+
+  /*! @brief: The quality of the clock synchronization with the current
+   *  session, as found by the last successful measurement of it.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Reports the round trip time and jitter of the pings to
+   *  the measured peers, the variance of the measured clock offsets and
+   *  the host time of the measurement, from which the time since then can
+   *  be taken with clock(). Nothing is measured if this instance founded
+   *  its session, including when it's alone, as the other peers then sync
+   *  to its clock, see SyncQuality::isMeasured.
+   */
+  SyncQuality syncQuality() const;
+
   /*! @brief How many peers are currently connected in a Link session?
    *  Thread-safe: yes
    *  Realtime-safe: yes
@@ -125,6 +541,10 @@ public:
    *  Realtime-safe: no
    *
    *  @discussion The callback is invoked on a Link-managed thread.
+   *  Once registering has returned, the previous callback isn't
+   *  running and won't be invoked anymore, so registering waits for
+   *  an invocation of it that may be in progress. Registering from
+   *  within a callback doesn't wait.
    *
    *  @param callback The callback signature is:
    *  void (std::size_t numPeers)
@@ -138,6 +558,10 @@ public:
    *  Realtime-safe: no
    *
    *  @discussion The callback is invoked on a Link-managed thread.
+   *  Once registering has returned, the previous callback isn't
+   *  running and won't be invoked anymore, so registering waits for
+   *  an invocation of it that may be in progress. Registering from
+   *  within a callback doesn't wait.
    *
    *  @param callback The callback signature is: void (double bpm)
    */
@@ -150,6 +574,10 @@ public:
    *  Realtime-safe: no
    *
    *  @discussion The callback is invoked on a Link-managed thread.
+   *  Once registering has returned, the previous callback isn't
+   *  running and won't be invoked anymore, so registering waits for
+   *  an invocation of it that may be in progress. Registering from
+   *  within a callback doesn't wait.
    *
    *  @param callback The callback signature is:
    *  void (bool isPlaying)
@@ -157,6 +585,47 @@ public:
   template <typename Callback>
   void setStartStopCallback(Callback callback);
 
+  /*! @brief Select the threads that the callbacks are invoked on.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion The default is CallbackDelivery::IoThread. Notifications
+   *  that are pending when switching modes are delivered on the calling
+   *  thread.
+   */
+  void setCallbackDelivery(CallbackDelivery delivery);
+
+  /*! @brief Invoke the callbacks for the pending notifications.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion Intended to be periodically called, e.g. from the UI
+   *  thread, with CallbackDelivery::Polled. Returns whether any
+   *  notifications were pending.
+   */
+  bool processCallbacks();
+
+  /*! @brief Limit how often the tempo callback is invoked.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion While a peer drags or ramps the tempo, the tempo may
+   *  change dozens of times per second. With a non-zero interval and
+   *  CallbackDelivery::NotifierThread or Polled, the tempo callback is
+   *  invoked at most once per interval. A tempo that changes sooner is
+   *  held back and delivered once the interval has passed, by the
+   *  notifier thread or the next call to processCallbacks, so the last
+   *  tempo is always delivered. Delivery on the io thread isn't limited.
+   *  The default of 0 doesn't limit the callback.
+   */
+  void setTempoCallbackMinInterval(std::chrono::microseconds interval);
+
+  /*! @brief The interval set with setTempoCallbackMinInterval.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   */
+  std::chrono::microseconds tempoCallbackMinInterval() const;
+
   /*! @brief The clock used by Link.
    *  Thread-safe: yes
    *  Realtime-safe: yes
@@ -165,6 +634,13 @@ public:
    *  of the system clock. It exposes a micros() method, which is a
    *  normalized representation of the current system time in
    *  std::chrono::microseconds.
+   *
+   *  A custom Clock may also expose a clockDomainId() method returning a
+   *  link::ClockDomainId. Peers whose clocks are in the same identified
+   *  domain read the same time, so they take over each other's timing
+   *  instead of measuring it. A Clock reading the time of a PTP domain,
+   *  e.g. on an AES67 network, can return link::ptpClockDomainId() of its
+   *  grandmaster and domain number.
    */
   Clock clock() const;
 
@@ -181,6 +657,35 @@ public:
    */
   SessionState captureAudioSessionState() const;
 
+  /*! @brief Capture the Link Session State for rendering the given time
+   *  from the audio thread.
+   *  Thread-safe: no
+   *  Realtime-safe: yes
+   *
+   *  @discussion Like captureAudioSessionState, but if the timeline has
+   *  changed since the given time, e.g. by a peer changing the tempo, the
+   *  returned Session State has the timeline that was valid at that time.
+   *  This lets an engine that renders audio for times in the past, such
+   *  as a buffer that is delayed for lookahead, keep the mapping of beats
+   *  that it used before the change instead of jumping. The 16 most
+   *  recent timelines are kept.
+   */
+  SessionState captureAudioSessionStateAt(std::chrono::microseconds time) const;
+
+  /*! @brief Capture the current Link Session State from any of
+   *  several audio threads.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   *
+   *  @discussion Like captureAudioSessionState, but may be called from
+   *  any number of realtime threads concurrently, e.g. the worker
+   *  threads of a host that renders in parallel. Session States
+   *  committed with commitAudioSessionState are only reflected once
+   *  Link has processed them, so the thread committing changes should
+   *  keep using captureAudioSessionState.
+   */
+  SessionState captureSharedAudioSessionState() const;
+
   /*! @brief Commit the given Session State to the Link session from the
    *  audio thread.
    *  Thread-safe: no
@@ -193,6 +698,78 @@ public:
    */
   void commitAudioSessionState(SessionState state);
 
+  /*! @brief Commit the given Session State to the Link session from any
+   *  of several audio threads.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   *
+   *  @discussion Like commitAudioSessionState, but may be called from
+   *  any number of realtime threads concurrently, e.g. by the tempo
+   *  automation of a host that renders on several worker threads. The
+   *  commits of all threads are merged when Link processes them, the
+   *  timeline and the start/stop state committed last win. They are only
+   *  reflected by captureAudioSessionState and
+   *  captureSharedAudioSessionState once Link has processed them, and
+   *  freewheeling doesn't apply to them. Returns false if the Session
+   *  State was dropped because eight other threads are committing at the
+   *  same time.
+   */
+  bool commitSharedAudioSessionState(SessionState state);
+
+  /*! @brief Begin processing an audio block.
+   *  Thread-safe: no
+   *  Realtime-safe: yes
+   *
+   *  @discussion This method should ONLY be called in the audio
+   *  thread, typically at the start of the audio callback. It reads
+   *  the clock once and resolves which Link Session State the audio
+   *  thread should see. Until endAudioBlock is called,
+   *  captureAudioSessionState returns this snapshot without consulting
+   *  the clock again, so it can cheaply be called from several places
+   *  within the block. Session States committed with
+   *  commitAudioSessionState during the block are reflected by
+   *  subsequent captures.
+   */
+  void beginAudioBlock();
+
+  /*! @brief End processing an audio block.
+   *  Thread-safe: no
+   *  Realtime-safe: yes
+   *
+   *  @discussion Counterpart of beginAudioBlock. Afterwards,
+   *  captureAudioSessionState resolves the Link Session State on every
+   *  call again.
+   */
+  void endAudioBlock();
+
+  /*! @brief Is freewheeling enabled?
+   *  Thread-safe: no
+   *  Realtime-safe: yes
+   *
+   *  @discussion This method should ONLY be called in the audio thread.
+   */
+  bool isFreewheelEnabled() const;
+
+  /*! @brief Enable freewheeling, e.g. to render faster than real time.
+   *  Thread-safe: no
+   *  Realtime-safe: yes
+   *
+   *  @discussion This method should ONLY be called in the audio thread.
+   *  Enabling freewheeling freezes the Session State returned by
+   *  captureAudioSessionState. Session States committed with
+   *  commitAudioSessionState meanwhile only replace the frozen state.
+   *  They are not passed on to the session, and changes of the session
+   *  don't affect the frozen state. As the timeline maps any time to
+   *  beats, an offline render can use times derived from its sample
+   *  position instead of the clock, e.g. with a util::SampleClock that
+   *  starts at the timeAtBeat of the first beat of the render. Link stays
+   *  in the session, and captureAppSessionState and
+   *  captureSharedAudioSessionState keep following it. Disabling
+   *  freewheeling discards the frozen state, so that the audio thread
+   *  follows the session again from the next capture.
+   */
+  void enableFreewheel(bool bEnable);
+
   /*! @brief Capture the current Link Session State from an application
    *  thread.
    *  Thread-safe: yes
@@ -207,6 +784,19 @@ public:
    */
   SessionState captureAppSessionState() const;
 
+  /*! @brief A number that increases whenever the Session State that
+   *  captureAppSessionState returns changes.
+   *  Thread-safe: yes
+   *  Realtime-safe: yes
+   *
+   *  @discussion Lets threads that poll the Session State, such as the
+   *  ones drawing a user interface, skip capturing it while it stays the
+   *  same. A Session State captured after reading the version is at
+   *  least as recent as that version. Changes of the number of peers
+   *  aren't counted, see setNumPeersCallback.
+   */
+  std::uint64_t appSessionStateVersion() const;
+
   /*! @brief Commit the given Session State to the Link session from an
    *  application thread.
    *  Thread-safe: yes
@@ -218,6 +808,19 @@ public:
    */
   void commitAppSessionState(SessionState state);
 
+  /*! @brief Schedule a change of the session tempo from an application
+   *  thread.
+   *  Thread-safe: yes
+   *  Realtime-safe: no
+   *
+   *  @discussion At the given time the tempo changes to bpm, keeping the
+   *  beat at that time. The change is communicated to the other peers of
+   *  the session right away, so that all of them switch at the same moment
+   *  instead of following a commit once it reached them. Times in the past
+   *  change the tempo right away.
+   */
+  void scheduleTempo(double bpm, std::chrono::microseconds atTime);
+
   /*! @class SessionState
    *  @brief Representation of a timeline and the start/stop state
    *
@@ -248,15 +851,37 @@ public:
      *
      *  @discussion This is a stable value that is appropriate for display
      *  to the user. Beat time progress will not necessarily match this tempo
-     *  exactly because of clock drift compensation.
+     *  exactly because of clock drift compensation. During a tempo ramp this
+     *  is the tempo that the ramp leads to.
      */
     double tempo() const;
 
     /*! @brief: Set the timeline tempo to the given bpm value, taking
-     *  effect at the given time.
+     *  effect at the given time. Ends a tempo ramp.
      */
     void setTempo(double bpm, std::chrono::microseconds atTime);
 
+    /*! @brief: Ramp the tempo from startBpm to endBpm over the given number
+     *  of beats, starting at the given time.
+     *
+     *  @discussion: The ramp is shared with the session as a whole, so that
+     *  every peer computes the same beats along it without further commits.
+     *  With the linear curve the tempo changes by the same amount on every
+     *  beat, with the exponential one by the same factor. beatAtTime,
+     *  phaseAtTime, timeAtBeat and beat cursors follow the ramp. A
+     *  non-positive length sets endBpm at startTime.
+     */
+    void setTempoRamp(double startBpm,
+      double endBpm,
+      std::chrono::microseconds startTime,
+      double lengthInBeats,
+      TempoCurve curve);
+
+    /*! @brief: The tempo at the given time, which differs from tempo()
+     *  before the end of a tempo ramp.
+     */
+    double tempoAtTime(std::chrono::microseconds time) const;
+
     /*! @brief: Get the beat value corresponding to the given time
      *  for the given quantum.
      *
@@ -288,6 +913,59 @@ public:
      */
     std::chrono::microseconds timeAtBeat(double beat, double quantum) const;
 
+    /*! @brief: Evaluate beatAtTime and phaseAtTime for a sequence of
+     *  equidistant times, such as the samples of an audio buffer.
+     *
+     *  @discussion: The i-th entry corresponds to the time
+     *  beginTime + round(i * microsPerSample) and is identical to the
+     *  result of the per-sample methods at that time. The timeline is
+     *  only evaluated once per call, which makes this considerably
+     *  cheaper than calling beatAtTime and phaseAtTime for every sample.
+     *
+     *  pBeats and pPhases must be null or point to at least numSamples
+     *  values. If pPhaseWraps is not null, it must point to at least
+     *  numSamples values and receives the indices of the samples at which
+     *  the phase is lower than at the preceding sample time, i.e. at which
+     *  a quantum boundary has been crossed. The preceding sample time of
+     *  the first sample is beginTime - round(microsPerSample). Returns the
+     *  number of phase wraps.
+     */
+    std::size_t beatsAndPhasesAtTimes(std::chrono::microseconds beginTime,
+      double microsPerSample,
+      std::size_t numSamples,
+      double quantum,
+      double* pBeats,
+      double* pPhases,
+      std::size_t* pPhaseWraps) const;
+
+    /*! @brief: Create a cursor that follows beatAtTime and phaseAtTime
+     *  from the given time on, sample by sample.
+     *
+     *  @discussion: The cursor is advanced by a number of samples at the
+     *  given sample rate, e.g. once per rendered block, and reports its
+     *  beats() and phase() with a multiply-add instead of evaluating the
+     *  timeline. Its values deviate from those of beatAtTime and
+     *  phaseAtTime at the rounded cursor time() by less than a millionth of
+     *  a beat plus the beats of half a microsecond. During a tempo ramp,
+     *  the cursor takes up the ramp again with every advance and moves on
+     *  with the tempo at that point in between. The cursor keeps following
+     *  this Session State's timeline and ramp until it is passed to
+     *  syncBeatCursor.
+     */
+    BeatCursor beatCursorAtTime(
+      std::chrono::microseconds time, double sampleRate, double quantum) const;
+
+    /*! @brief: Make the given cursor follow the timeline of this Session
+     *  State from its current position on.
+     *
+     *  @discussion: Intended to be called with every newly captured
+     *  Session State. If neither the timeline nor the tempo ramp has
+     *  changed, this does nothing and returns false. Otherwise the cursor
+     *  continues from its current time with the beats of the new timeline
+     *  and true is returned.
+     */
+    bool syncBeatCursor(BeatCursor& cursor) const;
+
     /*! @brief: Attempt to map the given beat to the given time in the
      *  context of the given quantum.
      *
@@ -365,10 +1043,21 @@ public:
       bool isPlaying, std::chrono::microseconds time, double beat, double quantum);
 
   private:
-    friend BasicLink<Clock>;
+    friend BasicLink<Clock, IoContext>;
+    // The parts of mState that the modifiers have touched. Only those are compared
+    // with mOriginalState on commit, and nothing at all if none was touched.
+    enum Modification : std::uint8_t
+    {
+      kTimelineModified = 1,
+      kStartStopStateModified = 2
+    };
+
     link::ApiState mOriginalState;
     link::ApiState mState;
+    // mState.timeline prepared for the queries, kept in sync on modification
+    link::CompiledTimeline mTimeline;
     bool mbRespectQuantum;
+    std::uint8_t mModifications;
   };
 
 private:
@@ -377,16 +1066,42 @@ private:
     link::StartStopStateCallback,
     Clock,
     link::platform::Random,
-    link::platform::IoContext>;
+    IoContext>;
+
+  void notifyNumPeers(std::size_t numPeers);
+  void notifyTempo(link::Tempo tempo);
+  void notifyIsPlaying(bool isPlaying);
+  void notifyCallbackDelivery();
+  bool takeCallbacks();
 
-  std::mutex mCallbackMutex;
-  link::PeerCountCallback mPeerCountCallback = [](std::size_t) {};
-  link::TempoCallback mTempoCallback = [](link::Tempo) {};
-  link::StartStopStateCallback mStartStopCallback = [](bool) {};
+  mutable std::mutex mTakeCallbacksMutex;
+  // Guarded by mTakeCallbacksMutex
+  link::RateLimiter<link::Tempo> mTempoCallbackLimiter;
+  link::AtomicCallback<link::PeerCountCallback> mPeerCountCallback{
+    [](std::size_t) {}};
+  link::AtomicCallback<link::TempoCallback> mTempoCallback{[](link::Tempo) {}};
+  link::AtomicCallback<link::StartStopStateCallback> mStartStopCallback{[](bool) {}};
+  std::atomic<CallbackDelivery> mCallbackDelivery;
+  link::CallbackMailbox mCallbackMailbox;
+  // Read by takeCallbacks, so it must outlive the thread of mCallbackNotifier
   Clock mClock;
+  link::CallbackNotifier mCallbackNotifier;
   Controller mController;
+  // Audio thread only
+  bool mIsFreewheeling;
+  link::ApiState mFreewheelState;
+  bool mbFreewheelRespectsQuantum;
 };
 
+#if defined(LINK_COMPILED)
+// Link and SharedLink are instantiated once in the Ableton::LinkCompiled library, so
+// that the translation units that use them only compile the member templates and the
+// members that are defined in the class. BasicLink with other clocks or io contexts
+// is still instantiated where it's used.
+extern template class BasicLink<link::platform::Clock>;
+extern template class BasicLink<link::platform::Clock, link::platform::SharedIoContext>;
+#endif
+
 class Link : public BasicLink<link::platform::Clock>
 {
 public:
@@ -396,6 +1111,23 @@ public:
     : BasicLink(bpm)
   {
   }
+
+  Link(double bpm, ::asio::io_service& ioService)
+    : BasicLink(bpm, ioService)
+  {
+  }
+};
+
+class SharedLink
+  : public BasicLink<link::platform::Clock, link::platform::SharedIoContext>
+{
+public:
+  using Clock = link::platform::Clock;
+
+  SharedLink(double bpm)
+    : BasicLink(bpm)
+  {
+  }
 };
 
 } // namespace ableton
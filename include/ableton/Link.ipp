@@ -26,193 +26,748 @@ namespace ableton
 namespace detail
 {
 
-template <typename Clock>
-inline typename BasicLink<Clock>::SessionState toSessionState(
+template <typename Clock, typename IoContext>
+inline typename BasicLink<Clock, IoContext>::SessionState toSessionState(
   const link::ClientState& state, const bool isConnected)
 {
-  return {{state.timeline, {state.startStopState.isPlaying, state.startStopState.time}},
+  return {{state.timeline, {state.startStopState.isPlaying, state.startStopState.time},
+            state.tempoRamp},
     isConnected};
 }
 
+// Only the parts that have been modified are compared
 inline link::IncomingClientState toIncomingClientState(const link::ApiState& state,
   const link::ApiState& originalState,
+  const bool timelineModified,
+  const bool startStopStateModified,
   const std::chrono::microseconds timestamp)
 {
-  const auto timeline = originalState.timeline != state.timeline
+  const auto timeline = timelineModified
+                            && (originalState.timeline != state.timeline
+                                || originalState.tempoRamp != state.tempoRamp)
                           ? link::OptionalTimeline{state.timeline}
                           : link::OptionalTimeline{};
   const auto startStopState =
-    originalState.startStopState != state.startStopState
+    startStopStateModified && originalState.startStopState != state.startStopState
       ? link::OptionalClientStartStopState{{state.startStopState.isPlaying,
           state.startStopState.time, timestamp}}
       : link::OptionalClientStartStopState{};
-  return {timeline, startStopState, timestamp};
+  return {timeline, startStopState, timestamp, state.tempoRamp};
 }
 
 } // namespace detail
 
-template <typename Clock>
-inline BasicLink<Clock>::BasicLink(const double bpm)
-  : mController(link::Tempo(bpm),
-      [this](const std::size_t peers) {
-        std::lock_guard<std::mutex> lock(mCallbackMutex);
-        mPeerCountCallback(peers);
-      },
-      [this](const link::Tempo tempo) {
-        std::lock_guard<std::mutex> lock(mCallbackMutex);
-        mTempoCallback(tempo);
-      },
-      [this](const bool isPlaying) {
-        std::lock_guard<std::mutex> lock(mCallbackMutex);
-        mStartStopCallback(isPlaying);
-      },
+template <typename Clock, typename IoContext>
+BasicLink<Clock, IoContext>::BasicLink(const double bpm)
+  : mCallbackDelivery(CallbackDelivery::IoThread)
+  , mCallbackNotifier([this] { takeCallbacks(); })
+  , mController(link::Tempo(bpm),
+      [this](const std::size_t peers) { notifyNumPeers(peers); },
+      [this](const link::Tempo tempo) { notifyTempo(tempo); },
+      [this](const bool isPlaying) { notifyIsPlaying(isPlaying); },
       mClock)
+  , mIsFreewheeling(false)
+  , mbFreewheelRespectsQuantum(false)
+{
+}
+
+template <typename Clock, typename IoContext>
+BasicLink<Clock, IoContext>::BasicLink(const double bpm, ::asio::io_service& ioService)
+  : mCallbackDelivery(CallbackDelivery::IoThread)
+  , mCallbackNotifier([this] { takeCallbacks(); })
+  , mController(link::Tempo(bpm),
+      [this](const std::size_t peers) { notifyNumPeers(peers); },
+      [this](const link::Tempo tempo) { notifyTempo(tempo); },
+      [this](const bool isPlaying) { notifyIsPlaying(isPlaying); },
+      mClock,
+      ioService)
+  , mIsFreewheeling(false)
+  , mbFreewheelRespectsQuantum(false)
+{
+}
+
+template <typename Clock, typename IoContext>
+BasicLink<Clock, IoContext>::~BasicLink()
 {
 }
 
-template <typename Clock>
-inline bool BasicLink<Clock>::isEnabled() const
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::isEnabled() const
 {
   return mController.isEnabled();
 }
 
-template <typename Clock>
-inline void BasicLink<Clock>::enable(const bool bEnable)
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::enable(const bool bEnable)
 {
   mController.enable(bEnable);
 }
 
-template <typename Clock>
-inline bool BasicLink<Clock>::isStartStopSyncEnabled() const
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::suspend()
+{
+  mController.suspend();
+}
+
+template <typename Clock, typename IoContext>
+std::future<void> BasicLink<Clock, IoContext>::shutdown()
+{
+  return mController.shutdown();
+}
+
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::isStartStopSyncEnabled() const
 {
   return mController.isStartStopSyncEnabled();
 }
 
-template <typename Clock>
-inline void BasicLink<Clock>::enableStartStopSync(bool bEnable)
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::enableStartStopSync(bool bEnable)
 {
   mController.enableStartStopSync(bEnable);
 }
 
-template <typename Clock>
-inline std::size_t BasicLink<Clock>::numPeers() const
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::isAudioTimelineCommitQueueEnabled() const
+{
+  return mController.isRtTimelineCommitQueueEnabled();
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::enableAudioTimelineCommitQueue(bool bEnable)
+{
+  mController.enableRtTimelineCommitQueue(bEnable);
+}
+
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::isSessionEventQueueEnabled() const
+{
+  return mController.isSessionEventQueueEnabled();
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::enableSessionEventQueue(bool bEnable)
+{
+  mController.enableSessionEventQueue(bEnable);
+}
+
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::readSessionEvent(SessionEvent& event)
+{
+  LINK_RT_SAFE_SCOPE;
+  if (auto pendingEvent = mController.readSessionEventRtSafe())
+  {
+    event = *pendingEvent;
+    return true;
+  }
+  return false;
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::setThreadPolicy(ThreadPolicy policy)
+{
+  mController.setThreadPolicy(policy);
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::enableThreadPerInterface(const bool bEnable)
+{
+  mController.enableThreadPerInterface(bEnable);
+}
+
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::isThreadPerInterfaceEnabled() const
+{
+  return mController.isThreadPerInterfaceEnabled();
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::setPowerProfile(const PowerProfile profile)
+{
+  mController.setPowerProfile(profile);
+}
+
+template <typename Clock, typename IoContext>
+typename BasicLink<Clock, IoContext>::PowerProfile BasicLink<Clock,
+  IoContext>::powerProfile() const
+{
+  return mController.powerProfile();
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::setInterfaceFilter(InterfaceFilter filter)
+{
+  mController.setInterfaceFilter(std::move(filter));
+}
+
+template <typename Clock, typename IoContext>
+std::vector<::asio::ip::address> BasicLink<Clock, IoContext>::knownPeerAddresses() const
+{
+  return mController.knownPeerAddresses();
+}
+
+template <typename Clock, typename IoContext>
+std::shared_ptr<const typename BasicLink<Clock, IoContext>::PeerList> BasicLink<Clock,
+  IoContext>::peerList() const
+{
+  return mController.peerList();
+}
+
+template <typename Clock, typename IoContext>
+std::shared_ptr<const typename BasicLink<Clock, IoContext>::SessionList> BasicLink<Clock,
+  IoContext>::sessionList() const
+{
+  return mController.sessionList();
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::setMaxMeasuredOtherSessions(
+  const std::size_t maxMeasured)
+{
+  mController.setMaxMeasuredOtherSessions(maxMeasured);
+}
+
+template <typename Clock, typename IoContext>
+std::size_t BasicLink<Clock, IoContext>::maxMeasuredOtherSessions() const
+{
+  return mController.maxMeasuredOtherSessions();
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::setKnownPeerAddresses(
+  std::vector<::asio::ip::address> addresses)
+{
+  mController.setKnownPeerAddresses(std::move(addresses));
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::setUnicastPeers(
+  std::vector<::asio::ip::udp::endpoint> peers)
+{
+  mController.setUnicastPeers(std::move(peers));
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::setSessionGroup(const std::uint16_t groupId)
+{
+  mController.setSessionGroup(groupId);
+}
+
+template <typename Clock, typename IoContext>
+std::uint16_t BasicLink<Clock, IoContext>::sessionGroup() const
+{
+  return mController.sessionGroup();
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::enableObserverMode(const bool bEnable)
+{
+  mController.enableObserverMode(bEnable);
+}
+
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::isObserverModeEnabled() const
+{
+  return mController.isObserverModeEnabled();
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::enableClockSlewing(const bool bEnable)
+{
+  mController.enableClockSlewing(bEnable);
+}
+
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::isClockSlewingEnabled() const
+{
+  return mController.isClockSlewingEnabled();
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::setMaxDiscoveryHubs(const std::size_t maxHubs)
+{
+  mController.setMaxDiscoveryHubs(maxHubs);
+}
+
+template <typename Clock, typename IoContext>
+std::size_t BasicLink<Clock, IoContext>::maxDiscoveryHubs() const
+{
+  return mController.maxDiscoveryHubs();
+}
+
+template <typename Clock, typename IoContext>
+typename BasicLink<Clock, IoContext>::Stats BasicLink<Clock, IoContext>::stats() const
+{
+  return mController.stats();
+}
+
+template <typename Clock, typename IoContext>
+typename BasicLink<Clock, IoContext>::SyncQuality BasicLink<Clock,
+  IoContext>::syncQuality() const
+{
+  return mController.syncQuality();
+}
+
+template <typename Clock, typename IoContext>
+std::size_t BasicLink<Clock, IoContext>::numPeers() const
 {
   return mController.numPeers();
 }
 
-template <typename Clock>
+template <typename Clock, typename IoContext>
 template <typename Callback>
-void BasicLink<Clock>::setNumPeersCallback(Callback callback)
+void BasicLink<Clock, IoContext>::setNumPeersCallback(Callback callback)
 {
-  std::lock_guard<std::mutex> lock(mCallbackMutex);
-  mPeerCountCallback = [callback](const std::size_t numPeers) { callback(numPeers); };
+  mPeerCountCallback.set(
+    [callback](const std::size_t numPeers) { callback(numPeers); });
 }
 
-template <typename Clock>
+template <typename Clock, typename IoContext>
 template <typename Callback>
-void BasicLink<Clock>::setTempoCallback(Callback callback)
+void BasicLink<Clock, IoContext>::setTempoCallback(Callback callback)
 {
-  std::lock_guard<std::mutex> lock(mCallbackMutex);
-  mTempoCallback = [callback](const link::Tempo tempo) { callback(tempo.bpm()); };
+  mTempoCallback.set([callback](const link::Tempo tempo) { callback(tempo.bpm()); });
 }
 
-template <typename Clock>
+template <typename Clock, typename IoContext>
 template <typename Callback>
-void BasicLink<Clock>::setStartStopCallback(Callback callback)
+void BasicLink<Clock, IoContext>::setStartStopCallback(Callback callback)
+{
+  mStartStopCallback.set(callback);
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::setCallbackDelivery(const CallbackDelivery delivery)
+{
+  if (delivery == CallbackDelivery::NotifierThread)
+  {
+    mCallbackNotifier.start();
+  }
+  mCallbackDelivery = delivery;
+  takeCallbacks();
+}
+
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::processCallbacks()
+{
+  return takeCallbacks();
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::setTempoCallbackMinInterval(
+  const std::chrono::microseconds interval)
+{
+  {
+    std::lock_guard<std::mutex> lock(mTakeCallbacksMutex);
+    mTempoCallbackLimiter.setMinInterval(interval);
+  }
+  notifyCallbackDelivery();
+}
+
+template <typename Clock, typename IoContext>
+std::chrono::microseconds BasicLink<Clock, IoContext>::tempoCallbackMinInterval() const
 {
-  std::lock_guard<std::mutex> lock(mCallbackMutex);
-  mStartStopCallback = callback;
+  std::lock_guard<std::mutex> lock(mTakeCallbacksMutex);
+  return mTempoCallbackLimiter.minInterval();
 }
 
-template <typename Clock>
-inline Clock BasicLink<Clock>::clock() const
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::notifyNumPeers(const std::size_t numPeers)
+{
+  if (mCallbackDelivery == CallbackDelivery::IoThread)
+  {
+    mPeerCountCallback(numPeers);
+  }
+  else
+  {
+    mCallbackMailbox.postNumPeers(numPeers);
+    notifyCallbackDelivery();
+  }
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::notifyTempo(const link::Tempo tempo)
+{
+  if (mCallbackDelivery == CallbackDelivery::IoThread)
+  {
+    mTempoCallback(tempo);
+  }
+  else
+  {
+    mCallbackMailbox.postTempo(tempo);
+    notifyCallbackDelivery();
+  }
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::notifyIsPlaying(const bool isPlaying)
+{
+  if (mCallbackDelivery == CallbackDelivery::IoThread)
+  {
+    mStartStopCallback(isPlaying);
+  }
+  else
+  {
+    mCallbackMailbox.postIsPlaying(isPlaying);
+    notifyCallbackDelivery();
+  }
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::notifyCallbackDelivery()
+{
+  if (mCallbackDelivery == CallbackDelivery::NotifierThread)
+  {
+    mCallbackNotifier.notify();
+  }
+}
+
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::takeCallbacks()
+{
+  // The mailbox must not be emptied by several threads at once
+  std::lock_guard<std::mutex> lock(mTakeCallbacksMutex);
+  const auto now = mClock.micros();
+  const auto didTake = mCallbackMailbox.take(
+    [this](const std::size_t numPeers) { mPeerCountCallback(numPeers); },
+    [this, now](const link::Tempo tempo) {
+      if (mTempoCallbackLimiter.offer(tempo, now))
+      {
+        mTempoCallback(tempo);
+      }
+    },
+    [this](const bool isPlaying) { mStartStopCallback(isPlaying); });
+
+  auto heldTempo = link::Tempo{};
+  const auto didTakeHeld = mTempoCallbackLimiter.takeDue(now, heldTempo);
+  if (didTakeHeld)
+  {
+    mTempoCallback(heldTempo);
+  }
+  if (mTempoCallbackLimiter.hasHeld()
+      && mCallbackDelivery == CallbackDelivery::NotifierThread)
+  {
+    mCallbackNotifier.notifyAfter(mTempoCallbackLimiter.dueTime() - now);
+  }
+  return didTake || didTakeHeld;
+}
+
+template <typename Clock, typename IoContext>
+Clock BasicLink<Clock, IoContext>::clock() const
 {
   return mClock;
 }
 
-template <typename Clock>
-inline typename BasicLink<Clock>::SessionState BasicLink<
-  Clock>::captureAudioSessionState() const
+template <typename Clock, typename IoContext>
+typename BasicLink<Clock, IoContext>::SessionState BasicLink<Clock,
+  IoContext>::captureAudioSessionState() const
+{
+  LINK_RT_SAFE_SCOPE;
+  if (mIsFreewheeling)
+  {
+    return {mFreewheelState, mbFreewheelRespectsQuantum};
+  }
+  return detail::toSessionState<Clock, IoContext>(
+    mController.clientStateRtSafe(), numPeers() > 0);
+}
+
+template <typename Clock, typename IoContext>
+typename BasicLink<Clock, IoContext>::SessionState BasicLink<Clock,
+  IoContext>::captureAudioSessionStateAt(const std::chrono::microseconds time) const
+{
+  LINK_RT_SAFE_SCOPE;
+  if (mIsFreewheeling)
+  {
+    return {mFreewheelState, mbFreewheelRespectsQuantum};
+  }
+  return detail::toSessionState<Clock, IoContext>(
+    mController.clientStateRtSafeAt(time), numPeers() > 0);
+}
+
+template <typename Clock, typename IoContext>
+typename BasicLink<Clock, IoContext>::SessionState BasicLink<Clock,
+  IoContext>::captureSharedAudioSessionState() const
+{
+  LINK_RT_SAFE_SCOPE;
+  return detail::toSessionState<Clock, IoContext>(
+    mController.clientStateRtShared(), numPeers() > 0);
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::commitAudioSessionState(
+  const typename BasicLink<Clock, IoContext>::SessionState state)
+{
+  LINK_RT_SAFE_SCOPE;
+  if (mIsFreewheeling)
+  {
+    mFreewheelState = state.mState;
+    return;
+  }
+  if (state.mModifications == 0)
+  {
+    return;
+  }
+  mController.setClientStateRtSafe(detail::toIncomingClientState(state.mState,
+    state.mOriginalState, (state.mModifications & SessionState::kTimelineModified) != 0,
+    (state.mModifications & SessionState::kStartStopStateModified) != 0,
+    mClock.micros()));
+}
+
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::commitSharedAudioSessionState(
+  const typename BasicLink<Clock, IoContext>::SessionState state)
 {
-  return detail::toSessionState<Clock>(mController.clientStateRtSafe(), numPeers() > 0);
+  LINK_RT_SAFE_SCOPE;
+  if (state.mModifications == 0)
+  {
+    return true;
+  }
+  return mController.setClientStateRtShared(detail::toIncomingClientState(state.mState,
+    state.mOriginalState, (state.mModifications & SessionState::kTimelineModified) != 0,
+    (state.mModifications & SessionState::kStartStopStateModified) != 0,
+    mClock.micros()));
 }
 
-template <typename Clock>
-inline void BasicLink<Clock>::commitAudioSessionState(
-  const typename BasicLink<Clock>::SessionState state)
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::beginAudioBlock()
 {
-  mController.setClientStateRtSafe(
-    detail::toIncomingClientState(state.mState, state.mOriginalState, mClock.micros()));
+  LINK_RT_SAFE_SCOPE;
+  mController.beginRtBlock();
 }
 
-template <typename Clock>
-inline typename BasicLink<Clock>::SessionState BasicLink<Clock>::captureAppSessionState()
-  const
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::endAudioBlock()
 {
-  return detail::toSessionState<Clock>(mController.clientState(), numPeers() > 0);
+  LINK_RT_SAFE_SCOPE;
+  mController.endRtBlock();
 }
 
-template <typename Clock>
-inline void BasicLink<Clock>::commitAppSessionState(
-  const typename BasicLink<Clock>::SessionState state)
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::isFreewheelEnabled() const
 {
-  mController.setClientState(
-    detail::toIncomingClientState(state.mState, state.mOriginalState, mClock.micros()));
+  return mIsFreewheeling;
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::enableFreewheel(const bool bEnable)
+{
+  if (bEnable && !mIsFreewheeling)
+  {
+    const auto state = captureAudioSessionState();
+    mFreewheelState = state.mState;
+    mbFreewheelRespectsQuantum = state.mbRespectQuantum;
+  }
+  mIsFreewheeling = bEnable;
+}
+
+template <typename Clock, typename IoContext>
+typename BasicLink<Clock, IoContext>::SessionState BasicLink<Clock,
+  IoContext>::captureAppSessionState() const
+{
+  return detail::toSessionState<Clock, IoContext>(
+    mController.clientState(), numPeers() > 0);
+}
+
+template <typename Clock, typename IoContext>
+std::uint64_t BasicLink<Clock, IoContext>::appSessionStateVersion() const
+{
+  return mController.clientStateVersion();
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::commitAppSessionState(
+  const typename BasicLink<Clock, IoContext>::SessionState state)
+{
+  if (state.mModifications == 0)
+  {
+    return;
+  }
+  mController.setClientState(detail::toIncomingClientState(state.mState,
+    state.mOriginalState, (state.mModifications & SessionState::kTimelineModified) != 0,
+    (state.mModifications & SessionState::kStartStopStateModified) != 0,
+    mClock.micros()));
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::scheduleTempo(
+  const double bpm, const std::chrono::microseconds atTime)
+{
+  // Like SessionState::setTempo, the client timeline keeps its beat origin
+  const auto timeline = mController.clientState().timeline;
+  const auto desiredTl =
+    link::clampTempo(link::Timeline{link::Tempo(bpm), timeline.toBeats(atTime), atTime});
+  mController.scheduleClientTimeline(
+    {desiredTl.tempo, timeline.beatOrigin, desiredTl.fromBeats(timeline.beatOrigin)},
+    atTime);
 }
 
 // Link::SessionState
 
-template <typename Clock>
-inline BasicLink<Clock>::SessionState::SessionState(
+template <typename Clock, typename IoContext>
+BasicLink<Clock, IoContext>::SessionState::SessionState(
   const link::ApiState state, const bool bRespectQuantum)
   : mOriginalState(state)
   , mState(state)
+  , mTimeline(state.timeline)
   , mbRespectQuantum(bRespectQuantum)
+  , mModifications(0)
 {
 }
 
-template <typename Clock>
-inline double BasicLink<Clock>::SessionState::tempo() const
+template <typename Clock, typename IoContext>
+double BasicLink<Clock, IoContext>::SessionState::tempo() const
 {
   return mState.timeline.tempo.bpm();
 }
 
-template <typename Clock>
-inline void BasicLink<Clock>::SessionState::setTempo(
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::SessionState::setTempo(
   const double bpm, const std::chrono::microseconds atTime)
 {
-  const auto desiredTl = link::clampTempo(
-    link::Timeline{link::Tempo(bpm), mState.timeline.toBeats(atTime), atTime});
+  const auto beat = link::rampedTimeline(mTimeline, mState.tempoRamp).toBeats(atTime);
+  const auto desiredTl =
+    link::clampTempo(link::Timeline{link::Tempo(bpm), beat, atTime});
   mState.timeline.tempo = desiredTl.tempo;
   mState.timeline.timeOrigin = desiredTl.fromBeats(mState.timeline.beatOrigin);
+  mState.tempoRamp = {};
+  mTimeline = link::CompiledTimeline{mState.timeline};
+  mModifications |= kTimelineModified;
+}
+
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::SessionState::setTempoRamp(const double startBpm,
+  const double endBpm,
+  const std::chrono::microseconds startTime,
+  const double lengthInBeats,
+  const TempoCurve curve)
+{
+  if (!(lengthInBeats > 0.))
+  {
+    setTempo(endBpm, startTime);
+    return;
+  }
+
+  const auto beat =
+    link::rampedTimeline(mTimeline, mState.tempoRamp).toBeats(startTime);
+  const auto ramp = link::TempoRamp{
+    link::clampTempo(link::Timeline{link::Tempo(startBpm), beat, startTime}),
+    link::clampTempo(link::Timeline{link::Tempo(endBpm), beat, startTime}).tempo,
+    link::Beats{lengthInBeats}, curve};
+  // Like setTempo, the timeline that the ramp leads to keeps the beat origin
+  const auto endTl = ramp.endTimeline();
+  mState.timeline.tempo = endTl.tempo;
+  mState.timeline.timeOrigin = endTl.fromBeats(mState.timeline.beatOrigin);
+  mState.tempoRamp = ramp;
+  mTimeline = link::CompiledTimeline{mState.timeline};
+  mModifications |= kTimelineModified;
+}
+
+template <typename Clock, typename IoContext>
+double BasicLink<Clock, IoContext>::SessionState::tempoAtTime(
+  const std::chrono::microseconds time) const
+{
+  return mState.tempoRamp.isRamping() && time < mState.tempoRamp.endTime()
+           ? mState.tempoRamp.tempoAtTime(time).bpm()
+           : tempo();
 }
 
-template <typename Clock>
-inline double BasicLink<Clock>::SessionState::beatAtTime(
+template <typename Clock, typename IoContext>
+double BasicLink<Clock, IoContext>::SessionState::beatAtTime(
   const std::chrono::microseconds time, const double quantum) const
 {
-  return link::toPhaseEncodedBeats(mState.timeline, time, link::Beats{quantum})
+  return link::toPhaseEncodedBeats(
+    link::rampedTimeline(mTimeline, mState.tempoRamp), time, link::Beats{quantum})
     .floating();
 }
 
-template <typename Clock>
-inline double BasicLink<Clock>::SessionState::phaseAtTime(
+template <typename Clock, typename IoContext>
+double BasicLink<Clock, IoContext>::SessionState::phaseAtTime(
   const std::chrono::microseconds time, const double quantum) const
 {
   return link::phase(link::Beats{beatAtTime(time, quantum)}, link::Beats{quantum})
     .floating();
 }
 
-template <typename Clock>
-inline std::chrono::microseconds BasicLink<Clock>::SessionState::timeAtBeat(
+template <typename Clock, typename IoContext>
+std::chrono::microseconds BasicLink<Clock, IoContext>::SessionState::timeAtBeat(
   const double beat, const double quantum) const
 {
-  return link::fromPhaseEncodedBeats(
-    mState.timeline, link::Beats{beat}, link::Beats{quantum});
+  return link::fromPhaseEncodedBeats(link::rampedTimeline(mTimeline, mState.tempoRamp),
+    link::Beats{beat}, link::Beats{quantum});
+}
+
+template <typename Clock, typename IoContext>
+std::size_t BasicLink<Clock, IoContext>::SessionState::beatsAndPhasesAtTimes(
+  const std::chrono::microseconds beginTime,
+  const double microsPerSample,
+  const std::size_t numSamples,
+  const double quantum,
+  double* const pBeats,
+  double* const pPhases,
+  std::size_t* const pPhaseWraps) const
+{
+  using namespace std::chrono;
+
+  // The phase encoding reduces to a constant offset, see phaseEncodingOffset
+  const auto q = link::Beats{quantum};
+  const auto timeline = link::rampedTimeline(mTimeline, mState.tempoRamp);
+  const auto offset = link::phaseEncodingOffset(timeline, q);
+  const auto microBeatsAtTime = [&](const microseconds time) {
+    return (timeline.toBeats(time) + offset).microBeats();
+  };
+  const auto phaseOf = [&q](const std::int64_t microBeats) {
+    return link::phase(link::Beats{microBeats}, q).microBeats();
+  };
+
+  auto lastPhase =
+    phaseOf(microBeatsAtTime(beginTime - microseconds{std::llround(microsPerSample)}));
+  std::size_t numPhaseWraps = 0;
+  for (std::size_t i = 0; i < numSamples; ++i)
+  {
+    const auto time =
+      beginTime + microseconds{std::llround(static_cast<double>(i) * microsPerSample)};
+    const auto microBeats = microBeatsAtTime(time);
+    const auto phase = phaseOf(microBeats);
+
+    if (pBeats)
+    {
+      pBeats[i] = static_cast<double>(microBeats) / 1e6;
+    }
+    if (pPhases)
+    {
+      pPhases[i] = static_cast<double>(phase) / 1e6;
+    }
+    if (phase < lastPhase)
+    {
+      if (pPhaseWraps)
+      {
+        pPhaseWraps[numPhaseWraps] = i;
+      }
+      ++numPhaseWraps;
+    }
+    lastPhase = phase;
+  }
+  return numPhaseWraps;
+}
+
+template <typename Clock, typename IoContext>
+typename BasicLink<Clock, IoContext>::BeatCursor BasicLink<Clock,
+  IoContext>::SessionState::beatCursorAtTime(const std::chrono::microseconds time,
+  const double sampleRate,
+  const double quantum) const
+{
+  return BeatCursor{
+    mState.timeline, mState.tempoRamp, time, sampleRate, link::Beats{quantum}};
+}
+
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::SessionState::syncBeatCursor(BeatCursor& cursor) const
+{
+  return cursor.sync(mState.timeline, mState.tempoRamp);
 }
 
-template <typename Clock>
-inline void BasicLink<Clock>::SessionState::requestBeatAtTime(
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::SessionState::requestBeatAtTime(
   const double beat, std::chrono::microseconds time, const double quantum)
 {
   if (mbRespectQuantum)
@@ -225,8 +780,8 @@ inline void BasicLink<Clock>::SessionState::requestBeatAtTime(
   forceBeatAtTime(beat, time, quantum);
 }
 
-template <typename Clock>
-inline void BasicLink<Clock>::SessionState::forceBeatAtTime(
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::SessionState::forceBeatAtTime(
   const double beat, const std::chrono::microseconds time, const double quantum)
 {
   // There are two components to the beat adjustment: a phase shift
@@ -238,29 +793,36 @@ inline void BasicLink<Clock>::SessionState::forceBeatAtTime(
   // Now adjust the magnitude
   mState.timeline.beatOrigin =
     mState.timeline.beatOrigin + (link::Beats{beat} - closestInPhase);
+  // The ramp is shifted along with the timeline it leads to
+  mState.tempoRamp.timeline.beatOrigin =
+    mState.tempoRamp.timeline.beatOrigin + (link::Beats{beat} - curBeatAtTime);
+  mTimeline = link::CompiledTimeline{mState.timeline};
+  mModifications |= kTimelineModified;
 }
 
-template <typename Clock>
-inline void BasicLink<Clock>::SessionState::setIsPlaying(
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::SessionState::setIsPlaying(
   const bool isPlaying, const std::chrono::microseconds time)
 {
   mState.startStopState = {isPlaying, time};
+  mModifications |= kStartStopStateModified;
 }
 
-template <typename Clock>
-inline bool BasicLink<Clock>::SessionState::isPlaying() const
+template <typename Clock, typename IoContext>
+bool BasicLink<Clock, IoContext>::SessionState::isPlaying() const
 {
   return mState.startStopState.isPlaying;
 }
 
-template <typename Clock>
-inline std::chrono::microseconds BasicLink<Clock>::SessionState::timeForIsPlaying() const
+template <typename Clock, typename IoContext>
+std::chrono::microseconds BasicLink<Clock,
+  IoContext>::SessionState::timeForIsPlaying() const
 {
   return mState.startStopState.time;
 }
 
-template <typename Clock>
-inline void BasicLink<Clock>::SessionState::requestBeatAtStartPlayingTime(
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::SessionState::requestBeatAtStartPlayingTime(
   const double beat, const double quantum)
 {
   if (isPlaying())
@@ -269,11 +831,12 @@ inline void BasicLink<Clock>::SessionState::requestBeatAtStartPlayingTime(
   }
 }
 
-template <typename Clock>
-inline void BasicLink<Clock>::SessionState::setIsPlayingAndRequestBeatAtTime(
+template <typename Clock, typename IoContext>
+void BasicLink<Clock, IoContext>::SessionState::setIsPlayingAndRequestBeatAtTime(
   bool isPlaying, std::chrono::microseconds time, double beat, double quantum)
 {
   mState.startStopState = {isPlaying, time};
+  mModifications |= kStartStopStateModified;
   requestBeatAtStartPlayingTime(beat, quantum);
 }
 
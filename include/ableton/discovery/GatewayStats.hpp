@@ -0,0 +1,93 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace ableton
+{
+namespace discovery
+{
+
+// Counters for the traffic of a gateway, shared by the components that send
+// and receive on its interface. They are updated on the io threads and may be
+// read from any thread.
+struct GatewayStats
+{
+  GatewayStats()
+    : packetsSent(0)
+    , packetsReceived(0)
+    , parseFailures(0)
+    , sendFailures(0)
+    , handlerNanos(0)
+  {
+  }
+
+  GatewayStats(const GatewayStats&) = delete;
+  GatewayStats& operator=(const GatewayStats&) = delete;
+
+  static void increment(std::atomic<std::uint64_t>& counter, const std::uint64_t n = 1)
+  {
+    counter.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  std::atomic<std::uint64_t> packetsSent;
+  std::atomic<std::uint64_t> packetsReceived;
+  // Packets that were received but are malformed or of an unexpected type
+  std::atomic<std::uint64_t> parseFailures;
+  // Packets that couldn't be sent because of an error of the interface
+  std::atomic<std::uint64_t> sendFailures;
+  // Time spent handling the received packets
+  std::atomic<std::uint64_t> handlerNanos;
+};
+
+// Counts a received packet and adds the time until the end of the scope to
+// the handler time
+class ScopedPacketHandler
+{
+public:
+  ScopedPacketHandler(GatewayStats& stats)
+    : mStats(stats)
+    , mBegin(std::chrono::steady_clock::now())
+  {
+    GatewayStats::increment(mStats.packetsReceived);
+  }
+
+  ScopedPacketHandler(const ScopedPacketHandler&) = delete;
+  ScopedPacketHandler& operator=(const ScopedPacketHandler&) = delete;
+
+  ~ScopedPacketHandler()
+  {
+    using namespace std::chrono;
+    GatewayStats::increment(mStats.handlerNanos,
+      static_cast<std::uint64_t>(
+        duration_cast<nanoseconds>(steady_clock::now() - mBegin).count()));
+  }
+
+private:
+  GatewayStats& mStats;
+  std::chrono::steady_clock::time_point mBegin;
+};
+
+} // namespace discovery
+} // namespace ableton
@@ -0,0 +1,105 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/discovery/NetworkInterface.hpp>
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ableton
+{
+namespace discovery
+{
+
+struct Subnet
+{
+  bool contains(const asio::ip::address& addr) const
+  {
+    if (!addr.is_v4())
+    {
+      return false;
+    }
+    const auto mask = prefixLength == 0
+                        ? std::uint32_t{0}
+                        : ~std::uint32_t{0} << (32 - std::min(prefixLength, 32u));
+    return (addr.to_v4().to_ulong() & mask) == (address.to_ulong() & mask);
+  }
+
+  asio::ip::address_v4 address;
+  unsigned prefixLength;
+};
+
+// Selects the network interfaces that peer gateways are created on. An interface
+// is used if it matches none of the denied rules and, unless there are no allowed
+// rules at all, at least one of the allowed rules. Names match exactly or, if the
+// pattern ends with '*', by prefix.
+struct InterfaceFilter
+{
+  struct Rules
+  {
+    bool empty() const
+    {
+      return names.empty() && subnets.empty() && types.empty();
+    }
+
+    bool matches(const NetworkInterface& networkInterface) const
+    {
+      using namespace std;
+      return any_of(begin(names), end(names),
+               [&networkInterface](const string& pattern) {
+                 return matchesName(pattern, networkInterface.name);
+               })
+             || any_of(begin(subnets), end(subnets),
+               [&networkInterface](const Subnet& subnet) {
+                 return subnet.contains(networkInterface.address);
+               })
+             || find(begin(types), end(types), networkInterface.type) != end(types);
+    }
+
+    std::vector<std::string> names;
+    std::vector<Subnet> subnets;
+    std::vector<InterfaceType> types;
+
+  private:
+    static bool matchesName(const std::string& pattern, const std::string& name)
+    {
+      if (!pattern.empty() && pattern.back() == '*')
+      {
+        return name.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0;
+      }
+      return pattern == name;
+    }
+  };
+
+  bool operator()(const NetworkInterface& networkInterface) const
+  {
+    return !denied.matches(networkInterface)
+           && (allowed.empty() || allowed.matches(networkInterface));
+  }
+
+  Rules allowed;
+  Rules denied;
+};
+
+} // namespace discovery
+} // namespace ableton
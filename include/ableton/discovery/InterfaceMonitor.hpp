@@ -0,0 +1,43 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+namespace ableton
+{
+namespace discovery
+{
+
+// An io context reports changes of the network interfaces through the monitor
+// returned by its makeInterfaceMonitor(handler). For as long as the monitor exists,
+// the handler is called on the io thread whenever the interfaces may have changed.
+// A monitor that isn't active doesn't report anything, so that the interfaces have
+// to be polled instead.
+//
+// NullInterfaceMonitor is used by io contexts that don't support monitoring.
+struct NullInterfaceMonitor
+{
+  bool isActive() const
+  {
+    return false;
+  }
+};
+
+} // namespace discovery
+} // namespace ableton
@@ -19,9 +19,13 @@
 
 #pragma once
 
+#include <ableton/discovery/InterfaceFilter.hpp>
+#include <ableton/discovery/InterfaceMonitor.hpp>
 #include <ableton/platforms/asio/AsioWrapper.hpp>
 #include <ableton/util/Injected.hpp>
+#include <ableton/util/Log.hpp>
 #include <chrono>
+#include <memory>
 #include <vector>
 
 namespace ableton
@@ -30,12 +34,17 @@ namespace discovery
 {
 
 // Callback takes a range of asio::ip:address which is
-// guaranteed to be sorted and unique
+// guaranteed to be sorted and unique. Only the addresses of the interfaces that
+// pass the filter are included.
+//
+// If the io context has an active interface monitor, the interfaces are rescanned
+// when the monitor reports a change instead of periodically.
 template <typename Callback, typename IoContext>
 class InterfaceScanner
 {
 public:
   using Timer = typename util::Injected<IoContext>::type::Timer;
+  using InterfaceMonitor = typename util::Injected<IoContext>::type::InterfaceMonitor;
 
   InterfaceScanner(const std::chrono::seconds period,
     util::Injected<Callback> callback,
@@ -44,34 +53,90 @@ public:
     , mCallback(std::move(callback))
     , mIo(std::move(io))
     , mTimer(mIo->makeTimer())
+    , mIsScanPending(false)
   {
   }
 
   void enable(const bool bEnable)
   {
+    mIsScanPending = false;
     if (bEnable)
     {
+      mpMonitor.reset(new InterfaceMonitor(
+        mIo->makeInterfaceMonitor([this] { onInterfacesChanged(); })));
       scan();
     }
     else
     {
       mTimer.cancel();
+      mpMonitor.reset();
+    }
+  }
+
+  // Rescans immediately if enabled, so that gateways on interfaces that are no
+  // longer accepted are removed and those that are now accepted are added
+  void setFilter(InterfaceFilter filter)
+  {
+    mFilter = std::move(filter);
+    if (mpMonitor)
+    {
+      scan();
+    }
+  }
+
+  // Takes effect with the next scan, unless the period is shortened, which rescans
+  // right away if enabled
+  void setPeriod(const std::chrono::seconds period)
+  {
+    const auto isShorter = period < mPeriod;
+    mPeriod = period;
+    if (isShorter && mpMonitor && !mpMonitor->isActive())
+    {
+      scan();
     }
   }
 
   void scan()
   {
     using namespace std;
-    debug(mIo->log()) << "Scanning network interfaces";
+    mIsScanPending = false;
+    LINK_DEBUG(mIo->log()) << "Scanning network interfaces";
     // Rescan the hardware for available network interface addresses
-    vector<asio::ip::address> addrs = mIo->scanNetworkInterfaces();
+    vector<asio::ip::address> addrs;
+    for (const auto& networkInterface : mIo->scanNetworkInterfaces())
+    {
+      if (mFilter(networkInterface))
+      {
+        addrs.push_back(networkInterface.address);
+      }
+    }
     // Sort and unique them to guarantee consistent comparison
     sort(begin(addrs), end(addrs));
     addrs.erase(unique(begin(addrs), end(addrs)), end(addrs));
     // Pass them to the callback
     (*mCallback)(std::move(addrs));
-    // setup the next scanning
-    mTimer.expires_from_now(mPeriod);
+    // setup the next scanning unless changes are reported by the monitor
+    if (!mpMonitor || !mpMonitor->isActive())
+    {
+      scheduleScan(mPeriod);
+    }
+  }
+
+private:
+  // Changes come in bursts, e.g. when an interface comes up and its addresses are
+  // assigned, so the rescan is delayed until they have settled
+  void onInterfacesChanged()
+  {
+    if (!mIsScanPending)
+    {
+      mIsScanPending = true;
+      scheduleScan(std::chrono::milliseconds{100});
+    }
+  }
+
+  void scheduleScan(const std::chrono::milliseconds delay)
+  {
+    mTimer.expires_from_now(delay);
     using ErrorCode = typename Timer::ErrorCode;
     mTimer.async_wait([this](const ErrorCode e) {
       if (!e)
@@ -81,11 +146,13 @@ public:
     });
   }
 
-private:
-  const std::chrono::seconds mPeriod;
+  std::chrono::seconds mPeriod;
   util::Injected<Callback> mCallback;
   util::Injected<IoContext> mIo;
   Timer mTimer;
+  std::unique_ptr<InterfaceMonitor> mpMonitor; // Only exists while enabled
+  InterfaceFilter mFilter;
+  bool mIsScanPending;
 };
 
 // Factory function
@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <ableton/discovery/PacketFilter.hpp>
 #include <ableton/platforms/asio/AsioWrapper.hpp>
 #include <ableton/util/Injected.hpp>
 
@@ -27,11 +28,43 @@ namespace ableton
 namespace discovery
 {
 
-inline asio::ip::udp::endpoint multicastEndpoint()
+inline asio::ip::udp::endpoint multicastEndpointV4()
 {
   return {asio::ip::address_v4::from_string("224.76.78.75"), 20808};
 }
 
+// The link-local group on the interface with the given scope id
+inline asio::ip::udp::endpoint multicastEndpointV6(const unsigned long scopeId)
+{
+  auto addr = asio::ip::address_v6::from_string("ff12::8080");
+  addr.scope_id(scopeId);
+  return {addr, 20808};
+}
+
+// The multicast endpoint of the address family of the given interface address
+inline asio::ip::udp::endpoint multicastEndpoint(const asio::ip::address& ifAddr)
+{
+  return ifAddr.is_v6() ? multicastEndpointV6(ifAddr.to_v6().scope_id())
+                        : multicastEndpointV4();
+}
+
+// Peers don't announce the scope of their link-local v6 addresses, which is that
+// of the interface they are reached through
+inline asio::ip::udp::endpoint inScopeOf(
+  const asio::ip::address& ifAddr, asio::ip::udp::endpoint ep)
+{
+  if (ifAddr.is_v6() && ep.address().is_v6())
+  {
+    auto addr = ep.address().to_v6();
+    if (addr.is_link_local() && addr.scope_id() == 0)
+    {
+      addr.scope_id(ifAddr.to_v6().scope_id());
+      ep.address(addr);
+    }
+  }
+  return ep;
+}
+
 // Type tags for dispatching between unicast and multicast packets
 struct MulticastTag
 {
@@ -40,23 +73,25 @@ struct UnicastTag
 {
 };
 
+// The sockets of a peer gateway on the interface with the given address, which
+// may be of either address family
 template <typename IoContext, std::size_t MaxPacketSize>
-class IpV4Interface
+class IpInterface
 {
 public:
   using Socket = typename util::Injected<IoContext>::type::template Socket<MaxPacketSize>;
 
-  IpV4Interface(util::Injected<IoContext> io, const asio::ip::address_v4& addr)
+  IpInterface(util::Injected<IoContext> io, const asio::ip::address& addr)
     : mIo(std::move(io))
     , mMulticastReceiveSocket(mIo->template openMulticastSocket<MaxPacketSize>(addr))
     , mSendSocket(mIo->template openUnicastSocket<MaxPacketSize>(addr))
   {
   }
 
-  IpV4Interface(const IpV4Interface&) = delete;
-  IpV4Interface& operator=(const IpV4Interface&) = delete;
+  IpInterface(const IpInterface&) = delete;
+  IpInterface& operator=(const IpInterface&) = delete;
 
-  IpV4Interface(IpV4Interface&& rhs)
+  IpInterface(IpInterface&& rhs)
     : mIo(std::move(rhs.mIo))
     , mMulticastReceiveSocket(std::move(rhs.mMulticastReceiveSocket))
     , mSendSocket(std::move(rhs.mSendSocket))
@@ -70,6 +105,15 @@ public:
     return mSendSocket.send(pData, numBytes, to);
   }
 
+  // Reports an error through ec instead of throwing
+  std::size_t send(const uint8_t* const pData,
+    const size_t numBytes,
+    const asio::ip::udp::endpoint& to,
+    asio::error_code& ec)
+  {
+    return mSendSocket.send(pData, numBytes, to, ec);
+  }
+
   template <typename Handler>
   void receive(Handler handler, UnicastTag)
   {
@@ -88,6 +132,13 @@ public:
     return mSendSocket.endpoint();
   }
 
+  // Only the multicast socket receives the packets of all peers, the unicast
+  // socket is filtered by its port
+  void setPacketFilter(const PacketFilter& filter)
+  {
+    mIo->setPacketFilter(mMulticastReceiveSocket, filter);
+  }
+
 private:
   template <typename Tag, typename Handler>
   struct SocketReceiver
@@ -113,8 +164,8 @@ private:
 };
 
 template <std::size_t MaxPacketSize, typename IoContext>
-IpV4Interface<IoContext, MaxPacketSize> makeIpV4Interface(
-  util::Injected<IoContext> io, const asio::ip::address_v4& addr)
+IpInterface<IoContext, MaxPacketSize> makeIpInterface(
+  util::Injected<IoContext> io, const asio::ip::address& addr)
 {
   return {std::move(io), addr};
 }
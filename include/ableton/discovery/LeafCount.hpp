@@ -0,0 +1,60 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/discovery/NetworkByteStreamSerializable.hpp>
+#include <cstdint>
+
+namespace ableton
+{
+namespace discovery
+{
+
+// A payload entry that hubs append to their messages, see BroadcastPolicy::maxHubs.
+// It counts the leaves that are attached to the hub, which the other nodes only
+// know through it. Peers that don't know it ignore it.
+struct LeafCount
+{
+  static const std::int32_t key = 'leaf';
+  static_assert(key == 0x6c656166, "Unexpected byte order");
+
+  // Model the NetworkByteStreamSerializable concept
+  friend std::uint32_t sizeInByteStream(const LeafCount& entry)
+  {
+    return discovery::sizeInByteStream(entry.count);
+  }
+
+  template <typename It>
+  friend It toNetworkByteStream(const LeafCount& entry, It out)
+  {
+    return discovery::toNetworkByteStream(entry.count, std::move(out));
+  }
+
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, LeafCount& entry)
+  {
+    return tryDeserialize(begin, end, entry.count);
+  }
+
+  std::uint32_t count;
+};
+
+} // namespace discovery
+} // namespace ableton
@@ -29,9 +29,15 @@
 #elif defined(ESP_PLATFORM)
 #include <ableton/platforms/esp32/Esp32.hpp>
 #endif
+#include <ableton/util/Exceptions.hpp>
 
 #include <chrono>
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -65,19 +71,123 @@ struct NetworkByteStreamSerializable
 
 // Deserialization aspect of the concept. Outside of the demonstration
 // type above because clients must specify the type
-// explicitly. Default implementation just defers to a class static
-// method on T. For types that can't provide such a method, specialize
+// explicitly. Default implementation just defers to class static
+// methods on T. For types that can't provide such methods, specialize
 // this template.
+//
+// Decoding is reported by status rather than by exception, as malformed and
+// foreign packets arrive on the discovery ports all the time and unwinding for
+// each of them is expensive. A type provides
+//
+//   template <typename It>
+//   static bool tryFromNetworkByteStream(It& begin, It end, T& value);
+//
+// which returns false if the given byte range doesn't hold a valid value and
+// otherwise advances begin to the next byte to parse. Types that only provide
+// the throwing fromNetworkByteStream are adapted.
+template <typename T>
+struct Deserialize;
+
+// Decodes a value from the byte range starting at begin. Returns false if
+// decoding fails, in which case begin and value are unspecified.
+template <typename T, typename It>
+bool tryDeserialize(It& begin, const It end, T& value)
+{
+  return Deserialize<T>::tryFromNetworkByteStream(begin, end, value);
+}
+
+// Adapts the status of decoding a type to an exception, for clients of the
+// throwing interface. Types that provide tryFromNetworkByteStream implement their
+// fromNetworkByteStream with it.
+template <typename T, typename It>
+std::pair<T, It> fromNetworkByteStreamOrThrow(It begin, const It end)
+{
+  T value{};
+  if (!tryDeserialize(begin, end, value))
+  {
+    LINK_THROW(std::range_error("Parsing type from byte stream failed"));
+  }
+  return std::make_pair(std::move(value), std::move(begin));
+}
+
+namespace detail
+{
+
+// Provides the throwing interface of a Deserialize specialization
+template <typename T>
+struct ThrowingDeserialize
+{
+  // Throws std::range_error if parsing the type from the given byte range
+  // fails. Returns a pair of the correctly parsed value and an iterator to the
+  // next byte to parse.
+  template <typename It>
+  static std::pair<T, It> fromNetworkByteStream(It begin, It end)
+  {
+    return fromNetworkByteStreamOrThrow<T>(std::move(begin), std::move(end));
+  }
+};
+
+template <typename T, typename It>
+auto tryFromMember(It& begin, const It end, T& value, int)
+  -> decltype(T::tryFromNetworkByteStream(begin, end, value))
+{
+  return T::tryFromNetworkByteStream(begin, end, value);
+}
+
+template <typename T, typename It>
+bool tryFromMember(It& begin, const It end, T& value, long)
+{
+#if defined(LINK_NO_EXCEPTIONS)
+  (void)begin;
+  (void)end;
+  (void)value;
+  static_assert(sizeof(T) == 0,
+    "Without exceptions, types must provide tryFromNetworkByteStream to be parsed");
+  return false;
+#else
+  try
+  {
+    std::tie(value, begin) = T::fromNetworkByteStream(begin, end);
+    return true;
+  }
+  catch (const std::runtime_error&)
+  {
+    return false;
+  }
+#endif
+}
+
+template <typename T, typename It>
+auto fromMember(It begin, It end, int)
+  -> decltype(T::fromNetworkByteStream(std::move(begin), std::move(end)))
+{
+  return T::fromNetworkByteStream(std::move(begin), std::move(end));
+}
+
+template <typename T, typename It>
+std::pair<T, It> fromMember(It begin, It end, long)
+{
+  return fromNetworkByteStreamOrThrow<T>(std::move(begin), std::move(end));
+}
+
+} // namespace detail
+
 template <typename T>
 struct Deserialize
 {
-  // Throws std::runtime_exception if parsing the type from the given
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, T& value)
+  {
+    return detail::tryFromMember(begin, end, value, 0);
+  }
+
+  // Throws std::runtime_error if parsing the type from the given
   // byte range fails. Returns a pair of the correctly parsed value
   // and an iterator to the next byte to parse.
   template <typename It>
   static std::pair<T, It> fromNetworkByteStream(It begin, It end)
   {
-    return T::fromNetworkByteStream(std::move(begin), std::move(end));
+    return detail::fromMember<T>(std::move(begin), std::move(end), 0);
   }
 };
 
@@ -105,22 +215,40 @@ It copyToByteStream(T t, It out)
 }
 
 template <typename T, typename It>
-std::pair<T, It> copyFromByteStream(It begin, const It end)
+bool tryCopyFromByteStream(It& begin, const It end, T& t)
 {
   using namespace std;
   using ItDiff = typename iterator_traits<It>::difference_type;
 
   if (distance(begin, end) < static_cast<ItDiff>(sizeof(T)))
   {
-    throw range_error("Parsing type from byte stream failed");
+    return false;
   }
-  else
+  copy_n(begin, sizeof(t), reinterpret_cast<uint8_t*>(&t));
+  begin += static_cast<ItDiff>(sizeof(t));
+  return true;
+}
+
+// Messages are encoded into and decoded from plain byte buffers. A value is
+// copied from and to those with a single memcpy, which compilers turn into one
+// load or store even where they don't see through the loop of copy_n.
+template <typename T>
+uint8_t* copyToByteStream(T t, uint8_t* const out)
+{
+  std::memcpy(out, &t, sizeof(t));
+  return out + sizeof(t);
+}
+
+template <typename T>
+bool tryCopyFromByteStream(const uint8_t*& begin, const uint8_t* const end, T& t)
+{
+  if (end - begin < static_cast<std::ptrdiff_t>(sizeof(T)))
   {
-    T t;
-    const auto n = sizeof(t);
-    copy_n(begin, n, reinterpret_cast<uint8_t*>(&t));
-    return make_pair(t, begin + n);
+    return false;
   }
+  std::memcpy(&t, begin, sizeof(t));
+  begin += sizeof(t);
+  return true;
 }
 
 } // namespace detail
@@ -136,12 +264,12 @@ It toNetworkByteStream(const uint8_t byte, It out)
 }
 
 template <>
-struct Deserialize<uint8_t>
+struct Deserialize<uint8_t> : detail::ThrowingDeserialize<uint8_t>
 {
   template <typename It>
-  static std::pair<uint8_t, It> fromNetworkByteStream(It begin, It end)
+  static bool tryFromNetworkByteStream(It& begin, const It end, uint8_t& value)
   {
-    return detail::copyFromByteStream<uint8_t>(std::move(begin), std::move(end));
+    return detail::tryCopyFromByteStream(begin, end, value);
   }
 };
 
@@ -153,14 +281,17 @@ It toNetworkByteStream(uint16_t s, It out)
 }
 
 template <>
-struct Deserialize<uint16_t>
+struct Deserialize<uint16_t> : detail::ThrowingDeserialize<uint16_t>
 {
   template <typename It>
-  static std::pair<uint16_t, It> fromNetworkByteStream(It begin, It end)
+  static bool tryFromNetworkByteStream(It& begin, const It end, uint16_t& value)
   {
-    auto result = detail::copyFromByteStream<uint16_t>(std::move(begin), std::move(end));
-    result.first = ntohs(result.first);
-    return result;
+    if (!detail::tryCopyFromByteStream(begin, end, value))
+    {
+      return false;
+    }
+    value = ntohs(value);
+    return true;
   }
 };
 
@@ -172,14 +303,17 @@ It toNetworkByteStream(uint32_t l, It out)
 }
 
 template <>
-struct Deserialize<uint32_t>
+struct Deserialize<uint32_t> : detail::ThrowingDeserialize<uint32_t>
 {
   template <typename It>
-  static std::pair<uint32_t, It> fromNetworkByteStream(It begin, It end)
+  static bool tryFromNetworkByteStream(It& begin, const It end, uint32_t& value)
   {
-    auto result = detail::copyFromByteStream<uint32_t>(std::move(begin), std::move(end));
-    result.first = ntohl(result.first);
-    return result;
+    if (!detail::tryCopyFromByteStream(begin, end, value))
+    {
+      return false;
+    }
+    value = ntohl(value);
+    return true;
   }
 };
 
@@ -191,14 +325,18 @@ It toNetworkByteStream(int32_t l, It out)
 }
 
 template <>
-struct Deserialize<int32_t>
+struct Deserialize<int32_t> : detail::ThrowingDeserialize<int32_t>
 {
   template <typename It>
-  static std::pair<int32_t, It> fromNetworkByteStream(It begin, It end)
+  static bool tryFromNetworkByteStream(It& begin, const It end, int32_t& value)
   {
-    auto result =
-      Deserialize<uint32_t>::fromNetworkByteStream(std::move(begin), std::move(end));
-    return std::make_pair(reinterpret_cast<const int32_t&>(result.first), result.second);
+    uint32_t bits = 0;
+    if (!tryDeserialize(begin, end, bits))
+    {
+      return false;
+    }
+    value = reinterpret_cast<const int32_t&>(bits);
+    return true;
   }
 };
 
@@ -210,14 +348,17 @@ It toNetworkByteStream(uint64_t ll, It out)
 }
 
 template <>
-struct Deserialize<uint64_t>
+struct Deserialize<uint64_t> : detail::ThrowingDeserialize<uint64_t>
 {
   template <typename It>
-  static std::pair<uint64_t, It> fromNetworkByteStream(It begin, It end)
+  static bool tryFromNetworkByteStream(It& begin, const It end, uint64_t& value)
   {
-    auto result = detail::copyFromByteStream<uint64_t>(std::move(begin), std::move(end));
-    result.first = ntohll(result.first);
-    return result;
+    if (!detail::tryCopyFromByteStream(begin, end, value))
+    {
+      return false;
+    }
+    value = ntohll(value);
+    return true;
   }
 };
 
@@ -229,14 +370,18 @@ It toNetworkByteStream(int64_t ll, It out)
 }
 
 template <>
-struct Deserialize<int64_t>
+struct Deserialize<int64_t> : detail::ThrowingDeserialize<int64_t>
 {
   template <typename It>
-  static std::pair<int64_t, It> fromNetworkByteStream(It begin, It end)
+  static bool tryFromNetworkByteStream(It& begin, const It end, int64_t& value)
   {
-    auto result =
-      Deserialize<uint64_t>::fromNetworkByteStream(std::move(begin), std::move(end));
-    return std::make_pair(reinterpret_cast<const int64_t&>(result.first), result.second);
+    uint64_t bits = 0;
+    if (!tryDeserialize(begin, end, bits))
+    {
+      return false;
+    }
+    value = reinterpret_cast<const int64_t&>(bits);
+    return true;
   }
 };
 
@@ -253,14 +398,18 @@ It toNetworkByteStream(bool bl, It out)
 }
 
 template <>
-struct Deserialize<bool>
+struct Deserialize<bool> : detail::ThrowingDeserialize<bool>
 {
   template <typename It>
-  static std::pair<bool, It> fromNetworkByteStream(It begin, It end)
+  static bool tryFromNetworkByteStream(It& begin, const It end, bool& value)
   {
-    auto result =
-      Deserialize<uint8_t>::fromNetworkByteStream(std::move(begin), std::move(end));
-    return std::make_pair(result.first != 0, result.second);
+    uint8_t byte = 0;
+    if (!tryDeserialize(begin, end, byte))
+    {
+      return false;
+    }
+    value = byte != 0;
+    return true;
   }
 };
 
@@ -280,14 +429,19 @@ It toNetworkByteStream(const std::chrono::microseconds micros, It out)
 
 template <>
 struct Deserialize<std::chrono::microseconds>
+  : detail::ThrowingDeserialize<std::chrono::microseconds>
 {
   template <typename It>
-  static std::pair<std::chrono::microseconds, It> fromNetworkByteStream(It begin, It end)
+  static bool tryFromNetworkByteStream(
+    It& begin, const It end, std::chrono::microseconds& value)
   {
-    using namespace std;
-    auto result =
-      Deserialize<int64_t>::fromNetworkByteStream(std::move(begin), std::move(end));
-    return make_pair(chrono::microseconds{result.first}, result.second);
+    int64_t count = 0;
+    if (!tryDeserialize(begin, end, count))
+    {
+      return false;
+    }
+    value = std::chrono::microseconds{count};
+    return true;
   }
 };
 
@@ -318,21 +472,23 @@ It containerToNetworkByteStream(const Container& container, It out)
 }
 
 template <typename T, typename BytesIt, typename InsertIt>
-BytesIt deserializeContainer(BytesIt bytesBegin,
+bool tryDeserializeContainer(BytesIt& bytesBegin,
   const BytesIt bytesEnd,
   InsertIt contBegin,
   const std::uint32_t maxElements)
 {
-  using namespace std;
   std::uint32_t numElements = 0;
   while (bytesBegin < bytesEnd && numElements < maxElements)
   {
-    T newVal;
-    tie(newVal, bytesBegin) = Deserialize<T>::fromNetworkByteStream(bytesBegin, bytesEnd);
-    *contBegin++ = newVal;
+    T newVal{};
+    if (!tryDeserialize(bytesBegin, bytesEnd, newVal))
+    {
+      return false;
+    }
+    *contBegin++ = std::move(newVal);
     ++numElements;
   }
-  return bytesBegin;
+  return true;
 }
 
 } // namespace detail
@@ -340,6 +496,48 @@ BytesIt deserializeContainer(BytesIt bytesBegin,
 // Need specific overloads for each container type, but use above
 // utilities for common implementation
 
+namespace detail
+{
+
+// Arrays of bytes, like node ids, are copied as a whole rather than byte by byte,
+// with a single check of the size of the range. Like other containers, they take
+// the remaining bytes if the range is shorter than the array.
+template <typename T, std::size_t Size, typename It>
+It arrayToNetworkByteStream(const std::array<T, Size>& arr, It out, std::false_type)
+{
+  return containerToNetworkByteStream(arr, std::move(out));
+}
+
+template <std::size_t Size, typename It>
+It arrayToNetworkByteStream(const std::array<uint8_t, Size>& arr, It out, std::true_type)
+{
+  return std::copy(arr.begin(), arr.end(), std::move(out));
+}
+
+template <typename T, std::size_t Size, typename It>
+bool tryArrayFromByteStream(
+  It& begin, const It end, std::array<T, Size>& value, std::false_type)
+{
+  return tryDeserializeContainer<T>(begin, end, value.begin(), Size);
+}
+
+template <std::size_t Size, typename It>
+bool tryArrayFromByteStream(
+  It& begin, const It end, std::array<uint8_t, Size>& value, std::true_type)
+{
+  using ItDiff = typename std::iterator_traits<It>::difference_type;
+  const auto numBytes =
+    (std::min)(std::distance(begin, end), static_cast<ItDiff>(Size));
+  if (numBytes > 0)
+  {
+    std::copy_n(begin, numBytes, value.begin());
+    begin += numBytes;
+  }
+  return true;
+}
+
+} // namespace detail
+
 // array
 template <typename T, std::size_t Size>
 std::uint32_t sizeInByteStream(const std::array<T, Size>& arr)
@@ -350,20 +548,21 @@ std::uint32_t sizeInByteStream(const std::array<T, Size>& arr)
 template <typename T, std::size_t Size, typename It>
 It toNetworkByteStream(const std::array<T, Size>& arr, It out)
 {
-  return detail::containerToNetworkByteStream(arr, std::move(out));
+  return detail::arrayToNetworkByteStream(
+    arr, std::move(out), std::is_same<T, uint8_t>{});
 }
 
 template <typename T, std::size_t Size>
 struct Deserialize<std::array<T, Size>>
+  : detail::ThrowingDeserialize<std::array<T, Size>>
 {
   template <typename It>
-  static std::pair<std::array<T, Size>, It> fromNetworkByteStream(It begin, It end)
+  static bool tryFromNetworkByteStream(
+    It& begin, const It end, std::array<T, Size>& value)
   {
-    using namespace std;
-    array<T, Size> result{};
-    auto resultIt = detail::deserializeContainer<T>(
-      std::move(begin), std::move(end), std::move(result.begin()), Size);
-    return make_pair(std::move(result), std::move(resultIt));
+    value = {};
+    return detail::tryArrayFromByteStream(
+      begin, end, value, std::is_same<T, uint8_t>{});
   }
 };
 
@@ -383,18 +582,17 @@ It toNetworkByteStream(const std::vector<T, Alloc>& vec, It out)
 
 template <typename T, typename Alloc>
 struct Deserialize<std::vector<T, Alloc>>
+  : detail::ThrowingDeserialize<std::vector<T, Alloc>>
 {
   template <typename It>
-  static std::pair<std::vector<T, Alloc>, It> fromNetworkByteStream(
-    It bytesBegin, It bytesEnd)
+  static bool tryFromNetworkByteStream(
+    It& bytesBegin, const It bytesEnd, std::vector<T, Alloc>& value)
   {
-    using namespace std;
-    auto result_size =
-      Deserialize<uint32_t>::fromNetworkByteStream(std::move(bytesBegin), bytesEnd);
-    vector<T, Alloc> result;
-    auto resultIt = detail::deserializeContainer<T>(std::move(result_size.second),
-      std::move(bytesEnd), back_inserter(result), result_size.first);
-    return make_pair(std::move(result), std::move(resultIt));
+    uint32_t size = 0;
+    value.clear();
+    return tryDeserialize(bytesBegin, bytesEnd, size)
+           && detail::tryDeserializeContainer<T>(
+             bytesBegin, bytesEnd, std::back_inserter(value), size);
   }
 };
 
@@ -413,16 +611,13 @@ It toNetworkByteStream(const std::tuple<X, Y>& tup, It out)
 }
 
 template <typename X, typename Y>
-struct Deserialize<std::tuple<X, Y>>
+struct Deserialize<std::tuple<X, Y>> : detail::ThrowingDeserialize<std::tuple<X, Y>>
 {
   template <typename It>
-  static std::pair<std::tuple<X, Y>, It> fromNetworkByteStream(It begin, It end)
+  static bool tryFromNetworkByteStream(It& begin, const It end, std::tuple<X, Y>& value)
   {
-    using namespace std;
-    auto xres = Deserialize<X>::fromNetworkByteStream(begin, end);
-    auto yres = Deserialize<Y>::fromNetworkByteStream(xres.second, end);
-    return make_pair(
-      make_tuple(std::move(xres.first), std::move(yres.first)), std::move(yres.second));
+    return tryDeserialize(begin, end, std::get<0>(value))
+           && tryDeserialize(begin, end, std::get<1>(value));
   }
 };
 
@@ -444,17 +639,15 @@ It toNetworkByteStream(const std::tuple<X, Y, Z>& tup, It out)
 
 template <typename X, typename Y, typename Z>
 struct Deserialize<std::tuple<X, Y, Z>>
+  : detail::ThrowingDeserialize<std::tuple<X, Y, Z>>
 {
   template <typename It>
-  static std::pair<std::tuple<X, Y, Z>, It> fromNetworkByteStream(It begin, It end)
+  static bool tryFromNetworkByteStream(
+    It& begin, const It end, std::tuple<X, Y, Z>& value)
   {
-    using namespace std;
-    auto xres = Deserialize<X>::fromNetworkByteStream(begin, end);
-    auto yres = Deserialize<Y>::fromNetworkByteStream(xres.second, end);
-    auto zres = Deserialize<Z>::fromNetworkByteStream(yres.second, end);
-    return make_pair(
-      make_tuple(std::move(xres.first), std::move(yres.first), std::move(zres.first)),
-      std::move(zres.second));
+    return tryDeserialize(begin, end, std::get<0>(value))
+           && tryDeserialize(begin, end, std::get<1>(value))
+           && tryDeserialize(begin, end, std::get<2>(value));
   }
 };
 
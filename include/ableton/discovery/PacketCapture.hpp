@@ -0,0 +1,204 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/discovery/NetworkByteStreamSerializable.hpp>
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+namespace ableton
+{
+namespace discovery
+{
+
+// A datagram as it was received by a socket of an interface, for recording the
+// traffic of a network and replaying it later
+struct CapturedPacket
+{
+  std::chrono::microseconds time;
+  asio::ip::address interfaceAddr;
+  asio::ip::udp::endpoint from;
+  std::vector<uint8_t> bytes;
+};
+
+// Captures start with a magic number and a version, followed by the packets. Each
+// packet is its time, the interface and the source address, the source port, the
+// number of bytes and the bytes, all in network byte order. Addresses are a family
+// byte, 4 or 6, and the bytes of the address, followed by the scope id for v6.
+namespace detail
+{
+
+const std::array<uint8_t, 4> kCaptureMagic = {{'L', 'C', 'A', 'P'}};
+const uint16_t kCaptureVersion = 1;
+// Family, v6 address and scope id
+const std::size_t kMaxAddressSize = 21;
+
+inline uint8_t* addressToByteStream(const asio::ip::address& addr, uint8_t* out)
+{
+  if (addr.is_v4())
+  {
+    out = toNetworkByteStream(uint8_t{4}, out);
+    const auto bytes = addr.to_v4().to_bytes();
+    return std::copy(bytes.begin(), bytes.end(), out);
+  }
+  out = toNetworkByteStream(uint8_t{6}, out);
+  const auto bytes = addr.to_v6().to_bytes();
+  out = std::copy(bytes.begin(), bytes.end(), out);
+  return toNetworkByteStream(static_cast<uint32_t>(addr.to_v6().scope_id()), out);
+}
+
+inline bool tryAddressFromByteStream(
+  const uint8_t*& begin, const uint8_t* const end, asio::ip::address& addr)
+{
+  uint8_t family = 0;
+  if (!tryDeserialize(begin, end, family))
+  {
+    return false;
+  }
+  if (family == 4)
+  {
+    asio::ip::address_v4::bytes_type bytes;
+    if (end - begin < static_cast<std::ptrdiff_t>(bytes.size()))
+    {
+      return false;
+    }
+    std::copy(begin, begin + bytes.size(), bytes.begin());
+    begin += bytes.size();
+    addr = asio::ip::address_v4{bytes};
+    return true;
+  }
+
+  asio::ip::address_v6::bytes_type bytes;
+  uint32_t scopeId = 0;
+  if (family != 6 || end - begin < static_cast<std::ptrdiff_t>(bytes.size()))
+  {
+    return false;
+  }
+  std::copy(begin, begin + bytes.size(), bytes.begin());
+  begin += bytes.size();
+  if (!tryDeserialize(begin, end, scopeId))
+  {
+    return false;
+  }
+  addr = asio::ip::address_v6{bytes, scopeId};
+  return true;
+}
+
+} // namespace detail
+
+// Writes packets to a stream, e.g. a file opened in binary mode
+class PacketCaptureWriter
+{
+public:
+  explicit PacketCaptureWriter(std::ostream& stream)
+    : mStream(stream)
+  {
+    std::array<uint8_t, 6> header;
+    const auto out = std::copy(
+      detail::kCaptureMagic.begin(), detail::kCaptureMagic.end(), header.data());
+    toNetworkByteStream(detail::kCaptureVersion, out);
+    write(header.data(), header.size());
+  }
+
+  // Datagrams of Link are far smaller than 64 KiB, bigger ones are truncated
+  void write(const CapturedPacket& packet)
+  {
+    std::array<uint8_t, 8 + 2 * detail::kMaxAddressSize + 2 + 2> header;
+    const auto numBytes =
+      static_cast<uint16_t>((std::min)(packet.bytes.size(), std::size_t{UINT16_MAX}));
+    auto out = toNetworkByteStream(packet.time, header.data());
+    out = detail::addressToByteStream(packet.interfaceAddr, out);
+    out = detail::addressToByteStream(packet.from.address(), out);
+    out = toNetworkByteStream(packet.from.port(), out);
+    out = toNetworkByteStream(numBytes, out);
+    write(header.data(), static_cast<std::size_t>(out - header.data()));
+    write(packet.bytes.data(), numBytes);
+  }
+
+  void flush()
+  {
+    mStream.flush();
+  }
+
+private:
+  void write(const uint8_t* const pData, const std::size_t numBytes)
+  {
+    mStream.write(
+      reinterpret_cast<const char*>(pData), static_cast<std::streamsize>(numBytes));
+  }
+
+  std::ostream& mStream;
+};
+
+// Reads all packets of a capture. Throws std::runtime_error if the stream isn't a
+// capture of a known version or if a packet is cut off, which is what's left of a
+// recording that was interrupted.
+inline std::vector<CapturedPacket> readPacketCapture(std::istream& stream)
+{
+  const auto data = std::vector<uint8_t>{
+    std::istreambuf_iterator<char>{stream}, std::istreambuf_iterator<char>{}};
+  auto begin = data.data();
+  const auto end = data.data() + data.size();
+
+  auto version = uint16_t{0};
+  if (data.size() < detail::kCaptureMagic.size()
+      || !std::equal(detail::kCaptureMagic.begin(), detail::kCaptureMagic.end(), begin))
+  {
+    throw std::runtime_error("Not a Link packet capture");
+  }
+  begin += detail::kCaptureMagic.size();
+  if (!tryDeserialize(begin, end, version) || version != detail::kCaptureVersion)
+  {
+    throw std::runtime_error("Unsupported version of Link packet capture");
+  }
+
+  auto packets = std::vector<CapturedPacket>{};
+  while (begin != end)
+  {
+    auto packet = CapturedPacket{};
+    auto fromAddr = asio::ip::address{};
+    auto port = uint16_t{0};
+    auto numBytes = uint16_t{0};
+    if (!tryDeserialize(begin, end, packet.time)
+        || !detail::tryAddressFromByteStream(begin, end, packet.interfaceAddr)
+        || !detail::tryAddressFromByteStream(begin, end, fromAddr)
+        || !tryDeserialize(begin, end, port) || !tryDeserialize(begin, end, numBytes)
+        || end - begin < numBytes)
+    {
+      throw std::runtime_error("Truncated packet in Link packet capture");
+    }
+    packet.from = asio::ip::udp::endpoint{fromAddr, port};
+    packet.bytes.assign(begin, begin + numBytes);
+    begin += numBytes;
+    packets.push_back(std::move(packet));
+  }
+  return packets;
+}
+
+} // namespace discovery
+} // namespace ableton
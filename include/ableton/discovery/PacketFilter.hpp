@@ -0,0 +1,67 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/discovery/v1/Messages.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace ableton
+{
+namespace discovery
+{
+
+// Describes the packets of the multicast socket that a messenger wants to see, so
+// that the platform can drop the others before they wake the io thread. A filter
+// never drops more than the messenger would ignore anyway. The default filter
+// accepts any Link packet.
+struct PacketFilter
+{
+  PacketFilter()
+    : groupId(0)
+    , acceptsAnyGroup(true)
+    , acceptsCompactMessages(true)
+  {
+  }
+
+  // Packets of other groups are dropped unless acceptsAnyGroup is set. Compact
+  // messages don't carry a group, they are only sent in group 0.
+  v1::SessionGroupId groupId;
+  bool acceptsAnyGroup;
+  bool acceptsCompactMessages;
+  // The serialized node id of the messenger, whose own packets are dropped. Empty
+  // if no packets are dropped for their sender.
+  std::vector<std::uint8_t> ownIdent;
+
+  friend bool operator==(const PacketFilter& lhs, const PacketFilter& rhs)
+  {
+    return lhs.groupId == rhs.groupId && lhs.acceptsAnyGroup == rhs.acceptsAnyGroup
+           && lhs.acceptsCompactMessages == rhs.acceptsCompactMessages
+           && lhs.ownIdent == rhs.ownIdent;
+  }
+
+  friend bool operator!=(const PacketFilter& lhs, const PacketFilter& rhs)
+  {
+    return !(lhs == rhs);
+  }
+};
+
+} // namespace discovery
+} // namespace ableton
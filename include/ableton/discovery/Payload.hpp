@@ -20,9 +20,8 @@
 #pragma once
 
 #include <ableton/discovery/NetworkByteStreamSerializable.hpp>
-#include <functional>
-#include <sstream>
-#include <unordered_map>
+#include <ableton/util/Exceptions.hpp>
+#include <stdexcept>
 
 namespace ableton
 {
@@ -49,19 +48,24 @@ struct PayloadEntryHeader
       header.size, toNetworkByteStream(header.key, std::move(out)));
   }
 
+  template <typename It>
+  static bool tryFromNetworkByteStream(
+    It& begin, const It end, PayloadEntryHeader& header)
+  {
+    return tryDeserialize(begin, end, header.key)
+           && tryDeserialize(begin, end, header.size);
+  }
+
   template <typename It>
   static std::pair<PayloadEntryHeader, It> fromNetworkByteStream(It begin, const It end)
   {
-    using namespace std;
-    Key key;
-    Size size;
-    tie(key, begin) = Deserialize<Key>::fromNetworkByteStream(begin, end);
-    tie(size, begin) = Deserialize<Size>::fromNetworkByteStream(begin, end);
-    return make_pair(
-      PayloadEntryHeader{std::move(key), std::move(size)}, std::move(begin));
+    return fromNetworkByteStreamOrThrow<PayloadEntryHeader>(
+      std::move(begin), std::move(end));
   }
 };
 
+// An entry whose value takes no bytes is left out of the payload, so that entry
+// types can opt out for values they can't represent.
 template <typename EntryType>
 struct PayloadEntry
 {
@@ -74,14 +78,25 @@ struct PayloadEntry
   PayloadEntryHeader header;
   EntryType value;
 
+  bool empty() const
+  {
+    return header.size == 0;
+  }
+
+  // The size of the value is taken from the header, so that encoding a message
+  // doesn't walk the value a second time
   friend std::uint32_t sizeInByteStream(const PayloadEntry& entry)
   {
-    return sizeInByteStream(entry.header) + sizeInByteStream(entry.value);
+    return entry.empty() ? 0 : sizeInByteStream(entry.header) + entry.header.size;
   }
 
   template <typename It>
   friend It toNetworkByteStream(const PayloadEntry& entry, It out)
   {
+    if (entry.empty())
+    {
+      return out;
+    }
     return toNetworkByteStream(
       entry.value, toNetworkByteStream(entry.header, std::move(out)));
   }
@@ -90,47 +105,44 @@ struct PayloadEntry
 namespace detail
 {
 
-template <typename It>
-using HandlerMap =
-  std::unordered_map<typename PayloadEntryHeader::Key, std::function<void(It, It)>>;
-
-// Given an index of handlers and a byte range, parse the bytes as a
-// sequence of payload entries and invoke the appropriate handler for
-// each entry type. Entries that are encountered that do not have a
-// corresponding handler in the map are ignored. Throws
-// std::runtime_error if parsing fails for any entry. Note that if an
-// exception is thrown, some of the handlers may have already been called.
-template <typename It>
-void parseByteStream(HandlerMap<It>& map, It bsBegin, const It bsEnd)
+// Parse the given byte range as a sequence of payload entries and
+// invoke the handler with the key and value range of each entry.
+// Returns false as soon as parsing fails for an entry or the handler
+// returns false for it. Note that the handler may already have been
+// called for some entries in that case.
+template <typename It, typename Handler>
+bool tryParseByteStream(It bsBegin, const It bsEnd, Handler handler)
 {
   using namespace std;
+  using ItDiff = typename iterator_traits<It>::difference_type;
 
   while (bsBegin < bsEnd)
   {
     // Try to parse an entry header at this location in the byte stream
     PayloadEntryHeader header;
-    It valueBegin;
-    tie(header, valueBegin) =
-      Deserialize<PayloadEntryHeader>::fromNetworkByteStream(bsBegin, bsEnd);
+    if (!tryDeserialize(bsBegin, bsEnd, header))
+    {
+      return false;
+    }
 
     // Ensure that the reported size of the entry does not exceed the
     // length of the byte stream
-    It valueEnd = valueBegin + header.size;
-    if (bsEnd < valueEnd)
+    if (distance(bsBegin, bsEnd) < static_cast<ItDiff>(header.size))
     {
-      throw range_error("Payload with incorrect size.");
+      return false;
     }
+    const It valueBegin = bsBegin;
+    const It valueEnd = valueBegin + static_cast<ItDiff>(header.size);
 
     // The next entry will start at the end of this one
     bsBegin = valueEnd;
 
-    // Use the appropriate handler for this entry, if available
-    auto handlerIt = map.find(header.key);
-    if (handlerIt != end(map))
+    if (!handler(header.key, valueBegin, valueEnd))
     {
-      handlerIt->second(std::move(valueBegin), std::move(valueEnd));
+      return false;
     }
   }
+  return true;
 }
 
 } // namespace detail
@@ -237,7 +249,10 @@ struct PayloadBuilder<>
   }
 };
 
-// Parse payloads to values
+// Parse payloads to values. The handler for an entry is selected by
+// comparing the entry key against the keys of the given entry types,
+// which is resolved at compile time. Entries without a corresponding
+// entry type are ignored.
 template <typename... Entries>
 struct ParsePayload;
 
@@ -245,33 +260,35 @@ template <typename First, typename... Rest>
 struct ParsePayload<First, Rest...>
 {
   template <typename It, typename... Handlers>
-  static void parse(It begin, It end, Handlers... handlers)
+  static bool tryParse(It begin, It end, Handlers... handlers)
   {
-    detail::HandlerMap<It> map;
-    collectHandlers(map, std::move(handlers)...);
-    detail::parseByteStream(map, std::move(begin), std::move(end));
+    return detail::tryParseByteStream(std::move(begin), std::move(end),
+      [&](const PayloadEntryHeader::Key key, const It valueBegin, const It valueEnd) {
+        return handleEntry(key, valueBegin, valueEnd, handlers...);
+      });
   }
 
+  // An entry of a known type must consume exactly the bytes of its value
   template <typename It, typename FirstHandler, typename... RestHandlers>
-  static void collectHandlers(
-    detail::HandlerMap<It>& map, FirstHandler handler, RestHandlers... rest)
+  static bool handleEntry(const PayloadEntryHeader::Key key,
+    const It begin,
+    const It end,
+    FirstHandler& handler,
+    RestHandlers&... rest)
   {
-    using namespace std;
-    map[First::key] = [handler](const It begin, const It end) {
-      const auto res = First::fromNetworkByteStream(begin, end);
-      if (res.second != end)
-      {
-        std::ostringstream stringStream;
-        stringStream << "Parsing payload entry " << First::key
-                     << " did not consume the expected number of bytes. "
-                     << " Expected: " << distance(begin, end)
-                     << ", Actual: " << distance(begin, res.second);
-        throw range_error(stringStream.str());
-      }
-      handler(res.first);
-    };
-
-    ParsePayload<Rest...>::collectHandlers(map, std::move(rest)...);
+    if (key != First::key)
+    {
+      return ParsePayload<Rest...>::handleEntry(key, begin, end, rest...);
+    }
+
+    First value{};
+    auto valueEnd = begin;
+    if (!tryDeserialize(valueEnd, end, value) || valueEnd != end)
+    {
+      return false;
+    }
+    handler(std::move(value));
+    return true;
   }
 };
 
@@ -279,18 +296,31 @@ template <>
 struct ParsePayload<>
 {
   template <typename It>
-  static void collectHandlers(detail::HandlerMap<It>&)
+  static bool handleEntry(const PayloadEntryHeader::Key, const It, const It)
   {
+    return true;
   }
 };
 
+// Returns false if the payload is malformed, without throwing. Note that the
+// handlers may already have been called for some entries in that case.
 template <typename... Entries, typename It, typename... Handlers>
-void parsePayload(It begin, It end, Handlers... handlers)
+bool tryParsePayload(It begin, It end, Handlers... handlers)
 {
-  using namespace std;
-  ParsePayload<Entries...>::parse(
+  return ParsePayload<Entries...>::tryParse(
     std::move(begin), std::move(end), std::move(handlers)...);
 }
 
+// Throws std::range_error if the payload is malformed
+template <typename... Entries, typename It, typename... Handlers>
+void parsePayload(It begin, It end, Handlers... handlers)
+{
+  if (!tryParsePayload<Entries...>(
+        std::move(begin), std::move(end), std::move(handlers)...))
+  {
+    LINK_THROW(std::range_error("Parsing payload failed"));
+  }
+}
+
 } // namespace discovery
 } // namespace ableton
@@ -19,10 +19,16 @@
 
 #pragma once
 
+#include <ableton/discovery/StateBroadcast.hpp>
 #include <ableton/discovery/UdpMessenger.hpp>
 #include <ableton/discovery/v1/Messages.hpp>
+#include <ableton/util/Exceptions.hpp>
+#include <ableton/util/Footprint.hpp>
+#include <ableton/util/Log.hpp>
 #include <ableton/util/SafeAsyncHandler.hpp>
+#include <algorithm>
 #include <memory>
+#include <unordered_map>
 
 namespace ableton
 {
@@ -41,10 +47,17 @@ public:
   using Timer = typename util::Injected<IoContext>::type::Timer;
   using TimerError = typename Timer::ErrorCode;
 
+  // Default maximum number of peers. If a new peer is seen when the maximum is
+  // reached, the peer that has been heard from least recently times out. With a
+  // static footprint, it's also the most peers a gateway can have.
+  static const std::size_t kDefaultMaxPeers =
+    util::kStaticFootprint ? util::kMaxPeers : 1024;
+
   PeerGateway(util::Injected<Messenger> messenger,
     util::Injected<PeerObserver> observer,
-    util::Injected<IoContext> io)
-    : mpImpl(new Impl(std::move(messenger), std::move(observer), std::move(io)))
+    util::Injected<IoContext> io,
+    const std::size_t maxPeers = kDefaultMaxPeers)
+    : mpImpl(new Impl(std::move(messenger), std::move(observer), std::move(io), maxPeers))
   {
     mpImpl->listen();
   }
@@ -57,120 +70,338 @@ public:
   {
   }
 
-  void updateState(NodeState state)
+  void updateState(
+    NodeState state, const StateBroadcast broadcast = StateBroadcast::Normal)
+  {
+    mpImpl->updateState(std::move(state), broadcast);
+  }
+
+  // A suspended gateway leaves its peers and stops announcing the node, but keeps
+  // its messenger. The known peers are reported as having left. Resuming announces
+  // the current state right away.
+  void suspend(const bool bSuspend)
+  {
+    mpImpl->suspend(bSuspend);
+  }
+
+  // Switching to listening only says bye bye to the peers and switching back
+  // announces the current state right away, see BroadcastPolicy
+  void setBroadcastPolicy(const BroadcastPolicy policy)
+  {
+    util::invokeCatching<std::runtime_error>(
+      [this, policy] { mpImpl->mMessenger->setBroadcastPolicy(policy); },
+      [this](const std::runtime_error& err) {
+        LINK_INFO(mpImpl->mIo->log())
+          << "Changing the broadcast policy of gateway failed: " << err.what();
+      });
+  }
+
+  void setUnicastPeers(std::vector<asio::ip::udp::endpoint> peers)
+  {
+    mpImpl->mMessenger->setUnicastPeers(std::move(peers));
+  }
+
+  void announceTo(const asio::ip::udp::endpoint& to)
   {
-    mpImpl->updateState(std::move(state));
+    util::invokeCatching<std::runtime_error>(
+      [this, &to] { mpImpl->mMessenger->announceTo(to); },
+      [this, &to](const std::runtime_error& err) {
+        LINK_INFO(mpImpl->mIo->log())
+          << "Announcing to " << to << " failed: " << err.what();
+      });
   }
 
 private:
-  using PeerTimeout = std::pair<std::chrono::system_clock::time_point, NodeId>;
-  using PeerTimeouts = std::vector<PeerTimeout>;
+  using TimePoint = typename Timer::TimePoint;
+  using PeerTimeout = std::pair<TimePoint, NodeId>;
+
+  // Binary min heap of peer timeouts with an index from peer id to heap position,
+  // so that the timeout of a peer can be found in constant time and updated or
+  // removed in logarithmic time.
+  class PeerTimeouts
+  {
+  public:
+    bool empty() const
+    {
+      return mHeap.empty();
+    }
+
+    std::size_t size() const
+    {
+      return mHeap.size();
+    }
+
+    std::size_t max_size() const
+    {
+      return mHeap.max_size();
+    }
+
+    const PeerTimeout& earliest() const
+    {
+      return mHeap.front();
+    }
+
+    bool contains(const NodeId& peerId) const
+    {
+      return mPositions.find(peerId) != mPositions.end();
+    }
+
+    // Insert a new timeout or update the existing one of the peer
+    void set(const NodeId& peerId, const TimePoint timeout)
+    {
+      const auto it = mPositions.find(peerId);
+      if (it == mPositions.end())
+      {
+        mPositions[peerId] = mHeap.size();
+        mHeap.emplace_back(timeout, peerId);
+        siftUp(mHeap.size() - 1);
+      }
+      else
+      {
+        const auto pos = it->second;
+        const auto previous = mHeap[pos].first;
+        mHeap[pos].first = timeout;
+        if (timeout < previous)
+        {
+          siftUp(pos);
+        }
+        else
+        {
+          siftDown(pos);
+        }
+      }
+    }
+
+    void erase(const NodeId& peerId)
+    {
+      const auto it = mPositions.find(peerId);
+      if (it != mPositions.end())
+      {
+        const auto pos = it->second;
+        mPositions.erase(it);
+        removeAt(pos);
+      }
+    }
+
+    void eraseEarliest()
+    {
+      mPositions.erase(mHeap.front().second);
+      removeAt(0);
+    }
+
+  private:
+    void removeAt(const std::size_t pos)
+    {
+      const auto last = mHeap.size() - 1;
+      if (pos != last)
+      {
+        mHeap[pos] = std::move(mHeap[last]);
+        mPositions[mHeap[pos].second] = pos;
+        mHeap.pop_back();
+        siftUp(pos);
+        siftDown(pos);
+      }
+      else
+      {
+        mHeap.pop_back();
+      }
+    }
+
+    void siftUp(std::size_t pos)
+    {
+      while (pos > 0)
+      {
+        const auto parent = (pos - 1) / 2;
+        if (!(mHeap[pos].first < mHeap[parent].first))
+        {
+          break;
+        }
+        swapEntries(pos, parent);
+        pos = parent;
+      }
+    }
+
+    void siftDown(std::size_t pos)
+    {
+      for (;;)
+      {
+        const auto left = 2 * pos + 1;
+        const auto right = left + 1;
+        auto smallest = pos;
+        if (left < mHeap.size() && mHeap[left].first < mHeap[smallest].first)
+        {
+          smallest = left;
+        }
+        if (right < mHeap.size() && mHeap[right].first < mHeap[smallest].first)
+        {
+          smallest = right;
+        }
+        if (smallest == pos)
+        {
+          break;
+        }
+        swapEntries(pos, smallest);
+        pos = smallest;
+      }
+    }
+
+    void swapEntries(const std::size_t a, const std::size_t b)
+    {
+      std::swap(mHeap[a], mHeap[b]);
+      mPositions[mHeap[a].second] = a;
+      mPositions[mHeap[b].second] = b;
+    }
+
+    util::FootprintVector<PeerTimeout, kDefaultMaxPeers> mHeap;
+    util::FootprintHashMap<NodeId, std::size_t, kDefaultMaxPeers> mPositions;
+  };
 
   struct Impl : std::enable_shared_from_this<Impl>
   {
     Impl(util::Injected<Messenger> messenger,
       util::Injected<PeerObserver> observer,
-      util::Injected<IoContext> io)
+      util::Injected<IoContext> io,
+      const std::size_t maxPeers)
       : mMessenger(std::move(messenger))
       , mObserver(std::move(observer))
       , mIo(std::move(io))
       , mPruneTimer(mIo->makeTimer())
+      , mIsPruningScheduled(false)
+      , mMaxPeers((std::min)(maxPeers, mPeerTimeouts.max_size()))
     {
     }
 
-    void updateState(NodeState state)
+    void updateState(NodeState state, const StateBroadcast broadcast)
     {
       mMessenger->updateState(std::move(state));
-      try
+      if (broadcast == StateBroadcast::Deferred)
       {
-        mMessenger->broadcastState();
+        return;
       }
-      catch (const std::runtime_error& err)
+      util::invokeCatching<std::runtime_error>(
+        [this, broadcast] {
+          mMessenger->broadcastState(broadcast == StateBroadcast::Urgent);
+        },
+        [this](const std::runtime_error& err) {
+          LINK_INFO(mIo->log()) << "State broadcast failed on gateway: " << err.what();
+        });
+    }
+
+    void suspend(const bool bSuspend)
+    {
+      if (bSuspend)
       {
-        info(mIo->log()) << "State broadcast failed on gateway: " << err.what();
+        mPruneTimer.cancel();
+        mIsPruningScheduled = false;
+        while (!mPeerTimeouts.empty())
+        {
+          const auto peerId = mPeerTimeouts.earliest().second;
+          mPeerTimeouts.eraseEarliest();
+          peerLeft(*mObserver, peerId);
+        }
       }
+
+      util::invokeCatching<std::runtime_error>(
+        [this, bSuspend] { mMessenger->suspend(bSuspend); },
+        [this](const std::runtime_error& err) {
+          LINK_INFO(mIo->log())
+            << "Suspending or resuming gateway failed: " << err.what();
+        });
     }
 
+    // The gateway stays the handler of the messenger for as long as it exists
     void listen()
     {
-      mMessenger->receive(util::makeAsyncSafe(this->shared_from_this()));
+      mMessenger->listen(util::makeAsyncSafe(this->shared_from_this()));
     }
 
     // Operators for handling incoming messages
     void operator()(const PeerState<NodeState>& msg)
     {
       onPeerState(msg.peerState, msg.ttl);
-      listen();
     }
 
     void operator()(const ByeBye<NodeId>& msg)
     {
       onByeBye(msg.peerId);
-      listen();
     }
 
     void onPeerState(const NodeState& nodeState, const int ttl)
     {
-      using namespace std;
       const auto peerId = nodeState.ident();
-      const auto existing = findPeer(peerId);
-      if (existing != end(mPeerTimeouts))
+      if (!mPeerTimeouts.contains(peerId))
       {
-        // If the peer is already present in our timeout list, remove it
-        // as it will be re-inserted below.
-        mPeerTimeouts.erase(existing);
+        if (mMaxPeers == 0)
+        {
+          return;
+        }
+        if (mPeerTimeouts.size() >= mMaxPeers)
+        {
+          // The earliest timeout belongs to the peer heard from least recently
+          const auto evictedId = mPeerTimeouts.earliest().second;
+          mPeerTimeouts.eraseEarliest();
+          LINK_INFO(mIo->log()) << "evicting peer " << evictedId;
+          peerTimedOut(*mObserver, evictedId);
+        }
       }
 
-      auto newTo = make_pair(mPruneTimer.now() + std::chrono::seconds(ttl), peerId);
-      mPeerTimeouts.insert(
-        upper_bound(begin(mPeerTimeouts), end(mPeerTimeouts), newTo, TimeoutCompare{}),
-        std::move(newTo));
+      const auto timeout = mPruneTimer.now() + std::chrono::seconds(ttl);
+      mPeerTimeouts.set(peerId, timeout);
 
       sawPeer(*mObserver, nodeState);
-      scheduleNextPruning();
+
+      // Refreshing a timeout only moves it later, in which case the scheduled
+      // pruning will find the peer alive and reschedule. The timer only needs to
+      // be re-armed if this timeout expires before the scheduled pruning.
+      if (!mIsPruningScheduled || pruneTime(timeout) < mScheduledPruneTime)
+      {
+        scheduleNextPruning();
+      }
     }
 
     void onByeBye(const NodeId& peerId)
     {
-      const auto it = findPeer(peerId);
-      if (it != mPeerTimeouts.end())
+      if (mPeerTimeouts.contains(peerId))
       {
-        peerLeft(*mObserver, it->second);
-        mPeerTimeouts.erase(it);
+        peerLeft(*mObserver, peerId);
+        mPeerTimeouts.erase(peerId);
       }
     }
 
     void pruneExpiredPeers()
     {
-      using namespace std;
-
-      const auto test = make_pair(mPruneTimer.now(), NodeId{});
-      debug(mIo->log()) << "pruning peers @ " << test.first.time_since_epoch().count();
-
-      const auto endExpired =
-        lower_bound(begin(mPeerTimeouts), end(mPeerTimeouts), test, TimeoutCompare{});
+      const auto now = mPruneTimer.now();
+      LINK_DEBUG(mIo->log()) << "pruning peers @ " << now.time_since_epoch().count();
 
-      for_each(begin(mPeerTimeouts), endExpired, [this](const PeerTimeout& pto) {
-        info(mIo->log()) << "pruning peer " << pto.second;
-        peerTimedOut(*mObserver, pto.second);
-      });
-      mPeerTimeouts.erase(begin(mPeerTimeouts), endExpired);
+      while (!mPeerTimeouts.empty() && mPeerTimeouts.earliest().first < now)
+      {
+        const auto peerId = mPeerTimeouts.earliest().second;
+        mPeerTimeouts.eraseEarliest();
+        LINK_INFO(mIo->log()) << "pruning peer " << peerId;
+        peerTimedOut(*mObserver, peerId);
+      }
       scheduleNextPruning();
     }
 
+    // Add a second of padding to the timer to avoid over-eager timeouts
+    static TimePoint pruneTime(const TimePoint timeout)
+    {
+      return timeout + std::chrono::seconds(1);
+    }
+
     void scheduleNextPruning()
     {
       // Find the next peer to expire and set the timer based on it
-      if (!mPeerTimeouts.empty())
+      mIsPruningScheduled = !mPeerTimeouts.empty();
+      if (mIsPruningScheduled)
       {
-        // Add a second of padding to the timer to avoid over-eager timeouts
-        const auto t = mPeerTimeouts.front().first + std::chrono::seconds(1);
+        mScheduledPruneTime = pruneTime(mPeerTimeouts.earliest().first);
 
-        debug(mIo->log()) << "scheduling next pruning for "
-                          << t.time_since_epoch().count() << " because of peer "
-                          << mPeerTimeouts.front().second;
+        LINK_DEBUG(mIo->log()) << "scheduling next pruning for "
+                               << mScheduledPruneTime.time_since_epoch().count()
+                               << " because of peer " << mPeerTimeouts.earliest().second;
 
-        mPruneTimer.expires_at(t);
+        mPruneTimer.expires_at(mScheduledPruneTime);
         mPruneTimer.async_wait([this](const TimerError e) {
           if (!e)
           {
@@ -180,25 +411,14 @@ private:
       }
     }
 
-    struct TimeoutCompare
-    {
-      bool operator()(const PeerTimeout& lhs, const PeerTimeout& rhs) const
-      {
-        return lhs.first < rhs.first;
-      }
-    };
-
-    typename PeerTimeouts::iterator findPeer(const NodeId& peerId)
-    {
-      return std::find_if(begin(mPeerTimeouts), end(mPeerTimeouts),
-        [&peerId](const PeerTimeout& pto) { return pto.second == peerId; });
-    }
-
     util::Injected<Messenger> mMessenger;
     util::Injected<PeerObserver> mObserver;
     util::Injected<IoContext> mIo;
     Timer mPruneTimer;
-    PeerTimeouts mPeerTimeouts; // Invariant: sorted by time_point
+    PeerTimeouts mPeerTimeouts;
+    bool mIsPruningScheduled;
+    TimePoint mScheduledPruneTime;
+    std::size_t mMaxPeers;
   };
 
   std::shared_ptr<Impl> mpImpl;
@@ -208,31 +428,37 @@ template <typename Messenger, typename PeerObserver, typename IoContext>
 PeerGateway<Messenger, PeerObserver, IoContext> makePeerGateway(
   util::Injected<Messenger> messenger,
   util::Injected<PeerObserver> observer,
-  util::Injected<IoContext> io)
+  util::Injected<IoContext> io,
+  const std::size_t maxPeers =
+    PeerGateway<Messenger, PeerObserver, IoContext>::kDefaultMaxPeers)
 {
-  return {std::move(messenger), std::move(observer), std::move(io)};
+  return {std::move(messenger), std::move(observer), std::move(io), maxPeers};
 }
 
-// IpV4 gateway types
+// IP gateway types
 template <typename StateQuery, typename IoContext>
-using IpV4Messenger = UdpMessenger<
-  IpV4Interface<typename util::Injected<IoContext>::type&, v1::kMaxMessageSize>,
+using IpMessenger = UdpMessenger<
+  IpInterface<typename util::Injected<IoContext>::type&, v1::kMaxMessageSize>,
   StateQuery,
   IoContext>;
 
 template <typename PeerObserver, typename StateQuery, typename IoContext>
-using IpV4Gateway =
-  PeerGateway<IpV4Messenger<StateQuery, typename util::Injected<IoContext>::type&>,
+using IpGateway =
+  PeerGateway<IpMessenger<StateQuery, typename util::Injected<IoContext>::type&>,
     PeerObserver,
     IoContext>;
 
-// Factory function to bind a PeerGateway to an IpV4Interface with the given address.
+// Factory function to bind a PeerGateway to an IpInterface with the given address.
 template <typename PeerObserver, typename NodeState, typename IoContext>
-IpV4Gateway<PeerObserver, NodeState, IoContext> makeIpV4Gateway(
+IpGateway<PeerObserver, NodeState, IoContext> makeIpGateway(
   util::Injected<IoContext> io,
-  const asio::ip::address_v4& addr,
+  const asio::ip::address& addr,
   util::Injected<PeerObserver> observer,
-  NodeState state)
+  NodeState state,
+  const BroadcastPolicy policy = defaultBroadcastPolicy(),
+  std::shared_ptr<GatewayStats> pStats = std::make_shared<GatewayStats>(),
+  const std::size_t maxPeers =
+    IpGateway<PeerObserver, NodeState, IoContext>::kDefaultMaxPeers)
 {
   using namespace std;
   using namespace util;
@@ -240,11 +466,12 @@ IpV4Gateway<PeerObserver, NodeState, IoContext> makeIpV4Gateway(
   const uint8_t ttl = 5;
   const uint8_t ttlRatio = 20;
 
-  auto iface = makeIpV4Interface<v1::kMaxMessageSize>(injectRef(*io), addr);
+  auto iface = makeIpInterface<v1::kMaxMessageSize>(injectRef(*io), addr);
 
-  auto messenger = makeUdpMessenger(
-    injectVal(std::move(iface)), std::move(state), injectRef(*io), ttl, ttlRatio);
-  return {injectVal(std::move(messenger)), std::move(observer), std::move(io)};
+  auto messenger = makeUdpMessenger(injectVal(std::move(iface)), std::move(state),
+    injectRef(*io), ttl, ttlRatio, policy, std::move(pStats));
+  return {
+    injectVal(std::move(messenger)), std::move(observer), std::move(io), maxPeers};
 }
 
 } // namespace discovery
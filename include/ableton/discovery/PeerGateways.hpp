@@ -20,14 +20,26 @@
 #pragma once
 
 #include <ableton/discovery/InterfaceScanner.hpp>
+#include <ableton/discovery/StateBroadcast.hpp>
 #include <ableton/platforms/asio/AsioWrapper.hpp>
-#include <map>
+#include <ableton/util/Exceptions.hpp>
+#include <ableton/util/Footprint.hpp>
+#include <ableton/util/Log.hpp>
+#include <ableton/util/Trace.hpp>
 
 namespace ableton
 {
 namespace discovery
 {
 
+// Gateways are created on v4 addresses and on link-local v6 addresses. The
+// multicast group of v6 is link-local, so any other v6 address of an interface
+// would only reach the same peers again.
+inline bool isGatewayAddress(const asio::ip::address& addr)
+{
+  return addr.is_v4() || (addr.is_v6() && addr.to_v6().is_link_local());
+}
+
 // GatewayFactory must have an operator()(NodeState, IoRef, asio::ip::address)
 // that constructs a new PeerGateway on a given interface address.
 template <typename NodeState, typename GatewayFactory, typename IoContext>
@@ -38,18 +50,20 @@ public:
   using Gateway = decltype(std::declval<GatewayFactory>()(std::declval<NodeState>(),
     std::declval<util::Injected<IoType&>>(),
     std::declval<asio::ip::address>()));
-  using GatewayMap = std::map<asio::ip::address, Gateway>;
+  // With a static footprint, the interfaces beyond the capacity stay without a
+  // gateway
+  using GatewayMap =
+    util::FootprintFlatMap<asio::ip::address, Gateway, util::kMaxGateways>;
 
   PeerGateways(const std::chrono::seconds rescanPeriod,
     NodeState state,
     GatewayFactory factory,
     util::Injected<IoContext> io)
-    : mIo(std::move(io))
+    : mRescanPeriod(rescanPeriod)
+    , mIo(std::move(io))
   {
     mpScannerCallback =
       std::make_shared<Callback>(std::move(state), std::move(factory), *mIo);
-    mpScanner = std::make_shared<Scanner>(
-      rescanPeriod, util::injectShared(mpScannerCallback), util::injectRef(*mIo));
   }
 
   ~PeerGateways()
@@ -67,7 +81,30 @@ public:
   void enable(const bool bEnable)
   {
     mpScannerCallback->mGateways.clear();
-    mpScanner->enable(bEnable);
+    if (bEnable || mpScanner)
+    {
+      scanner().enable(bEnable);
+    }
+  }
+
+  // Suspending keeps the gateways and their sockets, but suspends them and stops
+  // scanning the interfaces. Resuming resumes the gateways and rescans right away,
+  // so that only the gateways of interfaces that changed in the meantime are
+  // created or removed.
+  void suspend(const bool bSuspend)
+  {
+    if (bSuspend && mpScanner)
+    {
+      mpScanner->enable(false);
+    }
+    for (const auto& entry : mpScannerCallback->mGateways)
+    {
+      entry.second->suspend(bSuspend);
+    }
+    if (!bSuspend)
+    {
+      scanner().enable(true);
+    }
   }
 
   template <typename Handler>
@@ -76,12 +113,48 @@ public:
     handler(mpScannerCallback->mGateways.begin(), mpScannerCallback->mGateways.end());
   }
 
-  void updateNodeState(const NodeState& state)
+  // Invokes the handler with the gateway on the given interface address. Returns
+  // false without invoking the handler if there is none.
+  template <typename Handler>
+  bool withGateway(const asio::ip::address& gatewayAddr, Handler handler)
+  {
+    auto& gateways = mpScannerCallback->mGateways;
+    const auto it = gateways.find(gatewayAddr);
+    if (it == gateways.end())
+    {
+      return false;
+    }
+    handler(it->second);
+    return true;
+  }
+
+  // See InterfaceScanner::setPeriod
+  void setRescanPeriod(const std::chrono::seconds period)
+  {
+    mRescanPeriod = period;
+    if (mpScanner)
+    {
+      mpScanner->setPeriod(period);
+    }
+  }
+
+  // Gateways are only created on the interfaces that pass the filter
+  void setInterfaceFilter(InterfaceFilter filter)
+  {
+    mFilter = filter;
+    if (mpScanner)
+    {
+      mpScanner->setFilter(std::move(filter));
+    }
+  }
+
+  void updateNodeState(
+    const NodeState& state, const StateBroadcast broadcast = StateBroadcast::Normal)
   {
     mpScannerCallback->mState = state;
     for (const auto& entry : mpScannerCallback->mGateways)
     {
-      entry.second->updateNodeState(state);
+      entry.second->updateNodeState(state, broadcast);
     }
   }
 
@@ -91,9 +164,11 @@ public:
   {
     if (mpScannerCallback->mGateways.erase(gatewayAddr))
     {
+      trace(
+        mIo->trace(), util::TraceEvent::GatewayRemoved, util::traceAddress(gatewayAddr));
       // If we erased a gateway, rescan again immediately so that
       // we will re-initialize it if it's still present
-      mpScanner->scan();
+      scanner().scan();
     }
   }
 
@@ -131,25 +206,30 @@ private:
       for (const auto& addr : staleAddrs)
       {
         mGateways.erase(addr);
+        trace(mIo.trace(), util::TraceEvent::GatewayRemoved, util::traceAddress(addr));
       }
 
       // Add the new addresses
       for (const auto& addr : newAddrs)
       {
-        try
-        {
-          // Only handle v4 for now
-          if (addr.is_v4())
-          {
-            info(mIo.log()) << "initializing peer gateway on interface " << addr;
-            mGateways.emplace(addr, mFactory(mState, util::injectRef(mIo), addr.to_v4()));
-          }
-        }
-        catch (const runtime_error& e)
-        {
-          warning(mIo.log()) << "failed to init gateway on interface " << addr
-                             << " reason: " << e.what();
-        }
+        util::invokeCatching<runtime_error>(
+          [this, &addr] {
+            if (mGateways.size() == mGateways.max_size())
+            {
+              LINK_WARNING(mIo.log()) << "no room for a gateway on interface " << addr;
+            }
+            else if (isGatewayAddress(addr))
+            {
+              LINK_INFO(mIo.log()) << "initializing peer gateway on interface " << addr;
+              mGateways.emplace(addr, mFactory(mState, util::injectRef(mIo), addr));
+              trace(
+                mIo.trace(), util::TraceEvent::GatewayAdded, util::traceAddress(addr));
+            }
+          },
+          [this, &addr](const runtime_error& e) {
+            LINK_WARNING(mIo.log()) << "failed to init gateway on interface " << addr
+                                    << " reason: " << e.what();
+          });
       }
     }
 
@@ -160,6 +240,22 @@ private:
   };
 
   using Scanner = InterfaceScanner<std::shared_ptr<Callback>, IoType&>;
+
+  // The scanner is only created when it's first enabled, so that discovery that is
+  // never enabled doesn't set up its timer
+  Scanner& scanner()
+  {
+    if (!mpScanner)
+    {
+      mpScanner = std::make_shared<Scanner>(
+        mRescanPeriod, util::injectShared(mpScannerCallback), util::injectRef(*mIo));
+      mpScanner->setFilter(mFilter);
+    }
+    return *mpScanner;
+  }
+
+  std::chrono::seconds mRescanPeriod;
+  InterfaceFilter mFilter;
   std::shared_ptr<Callback> mpScannerCallback;
   std::shared_ptr<Scanner> mpScanner;
   util::Injected<IoContext> mIo;
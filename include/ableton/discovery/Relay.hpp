@@ -0,0 +1,266 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/discovery/InterfaceFilter.hpp>
+#include <ableton/discovery/IpInterface.hpp>
+#include <ableton/discovery/v1/Messages.hpp>
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <ableton/util/Injected.hpp>
+#include <ableton/util/Log.hpp>
+#include <ableton/util/SafeAsyncHandler.hpp>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace ableton
+{
+namespace discovery
+{
+
+// Counters for the messages handled by a Relay
+struct RelayMetrics
+{
+  std::size_t messagesForwarded;
+  // Messages that were not forwarded because of their type or origin
+  std::size_t messagesDropped;
+};
+
+// Repeats the announcements of peers between the networks of several interfaces
+// and remote relays, so that a session can span routed subnets without multicast
+// routing. The alive and bye bye messages that a peer multicasts on one network
+// are multicast unchanged on all other networks and are sent to the remote
+// relays. Messages from remote relays are only repeated on the local networks.
+//
+// The peers measure each other directly, so they must be able to reach each
+// other by unicast. Responses to the repeated messages are sent to the relay and
+// are dropped, which is why peers on other networks only learn of each other
+// with the regular broadcasts. V2 messages are not repeated, as they depend on
+// these responses.
+//
+// A message is received by the multicast sockets of all interfaces on some
+// systems, so it's only repeated from the network whose subnet contains its
+// sender. Only one relay may connect the same networks, or the messages would
+// circle between the relays.
+template <typename Interface, typename NodeId, typename IoContext>
+class Relay
+{
+public:
+  struct Network
+  {
+    util::Injected<Interface> iface;
+    Subnet subnet;
+  };
+
+  Relay(std::vector<Network> networks,
+    std::vector<asio::ip::udp::endpoint> remoteRelays,
+    util::Injected<IoContext> io)
+    : mpImpl(std::make_shared<Impl>(
+        std::move(networks), std::move(remoteRelays), std::move(io)))
+  {
+    mpImpl->listen();
+  }
+
+  Relay(const Relay&) = delete;
+  Relay& operator=(const Relay&) = delete;
+
+  Relay(Relay&& rhs)
+    : mpImpl(std::move(rhs.mpImpl))
+  {
+  }
+
+  RelayMetrics metrics() const
+  {
+    return mpImpl->mMetrics;
+  }
+
+private:
+  struct Impl;
+
+  // Receives the multicast messages of one network
+  struct Port : util::EnableAsyncSafe<Port>
+  {
+    Port(Impl& relay, const std::size_t index)
+      : mRelay(relay)
+      , mIndex(index)
+    {
+    }
+
+    void listen()
+    {
+      mRelay.mNetworks[mIndex].iface->receive(
+        this->asyncSafe(), MulticastTag{});
+    }
+
+    template <typename Tag, typename It>
+    void operator()(Tag,
+      const asio::ip::udp::endpoint& from,
+      const It messageBegin,
+      const It messageEnd)
+    {
+      mRelay.receive(mIndex, from, messageBegin, messageEnd);
+      listen();
+    }
+
+    Impl& mRelay;
+    std::size_t mIndex;
+  };
+
+  struct Impl
+  {
+    Impl(std::vector<Network> networks,
+      std::vector<asio::ip::udp::endpoint> remoteRelays,
+      util::Injected<IoContext> io)
+      : mNetworks(std::move(networks))
+      , mRemoteRelays(std::move(remoteRelays))
+      , mIo(std::move(io))
+      , mMetrics{}
+    {
+      for (auto& network : mNetworks)
+      {
+        mOwnEndpoints.push_back(network.iface->endpoint());
+      }
+    }
+
+    void listen()
+    {
+      for (std::size_t i = 0; i < mNetworks.size(); ++i)
+      {
+        mPorts.push_back(std::make_shared<Port>(*this, i));
+        mPorts.back()->listen();
+      }
+    }
+
+    template <typename It>
+    void receive(const std::size_t index,
+      const asio::ip::udp::endpoint& from,
+      const It messageBegin,
+      const It messageEnd)
+    {
+      const auto origin = originOf(from);
+      const auto isFromRemoteRelay = origin == mNetworks.size();
+      if ((!isFromRemoteRelay && origin != index) || isOwnEndpoint(from)
+          || !isRepeated(messageBegin, messageEnd))
+      {
+        ++mMetrics.messagesDropped;
+        return;
+      }
+
+      const auto pData = &*messageBegin;
+      const auto numBytes =
+        static_cast<std::size_t>(std::distance(messageBegin, messageEnd));
+      for (std::size_t i = 0; i < mNetworks.size(); ++i)
+      {
+        if (i != origin)
+        {
+          send(*mNetworks[i].iface, pData, numBytes, multicastEndpointV4());
+        }
+      }
+      if (!isFromRemoteRelay)
+      {
+        for (const auto& relay : mRemoteRelays)
+        {
+          send(*mNetworks[origin].iface, pData, numBytes, relay);
+        }
+      }
+      ++mMetrics.messagesForwarded;
+    }
+
+    // The index of the network that contains the sender, or the number of
+    // networks if it's a remote relay or not known
+    std::size_t originOf(const asio::ip::udp::endpoint& from) const
+    {
+      for (std::size_t i = 0; i < mNetworks.size(); ++i)
+      {
+        if (mNetworks[i].subnet.contains(from.address()))
+        {
+          return i;
+        }
+      }
+      return mNetworks.size();
+    }
+
+    bool isOwnEndpoint(const asio::ip::udp::endpoint& from) const
+    {
+      return std::find(mOwnEndpoints.begin(), mOwnEndpoints.end(), from)
+             != mOwnEndpoints.end();
+    }
+
+    template <typename It>
+    bool isRepeated(const It messageBegin, const It messageEnd) const
+    {
+      // A malformed header parses as the empty header, which isn't repeated
+      const auto header = v1::parseMessageHeader<NodeId>(messageBegin, messageEnd).first;
+      // Messages of all groups are repeated, the peers filter them by group
+      return header.messageType == v1::kAlive || header.messageType == v1::kByeBye;
+    }
+
+    void send(Interface& iface,
+      const uint8_t* const pData,
+      const std::size_t numBytes,
+      const asio::ip::udp::endpoint& to)
+    {
+      asio::error_code ec;
+      iface.send(pData, numBytes, to, ec);
+      if (ec)
+      {
+        LINK_INFO(mIo->log()) << "Relaying to " << to << " failed: " << ec.message();
+      }
+    }
+
+    std::vector<Network> mNetworks;
+    std::vector<asio::ip::udp::endpoint> mRemoteRelays;
+    std::vector<asio::ip::udp::endpoint> mOwnEndpoints;
+    std::vector<std::shared_ptr<Port>> mPorts;
+    util::Injected<IoContext> mIo;
+    RelayMetrics mMetrics;
+  };
+
+  std::shared_ptr<Impl> mpImpl;
+};
+
+// IpV4 relay types
+template <typename NodeId, typename IoContext>
+using IpV4Relay = Relay<
+  IpInterface<typename util::Injected<IoContext>::type&, v1::kMaxMessageSize>,
+  NodeId,
+  IoContext>;
+
+// Factory function to bind a relay to the interfaces with the addresses of the
+// given subnets. The relay runs once the io context has been started.
+template <typename NodeId, typename IoContext>
+IpV4Relay<NodeId, IoContext> makeIpV4Relay(util::Injected<IoContext> io,
+  const std::vector<Subnet>& subnets,
+  std::vector<asio::ip::udp::endpoint> remoteRelays = {})
+{
+  using Relay = IpV4Relay<NodeId, IoContext>;
+  auto networks = std::vector<typename Relay::Network>{};
+  for (const auto& subnet : subnets)
+  {
+    networks.push_back(typename Relay::Network{
+      util::injectVal(makeIpInterface<v1::kMaxMessageSize>(
+        util::injectRef(*io), subnet.address)),
+      subnet});
+  }
+  return {std::move(networks), std::move(remoteRelays), std::move(io)};
+}
+
+} // namespace discovery
+} // namespace ableton
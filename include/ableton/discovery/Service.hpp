@@ -32,9 +32,15 @@ class Service
 public:
   using ServicePeerGateways = PeerGateways<NodeState, GatewayFactory, IoContext>;
 
+  // The period of the interface scans on platforms without an interface monitor
+  static std::chrono::seconds defaultRescanPeriod()
+  {
+    return std::chrono::seconds{5};
+  }
+
   Service(NodeState state, GatewayFactory factory, util::Injected<IoContext> io)
     : mGateways(
-        std::chrono::seconds(5), std::move(state), std::move(factory), std::move(io))
+        defaultRescanPeriod(), std::move(state), std::move(factory), std::move(io))
   {
   }
 
@@ -43,6 +49,11 @@ public:
     mGateways.enable(bEnable);
   }
 
+  void suspend(const bool bSuspend)
+  {
+    mGateways.suspend(bSuspend);
+  }
+
   // Asynchronously operate on the current set of peer gateways. The
   // handler will be invoked in the service's io context.
   template <typename Handler>
@@ -51,9 +62,28 @@ public:
     mGateways.withGateways(std::move(handler));
   }
 
-  void updateNodeState(const NodeState& state)
+  // Operate on the peer gateway with the given address if it exists. Returns
+  // whether the handler was invoked.
+  template <typename Handler>
+  bool withGateway(const asio::ip::address& gatewayAddr, Handler handler)
+  {
+    return mGateways.withGateway(gatewayAddr, std::move(handler));
+  }
+
+  void setInterfaceFilter(InterfaceFilter filter)
+  {
+    mGateways.setInterfaceFilter(std::move(filter));
+  }
+
+  void setRescanPeriod(const std::chrono::seconds period)
+  {
+    mGateways.setRescanPeriod(period);
+  }
+
+  void updateNodeState(
+    const NodeState& state, const StateBroadcast broadcast = StateBroadcast::Normal)
   {
-    mGateways.updateNodeState(state);
+    mGateways.updateNodeState(state, broadcast);
   }
 
   // Repair the gateway with the given address if possible. Its
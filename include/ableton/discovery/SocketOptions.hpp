@@ -0,0 +1,83 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+
+namespace ableton
+{
+namespace discovery
+{
+
+// The kinds of traffic that sockets are opened for. Timing is the ping/pong
+// exchange of the clock measurements, whose round trip times should not grow
+// with the load of the network. Discovery is everything else.
+enum class TrafficClass
+{
+  Discovery,
+  Timing,
+};
+
+// How the sockets of a traffic class are set up. Zero leaves a setting to the
+// operating system.
+struct SocketOptions
+{
+  // The differentiated services code point of the packets sent, in the upper six
+  // bits of the v4 type of service or the v6 traffic class
+  std::uint8_t dscp;
+  int receiveBufferSize;
+  int sendBufferSize;
+  // SO_PRIORITY, which selects the queue of the packets on Linux. It's set after
+  // the DSCP, which also changes it. Ignored on other platforms.
+  int priority;
+  // Lets the kernel drop the packets of the multicast socket that the messenger
+  // would ignore, e.g. its own, before they wake the io thread. Only used for
+  // discovery on Linux.
+  bool filterPackets;
+};
+
+// The policy of a context for the options of its sockets. Timing packets are
+// marked as expedited forwarding (EF), discovery packets as assured forwarding
+// (AF41). On Linux timing packets are queued ahead of all others and discovery
+// packets like unmarked ones, instead of the bulk queue that AF41 maps to. The
+// buffer sizes are left to the system. Packets are filtered in the kernel if Link is
+// built with LINK_LINUX_PACKET_FILTER. Deployments can tune this by passing a
+// policy of their own to the context.
+struct DefaultSocketOptions
+{
+  static const std::uint8_t kExpeditedForwarding = 46;
+  static const std::uint8_t kAssuredForwarding41 = 34;
+#if defined(LINK_LINUX_PACKET_FILTER)
+  static const bool kFilterPackets = true;
+#else
+  static const bool kFilterPackets = false;
+#endif
+
+  static SocketOptions options(const TrafficClass trafficClass)
+  {
+    return trafficClass == TrafficClass::Timing
+             ? SocketOptions{kExpeditedForwarding, 0, 0, 6, false}
+             : SocketOptions{kAssuredForwarding41, 0, 0, 4, kFilterPackets};
+  }
+};
+
+} // namespace discovery
+} // namespace ableton
@@ -19,14 +19,31 @@
 
 #pragma once
 
-#include <ableton/discovery/IpV4Interface.hpp>
+#include <ableton/discovery/GatewayStats.hpp>
+#include <ableton/discovery/IpInterface.hpp>
+#include <ableton/discovery/LeafCount.hpp>
 #include <ableton/discovery/MessageTypes.hpp>
+#include <ableton/discovery/PacketFilter.hpp>
 #include <ableton/discovery/v1/Messages.hpp>
+#include <ableton/discovery/v2/Messages.hpp>
 #include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <ableton/util/Exceptions.hpp>
+#include <ableton/util/Footprint.hpp>
+#include <ableton/util/Log.hpp>
+#include <ableton/util/Trace.hpp>
 #include <ableton/util/Injected.hpp>
 #include <ableton/util/SafeAsyncHandler.hpp>
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace ableton
 {
@@ -46,9 +63,37 @@ struct UdpSendException : std::runtime_error
   asio::ip::address interfaceAddr;
 };
 
-// Throws UdpSendException
+// Send an already encoded message. An error of the interface is reported
+// through ec instead of throwing, so that an interface that is going down
+// doesn't unwind the io thread for every message.
+template <typename Interface>
+void sendUdpBuffer(Interface& iface,
+  const uint8_t* const pData,
+  const size_t numBytes,
+  const asio::ip::udp::endpoint& to,
+  asio::error_code& ec)
+{
+  iface.send(pData, numBytes, to, ec);
+}
+
+// Send an already encoded message. Throws UdpSendException
+template <typename Interface>
+void sendUdpBuffer(Interface& iface,
+  const uint8_t* const pData,
+  const size_t numBytes,
+  const asio::ip::udp::endpoint& to)
+{
+  asio::error_code ec;
+  sendUdpBuffer(iface, pData, numBytes, to, ec);
+  if (ec)
+  {
+    LINK_THROW(UdpSendException{asio::system_error(ec), iface.endpoint().address()});
+  }
+}
+
+// Returns the size of the message in bytes. Throws UdpSendException
 template <typename Interface, typename NodeId, typename Payload>
-void sendUdpMessage(Interface& iface,
+std::size_t sendUdpMessage(Interface& iface,
   NodeId from,
   const uint8_t ttl,
   const v1::MessageType messageType,
@@ -61,16 +106,92 @@ void sendUdpMessage(Interface& iface,
   const auto messageEnd =
     v1::detail::encodeMessage(std::move(from), ttl, messageType, payload, messageBegin);
   const auto numBytes = static_cast<size_t>(distance(messageBegin, messageEnd));
-  try
-  {
-    iface.send(buffer.data(), numBytes, to);
-  }
-  catch (const std::runtime_error& err)
-  {
-    throw UdpSendException{err, iface.endpoint().address()};
-  }
+  sendUdpBuffer(iface, buffer.data(), numBytes, to);
+  return numBytes;
 }
 
+// Policy for broadcasting state changes of the local node.
+struct BroadcastPolicy
+{
+  // Minimum time between two broadcasts. State changes within this
+  // period are merged into a single broadcast at its end.
+  std::chrono::milliseconds minBroadcastPeriod;
+  // Don't broadcast state changes that result in the same message as the
+  // last broadcast. The state is still broadcast at the nominal rate.
+  bool skipUnchangedStates;
+  // If non-zero, alive messages of a peer are only answered with a response
+  // if the peer hasn't been sent our current state within this period.
+  // Suppressed peers still receive the regular broadcasts.
+  std::chrono::milliseconds responseSuppressionPeriod;
+  // Advertise support for v2 messages and use them with peers that advertise it
+  // as well. Multicast messages are only sent as v2 if all known peers support
+  // it. Broadcasts of an unchanged state are then sent as heartbeats.
+  bool useCompactMessages;
+  // The periodic broadcasts are spread randomly over this fraction of the nominal
+  // period around it, e.g. 0.25 for up to 12.5% earlier or later, so that peers
+  // that were started at the same time don't keep broadcasting in lockstep.
+  double periodJitter;
+  // If non-zero, the ttl and with it the broadcast period are multiplied by the
+  // number of nodes that are known on the interface, including this one, divided
+  // by this count and rounded up. The multicast traffic of a large session then
+  // stays about the same as that of a session of this size.
+  std::size_t maxNodesAtNominalPeriod;
+  // Nodes only see the nodes of their own group. Groups other than the default 0
+  // partition a network into independent sets of sessions. As v2 messages don't
+  // carry a group, they are neither sent nor accepted in other groups. Changing
+  // the group of a messenger doesn't say bye bye to the nodes of the previous
+  // group.
+  v1::SessionGroupId groupId;
+  // Only receive the states of the peers. The node is neither announced nor are
+  // the peers answered, so the peers don't know it and don't pay for its
+  // discovery. A v2 heartbeat of a peer whose state was missed is still answered
+  // with a probe of that peer. Switching on says bye bye to the peers, switching
+  // off announces the state right away.
+  bool listenOnly;
+  // If non-zero, discovery is hierarchical. Nodes that multicast their state are
+  // hubs, of which only the maxHubs known ones with the lowest ids keep doing so.
+  // The other nodes attach as leaves to one of the hubs and only send their state
+  // to it, which counts them in a LeafCount entry. A node thus receives the states
+  // of the hubs and of its own leaves instead of the states of all nodes. A node
+  // that doesn't know enough hubs with lower ids, like one that was just started,
+  // is a hub, so that the lowest ids take over within a broadcast period. Only
+  // hubs answer multicast messages. v2 messages aren't used, as they don't carry
+  // the count. All nodes of a network should use the same maxHubs.
+  std::size_t maxHubs;
+  // Urgent broadcasts, like those of a transport start, are sent right away even
+  // within minBroadcastPeriod. Up to this many of them can be sent in a burst,
+  // and one more becomes available per minBroadcastPeriod. Urgent broadcasts
+  // beyond that are delayed like the others.
+  std::size_t maxUrgentBroadcasts;
+  // If greater than 1, the ttl and with it the broadcast period are multiplied by
+  // this factor as well, e.g. to save power while an app is in the background. As
+  // the peers time the node out after the ttl it sends, they keep it all the same.
+  // Changing the factor broadcasts the state with the new ttl right away.
+  std::size_t periodFactor;
+};
+
+inline BroadcastPolicy defaultBroadcastPolicy()
+{
+  return {std::chrono::milliseconds{50}, true, std::chrono::milliseconds{0}, false, 0.,
+    0, 0, false, 0, 0, 1};
+}
+
+// Counters for the messages sent and avoided by a UdpMessenger
+struct BroadcastMetrics
+{
+  std::size_t broadcastsSent;
+  // State broadcasts that were merged into a pending broadcast
+  std::size_t broadcastsMerged;
+  // State broadcasts that were skipped because the state didn't change
+  std::size_t broadcastsSkipped;
+  std::size_t responsesSent;
+  std::size_t responsesSuppressed;
+  // Broadcasts of an unchanged state that only carried its sequence number
+  std::size_t heartbeatsSent;
+  // Urgent broadcasts that were sent within minBroadcastPeriod
+  std::size_t urgentBroadcastsSent;
+};
+
 // UdpMessenger uses a "shared_ptr pImpl" pattern to make it movable
 // and to support safe async handler callbacks when receiving messages
 // on the given interface.
@@ -84,19 +205,49 @@ public:
   using TimerError = typename Timer::ErrorCode;
   using TimePoint = typename Timer::TimePoint;
 
+  // Maximum number of peers that are remembered for v2 messages. If a new peer is
+  // seen when the maximum is reached, the peer heard from least recently is
+  // forgotten. The hubs, the leaves and the responses that are suppressed are
+  // limited to as many peers.
+  static const std::size_t kMaxKnownPeers =
+    util::kStaticFootprint ? util::kMaxPeers : 1024;
+
+  // A failed send delays the following broadcasts by this period, which doubles
+  // with each consecutive failure up to the nominal broadcast period. Interface
+  // errors, e.g. while roaming between wireless networks, then cost a few failed
+  // sends instead of one per state change.
+  static std::chrono::milliseconds minSendRetryPeriod()
+  {
+    return std::chrono::milliseconds{50};
+  }
+
+  // Number of consecutive failed sends after which the interface is considered
+  // broken. The failure is then thrown as UdpSendException, so that the gateway
+  // can be repaired. Without exceptions it's passed to handleError of the io
+  // context instead.
+  static const std::size_t kMaxSendFailures = 8;
+
   UdpMessenger(util::Injected<Interface> iface,
     NodeState state,
     util::Injected<IoContext> io,
     const uint8_t ttl,
-    const uint8_t ttlRatio)
-    : mpImpl(std::make_shared<Impl>(
-        std::move(iface), std::move(state), std::move(io), ttl, ttlRatio))
+    const uint8_t ttlRatio,
+    const BroadcastPolicy policy = defaultBroadcastPolicy(),
+    std::shared_ptr<GatewayStats> pStats = std::make_shared<GatewayStats>())
+    : mpImpl(std::make_shared<Impl>(std::move(iface),
+        std::move(state),
+        std::move(io),
+        ttl,
+        ttlRatio,
+        policy,
+        std::move(pStats)))
   {
     // We need to always listen for incoming traffic in order to
     // respond to peer state broadcasts
     mpImpl->listen(MulticastTag{});
     mpImpl->listen(UnicastTag{});
-    mpImpl->broadcastState();
+    // The peers answer the alive message right away with their states
+    mpImpl->broadcastState(false);
   }
 
   UdpMessenger(const UdpMessenger&) = delete;
@@ -109,16 +260,14 @@ public:
 
   ~UdpMessenger()
   {
-    if (mpImpl != nullptr)
+    // A suspended messenger has already said bye bye
+    if (mpImpl != nullptr && !mpImpl->mIsSuspended)
     {
-      try
-      {
-        mpImpl->sendByeBye();
-      }
-      catch (const UdpSendException& err)
-      {
-        debug(mpImpl->mIo->log()) << "Failed to send bye bye message: " << err.what();
-      }
+      util::invokeCatching<UdpSendException>([this] { mpImpl->sendByeBye(); },
+        [this](const UdpSendException& err) {
+          LINK_DEBUG(mpImpl->mIo->log())
+            << "Failed to send bye bye message: " << err.what();
+        });
     }
   }
 
@@ -127,12 +276,63 @@ public:
     mpImpl->updateState(std::move(state));
   }
 
-  // Broadcast the current state of the system to all peers. May throw
-  // std::runtime_error if assembling a broadcast message fails or if
-  // there is an error at the transport layer. Throws on failure.
-  void broadcastState()
+  // Broadcast the current state of the system to all peers. Subject to
+  // the broadcast policy, the broadcast may be delayed and merged with
+  // subsequent ones or be skipped if the state hasn't changed. May throw
+  // std::runtime_error if assembling a broadcast message fails or
+  // UdpSendException if the interface is broken, see kMaxSendFailures. An urgent
+  // broadcast isn't delayed by minBroadcastPeriod, see maxUrgentBroadcasts.
+  void broadcastState(const bool isUrgent = false)
+  {
+    mpImpl->broadcastState(isUrgent);
+  }
+
+  // May throw UdpSendException if listenOnly changes, see kMaxSendFailures
+  void setBroadcastPolicy(const BroadcastPolicy policy)
+  {
+    mpImpl->setBroadcastPolicy(policy);
+  }
+
+  // Peers or relays on networks that drop or throttle multicast. Every broadcast
+  // and bye bye is also sent to each of these endpoints, and they are sent the
+  // current state right away. Unicast messages are handled like multicast ones on
+  // receipt. Endpoints of the other address family than the interface are ignored.
+  void setUnicastPeers(std::vector<asio::ip::udp::endpoint> peers)
+  {
+    mpImpl->setUnicastPeers(std::move(peers));
+  }
+
+  // Send the current state to a single endpoint, e.g. of a peer that is known
+  // from a previous run. A peer listening there answers with its own state
+  // without waiting for the multicast broadcasts. Endpoints of the other address
+  // family than the interface are ignored. May throw UdpSendException, see
+  // kMaxSendFailures.
+  void announceTo(const asio::ip::udp::endpoint& to)
   {
-    mpImpl->broadcastState();
+    if (mpImpl->isAnnouncing() && mpImpl->isOfInterfaceFamily(to))
+    {
+      mpImpl->sendPeerState(
+        v1::kAlive, inScopeOf(mpImpl->mMulticastEndpoint.address(), to));
+    }
+  }
+
+  // A suspended messenger says bye bye to its peers and then neither broadcasts
+  // nor answers or delivers received messages, but keeps its interface open.
+  // Resuming broadcasts the current state right away, which the peers answer. May
+  // throw UdpSendException, see kMaxSendFailures.
+  void suspend(const bool bSuspend)
+  {
+    mpImpl->suspend(bSuspend);
+  }
+
+  BroadcastMetrics broadcastMetrics() const
+  {
+    return mpImpl->mMetrics;
+  }
+
+  const GatewayStats& stats() const
+  {
+    return *mpImpl->mpStats;
   }
 
   // Asynchronous receive function for incoming messages from peers. Will
@@ -142,98 +342,836 @@ public:
   template <typename Handler>
   void receive(Handler handler)
   {
-    mpImpl->setReceiveHandler(std::move(handler));
+    mpImpl->setReceiveHandler(std::move(handler), false);
+  }
+
+  // Like receive, but the handler is invoked for every message until another
+  // handler is set, so that it's not stored again for each message.
+  template <typename Handler>
+  void listen(Handler handler)
+  {
+    mpImpl->setReceiveHandler(std::move(handler), true);
   }
 
 private:
-  struct Impl : std::enable_shared_from_this<Impl>
+  struct EncodedMessage
+  {
+    v1::MessageBuffer buffer;
+    std::size_t size;
+    uint8_t ttl;
+    // See LeafCount
+    std::uint32_t numLeaves;
+    bool isValid;
+  };
+
+  struct Impl : util::EnableAsyncSafe<Impl>
   {
     Impl(util::Injected<Interface> iface,
       NodeState state,
       util::Injected<IoContext> io,
       const uint8_t ttl,
-      const uint8_t ttlRatio)
+      const uint8_t ttlRatio,
+      const BroadcastPolicy policy,
+      std::shared_ptr<GatewayStats> pStats)
       : mIo(std::move(io))
       , mInterface(std::move(iface))
+      , mMulticastEndpoint(multicastEndpoint(mInterface->endpoint().address()))
       , mState(std::move(state))
       , mTimer(mIo->makeTimer())
       , mLastBroadcastTime{}
+      , mNumSendFailures(0)
+      , mSendRetryTime{}
+      , mHasScheduledBroadcast(false)
+      , mIsSuspended(false)
+      , mPolicy(policy)
+      , mNumUrgentBroadcasts(policy.maxUrgentBroadcasts)
+      , mUrgentRefillTime(mTimer.now())
+      , mStateVersion(0)
+      , mMetrics{}
+      , mEncodedMessages{}
+      , mCompactMessages{}
+      , mHasBroadcastCompactState(false)
+      , mCompactBroadcastVersion(0)
+      , mHasMulticastState(false)
+      , mHasParentHub(false)
+      , mParentHubId{}
       , mTtl(ttl)
+      , mNominalTtl(ttl)
       , mTtlRatio(ttlRatio)
-      , mPeerStateHandler([](PeerState<NodeState>) {})
-      , mByeByeHandler([](ByeBye<NodeId>) {})
+      , mRandom(static_cast<std::minstd_rand::result_type>(
+          std::hash<NodeId>{}(mState.ident())))
+      , mpStats(std::move(pStats))
+      , mIsReceiveHandlerPersistent(false)
     {
+      updatePacketFilter();
     }
 
+    // The handler of received messages, stored with a single allocation
+    struct ReceiveHandler
+    {
+      virtual ~ReceiveHandler() = default;
+      virtual void operator()(PeerState<NodeState> state) = 0;
+      virtual void operator()(ByeBye<NodeId> byeBye) = 0;
+    };
+
+    template <typename Handler>
+    struct TypedReceiveHandler : ReceiveHandler
+    {
+      TypedReceiveHandler(Handler h)
+        : handler(std::move(h))
+      {
+      }
+
+      void operator()(PeerState<NodeState> state) override
+      {
+        handler(std::move(state));
+      }
+
+      void operator()(ByeBye<NodeId> byeBye) override
+      {
+        handler(std::move(byeBye));
+      }
+
+      Handler handler;
+    };
+
     template <typename Handler>
-    void setReceiveHandler(Handler handler)
+    void setReceiveHandler(Handler handler, const bool isPersistent)
     {
-      mPeerStateHandler = [handler](
-                            PeerState<NodeState> state) { handler(std::move(state)); };
+      mpReceiveHandler.reset(new TypedReceiveHandler<Handler>(std::move(handler)));
+      mIsReceiveHandlerPersistent = isPersistent;
+    }
+
+    template <typename Message>
+    void deliver(Message message)
+    {
+      if (!mpReceiveHandler)
+      {
+        return;
+      }
+
+      // Handlers set with receive must only be called once. The handler is taken
+      // out while it runs, as it may set another one.
+      auto pHandler = std::move(mpReceiveHandler);
+      const auto isPersistent = mIsReceiveHandlerPersistent;
+      (*pHandler)(std::move(message));
+      if (isPersistent && !mpReceiveHandler)
+      {
+        mpReceiveHandler = std::move(pHandler);
+        mIsReceiveHandlerPersistent = true;
+      }
+    }
 
-      mByeByeHandler = [handler](ByeBye<NodeId> byeBye) { handler(std::move(byeBye)); };
+    // False if the node is suspended or only listens
+    bool isAnnouncing() const
+    {
+      return !mIsSuspended && !mPolicy.listenOnly;
     }
 
     void sendByeBye()
     {
-      sendUdpMessage(
-        *mInterface, mState.ident(), 0, v1::kByeBye, makePayload(), multicastEndpoint());
+      if (mPolicy.listenOnly)
+      {
+        return;
+      }
+
+      v1::MessageBuffer buffer;
+      const auto numBytes = encodeByeBye(buffer);
+      send(buffer.data(), numBytes, mMulticastEndpoint);
+      for (const auto& peer : mUnicastPeers)
+      {
+        sendToUnicastPeer(buffer.data(), numBytes, peer);
+      }
+    }
+
+    std::size_t encodeByeBye(v1::MessageBuffer& buffer)
+    {
+      const auto messageBegin = std::begin(buffer);
+      const auto messageEnd = v1::detail::encodeMessage(
+        mState.ident(), 0, v1::kByeBye, mPolicy.groupId, makePayload(), messageBegin);
+      return static_cast<size_t>(std::distance(messageBegin, messageEnd));
+    }
+
+    bool isOfInterfaceFamily(const asio::ip::udp::endpoint& ep) const
+    {
+      return ep.address().is_v4() == mMulticastEndpoint.address().is_v4();
+    }
+
+    void setUnicastPeers(std::vector<asio::ip::udp::endpoint> peers)
+    {
+      mUnicastPeers.clear();
+      for (const auto& peer : peers)
+      {
+        if (isOfInterfaceFamily(peer))
+        {
+          mUnicastPeers.push_back(inScopeOf(mMulticastEndpoint.address(), peer));
+        }
+      }
+      if (isAnnouncing())
+      {
+        sendToUnicastPeers();
+      }
+    }
+
+    void sendToUnicastPeers()
+    {
+      const auto& message = encodedMessage(v1::kAlive);
+      for (const auto& peer : mUnicastPeers)
+      {
+        sendToUnicastPeer(message.buffer.data(), message.size, peer);
+      }
+    }
+
+    void suspend(const bool bSuspend)
+    {
+      if (bSuspend == mIsSuspended)
+      {
+        return;
+      }
+
+      mIsSuspended = bSuspend;
+      if (bSuspend)
+      {
+        mTimer.cancel();
+        mHasScheduledBroadcast = false;
+        mLastResponses.clear();
+        mKnownPeers.clear();
+        mHubs.clear();
+        mLeaves.clear();
+        mHasParentHub = false;
+        sendByeBye();
+      }
+      else
+      {
+        announce();
+      }
+    }
+
+    void setBroadcastPolicy(const BroadcastPolicy policy)
+    {
+      const auto wasListeningOnly = mPolicy.listenOnly;
+      if (policy.listenOnly && !wasListeningOnly && !mIsSuspended)
+      {
+        // The peers are kept, as their states are still received
+        mTimer.cancel();
+        mHasScheduledBroadcast = false;
+        mLastResponses.clear();
+        sendByeBye();
+      }
+
+      // Only the hubs know a leaf, so it announces itself when leaving the mode
+      const auto wasLeaf = !wasListeningOnly && !isHub();
+      const auto periodFactorChanged = policy.periodFactor != mPolicy.periodFactor;
+      mPolicy = policy;
+      invalidateEncodedMessages();
+      updatePacketFilter();
+      if (policy.maxHubs == 0)
+      {
+        mHubs.clear();
+        mLeaves.clear();
+        mHasParentHub = false;
+      }
+
+      if (!policy.listenOnly && (wasListeningOnly || (wasLeaf && isHub()))
+          && !mIsSuspended)
+      {
+        announce();
+      }
+      else if (periodFactorChanged && isAnnouncing())
+      {
+        scheduleBroadcast();
+      }
+    }
+
+    void announce()
+    {
+      // The peers have forgotten us, so nothing is skipped or delayed
+      mLastBroadcast.clear();
+      mLastBroadcastTime = TimePoint{};
+      mHasBroadcastCompactState = false;
+      broadcastState(false);
     }
 
     void updateState(NodeState state)
     {
       mState = std::move(state);
+      invalidateEncodedMessages();
+      updatePacketFilter();
+      // The version is the sequence number of v2 messages, which must not change
+      // with updates that don't change the state
+      if (mPolicy.responseSuppressionPeriod > std::chrono::milliseconds{0}
+          || compactMessagesEnabled())
+      {
+        auto message = encodeAliveMessage();
+        if (message != mLastStateMessage)
+        {
+          mLastStateMessage = std::move(message);
+          ++mStateVersion;
+        }
+      }
+      else
+      {
+        ++mStateVersion;
+      }
+    }
+
+    void broadcastState(const bool isUrgent)
+    {
+      if (!isAnnouncing())
+      {
+        return;
+      }
+
+      const auto isUrgentNow =
+        isUrgent && mNumSendFailures == 0 && hasUrgentBroadcast(mTimer.now());
+      // Changes are merged into an already scheduled broadcast
+      if (mHasScheduledBroadcast && !isUrgentNow)
+      {
+        ++mMetrics.broadcastsMerged;
+      }
+      else if (mPolicy.skipUnchangedStates && encodeAliveMessage() == mLastBroadcast)
+      {
+        ++mMetrics.broadcastsSkipped;
+      }
+      else
+      {
+        scheduleBroadcast(isUrgentNow);
+      }
     }
 
-    void broadcastState()
+    // Refills the urgent broadcasts by one per minBroadcastPeriod
+    bool hasUrgentBroadcast(const TimePoint now)
     {
       using namespace std::chrono;
 
-      const auto minBroadcastPeriod = milliseconds{50};
-      const auto nominalBroadcastPeriod = milliseconds(mTtl * 1000 / mTtlRatio);
+      if (mPolicy.maxUrgentBroadcasts == 0)
+      {
+        return false;
+      }
+      if (mPolicy.minBroadcastPeriod <= milliseconds{0})
+      {
+        return true;
+      }
+      const auto refills = static_cast<std::size_t>(
+        duration_cast<milliseconds>(now - mUrgentRefillTime).count()
+        / mPolicy.minBroadcastPeriod.count());
+      if (mNumUrgentBroadcasts + refills >= mPolicy.maxUrgentBroadcasts)
+      {
+        mNumUrgentBroadcasts = mPolicy.maxUrgentBroadcasts;
+        mUrgentRefillTime = now;
+      }
+      else
+      {
+        mNumUrgentBroadcasts += refills;
+        mUrgentRefillTime += refills * mPolicy.minBroadcastPeriod;
+      }
+      return mNumUrgentBroadcasts > 0;
+    }
+
+    void scheduleBroadcast(const bool isUrgent = false)
+    {
+      using namespace std::chrono;
+
+      adaptTtl();
+      const auto now = mTimer.now();
       const auto timeSinceLastBroadcast =
-        duration_cast<milliseconds>(mTimer.now() - mLastBroadcastTime);
+        duration_cast<milliseconds>(now - mLastBroadcastTime);
 
       // The rate is limited to maxBroadcastRate to prevent flooding the network.
-      const auto delay = minBroadcastPeriod - timeSinceLastBroadcast;
+      auto delay = mPolicy.minBroadcastPeriod - timeSinceLastBroadcast;
+      if (mNumSendFailures > 0)
+      {
+        delay = (std::max)(delay, duration_cast<milliseconds>(mSendRetryTime - now));
+      }
+      else if (isUrgent && delay >= milliseconds{1})
+      {
+        --mNumUrgentBroadcasts;
+        ++mMetrics.urgentBroadcastsSent;
+        delay = milliseconds{0};
+      }
+      mHasScheduledBroadcast = delay >= milliseconds{1};
 
       // Schedule the next broadcast before we actually send the
       // message so that if sending throws an exception we are still
       // scheduled to try again. We want to keep trying at our
       // interval as long as this instance is alive.
-      mTimer.expires_from_now(delay > milliseconds{0} ? delay : nominalBroadcastPeriod);
+      scheduleBroadcastIn(delay > milliseconds{0} ? delay : jitteredBroadcastPeriod());
+
+      // If we're not delaying, broadcast now
+      if (!mHasScheduledBroadcast)
+      {
+        LINK_DEBUG(mIo->log()) << "Broadcasting state";
+        mLastBroadcast = encodeAliveMessage();
+        if (compactMessagesEnabled() && knownPeersUseCompactMessages())
+        {
+          broadcastCompactState();
+        }
+        else if (!isHub())
+        {
+          sendToParentHub();
+        }
+        else
+        {
+          mHasParentHub = false;
+          mHasMulticastState = true;
+          sendPeerState(v1::kAlive, mMulticastEndpoint);
+          mHasBroadcastCompactState = false;
+        }
+        if (mNumSendFailures > 0)
+        {
+          // Retry as soon as the backoff allows rather than at the nominal period
+          mLastBroadcast.clear();
+          mHasScheduledBroadcast = true;
+          scheduleBroadcastIn(duration_cast<milliseconds>(mSendRetryTime - mTimer.now()));
+        }
+        sendToUnicastPeers();
+        ++mMetrics.broadcastsSent;
+      }
+    }
+
+    void scheduleBroadcastIn(const std::chrono::milliseconds delay)
+    {
+      mTimer.expires_from_now(delay);
       mTimer.async_wait([this](const TimerError e) {
         if (!e)
         {
-          broadcastState();
+          scheduleBroadcast();
         }
       });
+    }
 
-      // If we're not delaying, broadcast now
-      if (delay < milliseconds{1})
+    // Peers that have received the current state with a v2 alive message before
+    // only need its sequence number. Peers that missed it ask for it with a probe.
+    void broadcastCompactState()
+    {
+      if (mHasBroadcastCompactState && mCompactBroadcastVersion == mStateVersion)
+      {
+        sendCompactPeerState(v2::kHeartbeat, mMulticastEndpoint);
+        ++mMetrics.heartbeatsSent;
+      }
+      else
+      {
+        sendCompactPeerState(v2::kAlive, mMulticastEndpoint);
+        mHasBroadcastCompactState = true;
+        mCompactBroadcastVersion = mStateVersion;
+      }
+    }
+
+    std::vector<uint8_t> encodeAliveMessage()
+    {
+      const auto& message = encodedMessage(v1::kAlive);
+      return {begin(message.buffer), begin(message.buffer) + message.size};
+    }
+
+    // The state messages only change with the state, so they are encoded
+    // once per state and message type and reused for all sends.
+    const EncodedMessage& encodedMessage(const v1::MessageType messageType)
+    {
+      using namespace std;
+      auto& message = mEncodedMessages[messageType - v1::kAlive];
+      const auto numLeaves = numAdvertisedLeaves();
+      if (!message.isValid || message.ttl != mTtl || message.numLeaves != numLeaves)
+      {
+        const auto messageBegin = begin(message.buffer);
+        const auto messageEnd =
+          compactMessagesEnabled()
+            ? v1::detail::encodeMessage(mState.ident(), mTtl, messageType,
+                mPolicy.groupId,
+                toPayload(mState)
+                  + makePayload(v2::Capabilities{v2::kCompactMessages}),
+                messageBegin)
+          : numLeaves > 0
+            ? v1::detail::encodeMessage(mState.ident(), mTtl, messageType,
+                mPolicy.groupId, toPayload(mState) + makePayload(LeafCount{numLeaves}),
+                messageBegin)
+            : v1::detail::encodeMessage(mState.ident(), mTtl, messageType,
+                mPolicy.groupId, toPayload(mState), messageBegin);
+        message.size = static_cast<size_t>(distance(messageBegin, messageEnd));
+        message.ttl = mTtl;
+        message.numLeaves = numLeaves;
+        message.isValid = true;
+      }
+      return message;
+    }
+
+    // The v2 counterpart of encodedMessage for alive, response and heartbeat
+    // messages
+    const EncodedMessage& encodedCompactMessage(const v2::MessageType messageType)
+    {
+      using namespace std;
+      auto& message = mCompactMessages[messageType == v2::kHeartbeat
+                                         ? mCompactMessages.size() - 1
+                                         : messageType - v2::kAlive];
+      if (!message.isValid || message.ttl != mTtl)
       {
-        debug(mIo->log()) << "Broadcasting state";
-        sendPeerState(v1::kAlive, multicastEndpoint());
+        const auto sequence = static_cast<v2::Sequence>(mStateVersion);
+        const auto messageBegin = begin(message.buffer);
+        const auto messageEnd =
+          messageType == v2::kHeartbeat
+            ? v2::heartbeatMessage(mState.ident(), mTtl, sequence, messageBegin)
+            : v2::detail::encodeMessage(mState.ident(), mTtl, messageType, sequence,
+                toPayload(mState), messageBegin);
+        message.size = static_cast<size_t>(distance(messageBegin, messageEnd));
+        message.ttl = mTtl;
+        message.isValid = true;
+      }
+      return message;
+    }
+
+    // Lets the interface drop the packets that would be ignored on receipt: those
+    // of other groups, our own and compact ones if we don't understand them
+    void updatePacketFilter()
+    {
+      PacketFilter filter;
+      filter.groupId = mPolicy.groupId;
+      filter.acceptsAnyGroup = false;
+      filter.acceptsCompactMessages = compactMessagesEnabled();
+      filter.ownIdent.resize(discovery::sizeInByteStream(mState.ident()));
+      discovery::toNetworkByteStream(mState.ident(), filter.ownIdent.begin());
+      if (filter != mPacketFilter)
+      {
+        mPacketFilter = std::move(filter);
+        mInterface->setPacketFilter(mPacketFilter);
+      }
+    }
+
+    bool compactMessagesEnabled() const
+    {
+      return mPolicy.useCompactMessages && mPolicy.groupId == 0 && mPolicy.maxHubs == 0;
+    }
+
+    // Nodes that multicast an alive message are hubs and nodes that send it to us
+    // alone are our leaves, see BroadcastPolicy::maxHubs
+    template <typename Tag>
+    void recordHubOrLeaf(const NodeId& peerId,
+      const Tag tag,
+      const uint8_t ttl,
+      const asio::ip::udp::endpoint& from)
+    {
+      if (mPolicy.maxHubs == 0)
+      {
+        return;
+      }
+
+      const auto expiration = mTimer.now() + std::chrono::seconds{ttl};
+      if (isMulticast(tag))
+      {
+        mLeaves.erase(peerId);
+        if (mHubs.size() < kMaxKnownPeers || mHubs.count(peerId) > 0)
+        {
+          mHubs[peerId] = Hub{from, expiration};
+        }
+      }
+      else if (mLeaves.size() < kMaxKnownPeers || mLeaves.count(peerId) > 0)
+      {
+        mLeaves[peerId] = expiration;
+      }
+    }
+
+    static bool isMulticast(MulticastTag)
+    {
+      return true;
+    }
+
+    static bool isMulticast(UnicastTag)
+    {
+      return false;
+    }
+
+    template <typename Map, typename Expiration>
+    static void pruneExpired(Map& map, const TimePoint now, Expiration expiration)
+    {
+      auto it = begin(map);
+      while (it != end(map))
+      {
+        if (expiration(it->second) <= now)
+        {
+          it = map.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+    }
+
+    // True if this node multicasts its state, see BroadcastPolicy::maxHubs
+    bool isHub()
+    {
+      if (mPolicy.maxHubs == 0)
+      {
+        return true;
+      }
+
+      pruneExpired(mHubs, mTimer.now(), [](const Hub& hub) { return hub.expiration; });
+      const auto& ownId = mState.ident();
+      const auto numLowerHubs = static_cast<std::size_t>(std::count_if(begin(mHubs),
+        end(mHubs),
+        [&ownId](const typename Hubs::value_type& hub) { return hub.first < ownId; }));
+      return numLowerHubs < mPolicy.maxHubs;
+    }
+
+    // The number of leaves that a hub counts in its messages. A leaf that has
+    // become a hub itself is not counted anymore.
+    std::uint32_t numAdvertisedLeaves()
+    {
+      if (mPolicy.maxHubs == 0 || !isHub())
+      {
+        return 0;
+      }
+
+      pruneExpired(mLeaves, mTimer.now(), [](const TimePoint t) { return t; });
+      return static_cast<std::uint32_t>(mLeaves.size());
+    }
+
+    // The hub that a leaf attaches to is chosen by a hash of both ids, which spreads
+    // the leaves over the hubs and only moves the leaves of a hub that goes away.
+    // Moving to another hub says bye bye to the previous one, so that it doesn't
+    // count the leaf anymore.
+    void sendToParentHub()
+    {
+      // A hub that becomes a leaf says bye bye to all nodes, which then don't count
+      // it twice or keep sending it their state. Its new hub knows it right after.
+      // Its own leaves move to other hubs, which count them from then on.
+      if (mHasMulticastState)
+      {
+        mHasMulticastState = false;
+        sendByeBye();
+        auto leaves = std::move(mLeaves);
+        mLeaves.clear();
+        for (const auto& leaf : leaves)
+        {
+          receiveByeBye(leaf.first);
+        }
+      }
+
+      const auto ownHash = std::hash<NodeId>{}(mState.ident());
+      const auto rank = [ownHash](const typename Hubs::value_type& hub) {
+        // The finalizer of splitmix64, so that every bit of both ids matters
+        auto hash = static_cast<std::uint64_t>(std::hash<NodeId>{}(hub.first))
+                    ^ (static_cast<std::uint64_t>(ownHash) * 0x9e3779b97f4a7c15u);
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9u;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebu;
+        return hash ^ (hash >> 31);
+      };
+      // Leaves know at least maxHubs hubs
+      const auto parentIt = std::max_element(begin(mHubs), end(mHubs),
+        [&rank](const typename Hubs::value_type& lhs,
+          const typename Hubs::value_type& rhs) { return rank(lhs) < rank(rhs); });
+
+      if (mHasParentHub && mParentHubId != parentIt->first)
+      {
+        v1::MessageBuffer buffer;
+        sendToUnicastPeer(buffer.data(), encodeByeBye(buffer), mParentHubEndpoint);
+      }
+      mHasParentHub = true;
+      mParentHubId = parentIt->first;
+      mParentHubEndpoint = parentIt->second.endpoint;
+      sendPeerState(v1::kAlive, mParentHubEndpoint);
+    }
+
+    bool isParentHub(const NodeId& peerId) const
+    {
+      return mHasParentHub && peerId == mParentHubId;
+    }
+
+    void invalidateEncodedMessages()
+    {
+      for (auto& message : mEncodedMessages)
+      {
+        message.isValid = false;
+      }
+      for (auto& message : mCompactMessages)
+      {
+        message.isValid = false;
+      }
+    }
+
+    std::chrono::milliseconds nominalBroadcastPeriod() const
+    {
+      return std::chrono::milliseconds(mTtl * 1000 / mTtlRatio);
+    }
+
+    std::chrono::milliseconds jitteredBroadcastPeriod()
+    {
+      const auto period = nominalBroadcastPeriod();
+      if (mPolicy.periodJitter <= 0.)
+      {
+        return period;
+      }
+      const auto spread = mPolicy.periodJitter * static_cast<double>(period.count());
+      auto jitter = std::uniform_real_distribution<double>{-0.5 * spread, 0.5 * spread};
+      return period + std::chrono::milliseconds{std::llround(jitter(mRandom))};
+    }
+
+    void adaptTtl()
+    {
+      const auto maxNodes = mPolicy.maxNodesAtNominalPeriod;
+      const auto numNodes = numKnownPeers() + 1;
+      const auto nodeFactor =
+        maxNodes == 0 ? std::size_t{1} : (numNodes + maxNodes - 1) / maxNodes;
+      const auto factor = nodeFactor * (std::max)(mPolicy.periodFactor, std::size_t{1});
+      mTtl = static_cast<uint8_t>(
+        (std::min)(factor * mNominalTtl, static_cast<std::size_t>(UINT8_MAX)));
+    }
+
+    void recordPacketSent(const asio::ip::udp::endpoint& to, const std::size_t numBytes)
+    {
+      GatewayStats::increment(mpStats->packetsSent);
+      trace(mIo->trace(), util::TraceEvent::PacketSent, util::traceEndpoint(to),
+        static_cast<std::uint64_t>(numBytes));
+    }
+
+    asio::error_code trySend(const uint8_t* const pData,
+      const std::size_t numBytes,
+      const asio::ip::udp::endpoint& to)
+    {
+      asio::error_code ec;
+      sendUdpBuffer(*mInterface, pData, numBytes, to, ec);
+      if (!ec)
+      {
+        recordPacketSent(to, numBytes);
+      }
+      return ec;
+    }
+
+    // Returns false if sending failed, in which case the following broadcasts are
+    // delayed, see minSendRetryPeriod
+    bool send(const uint8_t* const pData,
+      const std::size_t numBytes,
+      const asio::ip::udp::endpoint& to)
+    {
+      using namespace std::chrono;
+
+      const auto ec = trySend(pData, numBytes, to);
+      if (!ec)
+      {
+        mNumSendFailures = 0;
+        return true;
+      }
+
+      GatewayStats::increment(mpStats->sendFailures);
+      LINK_INFO(mIo->log()) << "Sending to " << to << " failed: " << ec.message();
+      if (mNumSendFailures < kMaxSendFailures)
+      {
+        ++mNumSendFailures;
+      }
+      const auto exponent = (std::min)(mNumSendFailures - 1, std::size_t{16});
+      mSendRetryTime = mTimer.now()
+                       + (std::min)(minSendRetryPeriod() * (1 << exponent),
+                         nominalBroadcastPeriod());
+      if (mNumSendFailures == kMaxSendFailures)
+      {
+        const auto error =
+          UdpSendException{asio::system_error(ec), mInterface->endpoint().address()};
+#if defined(LINK_NO_EXCEPTIONS)
+        // Passed on as if it had escaped the handler
+        mIo->handleError(error);
+#else
+        throw error;
+#endif
+      }
+      return false;
+    }
+
+    // A peer that can't be reached must not keep the others from being sent the
+    // state, so failures are only logged
+    void sendToUnicastPeer(const uint8_t* const pData,
+      const std::size_t numBytes,
+      const asio::ip::udp::endpoint& to)
+    {
+      const auto ec = trySend(pData, numBytes, to);
+      if (ec)
+      {
+        LINK_INFO(mIo->log()) << "Sending to " << to << " failed: " << ec.message();
       }
     }
 
     void sendPeerState(
       const v1::MessageType messageType, const asio::ip::udp::endpoint& to)
     {
-      sendUdpMessage(
-        *mInterface, mState.ident(), mTtl, messageType, toPayload(mState), to);
-      mLastBroadcastTime = mTimer.now();
+      const auto& message = encodedMessage(messageType);
+      if (send(message.buffer.data(), message.size, to))
+      {
+        mLastBroadcastTime = mTimer.now();
+      }
     }
 
-    void sendResponse(const asio::ip::udp::endpoint& to)
+    void sendCompactPeerState(
+      const v2::MessageType messageType, const asio::ip::udp::endpoint& to)
     {
-      sendPeerState(v1::kResponse, to);
+      const auto& message = encodedCompactMessage(messageType);
+      if (send(message.buffer.data(), message.size, to))
+      {
+        mLastBroadcastTime = mTimer.now();
+      }
+    }
+
+    void sendCompactProbe(const asio::ip::udp::endpoint& to)
+    {
+      v2::MessageBuffer buffer;
+      const auto messageBegin = std::begin(buffer);
+      const auto messageEnd = v2::probeMessage(mState.ident(), mTtl, messageBegin);
+      send(buffer.data(), static_cast<size_t>(std::distance(messageBegin, messageEnd)),
+        to);
+    }
+
+    void sendResponse(const NodeId& peerId, const asio::ip::udp::endpoint& to)
+    {
+      using namespace std::chrono;
+
+      if (mPolicy.listenOnly)
+      {
+        return;
+      }
+
+      if (mPolicy.responseSuppressionPeriod > milliseconds{0}
+          && (mLastResponses.size() < kMaxKnownPeers || mLastResponses.count(peerId) > 0))
+      {
+        const auto now = mTimer.now();
+        auto& lastResponse = mLastResponses[peerId];
+        if (lastResponse.stateVersion == mStateVersion
+            && now - lastResponse.time < mPolicy.responseSuppressionPeriod)
+        {
+          ++mMetrics.responsesSuppressed;
+          return;
+        }
+        lastResponse = {now, mStateVersion};
+        pruneLastResponses(now);
+      }
+
+      if (compactMessagesEnabled() && knownPeerUsesCompactMessages(peerId))
+      {
+        sendCompactPeerState(v2::kResponse, to);
+      }
+      else
+      {
+        sendPeerState(v1::kResponse, to);
+      }
+      ++mMetrics.responsesSent;
+    }
+
+    void pruneLastResponses(const TimePoint now)
+    {
+      // Records older than the suppression period don't suppress anything anymore
+      auto it = begin(mLastResponses);
+      while (it != end(mLastResponses))
+      {
+        if (now - it->second.time >= mPolicy.responseSuppressionPeriod)
+        {
+          it = mLastResponses.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
     }
 
     template <typename Tag>
     void listen(Tag tag)
     {
-      mInterface->receive(util::makeAsyncSafe(this->shared_from_this()), tag);
+      mInterface->receive(this->asyncSafe(), tag);
     }
 
     template <typename Tag, typename It>
@@ -242,21 +1180,47 @@ private:
       const It messageBegin,
       const It messageEnd)
     {
+      const ScopedPacketHandler packetHandler(*mpStats);
+      trace(mIo->trace(), util::TraceEvent::PacketReceived, util::traceEndpoint(from),
+        static_cast<std::uint64_t>(std::distance(messageBegin, messageEnd)));
+      if (mIsSuspended)
+      {
+        listen(tag);
+        return;
+      }
+
+      if (compactMessagesEnabled())
+      {
+        auto result = v2::parseMessageHeader<NodeId>(messageBegin, messageEnd);
+        if (result.first.messageType != v2::kInvalid)
+        {
+          receiveCompactMessage(std::move(result.first), from, result.second, messageEnd);
+          listen(tag);
+          return;
+        }
+      }
+
       auto result = v1::parseMessageHeader<NodeId>(messageBegin, messageEnd);
 
       const auto& header = result.first;
       // Ignore messages from self and other groups
-      if (header.ident != mState.ident() && header.groupId == 0)
+      if (header.ident != mState.ident() && header.groupId == mPolicy.groupId)
       {
-        debug(mIo->log()) << "Received message type "
-                          << static_cast<int>(header.messageType) << " from peer "
-                          << header.ident;
+        LINK_DEBUG(mIo->log()) << "Received message type "
+                               << static_cast<int>(header.messageType) << " from peer "
+                               << header.ident;
 
         switch (header.messageType)
         {
         case v1::kAlive:
-          sendResponse(from);
-          receivePeerState(std::move(result.first), result.second, messageEnd);
+          recordHubOrLeaf(header.ident, tag, header.ttl, from);
+          // Receiving the state first lets the handler update the state that
+          // answers the peer
+          receivePeerState(header, result.second, messageEnd);
+          if (!isMulticast(tag) || isHub())
+          {
+            sendResponse(header.ident, from);
+          }
           break;
         case v1::kResponse:
           receivePeerState(std::move(result.first), result.second, messageEnd);
@@ -265,49 +1229,322 @@ private:
           receiveByeBye(std::move(result.first.ident));
           break;
         default:
-          info(mIo->log()) << "Unknown message received of type: " << header.messageType;
+          GatewayStats::increment(mpStats->parseFailures);
+          LINK_INFO(mIo->log())
+            << "Unknown message received of type: " << header.messageType;
         }
       }
       listen(tag);
     }
 
+    template <typename It>
+    void receiveCompactMessage(v2::MessageHeader<NodeId> header,
+      const asio::ip::udp::endpoint& from,
+      const It payloadBegin,
+      const It payloadEnd)
+    {
+      if (header.ident == mState.ident())
+      {
+        return;
+      }
+
+      LINK_DEBUG(mIo->log()) << "Received v2 message type "
+                             << static_cast<int>(header.messageType) << " from peer "
+                             << header.ident;
+
+      switch (header.messageType)
+      {
+      case v2::kAlive:
+        // Receiving the state first lets the response know that the peer
+        // understands v2
+        receiveCompactPeerState(header, payloadBegin, payloadEnd);
+        sendResponse(header.ident, from);
+        break;
+      case v2::kHeartbeat:
+        sendResponse(header.ident, from);
+        receiveHeartbeat(std::move(header), from);
+        break;
+      case v2::kProbe:
+        // The peer missed our state, so an earlier response doesn't suppress this one
+        mLastResponses.erase(header.ident);
+        sendResponse(header.ident, from);
+        break;
+      case v2::kResponse:
+        receiveCompactPeerState(std::move(header), payloadBegin, payloadEnd);
+        break;
+      case v2::kByeBye:
+        receiveByeBye(std::move(header.ident));
+        break;
+      default:
+        GatewayStats::increment(mpStats->parseFailures);
+        LINK_INFO(mIo->log())
+          << "Unknown v2 message received of type: " << header.messageType;
+      }
+    }
+
     template <typename It>
     void receivePeerState(
       v1::MessageHeader<NodeId> header, It payloadBegin, It payloadEnd)
     {
-      try
+      auto state = NodeState{};
+      if (!(isParentHub(header.ident)
+              ? tryFromParentHubPayload(header.ident, payloadBegin, payloadEnd, state)
+              : NodeState::tryFromPayload(header.ident, payloadBegin, payloadEnd, state)))
+      {
+        ignorePeerState(header.ident);
+        return;
+      }
+      auto usesCompactMessages = false;
+      if (compactMessagesEnabled())
+      {
+        auto capabilities = v2::Capabilities{0};
+        if (!tryParsePayload<v2::Capabilities>(std::move(payloadBegin),
+              std::move(payloadEnd),
+              [&capabilities](const v2::Capabilities& c) { capabilities = c; }))
+        {
+          ignorePeerState(header.ident);
+          return;
+        }
+        usesCompactMessages = (capabilities.flags & v2::kCompactMessages) != 0;
+      }
+      rememberPeer(
+        std::move(header.ident), header.ttl, usesCompactMessages, false, 0, state);
+      deliverPeerState(std::move(state), header.ttl);
+    }
+
+    template <typename It>
+    void receiveCompactPeerState(
+      v2::MessageHeader<NodeId> header, const It payloadBegin, const It payloadEnd)
+    {
+      using Payload = decltype(toPayload(std::declval<NodeState>()));
+      // The parsers of the entries expect the v1 encoding
+      mPayloadBuffer.resize(v2::kMaxPayloadExpansion
+                            * static_cast<std::size_t>(
+                              std::distance(payloadBegin, payloadEnd)));
+      auto expandedEnd = mPayloadBuffer.data();
+      auto state = NodeState{};
+      if (!v2::tryExpandPayload<Payload>(payloadBegin, payloadEnd, expandedEnd)
+          || !NodeState::tryFromPayload(
+            header.ident, mPayloadBuffer.data(), expandedEnd, state))
+      {
+        ignorePeerState(header.ident);
+        return;
+      }
+      rememberPeer(
+        std::move(header.ident), header.ttl, true, true, header.sequence, state);
+      deliverPeerState(std::move(state), header.ttl);
+    }
+
+    // The hub of a leaf counts the leaf itself, which is taken out of the count of
+    // the state that is delivered, so that the counts of the hubs add up to the
+    // other nodes. The entry is appended to a copy of the payload and replaces the
+    // one of the hub when parsing it.
+    template <typename It>
+    bool tryFromParentHubPayload(
+      const NodeId& peerId, const It payloadBegin, const It payloadEnd, NodeState& state)
+    {
+      auto leafCount = LeafCount{0};
+      if (!tryParsePayload<LeafCount>(payloadBegin, payloadEnd,
+            [&leafCount](const LeafCount& entry) { leafCount = entry; }))
+      {
+        return false;
+      }
+      if (leafCount.count == 0)
+      {
+        return NodeState::tryFromPayload(peerId, payloadBegin, payloadEnd, state);
+      }
+
+      const auto others = makePayload(LeafCount{leafCount.count - 1});
+      mPayloadBuffer.assign(payloadBegin, payloadEnd);
+      const auto payloadSize = mPayloadBuffer.size();
+      mPayloadBuffer.resize(payloadSize + sizeInByteStream(others));
+      toNetworkByteStream(others,
+        mPayloadBuffer.begin()
+          + static_cast<std::vector<uint8_t>::difference_type>(payloadSize));
+      return NodeState::tryFromPayload(
+        peerId, mPayloadBuffer.cbegin(), mPayloadBuffer.cend(), state);
+    }
+
+    // Malformed payloads are dropped without throwing, as they may arrive at a high
+    // rate from misbehaving hosts
+    void ignorePeerState(const NodeId& peerId)
+    {
+      GatewayStats::increment(mpStats->parseFailures);
+      LINK_INFO(mIo->log()) << "Ignoring malformed peer state message from " << peerId;
+    }
+
+    void receiveHeartbeat(
+      v2::MessageHeader<NodeId> header, const asio::ip::udp::endpoint& from)
+    {
+      const auto it = mKnownPeers.find(header.ident);
+      if (it != end(mKnownPeers) && it->second.hasSequence
+          && it->second.sequence == header.sequence)
       {
-        auto state = NodeState::fromPayload(
-          std::move(header.ident), std::move(payloadBegin), std::move(payloadEnd));
+        it->second.expiration = mTimer.now() + std::chrono::seconds{header.ttl};
+        deliverPeerState(it->second.state, header.ttl);
+      }
+      else
+      {
+        // We have missed the state of the peer
+        sendCompactProbe(from);
+      }
+    }
+
+    void deliverPeerState(NodeState state, const uint8_t ttl)
+    {
+      deliver(PeerState<NodeState>{std::move(state), ttl});
+    }
 
-        // Handlers must only be called once
-        auto handler = std::move(mPeerStateHandler);
-        mPeerStateHandler = [](PeerState<NodeState>) {};
-        handler(PeerState<NodeState>{std::move(state), header.ttl});
+    void rememberPeer(NodeId peerId,
+      const uint8_t ttl,
+      const bool usesCompactMessages,
+      const bool hasSequence,
+      const v2::Sequence sequence,
+      NodeState state)
+    {
+      auto peer = KnownPeer{mTimer.now() + std::chrono::seconds{ttl},
+        usesCompactMessages, hasSequence, sequence, std::move(state)};
+      const auto it = mKnownPeers.find(peerId);
+      if (it == end(mKnownPeers))
+      {
+        if (mKnownPeers.size() >= kMaxKnownPeers)
+        {
+          mKnownPeers.erase(std::min_element(begin(mKnownPeers), end(mKnownPeers),
+            [](const typename KnownPeers::value_type& lhs,
+              const typename KnownPeers::value_type& rhs) {
+              return lhs.second.expiration < rhs.second.expiration;
+            }));
+        }
+        mKnownPeers.emplace(std::move(peerId), std::move(peer));
       }
-      catch (const std::runtime_error& err)
+      else
+      {
+        it->second = std::move(peer);
+      }
+    }
+
+    bool knownPeerUsesCompactMessages(const NodeId& peerId) const
+    {
+      const auto it = mKnownPeers.find(peerId);
+      return it != end(mKnownPeers) && it->second.usesCompactMessages;
+    }
+
+    // Peers that we haven't heard from within their ttl are forgotten
+    std::size_t numKnownPeers()
+    {
+      const auto now = mTimer.now();
+      auto it = begin(mKnownPeers);
+      while (it != end(mKnownPeers))
       {
-        info(mIo->log()) << "Ignoring peer state message: " << err.what();
+        if (it->second.expiration <= now)
+        {
+          it = mKnownPeers.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
       }
+      return mKnownPeers.size();
+    }
+
+    // Multicast messages must be understood by all peers
+    bool knownPeersUseCompactMessages()
+    {
+      return numKnownPeers() > 0
+             && std::all_of(begin(mKnownPeers), end(mKnownPeers),
+               [](const typename KnownPeers::value_type& entry) {
+                 return entry.second.usesCompactMessages;
+               });
     }
 
     void receiveByeBye(NodeId nodeId)
     {
-      // Handlers must only be called once
-      auto byeByeHandler = std::move(mByeByeHandler);
-      mByeByeHandler = [](ByeBye<NodeId>) {};
-      byeByeHandler(ByeBye<NodeId>{std::move(nodeId)});
+      mKnownPeers.erase(nodeId);
+      mLastResponses.erase(nodeId);
+      mHubs.erase(nodeId);
+      mLeaves.erase(nodeId);
+      if (isParentHub(nodeId))
+      {
+        mHasParentHub = false;
+      }
+      deliver(ByeBye<NodeId>{std::move(nodeId)});
     }
 
     util::Injected<IoContext> mIo;
     util::Injected<Interface> mInterface;
+    // The group of the address family of the interface
+    asio::ip::udp::endpoint mMulticastEndpoint;
     NodeState mState;
     Timer mTimer;
     TimePoint mLastBroadcastTime;
+    // Consecutive failed sends and the time until which broadcasts are delayed
+    std::size_t mNumSendFailures;
+    TimePoint mSendRetryTime;
+    std::vector<uint8_t> mLastBroadcast;
+    bool mHasScheduledBroadcast;
+    bool mIsSuspended;
+    std::vector<asio::ip::udp::endpoint> mUnicastPeers;
+    BroadcastPolicy mPolicy;
+    // The urgent broadcasts that are available and the time they were last
+    // refilled, see BroadcastPolicy::maxUrgentBroadcasts
+    std::size_t mNumUrgentBroadcasts;
+    TimePoint mUrgentRefillTime;
+    // The filter of the interface, which accepts any Link packet until it's set
+    PacketFilter mPacketFilter;
+    struct LastResponse
+    {
+      TimePoint time;
+      std::size_t stateVersion;
+    };
+    util::FootprintHashMap<NodeId, LastResponse, kMaxKnownPeers> mLastResponses;
+    std::vector<uint8_t> mLastStateMessage;
+    std::size_t mStateVersion;
+    BroadcastMetrics mMetrics;
+    // Encoded alive and response messages for the current state
+    std::array<EncodedMessage, 2> mEncodedMessages;
+    // Encoded v2 alive, response and heartbeat messages for the current state
+    std::array<EncodedMessage, 3> mCompactMessages;
+    bool mHasBroadcastCompactState;
+    std::size_t mCompactBroadcastVersion;
+    // The peers we have heard from
+    struct KnownPeer
+    {
+      TimePoint expiration;
+      bool usesCompactMessages;
+      // Heartbeats refer to the state of the last v2 message by its sequence number
+      bool hasSequence;
+      v2::Sequence sequence;
+      NodeState state;
+    };
+    using KnownPeers = util::FootprintHashMap<NodeId, KnownPeer, kMaxKnownPeers>;
+    KnownPeers mKnownPeers;
+    // The hubs and our leaves that we have heard from, see BroadcastPolicy::maxHubs
+    struct Hub
+    {
+      asio::ip::udp::endpoint endpoint;
+      TimePoint expiration;
+    };
+    using Hubs = util::FootprintHashMap<NodeId, Hub, kMaxKnownPeers>;
+    Hubs mHubs;
+    util::FootprintHashMap<NodeId, TimePoint, kMaxKnownPeers> mLeaves;
+    // Whether the last state was multicast, as a hub
+    bool mHasMulticastState;
+    // The hub that this node is a leaf of, if it's one
+    bool mHasParentHub;
+    NodeId mParentHubId;
+    asio::ip::udp::endpoint mParentHubEndpoint;
+    std::vector<uint8_t> mPayloadBuffer;
+    // The ttl of the messages, which is the nominal ttl adapted to the number of
+    // known peers, see BroadcastPolicy::maxNodesAtNominalPeriod
     uint8_t mTtl;
+    uint8_t mNominalTtl;
     uint8_t mTtlRatio;
-    std::function<void(PeerState<NodeState>)> mPeerStateHandler;
-    std::function<void(ByeBye<NodeId>)> mByeByeHandler;
+    // Draws the jitter of the broadcast period
+    std::minstd_rand mRandom;
+    std::shared_ptr<GatewayStats> mpStats;
+    std::unique_ptr<ReceiveHandler> mpReceiveHandler;
+    bool mIsReceiveHandlerPersistent;
   };
 
   std::shared_ptr<Impl> mpImpl;
@@ -320,10 +1557,17 @@ UdpMessenger<Interface, NodeState, IoContext> makeUdpMessenger(
   NodeState state,
   util::Injected<IoContext> io,
   const uint8_t ttl,
-  const uint8_t ttlRatio)
+  const uint8_t ttlRatio,
+  const BroadcastPolicy policy = defaultBroadcastPolicy(),
+  std::shared_ptr<GatewayStats> pStats = std::make_shared<GatewayStats>())
 {
-  return UdpMessenger<Interface, NodeState, IoContext>{
-    std::move(iface), std::move(state), std::move(io), ttl, ttlRatio};
+  return UdpMessenger<Interface, NodeState, IoContext>{std::move(iface),
+    std::move(state),
+    std::move(io),
+    ttl,
+    ttlRatio,
+    policy,
+    std::move(pStats)};
 }
 
 } // namespace discovery
@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <ableton/discovery/IpInterface.hpp>
+#include <ableton/discovery/PacketFilter.hpp>
+#include <ableton/util/Exceptions.hpp>
 #include <ableton/util/Log.hpp>
 
 namespace ableton
@@ -35,10 +38,30 @@ public:
     const size_t numBytes,
     const asio::ip::udp::endpoint& endpoint)
   {
-    sentMessages.push_back(
-      std::make_pair(std::vector<uint8_t>{bytes, bytes + numBytes}, endpoint));
+    asio::error_code ec;
+    send(bytes, numBytes, endpoint, ec);
+    if (ec)
+    {
+      LINK_THROW(asio::system_error(ec));
+    }
   }
 
+  // Fails with sendError if it's set, like an interface that is going down
+  void send(const uint8_t* const bytes,
+    const size_t numBytes,
+    const asio::ip::udp::endpoint& endpoint,
+    asio::error_code& ec)
+  {
+    ec = sendError;
+    if (!ec)
+    {
+      sentMessages.push_back(
+        std::make_pair(std::vector<uint8_t>{bytes, bytes + numBytes}, endpoint));
+    }
+  }
+
+  // Messages are delivered to the callback that was set last, except for those
+  // passed to incomingMulticastMessage
   template <typename Callback, typename Tag>
   void receive(Callback callback, Tag tag)
   {
@@ -46,6 +69,7 @@ public:
                   const std::vector<uint8_t>& buffer) {
       callback(tag, from, begin(buffer), end(buffer));
     };
+    storeMulticastCallback(tag);
   }
 
   template <typename It>
@@ -56,18 +80,46 @@ public:
     mCallback(from, buffer);
   }
 
+  // Delivers the message to the callback that was set for multicast messages
+  template <typename It>
+  void incomingMulticastMessage(
+    const asio::ip::udp::endpoint& from, It messageBegin, It messageEnd)
+  {
+    std::vector<uint8_t> buffer{messageBegin, messageEnd};
+    mMulticastCallback(from, buffer);
+  }
+
   asio::ip::udp::endpoint endpoint() const
   {
     return asio::ip::udp::endpoint({}, 0);
   }
 
+  void setPacketFilter(const PacketFilter& filter)
+  {
+    packetFilter = filter;
+    ++numPacketFiltersSet;
+  }
+
   using SentMessage = std::pair<std::vector<uint8_t>, asio::ip::udp::endpoint>;
   std::vector<SentMessage> sentMessages;
+  asio::error_code sendError;
+  PacketFilter packetFilter;
+  std::size_t numPacketFiltersSet = 0;
 
 private:
+  void storeMulticastCallback(MulticastTag)
+  {
+    mMulticastCallback = mCallback;
+  }
+
+  void storeMulticastCallback(UnicastTag)
+  {
+  }
+
   using ReceiveCallback =
     std::function<void(const asio::ip::udp::endpoint&, const std::vector<uint8_t>&)>;
   ReceiveCallback mCallback;
+  ReceiveCallback mMulticastCallback;
 };
 
 } // namespace test
@@ -49,6 +49,15 @@ public:
     return numBytes;
   }
 
+  std::size_t send(const uint8_t* const pData,
+    const size_t numBytes,
+    const asio::ip::udp::endpoint& to,
+    asio::error_code& ec)
+  {
+    ec = {};
+    return send(pData, numBytes, to);
+  }
+
   template <typename Handler>
   void receive(Handler handler)
   {
@@ -71,6 +80,11 @@ public:
     return asio::ip::udp::endpoint({}, 0);
   }
 
+  std::chrono::microseconds receiveDelay() const
+  {
+    return {};
+  }
+
   using SentMessage = std::pair<std::vector<uint8_t>, asio::ip::udp::endpoint>;
   std::vector<SentMessage> sentMessages;
 
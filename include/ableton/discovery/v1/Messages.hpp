@@ -20,6 +20,7 @@
 #pragma once
 
 #include <ableton/discovery/Payload.hpp>
+#include <ableton/util/Exceptions.hpp>
 #include <array>
 
 namespace ableton
@@ -67,22 +68,19 @@ struct MessageHeader
           discovery::toNetworkByteStream(header.messageType, std::move(out)))));
   }
 
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, MessageHeader& header)
+  {
+    return tryDeserialize(begin, end, header.messageType)
+           && tryDeserialize(begin, end, header.ttl)
+           && tryDeserialize(begin, end, header.groupId)
+           && tryDeserialize(begin, end, header.ident);
+  }
+
   template <typename It>
   static std::pair<MessageHeader, It> fromNetworkByteStream(It begin, const It end)
   {
-    using namespace std;
-
-    MessageHeader header;
-    tie(header.messageType, begin) =
-      Deserialize<decltype(header.messageType)>::fromNetworkByteStream(begin, end);
-    tie(header.ttl, begin) =
-      Deserialize<decltype(header.ttl)>::fromNetworkByteStream(begin, end);
-    tie(header.groupId, begin) =
-      Deserialize<decltype(header.groupId)>::fromNetworkByteStream(begin, end);
-    tie(header.ident, begin) =
-      Deserialize<decltype(header.ident)>::fromNetworkByteStream(begin, end);
-
-    return make_pair(std::move(header), std::move(begin));
+    return fromNetworkByteStreamOrThrow<MessageHeader>(std::move(begin), std::move(end));
   }
 };
 
@@ -99,11 +97,12 @@ template <typename NodeId, typename Payload, typename It>
 It encodeMessage(NodeId from,
   const uint8_t ttl,
   const MessageType messageType,
+  const SessionGroupId groupId,
   const Payload& payload,
   It out)
 {
   using namespace std;
-  const MessageHeader<NodeId> header = {messageType, ttl, 0, std::move(from)};
+  const MessageHeader<NodeId> header = {messageType, ttl, groupId, std::move(from)};
   const auto messageSize =
     kProtocolHeader.size() + sizeInByteStream(header) + sizeInByteStream(payload);
 
@@ -115,10 +114,22 @@ It encodeMessage(NodeId from,
   }
   else
   {
-    throw range_error("Exceeded maximum message size");
+    LINK_THROW(range_error("Exceeded maximum message size"));
   }
 }
 
+// Encodes a message of the default group 0
+template <typename NodeId, typename Payload, typename It>
+It encodeMessage(NodeId from,
+  const uint8_t ttl,
+  const MessageType messageType,
+  const Payload& payload,
+  It out)
+{
+  return encodeMessage(std::move(from), ttl, messageType, SessionGroupId{0}, payload,
+    std::move(out));
+}
+
 } // namespace detail
 
 template <typename NodeId, typename Payload, typename It>
@@ -157,8 +168,15 @@ std::pair<MessageHeader<NodeId>, It> parseMessageHeader(It bytesBegin, const It
   if (distance(bytesBegin, bytesEnd) >= minMessageSize
       && equal(begin(detail::kProtocolHeader), end(detail::kProtocolHeader), bytesBegin))
   {
-    tie(header, bytesBegin) = MessageHeader<NodeId>::fromNetworkByteStream(
-      bytesBegin + protocolHeaderSize, bytesEnd);
+    auto headerEnd = bytesBegin + static_cast<ItDiff>(protocolHeaderSize);
+    if (tryDeserialize(headerEnd, bytesEnd, header))
+    {
+      bytesBegin = headerEnd;
+    }
+    else
+    {
+      header = {};
+    }
   }
   return make_pair(std::move(header), std::move(bytesBegin));
 }
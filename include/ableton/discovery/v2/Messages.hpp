@@ -0,0 +1,473 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/discovery/Payload.hpp>
+#include <ableton/discovery/v1/Messages.hpp>
+#include <ableton/util/Exceptions.hpp>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <type_traits>
+
+namespace ableton
+{
+namespace discovery
+{
+namespace v2
+{
+
+// A compact encoding of the discovery messages. Entry headers use a one byte tag
+// and a varint size instead of the eight bytes of v1 and states that haven't
+// changed are announced by their sequence number only. Peers advertise that they
+// understand v2 messages with a Capabilities entry in their v1 messages, so
+// that v2 is only sent to peers that can parse it.
+
+const std::size_t kMaxMessageSize = v1::kMaxMessageSize;
+using MessageBuffer = v1::MessageBuffer;
+
+using MessageType = uint8_t;
+using Sequence = uint32_t;
+
+const MessageType kInvalid = 0;
+const MessageType kAlive = 1;
+const MessageType kResponse = 2;
+const MessageType kByeBye = 3;
+const MessageType kProbe = 4;
+// An alive message without a payload. The state of the peer is the one it sent
+// with the sequence number of the header.
+const MessageType kHeartbeat = 5;
+
+// Flags of the Capabilities entry
+const uint32_t kCompactMessages = 1;
+
+// A payload entry that is appended to the v1 messages of peers that understand
+// v2 messages. Peers that don't know it ignore it.
+struct Capabilities
+{
+  static const std::int32_t key = 'caps';
+  static_assert(key == 0x63617073, "Unexpected byte order");
+
+  // Model the NetworkByteStreamSerializable concept
+  friend std::uint32_t sizeInByteStream(const Capabilities& capabilities)
+  {
+    return discovery::sizeInByteStream(capabilities.flags);
+  }
+
+  template <typename It>
+  friend It toNetworkByteStream(const Capabilities& capabilities, It out)
+  {
+    return discovery::toNetworkByteStream(capabilities.flags, std::move(out));
+  }
+
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, Capabilities& value)
+  {
+    return tryDeserialize(begin, end, value.flags);
+  }
+
+  template <typename It>
+  static std::pair<Capabilities, It> fromNetworkByteStream(It begin, It end)
+  {
+    return fromNetworkByteStreamOrThrow<Capabilities>(std::move(begin), std::move(end));
+  }
+
+  uint32_t flags;
+};
+
+// Unsigned LEB128 varints
+
+inline std::uint32_t sizeOfVarint(uint32_t value)
+{
+  std::uint32_t size = 1;
+  while (value >= 0x80)
+  {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+template <typename It>
+It encodeVarint(uint32_t value, It out)
+{
+  while (value >= 0x80)
+  {
+    *out++ = static_cast<uint8_t>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  *out++ = static_cast<uint8_t>(value);
+  return out;
+}
+
+// Returns false if the byte stream ends within the varint or if its value
+// exceeds 32 bits
+template <typename It>
+bool tryDecodeVarint(It& begin, const It end, uint32_t& value)
+{
+  value = 0;
+  for (unsigned shift = 0; shift < 32; shift += 7)
+  {
+    if (begin == end)
+    {
+      return false;
+    }
+    const auto byte = static_cast<uint8_t>(*begin++);
+    if (shift == 28 && byte > 0x0f)
+    {
+      return false;
+    }
+    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Throws std::range_error if the varint can't be decoded
+template <typename It>
+std::pair<uint32_t, It> decodeVarint(It begin, const It end)
+{
+  uint32_t value = 0;
+  if (!tryDecodeVarint(begin, end, value))
+  {
+    LINK_THROW(std::range_error("Parsing varint from byte stream failed"));
+  }
+  return std::make_pair(value, std::move(begin));
+}
+
+namespace detail
+{
+
+template <typename T>
+struct Void
+{
+  using type = void;
+};
+
+// Entries without a compact key are tagged with this value, followed by their
+// four byte v1 key
+const uint8_t kEscapedKey = 0;
+
+} // namespace detail
+
+// The one byte tag of an entry type in compact payloads. Entry types can define a
+// static compactKey between 1 and 127, all others are tagged by their v1 key.
+template <typename Entry, typename = void>
+struct CompactKey : std::integral_constant<uint8_t, detail::kEscapedKey>
+{
+};
+
+template <typename Entry>
+struct CompactKey<Entry, typename detail::Void<decltype(Entry::compactKey)>::type>
+  : std::integral_constant<uint8_t, Entry::compactKey>
+{
+  static_assert(Entry::compactKey > 0 && Entry::compactKey < 0x80,
+    "Compact keys must fit into a single varint byte");
+};
+
+template <typename Entry>
+std::uint32_t sizeOfCompactEntryHeader(const PayloadEntry<Entry>& entry)
+{
+  const auto tagSize = CompactKey<Entry>::value == detail::kEscapedKey
+                         ? 1 + discovery::sizeInByteStream(entry.header.key)
+                         : 1;
+  return tagSize + sizeOfVarint(entry.header.size);
+}
+
+// Payloads in the compact encoding. The values of the entries keep their v1
+// encoding.
+
+inline std::size_t sizeInCompactByteStream(const Payload<>&)
+{
+  return 0;
+}
+
+template <typename First, typename Rest>
+std::size_t sizeInCompactByteStream(const Payload<First, Rest>& payload)
+{
+  const auto& entry = payload.mFirst;
+  return (entry.empty() ? 0 : sizeOfCompactEntryHeader(entry) + entry.header.size)
+         + sizeInCompactByteStream(payload.mRest);
+}
+
+template <typename It>
+It toCompactByteStream(const Payload<>&, It out)
+{
+  return out;
+}
+
+template <typename First, typename Rest, typename It>
+It toCompactByteStream(const Payload<First, Rest>& payload, It out)
+{
+  const auto& entry = payload.mFirst;
+  if (entry.empty())
+  {
+    return toCompactByteStream(payload.mRest, std::move(out));
+  }
+  *out++ = CompactKey<First>::value;
+  if (CompactKey<First>::value == detail::kEscapedKey)
+  {
+    out = toNetworkByteStream(entry.header.key, std::move(out));
+  }
+  out = encodeVarint(entry.header.size, std::move(out));
+  return toCompactByteStream(
+    payload.mRest, toNetworkByteStream(entry.value, std::move(out)));
+}
+
+// The v1 keys of the entries of a payload type, looked up by compact key
+template <typename Payload>
+struct PayloadKeys;
+
+template <>
+struct PayloadKeys<Payload<>>
+{
+  static bool find(uint8_t, PayloadEntryHeader::Key&)
+  {
+    return false;
+  }
+};
+
+template <typename First, typename Rest>
+struct PayloadKeys<Payload<First, Rest>>
+{
+  static bool find(const uint8_t compactKey, PayloadEntryHeader::Key& key)
+  {
+    if (CompactKey<First>::value != detail::kEscapedKey
+        && compactKey == CompactKey<First>::value)
+    {
+      key = First::key;
+      return true;
+    }
+    return PayloadKeys<Rest>::find(compactKey, key);
+  }
+};
+
+// The v1 encoding of a compact payload takes at most this many bytes per
+// compact byte
+const std::size_t kMaxPayloadExpansion = 4;
+
+// Converts a compact payload into the v1 encoding of the given payload type, so
+// that it can be parsed by the parsers of the entries. Entries with compact keys
+// that are not part of the payload type are dropped. The output must provide
+// kMaxPayloadExpansion bytes for each byte of input. Returns false if the input
+// is malformed, in which case out is unspecified.
+template <typename Payload, typename It, typename OutIt>
+bool tryExpandPayload(It begin, const It end, OutIt& out)
+{
+  using namespace std;
+  using ItDiff = typename iterator_traits<It>::difference_type;
+
+  while (begin < end)
+  {
+    const auto compactKey = static_cast<uint8_t>(*begin++);
+    auto header = PayloadEntryHeader{};
+    auto isKnown = true;
+    if (compactKey == detail::kEscapedKey)
+    {
+      if (!tryDeserialize(begin, end, header.key))
+      {
+        return false;
+      }
+    }
+    else
+    {
+      isKnown = PayloadKeys<Payload>::find(compactKey, header.key);
+    }
+
+    if (!tryDecodeVarint(begin, end, header.size)
+        || distance(begin, end) < static_cast<ItDiff>(header.size))
+    {
+      return false;
+    }
+    const auto valueEnd = begin + static_cast<ItDiff>(header.size);
+    if (isKnown)
+    {
+      out = copy(begin, valueEnd, toNetworkByteStream(header, std::move(out)));
+    }
+    begin = valueEnd;
+  }
+  return true;
+}
+
+// Throws std::range_error if the input is malformed
+template <typename Payload, typename It, typename OutIt>
+OutIt expandPayload(It begin, const It end, OutIt out)
+{
+  if (!tryExpandPayload<Payload>(std::move(begin), end, out))
+  {
+    LINK_THROW(std::range_error("Payload with incorrect size."));
+  }
+  return out;
+}
+
+template <typename NodeId>
+struct MessageHeader
+{
+  MessageType messageType;
+  uint8_t ttl;
+  NodeId ident;
+  // Changes with the state of the peer
+  Sequence sequence;
+
+  friend std::uint32_t sizeInByteStream(const MessageHeader& header)
+  {
+    return discovery::sizeInByteStream(header.messageType)
+           + discovery::sizeInByteStream(header.ttl)
+           + discovery::sizeInByteStream(header.ident) + sizeOfVarint(header.sequence);
+  }
+
+  template <typename It>
+  friend It toNetworkByteStream(const MessageHeader& header, It out)
+  {
+    return encodeVarint(header.sequence,
+      discovery::toNetworkByteStream(header.ident,
+        discovery::toNetworkByteStream(header.ttl,
+          discovery::toNetworkByteStream(header.messageType, std::move(out)))));
+  }
+
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, MessageHeader& header)
+  {
+    return tryDeserialize(begin, end, header.messageType)
+           && tryDeserialize(begin, end, header.ttl)
+           && tryDeserialize(begin, end, header.ident)
+           && tryDecodeVarint(begin, end, header.sequence);
+  }
+
+  template <typename It>
+  static std::pair<MessageHeader, It> fromNetworkByteStream(It begin, const It end)
+  {
+    return fromNetworkByteStreamOrThrow<MessageHeader>(std::move(begin), std::move(end));
+  }
+};
+
+namespace detail
+{
+
+// Differs from the v1 protocol header within its first four bytes, so that v1
+// peers ignore v2 messages
+using ProtocolHeader = std::array<char, 4>;
+const ProtocolHeader kProtocolHeader = {{'_', 'a', 's', 2}};
+
+// Must have at least kMaxMessageSize bytes available in the output stream
+template <typename NodeId, typename Payload, typename It>
+It encodeMessage(NodeId from,
+  const uint8_t ttl,
+  const MessageType messageType,
+  const Sequence sequence,
+  const Payload& payload,
+  It out)
+{
+  using namespace std;
+  const MessageHeader<NodeId> header = {messageType, ttl, std::move(from), sequence};
+  const auto messageSize =
+    kProtocolHeader.size() + sizeInByteStream(header) + sizeInCompactByteStream(payload);
+
+  if (messageSize < kMaxMessageSize)
+  {
+    return toCompactByteStream(
+      payload, toNetworkByteStream(header,
+                 copy(begin(kProtocolHeader), end(kProtocolHeader), std::move(out))));
+  }
+  else
+  {
+    LINK_THROW(range_error("Exceeded maximum message size"));
+  }
+}
+
+} // namespace detail
+
+template <typename NodeId, typename Payload, typename It>
+It aliveMessage(NodeId from,
+  const uint8_t ttl,
+  const Sequence sequence,
+  const Payload& payload,
+  It out)
+{
+  return detail::encodeMessage(
+    std::move(from), ttl, kAlive, sequence, payload, std::move(out));
+}
+
+template <typename NodeId, typename Payload, typename It>
+It responseMessage(NodeId from,
+  const uint8_t ttl,
+  const Sequence sequence,
+  const Payload& payload,
+  It out)
+{
+  return detail::encodeMessage(
+    std::move(from), ttl, kResponse, sequence, payload, std::move(out));
+}
+
+template <typename NodeId, typename It>
+It heartbeatMessage(NodeId from, const uint8_t ttl, const Sequence sequence, It out)
+{
+  return detail::encodeMessage(
+    std::move(from), ttl, kHeartbeat, sequence, makePayload(), std::move(out));
+}
+
+template <typename NodeId, typename It>
+It byeByeMessage(NodeId from, It out)
+{
+  return detail::encodeMessage(
+    std::move(from), 0, kByeBye, 0, makePayload(), std::move(out));
+}
+
+template <typename NodeId, typename It>
+It probeMessage(NodeId from, const uint8_t ttl, It out)
+{
+  return detail::encodeMessage(
+    std::move(from), ttl, kProbe, 0, makePayload(), std::move(out));
+}
+
+// Returns a header with message type kInvalid if the bytes are not a v2 message
+template <typename NodeId, typename It>
+std::pair<MessageHeader<NodeId>, It> parseMessageHeader(It bytesBegin, const It bytesEnd)
+{
+  using namespace std;
+  using ItDiff = typename iterator_traits<It>::difference_type;
+
+  MessageHeader<NodeId> header = {};
+  const auto protocolHeaderSize = discovery::sizeInByteStream(detail::kProtocolHeader);
+  const auto minMessageSize =
+    static_cast<ItDiff>(protocolHeaderSize + sizeInByteStream(header));
+
+  if (distance(bytesBegin, bytesEnd) >= minMessageSize
+      && equal(begin(detail::kProtocolHeader), end(detail::kProtocolHeader), bytesBegin))
+  {
+    auto headerEnd = bytesBegin + static_cast<ItDiff>(protocolHeaderSize);
+    if (tryDeserialize(headerEnd, bytesEnd, header))
+    {
+      bytesBegin = headerEnd;
+    }
+    else
+    {
+      header = {};
+    }
+  }
+  return make_pair(std::move(header), std::move(bytesBegin));
+}
+
+} // namespace v2
+} // namespace discovery
+} // namespace ableton
@@ -0,0 +1,187 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#pragma once
+
+#include <ableton/link/Beats.hpp>
+#include <ableton/link/Phase.hpp>
+#include <ableton/link/TempoRamp.hpp>
+#include <ableton/link/Timeline.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+namespace ableton
+{
+namespace link
+{
+
+// Follows the phase encoded beats of a timeline for a given quantum at
+// consecutive sample positions. Beats and phase are derived from the
+// number of samples the cursor has been advanced by since its anchor with
+// a multiply-add, so they don't accumulate rounding errors. The timeline
+// is only evaluated again when the cursor is synced to a different one.
+// Since the cursor is restricted neither to integral times nor to integral
+// micro beats, its beats deviate from toPhaseEncodedBeats at the rounded
+// time() by less than a micro beat plus the beats of half a microsecond.
+// Until the end of a tempo ramp, the cursor is anchored on the ramp again
+// with every advance and moves on with the tempo at that point, so the
+// samples ahead of it miss the change of the tempo in between.
+
+class BeatCursor
+{
+public:
+  BeatCursor() = default;
+
+  BeatCursor(const Timeline& tl,
+    const std::chrono::microseconds time,
+    const double sampleRate,
+    const Beats quantum)
+    : BeatCursor(tl, TempoRamp{}, time, sampleRate, quantum)
+  {
+  }
+
+  BeatCursor(const Timeline& tl,
+    const TempoRamp& tempoRamp,
+    const std::chrono::microseconds time,
+    const double sampleRate,
+    const Beats quantum)
+    : mTimeline(tl)
+    , mTempoRamp(tempoRamp)
+    , mQuantum(quantum.floating())
+    , mMicrosPerSample(1e6 / sampleRate)
+    , mAnchorTime(static_cast<double>(time.count()))
+  {
+    anchor();
+  }
+
+  void advance(const std::int64_t numSamples)
+  {
+    mNumSamples += numSamples;
+    if (mIsInRamp)
+    {
+      mAnchorTime = exactTime();
+      mNumSamples = 0;
+      anchor();
+    }
+  }
+
+  // Rebase onto the given timeline and ramp at the current position of the
+  // cursor if they differ from the ones the cursor follows. Returns whether
+  // it did.
+  bool sync(const Timeline& tl, const TempoRamp& tempoRamp = TempoRamp{})
+  {
+    if (tl == mTimeline && tempoRamp == mTempoRamp)
+    {
+      return false;
+    }
+    mAnchorTime = exactTime();
+    mNumSamples = 0;
+    mTimeline = tl;
+    mTempoRamp = tempoRamp;
+    anchor();
+    return true;
+  }
+
+  double beats() const
+  {
+    return beatsAtSample(0);
+  }
+
+  double phase() const
+  {
+    return phaseAtSample(0);
+  }
+
+  // Beats and phase the given number of samples ahead of the cursor
+  double beatsAtSample(const std::int64_t sample) const
+  {
+    return mAnchorBeats + static_cast<double>(mNumSamples + sample) * mBeatsPerSample;
+  }
+
+  double phaseAtSample(const std::int64_t sample) const
+  {
+    if (mQuantum <= 0.)
+    {
+      return 0.;
+    }
+    const auto beats = beatsAtSample(sample);
+    const auto phase = beats - mQuantum * std::floor(beats * mInverseQuantum);
+    // Reciprocal multiplication may be off by one quantum at the boundaries
+    return phase < 0. ? phase + mQuantum : (phase >= mQuantum ? phase - mQuantum : phase);
+  }
+
+  std::chrono::microseconds time() const
+  {
+    return std::chrono::microseconds{std::llround(exactTime())};
+  }
+
+  double quantum() const
+  {
+    return mQuantum;
+  }
+
+private:
+  double exactTime() const
+  {
+    return mAnchorTime + static_cast<double>(mNumSamples) * mMicrosPerSample;
+  }
+
+  void anchor()
+  {
+    const auto q = Beats{mQuantum};
+    mInverseQuantum = mQuantum > 0. ? 1. / mQuantum : 0.;
+    // Like rampedTimeline, the ramp maps all times before its end
+    const auto time = std::chrono::microseconds{std::llround(mAnchorTime)};
+    mIsInRamp = mTempoRamp.isRamping() && time < mTempoRamp.endTime();
+    if (mIsInRamp)
+    {
+      const auto microsPerBeat =
+        static_cast<double>(mTempoRamp.tempoAtTime(time).microsPerBeat().count());
+      mAnchorBeats = (mTempoRamp.toBeats(time) + phaseEncodingOffset(mTimeline, q))
+                       .floating()
+                     + (mAnchorTime - static_cast<double>(time.count())) / microsPerBeat;
+      mBeatsPerSample = mMicrosPerSample / microsPerBeat;
+      return;
+    }
+
+    const auto microsPerBeat =
+      static_cast<double>(mTimeline.tempo.microsPerBeat().count());
+    // Same as toPhaseEncodedBeats, but at a time that may be fractional
+    mAnchorBeats =
+      (mTimeline.beatOrigin + phaseEncodingOffset(mTimeline, q)).floating()
+      + (mAnchorTime - static_cast<double>(mTimeline.timeOrigin.count())) / microsPerBeat;
+    mBeatsPerSample = mMicrosPerSample / microsPerBeat;
+  }
+
+  Timeline mTimeline{};
+  TempoRamp mTempoRamp{};
+  double mQuantum = 0.;
+  double mMicrosPerSample = 0.;
+  double mAnchorTime = 0.;
+  double mAnchorBeats = 0.;
+  double mBeatsPerSample = 0.;
+  double mInverseQuantum = 0.;
+  std::int64_t mNumSamples = 0;
+  bool mIsInRamp = false;
+};
+
+} // namespace link
+} // namespace ableton
@@ -28,71 +28,73 @@ namespace ableton
 namespace link
 {
 
+// The arithmetic on beats is integral and constexpr, so that it can be folded by
+// the compiler. Only the conversion from floating beats needs to round.
 struct Beats
 {
   Beats() = default;
 
-  explicit Beats(const double beats)
+  explicit Beats(const double beats) noexcept
     : mValue(std::llround(beats * 1e6))
   {
   }
 
-  explicit Beats(const std::int64_t microBeats)
+  explicit constexpr Beats(const std::int64_t microBeats) noexcept
     : mValue(microBeats)
   {
   }
 
-  double floating() const
+  constexpr double floating() const noexcept
   {
     return static_cast<double>(mValue) / 1e6;
   }
 
-  std::int64_t microBeats() const
+  constexpr std::int64_t microBeats() const noexcept
   {
     return mValue;
   }
 
-  Beats operator-() const
+  constexpr Beats operator-() const noexcept
   {
     return Beats{-mValue};
   }
 
-  friend Beats abs(const Beats b)
+  friend constexpr Beats abs(const Beats b) noexcept
   {
-    return Beats{std::abs(b.mValue)};
+    return Beats{b.mValue < 0 ? -b.mValue : b.mValue};
   }
 
-  friend Beats operator+(const Beats lhs, const Beats rhs)
+  friend constexpr Beats operator+(const Beats lhs, const Beats rhs) noexcept
   {
     return Beats{lhs.mValue + rhs.mValue};
   }
 
-  friend Beats operator-(const Beats lhs, const Beats rhs)
+  friend constexpr Beats operator-(const Beats lhs, const Beats rhs) noexcept
   {
     return Beats{lhs.mValue - rhs.mValue};
   }
 
-  friend Beats operator%(const Beats lhs, const Beats rhs)
+  friend constexpr Beats operator%(const Beats lhs, const Beats rhs) noexcept
   {
     return Beats{rhs.mValue == 0 ? 0 : (lhs.mValue % rhs.mValue)};
   }
 
-  friend bool operator<(const Beats lhs, const Beats rhs)
+  friend constexpr bool operator<(const Beats lhs, const Beats rhs) noexcept
   {
     return lhs.mValue < rhs.mValue;
   }
 
-  friend bool operator>(const Beats lhs, const Beats rhs)
+  friend constexpr bool operator>(const Beats lhs, const Beats rhs) noexcept
   {
     return lhs.mValue > rhs.mValue;
   }
 
-  friend bool operator==(const Beats lhs, const Beats rhs)
+  friend constexpr bool operator==(const Beats lhs, const Beats rhs) noexcept
   {
     return lhs.mValue == rhs.mValue;
   }
 
-  friend bool operator!=(const Beats lhs, const Beats rhs)
+  friend constexpr bool operator!=(const Beats lhs, const Beats rhs) noexcept
   {
     return lhs.mValue != rhs.mValue;
   }
@@ -109,12 +111,17 @@ struct Beats
     return discovery::toNetworkByteStream(beats.microBeats(), std::move(out));
   }
 
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, Beats& beats)
+  {
+    return discovery::tryDeserialize(begin, end, beats.mValue);
+  }
+
   template <typename It>
   static std::pair<Beats, It> fromNetworkByteStream(It begin, It end)
   {
-    auto result = discovery::Deserialize<std::int64_t>::fromNetworkByteStream(
+    return discovery::fromNetworkByteStreamOrThrow<Beats>(
       std::move(begin), std::move(end));
-    return std::make_pair(Beats{result.first}, std::move(result.second));
   }
 
 private:
@@ -0,0 +1,387 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#pragma once
+
+#include <ableton/link/Tempo.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace ableton
+{
+namespace link
+{
+
+// Hands the peer count, tempo and start/stop notifications of the io thread
+// over to the thread that invokes the user callbacks. Posting is lock-free
+// and never waits for the receiving thread. Notifications of the same kind
+// that are posted before the previous one was taken are coalesced, so the
+// receiver always sees the latest value.
+
+class CallbackMailbox
+{
+public:
+  CallbackMailbox()
+    : mPending(0)
+    , mNumPeers(0)
+    , mBpm(0.)
+    , mIsPlaying(false)
+  {
+  }
+
+  void postNumPeers(const std::size_t numPeers)
+  {
+    mNumPeers.store(numPeers, std::memory_order_relaxed);
+    mPending.fetch_or(kNumPeers, std::memory_order_release);
+  }
+
+  void postTempo(const Tempo tempo)
+  {
+    mBpm.store(tempo.bpm(), std::memory_order_relaxed);
+    mPending.fetch_or(kTempo, std::memory_order_release);
+  }
+
+  void postIsPlaying(const bool isPlaying)
+  {
+    mIsPlaying.store(isPlaying, std::memory_order_relaxed);
+    mPending.fetch_or(kIsPlaying, std::memory_order_release);
+  }
+
+  // Invoke the given handlers with the notifications posted since the last
+  // call. Returns whether there were any. Must not be called concurrently.
+  template <typename NumPeersHandler, typename TempoHandler, typename IsPlayingHandler>
+  bool take(NumPeersHandler numPeersHandler,
+    TempoHandler tempoHandler,
+    IsPlayingHandler isPlayingHandler)
+  {
+    const auto pending = mPending.exchange(0, std::memory_order_acquire);
+    if (pending & kNumPeers)
+    {
+      numPeersHandler(mNumPeers.load(std::memory_order_relaxed));
+    }
+    if (pending & kTempo)
+    {
+      tempoHandler(Tempo{mBpm.load(std::memory_order_relaxed)});
+    }
+    if (pending & kIsPlaying)
+    {
+      isPlayingHandler(mIsPlaying.load(std::memory_order_relaxed));
+    }
+    return pending != 0;
+  }
+
+private:
+  enum : unsigned
+  {
+    kNumPeers = 1,
+    kTempo = 2,
+    kIsPlaying = 4
+  };
+
+  std::atomic<unsigned> mPending;
+  std::atomic<std::size_t> mNumPeers;
+  std::atomic<double> mBpm;
+  std::atomic<bool> mIsPlaying;
+};
+
+// Limits the rate of the notifications of one kind to one per interval. A value
+// that arrives before the interval since the last delivered one has passed is held
+// back, replacing any value held before, and can be taken once the interval has
+// passed, so the receiver always ends up with the latest value. An interval of 0
+// doesn't limit anything. Not thread-safe.
+
+template <typename T>
+class RateLimiter
+{
+public:
+  using Micros = std::chrono::microseconds;
+
+  RateLimiter()
+    : mMinInterval(0)
+    , mLastDelivery(0)
+    , mHasDelivered(false)
+    , mHasHeld(false)
+  {
+  }
+
+  // A held value stays held until the new interval has passed
+  void setMinInterval(const Micros interval)
+  {
+    mMinInterval = interval;
+  }
+
+  Micros minInterval() const
+  {
+    return mMinInterval;
+  }
+
+  // Returns whether the value is to be delivered now, otherwise it's held
+  bool offer(T value, const Micros now)
+  {
+    if (isDue(now))
+    {
+      deliveredAt(now);
+      return true;
+    }
+    mHeld = std::move(value);
+    mHasHeld = true;
+    return false;
+  }
+
+  // Takes the held value if it's due
+  bool takeDue(const Micros now, T& value)
+  {
+    if (!mHasHeld || !isDue(now))
+    {
+      return false;
+    }
+    value = std::move(mHeld);
+    deliveredAt(now);
+    return true;
+  }
+
+  bool hasHeld() const
+  {
+    return mHasHeld;
+  }
+
+  // When the held value is due
+  Micros dueTime() const
+  {
+    return mLastDelivery + mMinInterval;
+  }
+
+private:
+  bool isDue(const Micros now) const
+  {
+    return !mHasDelivered || now - mLastDelivery >= mMinInterval;
+  }
+
+  void deliveredAt(const Micros now)
+  {
+    mLastDelivery = now;
+    mHasDelivered = true;
+    mHasHeld = false;
+  }
+
+  Micros mMinInterval;
+  Micros mLastDelivery;
+  bool mHasDelivered;
+  bool mHasHeld;
+  T mHeld;
+};
+
+namespace detail
+{
+
+// The number of AtomicCallback invocations that the calling thread is inside of
+inline std::size_t& callbackInvocationDepth()
+{
+  static thread_local std::size_t depth = 0;
+  return depth;
+}
+
+} // namespace detail
+
+// A callback that can be replaced while another thread invokes it. Invoking it
+// atomically loads the current callback and never waits for a callback that is
+// being replaced. Once set has returned, the replaced callback isn't running and
+// won't be invoked anymore, so that it may capture objects that are destroyed
+// right after. To that end set waits for the invocations that started before the
+// replacement, which are counted per epoch. Invocations that start during the
+// wait count towards the next epoch and don't delay it. Called from within an
+// invocation on the same thread, set doesn't wait, as it would wait for itself.
+
+template <typename Fn>
+class AtomicCallback
+{
+public:
+  AtomicCallback(Fn fn)
+    : mpFn(std::make_shared<const Fn>(std::move(fn)))
+    , mEpoch(0)
+  {
+    mNumInvocations[0] = 0;
+    mNumInvocations[1] = 0;
+  }
+
+  AtomicCallback(const AtomicCallback&) = delete;
+  AtomicCallback& operator=(const AtomicCallback&) = delete;
+
+  void set(Fn fn)
+  {
+    std::lock_guard<std::mutex> lock(mSetMutex);
+    std::atomic_store(&mpFn, std::shared_ptr<const Fn>(std::make_shared<const Fn>(
+                               std::move(fn))));
+    const auto previousEpoch = mEpoch.fetch_xor(1u);
+    if (detail::callbackInvocationDepth() == 0)
+    {
+      while (mNumInvocations[previousEpoch] > 0)
+      {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  template <typename... Args>
+  void operator()(Args&&... args) const
+  {
+    const Invocation invocation(*this);
+    const auto pFn = std::atomic_load(&mpFn);
+    (*pFn)(std::forward<Args>(args)...);
+  }
+
+private:
+  // Counts the invocation in the current epoch, also if the callback throws
+  struct Invocation
+  {
+    Invocation(const AtomicCallback& callback)
+      : mNumInvocations(callback.mNumInvocations[callback.mEpoch.load()])
+    {
+      ++mNumInvocations;
+      ++detail::callbackInvocationDepth();
+    }
+
+    ~Invocation()
+    {
+      --detail::callbackInvocationDepth();
+      --mNumInvocations;
+    }
+
+    std::atomic<std::size_t>& mNumInvocations;
+  };
+
+  std::shared_ptr<const Fn> mpFn;
+  std::mutex mSetMutex;
+  std::atomic<unsigned> mEpoch;
+  mutable std::atomic<std::size_t> mNumInvocations[2];
+};
+
+// A thread that runs a function whenever it has been notified. Notifying
+// only holds a mutex that the thread never holds while running the
+// function, so the notifying thread can't be blocked by it. The thread is
+// started on the first call to start. A notification can also be scheduled
+// for later, e.g. to deliver a value that a RateLimiter held back.
+
+class CallbackNotifier
+{
+public:
+  CallbackNotifier(std::function<void()> function)
+    : mFunction(std::move(function))
+    , mIsNotified(false)
+    , mHasDeadline(false)
+    , mIsStopped(false)
+  {
+  }
+
+  CallbackNotifier(const CallbackNotifier&) = delete;
+  CallbackNotifier& operator=(const CallbackNotifier&) = delete;
+
+  ~CallbackNotifier()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mIsStopped = true;
+    }
+    mCondition.notify_one();
+    if (mThread.joinable())
+    {
+      mThread.join();
+    }
+  }
+
+  void start()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mThread.joinable())
+    {
+      mThread = std::thread([this] { run(); });
+    }
+  }
+
+  void notify()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mIsNotified = true;
+    }
+    mCondition.notify_one();
+  }
+
+  // Runs the function once the delay has passed, unless it runs earlier anyway.
+  // Replaces a notification that was scheduled before.
+  void notifyAfter(const std::chrono::microseconds delay)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mDeadline = std::chrono::steady_clock::now() + delay;
+      mHasDeadline = true;
+    }
+    mCondition.notify_one();
+  }
+
+private:
+  void run()
+  {
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mIsStopped && !mIsNotified
+               && !(mHasDeadline && std::chrono::steady_clock::now() >= mDeadline))
+        {
+          if (mHasDeadline)
+          {
+            mCondition.wait_until(lock, mDeadline);
+          }
+          else
+          {
+            mCondition.wait(lock);
+          }
+        }
+        if (mIsStopped)
+        {
+          return;
+        }
+        mIsNotified = false;
+        mHasDeadline = false;
+      }
+      mFunction();
+    }
+  }
+
+  std::function<void()> mFunction;
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  bool mIsNotified;
+  bool mHasDeadline;
+  std::chrono::steady_clock::time_point mDeadline;
+  bool mIsStopped;
+  std::thread mThread;
+};
+
+} // namespace link
+} // namespace ableton
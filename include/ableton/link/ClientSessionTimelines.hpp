@@ -20,6 +20,7 @@
 #pragma once
 
 #include <ableton/link/GhostXForm.hpp>
+#include <ableton/link/TempoRamp.hpp>
 #include <ableton/link/Timeline.hpp>
 
 namespace ableton
@@ -99,6 +100,43 @@ inline Timeline updateSessionTimelineFromClient(const Timeline curSession,
   }
 }
 
+// Like updateClientTimelineFromSession, for a session timeline that is reached
+// through the given ramp. The client keeps the given beat at atTime, which is its
+// beat through its own ramp if it has one, so that the result is continuous with
+// the client beats when passed to sessionRampToClient along with the ramp.
+inline Timeline updateClientTimelineFromSessionRamp(const Beats clientBeatAtTime,
+  const Timeline session,
+  const TempoRamp& sessionRamp,
+  const std::chrono::microseconds atTime,
+  const GhostXForm xform)
+{
+  const auto sessionBeatAtTime =
+    rampedTimeline(session, sessionRamp).toBeats(xform.hostToGhost(atTime));
+  // As above, the time origin of the client timeline is beat 0 on the session
+  // timeline and its beat origin is the offset of the client beats
+  const auto hostBeatZero = xform.ghostToHost(session.fromBeats(Beats{INT64_C(0)}));
+  return {session.tempo, clientBeatAtTime - sessionBeatAtTime, hostBeatZero};
+}
+
+// The beats of the session are the beats of the client relative to the beat
+// origin of the client timeline, see updateSessionTimelineFromClient. Ramps are
+// converted between the two the same way.
+inline TempoRamp clientRampToSession(
+  TempoRamp ramp, const Timeline client, const GhostXForm xform)
+{
+  ramp.timeline.beatOrigin = ramp.timeline.beatOrigin - client.beatOrigin;
+  ramp.timeline.timeOrigin = xform.hostToGhost(ramp.timeline.timeOrigin);
+  return ramp;
+}
+
+inline TempoRamp sessionRampToClient(
+  TempoRamp ramp, const Timeline client, const GhostXForm xform)
+{
+  ramp.timeline.beatOrigin = ramp.timeline.beatOrigin + client.beatOrigin;
+  ramp.timeline.timeOrigin = xform.ghostToHost(ramp.timeline.timeOrigin);
+  return ramp;
+}
+
 // Shift timeline so result.toBeats(t) == client.toBeats(t) +
 // shift. This takes into account the fact that the timeOrigin
 // corresponds to beat 0 on the session timeline. Using this function
@@ -0,0 +1,167 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#pragma once
+
+#include <ableton/discovery/NetworkByteStreamSerializable.hpp>
+#include <ableton/link/GhostXForm.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace ableton
+{
+namespace link
+{
+
+// Identifies a domain of clocks that read the same time, e.g. a monotonic clock
+// since boot that all processes of a host share, or clocks on several hosts that
+// are disciplined by PTP. Zero if the domain of a clock can't be identified.
+using ClockDomainId = std::array<std::uint8_t, 16>;
+
+// The domain of clocks that follow the PTP grandmaster with the given clock
+// identity in the given PTP domain. A Clock that reads PTP time, e.g. through a
+// PTP hardware clock, can return this from clockDomainId() to let Link on other
+// hosts of the domain skip measuring it.
+inline ClockDomainId ptpClockDomainId(
+  const std::array<std::uint8_t, 8>& grandmasterIdentity, const std::uint8_t domainNumber)
+{
+  ClockDomainId id{};
+  std::copy(grandmasterIdentity.begin(), grandmasterIdentity.end(), id.begin());
+  id[grandmasterIdentity.size()] = domainNumber;
+  // Tells the id apart from those of host clocks, which are random otherwise
+  id.back() = 'P';
+  return id;
+}
+
+namespace detail
+{
+
+template <typename Clock>
+auto clockDomainId(const Clock& clock, int) -> decltype(clock.clockDomainId())
+{
+  return clock.clockDomainId();
+}
+
+template <typename Clock>
+ClockDomainId clockDomainId(const Clock&, long)
+{
+  return {};
+}
+
+} // namespace detail
+
+// The clock domain of the given clock, if it provides a clockDomainId() member
+template <typename Clock>
+ClockDomainId clockDomainId(const Clock& clock)
+{
+  return detail::clockDomainId(clock, 0);
+}
+
+// The clock domain of a peer and the ghost transform of the peer for its clock.
+// Peers in the same clock domain can take over each other's transform instead of
+// measuring it. Entries without a clock domain id take no bytes and are left out of
+// payloads.
+struct ClockDomain
+{
+  static const std::int32_t key = 'cdom';
+  static_assert(key == 0x63646f6d, "Unexpected byte order");
+  static const std::uint8_t compactKey = 6;
+
+  bool isIdentified() const
+  {
+    return std::any_of(id.begin(), id.end(), [](std::uint8_t b) { return b != 0; });
+  }
+
+  friend bool operator==(const ClockDomain& lhs, const ClockDomain& rhs)
+  {
+    return lhs.id == rhs.id && lhs.xform == rhs.xform;
+  }
+
+  // Model the NetworkByteStreamSerializable concept
+  friend std::uint32_t sizeInByteStream(const ClockDomain& clock)
+  {
+    if (!clock.isIdentified())
+    {
+      return 0;
+    }
+    return discovery::sizeInByteStream(clock.id)
+           + discovery::sizeInByteStream(slopeBits(clock.xform.slope))
+           + discovery::sizeInByteStream(clock.xform.intercept);
+  }
+
+  template <typename It>
+  friend It toNetworkByteStream(const ClockDomain& clock, It out)
+  {
+    if (!clock.isIdentified())
+    {
+      return out;
+    }
+    return discovery::toNetworkByteStream(clock.xform.intercept,
+      discovery::toNetworkByteStream(slopeBits(clock.xform.slope),
+        discovery::toNetworkByteStream(clock.id, std::move(out))));
+  }
+
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, ClockDomain& clock)
+  {
+    using discovery::tryDeserialize;
+    std::uint64_t bits = 0;
+    if (!tryDeserialize(begin, end, clock.id) || !tryDeserialize(begin, end, bits)
+        || !tryDeserialize(begin, end, clock.xform.intercept))
+    {
+      return false;
+    }
+    clock.xform.slope = slope(bits);
+    return true;
+  }
+
+  template <typename It>
+  static std::pair<ClockDomain, It> fromNetworkByteStream(It begin, It end)
+  {
+    return discovery::fromNetworkByteStreamOrThrow<ClockDomain>(
+      std::move(begin), std::move(end));
+  }
+
+  // The slope is sent as the bits of the double
+  static std::uint64_t slopeBits(const double slope)
+  {
+    static_assert(sizeof(double) == sizeof(std::uint64_t), "Unexpected double size");
+    std::uint64_t bits;
+    std::memcpy(&bits, &slope, sizeof(bits));
+    return bits;
+  }
+
+  static double slope(const std::uint64_t bits)
+  {
+    double slope;
+    std::memcpy(&slope, &bits, sizeof(slope));
+    return slope;
+  }
+
+  ClockDomainId id;
+  GhostXForm xform;
+};
+
+} // namespace link
+} // namespace ableton
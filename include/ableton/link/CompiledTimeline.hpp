@@ -0,0 +1,74 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/link/Beats.hpp>
+#include <ableton/link/Timeline.hpp>
+#include <chrono>
+#include <cmath>
+
+namespace ableton
+{
+namespace link
+{
+
+// A Timeline prepared for repeated conversions between beats and
+// time. The integral microseconds per beat that the tempo is
+// represented with on the wire are resolved once on construction
+// instead of on every conversion. Conversions are bit-identical to
+// the ones of the Timeline it was compiled from.
+
+struct CompiledTimeline
+{
+  CompiledTimeline() = default;
+
+  explicit CompiledTimeline(const Timeline& tl)
+    : beatOrigin(tl.beatOrigin)
+    , timeOrigin(tl.timeOrigin)
+    , microsPerBeat(tl.tempo.microsPerBeat())
+    , mMicrosPerBeat(static_cast<double>(microsPerBeat.count()))
+  {
+  }
+
+  Beats toBeats(const std::chrono::microseconds time) const
+  {
+    return beatOrigin
+           + Beats{static_cast<double>((time - timeOrigin).count()) / mMicrosPerBeat};
+  }
+
+  std::chrono::microseconds fromBeats(const Beats beats) const
+  {
+    return timeOrigin
+           + std::chrono::microseconds{
+             std::llround((beats - beatOrigin).floating() * mMicrosPerBeat)};
+  }
+
+  Beats beatOrigin;
+  std::chrono::microseconds timeOrigin;
+  std::chrono::microseconds microsPerBeat;
+
+private:
+  // Division by the exact double value of microsPerBeat rather than
+  // multiplication with its reciprocal keeps results identical to Tempo
+  double mMicrosPerBeat = 0;
+};
+
+} // namespace link
+} // namespace ableton
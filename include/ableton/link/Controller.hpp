@@ -21,16 +21,33 @@
 
 #include <ableton/discovery/Service.hpp>
 #include <ableton/link/ClientSessionTimelines.hpp>
-#include <ableton/link/Gateway.hpp>
 #include <ableton/link/GhostXForm.hpp>
+#include <ableton/link/MultiWriterBuffer.hpp>
 #include <ableton/link/NodeState.hpp>
+#include <ableton/link/PeerList.hpp>
+#include <ableton/link/PendingTimeline.hpp>
+#include <ableton/link/PowerProfile.hpp>
 #include <ableton/link/Peers.hpp>
+#include <ableton/link/SessionEvent.hpp>
 #include <ableton/link/SessionState.hpp>
 #include <ableton/link/Sessions.hpp>
+#include <ableton/link/ShardedGateway.hpp>
+#include <ableton/link/SpscRingBuffer.hpp>
 #include <ableton/link/StartStopState.hpp>
+#include <ableton/link/Stats.hpp>
+#include <ableton/link/SyncQuality.hpp>
+#include <ableton/link/TimelineHistory.hpp>
 #include <ableton/link/TripleBuffer.hpp>
+#include <ableton/platforms/ThreadPolicy.hpp>
+#include <ableton/util/CacheLine.hpp>
+#include <ableton/util/Log.hpp>
+#include <ableton/util/Trace.hpp>
+#include <algorithm>
 #include <condition_variable>
+#include <future>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 namespace ableton
 {
@@ -52,7 +69,7 @@ inline SessionState initSessionState(const Tempo tempo, const Clock& clock)
 {
   using namespace std::chrono;
   return {clampTempo(Timeline{tempo, Beats{0.}, microseconds{0}}),
-    StartStopState{false, Beats{0.}, microseconds{0}}, initXForm(clock)};
+    StartStopState{false, Beats{0.}, microseconds{0}}, initXForm(clock), TempoRamp{}};
 }
 
 inline ClientState initClientState(const SessionState& sessionState)
@@ -60,14 +77,15 @@ inline ClientState initClientState(const SessionState& sessionState)
   const auto hostTime = sessionState.ghostXForm.ghostToHost(std::chrono::microseconds{0});
   return {
     Timeline{sessionState.timeline.tempo, sessionState.timeline.beatOrigin, hostTime},
-    ClientStartStopState{sessionState.startStopState.isPlaying, hostTime, hostTime}};
+    ClientStartStopState{sessionState.startStopState.isPlaying, hostTime, hostTime},
+    TempoRamp{}};
 }
 
 inline RtClientState initRtClientState(const ClientState& clientState)
 {
   using namespace std::chrono;
-  return {
-    clientState.timeline, clientState.startStopState, microseconds{0}, microseconds{0}};
+  return {clientState.timeline, clientState.startStopState, microseconds{0},
+    microseconds{0}, clientState.tempoRamp};
 }
 
 // The timespan in which local modifications to the timeline will be
@@ -75,6 +93,58 @@ inline RtClientState initRtClientState(const ClientState& clientState)
 const auto kLocalModGracePeriod = std::chrono::milliseconds(1000);
 const auto kRtHandlerFallbackPeriod = kLocalModGracePeriod / 2;
 
+// The number of timeline commits from the realtime thread that are kept
+// for processing if the timeline commit queue is enabled and the minimum
+// period between the resulting discovery updates.
+const std::size_t kRtTimelineCommitQueueSize = 64;
+const auto kRtTimelineCommitDiscoveryPeriod = std::chrono::milliseconds(50);
+
+// The number of realtime threads that can commit client states with
+// setClientStateRtShared at the same time
+const std::size_t kRtSharedCommitSlots = 8;
+
+// A start stop state that is received from the session is relayed by broadcasting
+// it after a delay within this window, which is spread over the peers by their ids.
+// The relay is skipped if at least the given number of peer entries already carry
+// the state by then, so one transport change doesn't make every peer rebroadcast.
+const auto kStartStopRelayWindow = std::chrono::milliseconds(50);
+const std::size_t kStartStopRelayRedundancy = 2;
+
+// The number of session events that are kept for a realtime reader if the
+// session event queue is enabled
+const std::size_t kSessionEventQueueSize = 64;
+
+// The number of recent client timelines that are kept for mapping times before
+// the latest change
+const std::size_t kTimelineHistorySize = 16;
+
+// Timers of the io context may defer deadlines that are further away than this, so
+// the activation of a pending timeline is approached in steps
+const auto kMaxExactTimerDelay = std::chrono::milliseconds(16);
+
+// With clock slewing enabled, a remeasured xform of the session is approached by
+// changing the rate of the ghost time by this much instead of making it jump, unless
+// it's further off than the maximum offset
+const auto kClockSlewRate = 0.001;
+const auto kMaxClockSlewOffset = std::chrono::milliseconds(10);
+
+// When the last peer of the session leaves or times out, the state is only reset
+// if no peer of the session reappears within this period
+const auto kStateResetGracePeriod = std::chrono::seconds(2);
+
+// The number of addresses of former session peers that are remembered
+const std::size_t kMaxKnownPeerAddresses = 64;
+
+// The peer list is republished at most this often when only the last seen times of
+// the peers have changed
+const auto kPeerListRefreshPeriod = std::chrono::seconds(1);
+
+// While the session ramps, the timeline that peers of older versions follow is
+// moved along the ramp this often. A timeline that they pass on is recognized as
+// one of these if it's this close to the ramp.
+const auto kRampTangentPeriod = std::chrono::milliseconds(100);
+const auto kMaxRampTangentOffset = std::chrono::microseconds(10);
+
 inline ClientStartStopState selectPreferredStartStopState(
   const ClientStartStopState currentStartStopState,
   const ClientStartStopState startStopState)
@@ -129,38 +199,35 @@ public:
     TempoCallback tempoCallback,
     StartStopStateCallback startStopStateCallback,
     Clock clock)
-    : mTempoCallback(std::move(tempoCallback))
-    , mStartStopStateCallback(std::move(startStopStateCallback))
-    , mClock(std::move(clock))
-    , mNodeId(NodeId::random<Random>())
-    , mSessionId(mNodeId)
-    , mSessionState(detail::initSessionState(tempo, mClock))
-    , mClientState(detail::initClientState(mSessionState))
-    , mLastIsPlayingForStartStopStateCallback(false)
-    , mRtClientState(detail::initRtClientState(mClientState.get()))
-    , mHasPendingRtClientStates(false)
-    , mSessionPeerCounter(*this, std::move(peerCallback))
-    , mEnabled(false)
-    , mStartStopSyncEnabled(false)
-    , mIo(IoContext{UdpSendExceptionHandler{this}})
-    , mRtClientStateSetter(*this)
-    , mPeers(util::injectRef(*mIo),
-        std::ref(mSessionPeerCounter),
-        SessionTimelineCallback{*this},
-        SessionStartStopStateCallback{*this})
-    , mSessions(
-        {mSessionId, mSessionState.timeline, {mSessionState.ghostXForm, mClock.micros()}},
-        util::injectRef(mPeers),
-        MeasurePeer{*this},
-        JoinSessionCallback{*this},
-        util::injectRef(*mIo),
-        mClock)
-    , mDiscovery(std::make_pair(NodeState{mNodeId, mSessionId, mSessionState.timeline,
-                                  mSessionState.startStopState},
-                   mSessionState.ghostXForm),
-        GatewayFactory{*this},
-        util::injectRef(*mIo))
+    : Controller(std::move(tempo),
+        std::move(peerCallback),
+        std::move(tempoCallback),
+        std::move(startStopStateCallback),
+        std::move(clock),
+        [](UdpSendExceptionHandler handler) { return IoContext{handler}; })
+  {
+  }
+
+  // Runs on an io service that is provided by the application instead of a thread
+  // owned by the io context. The IoContext must be constructible from it.
+  template <typename IoService>
+  Controller(Tempo tempo,
+    PeerCountCallback peerCallback,
+    TempoCallback tempoCallback,
+    StartStopStateCallback startStopStateCallback,
+    Clock clock,
+    IoService& ioService)
+    : Controller(std::move(tempo),
+        std::move(peerCallback),
+        std::move(tempoCallback),
+        std::move(startStopStateCallback),
+        std::move(clock),
+        [&ioService](UdpSendExceptionHandler handler) {
+          return IoContext{ioService, handler};
+        })
   {
+    // The io service of the application is already running
+    mIsStarted = true;
   }
 
   Controller(const Controller&) = delete;
@@ -171,29 +238,59 @@ public:
 
   ~Controller()
   {
-    std::mutex mutex;
-    std::condition_variable condition;
-    auto stopped = false;
-
-    mIo->async([this, &mutex, &condition, &stopped]() {
-      enable(false);
-      std::unique_lock<std::mutex> lock(mutex);
-      stopped = true;
-      condition.notify_one();
-    });
+    // After a completed shutdown, or if the io thread has never been started, there
+    // is nothing left to do on it
+    if (mIsStarted && !mIsShutDown)
+    {
+      if (mIo->runningInThisThread())
+      {
+        // Destroyed from a handler of the io_service of the application, which can't
+        // wait for another one
+        mEnabled = false;
+        mDiscovery.enable(false);
+      }
+      else
+      {
+        std::mutex mutex;
+        std::condition_variable condition;
+        auto stopped = false;
+
+        mIo->async([this, &mutex, &condition, &stopped]() {
+          enable(false);
+          std::unique_lock<std::mutex> lock(mutex);
+          stopped = true;
+          condition.notify_one();
+        });
 
-    std::unique_lock<std::mutex> lock(mutex);
-    condition.wait(lock, [&stopped] { return stopped; });
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&stopped] { return stopped; });
+      }
+    }
 
     mIo->stop();
   }
 
   void enable(const bool bEnable)
   {
+    std::lock_guard<std::mutex> lock(mEnableGuard);
     const bool bWasEnabled = mEnabled.exchange(bEnable);
-    if (bWasEnabled != bEnable)
+    const bool bWasSuspended = mSuspended;
+    mSuspended = false;
+    if (bEnable)
+    {
+      mIsShutDown = false;
+      // The threads are only started by the first enable, so that a controller that
+      // is never enabled doesn't cost any. What was posted before is handled first.
+      std::lock_guard<std::recursive_mutex> startLock(mStartGuard);
+      if (!mIsStarted)
+      {
+        mIsStarted = true;
+        mIo->start();
+      }
+    }
+    if (bWasEnabled != bEnable || bWasSuspended)
     {
-      mIo->async([this, bEnable] {
+      mIo->async([this, bEnable, bWasSuspended] {
         if (bEnable)
         {
           // Process the pending client states to make sure we don't push one after we
@@ -203,11 +300,70 @@ public:
           // tempo in existing sessions
           resetState();
         }
-        mDiscovery.enable(bEnable);
+        if (bEnable && bWasSuspended)
+        {
+          mDiscovery.suspend(false);
+        }
+        else
+        {
+          mDiscovery.enable(bEnable);
+        }
       });
     }
   }
 
+  // See Link::enableClockSlewing. Applies to the remeasurements that complete
+  // afterwards. Thread-safe and realtime-safe
+  void enableClockSlewing(const bool bEnable)
+  {
+    mClockSlewingEnabled = bEnable;
+  }
+
+  bool isClockSlewingEnabled() const
+  {
+    return mClockSlewingEnabled;
+  }
+
+  // Disables like enable(false), but keeps the gateways and their sockets so that
+  // enabling again doesn't have to rebuild them. The peers see the node leave, and
+  // enabling announces the new state right away. Disabling while suspended
+  // releases the gateways.
+  void suspend()
+  {
+    std::lock_guard<std::mutex> lock(mEnableGuard);
+    if (mEnabled.exchange(false))
+    {
+      mSuspended = true;
+      mIo->async([this] { mDiscovery.suspend(true); });
+    }
+  }
+
+  // Disables the controller and releases its gateways on the io thread without
+  // waiting for it, which sends the bye bye messages. The returned future is ready
+  // once that is done, after which destroying the controller doesn't wait for the
+  // io thread. Shutting down several controllers before destroying them lets them
+  // leave their sessions concurrently.
+  std::future<void> shutdown()
+  {
+    std::lock_guard<std::mutex> lock(mEnableGuard);
+    mEnabled = false;
+    mSuspended = false;
+    auto pDone = std::make_shared<std::promise<void>>();
+    if (!mIsStarted)
+    {
+      mIsShutDown = true;
+      pDone->set_value();
+      return pDone->get_future();
+    }
+    mIo->async([this, pDone] {
+      mDiscovery.enable(false);
+      // Unless the controller has been enabled again in the meantime
+      mIsShutDown = !mEnabled;
+      pDone->set_value();
+    });
+    return pDone->get_future();
+  }
+
   bool isEnabled() const
   {
     return mEnabled;
@@ -223,18 +379,318 @@ public:
     return mStartStopSyncEnabled;
   }
 
+  // Queue an event for every change of the session tempo and start/stop
+  // state, to be read with readSessionEventRtSafe. Events are dropped if
+  // kSessionEventQueueSize events are pending.
+  void enableSessionEventQueue(const bool bEnable)
+  {
+    mSessionEventQueueEnabled = bEnable;
+  }
+
+  bool isSessionEventQueueEnabled() const
+  {
+    return mSessionEventQueueEnabled;
+  }
+
+  // Wait-free, but must not be called from multiple threads concurrently
+  Optional<SessionEvent> readSessionEventRtSafe()
+  {
+    return mSessionEvents.read();
+  }
+
+  // Thread-safe but not realtime-safe
+  Stats stats() const
+  {
+    return mStats.snapshot();
+  }
+
+  // The quality of the clock synchronization with the current session. It isn't
+  // measured if this controller founded the session, as the others then sync to
+  // its clock. Thread-safe but not realtime-safe
+  SyncQuality syncQuality() const
+  {
+    std::lock_guard<std::mutex> lock(mSyncQualityGuard);
+    return mSyncQuality;
+  }
+
+  // The transformation from host time to the time of the session. NOT thread-safe,
+  // must be called from the thread of the io context, e.g. by simulations that run
+  // it serially.
+  GhostXForm ghostXForm() const
+  {
+    return mSessionState.ghostXForm;
+  }
+
+  // The addresses of the peers that have been in a session with this controller,
+  // most recent last. Thread-safe but not realtime-safe
+  std::vector<asio::ip::address> knownPeerAddresses() const
+  {
+    std::lock_guard<std::mutex> lock(mKnownPeerAddressesGuard);
+    return mKnownPeerAddresses;
+  }
+
+  // The entries of all peers on all gateways. The io thread publishes a new list
+  // whenever the membership of a session changes and refreshes the last seen times
+  // and the measurements every kPeerListRefreshPeriod while peers send their states.
+  // A published list doesn't change, it's shared rather than copied by each call.
+  // Thread-safe but not realtime-safe
+  std::shared_ptr<const PeerList> peerList() const
+  {
+    std::lock_guard<std::mutex> lock(mPeerListGuard);
+    return mpPeerList;
+  }
+
+  // The current and the other remembered sessions with their peer counts and
+  // measurements. The io thread publishes a new list whenever a session is seen,
+  // measured, forgotten or changes its timeline or peers, see peerList.
+  // Thread-safe but not realtime-safe
+  std::shared_ptr<const SessionList> sessionList() const
+  {
+    std::lock_guard<std::mutex> lock(mSessionListGuard);
+    return mpSessionList;
+  }
+
+  // See Sessions::setMaxMeasuredOtherSessions. Thread-safe but not realtime-safe
+  void setMaxMeasuredOtherSessions(const std::size_t maxMeasured)
+  {
+    mMaxMeasuredOtherSessions = maxMeasured;
+    mIo->async(
+      [this, maxMeasured] { mSessions.setMaxMeasuredOtherSessions(maxMeasured); });
+  }
+
+  std::size_t maxMeasuredOtherSessions() const
+  {
+    return mMaxMeasuredOtherSessions;
+  }
+
+  // Gateways that are created afterwards send their state directly to peers at
+  // these addresses in addition to the multicast announcement. Restoring the
+  // addresses of a previous run lets the peers find each other without waiting
+  // for multicast. Thread-safe but not realtime-safe
+  void setKnownPeerAddresses(std::vector<asio::ip::address> addresses)
+  {
+    if (addresses.size() > detail::kMaxKnownPeerAddresses)
+    {
+      addresses.erase(addresses.begin(),
+        addresses.end() - static_cast<std::ptrdiff_t>(detail::kMaxKnownPeerAddresses));
+    }
+    std::lock_guard<std::mutex> lock(mKnownPeerAddressesGuard);
+    mKnownPeerAddresses = std::move(addresses);
+  }
+
+  // Peers or relays that are sent every broadcast directly, for networks that drop
+  // or throttle multicast
+  void setUnicastPeers(std::vector<asio::ip::udp::endpoint> peers)
+  {
+    using GatewayIt = typename Discovery::ServicePeerGateways::GatewayMap::iterator;
+    mIo->async([this, peers] {
+      mUnicastPeers = peers;
+      mDiscovery.withGateways([&peers](GatewayIt it, const GatewayIt end) {
+        for (; it != end; ++it)
+        {
+          it->second->setUnicastPeers(peers);
+        }
+      });
+    });
+  }
+
+  // Peers only see the peers of their own group, see discovery::BroadcastPolicy.
+  // The gateways are replaced with ones of the new group, which says bye bye to
+  // the peers of the previous one.
+  void setSessionGroup(const discovery::v1::SessionGroupId groupId)
+  {
+    mSessionGroup = groupId;
+    mIo->async([this, groupId] {
+      if (groupId == mGatewaySessionGroup)
+      {
+        return;
+      }
+      mGatewaySessionGroup = groupId;
+      using GatewayIt = typename Discovery::ServicePeerGateways::GatewayMap::iterator;
+      std::vector<asio::ip::address> addrs;
+      mDiscovery.withGateways([&addrs](GatewayIt it, const GatewayIt end) {
+        for (; it != end; ++it)
+        {
+          addrs.push_back(it->first);
+        }
+      });
+      for (const auto& addr : addrs)
+      {
+        mDiscovery.repairGateway(addr);
+      }
+    });
+  }
+
+  discovery::v1::SessionGroupId sessionGroup() const
+  {
+    return mSessionGroup;
+  }
+
+  // An observer follows the sessions of its peers without being announced to them.
+  // Its gateways only listen, see discovery::BroadcastPolicy, and it joins the
+  // first session it measures. Entering the mode says bye bye to the peers and
+  // leaving it announces the node, the known peers are kept.
+  void enableObserverMode(const bool bEnable)
+  {
+    mObserverModeEnabled = bEnable;
+    mIo->async([this, bEnable] {
+      if (bEnable == mGatewayObserverMode)
+      {
+        return;
+      }
+      mGatewayObserverMode = bEnable;
+      mSessions.enableObserverMode(bEnable);
+      using GatewayIt = typename Discovery::ServicePeerGateways::GatewayMap::iterator;
+      mDiscovery.withGateways([bEnable](GatewayIt it, const GatewayIt end) {
+        for (; it != end; ++it)
+        {
+          it->second->enableObserverMode(bEnable);
+        }
+      });
+    });
+  }
+
+  bool isObserverModeEnabled() const
+  {
+    return mObserverModeEnabled;
+  }
+
+  // Discovery is hierarchical with at most this many hubs on each interface, see
+  // discovery::BroadcastPolicy::maxHubs, or a full mesh if it's 0
+  void setMaxDiscoveryHubs(const std::size_t maxHubs)
+  {
+    mMaxDiscoveryHubs = maxHubs;
+    mIo->async([this, maxHubs] {
+      if (maxHubs == mGatewayMaxHubs)
+      {
+        return;
+      }
+      mGatewayMaxHubs = maxHubs;
+      using GatewayIt = typename Discovery::ServicePeerGateways::GatewayMap::iterator;
+      mDiscovery.withGateways([maxHubs](GatewayIt it, const GatewayIt end) {
+        for (; it != end; ++it)
+        {
+          it->second->setMaxHubs(maxHubs);
+        }
+      });
+    });
+  }
+
+  std::size_t maxDiscoveryHubs() const
+  {
+    return mMaxDiscoveryHubs;
+  }
+
+  // See PowerProfile. Profiles with shorter periods take effect right away: the
+  // state is broadcast, the interfaces are rescanned and a remeasurement of the
+  // session that was skipped is launched.
+  void setPowerProfile(const PowerProfile profile)
+  {
+    mPowerProfile = profile;
+    mIo->async([this, profile] {
+      if (profile == mGatewayPowerProfile)
+      {
+        return;
+      }
+      mGatewayPowerProfile = profile;
+      const auto factor = periodFactor(profile);
+      mRtClientStateSetter.setFallbackPeriod(
+        detail::kRtHandlerFallbackPeriod * static_cast<int>(factor));
+      mDiscovery.setRescanPeriod(
+        Discovery::defaultRescanPeriod() * static_cast<int>(factor));
+      mSessions.suspendRemeasurements(profile == PowerProfile::Background);
+      using GatewayIt = typename Discovery::ServicePeerGateways::GatewayMap::iterator;
+      mDiscovery.withGateways([factor](GatewayIt it, const GatewayIt end) {
+        for (; it != end; ++it)
+        {
+          it->second->setPeriodFactor(factor);
+        }
+      });
+    });
+  }
+
+  PowerProfile powerProfile() const
+  {
+    return mPowerProfile;
+  }
+
+  // Thread-safe, the policy is applied by the threads of the io context, including
+  // those of the gateways that run on threads of their own
+  void setThreadPolicy(const platforms::ThreadPolicy& policy)
+  {
+    mIo->setThreadPolicy(policy);
+    mIo->async([this, policy] {
+      mGatewayThreadPolicy = policy;
+      using GatewayIt = typename Discovery::ServicePeerGateways::GatewayMap::iterator;
+      mDiscovery.withGateways([&policy](GatewayIt it, const GatewayIt end) {
+        for (; it != end; ++it)
+        {
+          it->second->setThreadPolicy(policy);
+        }
+      });
+    });
+  }
+
+  // The gateway of each interface runs on a shard of the io context, see
+  // ShardedGateway, so that the traffic of one interface doesn't delay the handling
+  // of the others. The gateways are replaced with ones on the new contexts.
+  void enableThreadPerInterface(const bool bEnable)
+  {
+    mThreadPerInterfaceEnabled = bEnable;
+    mIo->async([this, bEnable] {
+      if (bEnable == mGatewayThreadPerInterface)
+      {
+        return;
+      }
+      mGatewayThreadPerInterface = bEnable;
+      using GatewayIt = typename Discovery::ServicePeerGateways::GatewayMap::iterator;
+      std::vector<asio::ip::address> addrs;
+      mDiscovery.withGateways([&addrs](GatewayIt it, const GatewayIt end) {
+        for (; it != end; ++it)
+        {
+          addrs.push_back(it->first);
+        }
+      });
+      for (const auto& addr : addrs)
+      {
+        mDiscovery.repairGateway(addr);
+      }
+    });
+  }
+
+  bool isThreadPerInterfaceEnabled() const
+  {
+    return mThreadPerInterfaceEnabled;
+  }
+
+  void setInterfaceFilter(discovery::InterfaceFilter filter)
+  {
+    mIo->async([this, filter] { mDiscovery.setInterfaceFilter(filter); });
+  }
+
   std::size_t numPeers() const
   {
     return mSessionPeerCounter.mSessionPeerCount;
   }
 
-  // Get the current Link client state. Thread-safe but may block, so
-  // it cannot be used from audio thread.
+  // Get the current Link client state. Thread-safe and doesn't block
+  // on concurrent modifications.
   ClientState clientState() const
   {
+    // Handling the commits changes what is returned, but not the controller as seen
+    // by its owner, which never holds a const controller
+    const_cast<Controller&>(*this).handleClientStatesIfNotStarted();
     return mClientState.get();
   }
 
+  // Increases whenever the client state changes. Thread-safe and realtime-safe.
+  // Before the io thread is started, the realtime commits that clientState will
+  // handle are counted as well.
+  std::uint64_t clientStateVersion() const
+  {
+    return mClientState.version() + mNumRtCommitsBeforeStart;
+  }
+
   // Set the client state to be used, starting at the given time.
   // Thread-safe but may block, so it cannot be used from audio thread.
   void setClientState(IncomingClientState newClientState)
@@ -244,6 +700,7 @@ public:
       {
         *newClientState.timeline = clampTempo(*newClientState.timeline);
         clientState.timeline = *newClientState.timeline;
+        clientState.tempoRamp = newClientState.tempoRamp;
       }
       if (newClientState.startStopState)
       {
@@ -253,44 +710,105 @@ public:
         clientState.startStopState = *newClientState.startStopState;
       }
     });
-    mIo->async([this, newClientState] { handleClientState(newClientState); });
+    mClientStateSetter.push(newClientState);
+    handleClientStatesIfNotStarted();
+  }
+
+  // Until the io thread is started by the first enable, the client states that are
+  // committed from the app and the audio thread are handled by the app thread when
+  // it commits or captures, so that a controller that is never enabled still works
+  // as a local clock. The callbacks of the changes are invoked on that thread then.
+  void handleClientStatesIfNotStarted()
+  {
+    if (!mIsStarted)
+    {
+      // Recursive, because the callbacks may commit or capture again
+      std::lock_guard<std::recursive_mutex> lock(mStartGuard);
+      if (!mIsStarted)
+      {
+        mClientStateSetter.processPendingClientState();
+        mRtClientStateSetter.processPendingClientStates();
+      }
+    }
+  }
+
+  // Schedule the client timeline to replace the current one at the given time.
+  // The change is announced to the session right away, so that all peers switch
+  // to it at the same moment. The timeline should be continuous with the current
+  // one at that time. Thread-safe but may block, so it cannot be used from audio
+  // thread.
+  void scheduleClientTimeline(Timeline timeline, const std::chrono::microseconds time)
+  {
+    timeline = clampTempo(timeline);
+    mIo->async([this, timeline, time] { handleScheduledClientTimeline(timeline, time); });
   }
 
   // Non-blocking client state access for a realtime context. NOT
   // thread-safe. Must not be called from multiple threads
   // concurrently and must not be called concurrently with setClientStateRtSafe.
+  // Within a realtime block the client state cached by beginRtBlock is returned.
   ClientState clientStateRtSafe() const
   {
-    // Respect the session state guard and the client state guard but don't
-    // block on them. If we can't access one or both because of concurrent modification
-    // we fall back to our cached version of the timeline and/or start stop state.
+    if (!mIsInRtBlock)
+    {
+      updateRtClientState();
+    }
+    return {
+      mRtClientState.timeline, mRtClientState.startStopState, mRtClientState.tempoRamp};
+  }
 
-    if (!mHasPendingRtClientStates)
+  // The client state for rendering the given time, with the timeline that was
+  // valid then if it has changed since. A replaced timeline is returned without
+  // its ramp. Same threading requirements as clientStateRtSafe.
+  ClientState clientStateRtSafeAt(const std::chrono::microseconds time) const
+  {
+    auto clientState = clientStateRtSafe();
+    if (const auto timeline = mRtTimelineHistory.readInPlace().replacedTimelineAt(time))
     {
-      const auto now = mClock.micros();
-      const auto timelineGracePeriodOver =
-        now - mRtClientState.timelineTimestamp > detail::kLocalModGracePeriod;
-      const auto startStopStateGracePeriodOver =
-        now - mRtClientState.startStopStateTimestamp > detail::kLocalModGracePeriod;
+      clientState.timeline = *timeline;
+      clientState.tempoRamp = {};
+    }
+    return clientState;
+  }
 
-      if (timelineGracePeriodOver || startStopStateGracePeriodOver)
-      {
-        const auto clientState = mClientState.getRt();
+  // Non-blocking client state access for any number of realtime
+  // threads. Thread-safe. In contrast to clientStateRtSafe, client states
+  // set with setClientStateRtSafe are only reflected once they have been
+  // processed, which happens asynchronously.
+  ClientState clientStateRtShared() const
+  {
+    return mClientState.get();
+  }
 
-        if (timelineGracePeriodOver && clientState.timeline != mRtClientState.timeline)
-        {
-          mRtClientState.timeline = clientState.timeline;
-        }
+  // Keep every timeline set with setClientStateRtSafe, up to
+  // kRtTimelineCommitQueueSize pending ones, instead of only the latest
+  // one. Each queued timeline is applied to the session in order, such
+  // that tempo ramps reach the session in their full resolution, while
+  // the resulting discovery updates are coalesced and rate limited.
+  void enableRtTimelineCommitQueue(const bool bEnable)
+  {
+    mRtTimelineCommitQueueEnabled = bEnable;
+  }
 
-        if (startStopStateGracePeriodOver
-            && clientState.startStopState != mRtClientState.startStopState)
-        {
-          mRtClientState.startStopState = clientState.startStopState;
-        }
-      }
-    }
+  bool isRtTimelineCommitQueueEnabled() const
+  {
+    return mRtTimelineCommitQueueEnabled;
+  }
 
-    return {mRtClientState.timeline, mRtClientState.startStopState};
+  // Begin a block of realtime client state accesses, such as the
+  // processing of an audio buffer. The clock is read and the grace
+  // periods of local modifications are resolved once here instead of
+  // in every call to clientStateRtSafe until endRtBlock is called.
+  // Same threading requirements as clientStateRtSafe.
+  void beginRtBlock()
+  {
+    updateRtClientState();
+    mIsInRtBlock = true;
+  }
+
+  void endRtBlock()
+  {
+    mIsInRtBlock = false;
   }
 
   // should only be called from the audio thread
@@ -323,6 +841,7 @@ public:
     {
       // Cache the new timeline and StartStopState for serving back to the client
       mRtClientState.timeline = *newClientState.timeline;
+      mRtClientState.tempoRamp = newClientState.tempoRamp;
       mRtClientState.timelineTimestamp = makeRtTimestamp(now);
     }
     if (newClientState.startStopState)
@@ -332,7 +851,64 @@ public:
     }
   }
 
+  // Non-blocking client state commit for any number of realtime threads.
+  // Thread-safe. The commits of all threads are merged when they are
+  // processed, the timeline and the start/stop state with the latest
+  // timestamps win. In contrast to setClientStateRtSafe, the committed state
+  // is only reflected by clientStateRtSafe once it has been processed and the
+  // timelines aren't kept by the timeline commit queue. Returns false if the
+  // state was dropped because kRtSharedCommitSlots other threads are
+  // committing at the same time.
+  bool setClientStateRtShared(IncomingClientState newClientState)
+  {
+    if (!newClientState.timeline && !newClientState.startStopState)
+    {
+      return true;
+    }
+
+    if (newClientState.timeline)
+    {
+      *newClientState.timeline = clampTempo(*newClientState.timeline);
+    }
+    return mRtClientStateSetter.pushShared(newClientState);
+  }
+
 private:
+  void updateRtClientState() const
+  {
+    // Respect the session state guard and the client state guard but don't
+    // block on them. If we can't access one or both because of concurrent modification
+    // we fall back to our cached version of the timeline and/or start stop state.
+
+    if (!mHasPendingRtClientStates)
+    {
+      const auto now = mClock.micros();
+      const auto timelineGracePeriodOver =
+        now - mRtClientState.timelineTimestamp > detail::kLocalModGracePeriod;
+      const auto startStopStateGracePeriodOver =
+        now - mRtClientState.startStopStateTimestamp > detail::kLocalModGracePeriod;
+
+      if (timelineGracePeriodOver || startStopStateGracePeriodOver)
+      {
+        const auto& clientState = mClientState.getRt();
+
+        if (timelineGracePeriodOver
+            && (clientState.timeline != mRtClientState.timeline
+                || clientState.tempoRamp != mRtClientState.tempoRamp))
+        {
+          mRtClientState.timeline = clientState.timeline;
+          mRtClientState.tempoRamp = clientState.tempoRamp;
+        }
+
+        if (startStopStateGracePeriodOver
+            && clientState.startStopState != mRtClientState.startStopState)
+        {
+          mRtClientState.startStopState = clientState.startStopState;
+        }
+      }
+    }
+  }
+
   std::chrono::microseconds makeRtTimestamp(const std::chrono::microseconds now) const
   {
     return isEnabled() ? now : std::chrono::microseconds(0);
@@ -354,35 +930,142 @@ private:
     }
   }
 
-  void updateDiscovery()
+  void queueSessionEvent(const SessionEvent& event)
+  {
+    if (mSessionEventQueueEnabled)
+    {
+      mSessionEvents.write(event);
+    }
+  }
+
+  void updateDiscovery(
+    const discovery::StateBroadcast broadcast = discovery::StateBroadcast::Normal)
   {
     // Push the change to the discovery service
+    const auto tangent = rampTangent();
     mDiscovery.updateNodeState(
       std::make_pair(NodeState{mNodeId, mSessionId, mSessionState.timeline,
-                       mSessionState.startStopState},
-        mSessionState.ghostXForm));
+                       mSessionState.startStopState, mPendingTimeline,
+                       mSessionState.tempoRamp, mSyncStratum, tangent},
+        mSessionState.ghostXForm),
+      broadcast);
+    armRampTangentTimer(tangent);
   }
 
+  // Peers of older versions don't know tempo ramps. While the session ramps, they
+  // are sent the timeline that touches the ramp at the current time instead, which
+  // is the end timeline once the ramp is over.
+  Timeline rampTangent() const
+  {
+    const auto& ramp = mSessionState.tempoRamp;
+    if (!ramp.isRamping())
+    {
+      return {};
+    }
+
+    const auto ghostTime = mSessionState.ghostXForm.hostToGhost(mClock.micros());
+    if (ghostTime >= ramp.endTime())
+    {
+      return ramp.endTimeline();
+    }
+    return clampTempo(
+      Timeline{ramp.tempoAtTime(ghostTime), ramp.toBeats(ghostTime), ghostTime});
+  }
+
+  void armRampTangentTimer(const Timeline& tangent)
+  {
+    const auto& ramp = mSessionState.tempoRamp;
+    if (!ramp.isRamping() || tangent == ramp.endTimeline())
+    {
+      mRampTangentTimer.cancel();
+      return;
+    }
+
+    // Move on to the end timeline right at the end of the ramp
+    const auto remaining =
+      mSessionState.ghostXForm.ghostToHost(ramp.endTime()) - mClock.micros();
+    mRampTangentTimer.expires_from_now(
+      std::min<std::chrono::microseconds>(remaining, detail::kRampTangentPeriod));
+    mRampTangentTimer.async_wait([this](const typename Timer::ErrorCode e) {
+      if (!e)
+      {
+        updateDiscovery();
+      }
+    });
+  }
+
+  // Whether the timeline is one that a peer of an older version took over from the
+  // ramp of the session
+  bool isSessionRampTangent(const Timeline& timeline) const
+  {
+    const auto& ramp = mSessionState.tempoRamp;
+    if (!ramp.isRamping())
+    {
+      return false;
+    }
+
+    // The tempo is sent as whole microseconds per beat
+    const auto time =
+      rampedTimeline(mSessionState.timeline, ramp).fromBeats(timeline.beatOrigin);
+    const auto microsPerBeat = ramp.tempoAtTime(timeline.timeOrigin).microsPerBeat();
+    return std::abs((time - timeline.timeOrigin).count())
+             <= detail::kMaxRampTangentOffset.count()
+           && std::abs((microsPerBeat - timeline.tempo.microsPerBeat()).count()) <= 1;
+  }
+
+  // The session keeps its tempo ramp as long as its timeline doesn't change
   void updateSessionTiming(Timeline newTimeline, const GhostXForm newXForm)
+  {
+    newTimeline = clampTempo(newTimeline);
+    const auto newTempoRamp =
+      newTimeline == mSessionState.timeline ? mSessionState.tempoRamp : TempoRamp{};
+    updateSessionTiming(newTimeline, newXForm, newTempoRamp);
+  }
+
+  void updateSessionTiming(
+    Timeline newTimeline, const GhostXForm newXForm, const TempoRamp newTempoRamp)
   {
     // Clamp the session tempo because it may slightly overshoot (999 bpm is
     // transferred as 60606 us/beat and received as 999.000999... bpm).
     newTimeline = clampTempo(newTimeline);
     const auto oldTimeline = mSessionState.timeline;
     const auto oldXForm = mSessionState.ghostXForm;
+    const auto oldTempoRamp = mSessionState.tempoRamp;
 
-    if (oldTimeline != newTimeline || oldXForm != newXForm)
+    if (oldTimeline != newTimeline || oldXForm != newXForm
+        || oldTempoRamp != newTempoRamp)
     {
       {
         std::lock_guard<std::mutex> lock(mSessionStateGuard);
         mSessionState.timeline = newTimeline;
         mSessionState.ghostXForm = newXForm;
+        mSessionState.tempoRamp = newTempoRamp;
       }
 
       // Update the client timeline and start stop state based on the new session timing
+      const auto now = mClock.micros();
+      auto oldClientTimeline = Timeline{};
+      auto newClientTimeline = Timeline{};
       mClientState.update([&](ClientState& clientState) {
-        clientState.timeline = updateClientTimelineFromSession(clientState.timeline,
-          mSessionState.timeline, mClock.micros(), mSessionState.ghostXForm);
+        oldClientTimeline = clientState.timeline;
+        if (clientState.tempoRamp.isRamping() || newTempoRamp.isRamping())
+        {
+          // Continue from the beat that the client is at through its ramp
+          const auto clientBeat =
+            rampedTimeline(clientState.timeline, clientState.tempoRamp).toBeats(now);
+          clientState.timeline = updateClientTimelineFromSessionRamp(clientBeat,
+            mSessionState.timeline, newTempoRamp, now, mSessionState.ghostXForm);
+          clientState.tempoRamp =
+            newTempoRamp.isRamping() ? sessionRampToClient(newTempoRamp,
+              clientState.timeline, mSessionState.ghostXForm)
+                                     : TempoRamp{};
+        }
+        else
+        {
+          clientState.timeline = updateClientTimelineFromSession(clientState.timeline,
+            mSessionState.timeline, now, mSessionState.ghostXForm);
+        }
+        newClientTimeline = clientState.timeline;
         // Don't pass the start stop state to the client when start stop sync is disabled
         // or when we have a default constructed start stop state
         if (mStartStopSyncEnabled && mSessionState.startStopState != StartStopState{})
@@ -394,22 +1077,130 @@ private:
         }
       });
 
+      if (newClientTimeline != oldClientTimeline)
+      {
+        recordClientTimeline(now, newClientTimeline);
+      }
+
       if (oldTimeline.tempo != newTimeline.tempo)
       {
+        queueSessionEvent(SessionEvent::tempoChange(mClock.micros(), newTimeline.tempo));
         mTempoCallback(newTimeline.tempo);
       }
     }
   }
 
-  void handleTimelineFromSession(SessionId id, Timeline timeline)
+  void recordClientTimeline(const std::chrono::microseconds time, const Timeline timeline)
+  {
+    mTimelineHistory.add(time, timeline);
+    mRtTimelineHistory.write(mTimelineHistory);
+  }
+
+  void handleTimelineFromSession(SessionId id, Timeline timeline, TempoRamp tempoRamp)
+  {
+    LINK_DEBUG(mIo->log()) << "Received timeline with tempo: " << timeline.tempo.bpm()
+                           << " for session: " << id;
+    // Peers of older versions pass on the tangents of the ramp, which mustn't
+    // replace it
+    if (id == mSessionId && !tempoRamp.isRamping() && isSessionRampTangent(timeline))
+    {
+      return;
+    }
+    const auto sessionTimeline = mSessions.sawSessionTimeline(std::move(id), timeline);
+    // The ramp only comes along if its timeline is adopted
+    if (sessionTimeline == timeline)
+    {
+      updateSessionTiming(sessionTimeline, mSessionState.ghostXForm, tempoRamp);
+    }
+    else
+    {
+      updateSessionTiming(sessionTimeline, mSessionState.ghostXForm);
+    }
+    updateDiscovery();
+  }
+
+  void handlePendingTimelineFromSession(SessionId id, PendingTimeline pending)
   {
-    debug(mIo->log()) << "Received timeline with tempo: " << timeline.tempo.bpm()
-                      << " for session: " << id;
-    updateSessionTiming(mSessions.sawSessionTimeline(std::move(id), std::move(timeline)),
-      mSessionState.ghostXForm);
+    // Pending timelines of other sessions are ignored, those that are already in
+    // effect or have lower priority than the session timeline are superseded
+    if (id != mSessionId || !isPreferred(pending, mPendingTimeline)
+        || !(pending.timeline.beatOrigin > mSessionState.timeline.beatOrigin))
+    {
+      return;
+    }
+
+    LINK_DEBUG(mIo->log()) << "Received pending timeline with tempo: "
+                           << pending.timeline.tempo.bpm()
+                           << ", activation: " << pending.activationTime.count()
+                           << " for session: " << id;
+    schedulePendingTimeline(std::move(pending));
+    // Relay the pending timeline, so that peers that don't see the scheduling peer
+    // switch as well
     updateDiscovery();
   }
 
+  void handleScheduledClientTimeline(
+    const Timeline clientTimeline, const std::chrono::microseconds time)
+  {
+    schedulePendingTimeline({updateSessionTimelineFromClient(mSessionState.timeline,
+                               clientTimeline, time, mSessionState.ghostXForm),
+      mSessionState.ghostXForm.hostToGhost(time)});
+    updateDiscovery();
+  }
+
+  void schedulePendingTimeline(PendingTimeline pending)
+  {
+    mPendingTimeline = std::move(pending);
+    armPendingTimelineTimer();
+  }
+
+  void armPendingTimelineTimer()
+  {
+    const auto remaining =
+      mSessionState.ghostXForm.ghostToHost(mPendingTimeline.activationTime)
+      - mClock.micros();
+    if (remaining <= std::chrono::microseconds{0})
+    {
+      activatePendingTimeline();
+      return;
+    }
+
+    // A deferred deadline is at most a sixteenth of the delay late, so waking up
+    // an eighth earlier and waiting again for the rest never overshoots
+    mPendingTimelineTimer.expires_from_now(
+      remaining < detail::kMaxExactTimerDelay ? remaining : remaining - remaining / 8);
+    mPendingTimelineTimer.async_wait([this](const typename Timer::ErrorCode e) {
+      if (!e)
+      {
+        armPendingTimelineTimer();
+      }
+    });
+  }
+
+  void activatePendingTimeline()
+  {
+    const auto pending = mPendingTimeline;
+    mPendingTimeline = {};
+
+    // A timeline that was seen in the meantime and has priority over the pending
+    // one stays in effect
+    const auto timeline = mSessions.sawSessionTimeline(mSessionId, pending.timeline);
+    if (timeline == pending.timeline)
+    {
+      // The other peers switch at the same moment, which the cache must reflect to
+      // not report their old timelines as new ones
+      mPeers.setSessionTimeline(mSessionId, timeline);
+    }
+    updateSessionTiming(timeline, mSessionState.ghostXForm);
+    updateDiscovery();
+  }
+
+  void resetPendingTimeline()
+  {
+    mPendingTimeline = {};
+    mPendingTimelineTimer.cancel();
+  }
+
   void resetSessionStartStopState()
   {
     mSessionState.startStopState = StartStopState{};
@@ -417,11 +1208,11 @@ private:
 
   void handleStartStopStateFromSession(SessionId sessionId, StartStopState startStopState)
   {
-    debug(mIo->log()) << "Received start stop state. isPlaying: "
-                      << startStopState.isPlaying
-                      << ", beats: " << startStopState.beats.floating()
-                      << ", time: " << startStopState.timestamp.count()
-                      << " for session: " << sessionId;
+    LINK_DEBUG(mIo->log()) << "Received start stop state. isPlaying: "
+                           << startStopState.isPlaying
+                           << ", beats: " << startStopState.beats.floating()
+                           << ", time: " << startStopState.timestamp.count()
+                           << " for session: " << sessionId;
     if (sessionId == mSessionId
         && startStopState.timestamp > mSessionState.startStopState.timestamp)
     {
@@ -429,33 +1220,90 @@ private:
 
       // Always propagate the session start stop state so even a client that doesn't have
       // the feature enabled can function as a relay.
-      updateDiscovery();
+      updateDiscovery(discovery::StateBroadcast::Deferred);
+      scheduleStartStopRelay();
 
       if (mStartStopSyncEnabled)
       {
+        const auto clientStartStopState = detail::mapStartStopStateFromSessionToClient(
+          startStopState, mSessionState.timeline, mSessionState.ghostXForm);
         mClientState.update([&](ClientState& clientState) {
-          clientState.startStopState = detail::mapStartStopStateFromSessionToClient(
-            startStopState, mSessionState.timeline, mSessionState.ghostXForm);
+          clientState.startStopState = clientStartStopState;
         });
+        queueSessionEvent(SessionEvent::startStopChange(
+          clientStartStopState.time, clientStartStopState.isPlaying));
         invokeStartStopStateCallbackIfChanged();
       }
     }
   }
 
-  void handleClientState(const IncomingClientState clientState)
+  // The pending relay decides for the latest start stop state of the session
+  void scheduleStartStopRelay()
+  {
+    using namespace std::chrono;
+
+    if (mHasScheduledStartStopRelay)
+    {
+      return;
+    }
+
+    mHasScheduledStartStopRelay = true;
+    const auto window = duration_cast<microseconds>(detail::kStartStopRelayWindow);
+    mStartStopRelayTimer.expires_from_now(microseconds{
+      static_cast<microseconds::rep>(NodeIdHash{}(mNodeId)
+                                     % static_cast<std::size_t>(window.count()))});
+    mStartStopRelayTimer.async_wait([this](const typename Timer::ErrorCode e) {
+      if (!e)
+      {
+        mHasScheduledStartStopRelay = false;
+        if (mPeers.startStopStateCount(mSessionId, mSessionState.startStopState)
+            < detail::kStartStopRelayRedundancy)
+        {
+          updateDiscovery();
+        }
+      }
+    });
+  }
+
+  void handleClientState(const IncomingClientState clientState)
+  {
+    if (const auto broadcast = applyClientState(clientState))
+    {
+      updateDiscovery(*broadcast);
+    }
+
+    invokeStartStopStateCallbackIfChanged();
+  }
+
+  // Returns how discovery must be updated, if at all. Tempo changes and start stop
+  // transitions of the client are broadcast urgently, so that the peers follow
+  // them without waiting for the broadcast rate limit.
+  Optional<discovery::StateBroadcast> applyClientState(
+    const IncomingClientState clientState)
   {
-    auto mustUpdateDiscovery = false;
+    using discovery::StateBroadcast;
+
+    auto broadcast = Optional<StateBroadcast>{};
 
     if (clientState.timeline)
     {
+      recordClientTimeline(clientState.timelineTimestamp, *clientState.timeline);
       auto sessionTimeline = updateSessionTimelineFromClient(mSessionState.timeline,
         *clientState.timeline, clientState.timelineTimestamp, mSessionState.ghostXForm);
+      const auto sessionTempoRamp =
+        clientState.tempoRamp.isRamping()
+          ? clientRampToSession(
+            clientState.tempoRamp, *clientState.timeline, mSessionState.ghostXForm)
+          : TempoRamp{};
 
+      const auto isTempoChange = sessionTimeline.tempo != mSessionState.timeline.tempo;
       mSessions.resetTimeline(sessionTimeline);
       mPeers.setSessionTimeline(mSessionId, sessionTimeline);
-      updateSessionTiming(std::move(sessionTimeline), mSessionState.ghostXForm);
+      updateSessionTiming(
+        std::move(sessionTimeline), mSessionState.ghostXForm, sessionTempoRamp);
 
-      mustUpdateDiscovery = true;
+      broadcast = Optional<StateBroadcast>{
+        isTempoChange ? StateBroadcast::Urgent : StateBroadcast::Normal};
     }
 
     if (mStartStopSyncEnabled && clientState.startStopState)
@@ -465,23 +1313,38 @@ private:
         mSessionState.ghostXForm.hostToGhost(clientState.startStopState->timestamp);
       if (newGhostTime > mSessionState.startStopState.timestamp)
       {
+        const auto isTransition =
+          clientState.startStopState->isPlaying != mSessionState.startStopState.isPlaying;
         mClientState.update([&](ClientState& currentClientState) {
           mSessionState.startStopState =
             detail::mapStartStopStateFromClientToSession(*clientState.startStopState,
               mSessionState.timeline, mSessionState.ghostXForm);
           currentClientState.startStopState = *clientState.startStopState;
         });
+        queueSessionEvent(SessionEvent::startStopChange(
+          clientState.startStopState->time, clientState.startStopState->isPlaying));
 
-        mustUpdateDiscovery = true;
+        if (isTransition)
+        {
+          broadcast = Optional<StateBroadcast>{StateBroadcast::Urgent};
+        }
+        else if (!broadcast)
+        {
+          broadcast = Optional<StateBroadcast>{StateBroadcast::Normal};
+        }
       }
     }
 
-    if (mustUpdateDiscovery)
+    return broadcast;
+  }
+
+  // Realtime-safe, see clientStateVersion
+  void countRtCommitBeforeStart()
+  {
+    if (!mIsStarted)
     {
-      updateDiscovery();
+      mNumRtCommitsBeforeStart.fetch_add(1, std::memory_order_relaxed);
     }
-
-    invokeStartStopStateCallbackIfChanged();
   }
 
   void handleRtClientState(IncomingClientState clientState)
@@ -490,6 +1353,7 @@ private:
       if (clientState.timeline)
       {
         currentClientState.timeline = *clientState.timeline;
+        currentClientState.tempoRamp = clientState.tempoRamp;
       }
       if (clientState.startStopState)
       {
@@ -500,37 +1364,276 @@ private:
       }
     });
 
-    handleClientState(clientState);
+    if (const auto broadcast = applyClientState(clientState))
+    {
+      if (mRtTimelineCommitQueueEnabled)
+      {
+        updateDiscoveryRateLimited();
+      }
+      else
+      {
+        updateDiscovery(*broadcast);
+      }
+    }
+
+    invokeStartStopStateCallbackIfChanged();
     mHasPendingRtClientStates = false;
   }
 
+  void handleQueuedRtTimeline(const std::chrono::microseconds timestamp,
+    const Timeline timeline,
+    const TempoRamp tempoRamp)
+  {
+    mClientState.update([&](ClientState& currentClientState) {
+      currentClientState.timeline = timeline;
+      currentClientState.tempoRamp = tempoRamp;
+    });
+
+    if (applyClientState({OptionalTimeline{timeline}, {}, timestamp, tempoRamp}))
+    {
+      updateDiscoveryRateLimited();
+    }
+  }
+
+  void updateDiscoveryRateLimited()
+  {
+    using namespace std::chrono;
+
+    if (mHasScheduledDiscoveryUpdate)
+    {
+      return;
+    }
+
+    const auto delay = detail::kRtTimelineCommitDiscoveryPeriod
+                       - duration_cast<milliseconds>(
+                         mDiscoveryUpdateTimer.now() - mLastRtDiscoveryUpdate);
+    if (delay > milliseconds{0})
+    {
+      mHasScheduledDiscoveryUpdate = true;
+      mDiscoveryUpdateTimer.expires_from_now(delay);
+      mDiscoveryUpdateTimer.async_wait([this](const typename Timer::ErrorCode e) {
+        if (!e)
+        {
+          mHasScheduledDiscoveryUpdate = false;
+          mLastRtDiscoveryUpdate = mDiscoveryUpdateTimer.now();
+          updateDiscovery();
+        }
+      });
+    }
+    else
+    {
+      mLastRtDiscoveryUpdate = mDiscoveryUpdateTimer.now();
+      updateDiscovery();
+    }
+  }
+
   void joinSession(const Session& session)
   {
     const bool sessionIdChanged = mSessionId != session.sessionId;
     mSessionId = session.sessionId;
+    mSyncStratum = session.measurement.stratum;
 
     // Prevent passing the state of the previous session to the new one.
     if (sessionIdChanged)
     {
       mRtClientStateSetter.processPendingClientStates();
       resetSessionStartStopState();
+      resetPendingTimeline();
     }
 
-    updateSessionTiming(session.timeline, session.measurement.xform);
+    if (!sessionIdChanged && mClockSlewingEnabled)
+    {
+      slewSessionTiming(session.timeline, session.measurement.xform);
+    }
+    else if (sessionIdChanged)
+    {
+      mClockSlewTimer.cancel();
+      updateSessionTiming(
+        session.timeline, session.measurement.xform, sessionTempoRamp(session));
+    }
+    else
+    {
+      mClockSlewTimer.cancel();
+      updateSessionTiming(session.timeline, session.measurement.xform);
+    }
     updateDiscovery();
+    setSyncQuality(session.measurement.quality);
 
     if (sessionIdChanged)
     {
-      debug(mIo->log()) << "Joining session " << session.sessionId << " with tempo "
-                        << session.timeline.tempo.bpm();
+      mStats.sessionJoined();
+      trace(
+        mIo->trace(), util::TraceEvent::SessionJoined, util::traceId(session.sessionId));
+      LINK_DEBUG(mIo->log()) << "Joining session " << session.sessionId << " with tempo "
+                             << session.timeline.tempo.bpm();
       mSessionPeerCounter();
     }
   }
 
+  // A node that joins a session during a tempo ramp takes the ramp over from a peer
+  // whose timeline is the one of the session, as the peers only pass it on when it
+  // changes
+  TempoRamp sessionTempoRamp(const Session& session) const
+  {
+    auto tempoRamp = TempoRamp{};
+    mPeers.forEachPeer([&session, &tempoRamp](const Peer& peer) {
+      const auto& state = peer.first;
+      if (state.sessionId() == session.sessionId && state.timeline() == session.timeline
+          && state.tempoRamp().isRamping())
+      {
+        tempoRamp = state.tempoRamp();
+      }
+    });
+    return tempoRamp;
+  }
+
+  // Moves the ghost time towards the remeasured xform of the session at a bounded
+  // rate. The client timeline follows the xform of the session, so its tempo is off
+  // by at most the slew rate meanwhile, but its beat time never jumps.
+  void slewSessionTiming(const Timeline& timeline, const GhostXForm xform)
+  {
+    using namespace std::chrono;
+
+    const auto now = mClock.micros();
+    const auto offset =
+      xform.hostToGhost(now) - mSessionState.ghostXForm.hostToGhost(now);
+    const auto distance = microseconds{std::abs(offset.count())};
+    if (distance == microseconds{0} || distance > detail::kMaxClockSlewOffset)
+    {
+      mClockSlewTimer.cancel();
+      updateSessionTiming(timeline, xform);
+      return;
+    }
+
+    const auto duration = microseconds{
+      llround(static_cast<double>(distance.count()) / detail::kClockSlewRate)};
+    updateSessionTiming(
+      timeline, slewedXForm(mSessionState.ghostXForm, xform, now, duration));
+    mClockSlewTimer.expires_from_now(duration);
+    mClockSlewTimer.async_wait([this, xform](const typename Timer::ErrorCode e) {
+      if (!e)
+      {
+        updateSessionTiming(mSessionState.timeline, xform);
+        updateDiscovery();
+      }
+    });
+  }
+
+  void setSyncQuality(const SyncQuality quality)
+  {
+    std::lock_guard<std::mutex> lock(mSyncQualityGuard);
+    mSyncQuality = quality;
+  }
+
+  void sawPeerState(const NodeId& id, const std::chrono::microseconds time)
+  {
+    const auto it = mPeerLastSeen.find(id);
+    if (it != mPeerLastSeen.end())
+    {
+      it->second = time;
+    }
+    else if (mPeerLastSeen.size() < mPeerLastSeen.max_size())
+    {
+      mPeerLastSeen.emplace(id, time);
+    }
+  }
+
+  void refreshPeerList(const std::chrono::microseconds now)
+  {
+    if (now - mLastPeerListTime >= detail::kPeerListRefreshPeriod)
+    {
+      publishPeerList();
+    }
+  }
+
+  void publishPeerList()
+  {
+    auto pList = std::make_shared<PeerList>();
+    // Only the peers that are still known are remembered
+    auto lastSeen = PeerLastSeen{};
+    mPeers.forEachPeer([this, &pList, &lastSeen](const Peer& peer) {
+      const auto& state = peer.first;
+      const auto it = mPeerLastSeen.find(state.ident());
+      const auto seen =
+        it != mPeerLastSeen.end() ? it->second : std::chrono::microseconds{};
+      if (lastSeen.find(state.ident()) == lastSeen.end())
+      {
+        lastSeen.emplace(state.ident(), seen);
+      }
+      pList->push_back(PeerInfo{state.ident(), state.sessionId(), state.timeline(),
+        peer.second, state.endpoint, state.numLeaves,
+        mSessions.sessionMeasurement(state.sessionId()).xform, seen});
+    });
+    mPeerLastSeen = std::move(lastSeen);
+    mLastPeerListTime = mClock.micros();
+
+    // The previous list is released outside of the lock
+    auto pPublished = std::shared_ptr<const PeerList>{std::move(pList)};
+    {
+      std::lock_guard<std::mutex> lock(mPeerListGuard);
+      std::swap(mpPeerList, pPublished);
+    }
+  }
+
+  void publishSessionList()
+  {
+    auto pList = std::make_shared<SessionList>();
+    mSessions.forEachSession([this, &pList](const Session& session) {
+      pList->push_back(SessionInfo{session.sessionId, session.timeline,
+        mPeers.uniqueSessionPeerCount(session.sessionId), session.measurement,
+        session.sessionId == mSessionId});
+    });
+
+    auto pPublished = std::shared_ptr<const SessionList>{std::move(pList)};
+    {
+      std::lock_guard<std::mutex> lock(mSessionListGuard);
+      std::swap(mpSessionList, pPublished);
+    }
+  }
+
+  void rememberSessionPeerAddresses()
+  {
+    const auto peers = mPeers.sessionPeers(mSessionId);
+    std::lock_guard<std::mutex> lock(mKnownPeerAddressesGuard);
+    for (const auto& peer : peers)
+    {
+      const auto addr = peer.first.endpoint.address();
+      const auto it =
+        std::find(mKnownPeerAddresses.begin(), mKnownPeerAddresses.end(), addr);
+      if (it != mKnownPeerAddresses.end())
+      {
+        mKnownPeerAddresses.erase(it);
+      }
+      else if (mKnownPeerAddresses.size() == detail::kMaxKnownPeerAddresses)
+      {
+        mKnownPeerAddresses.erase(mKnownPeerAddresses.begin());
+      }
+      mKnownPeerAddresses.push_back(addr);
+    }
+  }
+
+  // Peers that timed out because of a short outage come back with their ids and
+  // sessions unchanged. Keeping the state of the node until then spares them from
+  // meeting it as a new peer with a new session, which they would have to measure.
+  void scheduleStateReset()
+  {
+    mStateResetTimer.expires_from_now(detail::kStateResetGracePeriod);
+    mStateResetTimer.async_wait([this](const typename Timer::ErrorCode e) {
+      if (!e && mSessionPeerCounter.mSessionPeerCount == 0)
+      {
+        resetState();
+      }
+    });
+  }
+
   void resetState()
   {
+    mStateResetTimer.cancel();
+    mClockSlewTimer.cancel();
+    mStats.stateReset();
     mNodeId = NodeId::random<Random>();
     mSessionId = mNodeId;
+    mSyncStratum = 0;
 
     const auto xform = detail::initXForm(mClock);
     const auto hostTime = -xform.intercept;
@@ -543,22 +1646,84 @@ private:
       xform.hostToGhost(hostTime)};
 
     resetSessionStartStopState();
+    resetPendingTimeline();
 
     updateSessionTiming(newTl, xform);
     updateDiscovery();
 
-    mSessions.resetSession({mNodeId, newTl, {xform, hostTime}});
+    mSessions.resetSession({mNodeId, newTl, {xform, hostTime, {}, 0}});
+    setSyncQuality({});
     mPeers.resetPeers();
+    publishPeerList();
+    publishSessionList();
   }
 
   struct SessionTimelineCallback
   {
-    void operator()(SessionId id, Timeline timeline)
+    void operator()(SessionId id, Timeline timeline, TempoRamp tempoRamp)
+    {
+      mController.handleTimelineFromSession(
+        std::move(id), std::move(timeline), std::move(tempoRamp));
+    }
+
+    void operator()(SessionId id, PendingTimeline pending)
+    {
+      mController.handlePendingTimelineFromSession(std::move(id), std::move(pending));
+    }
+
+    Controller& mController;
+  };
+
+  // Passes the client states set from the app threads on to the io thread. States
+  // that are set while the io thread hasn't picked up the previous one yet are
+  // merged into it, so that a burst of commits costs a single io operation.
+  struct ClientStateSetter
+  {
+    ClientStateSetter(Controller& controller)
+      : mController(controller)
+      , mPendingClientState{}
+      , mHasPendingClientState(false)
+    {
+    }
+
+    void push(const IncomingClientState clientState)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mPendingClientStateGuard);
+        if (clientState.timeline)
+        {
+          mPendingClientState.timeline = clientState.timeline;
+          mPendingClientState.timelineTimestamp = clientState.timelineTimestamp;
+          mPendingClientState.tempoRamp = clientState.tempoRamp;
+        }
+        if (clientState.startStopState)
+        {
+          mPendingClientState.startStopState = clientState.startStopState;
+        }
+        if (mHasPendingClientState)
+        {
+          return;
+        }
+        mHasPendingClientState = true;
+      }
+      mController.mIo->async([this]() { processPendingClientState(); });
+    }
+
+    void processPendingClientState()
     {
-      mController.handleTimelineFromSession(std::move(id), std::move(timeline));
+      auto clientState = IncomingClientState{};
+      {
+        std::lock_guard<std::mutex> lock(mPendingClientStateGuard);
+        std::swap(clientState, mPendingClientState);
+        mHasPendingClientState = false;
+      }
+      mController.handleClientState(clientState);
     }
 
     Controller& mController;
+    std::mutex mPendingClientStateGuard;
+    IncomingClientState mPendingClientState;
+    bool mHasPendingClientState;
   };
 
   struct RtClientStateSetter
@@ -571,7 +1736,8 @@ private:
       : mController(controller)
       , mCallbackDispatcher(
           [this] { mController.mIo->async([this]() { processPendingClientStates(); }); },
-          detail::kRtHandlerFallbackPeriod)
+          detail::kRtHandlerFallbackPeriod,
+          *mController.mIo)
     {
     }
 
@@ -579,8 +1745,15 @@ private:
     {
       if (clientState.timeline)
       {
-        mTimelineBuffer.write(
-          std::make_pair(clientState.timelineTimestamp, *clientState.timeline));
+        const auto commit = TimelineCommit{
+          clientState.timelineTimestamp, *clientState.timeline, clientState.tempoRamp};
+        mTimelineBuffer.write(commit);
+        if (mController.mRtTimelineCommitQueueEnabled)
+        {
+          // If the queue is full the timeline is dropped, but the latest one is
+          // still passed on through mTimelineBuffer
+          mTimelineQueue.write(commit);
+        }
       }
 
       if (clientState.startStopState)
@@ -590,13 +1763,59 @@ private:
 
       if (clientState.timeline || clientState.startStopState)
       {
+        mController.mStats.rtCommitted();
+        mController.countRtCommitBeforeStart();
         mCallbackDispatcher.invoke();
       }
     }
 
+    // Thread-safe, in contrast to push
+    bool pushShared(const IncomingClientState clientState)
+    {
+      auto isWritten = true;
+      if (clientState.timeline)
+      {
+        isWritten = mSharedTimelines.write(clientState.timelineTimestamp,
+          TimelineCommit{
+            clientState.timelineTimestamp, *clientState.timeline, clientState.tempoRamp});
+      }
+
+      if (clientState.startStopState)
+      {
+        isWritten = mSharedStartStopStates.write((*clientState.startStopState).timestamp,
+                      *clientState.startStopState)
+                    && isWritten;
+      }
+
+      mController.mStats.rtCommitted();
+      mController.countRtCommitBeforeStart();
+      mCallbackDispatcher.invoke();
+      return isWritten;
+    }
+
+    void setFallbackPeriod(const std::chrono::milliseconds period)
+    {
+      mCallbackDispatcher.setFallbackPeriod(period);
+    }
+
     void processPendingClientStates()
     {
+      // Drain the queue even if it has been disabled in the meantime so that no
+      // outdated timelines are left when enabling it again
+      while (const auto commit = mTimelineQueue.read())
+      {
+        if (mController.mRtTimelineCommitQueueEnabled)
+        {
+          mController.handleQueuedRtTimeline(
+            (*commit).timestamp, (*commit).timeline, (*commit).tempoRamp);
+        }
+      }
+
       const auto clientState = buildMergedPendingClientState();
+      if (clientState.timeline || clientState.startStopState)
+      {
+        mController.mStats.rtCommitApplied();
+      }
       mController.handleRtClientState(clientState);
     }
 
@@ -606,21 +1825,52 @@ private:
       auto clientState = IncomingClientState{};
       if (auto tl = mTimelineBuffer.readNew())
       {
-        clientState.timelineTimestamp = (*tl).first;
-        clientState.timeline = OptionalTimeline{(*tl).second};
+        clientState.timelineTimestamp = (*tl).timestamp;
+        clientState.timeline = OptionalTimeline{(*tl).timeline};
+        clientState.tempoRamp = (*tl).tempoRamp;
       }
       if (auto sss = mStartStopStateBuffer.readNew())
       {
         clientState.startStopState = sss;
       }
+
+      // The latest of the commits of both paths wins
+      if (const auto tl = mSharedTimelines.readNew())
+      {
+        if (!clientState.timeline || (*tl).timestamp > clientState.timelineTimestamp)
+        {
+          clientState.timelineTimestamp = (*tl).timestamp;
+          clientState.timeline = OptionalTimeline{(*tl).timeline};
+          clientState.tempoRamp = (*tl).tempoRamp;
+        }
+      }
+      if (const auto sss = mSharedStartStopStates.readNew())
+      {
+        clientState.startStopState = OptionalClientStartStopState{
+          clientState.startStopState
+            ? detail::selectPreferredStartStopState(*clientState.startStopState, *sss)
+            : *sss};
+      }
       return clientState;
     }
 
+    struct TimelineCommit
+    {
+      std::chrono::microseconds timestamp;
+      Timeline timeline;
+      TempoRamp tempoRamp;
+    };
+
     Controller& mController;
     // Use separate TripleBuffers for the Timeline and the StartStopState so we read the
     // latest set value from either optional.
-    TripleBuffer<std::pair<std::chrono::microseconds, Timeline>> mTimelineBuffer;
+    TripleBuffer<TimelineCommit> mTimelineBuffer;
     TripleBuffer<ClientStartStopState> mStartStopStateBuffer;
+    SpscRingBuffer<TimelineCommit, detail::kRtTimelineCommitQueueSize> mTimelineQueue;
+    // Written by the threads that use setClientStateRtShared
+    MultiWriterBuffer<TimelineCommit, detail::kRtSharedCommitSlots> mSharedTimelines;
+    MultiWriterBuffer<ClientStartStopState, detail::kRtSharedCommitSlots>
+      mSharedStartStopStates;
     CallbackDispatcher mCallbackDispatcher;
   };
 
@@ -648,13 +1898,16 @@ private:
       const auto count =
         mController.mPeers.uniqueSessionPeerCount(mController.mSessionId);
       const auto oldCount = mSessionPeerCount.exchange(count);
+      mController.rememberSessionPeerAddresses();
+      mController.publishPeerList();
+      mController.publishSessionList();
       if (oldCount != count)
       {
         if (count == 0)
         {
           // When the count goes down to zero, completely reset the
           // state, effectively founding a new session
-          mController.mIo->async([this] { mController.resetState(); });
+          mController.scheduleStateReset();
         }
         mCallback(count);
       }
@@ -667,26 +1920,35 @@ private:
 
   struct MeasurePeer
   {
+    template <typename Handler>
+    struct CountingHandler
+    {
+      void operator()(GhostXForm xform, const SyncQuality quality) const
+      {
+        mpStats->measurementFinished(xform != GhostXForm{});
+        mHandler(std::move(xform), quality);
+      }
+
+      StatsCollector* mpStats;
+      Handler mHandler;
+    };
+
     template <typename Peer, typename Handler>
-    void operator()(Peer peer, Handler handler)
-    {
-      using It = typename Discovery::ServicePeerGateways::GatewayMap::iterator;
-      using ValueType = typename Discovery::ServicePeerGateways::GatewayMap::value_type;
-      mController.mDiscovery.withGateways([peer, handler](It begin, const It end) {
-        const auto addr = peer.second;
-        const auto it = std::find_if(
-          begin, end, [&addr](const ValueType& vt) { return vt.first == addr; });
-        if (it != end)
-        {
-          it->second->measurePeer(std::move(peer.first), std::move(handler));
-        }
-        else
-        {
-          // invoke the handler with an empty result if we couldn't
-          // find the peer's gateway
-          handler(GhostXForm{});
-        }
-      });
+    void operator()(Peer peer, Handler measurementHandler)
+    {
+      mController.mStats.measurementStarted();
+      auto handler =
+        CountingHandler<Handler>{&mController.mStats, std::move(measurementHandler)};
+      const auto found = mController.mDiscovery.withGateway(
+        peer.second, [&peer, &handler](const GatewayPtr& pGateway) {
+          pGateway->measurePeer(std::move(peer.first), std::move(handler));
+        });
+      if (!found)
+      {
+        // invoke the handler with an empty result if we couldn't
+        // find the peer's gateway
+        handler(GhostXForm{}, SyncQuality{});
+      }
     }
 
     Controller& mController;
@@ -699,6 +1961,16 @@ private:
       mController.joinSession(std::move(session));
     }
 
+    void switchDeferred()
+    {
+      mController.mStats.sessionSwitchDeferred();
+    }
+
+    void sessionsChanged()
+    {
+      mController.publishSessionList();
+    }
+
     Controller& mController;
   };
 
@@ -709,8 +1981,47 @@ private:
     SessionTimelineCallback,
     SessionStartStopStateCallback>;
 
-  using ControllerGateway =
-    Gateway<typename ControllerPeers::GatewayObserver, Clock, IoType&>;
+  using Peer = typename ControllerPeers::Peer;
+  using PeerLastSeen = util::FootprintHashMap<NodeId,
+    std::chrono::microseconds,
+    ControllerPeers::kMaxPeerEntries,
+    NodeIdHash>;
+
+  // Relays the observations of a gateway to the peers and records when the states of
+  // the peers arrive for the peer list
+  struct PeerListObserver
+  {
+    using GatewayObserverNodeState = PeerState;
+    using GatewayObserverNodeId = NodeId;
+
+    friend void sawPeer(PeerListObserver& observer, const PeerState& state)
+    {
+      observer.sawPeerState(state);
+    }
+
+    friend void peerLeft(PeerListObserver& observer, const NodeId& id)
+    {
+      peerLeft(observer.mPeersObserver, id);
+    }
+
+    friend void peerTimedOut(PeerListObserver& observer, const NodeId& id)
+    {
+      peerTimedOut(observer.mPeersObserver, id);
+    }
+
+    void sawPeerState(const PeerState& state)
+    {
+      const auto now = mpController->mClock.micros();
+      mpController->sawPeerState(state.ident(), now);
+      sawPeer(mPeersObserver, state);
+      mpController->refreshPeerList(now);
+    }
+
+    typename ControllerPeers::GatewayObserver mPeersObserver;
+    Controller* mpController;
+  };
+
+  using ControllerGateway = ShardedGateway<PeerListObserver, Clock, IoType&>;
   using GatewayPtr = std::shared_ptr<ControllerGateway>;
 
   struct GatewayFactory
@@ -719,16 +2030,29 @@ private:
       util::Injected<IoType&> io,
       const asio::ip::address& addr)
     {
-      if (addr.is_v4())
+      auto pShard = std::unique_ptr<IoType>{};
+      if (mController.mGatewayThreadPerInterface)
       {
-        return GatewayPtr{new ControllerGateway{std::move(io), addr.to_v4(),
-          util::injectVal(makeGatewayObserver(mController.mPeers, addr)),
-          std::move(state.first), std::move(state.second), mController.mClock}};
+        pShard.reset(new IoType{mController.mIo->makeShard(
+          UdpSendExceptionHandler{&mController}, "Link " + addr.to_string())});
+        pShard->setThreadPolicy(mController.mGatewayThreadPolicy);
       }
-      else
+      auto pGateway = GatewayPtr{new ControllerGateway{std::move(io), std::move(pShard),
+        addr,
+        PeerListObserver{makeGatewayObserver(mController.mPeers, addr), &mController},
+        std::move(state.first),
+        std::move(state.second), mController.mClock, mController.mStats.addGateway(addr),
+        false, mController.mGatewaySessionGroup, mController.mGatewayObserverMode,
+        mController.mGatewayMaxHubs, periodFactor(mController.mGatewayPowerProfile)}};
+      pGateway->setUnicastPeers(mController.mUnicastPeers);
+      for (const auto& peerAddr : mController.knownPeerAddresses())
       {
-        throw std::runtime_error("Could not create peer gateway on non-ipV4 address");
+        if (peerAddr != addr)
+        {
+          pGateway->announceTo({peerAddr, discovery::multicastEndpointV4().port()});
+        }
       }
+      return pGateway;
     }
 
     Controller& mController;
@@ -748,11 +2072,92 @@ private:
     Controller* mpController;
   };
 
+  Controller(Tempo tempo,
+    PeerCountCallback peerCallback,
+    TempoCallback tempoCallback,
+    StartStopStateCallback startStopStateCallback,
+    Clock clock,
+    std::function<IoContext(UdpSendExceptionHandler)> makeIoContext)
+    : mTempoCallback(std::move(tempoCallback))
+    , mStartStopStateCallback(std::move(startStopStateCallback))
+    , mClock(std::move(clock))
+    , mNodeId(NodeId::random<Random>())
+    , mSessionId(mNodeId)
+    , mSyncStratum(0)
+    , mSessionState(detail::initSessionState(tempo, mClock))
+    , mClientState(detail::initClientState(mSessionState))
+    , mLastIsPlayingForStartStopStateCallback(false)
+    , mRtClientState(detail::initRtClientState(mClientState.get()))
+    , mHasPendingRtClientStates(false)
+    , mIsInRtBlock(false)
+    , mRtTimelineCommitQueueEnabled(false)
+    , mSessionEventQueueEnabled(false)
+    , mSessionPeerCounter(*this, std::move(peerCallback))
+    , mEnabled(false)
+    , mSuspended(false)
+    , mIsShutDown(false)
+    , mIsStarted(false)
+    , mNumRtCommitsBeforeStart(0)
+    , mStartStopSyncEnabled(false)
+    , mSessionGroup(0)
+    , mGatewaySessionGroup(0)
+    , mObserverModeEnabled(false)
+    , mGatewayObserverMode(false)
+    , mMaxDiscoveryHubs(0)
+    , mGatewayMaxHubs(0)
+    , mThreadPerInterfaceEnabled(false)
+    , mGatewayThreadPerInterface(false)
+    , mPowerProfile(PowerProfile::Full)
+    , mGatewayPowerProfile(PowerProfile::Full)
+    , mLastPeerListTime(0)
+    , mpPeerList(std::make_shared<PeerList>())
+    , mpSessionList(std::make_shared<SessionList>())
+    , mMaxMeasuredOtherSessions(ControllerSessions::kDefaultMaxOtherSessions)
+    , mClockSlewingEnabled(false)
+    , mIo(makeIoContext(UdpSendExceptionHandler{this}))
+    , mClientStateSetter(*this)
+    , mRtClientStateSetter(*this)
+    , mDiscoveryUpdateTimer(mIo->makeTimer())
+    , mLastRtDiscoveryUpdate(
+        mDiscoveryUpdateTimer.now() - detail::kRtTimelineCommitDiscoveryPeriod)
+    , mHasScheduledDiscoveryUpdate(false)
+    , mStartStopRelayTimer(mIo->makeTimer())
+    , mHasScheduledStartStopRelay(false)
+    , mPendingTimeline{}
+    , mPendingTimelineTimer(mIo->makeTimer())
+    , mStateResetTimer(mIo->makeTimer())
+    , mClockSlewTimer(mIo->makeTimer())
+    , mRampTangentTimer(mIo->makeTimer())
+    , mPeers(util::injectRef(*mIo),
+        std::ref(mSessionPeerCounter),
+        SessionTimelineCallback{*this},
+        SessionStartStopStateCallback{*this})
+    , mSessions(
+        {mSessionId, mSessionState.timeline,
+          {mSessionState.ghostXForm, mClock.micros(), SyncQuality{}, 0}},
+        util::injectRef(mPeers),
+        MeasurePeer{*this},
+        JoinSessionCallback{*this},
+        util::injectRef(*mIo),
+        mClock)
+    , mDiscovery(std::make_pair(NodeState{mNodeId, mSessionId, mSessionState.timeline,
+                                  mSessionState.startStopState, mPendingTimeline,
+                                  mSessionState.tempoRamp, mSyncStratum, Timeline{}},
+                   mSessionState.ghostXForm),
+        GatewayFactory{*this},
+        util::injectRef(*mIo))
+  {
+    recordClientTimeline(std::chrono::microseconds::min(), mClientState.get().timeline);
+    publishSessionList();
+  }
+
   TempoCallback mTempoCallback;
   StartStopStateCallback mStartStopStateCallback;
   Clock mClock;
   NodeId mNodeId;
   SessionId mSessionId;
+  // See SyncStratum, only accessed on the io thread
+  std::uint8_t mSyncStratum;
 
   mutable std::mutex mSessionStateGuard;
   SessionState mSessionState;
@@ -760,19 +2165,85 @@ private:
   ControllerClientState mClientState;
   bool mLastIsPlayingForStartStopStateCallback;
 
+  // The state the realtime thread uses on every block is kept off the cache lines
+  // of the members that the other threads write
+  util::CacheLinePadding mRtLeadingPadding;
   mutable RtClientState mRtClientState;
   std::atomic<bool> mHasPendingRtClientStates;
+  bool mIsInRtBlock;
+  util::CacheLinePadding mRtTrailingPadding;
+  std::atomic<bool> mRtTimelineCommitQueueEnabled;
+  std::atomic<bool> mSessionEventQueueEnabled;
+  SpscRingBuffer<SessionEvent, detail::kSessionEventQueueSize> mSessionEvents;
+  TimelineHistory<detail::kTimelineHistorySize> mTimelineHistory;
+  mutable TripleBuffer<TimelineHistory<detail::kTimelineHistorySize>> mRtTimelineHistory;
+  mutable StatsCollector mStats;
 
   SessionPeerCounter mSessionPeerCounter;
 
+  std::mutex mEnableGuard;
   std::atomic<bool> mEnabled;
+  bool mSuspended;
+  std::atomic<bool> mIsShutDown;
+  // Whether the threads of the io context have been started, guarded by mStartGuard
+  // while they haven't
+  std::recursive_mutex mStartGuard;
+  std::atomic<bool> mIsStarted;
+  std::atomic<std::size_t> mNumRtCommitsBeforeStart;
+  mutable std::mutex mKnownPeerAddressesGuard;
+  std::vector<asio::ip::address> mKnownPeerAddresses;
+  std::vector<asio::ip::udp::endpoint> mUnicastPeers;
+  mutable std::mutex mSyncQualityGuard;
+  SyncQuality mSyncQuality;
 
   std::atomic<bool> mStartStopSyncEnabled;
+  std::atomic<discovery::v1::SessionGroupId> mSessionGroup;
+  // The group of the gateways, only accessed on the io thread
+  discovery::v1::SessionGroupId mGatewaySessionGroup;
+  std::atomic<bool> mObserverModeEnabled;
+  // Whether the gateways only listen, only accessed on the io thread
+  bool mGatewayObserverMode;
+  std::atomic<std::size_t> mMaxDiscoveryHubs;
+  // The hubs of the gateways, only accessed on the io thread
+  std::size_t mGatewayMaxHubs;
+  std::atomic<bool> mThreadPerInterfaceEnabled;
+  // Whether the gateways run on shards and the policy of their threads, only
+  // accessed on the io thread
+  bool mGatewayThreadPerInterface;
+  platforms::ThreadPolicy mGatewayThreadPolicy;
+  std::atomic<PowerProfile> mPowerProfile;
+  // The profile that the io thread applies, only accessed on the io thread
+  PowerProfile mGatewayPowerProfile;
+  // When the peers were last seen and the list was last published, only accessed on
+  // the io thread
+  PeerLastSeen mPeerLastSeen;
+  std::chrono::microseconds mLastPeerListTime;
+  mutable std::mutex mPeerListGuard;
+  std::shared_ptr<const PeerList> mpPeerList;
+  mutable std::mutex mSessionListGuard;
+  std::shared_ptr<const SessionList> mpSessionList;
+  std::atomic<std::size_t> mMaxMeasuredOtherSessions;
+  std::atomic<bool> mClockSlewingEnabled;
 
   util::Injected<IoContext> mIo;
 
+  ClientStateSetter mClientStateSetter;
   RtClientStateSetter mRtClientStateSetter;
 
+  using Timer = typename util::Injected<IoContext>::type::Timer;
+  Timer mDiscoveryUpdateTimer;
+  typename Timer::TimePoint mLastRtDiscoveryUpdate;
+  bool mHasScheduledDiscoveryUpdate;
+  Timer mStartStopRelayTimer;
+  bool mHasScheduledStartStopRelay;
+  // The timeline that replaces the session timeline at its activation time, in
+  // ghost time
+  PendingTimeline mPendingTimeline;
+  Timer mPendingTimelineTimer;
+  Timer mStateResetTimer;
+  Timer mClockSlewTimer;
+  Timer mRampTangentTimer;
+
   ControllerPeers mPeers;
 
   using ControllerSessions = Sessions<ControllerPeers&,
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <ableton/discovery/PeerGateway.hpp>
+#include <ableton/link/ClockDomain.hpp>
 #include <ableton/link/MeasurementService.hpp>
 #include <ableton/link/PeerState.hpp>
 
@@ -28,65 +29,198 @@ namespace ableton
 namespace link
 {
 
+// Peers broadcast with a jittered period, so that devices that were powered on
+// together don't keep broadcasting in bursts, and sessions with more than 16 nodes
+// on an interface broadcast less often per peer. Observers only listen. Discovery
+// is hierarchical if maxHubs is non-zero. The broadcast period is stretched by the
+// periodFactor of the power profile.
+inline discovery::BroadcastPolicy broadcastPolicy(
+  const discovery::v1::SessionGroupId groupId = 0,
+  const bool isObserver = false,
+  const std::size_t maxHubs = 0,
+  const std::size_t periodFactor = 1)
+{
+  auto policy = discovery::defaultBroadcastPolicy();
+  policy.periodJitter = 0.25;
+  policy.maxNodesAtNominalPeriod = 16;
+  policy.groupId = groupId;
+  policy.listenOnly = isObserver;
+  policy.maxHubs = maxHubs;
+  policy.maxUrgentBroadcasts = 3;
+  policy.periodFactor = periodFactor;
+  return policy;
+}
+
 template <typename PeerObserver, typename Clock, typename IoContext>
 class Gateway
 {
+  // Opens the ping responder on the first peer that is seen. The messenger passes
+  // the state of a peer on before answering it, so that the answer and the
+  // broadcast that follows already announce the endpoint of the responder. Peers
+  // that haven't announced theirs yet aren't passed on, as they can't be measured.
+  // They do so as soon as they see this node.
+  struct Observer
+  {
+    using ObserverT = typename util::Injected<PeerObserver>::type;
+    using GatewayObserverNodeState = typename ObserverT::GatewayObserverNodeState;
+    using GatewayObserverNodeId = typename ObserverT::GatewayObserverNodeId;
+
+    friend void sawPeer(Observer& observer, const GatewayObserverNodeState& state)
+    {
+      observer.openPingResponder();
+      if (state.endpoint.port() != 0)
+      {
+        sawPeer(*observer.mObserver, state);
+      }
+    }
+
+    friend void peerLeft(Observer& observer, const GatewayObserverNodeId& id)
+    {
+      peerLeft(*observer.mObserver, id);
+    }
+
+    friend void peerTimedOut(Observer& observer, const GatewayObserverNodeId& id)
+    {
+      peerTimedOut(*observer.mObserver, id);
+    }
+
+    void openPingResponder()
+    {
+      mpGateway->openPingResponder();
+    }
+
+    util::Injected<PeerObserver> mObserver;
+    Gateway* mpGateway;
+  };
+
 public:
   Gateway(util::Injected<IoContext> io,
-    asio::ip::address_v4 addr,
+    asio::ip::address addr,
     util::Injected<PeerObserver> observer,
     NodeState nodeState,
     GhostXForm ghostXForm,
-    Clock clock)
+    Clock clock,
+    std::shared_ptr<discovery::GatewayStats> pStats =
+      std::make_shared<discovery::GatewayStats>(),
+    const bool shareResponderSocket = false,
+    const discovery::v1::SessionGroupId groupId = 0,
+    const bool isObserver = false,
+    const std::size_t maxHubs = 0,
+    const std::size_t periodFactor = 1)
     : mIo(std::move(io))
+    , mClockDomainId(clockDomainId(clock))
+    , mGroupId(groupId)
+    , mIsObserver(isObserver)
+    , mMaxHubs(maxHubs)
+    , mPeriodFactor(periodFactor)
     , mMeasurement(addr,
         nodeState.sessionId,
-        std::move(ghostXForm),
+        ghostXForm,
         std::move(clock),
-        util::injectRef(*mIo))
-    , mPeerGateway(discovery::makeIpV4Gateway(util::injectRef(*mIo),
+        util::injectRef(*mIo),
+        pStats,
+        decltype(mMeasurement)::kDefaultMaxMeasurements,
+        shareResponderSocket)
+    , mState{std::move(nodeState), mMeasurement.endpoint(),
+        ClockDomain{mClockDomainId, std::move(ghostXForm)}, 0}
+    , mPeerGateway(discovery::makeIpGateway(util::injectRef(*mIo),
         std::move(addr),
-        std::move(observer),
-        PeerState{std::move(nodeState), mMeasurement.endpoint()}))
+        util::injectVal(Observer{std::move(observer), this}),
+        mState,
+        broadcastPolicy(groupId, isObserver, maxHubs, periodFactor),
+        std::move(pStats)))
   {
   }
 
+  // The observer of the peer gateway refers to the gateway, which therefore can't
+  // be moved
   Gateway(const Gateway& rhs) = delete;
   Gateway& operator=(const Gateway& rhs) = delete;
 
-  Gateway(Gateway&& rhs)
-    : mIo(std::move(rhs.mIo))
-    , mMeasurement(std::move(rhs.mMeasurement))
-    , mPeerGateway(std::move(rhs.mPeerGateway))
+  void updateNodeState(std::pair<NodeState, GhostXForm> state,
+    const discovery::StateBroadcast broadcast = discovery::StateBroadcast::Normal)
   {
+    mMeasurement.updateNodeState(state.first.sessionId, state.second);
+    mState = PeerState{std::move(state.first), mMeasurement.endpoint(),
+      ClockDomain{mClockDomainId, std::move(state.second)}, 0};
+    mPeerGateway.updateState(mState, broadcast);
   }
 
-  Gateway& operator=(Gateway&& rhs)
+  void suspend(const bool bSuspend)
   {
-    mIo = std::move(rhs.mIo);
-    mMeasurement = std::move(rhs.mMeasurement);
-    mPeerGateway = std::move(rhs.mPeerGateway);
-    return *this;
+    mPeerGateway.suspend(bSuspend);
   }
 
-  void updateNodeState(std::pair<NodeState, GhostXForm> state)
+  void enableObserverMode(const bool bEnable)
   {
-    mMeasurement.updateNodeState(state.first.sessionId, state.second);
-    mPeerGateway.updateState(PeerState{std::move(state.first), mMeasurement.endpoint()});
+    mIsObserver = bEnable;
+    updateBroadcastPolicy();
+  }
+
+  void setMaxHubs(const std::size_t maxHubs)
+  {
+    mMaxHubs = maxHubs;
+    updateBroadcastPolicy();
+  }
+
+  void setPeriodFactor(const std::size_t periodFactor)
+  {
+    mPeriodFactor = periodFactor;
+    updateBroadcastPolicy();
+  }
+
+  void setUnicastPeers(std::vector<asio::ip::udp::endpoint> peers)
+  {
+    mPeerGateway.setUnicastPeers(std::move(peers));
+  }
+
+  void announceTo(const asio::ip::udp::endpoint& to)
+  {
+    mPeerGateway.announceTo(to);
   }
 
   template <typename Handler>
   void measurePeer(const PeerState& peer, Handler handler)
   {
     mMeasurement.measurePeer(peer, std::move(handler));
+    // The measurement retries opening the ping responder if that failed before
+    announceEndpoint();
   }
 
 private:
+  void openPingResponder()
+  {
+    mMeasurement.openPingResponder();
+    announceEndpoint();
+  }
+
+  // Peers that are already known get the endpoint without waiting for the next
+  // broadcast
+  void announceEndpoint()
+  {
+    if (mMeasurement.endpoint() != mState.endpoint)
+    {
+      mState.endpoint = mMeasurement.endpoint();
+      mPeerGateway.updateState(mState, discovery::StateBroadcast::Urgent);
+    }
+  }
+
+  void updateBroadcastPolicy()
+  {
+    mPeerGateway.setBroadcastPolicy(
+      broadcastPolicy(mGroupId, mIsObserver, mMaxHubs, mPeriodFactor));
+  }
+
   util::Injected<IoContext> mIo;
+  ClockDomainId mClockDomainId;
+  discovery::v1::SessionGroupId mGroupId;
+  bool mIsObserver;
+  std::size_t mMaxHubs;
+  std::size_t mPeriodFactor;
   MeasurementService<Clock, typename util::Injected<IoContext>::type&> mMeasurement;
-  discovery::
-    IpV4Gateway<PeerObserver, PeerState, typename util::Injected<IoContext>::type&>
-      mPeerGateway;
+  PeerState mState;
+  discovery::IpGateway<Observer, PeerState, typename util::Injected<IoContext>::type&>
+    mPeerGateway;
 };
 
 } // namespace link
@@ -29,33 +29,71 @@ namespace link
 
 using std::chrono::microseconds;
 
+// Maps host time to the ghost time of a session and back. The slope differs from 1
+// when the host clock drifts relative to the ghost time. Its inverse is computed
+// once on construction, so mapping ghost time to host time doesn't divide. The
+// slope and intercept must therefore not be modified after construction.
 struct GhostXForm
 {
-  microseconds hostToGhost(const microseconds hostTime) const
+  GhostXForm() = default;
+
+  GhostXForm(const double slope_, const microseconds intercept_) noexcept
+    : slope(slope_)
+    , intercept(intercept_)
+    , mInverseSlope(slope_ == 0. ? 0. : 1. / slope_)
+  {
+  }
+
+  microseconds hostToGhost(const microseconds hostTime) const noexcept
   {
     return microseconds{llround(slope * static_cast<double>(hostTime.count()))}
            + intercept;
   }
 
-  microseconds ghostToHost(const microseconds ghostTime) const
+  microseconds ghostToHost(const microseconds ghostTime) const noexcept
   {
     return microseconds{
-      llround(static_cast<double>((ghostTime - intercept).count()) / slope)};
+      llround(static_cast<double>((ghostTime - intercept).count()) * mInverseSlope)};
+  }
+
+  double inverseSlope() const noexcept
+  {
+    return mInverseSlope;
   }
 
-  friend bool operator==(const GhostXForm lhs, const GhostXForm rhs)
+  friend constexpr bool operator==(const GhostXForm lhs, const GhostXForm rhs) noexcept
   {
     return lhs.slope == rhs.slope && lhs.intercept == rhs.intercept;
   }
 
-  friend bool operator!=(const GhostXForm lhs, const GhostXForm rhs)
+  friend constexpr bool operator!=(const GhostXForm lhs, const GhostXForm rhs) noexcept
   {
     return !(lhs == rhs);
   }
 
-  double slope;
-  microseconds intercept;
+  double slope = 0.;
+  microseconds intercept{0};
+
+private:
+  double mInverseSlope = 0.;
 };
 
+// The xform that continues from the ghost time of from at hostTime and meets to once
+// the duration has passed. The rate of its ghost time differs from the one of to by
+// the offset between the two at hostTime divided by the duration, so moving from one
+// xform to the other this way doesn't make the ghost time jump.
+inline GhostXForm slewedXForm(const GhostXForm from,
+  const GhostXForm to,
+  const microseconds hostTime,
+  const microseconds duration) noexcept
+{
+  const auto start = from.hostToGhost(hostTime);
+  const auto end = to.hostToGhost(hostTime + duration);
+  const auto slope =
+    static_cast<double>((end - start).count()) / static_cast<double>(duration.count());
+  return GhostXForm{
+    slope, start - microseconds{llround(slope * static_cast<double>(hostTime.count()))}};
+}
+
 } // namespace link
 } // namespace ableton
@@ -0,0 +1,111 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/link/GhostXForm.hpp>
+#include <ableton/link/LinearRegression.hpp>
+#include <chrono>
+#include <vector>
+
+namespace ableton
+{
+namespace link
+{
+
+// Tracks the GhostXForm of a session over a series of measurements. A single
+// measurement only determines the offset between host and ghost time at the time
+// of the measurement, so the drift of the host clock relative to the ghost time
+// accumulates until the next one. The tracker fits a line through the most recent
+// measurements to estimate the drift as well, which results in an xform that
+// stays accurate between measurements and changes smoothly with each of them.
+
+class GhostXFormTracker
+{
+public:
+  static const std::size_t kMaxNumMeasurements = 12;
+  static const std::size_t kMinNumMeasurementsForDrift = 3;
+
+  GhostXFormTracker()
+  {
+    mMeasurements.reserve(kMaxNumMeasurements);
+  }
+
+  void reset()
+  {
+    mMeasurements.clear();
+  }
+
+  // Add a measurement taken at the given host time and return the updated xform
+  GhostXForm update(const std::chrono::microseconds hostTime, const GhostXForm xform)
+  {
+    if (mMeasurements.size() == kMaxNumMeasurements)
+    {
+      mMeasurements.erase(mMeasurements.begin());
+    }
+    mMeasurements.push_back({hostTime, xform.hostToGhost(hostTime)});
+    return estimate();
+  }
+
+private:
+  struct Measurement
+  {
+    std::chrono::microseconds hostTime;
+    std::chrono::microseconds ghostTime;
+  };
+
+  GhostXForm estimate() const
+  {
+    using namespace std::chrono;
+
+    const auto& latest = mMeasurements.back();
+    if (mMeasurements.size() < kMinNumMeasurementsForDrift)
+    {
+      return GhostXForm{1., latest.ghostTime - latest.hostTime};
+    }
+
+    // Fit the offset between ghost and host time relative to the first
+    // measurement to keep the numbers small
+    const auto& first = mMeasurements.front();
+    std::vector<std::pair<double, double>> points;
+    points.reserve(mMeasurements.size());
+    for (const auto& measurement : mMeasurements)
+    {
+      points.emplace_back(
+        static_cast<double>((measurement.hostTime - first.hostTime).count()),
+        static_cast<double>(
+          (measurement.ghostTime - measurement.hostTime - first.ghostTime
+            + first.hostTime)
+            .count()));
+    }
+    const auto line = linearRegression(points.begin(), points.end());
+
+    // ghost = host + firstOffset + drift * (host - firstHost)
+    const auto drift = line.first;
+    const auto intercept = static_cast<double>((first.ghostTime - first.hostTime).count())
+                           + line.second
+                           - drift * static_cast<double>(first.hostTime.count());
+    return GhostXForm{1. + drift, microseconds{llround(intercept)}};
+  }
+
+  std::vector<Measurement> mMeasurements;
+};
+
+} // namespace link
+} // namespace ableton
@@ -22,6 +22,7 @@
 #include <ableton/link/LinearRegression.hpp>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <utility>
 #include <vector>
 
@@ -82,5 +83,272 @@ private:
 template <typename Clock>
 using HostTimeFilter = BasicHostTimeFilter<Clock, double, 512>;
 
+// Variant of BasicHostTimeFilter with constant cost per sample. Instead of
+// running the regression over all buffered points on every call, it keeps
+// running sums that are updated with the new point and the evicted one. To
+// bound the accumulation of rounding errors, the sums are recomputed from the
+// buffered points each time the ring buffer wraps around.
+template <typename Clock, typename NumberType, std::size_t kNumPoints = 512>
+class BasicIncrementalHostTimeFilter
+{
+  using Point = std::pair<NumberType, NumberType>;
+  using Points = std::vector<Point>;
+
+public:
+  BasicIncrementalHostTimeFilter()
+    : mIndex(0)
+  {
+    mPoints.reserve(kNumPoints);
+  }
+
+  ~BasicIncrementalHostTimeFilter() = default;
+
+  void reset()
+  {
+    mIndex = 0;
+    mPoints.clear();
+    mSums = {};
+  }
+
+  std::chrono::microseconds sampleTimeToHostTime(const NumberType sampleTime)
+  {
+    const auto micros = static_cast<NumberType>(mHostTimeSampler.micros().count());
+    const auto point = std::make_pair(sampleTime, micros);
+
+    if (mPoints.size() < kNumPoints)
+    {
+      mPoints.push_back(point);
+    }
+    else
+    {
+      mSums.remove(mPoints[mIndex]);
+      mPoints[mIndex] = point;
+    }
+    mSums.add(point);
+    mIndex = (mIndex + 1) % kNumPoints;
+
+    if (mIndex == 0)
+    {
+      resync();
+    }
+
+    const auto result = linearRegressionFromSums(static_cast<NumberType>(mPoints.size()),
+      mSums.x, mSums.xx, mSums.xy, mSums.y);
+
+    const auto hostTime = (result.first * sampleTime) + result.second;
+
+    return std::chrono::microseconds(llround(hostTime));
+  }
+
+private:
+  struct Sums
+  {
+    void add(const Point& p)
+    {
+      x += p.first;
+      xx += p.first * p.first;
+      xy += p.first * p.second;
+      y += p.second;
+    }
+
+    void remove(const Point& p)
+    {
+      x -= p.first;
+      xx -= p.first * p.first;
+      xy -= p.first * p.second;
+      y -= p.second;
+    }
+
+    NumberType x = 0;
+    NumberType xx = 0;
+    NumberType xy = 0;
+    NumberType y = 0;
+  };
+
+  void resync()
+  {
+    mSums = {};
+    for (const auto& point : mPoints)
+    {
+      mSums.add(point);
+    }
+  }
+
+  std::size_t mIndex;
+  Points mPoints;
+  Sums mSums;
+  Clock mHostTimeSampler;
+};
+
+template <typename Clock>
+using IncrementalHostTimeFilter = BasicIncrementalHostTimeFilter<Clock, double, 512>;
+
+// Variant of BasicHostTimeFilter for long running streams and jittery callbacks.
+//
+// The points are stored as exact integers and the regression is evaluated
+// relative to the newest point and centered around the means of the others, so
+// that the arithmetic only deals with the spread of the buffered points instead of
+// the absolute sample and host times, which grow to 1e10 and beyond after days of
+// uptime. This keeps the fit accurate in float, e.g. on embedded targets without
+// double precision hardware, as long as the buffered points span less than 2^24
+// samples and microseconds.
+//
+// A point whose host time deviates from the fit of the previous points by more
+// than kOutlierFactor times the mean deviation of the accepted points, and by at
+// least kMinOutlierThreshold, is left out of the fit. This keeps single late
+// callbacks from skewing the fit. After more than kMaxOutliers outliers in a row
+// the timing of the stream is assumed to have changed and the filter restarts.
+template <typename Clock, typename NumberType, std::size_t kNumPoints = 512>
+class BasicRobustHostTimeFilter
+{
+  using Point = std::pair<std::int64_t, std::int64_t>;
+  using Points = std::vector<Point>;
+
+public:
+  static constexpr std::size_t kMinPointsForOutliers = 16;
+  static constexpr std::size_t kMaxOutliers = 8;
+  static constexpr NumberType kOutlierFactor = 4;
+  static constexpr NumberType kMinOutlierThreshold = 1000; // Microseconds
+
+  BasicRobustHostTimeFilter()
+    : mIndex(0)
+    , mMeanDeviation(0)
+    , mNumOutliers(0)
+  {
+    mPoints.reserve(kNumPoints);
+  }
+
+  ~BasicRobustHostTimeFilter() = default;
+
+  void reset()
+  {
+    mIndex = 0;
+    mPoints.clear();
+    mMeanDeviation = 0;
+    mNumOutliers = 0;
+  }
+
+  std::chrono::microseconds sampleTimeToHostTime(const double sampleTime)
+  {
+    const auto point = Point{static_cast<std::int64_t>(llround(sampleTime)),
+      static_cast<std::int64_t>(mHostTimeSampler.micros().count())};
+
+    const auto moments = momentsOfOthers(point);
+    if (moments.numPoints >= static_cast<NumberType>(kMinPointsForOutliers))
+    {
+      // The deviation of the new point from the fit of the others
+      const auto fit = moments.fitAtOrigin();
+      const auto deviation = std::abs(fit);
+      if (deviation > kMinOutlierThreshold && deviation > kOutlierFactor * mMeanDeviation)
+      {
+        if (++mNumOutliers <= kMaxOutliers)
+        {
+          return hostTime(point, fit);
+        }
+        reset();
+        mPoints.push_back(point);
+        mIndex = 1;
+        return hostTime(point, 0);
+      }
+      mMeanDeviation += (deviation - mMeanDeviation) / NumberType{16};
+    }
+    mNumOutliers = 0;
+
+    if (mPoints.size() < kNumPoints)
+    {
+      mPoints.push_back(point);
+    }
+    else
+    {
+      mPoints[mIndex] = point;
+    }
+    mIndex = (mIndex + 1) % kNumPoints;
+
+    return hostTime(point, moments.withOrigin().fitAtOrigin());
+  }
+
+private:
+  // Means and centered sums of squares of points relative to the new point
+  struct Moments
+  {
+    // The value of the fit at the new point
+    NumberType fitAtOrigin() const
+    {
+      const auto slope = sumXX == NumberType{0} ? NumberType{0} : sumXY / sumXX;
+      return meanY - slope * meanX;
+    }
+
+    // The moments including the new point, which is at the origin
+    Moments withOrigin() const
+    {
+      const auto num = numPoints + 1;
+      const auto x = meanX * numPoints / num;
+      const auto y = meanY * numPoints / num;
+      return {num, x, y, sumXX + meanX * x, sumXY + meanX * y};
+    }
+
+    NumberType numPoints;
+    NumberType meanX;
+    NumberType meanY;
+    NumberType sumXX;
+    NumberType sumXY;
+  };
+
+  // The moments of the buffered points but for the one that the new point
+  // replaces. The means are taken from exact integer sums, so that only the
+  // centered sums are subject to rounding.
+  Moments momentsOfOthers(const Point& point) const
+  {
+    const auto replaced = mPoints.size() < kNumPoints ? mPoints.size() : mIndex;
+    std::int64_t numPoints = 0;
+    std::int64_t sumX = 0;
+    std::int64_t sumY = 0;
+    for (std::size_t i = 0; i < mPoints.size(); ++i)
+    {
+      if (i != replaced)
+      {
+        ++numPoints;
+        sumX += mPoints[i].first - point.first;
+        sumY += mPoints[i].second - point.second;
+      }
+    }
+
+    auto moments = Moments{static_cast<NumberType>(numPoints), 0, 0, 0, 0};
+    if (numPoints == 0)
+    {
+      return moments;
+    }
+    moments.meanX = static_cast<NumberType>(sumX) / moments.numPoints;
+    moments.meanY = static_cast<NumberType>(sumY) / moments.numPoints;
+    for (std::size_t i = 0; i < mPoints.size(); ++i)
+    {
+      if (i != replaced)
+      {
+        const auto x =
+          static_cast<NumberType>(mPoints[i].first - point.first) - moments.meanX;
+        const auto y =
+          static_cast<NumberType>(mPoints[i].second - point.second) - moments.meanY;
+        moments.sumXX += x * x;
+        moments.sumXY += x * y;
+      }
+    }
+    return moments;
+  }
+
+  static std::chrono::microseconds hostTime(const Point& point, const NumberType fit)
+  {
+    return std::chrono::microseconds{point.second + llround(fit)};
+  }
+
+  std::size_t mIndex;
+  Points mPoints;
+  NumberType mMeanDeviation;
+  std::size_t mNumOutliers;
+  Clock mHostTimeSampler;
+};
+
+template <typename Clock>
+using RobustHostTimeFilter = BasicRobustHostTimeFilter<Clock, double, 512>;
+
 } // namespace link
 } // namespace ableton
@@ -28,6 +28,26 @@ namespace ableton
 namespace link
 {
 
+// Compute (slope, intercept) of the least squares fit from the
+// accumulated sums of a set of points. Useful for callers that
+// maintain the sums incrementally.
+template <typename NumberType>
+std::pair<NumberType, NumberType> linearRegressionFromSums(const NumberType numPoints,
+  const NumberType sumX,
+  const NumberType sumXX,
+  const NumberType sumXY,
+  const NumberType sumY)
+{
+  assert(numPoints > 0);
+  const NumberType denominator = numPoints * sumXX - sumX * sumX;
+  const NumberType slope = denominator == NumberType{0}
+                             ? NumberType{0}
+                             : (numPoints * sumXY - sumX * sumY) / denominator;
+  const NumberType intercept = (sumY - slope * sumX) / numPoints;
+
+  return std::make_pair(slope, intercept);
+}
+
 template <typename It>
 typename std::iterator_traits<It>::value_type linearRegression(It begin, It end)
 {
@@ -47,14 +67,7 @@ typename std::iterator_traits<It>::value_type linearRegression(It begin, It end)
   }
 
   const NumberType numPoints = static_cast<NumberType>(distance(begin, end));
-  assert(numPoints > 0);
-  const NumberType denominator = numPoints * sumXX - sumX * sumX;
-  const NumberType slope = denominator == NumberType{0}
-                             ? NumberType{0}
-                             : (numPoints * sumXY - sumX * sumY) / denominator;
-  const NumberType intercept = (sumY - slope * sumX) / numPoints;
-
-  return std::make_pair(slope, intercept);
+  return linearRegressionFromSums(numPoints, sumX, sumXX, sumXY, sumY);
 }
 
 } // namespace link
@@ -19,13 +19,18 @@
 
 #pragma once
 
+#include <ableton/discovery/GatewayStats.hpp>
 #include <ableton/discovery/Payload.hpp>
+#include <ableton/discovery/SocketOptions.hpp>
+#include <ableton/link/Median.hpp>
 #include <ableton/link/PayloadEntries.hpp>
 #include <ableton/link/PeerState.hpp>
 #include <ableton/link/SessionId.hpp>
 #include <ableton/link/v1/Messages.hpp>
 #include <ableton/util/Injected.hpp>
+#include <ableton/util/Log.hpp>
 #include <ableton/util/SafeAsyncHandler.hpp>
+#include <ableton/util/Trace.hpp>
 #include <chrono>
 #include <memory>
 
@@ -37,20 +42,67 @@ namespace link
 template <typename Clock, typename IoContext>
 struct Measurement
 {
+  // Receives the data points in ascending order, or none if the measurement failed
   using Callback = std::function<void(std::vector<double>&)>;
   using Micros = std::chrono::microseconds;
+  using Socket =
+    typename util::Injected<IoContext>::type::template Socket<v1::kMaxMessageSize>;
 
   static const std::size_t kNumberDataPoints = 100;
   static const std::size_t kNumberMeasurements = 5;
+  // The measurement finishes early after kMinNumberDataPoints if the 95% confidence
+  // interval of the median is narrower than kMaxMedianConfidenceInterval microseconds
+  static const std::size_t kMinNumberDataPoints = 20;
+  static const std::size_t kMaxMedianConfidenceInterval = 200;
+  // Pings that aren't answered in time are considered lost and are sent again. The
+  // timeout doubles with every consecutive loss, up to kMaxTimeoutFactor times the
+  // initial one, so that a lossy link isn't flooded with retries. If the retries run
+  // out with at least kMinPartialDataPoints, the measurement finishes with them
+  // rather than failing.
+  static const std::size_t kInitialTimeoutMillis = 50;
+  static const std::size_t kMaxTimeoutFactor = 8;
+  static const std::size_t kMinPartialDataPoints = 10;
 
+  // Up to numPingsInFlight pings are outstanding at the same time. Every pong is
+  // answered with a new ping right away, so each of them forms an independent
+  // chain of ping/pong exchanges and data points are collected numPingsInFlight
+  // times as fast as with a single outstanding ping.
   Measurement(const PeerState& state,
     Callback callback,
-    asio::ip::address_v4 address,
+    asio::ip::address address,
     Clock clock,
-    util::Injected<IoContext> io)
+    util::Injected<IoContext> io,
+    const std::size_t numPingsInFlight = 1,
+    std::shared_ptr<discovery::GatewayStats> pStats =
+      std::make_shared<discovery::GatewayStats>())
+    : Measurement(state,
+        std::move(callback),
+        makeResources(io, std::move(address)),
+        std::move(clock),
+        std::move(io),
+        numPingsInFlight,
+        std::move(pStats))
+  {
+  }
+
+  // Uses the socket and buffers of a previous measurement, see makeResources
+  struct Resources;
+  Measurement(const PeerState& state,
+    Callback callback,
+    std::shared_ptr<Resources> pResources,
+    Clock clock,
+    util::Injected<IoContext> io,
+    const std::size_t numPingsInFlight = 1,
+    std::shared_ptr<discovery::GatewayStats> pStats =
+      std::make_shared<discovery::GatewayStats>())
     : mIo(std::move(io))
-    , mpImpl(std::make_shared<Impl>(
-        std::move(state), std::move(callback), std::move(address), std::move(clock), mIo))
+    , mpImpl(std::make_shared<Impl>(std::move(state),
+        std::move(callback),
+        std::move(pResources),
+        std::move(clock),
+        mIo,
+        numPingsInFlight,
+        std::move(pStats)))
   {
     mpImpl->listen();
   }
@@ -60,47 +112,158 @@ struct Measurement
   Measurement(const Measurement&&) = delete;
   Measurement& operator=(Measurement&&) = delete;
 
+  // Opens a socket for measurements on the given address. Throws
+  // std::runtime_error if that fails.
+  static std::shared_ptr<Resources> makeResources(
+    util::Injected<IoContext>& io, asio::ip::address address)
+  {
+    auto pResources = std::make_shared<Resources>(
+      std::make_shared<Socket>(
+        io->template openUnicastSocket<v1::kMaxMessageSize>(
+          address, discovery::TrafficClass::Timing)),
+      std::move(address));
+    pResources->listen();
+    return pResources;
+  }
+
+  // Sends the pings through a socket that is owned by someone else, who passes the
+  // pongs it receives to Resources::receive
+  static std::shared_ptr<Resources> makeResources(
+    std::shared_ptr<Socket> pSocket, asio::ip::address address)
+  {
+    return std::make_shared<Resources>(std::move(pSocket), std::move(address));
+  }
+
+  asio::ip::udp::endpoint endpoint() const
+  {
+    return mpImpl->mEndpoint;
+  }
+
+  const std::shared_ptr<Resources>& resources() const
+  {
+    return mpImpl->mpResources;
+  }
+
+  struct Impl;
+
+  // The socket and the data buffers of a measurement, which can be reused by
+  // later measurements so that they don't need to open a socket or allocate.
+  // The messages received on the socket are passed to the measurement that
+  // currently uses it.
+  struct Resources : util::EnableAsyncSafe<Resources>
+  {
+    Resources(std::shared_ptr<Socket> pSocket, asio::ip::address address)
+      : mpSocket(std::move(pSocket))
+      , mAddress(std::move(address))
+    {
+      // Two data points are added per pong
+      mData.reserve(kNumberDataPoints + 2);
+      mRoundTrips.reserve(kNumberDataPoints + 2);
+    }
+
+    void listen()
+    {
+      mpSocket->receive(this->asyncSafe());
+    }
+
+    template <typename It>
+    void operator()(
+      const asio::ip::udp::endpoint& from, const It messageBegin, const It messageEnd)
+    {
+      receive(from, messageBegin, messageEnd);
+      listen();
+    }
+
+    template <typename It>
+    void receive(
+      const asio::ip::udp::endpoint& from, const It messageBegin, const It messageEnd)
+    {
+      if (const auto pUser = mpUser.lock())
+      {
+        (*pUser)(from, messageBegin, messageEnd);
+      }
+    }
+
+    std::shared_ptr<Socket> mpSocket;
+    asio::ip::address mAddress;
+    std::vector<double> mData;
+    // The round trip times of the pings, in the order of their pongs
+    std::vector<double> mRoundTrips;
+    std::weak_ptr<Impl> mpUser;
+  };
+
   struct Impl : std::enable_shared_from_this<Impl>
   {
-    using Socket =
-      typename util::Injected<IoContext>::type::template Socket<v1::kMaxMessageSize>;
     using Timer = typename util::Injected<IoContext>::type::Timer;
     using Log = typename util::Injected<IoContext>::type::Log;
+    using Trace = typename util::Injected<IoContext>::type::Trace;
 
     Impl(const PeerState& state,
       Callback callback,
-      asio::ip::address_v4 address,
+      std::shared_ptr<Resources> pResources,
       Clock clock,
-      util::Injected<IoContext> io)
-      : mSocket(io->template openUnicastSocket<v1::kMaxMessageSize>(address))
+      util::Injected<IoContext> io,
+      const std::size_t numPingsInFlight,
+      std::shared_ptr<discovery::GatewayStats> pStats)
+      : mpResources(std::move(pResources))
+      , mSocket(*mpResources->mpSocket)
+      , mData(mpResources->mData)
+      , mRoundTrips(mpResources->mRoundTrips)
       , mSessionId(state.nodeState.sessionId)
       , mEndpoint(state.endpoint)
       , mCallback(std::move(callback))
       , mClock(std::move(clock))
       , mTimer(io->makeTimer())
       , mMeasurementsStarted(0)
-      , mLog(channel(io->log(), "Measurement on gateway@" + address.to_string()))
+      , mConsecutiveTimeouts(0)
+      , mNumPingsInFlight(numPingsInFlight)
+      , mpStats(std::move(pStats))
+      , mLog(util::lazyChannel(io->log(),
+          [this] {
+            return "Measurement on gateway@" + mpResources->mAddress.to_string();
+          }))
+      , mTrace(io->trace())
       , mSuccess(false)
     {
-      const auto ht = HostTime{mClock.micros()};
-      sendPing(mEndpoint, discovery::makePayload(ht));
+      mData.clear();
+      mRoundTrips.clear();
+      trace(mTrace, util::TraceEvent::MeasurementStarted, util::traceEndpoint(mEndpoint));
+      sendInitialPings();
       resetTimer();
     }
 
+    // Pongs are identified by the host time of the ping they answer, which the
+    // ping responder echoes, so the pings don't need sequence numbers
+    void sendInitialPings()
+    {
+      for (std::size_t i = 0; i < mNumPingsInFlight; ++i)
+      {
+        const auto ht = HostTime{mClock.micros()};
+        sendPing(mEndpoint, discovery::makePayload(ht));
+      }
+    }
+
     void resetTimer()
     {
       mTimer.cancel();
-      mTimer.expires_from_now(std::chrono::milliseconds(50));
+      mTimer.expires_from_now(timeout());
       mTimer.async_wait([this](const typename Timer::ErrorCode e) {
         if (!e)
         {
           if (mMeasurementsStarted < kNumberMeasurements)
           {
-            const auto ht = HostTime{mClock.micros()};
-            sendPing(mEndpoint, discovery::makePayload(ht));
+            // All pings in flight are considered lost
+            sendInitialPings();
             ++mMeasurementsStarted;
+            ++mConsecutiveTimeouts;
             resetTimer();
           }
+          else if (mData.size() >= kMinPartialDataPoints)
+          {
+            LINK_DEBUG(mLog) << "Finishing measurement of " << mEndpoint << " with "
+                             << mData.size() << " data points";
+            finish();
+          }
           else
           {
             fail();
@@ -109,24 +272,44 @@ struct Measurement
       });
     }
 
+    std::chrono::milliseconds timeout() const
+    {
+      auto factor = std::size_t{1};
+      for (std::size_t i = 0; i < mConsecutiveTimeouts && factor < kMaxTimeoutFactor; ++i)
+      {
+        factor *= 2;
+      }
+      return std::chrono::milliseconds(
+        static_cast<std::chrono::milliseconds::rep>(kInitialTimeoutMillis * factor));
+    }
+
     void listen()
     {
-      mSocket.receive(util::makeAsyncSafe(this->shared_from_this()));
+      mpResources->mpUser = this->shared_from_this();
     }
 
-    // Operator to handle incoming messages on the interface
+    // Operator to handle incoming messages on the socket
     template <typename It>
     void operator()(
       const asio::ip::udp::endpoint& from, const It messageBegin, const It messageEnd)
     {
       using namespace std;
+      const discovery::ScopedPacketHandler packetHandler(*mpStats);
+      trace(mTrace, util::TraceEvent::PacketReceived, util::traceEndpoint(from),
+        static_cast<std::uint64_t>(std::distance(messageBegin, messageEnd)));
       const auto result = v1::parseMessageHeader(messageBegin, messageEnd);
       const auto& header = result.first;
       const auto payloadBegin = result.second;
 
+      if (mSuccess)
+      {
+        // Pongs for pings that were still in flight when the measurement finished
+        return;
+      }
+
       if (header.messageType == v1::kPong)
       {
-        debug(mLog) << "Received Pong message from " << from;
+        LINK_DEBUG(mLog) << "Received Pong message from " << from;
 
         // parse for all entries
         SessionId sessionId{};
@@ -134,48 +317,47 @@ struct Measurement
         std::chrono::microseconds prevGHostTime{0};
         std::chrono::microseconds prevHostTime{0};
 
-        try
-        {
-          discovery::parsePayload<SessionMembership, GHostTime, PrevGHostTime, HostTime>(
-            payloadBegin, messageEnd,
-            [&sessionId](const SessionMembership& sms) { sessionId = sms.sessionId; },
-            [&ghostTime](GHostTime gt) { ghostTime = std::move(gt.time); },
-            [&prevGHostTime](PrevGHostTime gt) { prevGHostTime = std::move(gt.time); },
-            [&prevHostTime](HostTime ht) { prevHostTime = std::move(ht.time); });
-        }
-        catch (const std::runtime_error& err)
+        if (!discovery::tryParsePayload<SessionMembership, GHostTime, PrevGHostTime,
+              HostTime>(payloadBegin, messageEnd,
+              [&sessionId](const SessionMembership& sms) { sessionId = sms.sessionId; },
+              [&ghostTime](GHostTime gt) { ghostTime = std::move(gt.time); },
+              [&prevGHostTime](PrevGHostTime gt) { prevGHostTime = std::move(gt.time); },
+              [&prevHostTime](HostTime ht) { prevHostTime = std::move(ht.time); }))
         {
-          warning(mLog) << "Failed parsing payload, caught exception: " << err.what();
-          listen();
+          discovery::GatewayStats::increment(mpStats->parseFailures);
+          LINK_WARNING(mLog) << "Failed parsing payload of pong from " << from;
           return;
         }
 
         if (mSessionId == sessionId)
         {
           const auto hostTime = mClock.micros();
+          // The pong arrived before the handler was invoked
+          const auto receiveTime = hostTime - mSocket.receiveDelay();
 
           const auto payload =
             discovery::makePayload(HostTime{hostTime}, PrevGHostTime{ghostTime});
 
           sendPing(from, payload);
-          listen();
-
+          mConsecutiveTimeouts = 0;
 
           if (ghostTime != Micros{0} && prevHostTime != Micros{0})
           {
-            mData.push_back(
+            mRoundTrips.push_back(
+              static_cast<double>((receiveTime - prevHostTime).count()));
+            insertSorted(mData,
               static_cast<double>(ghostTime.count())
-              - (static_cast<double>((hostTime + prevHostTime).count()) * 0.5));
+                - (static_cast<double>((receiveTime + prevHostTime).count()) * 0.5));
 
             if (prevGHostTime != Micros{0})
             {
-              mData.push_back(
+              insertSorted(mData,
                 (static_cast<double>((ghostTime + prevGHostTime).count()) * 0.5)
-                - static_cast<double>(prevHostTime.count()));
+                  - static_cast<double>(prevHostTime.count()));
             }
           }
 
-          if (mData.size() > kNumberDataPoints)
+          if (mData.size() > kNumberDataPoints || isMedianPrecise())
           {
             finish();
           }
@@ -184,15 +366,20 @@ struct Measurement
             resetTimer();
           }
         }
-        else
+        else if (from == mEndpoint)
         {
           fail();
         }
+        else
+        {
+          // A late pong for a previous measurement that used the socket
+          LINK_DEBUG(mLog) << "Ignoring pong of another session from " << from;
+        }
       }
       else
       {
-        debug(mLog) << "Received invalid message from " << from;
-        listen();
+        discovery::GatewayStats::increment(mpStats->parseFailures);
+        LINK_DEBUG(mLog) << "Received invalid message from " << from;
       }
     }
 
@@ -204,41 +391,65 @@ struct Measurement
       const auto msgEnd = v1::pingMessage(payload, msgBegin);
       const auto numBytes = static_cast<size_t>(std::distance(msgBegin, msgEnd));
 
-      try
+      asio::error_code ec;
+      mSocket.send(buffer.data(), numBytes, to, ec);
+      if (ec)
       {
-        mSocket.send(buffer.data(), numBytes, to);
+        LINK_INFO(mLog) << "Failed to send Ping to " << to.address().to_string() << ": "
+                        << ec.message();
+        return;
       }
-      catch (const std::runtime_error& err)
+      discovery::GatewayStats::increment(mpStats->packetsSent);
+      trace(mTrace, util::TraceEvent::PacketSent, util::traceEndpoint(to),
+        static_cast<std::uint64_t>(numBytes));
+    }
+
+    bool isMedianPrecise()
+    {
+      if (mData.size() < kMinNumberDataPoints)
       {
-        info(mLog) << "Failed to send Ping to " << to.address().to_string() << ": "
-                   << err.what();
+        return false;
       }
+      return sortedMedianConfidenceIntervalWidth(mData.begin(), mData.end())
+             < static_cast<double>(kMaxMedianConfidenceInterval);
     }
 
     void finish()
     {
       mTimer.cancel();
       mSuccess = true;
-      debug(mLog) << "Measuring " << mEndpoint << " done.";
+      LINK_DEBUG(mLog) << "Measuring " << mEndpoint << " done.";
+      trace(mTrace, util::TraceEvent::MeasurementFinished, util::traceEndpoint(mEndpoint),
+        1);
       mCallback(mData);
     }
 
     void fail()
     {
       mData.clear();
-      debug(mLog) << "Measuring " << mEndpoint << " failed.";
+      mRoundTrips.clear();
+      LINK_DEBUG(mLog) << "Measuring " << mEndpoint << " failed.";
+      trace(mTrace, util::TraceEvent::MeasurementFinished, util::traceEndpoint(mEndpoint),
+        0);
       mCallback(mData);
     }
 
-    Socket mSocket;
+    std::shared_ptr<Resources> mpResources;
+    Socket& mSocket;
+    // Kept sorted, so that the median is known after every pong
+    std::vector<double>& mData;
+    std::vector<double>& mRoundTrips;
     SessionId mSessionId;
     asio::ip::udp::endpoint mEndpoint;
-    std::vector<double> mData;
     Callback mCallback;
     Clock mClock;
     Timer mTimer;
     std::size_t mMeasurementsStarted;
+    std::size_t mConsecutiveTimeouts;
+    std::size_t mNumPingsInFlight;
+    std::shared_ptr<discovery::GatewayStats> mpStats;
     Log mLog;
+    Trace mTrace;
     bool mSuccess;
   };
 
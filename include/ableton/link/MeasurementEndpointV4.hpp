@@ -31,10 +31,16 @@ struct MeasurementEndpointV4
 {
   static const std::int32_t key = 'mep4';
   static_assert(key == 0x6d657034, "Unexpected byte order");
+  static const std::uint8_t compactKey = 4;
 
-  // Model the NetworkByteStreamSerializable concept
+  // Model the NetworkByteStreamSerializable concept. Endpoints of other address
+  // families take no bytes and are left out of payloads.
   friend std::uint32_t sizeInByteStream(const MeasurementEndpointV4 mep)
   {
+    if (!mep.ep.address().is_v4())
+    {
+      return 0;
+    }
     return discovery::sizeInByteStream(
              static_cast<std::uint32_t>(mep.ep.address().to_v4().to_ulong()))
            + discovery::sizeInByteStream(mep.ep.port());
@@ -43,23 +49,35 @@ struct MeasurementEndpointV4
   template <typename It>
   friend It toNetworkByteStream(const MeasurementEndpointV4 mep, It out)
   {
+    if (!mep.ep.address().is_v4())
+    {
+      return out;
+    }
     return discovery::toNetworkByteStream(mep.ep.port(),
       discovery::toNetworkByteStream(
         static_cast<std::uint32_t>(mep.ep.address().to_v4().to_ulong()), std::move(out)));
   }
 
+  template <typename It>
+  static bool tryFromNetworkByteStream(
+    It& begin, const It end, MeasurementEndpointV4& endpoint)
+  {
+    std::uint32_t addr = 0;
+    std::uint16_t port = 0;
+    if (!discovery::tryDeserialize(begin, end, addr)
+        || !discovery::tryDeserialize(begin, end, port))
+    {
+      return false;
+    }
+    endpoint.ep = {asio::ip::address_v4{addr}, port};
+    return true;
+  }
+
   template <typename It>
   static std::pair<MeasurementEndpointV4, It> fromNetworkByteStream(It begin, It end)
   {
-    using namespace std;
-    auto addrRes =
-      discovery::Deserialize<std::uint32_t>::fromNetworkByteStream(std::move(begin), end);
-    auto portRes = discovery::Deserialize<std::uint16_t>::fromNetworkByteStream(
-      std::move(addrRes.second), end);
-    return make_pair(
-      MeasurementEndpointV4{
-        {asio::ip::address_v4{std::move(addrRes.first)}, std::move(portRes.first)}},
-      std::move(portRes.second));
+    return discovery::fromNetworkByteStreamOrThrow<MeasurementEndpointV4>(
+      std::move(begin), std::move(end));
   }
 
   asio::ip::udp::endpoint ep;
@@ -0,0 +1,90 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#pragma once
+
+#include <ableton/discovery/NetworkByteStreamSerializable.hpp>
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+
+namespace ableton
+{
+namespace link
+{
+
+struct MeasurementEndpointV6
+{
+  static const std::int32_t key = 'mep6';
+  static_assert(key == 0x6d657036, "Unexpected byte order");
+  static const std::uint8_t compactKey = 5;
+
+  using AddressBytes = asio::ip::address_v6::bytes_type;
+
+  // Model the NetworkByteStreamSerializable concept. Endpoints of other address
+  // families take no bytes and are left out of payloads. The scope of link-local
+  // addresses is not encoded, it is that of the gateway the entry is received on.
+  friend std::uint32_t sizeInByteStream(const MeasurementEndpointV6 mep)
+  {
+    if (!mep.ep.address().is_v6())
+    {
+      return 0;
+    }
+    return discovery::sizeInByteStream(mep.ep.address().to_v6().to_bytes())
+           + discovery::sizeInByteStream(mep.ep.port());
+  }
+
+  template <typename It>
+  friend It toNetworkByteStream(const MeasurementEndpointV6 mep, It out)
+  {
+    if (!mep.ep.address().is_v6())
+    {
+      return out;
+    }
+    return discovery::toNetworkByteStream(mep.ep.port(),
+      discovery::toNetworkByteStream(
+        mep.ep.address().to_v6().to_bytes(), std::move(out)));
+  }
+
+  template <typename It>
+  static bool tryFromNetworkByteStream(
+    It& begin, const It end, MeasurementEndpointV6& endpoint)
+  {
+    AddressBytes addr{};
+    std::uint16_t port = 0;
+    if (!discovery::tryDeserialize(begin, end, addr)
+        || !discovery::tryDeserialize(begin, end, port))
+    {
+      return false;
+    }
+    endpoint.ep = {asio::ip::address_v6{addr}, port};
+    return true;
+  }
+
+  template <typename It>
+  static std::pair<MeasurementEndpointV6, It> fromNetworkByteStream(It begin, It end)
+  {
+    return discovery::fromNetworkByteStreamOrThrow<MeasurementEndpointV6>(
+      std::move(begin), std::move(end));
+  }
+
+  asio::ip::udp::endpoint ep;
+};
+
+} // namespace link
+} // namespace ableton
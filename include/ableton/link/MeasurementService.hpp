@@ -19,16 +19,25 @@
 
 #pragma once
 
+#include <ableton/discovery/IpInterface.hpp>
 #include <ableton/link/GhostXForm.hpp>
+#include <ableton/link/ClockDomain.hpp>
 #include <ableton/link/LinearRegression.hpp>
 #include <ableton/link/Measurement.hpp>
 #include <ableton/link/Median.hpp>
 #include <ableton/link/PeerState.hpp>
 #include <ableton/link/PingResponder.hpp>
 #include <ableton/link/SessionId.hpp>
+#include <ableton/link/SyncQuality.hpp>
 #include <ableton/link/v1/Messages.hpp>
-#include <map>
+#include <ableton/util/Exceptions.hpp>
+#include <ableton/util/Footprint.hpp>
+#include <ableton/util/Log.hpp>
+#include <ableton/util/SafeAsyncHandler.hpp>
+#include <algorithm>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
 namespace ableton
 {
@@ -40,20 +49,47 @@ class MeasurementService
 {
 public:
   using IoType = util::Injected<IoContext>;
+  using ResponderContext = typename IoType::type::ResponderContext;
   using MeasurementInstance = Measurement<Clock, IoContext>;
 
-  MeasurementService(asio::ip::address_v4 address,
+  // Number of outstanding pings of a measurement
+  static const std::size_t kNumPingsInFlight = 4;
+
+  // Default maximum number of measurements in progress. Unless they share the
+  // socket of the ping responder, each of them has its own socket, which is kept
+  // open for later measurements when it is done. With a static footprint, it's also
+  // the most measurements that can be in progress.
+  static const std::size_t kDefaultMaxMeasurements =
+    util::kStaticFootprint ? util::kMaxMeasurements : 16;
+
+  // Measurements can only send their pings through the socket of the ping
+  // responder if it runs on the same context
+  static constexpr bool kCanShareResponderSocket =
+    std::is_same<ResponderContext, typename IoType::type>::value;
+
+  // If shareResponderSocket is set and possible, all measurements send their pings
+  // through the socket of the ping responder, which passes the pongs on to the
+  // measurement of the peer they come from. Otherwise each measurement has a
+  // socket of its own. The ping responder is only opened once a peer is seen, see
+  // openPingResponder.
+  MeasurementService(asio::ip::address address,
     SessionId sessionId,
     GhostXForm ghostXForm,
     Clock clock,
-    IoType io)
+    IoType io,
+    std::shared_ptr<discovery::GatewayStats> pStats =
+      std::make_shared<discovery::GatewayStats>(),
+    const std::size_t maxMeasurements = kDefaultMaxMeasurements,
+    const bool shareResponderSocket = false)
     : mClock(std::move(clock))
+    , mClockDomainId(clockDomainId(mClock))
     , mIo(std::move(io))
-    , mPingResponder(std::move(address),
-        std::move(sessionId),
-        std::move(ghostXForm),
-        mClock,
-        util::injectRef(*mIo))
+    , mpStats(std::move(pStats))
+    , mMaxMeasurements((std::min)(maxMeasurements, mMeasurementMap.max_size()))
+    , mShareResponderSocket(kCanShareResponderSocket && shareResponderSocket)
+    , mAddress(std::move(address))
+    , mSessionId(std::move(sessionId))
+    , mGhostXForm(std::move(ghostXForm))
   {
   }
 
@@ -62,39 +98,191 @@ public:
 
   void updateNodeState(const SessionId& sessionId, const GhostXForm& xform)
   {
-    mPingResponder.updateNodeState(sessionId, xform);
+    mSessionId = sessionId;
+    mGhostXForm = xform;
+    if (mpPingResponder)
+    {
+      mpPingResponder->updateNodeState(sessionId, xform);
+    }
   }
 
+  // The endpoint of the ping responder. Its port is 0 until the responder has been
+  // opened.
   asio::ip::udp::endpoint endpoint() const
   {
-    return mPingResponder.endpoint();
+    return mpPingResponder ? mpPingResponder->endpoint()
+                           : asio::ip::udp::endpoint{mAddress, 0};
+  }
+
+  // Opens the ping responder if it isn't open yet. A gateway that never sees a peer
+  // doesn't need its socket. A failure is logged and the next call tries again.
+  void openPingResponder()
+  {
+    util::invokeCatching<std::runtime_error>([this] { makePingResponder(); },
+      [this](const std::runtime_error& err) {
+        LINK_INFO(mIo->log()) << "gateway@" + mAddress.to_string()
+                              << " Failed to open ping responder. Reason: "
+                              << err.what();
+      });
   }
 
-  // Measure the peer and invoke the handler with a GhostXForm
+  // Measure the peer and invoke the handler with a GhostXForm and the SyncQuality of
+  // the measurement, which are default constructed if it failed. If the maximum
+  // number of measurements is in progress, the measurement fails immediately. A
+  // peer in the same clock domain isn't measured, the handler is invoked on the
+  // next turn of the io context with the transform that the peer sent and a
+  // perfect quality. A peer that hasn't advertised the port of its ping responder
+  // yet can't be measured. This and other failures to start the measurement are
+  // reported on the next turn as well, once the caller has recorded the session
+  // that is being measured. Opens the ping responder if that failed before.
   template <typename Handler>
   void measurePeer(const PeerState& state, const Handler handler)
   {
     using namespace std;
 
+    if (state.clockDomain.isIdentified() && state.clockDomain.id == mClockDomainId)
+    {
+      const auto xform = state.clockDomain.xform;
+      const auto clock = mClock;
+      mIo->async([xform, clock, handler] {
+        const auto now = clock.micros();
+        auto quality = SyncQuality{};
+        quality.measurementTime = now;
+        handler(GhostXForm{1., xform.hostToGhost(now) - now}, quality);
+      });
+      return;
+    }
+
     const auto nodeId = state.nodeState.nodeId;
-    auto addr = mPingResponder.endpoint().address().to_v4();
+    const auto& addr = mAddress;
+    if (mMeasurementMap.size() >= mMaxMeasurements
+        && mMeasurementMap.find(nodeId) == mMeasurementMap.end())
+    {
+      LINK_INFO(mIo->log()) << "gateway@" + addr.to_string()
+                            << " Failed to measure. Reason: Too many measurements";
+      handler(GhostXForm{}, SyncQuality{});
+      return;
+    }
+
     auto callback = CompletionCallback<Handler>{*this, nodeId, handler};
+    auto peer = state;
+    peer.endpoint = discovery::inScopeOf(addr, state.endpoint);
+
+    const auto fail = [this, &addr, &handler](const char* const reason) {
+      LINK_INFO(mIo->log()) << "gateway@" + addr.to_string()
+                            << " Failed to measure. Reason: " << reason;
+      mIo->async([handler] { handler(GhostXForm{}, SyncQuality{}); });
+    };
 
-    try
+    util::invokeCatching<runtime_error>(
+      [&] {
+        makePingResponder();
+        if (state.endpoint.port() == 0)
+        {
+          fail("Peer has no endpoint");
+          return;
+        }
+
+        // A new measurement of the same peer takes over the socket of the old one
+        std::shared_ptr<Resources> pResources;
+        const auto it = mMeasurementMap.find(nodeId);
+        if (it != mMeasurementMap.end())
+        {
+          pResources = it->second->resources();
+          mMeasurementMap.erase(it);
+        }
+        else
+        {
+          pResources = acquireResources(addr);
+        }
+
+        auto pMeasurement =
+          std::unique_ptr<MeasurementInstance>(new MeasurementInstance{std::move(peer),
+            std::move(callback),
+            std::move(pResources),
+            mClock,
+            mIo,
+            kNumPingsInFlight,
+            mpStats});
+        mMeasurementMap.emplace(nodeId, std::move(pMeasurement));
+      },
+      [&fail](const runtime_error& err) { fail(err.what()); });
+  }
+
+private:
+  using Resources = typename MeasurementInstance::Resources;
+  using Responder = PingResponder<Clock, ResponderContext>;
+
+  // Throws std::runtime_error if the socket can't be opened
+  void makePingResponder()
+  {
+    if (mpPingResponder)
     {
-      mMeasurementMap[nodeId] =
-        std::unique_ptr<MeasurementInstance>(new MeasurementInstance{
-          state, std::move(callback), std::move(addr), mClock, mIo});
+      return;
     }
-    catch (const runtime_error& err)
+
+    mpPingResponder = std::unique_ptr<Responder>(new Responder{mAddress,
+      mSessionId,
+      mGhostXForm,
+      mClock,
+      util::injectRef(mIo->responderContext()),
+      mpStats});
+    if (mShareResponderSocket)
     {
-      info(mIo->log()) << "gateway@" + addr.to_string()
-                       << " Failed to measure. Reason: " << err.what();
-      handler(GhostXForm{});
+      mpPongReceiver = std::make_shared<PongReceiver>(PongReceiver{this});
+      mpPingResponder->setPongHandler(util::makeAsyncSafe(mpPongReceiver));
     }
   }
 
-private:
+  // Reuses the resources of a finished measurement if there are any. Throws
+  // std::runtime_error if a new socket can't be opened.
+  std::shared_ptr<Resources> acquireResources(const asio::ip::address& addr)
+  {
+    if (mFreeResources.empty())
+    {
+      return makeResources(
+        addr, std::integral_constant<bool, kCanShareResponderSocket>{});
+    }
+    auto pResources = std::move(mFreeResources.back());
+    mFreeResources.pop_back();
+    return pResources;
+  }
+
+  std::shared_ptr<Resources> makeResources(
+    const asio::ip::address& addr, std::true_type)
+  {
+    return mShareResponderSocket
+             ? MeasurementInstance::makeResources(mpPingResponder->sharedSocket(), addr)
+             : MeasurementInstance::makeResources(mIo, addr);
+  }
+
+  std::shared_ptr<Resources> makeResources(
+    const asio::ip::address& addr, std::false_type)
+  {
+    return MeasurementInstance::makeResources(mIo, addr);
+  }
+
+  // Passes the pongs received by the ping responder to the measurement of the peer
+  // that sent them
+  struct PongReceiver
+  {
+    void operator()(
+      const asio::ip::udp::endpoint& from, const uint8_t* begin, const uint8_t* end)
+    {
+      for (const auto& entry : mpService->mMeasurementMap)
+      {
+        if (entry.second->endpoint() == from)
+        {
+          const auto pResources = entry.second->resources();
+          pResources->receive(from, begin, end);
+          return;
+        }
+      }
+    }
+
+    MeasurementService* mpService;
+  };
+
   template <typename Handler>
   struct CompletionCallback
   {
@@ -113,15 +301,18 @@ private:
       const auto it = measurementMap.find(nodeId);
       if (it != measurementMap.end())
       {
-        if (data.empty())
-        {
-          handler(GhostXForm{});
-        }
-        else
-        {
-          handler(GhostXForm{1, microseconds(llround(median(data.begin(), data.end())))});
-        }
+        const auto xform = data.empty() ? GhostXForm{}
+                                        : GhostXForm{1,
+                                          microseconds(llround(
+                                            sortedMedian(data.begin(), data.end())))};
+        const auto quality =
+          data.empty() ? SyncQuality{}
+                       : syncQuality(data, it->second->resources()->mRoundTrips,
+                         mMeasurementService.mClock.micros());
+        // The data belongs to the socket, which may be reused by the handler
+        mMeasurementService.mFreeResources.push_back(it->second->resources());
         measurementMap.erase(it);
+        handler(xform, quality);
       }
     }
 
@@ -133,11 +324,25 @@ private:
   // Make sure the measurement map outlives the IoContext so that the rest of
   // the members are guaranteed to be valid when any final handlers
   // are begin run.
-  using MeasurementMap = std::map<NodeId, std::unique_ptr<MeasurementInstance>>;
+  using MeasurementMap = util::FootprintFlatMap<NodeId,
+    std::unique_ptr<MeasurementInstance>,
+    kDefaultMaxMeasurements>;
   MeasurementMap mMeasurementMap;
+  // Each measurement in progress has its resources, so there are never more of
+  // them than measurements
+  util::FootprintVector<std::shared_ptr<Resources>, kDefaultMaxMeasurements>
+    mFreeResources;
   Clock mClock;
+  ClockDomainId mClockDomainId;
   IoType mIo;
-  PingResponder<Clock, IoContext> mPingResponder;
+  std::shared_ptr<discovery::GatewayStats> mpStats;
+  std::size_t mMaxMeasurements;
+  bool mShareResponderSocket;
+  asio::ip::address mAddress;
+  SessionId mSessionId;
+  GhostXForm mGhostXForm;
+  std::shared_ptr<PongReceiver> mpPongReceiver;
+  std::unique_ptr<Responder> mpPingResponder;
 };
 
 } // namespace link
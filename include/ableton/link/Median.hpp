@@ -21,6 +21,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <vector>
 
 namespace ableton
@@ -46,5 +47,47 @@ double median(It begin, It end)
   }
 };
 
+// The median of sorted data, which is taken in constant time
+template <typename It>
+double sortedMedian(It begin, It end)
+{
+  const auto n = std::distance(begin, end);
+  assert(n > 2);
+  return (*(begin + (n / 2)) + *(begin + (n - 1) / 2)) / 2.0;
+}
+
+// Inserts the value into the sorted data so that it stays sorted. This keeps the
+// median and its confidence interval available after each new value without
+// sorting all of the data again.
+inline void insertSorted(std::vector<double>& data, const double value)
+{
+  data.insert(std::upper_bound(data.begin(), data.end(), value), value);
+}
+
+// Width of the approximate 95% confidence interval of the median of sorted data.
+// The interval is bounded by the order statistics around the median, so no
+// assumption about the distribution of the data is made.
+template <typename It>
+double sortedMedianConfidenceIntervalWidth(It begin, It end)
+{
+  const auto n = std::distance(begin, end);
+  assert(n > 2);
+  const auto halfWidth = 0.98 * std::sqrt(static_cast<double>(n));
+  const auto lower =
+    std::max(static_cast<double>(0), std::floor(static_cast<double>(n) / 2 - halfWidth));
+  const auto upper = std::min(
+    static_cast<double>(n - 1), std::ceil(static_cast<double>(n) / 2 + halfWidth));
+  return *(begin + static_cast<std::ptrdiff_t>(upper))
+         - *(begin + static_cast<std::ptrdiff_t>(lower));
+}
+
+// Same as sortedMedianConfidenceIntervalWidth for unsorted data. Reorders the data.
+template <typename It>
+double medianConfidenceIntervalWidth(It begin, It end)
+{
+  std::sort(begin, end);
+  return sortedMedianConfidenceIntervalWidth(begin, end);
+}
+
 } // namespace link
 } // namespace ableton
@@ -0,0 +1,115 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/link/Optional.hpp>
+#include <ableton/link/TripleBuffer.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <utility>
+
+namespace ableton
+{
+namespace link
+{
+
+// Lock free buffer for any number of writer threads and a single reader thread that
+// passes on the value with the latest timestamp. A write claims the first of the
+// NumSlots slots that no other writer is using and passes its value on through the
+// TripleBuffer of that slot, so writers never wait for each other or for the reader.
+// As long as no more than NumSlots threads write at the same time, a slot is always
+// available. Values that are older than the latest one written to their slot or
+// read before are dropped, so a writer that is preempted between taking its
+// timestamp and writing doesn't replace a later value.
+template <typename T, std::size_t NumSlots>
+class MultiWriterBuffer
+{
+public:
+  MultiWriterBuffer()
+    : mLatestRead(std::chrono::microseconds::min())
+  {
+  }
+
+  MultiWriterBuffer(const MultiWriterBuffer&) = delete;
+  MultiWriterBuffer& operator=(const MultiWriterBuffer&) = delete;
+
+  // Returns false if all slots are in use by other writers
+  bool write(const std::chrono::microseconds timestamp, const T& value)
+  {
+    for (auto& slot : mSlots)
+    {
+      if (!slot.isWriting.exchange(true, std::memory_order_acquire))
+      {
+        if (timestamp >= slot.latestWritten)
+        {
+          slot.latestWritten = timestamp;
+          slot.buffer.write(std::make_pair(timestamp, value));
+        }
+        slot.isWriting.store(false, std::memory_order_release);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The value with the latest timestamp of those written since the last call, if
+  // it's later than the one returned before. Must not be called from multiple
+  // threads concurrently.
+  Optional<T> readNew()
+  {
+    auto latest = Optional<T>{};
+    for (auto& slot : mSlots)
+    {
+      if (const auto entry = slot.buffer.readNew())
+      {
+        if ((*entry).first > mLatestRead)
+        {
+          mLatestRead = (*entry).first;
+          latest = Optional<T>{(*entry).second};
+        }
+      }
+    }
+    return latest;
+  }
+
+private:
+  struct Slot
+  {
+    Slot()
+      : isWriting(false)
+      , latestWritten(std::chrono::microseconds::min())
+    {
+    }
+
+    std::atomic<bool> isWriting;
+    // Only accessed by the writer that holds the slot
+    std::chrono::microseconds latestWritten;
+    TripleBuffer<std::pair<std::chrono::microseconds, T>> buffer;
+  };
+
+  std::array<Slot, NumSlots> mSlots;
+  std::chrono::microseconds mLatestRead; // Reader only
+};
+
+} // namespace link
+} // namespace ableton
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <array>
 #include <cstdint>
+#include <functional>
 #include <string>
 
 namespace ableton
@@ -53,6 +54,47 @@ struct NodeId : NodeIdArray
     return nodeId;
   }
 
+  // The bytes of the id as one big-endian integer, which orders ids like their
+  // bytes. Compilers turn this into a single load and byte swap.
+  std::uint64_t value() const
+  {
+    const NodeIdArray& bytes = *this;
+    return (std::uint64_t{bytes[0]} << 56) | (std::uint64_t{bytes[1]} << 48)
+           | (std::uint64_t{bytes[2]} << 40) | (std::uint64_t{bytes[3]} << 32)
+           | (std::uint64_t{bytes[4]} << 24) | (std::uint64_t{bytes[5]} << 16)
+           | (std::uint64_t{bytes[6]} << 8) | std::uint64_t{bytes[7]};
+  }
+
+  friend bool operator==(const NodeId& lhs, const NodeId& rhs)
+  {
+    return lhs.value() == rhs.value();
+  }
+
+  friend bool operator!=(const NodeId& lhs, const NodeId& rhs)
+  {
+    return lhs.value() != rhs.value();
+  }
+
+  friend bool operator<(const NodeId& lhs, const NodeId& rhs)
+  {
+    return lhs.value() < rhs.value();
+  }
+
+  friend bool operator>(const NodeId& lhs, const NodeId& rhs)
+  {
+    return lhs.value() > rhs.value();
+  }
+
+  friend bool operator<=(const NodeId& lhs, const NodeId& rhs)
+  {
+    return lhs.value() <= rhs.value();
+  }
+
+  friend bool operator>=(const NodeId& lhs, const NodeId& rhs)
+  {
+    return lhs.value() >= rhs.value();
+  }
+
   friend std::ostream& operator<<(std::ostream& stream, const NodeId& id)
   {
     return stream << std::string{id.cbegin(), id.cend()};
@@ -64,15 +106,39 @@ struct NodeId : NodeIdArray
     return discovery::toNetworkByteStream(nodeId, std::move(out));
   }
 
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, NodeId& nodeId)
+  {
+    return discovery::tryDeserialize(begin, end, static_cast<NodeIdArray&>(nodeId));
+  }
+
   template <typename It>
   static std::pair<NodeId, It> fromNetworkByteStream(It begin, It end)
   {
-    using namespace std;
-    auto result = discovery::Deserialize<NodeIdArray>::fromNetworkByteStream(
+    return discovery::fromNetworkByteStreamOrThrow<NodeId>(
       std::move(begin), std::move(end));
-    return make_pair(NodeId(std::move(result.first)), std::move(result.second));
+  }
+};
+
+// Hash function for using NodeIds as keys of unordered containers. NodeIds are
+// random, so their bytes can be used directly.
+struct NodeIdHash
+{
+  std::size_t operator()(const NodeId& nodeId) const
+  {
+    return std::hash<std::uint64_t>{}(nodeId.value());
   }
 };
 
 } // namespace link
 } // namespace ableton
+
+namespace std
+{
+
+template <>
+struct hash<ableton::link::NodeId> : ableton::link::NodeIdHash
+{
+};
+
+} // namespace std
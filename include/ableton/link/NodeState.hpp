@@ -21,19 +21,65 @@
 
 #include <ableton/discovery/Payload.hpp>
 #include <ableton/link/NodeId.hpp>
+#include <ableton/link/PendingTimeline.hpp>
 #include <ableton/link/SessionId.hpp>
 #include <ableton/link/StartStopState.hpp>
+#include <ableton/link/SyncStratum.hpp>
+#include <ableton/link/TempoRamp.hpp>
 #include <ableton/link/Timeline.hpp>
+#include <ableton/util/Exceptions.hpp>
 
 namespace ableton
 {
 namespace link
 {
 
+// A tempo ramp along with the session timeline that it leads to. Peers of older
+// versions skip the entry and follow the tangent of the ramp that the timeline entry
+// carries while ramping instead. Like the ramp, the entry takes no bytes without
+// one.
+struct TempoRampEntry
+{
+  static const std::int32_t key = 'tmrp';
+  static_assert(key == 0x746d7270, "Unexpected byte order");
+  static const std::uint8_t compactKey = 8;
+
+  // Model the NetworkByteStreamSerializable concept
+  friend std::uint32_t sizeInByteStream(const TempoRampEntry& entry)
+  {
+    if (!entry.ramp.isRamping())
+    {
+      return 0;
+    }
+    return sizeInByteStream(entry.ramp) + sizeInByteStream(entry.timeline);
+  }
+
+  template <typename It>
+  friend It toNetworkByteStream(const TempoRampEntry& entry, It out)
+  {
+    if (!entry.ramp.isRamping())
+    {
+      return out;
+    }
+    return toNetworkByteStream(
+      entry.timeline, toNetworkByteStream(entry.ramp, std::move(out)));
+  }
+
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, TempoRampEntry& entry)
+  {
+    return TempoRamp::tryFromNetworkByteStream(begin, end, entry.ramp)
+           && Timeline::tryFromNetworkByteStream(begin, end, entry.timeline);
+  }
+
+  TempoRamp ramp;
+  Timeline timeline;
+};
+
 struct NodeState
 {
-  using Payload =
-    decltype(discovery::makePayload(Timeline{}, SessionMembership{}, StartStopState{}));
+  using Payload = decltype(discovery::makePayload(Timeline{}, SessionMembership{},
+    StartStopState{}, PendingTimeline{}, TempoRampEntry{}, SyncStratum{}));
 
   NodeId ident() const
   {
@@ -42,28 +88,68 @@ struct NodeState
 
   friend bool operator==(const NodeState& lhs, const NodeState& rhs)
   {
-    return std::tie(lhs.nodeId, lhs.sessionId, lhs.timeline, lhs.startStopState)
-           == std::tie(rhs.nodeId, rhs.sessionId, rhs.timeline, rhs.startStopState);
+    return std::tie(lhs.nodeId, lhs.sessionId, lhs.timeline, lhs.startStopState,
+             lhs.pendingTimeline, lhs.tempoRamp, lhs.stratum, lhs.rampTangent)
+           == std::tie(rhs.nodeId, rhs.sessionId, rhs.timeline, rhs.startStopState,
+             rhs.pendingTimeline, rhs.tempoRamp, rhs.stratum, rhs.rampTangent);
   }
 
   friend Payload toPayload(const NodeState& state)
   {
-    return discovery::makePayload(
-      state.timeline, SessionMembership{state.sessionId}, state.startStopState);
+    const auto isRamping = state.tempoRamp.isRamping();
+    return discovery::makePayload(isRamping ? state.rampTangent : state.timeline,
+      SessionMembership{state.sessionId}, state.startStopState, state.pendingTimeline,
+      TempoRampEntry{state.tempoRamp, state.timeline}, SyncStratum{state.stratum});
+  }
+
+  // Returns false if the payload is malformed
+  template <typename It>
+  static bool tryFromPayload(NodeId nodeId, It begin, It end, NodeState& nodeState)
+  {
+    nodeState =
+      NodeState{std::move(nodeId), {}, {}, {}, {}, {}, SyncStratum::kUnknown, {}};
+    auto timeline = Timeline{};
+    auto rampEntry = TempoRampEntry{};
+    if (!discovery::tryParsePayload<Timeline, SessionMembership, StartStopState,
+          PendingTimeline, TempoRampEntry, SyncStratum>(
+          std::move(begin), std::move(end),
+          [&timeline](Timeline tl) { timeline = std::move(tl); },
+          [&nodeState](SessionMembership membership) {
+            nodeState.sessionId = std::move(membership.sessionId);
+          },
+          [&nodeState](
+            StartStopState ststst) { nodeState.startStopState = std::move(ststst); },
+          [&nodeState](PendingTimeline pending) {
+            nodeState.pendingTimeline = std::move(pending);
+          },
+          [&rampEntry](TempoRampEntry entry) { rampEntry = std::move(entry); },
+          [&nodeState](SyncStratum entry) { nodeState.stratum = entry.stratum; }))
+    {
+      return false;
+    }
+
+    if (rampEntry.ramp.isRamping())
+    {
+      nodeState.timeline = rampEntry.timeline;
+      nodeState.tempoRamp = rampEntry.ramp;
+      nodeState.rampTangent = timeline;
+    }
+    else
+    {
+      nodeState.timeline = timeline;
+    }
+    return true;
   }
 
+  // Throws std::range_error if the payload is malformed
   template <typename It>
   static NodeState fromPayload(NodeId nodeId, It begin, It end)
   {
-    using namespace std;
-    auto nodeState = NodeState{std::move(nodeId), {}, {}, {}};
-    discovery::parsePayload<Timeline, SessionMembership, StartStopState>(std::move(begin),
-      std::move(end), [&nodeState](Timeline tl) { nodeState.timeline = std::move(tl); },
-      [&nodeState](SessionMembership membership) {
-        nodeState.sessionId = std::move(membership.sessionId);
-      },
-      [&nodeState](
-        StartStopState ststst) { nodeState.startStopState = std::move(ststst); });
+    auto nodeState = NodeState{};
+    if (!tryFromPayload(std::move(nodeId), std::move(begin), std::move(end), nodeState))
+    {
+      LINK_THROW(std::range_error("Parsing node state failed"));
+    }
     return nodeState;
   }
 
@@ -71,6 +157,14 @@ struct NodeState
   SessionId sessionId;
   Timeline timeline;
   StartStopState startStopState;
+  PendingTimeline pendingTimeline;
+  // The ramp that leads to the timeline, if any
+  TempoRamp tempoRamp;
+  // See SyncStratum, 0 for the founder of the session
+  std::uint8_t stratum;
+  // The timeline along the ramp at the time of the latest broadcast, which the
+  // timeline entry carries for peers of older versions while ramping
+  Timeline rampTangent;
 };
 
 } // namespace link
@@ -52,13 +52,17 @@ struct HostTime
     return discovery::toNetworkByteStream(std::move(sht.time), std::move(out));
   }
 
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, HostTime& value)
+  {
+    return discovery::tryDeserialize(begin, end, value.time);
+  }
+
   template <typename It>
   static std::pair<HostTime, It> fromNetworkByteStream(It begin, It end)
   {
-    using namespace std;
-    auto result = discovery::Deserialize<chrono::microseconds>::fromNetworkByteStream(
+    return discovery::fromNetworkByteStreamOrThrow<HostTime>(
       std::move(begin), std::move(end));
-    return make_pair(HostTime{std::move(result.first)}, std::move(result.second));
   }
 
   std::chrono::microseconds time;
@@ -88,13 +92,17 @@ struct GHostTime
     return discovery::toNetworkByteStream(std::move(dgt.time), std::move(out));
   }
 
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, GHostTime& value)
+  {
+    return discovery::tryDeserialize(begin, end, value.time);
+  }
+
   template <typename It>
   static std::pair<GHostTime, It> fromNetworkByteStream(It begin, It end)
   {
-    using namespace std;
-    auto result = discovery::Deserialize<chrono::microseconds>::fromNetworkByteStream(
+    return discovery::fromNetworkByteStreamOrThrow<GHostTime>(
       std::move(begin), std::move(end));
-    return make_pair(GHostTime{std::move(result.first)}, std::move(result.second));
   }
 
   std::chrono::microseconds time;
@@ -124,13 +132,17 @@ struct PrevGHostTime
     return discovery::toNetworkByteStream(std::move(pdgt.time), std::move(out));
   }
 
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, PrevGHostTime& value)
+  {
+    return discovery::tryDeserialize(begin, end, value.time);
+  }
+
   template <typename It>
   static std::pair<PrevGHostTime, It> fromNetworkByteStream(It begin, It end)
   {
-    using namespace std;
-    auto result = discovery::Deserialize<chrono::microseconds>::fromNetworkByteStream(
+    return discovery::fromNetworkByteStreamOrThrow<PrevGHostTime>(
       std::move(begin), std::move(end));
-    return make_pair(PrevGHostTime{std::move(result.first)}, std::move(result.second));
   }
 
   std::chrono::microseconds time;
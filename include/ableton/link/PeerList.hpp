@@ -0,0 +1,62 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/link/GhostXForm.hpp>
+#include <ableton/link/NodeId.hpp>
+#include <ableton/link/SessionId.hpp>
+#include <ableton/link/Timeline.hpp>
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace ableton
+{
+namespace link
+{
+
+// What a node knows about a peer on one of its gateways
+struct PeerInfo
+{
+  NodeId nodeId;
+  SessionId sessionId;
+  Timeline timeline;
+  // The address of the interface that the peer is visible on
+  asio::ip::address interfaceAddr;
+  // The endpoint of the peer's measurement server
+  asio::ip::udp::endpoint endpoint;
+  // The peers that the peer is the hub of, see PeerState::numLeaves
+  std::uint32_t numLeaves;
+  // The transformation from host time to the ghost time of the peer's session, as
+  // last measured by the node. It's the node's own one if the peer is in its
+  // session and empty if the session hasn't been measured yet.
+  GhostXForm xform;
+  // The host time at which the node last received the state of the peer on any
+  // interface
+  std::chrono::microseconds lastSeen;
+};
+
+// The entries of all peers of a node on all gateways, ordered by node id and interface
+// address. A peer that is visible on several interfaces has an entry for each.
+using PeerList = std::vector<PeerInfo>;
+
+} // namespace link
+} // namespace ableton
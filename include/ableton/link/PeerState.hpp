@@ -19,9 +19,13 @@
 
 #pragma once
 
+#include <ableton/discovery/LeafCount.hpp>
 #include <ableton/discovery/Payload.hpp>
+#include <ableton/link/ClockDomain.hpp>
 #include <ableton/link/MeasurementEndpointV4.hpp>
+#include <ableton/link/MeasurementEndpointV6.hpp>
 #include <ableton/link/NodeState.hpp>
+#include <ableton/util/Exceptions.hpp>
 
 namespace ableton
 {
@@ -30,7 +34,9 @@ namespace link
 
 // A state type for peers. PeerState stores the normal NodeState plus
 // additional information (the remote endpoint at which to find its
-// ping/pong measurement server).
+// ping/pong measurement server). The endpoint is encoded by the entry of its
+// address family, the entry of the other family is left out. Peers whose host
+// clock can be identified also send it together with their ghost transform.
 
 struct PeerState
 {
@@ -56,34 +62,68 @@ struct PeerState
     return nodeState.startStopState;
   }
 
+  PendingTimeline pendingTimeline() const
+  {
+    return nodeState.pendingTimeline;
+  }
+
+  TempoRamp tempoRamp() const
+  {
+    return nodeState.tempoRamp;
+  }
+
   friend bool operator==(const PeerState& lhs, const PeerState& rhs)
   {
-    return lhs.nodeState == rhs.nodeState && lhs.endpoint == rhs.endpoint;
+    return lhs.nodeState == rhs.nodeState && lhs.endpoint == rhs.endpoint
+           && lhs.clockDomain == rhs.clockDomain && lhs.numLeaves == rhs.numLeaves;
   }
 
   friend auto toPayload(const PeerState& state)
     -> decltype(std::declval<NodeState::Payload>()
-                + discovery::makePayload(MeasurementEndpointV4{{}}))
+                + discovery::makePayload(
+                  MeasurementEndpointV4{{}}, MeasurementEndpointV6{{}}, ClockDomain{}))
   {
     return toPayload(state.nodeState)
-           + discovery::makePayload(MeasurementEndpointV4{state.endpoint});
+           + discovery::makePayload(MeasurementEndpointV4{state.endpoint},
+             MeasurementEndpointV6{state.endpoint}, state.clockDomain);
   }
 
+  // Returns false if the payload is malformed
   template <typename It>
-  static PeerState fromPayload(NodeId id, It begin, It end)
+  static bool tryFromPayload(NodeId id, It begin, It end, PeerState& peerState)
   {
-    using namespace std;
-    auto peerState = PeerState{NodeState::fromPayload(std::move(id), begin, end), {}};
+    peerState = PeerState{};
+    if (!NodeState::tryFromPayload(std::move(id), begin, end, peerState.nodeState))
+    {
+      return false;
+    }
+    return discovery::tryParsePayload<MeasurementEndpointV4, MeasurementEndpointV6,
+      ClockDomain, discovery::LeafCount>(std::move(begin), std::move(end),
+      [&peerState](MeasurementEndpointV4 me4) { peerState.endpoint = std::move(me4.ep); },
+      [&peerState](MeasurementEndpointV6 me6) { peerState.endpoint = std::move(me6.ep); },
+      [&peerState](ClockDomain clock) { peerState.clockDomain = std::move(clock); },
+      [&peerState](discovery::LeafCount leaves) { peerState.numLeaves = leaves.count; });
+  }
 
-    discovery::parsePayload<MeasurementEndpointV4>(
-      std::move(begin), std::move(end), [&peerState](MeasurementEndpointV4 me4) {
-        peerState.endpoint = std::move(me4.ep);
-      });
+  // Throws std::range_error if the payload is malformed
+  template <typename It>
+  static PeerState fromPayload(NodeId id, It begin, It end)
+  {
+    auto peerState = PeerState{};
+    if (!tryFromPayload(std::move(id), std::move(begin), std::move(end), peerState))
+    {
+      LINK_THROW(std::range_error("Parsing peer state failed"));
+    }
     return peerState;
   }
 
   NodeState nodeState;
   asio::ip::udp::endpoint endpoint;
+  ClockDomain clockDomain;
+  // The peers that are only known through this one, as it's their hub in
+  // hierarchical discovery, see discovery::BroadcastPolicy::maxHubs. Hubs append
+  // the count to their messages, so it's not part of toPayload.
+  std::uint32_t numLeaves;
 };
 
 } // namespace link
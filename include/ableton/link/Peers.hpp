@@ -20,8 +20,10 @@
 #pragma once
 
 #include <ableton/link/PeerState.hpp>
+#include <ableton/util/Footprint.hpp>
 #include <ableton/util/Injected.hpp>
 #include <cassert>
+#include <unordered_map>
 
 namespace ableton
 {
@@ -31,8 +33,11 @@ namespace link
 // SessionMembershipCallback is invoked when any change to session
 // membership occurs (when any peer joins or leaves a session)
 //
-// SessionTimelineCallback is invoked with a session id and a timeline
-// whenever a new combination of these values is seen
+// SessionTimelineCallback is invoked with a session id, a timeline and the
+// tempo ramp that leads to it whenever a new combination of the session id and
+// the timeline is seen. It's also invoked
+// with a session id and a pending timeline whenever a new combination of
+// those is seen, after the timeline of the same peer state.
 //
 // SessionStartStopStateCallback is invoked with a session id and a startStopState
 // whenever a new combination of these values is seen
@@ -49,6 +54,13 @@ class Peers
 public:
   using Peer = std::pair<PeerState, asio::ip::address>;
 
+  // With a static footprint, the entries of all peers on all gateways and the
+  // sessions of the current and the other sessions that are remembered, along with
+  // the one of a new peer before the other sessions make room for it. Peers that
+  // don't fit are dropped.
+  static const std::size_t kMaxPeerEntries = util::kMaxPeers * util::kMaxGateways;
+  static const std::size_t kMaxIndexedSessions = util::kMaxSessions + 2;
+
   Peers(util::Injected<IoContext> io,
     SessionMembershipCallback membership,
     SessionTimelineCallback timeline,
@@ -65,19 +77,183 @@ public:
   {
     using namespace std;
     vector<Peer> result;
-    auto& peerVec = mpImpl->mPeers;
-    copy_if(begin(peerVec), end(peerVec), back_inserter(result), SessionMemberPred{sid});
+    const auto pSession = mpImpl->findSession(sid);
+    if (pSession)
+    {
+      result.reserve(pSession->numEntries);
+      auto& peerVec = mpImpl->mPeers;
+      copy_if(
+        begin(peerVec), end(peerVec), back_inserter(result), SessionMemberPred{sid});
+    }
     return result;
   }
 
-  // Number of individual for a given session.
+  // Copies at most maxNumPeers distinct peers of the given session to out without
+  // allocating. Each peer is copied with the first gateway it's visible on in the
+  // session. The founding peer of the session comes first if it's a member. Returns
+  // the end of the copied range.
+  template <typename OutputIt>
+  OutputIt uniqueSessionPeers(
+    const SessionId& sid, const std::size_t maxNumPeers, OutputIt out) const
+  {
+    using namespace std;
+    if (maxNumPeers == 0 || !mpImpl->findSession(sid))
+    {
+      return out;
+    }
+
+    const auto& peerVec = mpImpl->mPeers;
+    const auto isMember = SessionMemberPred{sid};
+    // The founding peer's id is the session id
+    const auto founderEnd = upper_bound(begin(peerVec), end(peerVec), sid, IdLess{});
+    const auto founderIt = find_if(
+      lower_bound(begin(peerVec), end(peerVec), sid, IdLess{}), founderEnd, isMember);
+    auto numPeers = size_t{0};
+    if (founderIt != founderEnd)
+    {
+      *out++ = *founderIt;
+      ++numPeers;
+    }
+
+    auto it = begin(peerVec);
+    while (numPeers < maxNumPeers && it != end(peerVec))
+    {
+      const auto& id = it->first.ident();
+      const auto idEnd = upper_bound(it, end(peerVec), id, IdLess{});
+      if (id != sid)
+      {
+        const auto memberIt = find_if(it, idEnd, isMember);
+        if (memberIt != idEnd)
+        {
+          *out++ = *memberIt;
+          ++numPeers;
+        }
+      }
+      it = idEnd;
+    }
+    return out;
+  }
+
+  // Strata below this are equally good for measuring, see SyncStratum. Choosing
+  // among them by the seed spreads the measurements of a session over its peers,
+  // instead of all peers measuring the founder.
+  static const std::uint8_t kMaxPreferredStratum = 3;
+
+  // Copies at most maxNumPeers distinct peers of the given session to the random
+  // access iterator out without allocating, ranked for measuring them. Peers of a
+  // stratum below kMaxPreferredStratum come first, in an order that depends on the
+  // seed, the others by their strata. Each peer is copied with the first gateway
+  // it's visible on in the session. Returns the end of the copied range.
+  template <typename RandomIt>
+  RandomIt sessionPeersToMeasure(const SessionId& sid,
+    const std::size_t maxNumPeers,
+    const std::size_t seed,
+    const RandomIt out) const
+  {
+    using namespace std;
+    if (maxNumPeers == 0 || !mpImpl->findSession(sid))
+    {
+      return out;
+    }
+
+    const auto rank = [&sid, seed](const Peer& peer) {
+      const auto& id = peer.first.ident();
+      // The founder defines the session, whether it advertises its stratum or not
+      const auto stratum = id == sid ? 0 : peer.first.nodeState.stratum;
+      // The finalizer of splitmix64, so that every bit of the seed matters
+      auto hash = id.value() ^ (static_cast<uint64_t>(seed) * 0x9e3779b97f4a7c15u);
+      hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9u;
+      hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebu;
+      hash ^= hash >> 31;
+      return stratum < kMaxPreferredStratum ? make_pair(0, hash)
+                                            : make_pair(int{stratum}, hash);
+    };
+
+    const auto& peerVec = mpImpl->mPeers;
+    const auto isMember = SessionMemberPred{sid};
+    auto numPeers = size_t{0};
+    auto it = begin(peerVec);
+    while (it != end(peerVec))
+    {
+      const auto& id = it->first.ident();
+      const auto idEnd = upper_bound(it, end(peerVec), id, IdLess{});
+      const auto memberIt = find_if(it, idEnd, isMember);
+      if (memberIt != idEnd)
+      {
+        // Insert into the sorted range, dropping the last one if it's full
+        const auto peerRank = rank(*memberIt);
+        auto pos = out + static_cast<ptrdiff_t>(numPeers);
+        while (pos != out && peerRank < rank(*(pos - 1)))
+        {
+          --pos;
+        }
+        if (pos != out + static_cast<ptrdiff_t>(maxNumPeers))
+        {
+          numPeers = (min)(numPeers + 1, maxNumPeers);
+          move_backward(pos, out + static_cast<ptrdiff_t>(numPeers - 1),
+            out + static_cast<ptrdiff_t>(numPeers));
+          *pos = *memberIt;
+        }
+      }
+      it = idEnd;
+    }
+    return out + static_cast<ptrdiff_t>(numPeers);
+  }
+
+  // Invokes fn with the entries of all peers, one per gateway that a peer is visible
+  // on, ordered by (peerId, addr)
+  template <typename Fn>
+  void forEachPeer(Fn fn) const
+  {
+    for (const auto& peer : mpImpl->mPeers)
+    {
+      fn(peer);
+    }
+  }
+
+  // Number of individual peers of a given session, including the leaves of hubs,
+  // see PeerState::numLeaves. A hub that is visible on several gateways is counted
+  // with its largest number of leaves.
   std::size_t uniqueSessionPeerCount(const SessionId& sid) const
   {
     using namespace std;
-    auto peerVec = sessionPeers(sid);
-    auto last = unique(begin(peerVec), end(peerVec),
-      [](const Peer& a, const Peer& b) { return a.first.ident() == b.first.ident(); });
-    return static_cast<size_t>(distance(begin(peerVec), last));
+    const auto pSession = mpImpl->findSession(sid);
+    if (!pSession)
+    {
+      return 0;
+    }
+
+    auto count = pSession->peerEntries.size();
+    if (pSession->numLeaves > 0)
+    {
+      const auto& peerVec = mpImpl->mPeers;
+      auto it = begin(peerVec);
+      while (it != end(peerVec))
+      {
+        const auto idEnd = upper_bound(it, end(peerVec), it->first.ident(), IdLess{});
+        auto numLeaves = uint32_t{0};
+        for (; it != idEnd; ++it)
+        {
+          if (it->first.sessionId() == sid)
+          {
+            numLeaves = (max)(numLeaves, it->first.numLeaves);
+          }
+        }
+        count += numLeaves;
+      }
+    }
+    return count;
+  }
+
+  // Number of peer entries of a session, one per gateway of each peer, that carry
+  // the given start stop state
+  std::size_t startStopStateCount(
+    const SessionId& sid, const StartStopState& startStopState) const
+  {
+    const auto pSession = mpImpl->findSession(sid);
+    const auto pEntry =
+      pSession ? Impl::findValue(pSession->startStopStates, startStopState) : nullptr;
+    return pEntry ? pEntry->second : 0;
   }
 
   void setSessionTimeline(const SessionId& sid, const Timeline& tl)
@@ -88,6 +264,14 @@ public:
     // have adopted the newly specified timeline. We must represent
     // this in our cache or else we risk failing to notify about a
     // higher-priority peer timeline that was already seen.
+    auto pSession = mpImpl->findSession(sid);
+    if (!pSession
+        || (pSession->timelines.size() == 1 && pSession->timelines.front().first == tl))
+    {
+      // No peers or all of them already have the timeline
+      return;
+    }
+
     for (auto& peer : mpImpl->mPeers)
     {
       if (peer.first.sessionId() == sid)
@@ -95,6 +279,7 @@ public:
         peer.first.nodeState.timeline = tl;
       }
     }
+    pSession->timelines.assign(1, std::make_pair(tl, pSession->numEntries));
   }
 
   // Purge all cached peers that are members of the given session
@@ -104,11 +289,13 @@ public:
     auto& peerVec = mpImpl->mPeers;
     peerVec.erase(
       remove_if(begin(peerVec), end(peerVec), SessionMemberPred{sid}), end(peerVec));
+    mpImpl->mSessions.erase(sid);
   }
 
   void resetPeers()
   {
     mpImpl->mPeers.clear();
+    mpImpl->mSessions.clear();
   }
 
   // Observer type that monitors peer discovery on a particular
@@ -195,41 +382,79 @@ private:
       const auto peerSession = peerState.sessionId();
       const auto peerTimeline = peerState.timeline();
       const auto peerStartStopState = peerState.startStopState();
-
-      bool isNewSessionTimeline = !sessionTimelineExists(peerSession, peerTimeline);
-      bool isNewSessionStartStopState =
-        !sessionStartStopStateExists(peerSession, peerStartStopState);
+      const auto peerPendingTimeline = peerState.pendingTimeline();
+      const auto peerTempoRamp = peerState.tempoRamp();
 
       auto peer = make_pair(std::move(peerState), std::move(gatewayAddr));
       const auto idRange = equal_range(begin(mPeers), end(mPeers), peer, PeerIdComp{});
+      const auto addrRange = equal_range(idRange.first, idRange.second, peer, AddrComp{});
+
+      // Only the tables of a static footprint fill up
+      if ((addrRange.first == addrRange.second && mPeers.size() == mPeers.max_size())
+          || (!findSession(peerSession) && mSessions.size() == mSessions.max_size()))
+      {
+        return;
+      }
+
+      // Peers repeat their state until it changes. A state that equals the cached
+      // one changes neither the peers nor their sessions. The cache no longer
+      // matches if setSessionTimeline changed it or the peer has been forgotten.
+      if (addrRange.first != addrRange.second && addrRange.first->first == peer.first)
+      {
+        return;
+      }
+
+      // A peer that is visible on several gateways sends each of its states on all
+      // of them. Only the first copy needs to be evaluated against the sessions,
+      // the others just update the entries of their gateways.
+      const auto isKnownState =
+        any_of(idRange.first, idRange.second, [&peer](const Peer& entry) {
+          return entry.first.nodeState == peer.first.nodeState;
+        });
+
+      bool isNewSessionTimeline =
+        !isKnownState && !sessionTimelineExists(peerSession, peerTimeline);
+      bool isNewSessionPendingTimeline = !isKnownState && peerPendingTimeline.isPending()
+                                         && !sessionPendingTimelineExists(
+                                           peerSession, peerPendingTimeline);
+      bool isNewSessionStartStopState =
+        !isKnownState && !sessionStartStopStateExists(peerSession, peerStartStopState);
 
       bool didSessionMembershipChange = false;
       if (idRange.first == idRange.second)
       {
         // This peer is not currently known on any gateway
         didSessionMembershipChange = true;
+        addToIndex(peer);
         mPeers.insert(std::move(idRange.first), std::move(peer));
       }
       else
       {
         // We've seen this peer before... does it have a new session?
         didSessionMembershipChange =
-          all_of(idRange.first, idRange.second, [&peerSession](const Peer& test) {
-            return test.first.sessionId() != peerSession;
-          });
+          !isKnownState
+          && all_of(idRange.first, idRange.second, [&peerSession](const Peer& test) {
+               return test.first.sessionId() != peerSession;
+             });
 
         // was it on this gateway?
-        const auto addrRange =
-          equal_range(idRange.first, idRange.second, peer, AddrComp{});
-
         if (addrRange.first == addrRange.second)
         {
           // First time on this gateway, add it
+          didSessionMembershipChange =
+            didSessionMembershipChange || peer.first.numLeaves > 0;
+          addToIndex(peer);
           mPeers.insert(std::move(addrRange.first), std::move(peer));
         }
         else
         {
-          // We have an entry for this peer on this gateway, update it
+          // We have an entry for this peer on this gateway, update it. The leaves
+          // of a hub are members of its session as well.
+          didSessionMembershipChange = didSessionMembershipChange
+                                       || addrRange.first->first.numLeaves
+                                            != peer.first.numLeaves;
+          removeFromIndex(*addrRange.first);
+          addToIndex(peer);
           *addrRange.first = std::move(peer);
         }
       }
@@ -237,7 +462,12 @@ private:
       // Invoke callbacks outside the critical section
       if (isNewSessionTimeline)
       {
-        mSessionTimelineCallback(peerSession, peerTimeline);
+        mSessionTimelineCallback(peerSession, peerTimeline, peerTempoRamp);
+      }
+
+      if (isNewSessionPendingTimeline)
+      {
+        mSessionTimelineCallback(peerSession, peerPendingTimeline);
       }
 
       // Pass the start stop state to the Controller after it processed the timeline.
@@ -259,14 +489,17 @@ private:
     {
       using namespace std;
 
-      auto it = find_if(begin(mPeers), end(mPeers), [&](const Peer& peer) {
-        return peer.first.ident() == nodeId && peer.second == gatewayAddr;
-      });
+      const auto it = lower_bound(begin(mPeers), end(mPeers), nodeId,
+        [&](const Peer& peer, const NodeId& id) {
+          return peer.first.ident() < id
+                 || (peer.first.ident() == id && peer.second < gatewayAddr);
+        });
 
       bool didSessionMembershipChange = false;
-      if (it != end(mPeers))
+      if (it != end(mPeers) && it->first.ident() == nodeId && it->second == gatewayAddr)
       {
-        mPeers.erase(std::move(it));
+        removeFromIndex(*it);
+        mPeers.erase(it);
         didSessionMembershipChange = true;
       }
 
@@ -280,6 +513,14 @@ private:
     {
       using namespace std;
 
+      for (const auto& peer : mPeers)
+      {
+        if (peer.second == gatewayAddr)
+        {
+          removeFromIndex(peer);
+        }
+      }
+
       mPeers.erase(
         remove_if(begin(mPeers), end(mPeers),
           [&gatewayAddr](const Peer& peer) { return peer.second == gatewayAddr; }),
@@ -288,27 +529,122 @@ private:
       mSessionMembershipCallback();
     }
 
-    template <typename Predicate>
-    bool hasPeerWith(const SessionId& sessionId, Predicate predicate)
+    bool sessionTimelineExists(const SessionId& session, const Timeline& timeline)
     {
-      using namespace std;
-      return find_if(begin(mPeers), end(mPeers), [&](const Peer& peer) {
-        return peer.first.sessionId() == sessionId && predicate(peer.first);
-      }) != end(mPeers);
+      const auto pSession = findSession(session);
+      return pSession && findValue(pSession->timelines, timeline) != nullptr;
     }
 
-    bool sessionTimelineExists(const SessionId& session, const Timeline& timeline)
+    bool sessionPendingTimelineExists(
+      const SessionId& session, const PendingTimeline& pending)
     {
-      return hasPeerWith(session,
-        [&](const PeerState& peerState) { return peerState.timeline() == timeline; });
+      const auto pSession = findSession(session);
+      return pSession && findValue(pSession->pendingTimelines, pending) != nullptr;
     }
 
     bool sessionStartStopStateExists(
       const SessionId& sessionId, const StartStopState& startStopState)
     {
-      return hasPeerWith(sessionId, [&](const PeerState& peerState) {
-        return peerState.startStopState() == startStopState;
-      });
+      const auto pSession = findSession(sessionId);
+      return pSession && findValue(pSession->startStopStates, startStopState) != nullptr;
+    }
+
+    // Index of the peer entries of a session. Timelines, pending timelines and start
+    // stop states are stored with the number of entries that have them. There are
+    // usually only very few distinct values per session.
+    template <typename T>
+    using ValueCounts =
+      util::FootprintVector<std::pair<T, std::size_t>, kMaxPeerEntries>;
+
+    struct SessionIndex
+    {
+      std::size_t numEntries = 0;
+      // The sum of the leaves of all entries
+      std::size_t numLeaves = 0;
+      // Number of entries (one per gateway) of each member peer
+      util::FootprintHashMap<NodeId, std::size_t, kMaxPeerEntries, NodeIdHash>
+        peerEntries;
+      ValueCounts<Timeline> timelines;
+      ValueCounts<PendingTimeline> pendingTimelines;
+      ValueCounts<StartStopState> startStopStates;
+    };
+
+    SessionIndex* findSession(const SessionId& sid)
+    {
+      const auto it = mSessions.find(sid);
+      return it == mSessions.end() ? nullptr : &it->second;
+    }
+
+    template <typename T>
+    static std::pair<T, std::size_t>* findValue(ValueCounts<T>& values, const T& value)
+    {
+      for (auto& entry : values)
+      {
+        if (entry.first == value)
+        {
+          return &entry;
+        }
+      }
+      return nullptr;
+    }
+
+    template <typename T>
+    static void addValue(ValueCounts<T>& values, const T& value)
+    {
+      auto pEntry = findValue(values, value);
+      if (pEntry)
+      {
+        ++pEntry->second;
+      }
+      else
+      {
+        values.emplace_back(value, 1);
+      }
+    }
+
+    template <typename T>
+    static void removeValue(ValueCounts<T>& values, const T& value)
+    {
+      auto pEntry = findValue(values, value);
+      assert(pEntry);
+      if (--pEntry->second == 0)
+      {
+        *pEntry = std::move(values.back());
+        values.pop_back();
+      }
+    }
+
+    void addToIndex(const Peer& peer)
+    {
+      auto& session = mSessions[peer.first.sessionId()];
+      ++session.numEntries;
+      session.numLeaves += peer.first.numLeaves;
+      ++session.peerEntries[peer.first.ident()];
+      addValue(session.timelines, peer.first.timeline());
+      addValue(session.pendingTimelines, peer.first.pendingTimeline());
+      addValue(session.startStopStates, peer.first.startStopState());
+    }
+
+    void removeFromIndex(const Peer& peer)
+    {
+      const auto it = mSessions.find(peer.first.sessionId());
+      assert(it != mSessions.end());
+      auto& session = it->second;
+      if (--session.numEntries == 0)
+      {
+        mSessions.erase(it);
+        return;
+      }
+      session.numLeaves -= peer.first.numLeaves;
+
+      const auto entriesIt = session.peerEntries.find(peer.first.ident());
+      if (--entriesIt->second == 0)
+      {
+        session.peerEntries.erase(entriesIt);
+      }
+      removeValue(session.timelines, peer.first.timeline());
+      removeValue(session.pendingTimelines, peer.first.pendingTimeline());
+      removeValue(session.startStopStates, peer.first.startStopState());
     }
 
     struct PeerIdComp
@@ -331,7 +667,23 @@ private:
     SessionMembershipCallback mSessionMembershipCallback;
     SessionTimelineCallback mSessionTimelineCallback;
     SessionStartStopStateCallback mSessionStartStopStateCallback;
-    std::vector<Peer> mPeers; // sorted by peerId, unique by (peerId, addr)
+    // sorted by peerId, unique by (peerId, addr)
+    util::FootprintVector<Peer, kMaxPeerEntries> mPeers;
+    util::FootprintHashMap<SessionId, SessionIndex, kMaxIndexedSessions, NodeIdHash>
+      mSessions;
+  };
+
+  struct IdLess
+  {
+    bool operator()(const Peer& peer, const NodeId& id) const
+    {
+      return peer.first.ident() < id;
+    }
+
+    bool operator()(const NodeId& id, const Peer& peer) const
+    {
+      return id < peer.first.ident();
+    }
   };
 
   struct SessionMemberPred
@@ -0,0 +1,100 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+#pragma once
+
+#include <ableton/discovery/NetworkByteStreamSerializable.hpp>
+#include <ableton/link/Timeline.hpp>
+#include <chrono>
+#include <cstdint>
+#include <tuple>
+
+namespace ableton
+{
+namespace link
+{
+
+// A timeline that replaces the session timeline at the given ghost time. Peers
+// announce scheduled tempo changes with it ahead of time, so that all of them
+// switch at the same moment instead of following a broadcast once it arrives. The
+// timeline should be continuous with the one it replaces at the activation time.
+// Entries without a timeline take no bytes and are left out of payloads.
+struct PendingTimeline
+{
+  static const std::int32_t key = 'ptml';
+  static_assert(key == 0x70746d6c, "Unexpected byte order");
+  static const std::uint8_t compactKey = 7;
+
+  bool isPending() const
+  {
+    return timeline.tempo > Tempo{0.};
+  }
+
+  // Of two pending timelines the one with the larger beat origin wins, so that
+  // all peers pick the same one, like they do for session timelines
+  friend bool isPreferred(const PendingTimeline& lhs, const PendingTimeline& rhs)
+  {
+    return lhs.isPending()
+           && (!rhs.isPending() || lhs.timeline.beatOrigin > rhs.timeline.beatOrigin);
+  }
+
+  friend bool operator==(const PendingTimeline& lhs, const PendingTimeline& rhs)
+  {
+    return lhs.timeline == rhs.timeline && lhs.activationTime == rhs.activationTime;
+  }
+
+  friend bool operator!=(const PendingTimeline& lhs, const PendingTimeline& rhs)
+  {
+    return !(lhs == rhs);
+  }
+
+  // Model the NetworkByteStreamSerializable concept
+  friend std::uint32_t sizeInByteStream(const PendingTimeline& pending)
+  {
+    if (!pending.isPending())
+    {
+      return 0;
+    }
+    return sizeInByteStream(pending.timeline)
+           + discovery::sizeInByteStream(pending.activationTime);
+  }
+
+  template <typename It>
+  friend It toNetworkByteStream(const PendingTimeline& pending, It out)
+  {
+    if (!pending.isPending())
+    {
+      return out;
+    }
+    return discovery::toNetworkByteStream(
+      pending.activationTime, toNetworkByteStream(pending.timeline, std::move(out)));
+  }
+
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, PendingTimeline& pending)
+  {
+    return Timeline::tryFromNetworkByteStream(begin, end, pending.timeline)
+           && discovery::tryDeserialize(begin, end, pending.activationTime);
+  }
+
+  Timeline timeline;
+  std::chrono::microseconds activationTime;
+};
+
+} // namespace link
+} // namespace ableton
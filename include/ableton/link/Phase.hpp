@@ -22,6 +22,7 @@
 #include <ableton/link/Beats.hpp>
 #include <ableton/link/Timeline.hpp>
 #include <chrono>
+#include <cstdint>
 
 namespace ableton
 {
@@ -30,39 +31,34 @@ namespace link
 
 // Returns a value in the range [0,quantum) corresponding to beats %
 // quantum except that negative beat values are handled correctly.
-// If the given quantum is zero, returns zero.
-inline Beats phase(const Beats beats, const Beats quantum)
+// If the given quantum is zero, returns zero. Negative beat values are
+// handled by doing the computation relative to an origin that is on the
+// nearest quantum boundary less than -(abs(x)).
+constexpr Beats phase(const Beats beats, const Beats quantum) noexcept
 {
-  if (quantum == Beats{INT64_C(0)})
-  {
-    return Beats{INT64_C(0)};
-  }
-  else
-  {
-    // Handle negative beat values by doing the computation relative to an
-    // origin that is on the nearest quantum boundary less than -(abs(x))
-    const auto quantumMicros = quantum.microBeats();
-    const auto quantumBins = (llabs(beats.microBeats()) + quantumMicros) / quantumMicros;
-    const std::int64_t quantumBeats{quantumBins * quantumMicros};
-    return (beats + Beats{quantumBeats}) % quantum;
-  }
+  return quantum == Beats{INT64_C(0)}
+           ? Beats{INT64_C(0)}
+           : (beats
+               + Beats{((abs(beats).microBeats() + quantum.microBeats())
+                         / quantum.microBeats())
+                       * quantum.microBeats()})
+               % quantum;
 }
 
 // Return the least value greater than x that matches the phase of
 // target with respect to the given quantum. If the given quantum
 // quantum is 0, x is returned.
-inline Beats nextPhaseMatch(const Beats x, const Beats target, const Beats quantum)
+constexpr Beats nextPhaseMatch(
+  const Beats x, const Beats target, const Beats quantum) noexcept
 {
-  const auto desiredPhase = phase(target, quantum);
-  const auto xPhase = phase(x, quantum);
-  const auto phaseDiff = (desiredPhase - xPhase + quantum) % quantum;
-  return x + phaseDiff;
+  return x + (phase(target, quantum) - phase(x, quantum) + quantum) % quantum;
 }
 
 // Return the closest value to x that matches the phase of the target
 // with respect to the given quantum. The result deviates from x by at
 // most quantum/2, but may be less than x.
-inline Beats closestPhaseMatch(const Beats x, const Beats target, const Beats quantum)
+inline Beats closestPhaseMatch(
+  const Beats x, const Beats target, const Beats quantum) noexcept
 {
   return nextPhaseMatch(x - Beats{0.5 * quantum.floating()}, target, quantum);
 }
@@ -72,19 +68,129 @@ inline Beats closestPhaseMatch(const Beats x, const Beats target, const Beats qu
 // relative to the given quantum that corresponds to the given
 // time. The phase of the resulting beat value can be calculated with
 // phase(beats, quantum). The result will deviate by up to +-
-// (quantum/2) beats compared to the result of tl.toBeats(time).
+// (quantum/2) beats compared to the result of tl.toBeats(time). Besides
+// Timeline, the timeline functions here also accept a CompiledTimeline.
+template <typename T>
 inline Beats toPhaseEncodedBeats(
-  const Timeline& tl, const std::chrono::microseconds time, const Beats quantum)
+  const T& tl, const std::chrono::microseconds time, const Beats quantum)
 {
   const auto beat = tl.toBeats(time);
   return closestPhaseMatch(beat, beat - tl.beatOrigin, quantum);
 }
 
+// The difference between toPhaseEncodedBeats(tl, time, quantum) and
+// tl.toBeats(time). This offset only depends on the beat origin of the
+// timeline and the quantum, not on the time, so batched evaluations of
+// toPhaseEncodedBeats can compute it once and add it to tl.toBeats(time).
+template <typename T>
+inline Beats phaseEncodingOffset(const T& tl, const Beats quantum)
+{
+  const auto halfQuantum = Beats{0.5 * quantum.floating()};
+  return phase(halfQuantum - tl.beatOrigin, quantum) - halfQuantum;
+}
+
+// Batch versions of phase, nextPhaseMatch, closestPhaseMatch and
+// toPhaseEncodedBeats for ranges of values that each have their own
+// quantum. They return exactly the same results as the scalar functions,
+// but compute each phase with a single division and reduce the phase
+// difference without one. The output may alias the first input range.
+
+namespace detail
+{
+
+// Same as phase(beats, quantum) for positive quanta
+constexpr std::int64_t positivePhase(
+  const std::int64_t beats, const std::int64_t quantum) noexcept
+{
+  return beats % quantum < 0 ? beats % quantum + quantum : beats % quantum;
+}
+
+inline Beats batchNextPhaseMatch(const Beats x, const Beats target, const Beats quantum)
+{
+  const auto quantumMicros = quantum.microBeats();
+  if (quantumMicros <= 0)
+  {
+    return nextPhaseMatch(x, target, quantum);
+  }
+  // Both phases are in [0, quantum), so their difference only needs to be
+  // wrapped once
+  const auto phaseDiff = positivePhase(target.microBeats(), quantumMicros)
+                         - positivePhase(x.microBeats(), quantumMicros);
+  return Beats{x.microBeats() + (phaseDiff < 0 ? phaseDiff + quantumMicros : phaseDiff)};
+}
+
+} // namespace detail
+
+template <typename BeatsIt, typename QuantumIt, typename OutputIt>
+inline OutputIt phases(
+  BeatsIt beatsBegin, const BeatsIt beatsEnd, QuantumIt quantumBegin, OutputIt out)
+{
+  for (; beatsBegin != beatsEnd; ++beatsBegin, ++quantumBegin, ++out)
+  {
+    const auto quantumMicros = quantumBegin->microBeats();
+    *out = quantumMicros > 0
+             ? Beats{detail::positivePhase(beatsBegin->microBeats(), quantumMicros)}
+             : phase(*beatsBegin, *quantumBegin);
+  }
+  return out;
+}
+
+template <typename XIt, typename TargetIt, typename QuantumIt, typename OutputIt>
+inline OutputIt nextPhaseMatches(XIt xBegin,
+  const XIt xEnd,
+  TargetIt targetBegin,
+  QuantumIt quantumBegin,
+  OutputIt out)
+{
+  for (; xBegin != xEnd; ++xBegin, ++targetBegin, ++quantumBegin, ++out)
+  {
+    *out = detail::batchNextPhaseMatch(*xBegin, *targetBegin, *quantumBegin);
+  }
+  return out;
+}
+
+template <typename XIt, typename TargetIt, typename QuantumIt, typename OutputIt>
+inline OutputIt closestPhaseMatches(XIt xBegin,
+  const XIt xEnd,
+  TargetIt targetBegin,
+  QuantumIt quantumBegin,
+  OutputIt out)
+{
+  for (; xBegin != xEnd; ++xBegin, ++targetBegin, ++quantumBegin, ++out)
+  {
+    const auto quantum = *quantumBegin;
+    *out = detail::batchNextPhaseMatch(
+      *xBegin - Beats{0.5 * quantum.floating()}, *targetBegin, quantum);
+  }
+  return out;
+}
+
+// Evaluates toPhaseEncodedBeats at the same time for a range of quanta. The
+// timeline is only evaluated once.
+template <typename T, typename QuantumIt, typename OutputIt>
+inline OutputIt toPhaseEncodedBeats(const T& tl,
+  const std::chrono::microseconds time,
+  QuantumIt quantumBegin,
+  const QuantumIt quantumEnd,
+  OutputIt out)
+{
+  const auto beat = tl.toBeats(time);
+  const auto target = beat - tl.beatOrigin;
+  for (; quantumBegin != quantumEnd; ++quantumBegin, ++out)
+  {
+    const auto quantum = *quantumBegin;
+    *out = detail::batchNextPhaseMatch(
+      beat - Beats{0.5 * quantum.floating()}, target, quantum);
+  }
+  return out;
+}
+
 // The inverse of toPhaseEncodedBeats. Given a phase encoded beat
 // value from the given timeline and quantum, find the time value that
 // it maps to.
+template <typename T>
 inline std::chrono::microseconds fromPhaseEncodedBeats(
-  const Timeline& tl, const Beats beat, const Beats quantum)
+  const T& tl, const Beats beat, const Beats quantum)
 {
   const auto fromOrigin = beat - tl.beatOrigin;
   const auto originOffset = fromOrigin - phase(fromOrigin, quantum);
@@ -19,40 +19,85 @@
 
 #pragma once
 
+#include <ableton/discovery/GatewayStats.hpp>
+#include <ableton/discovery/SocketOptions.hpp>
 #include <ableton/link/GhostXForm.hpp>
 #include <ableton/link/PayloadEntries.hpp>
+#include <ableton/link/SeqLockBuffer.hpp>
 #include <ableton/link/SessionId.hpp>
 #include <ableton/link/v1/Messages.hpp>
 #include <ableton/util/Injected.hpp>
-#include <ableton/util/SafeAsyncHandler.hpp>
+#include <ableton/util/Log.hpp>
+#include <ableton/util/Trace.hpp>
 #include <chrono>
+#include <functional>
 #include <memory>
+#include <tuple>
 
 namespace ableton
 {
 namespace link
 {
 
+// Answers the pings of measuring peers. The IoContext is usually the responder
+// context of the platform's io context, which may run on a thread of its own. The
+// responder is therefore only accessed from the io thread of the context, except
+// for the node state, which is shared through a SeqLockBuffer so that updating it
+// doesn't need to wait for the handling of a ping. No memory is allocated while
+// replying to pings.
+//
+// A pong starts with the protocol header, the session membership and the ghost time,
+// followed by the payload of the ping. Everything but the ghost time is encoded
+// when the node state is updated, so replying only patches the ghost time in place.
+//
+// If a pong handler is set, measurements may send their pings through the socket of
+// the responder, which then passes the pongs it receives on to the handler.
 template <typename Clock, typename IoContext>
 class PingResponder
 {
   using IoType = util::Injected<IoContext&>;
   using Socket = typename IoType::type::template Socket<v1::kMaxMessageSize>;
 
+  using EntryHeader = discovery::PayloadEntryHeader;
+  static constexpr std::size_t kEntryHeaderSize =
+    sizeof(EntryHeader::Key) + sizeof(EntryHeader::Size);
+  static constexpr std::size_t kTimeEntrySize = kEntryHeaderSize + sizeof(std::int64_t);
+  // Pings carry a HostTime and optionally a PrevGHostTime
+  static constexpr std::size_t kMaxPingPayloadSize = 2 * kTimeEntrySize;
+  static constexpr std::size_t kPongHeaderSize =
+    std::tuple_size<v1::detail::ProtocolHeader>::value + sizeof(v1::MessageType)
+    + kEntryHeaderSize + std::tuple_size<NodeIdArray>::value + kTimeEntrySize;
+  static constexpr std::size_t kGhostTimeOffset = kPongHeaderSize - sizeof(std::int64_t);
+
 public:
-  PingResponder(asio::ip::address_v4 address,
+  using PongHandler = std::function<void(
+    const asio::ip::udp::endpoint&, const uint8_t* begin, const uint8_t* end)>;
+
+  PingResponder(asio::ip::address address,
     SessionId sessionId,
     GhostXForm ghostXForm,
     Clock clock,
-    IoType io)
+    IoType io,
+    std::shared_ptr<discovery::GatewayStats> pStats =
+      std::make_shared<discovery::GatewayStats>())
     : mIo(io)
     , mpImpl(std::make_shared<Impl>(std::move(address),
         std::move(sessionId),
         std::move(ghostXForm),
         std::move(clock),
-        std::move(io)))
+        std::move(io),
+        std::move(pStats)))
+  {
+    auto pImpl = mpImpl;
+    mIo->async([pImpl] { pImpl->listen(); });
+  }
+
+  ~PingResponder()
   {
-    mpImpl->listen();
+    // Release the implementation on the io thread, where it may currently be
+    // replying to a ping
+    auto pImpl = mpImpl;
+    mIo->async([pImpl] {});
   }
 
   PingResponder(const PingResponder&) = delete;
@@ -60,8 +105,7 @@ public:
 
   void updateNodeState(const SessionId& sessionId, const GhostXForm& xform)
   {
-    mpImpl->mSessionId = std::move(sessionId);
-    mpImpl->mGhostXForm = std::move(xform);
+    mpImpl->mNodeState.write(makeNodeState(sessionId, xform));
   }
 
   asio::ip::udp::endpoint endpoint() const
@@ -79,25 +123,75 @@ public:
     return mpImpl->mSocket;
   }
 
+  // The socket of the responder, for others to send messages through. It keeps the
+  // responder's implementation alive.
+  std::shared_ptr<Socket> sharedSocket() const
+  {
+    return std::shared_ptr<Socket>(mpImpl, &mpImpl->mSocket);
+  }
+
+  // Must be called on the io thread of the responder's context
+  void setPongHandler(PongHandler handler)
+  {
+    mpImpl->mPongHandler = std::move(handler);
+  }
+
 private:
-  struct Impl : std::enable_shared_from_this<Impl>
+  struct NodeState
+  {
+    std::array<uint8_t, kPongHeaderSize> pongHeader;
+    GhostXForm ghostXForm;
+  };
+
+  static NodeState makeNodeState(const SessionId& sessionId, const GhostXForm& xform)
   {
-    Impl(asio::ip::address_v4 address,
+    NodeState state;
+    v1::pongMessage(discovery::makePayload(SessionMembership{sessionId}, GHostTime{}),
+      begin(state.pongHeader));
+    state.ghostXForm = xform;
+    return state;
+  }
+
+  struct Impl;
+
+  // Unlike a SafeAsyncHandler, this fits into the small buffer of the socket's
+  // handler, so that listening for the next ping doesn't allocate. The
+  // implementation is only released on the io thread and thus outlives the
+  // invocations of the handler.
+  struct ReceiveHandler
+  {
+    template <typename It>
+    void operator()(
+      const asio::ip::udp::endpoint& from, const It begin, const It end) const
+    {
+      (*mpImpl)(from, begin, end);
+    }
+
+    Impl* mpImpl;
+  };
+
+  struct Impl
+  {
+    Impl(asio::ip::address address,
       SessionId sessionId,
       GhostXForm ghostXForm,
       Clock clock,
-      IoType io)
-      : mSessionId(std::move(sessionId))
-      , mGhostXForm(std::move(ghostXForm))
+      IoType io,
+      std::shared_ptr<discovery::GatewayStats> pStats)
+      : mNodeState(makeNodeState(sessionId, ghostXForm))
       , mClock(std::move(clock))
-      , mLog(channel(io->log(), "gateway@" + address.to_string()))
-      , mSocket(io->template openUnicastSocket<v1::kMaxMessageSize>(address))
+      , mpStats(std::move(pStats))
+      , mLog(util::lazyChannel(
+          io->log(), [&address] { return "gateway@" + address.to_string(); }))
+      , mTrace(io->trace())
+      , mSocket(io->template openUnicastSocket<v1::kMaxMessageSize>(
+          address, discovery::TrafficClass::Timing))
     {
     }
 
     void listen()
     {
-      mSocket.receive(util::makeAsyncSafe(this->shared_from_this()));
+      mSocket.receive(ReceiveHandler{this});
     }
 
     // Operator to handle incoming messages on the interface
@@ -105,6 +199,9 @@ private:
     void operator()(const asio::ip::udp::endpoint& from, const It begin, const It end)
     {
       using namespace discovery;
+      const ScopedPacketHandler packetHandler(*mpStats);
+      trace(mTrace, util::TraceEvent::PacketReceived, util::traceEndpoint(from),
+        static_cast<std::uint64_t>(std::distance(begin, end)));
 
       // Decode Ping Message
       const auto result = link::v1::parseMessageHeader(begin, end);
@@ -113,24 +210,20 @@ private:
 
       // Check Payload size
       const auto payloadSize = static_cast<std::size_t>(std::distance(payloadBegin, end));
-      const auto maxPayloadSize =
-        sizeInByteStream(makePayload(HostTime{}, PrevGHostTime{}));
-      if (header.messageType == v1::kPing && payloadSize <= maxPayloadSize)
+      if (header.messageType == v1::kPing && payloadSize <= kMaxPingPayloadSize)
       {
-        debug(mLog) << " Received ping message from " << from;
-
-        try
-        {
-          reply(std::move(payloadBegin), std::move(end), from);
-        }
-        catch (const std::runtime_error& err)
-        {
-          info(mLog) << " Failed to send pong to " << from << ". Reason: " << err.what();
-        }
+        LINK_DEBUG(mLog) << " Received ping message from " << from;
+
+        reply(std::move(payloadBegin), std::move(end), from);
+      }
+      else if (header.messageType == v1::kPong && mPongHandler)
+      {
+        mPongHandler(from, &*begin, &*begin + std::distance(begin, end));
       }
       else
       {
-        info(mLog) << " Received invalid Message from " << from << ".";
+        GatewayStats::increment(mpStats->parseFailures);
+        LINK_INFO(mLog) << " Received invalid Message from " << from << ".";
       }
       listen();
     }
@@ -138,28 +231,41 @@ private:
     template <typename It>
     void reply(It begin, It end, const asio::ip::udp::endpoint& to)
     {
-      using namespace discovery;
-
-      // Encode Pong Message
-      const auto id = SessionMembership{mSessionId};
-      const auto currentGt = GHostTime{mGhostXForm.hostToGhost(mClock.micros())};
-      const auto pongPayload = makePayload(id, currentGt);
-
-      v1::MessageBuffer pongBuffer;
-      const auto pongMsgBegin = std::begin(pongBuffer);
-      auto pongMsgEnd = v1::pongMessage(pongPayload, pongMsgBegin);
+      // Encode Pong Message. The ghost time is taken halfway between the arrival of
+      // the ping and now, so that the time it takes to handle the ping doesn't bias
+      // the measurement of the pinging peer.
+      const auto nodeState = mNodeState.read();
+      const auto pongMsgBegin = std::begin(mPongBuffer);
+      std::copy(std::begin(nodeState.pongHeader), std::end(nodeState.pongHeader),
+        pongMsgBegin);
+      discovery::toNetworkByteStream(
+        nodeState.ghostXForm.hostToGhost(mClock.micros() - mSocket.receiveDelay() / 2),
+        pongMsgBegin + kGhostTimeOffset);
       // Append ping payload to pong message.
-      pongMsgEnd = std::copy(begin, end, pongMsgEnd);
+      const auto pongMsgEnd = std::copy(begin, end, pongMsgBegin + kPongHeaderSize);
 
       const auto numBytes =
         static_cast<std::size_t>(std::distance(pongMsgBegin, pongMsgEnd));
-      mSocket.send(pongBuffer.data(), numBytes, to);
+      asio::error_code ec;
+      mSocket.send(mPongBuffer.data(), numBytes, to, ec);
+      if (ec)
+      {
+        LINK_INFO(mLog) << " Failed to send pong to " << to
+                        << ". Reason: " << ec.message();
+        return;
+      }
+      discovery::GatewayStats::increment(mpStats->packetsSent);
+      trace(mTrace, util::TraceEvent::PacketSent, util::traceEndpoint(to),
+        static_cast<std::uint64_t>(numBytes));
     }
 
-    SessionId mSessionId;
-    GhostXForm mGhostXForm;
+    SeqLockBuffer<NodeState> mNodeState;
+    v1::MessageBuffer mPongBuffer;
     Clock mClock;
+    std::shared_ptr<discovery::GatewayStats> mpStats;
     typename IoType::type::Log mLog;
+    typename IoType::type::Trace mTrace;
+    PongHandler mPongHandler;
     Socket mSocket;
   };
 
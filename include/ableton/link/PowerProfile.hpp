@@ -0,0 +1,48 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace ableton
+{
+namespace link
+{
+
+// How often Link wakes up to keep the session going
+enum class PowerProfile
+{
+  // The nominal periods
+  Full,
+  // For apps in the background and devices that run on battery. The broadcasts,
+  // the interface scans and the fallback of the callback dispatcher run at a
+  // quarter of their rate and the joined session isn't remeasured. The ttl that the
+  // peers time the node out after is stretched along with the broadcast period.
+  Background
+};
+
+// The factor by which the profile stretches the periods of the timers
+inline std::size_t periodFactor(const PowerProfile profile)
+{
+  return profile == PowerProfile::Background ? 4 : 1;
+}
+
+} // namespace link
+} // namespace ableton
@@ -0,0 +1,139 @@
+/* Copyright 2022, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace ableton
+{
+namespace link
+{
+
+// Single writer, multiple reader buffer based on sequence locks. In contrast to
+// TripleBuffer, any number of threads may read concurrently. The value is kept in two
+// slots that the writer alternates between. A read copies the most recently completed
+// slot and only retries if that slot was overwritten while copying, so a writer that
+// is preempted in the middle of a write never blocks the readers.
+//
+// The value is copied word by word through relaxed atomics to avoid data races
+// between readers and the writer, which requires T to be trivially copyable.
+template <typename T>
+struct SeqLockBuffer
+{
+  static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+
+  SeqLockBuffer()
+    : SeqLockBuffer(T{})
+  {
+  }
+
+  explicit SeqLockBuffer(const T& initial)
+  {
+    assert(mLatest.is_lock_free());
+    for (auto& slot : mSlots)
+    {
+      slot.sequence.store(0u, std::memory_order_relaxed);
+      storeWords(slot, initial);
+    }
+  }
+
+  SeqLockBuffer(const SeqLockBuffer&) = delete;
+  SeqLockBuffer& operator=(const SeqLockBuffer&) = delete;
+
+  T read() const noexcept
+  {
+    T value;
+    auto index = mLatest.load(std::memory_order_acquire);
+    while (!tryRead(mSlots[index], value))
+    {
+      index = mLatest.load(std::memory_order_acquire);
+    }
+    return value;
+  }
+
+  // Must not be called from multiple threads concurrently
+  void write(const T& value) noexcept
+  {
+    auto& slot = mSlots[mWriteIndex];
+    const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1u, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    storeWords(slot, value);
+    slot.sequence.store(sequence + 2u, std::memory_order_release);
+
+    mLatest.store(mWriteIndex, std::memory_order_release);
+    mWriteIndex ^= 1u;
+  }
+
+private:
+  using Word = std::uint32_t;
+  static constexpr std::size_t kNumWords = (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+  struct Slot
+  {
+    std::atomic<std::uint32_t> sequence; // Odd while being written
+    std::array<std::atomic<Word>, kNumWords> words;
+  };
+
+  static void storeWords(Slot& slot, const T& value) noexcept
+  {
+    std::array<Word, kNumWords> words{};
+    std::memcpy(words.data(), static_cast<const void*>(&value), sizeof(T));
+    for (std::size_t i = 0; i < kNumWords; ++i)
+    {
+      slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+  }
+
+  static bool tryRead(const Slot& slot, T& value) noexcept
+  {
+    const auto sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence & 1u)
+    {
+      return false;
+    }
+
+    std::array<Word, kNumWords> words;
+    for (std::size_t i = 0; i < kNumWords; ++i)
+    {
+      words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+    {
+      return false;
+    }
+
+    std::memcpy(static_cast<void*>(&value), words.data(), sizeof(T));
+    return true;
+  }
+
+  std::atomic<std::uint32_t> mLatest{0u}; // Reader and writer
+  std::uint32_t mWriteIndex = 1u;         // Writer only
+  std::array<Slot, 2> mSlots;
+};
+
+} // namespace link
+} // namespace ableton
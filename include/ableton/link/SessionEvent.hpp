@@ -0,0 +1,75 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#pragma once
+
+#include <ableton/link/Tempo.hpp>
+#include <chrono>
+
+namespace ableton
+{
+namespace link
+{
+
+// A change of the session tempo or start/stop state as it is delivered
+// to a realtime thread by the session event queue
+
+struct SessionEvent
+{
+  enum class Type
+  {
+    Tempo,
+    StartStop
+  };
+
+  static SessionEvent tempoChange(const std::chrono::microseconds time, const Tempo tempo)
+  {
+    return {Type::Tempo, time, tempo.bpm(), false};
+  }
+
+  static SessionEvent startStopChange(
+    const std::chrono::microseconds time, const bool isPlaying)
+  {
+    return {Type::StartStop, time, 0., isPlaying};
+  }
+
+  friend bool operator==(const SessionEvent& lhs, const SessionEvent& rhs)
+  {
+    return lhs.type == rhs.type && lhs.time == rhs.time && lhs.bpm == rhs.bpm
+           && lhs.isPlaying == rhs.isPlaying;
+  }
+
+  friend bool operator!=(const SessionEvent& lhs, const SessionEvent& rhs)
+  {
+    return !(lhs == rhs);
+  }
+
+  Type type;
+  // For tempo changes the host time at which Link adopted the new tempo, for
+  // start/stop changes the host time at which transport starts or stops
+  std::chrono::microseconds time;
+  // Only meaningful for tempo changes
+  double bpm;
+  // Only meaningful for start/stop changes
+  bool isPlaying;
+};
+
+} // namespace link
+} // namespace ableton
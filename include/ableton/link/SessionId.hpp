@@ -35,6 +35,7 @@ struct SessionMembership
 {
   static const std::int32_t key = 'sess';
   static_assert(key == 0x73657373, "Unexpected byte order");
+  static const std::uint8_t compactKey = 2;
 
   // Model the NetworkByteStreamSerializable concept
   friend std::uint32_t sizeInByteStream(const SessionMembership& sm)
@@ -48,12 +49,18 @@ struct SessionMembership
     return discovery::toNetworkByteStream(sm.sessionId, std::move(out));
   }
 
+  template <typename It>
+  static bool tryFromNetworkByteStream(
+    It& begin, const It end, SessionMembership& membership)
+  {
+    return discovery::tryDeserialize(begin, end, membership.sessionId);
+  }
+
   template <typename It>
   static std::pair<SessionMembership, It> fromNetworkByteStream(It begin, It end)
   {
-    using namespace std;
-    auto idRes = SessionId::fromNetworkByteStream(std::move(begin), std::move(end));
-    return make_pair(SessionMembership{std::move(idRes.first)}, std::move(idRes.second));
+    return discovery::fromNetworkByteStreamOrThrow<SessionMembership>(
+      std::move(begin), std::move(end));
   }
 
   SessionId sessionId;
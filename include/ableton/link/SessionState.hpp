@@ -19,10 +19,15 @@
 
 #pragma once
 
+#include <ableton/link/GhostXForm.hpp>
 #include <ableton/link/Optional.hpp>
+#include <ableton/link/SeqLockBuffer.hpp>
 #include <ableton/link/StartStopState.hpp>
+#include <ableton/link/TempoRamp.hpp>
 #include <ableton/link/Timeline.hpp>
 #include <ableton/link/TripleBuffer.hpp>
+#include <atomic>
+#include <cstdint>
 #include <mutex>
 
 namespace ableton
@@ -34,19 +39,22 @@ using OptionalTimeline = Optional<Timeline>;
 using OptionalStartStopState = Optional<StartStopState>;
 using OptionalClientStartStopState = Optional<ClientStartStopState>;
 
+// The tempo ramp of a state leads to its timeline. It's empty if the timeline
+// isn't reached through a ramp.
 struct SessionState
 {
   Timeline timeline;
   StartStopState startStopState;
   GhostXForm ghostXForm;
+  TempoRamp tempoRamp;
 };
 
 struct ClientState
 {
   friend bool operator==(const ClientState& lhs, const ClientState& rhs)
   {
-    return std::tie(lhs.timeline, lhs.startStopState)
-           == std::tie(rhs.timeline, rhs.startStopState);
+    return std::tie(lhs.timeline, lhs.startStopState, lhs.tempoRamp)
+           == std::tie(rhs.timeline, rhs.startStopState, rhs.tempoRamp);
   }
 
   friend bool operator!=(const ClientState& lhs, const ClientState& rhs)
@@ -56,6 +64,7 @@ struct ClientState
 
   Timeline timeline;
   ClientStartStopState startStopState;
+  TempoRamp tempoRamp;
 };
 
 struct ControllerClientState
@@ -63,32 +72,56 @@ struct ControllerClientState
   ControllerClientState(ClientState state)
     : mState(state)
     , mRtState(state)
+    , mPublishedState(state)
+    , mVersion(0)
   {
   }
 
+  // The mutex only serializes writers. Readers never take it, so
+  // frequent reads don't contend with updates from the io thread.
   template <typename Fn>
   void update(Fn fn)
   {
     std::unique_lock<std::mutex> lock(mMutex);
+    const auto previous = mState;
     fn(mState);
     mRtState.write(mState);
+    mPublishedState.write(mState);
+    if (mState != previous)
+    {
+      mVersion.fetch_add(1, std::memory_order_release);
+    }
   }
 
+  // Non-blocking and thread-safe, can be called from any number of
+  // threads concurrently
   ClientState get() const
   {
-    std::unique_lock<std::mutex> lock(mMutex);
-    return mState;
+    return mPublishedState.read();
+  }
+
+  // Increases whenever an update changes the state. A state that is read after the
+  // version is at least as recent as that version.
+  std::uint64_t version() const
+  {
+    return mVersion.load(std::memory_order_acquire);
   }
 
-  ClientState getRt() const
+  // Only for the realtime thread. The reference is valid until the next call.
+  const ClientState& getRt() const
   {
-    return mRtState.read();
+    return mRtState.readInPlace();
   }
 
 private:
-  mutable std::mutex mMutex;
+  // A ClientState is a few words, so the readers of other threads copy it out of
+  // a SeqLockBuffer rather than hold on to a slot of a SnapshotBuffer, which would
+  // need a sequentially consistent store for every read.
+  std::mutex mMutex;
   ClientState mState;
   mutable TripleBuffer<ClientState> mRtState;
+  SeqLockBuffer<ClientState> mPublishedState;
+  std::atomic<std::uint64_t> mVersion;
 };
 
 struct RtClientState
@@ -97,6 +130,7 @@ struct RtClientState
   ClientStartStopState startStopState;
   std::chrono::microseconds timelineTimestamp;
   std::chrono::microseconds startStopStateTimestamp;
+  TempoRamp tempoRamp;
 };
 
 struct IncomingClientState
@@ -104,12 +138,15 @@ struct IncomingClientState
   OptionalTimeline timeline;
   OptionalClientStartStopState startStopState;
   std::chrono::microseconds timelineTimestamp;
+  // Only applies together with the timeline
+  TempoRamp tempoRamp;
 };
 
 struct ApiState
 {
   Timeline timeline;
   ApiStartStopState startStopState;
+  TempoRamp tempoRamp;
 };
 
 } // namespace link
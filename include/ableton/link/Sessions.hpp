@@ -20,8 +20,18 @@
 #pragma once
 
 #include <ableton/link/GhostXForm.hpp>
+#include <ableton/link/GhostXFormTracker.hpp>
+#include <ableton/link/Median.hpp>
 #include <ableton/link/SessionId.hpp>
+#include <ableton/link/SyncQuality.hpp>
+#include <ableton/link/SyncStratum.hpp>
 #include <ableton/link/Timeline.hpp>
+#include <ableton/util/Footprint.hpp>
+#include <ableton/util/Log.hpp>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
 
 namespace ableton
 {
@@ -32,6 +42,9 @@ struct SessionMeasurement
 {
   GhostXForm xform;
   std::chrono::microseconds timestamp;
+  SyncQuality quality;
+  // The stratum of the node in the session when joining it, 0 for its founder
+  std::uint8_t stratum;
 };
 
 struct Session
@@ -41,6 +54,21 @@ struct Session
   SessionMeasurement measurement;
 };
 
+// What a node knows about a session, see Sessions::forEachSession
+struct SessionInfo
+{
+  SessionId sessionId;
+  Timeline timeline;
+  // The individual peers of the session, not counting the node itself
+  std::size_t numPeers;
+  // The timestamp is 0 if the session hasn't been measured yet
+  SessionMeasurement measurement;
+  bool isCurrent;
+};
+
+// The current session first, followed by the other sessions ordered by session id
+using SessionList = std::vector<SessionInfo>;
+
 template <typename Peers,
   typename MeasurePeer,
   typename JoinSessionCallback,
@@ -48,29 +76,133 @@ template <typename Peers,
   typename Clock>
 class Sessions
 {
+  using OtherSessions = util::FootprintVector<Session, util::kMaxSessions>;
+
 public:
   using Timer = typename util::Injected<IoContext>::type::Timer;
+  using Micros = std::chrono::microseconds;
+
+  // Maximum number of peers of a session that are measured in parallel. Their
+  // results are combined, so a single peer with a bad connection doesn't spoil
+  // the measurement of the session.
+  static const std::size_t kMaxMeasuredPeers = 3;
+
+  // Period of the remeasurements of a joined session. Their results are tracked
+  // to follow the drift of the host clock relative to the session's ghost time.
+  static std::chrono::microseconds remeasurementPeriod()
+  {
+    return std::chrono::seconds{10};
+  }
+
+  // Default maximum number of other sessions that are remembered. Each new
+  // session is measured, so this also bounds the measurements caused by a flood
+  // of sessions. With a static footprint, it's also the most sessions that can be
+  // remembered.
+  static const std::size_t kDefaultMaxOtherSessions =
+    util::kStaticFootprint ? util::kMaxSessions : 32;
+
+  // Switching sessions resets the start/stop state, updates the discovery and
+  // launches measurements, so peers on a network that partitions and heals mustn't
+  // bounce between sessions. Joining new sessions that win is never held back, but
+  // within switchHoldPeriod of leaving a session, it must lead by switchHysteresis
+  // more than usual to be rejoined and it doesn't win ties. Rejoining it within
+  // minRejoinInterval is deferred and decided again once the interval has passed.
+  static std::chrono::microseconds switchHoldPeriod()
+  {
+    return std::chrono::seconds{10};
+  }
+
+  static std::chrono::microseconds minRejoinInterval()
+  {
+    return std::chrono::seconds{2};
+  }
+
+  static std::chrono::microseconds switchHysteresis()
+  {
+    return std::chrono::milliseconds{100};
+  }
 
   Sessions(Session init,
     util::Injected<Peers> peers,
     MeasurePeer measure,
     JoinSessionCallback join,
     util::Injected<IoContext> io,
-    Clock clock)
+    Clock clock,
+    const std::size_t maxOtherSessions = kDefaultMaxOtherSessions)
     : mPeers(std::move(peers))
     , mMeasure(std::move(measure))
     , mCallback(std::move(join))
     , mCurrent(std::move(init))
     , mIo(std::move(io))
     , mTimer(mIo->makeTimer())
+    , mSwitchTimer(mIo->makeTimer())
     , mClock(std::move(clock))
+    , mMaxOtherSessions((std::min)(maxOtherSessions, mOtherSessions.max_size()))
+    , mMaxMeasuredOtherSessions(kDefaultMaxOtherSessions)
+    , mIsObserver(false)
+    , mIsRemeasurementSuspended(false)
+    , mIsRemeasurementDue(false)
+    , mFoundedSessionId(mCurrent.sessionId)
+    , mHasSwitched(false)
+    , mHasDeferredSwitch(false)
+    , mLastSwitchTime(0)
+  {
+  }
+
+  // An observer isn't known to its peers, so its own session can't win. As long as
+  // the current session has no peers, the first session that is measured is
+  // joined. Only one peer of a session is measured.
+  void enableObserverMode(const bool bEnable)
+  {
+    mIsObserver = bEnable;
+  }
+
+  // New sessions that are seen while at least maxMeasured other sessions are
+  // remembered are remembered without being measured, which bounds the measurement
+  // traffic caused by many competing sessions. They can't be joined, as there's
+  // nothing to compare them with, until a later sighting after their eviction finds
+  // room below the limit again. Sessions that are already remembered aren't
+  // affected.
+  void setMaxMeasuredOtherSessions(const std::size_t maxMeasured)
   {
+    mMaxMeasuredOtherSessions = maxMeasured;
+  }
+
+  // Invokes fn with the current session and then with each of the other remembered
+  // sessions, ordered by session id
+  template <typename Fn>
+  void forEachSession(Fn fn) const
+  {
+    fn(mCurrent);
+    for (const auto& session : mOtherSessions)
+    {
+      fn(session);
+    }
+  }
+
+  // While suspended, the remeasurements of the joined session are skipped. New
+  // sessions are still measured, so that the node joins the one that wins. A
+  // remeasurement that fell due in the meantime is launched on resuming.
+  void suspendRemeasurements(const bool bSuspend)
+  {
+    mIsRemeasurementSuspended = bSuspend;
+    if (!bSuspend && mIsRemeasurementDue)
+    {
+      launchSessionMeasurement(mCurrent);
+      scheduleRemeasurement();
+    }
   }
 
   void resetSession(Session session)
   {
+    mIsRemeasurementDue = false;
+    mFoundedSessionId = session.sessionId;
     mCurrent = std::move(session);
     mOtherSessions.clear();
+    mXFormTracker.reset();
+    mHasSwitched = false;
+    mHasDeferredSwitch = false;
+    mSwitchTimer.cancel();
   }
 
   void resetTimeline(Timeline timeline)
@@ -78,6 +210,20 @@ public:
     mCurrent.timeline = std::move(timeline);
   }
 
+  // The latest measurement of the current session or of a remembered other one. It's
+  // empty if the session is unknown or hasn't been measured yet.
+  SessionMeasurement sessionMeasurement(const SessionId& sid) const
+  {
+    using namespace std;
+    if (sid == mCurrent.sessionId)
+    {
+      return mCurrent.measurement;
+    }
+    const auto range = equal_range(
+      begin(mOtherSessions), end(mOtherSessions), Session{sid, {}, {}}, SessionIdComp{});
+    return range.first != range.second ? range.first->measurement : SessionMeasurement{};
+  }
+
   // Consider the observed session/timeline pair and return a possibly
   // new timeline that should be used going forward.
   Timeline sawSessionTimeline(SessionId sid, Timeline timeline)
@@ -97,8 +243,21 @@ public:
       {
         // brand new session, insert it into our list of known
         // sessions and launch a measurement
-        launchSessionMeasurement(session);
-        mOtherSessions.insert(range.first, std::move(session));
+        if (mOtherSessions.size() >= mMaxOtherSessions)
+        {
+          if (mMaxOtherSessions == 0)
+          {
+            return mCurrent.timeline;
+          }
+          evictOtherSession();
+        }
+        if (mOtherSessions.size() < mMaxMeasuredOtherSessions)
+        {
+          launchSessionMeasurement(session);
+        }
+        const auto it = lower_bound(
+          begin(mOtherSessions), end(mOtherSessions), session, SessionIdComp{});
+        mOtherSessions.insert(it, std::move(session));
       }
       else
       {
@@ -106,41 +265,81 @@ public:
         updateTimeline(*range.first, std::move(timeline));
       }
     }
+    mCallback.sessionsChanged();
     return mCurrent.timeline;
   }
 
 private:
+  // Evicts the session that was measured least recently. Sessions that haven't
+  // been measured yet go first, the result of a measurement in progress is
+  // ignored. The peers of the session are forgotten, so that it's measured
+  // again if it's still around.
+  void evictOtherSession()
+  {
+    using namespace std;
+    const auto it = min_element(begin(mOtherSessions), end(mOtherSessions),
+      [](const Session& lhs, const Session& rhs) {
+        return lhs.measurement.timestamp < rhs.measurement.timestamp;
+      });
+    const auto sessionId = it->sessionId;
+    LINK_DEBUG(mIo->log()) << "Evicting session " << sessionId;
+    mOtherSessions.erase(it);
+    mPeers->forgetSession(sessionId);
+  }
+
   void launchSessionMeasurement(Session& session)
   {
     using namespace std;
-    auto peers = mPeers->sessionPeers(session.sessionId);
-    if (!peers.empty())
+    // Measure every peer only once, even if it's visible on multiple gateways.
+    // Seeding the choice with the id of this node lets the peers that join a
+    // session measure different peers of a low stratum instead of all measuring
+    // its founder.
+    array<Peer, kMaxMeasuredPeers> peers;
+    const auto peersEnd = mPeers->sessionPeersToMeasure(session.sessionId,
+      mIsObserver ? 1 : peers.size(), NodeIdHash{}(mFoundedSessionId), begin(peers));
+    if (peersEnd != begin(peers))
     {
-      // first criteria: always prefer the founding peer
-      const auto it = find_if(begin(peers), end(peers),
-        [&session](const Peer& peer) { return session.sessionId == peer.first.ident(); });
-      // TODO: second criteria should be degree. We don't have that
-      // represented yet so just use the first peer for now
-      auto peer = it == end(peers) ? peers.front() : *it;
       // mark that a session is in progress by clearing out the
       // session's timestamp
       session.measurement.timestamp = {};
-      mMeasure(std::move(peer), MeasurementResultsHandler{*this, session.sessionId});
+
+      // The measurement round must be complete before the first handler can be
+      // invoked, which may happen synchronously
+      const auto sessionId = session.sessionId;
+      auto pRound = make_shared<MeasurementRound>();
+      pRound->numPending = static_cast<size_t>(distance(begin(peers), peersEnd));
+      for (auto it = begin(peers); it != peersEnd; ++it)
+      {
+        const auto stratum =
+          it->first.ident() == sessionId ? std::uint8_t{0} : it->first.nodeState.stratum;
+        mMeasure(std::move(*it),
+          MeasurementResultsHandler{*this, sessionId, pRound, stratum});
+      }
     }
   }
 
-  void handleSuccessfulMeasurement(const SessionId& id, GhostXForm xform)
+  void handleSuccessfulMeasurement(const SessionId& id,
+    GhostXForm xform,
+    const SyncQuality quality,
+    const std::uint8_t peerStratum)
   {
     using namespace std;
 
-    debug(mIo->log()) << "Session " << id << " measurement completed with result "
-                      << "(" << xform.slope << ", " << xform.intercept.count() << ")";
+    LINK_DEBUG(mIo->log()) << "Session " << id << " measurement completed with result ("
+                           << xform.slope << ", " << xform.intercept.count() << ")";
 
-    auto measurement = SessionMeasurement{std::move(xform), mClock.micros()};
+    const auto measurementTime = mClock.micros();
+    // The founder stays the reference of its session when it measures its peers
+    const auto stratum = id == mFoundedSessionId ? std::uint8_t{0}
+                                                 : SyncStratum::above(peerStratum);
+    auto measurement =
+      SessionMeasurement{std::move(xform), measurementTime, quality, stratum};
 
     if (mCurrent.sessionId == id)
     {
-      mCurrent.measurement = std::move(measurement);
+      mCurrent.measurement =
+        SessionMeasurement{mXFormTracker.update(measurementTime, measurement.xform),
+          measurementTime, quality, measurement.stratum};
       mCallback(mCurrent);
     }
     else
@@ -150,44 +349,136 @@ private:
 
       if (range.first != range.second)
       {
-        const auto SESSION_EPS = chrono::microseconds{500000};
-        // should we join this session?
-        const auto hostTime = mClock.micros();
-        const auto curGhost = mCurrent.measurement.xform.hostToGhost(hostTime);
-        const auto newGhost = measurement.xform.hostToGhost(hostTime);
         // update the measurement for the session entry
         range.first->measurement = std::move(measurement);
-        // If session times too close - fall back to session id order
-        const auto ghostDiff = newGhost - curGhost;
-        if (ghostDiff > SESSION_EPS
-            || (std::abs(ghostDiff.count()) < SESSION_EPS.count()
-                 && id < mCurrent.sessionId))
+        // should we join this session?
+        considerSwitch(range.first, measurementTime);
+      }
+    }
+    mCallback.sessionsChanged();
+  }
+
+  // True if the candidate session should be joined rather than the reference one
+  bool isPreferred(const Session& candidate,
+    const Session& reference,
+    const Micros hostTime,
+    const Micros hysteresis) const
+  {
+    const auto SESSION_EPS = std::chrono::microseconds{500000};
+    const auto ghostDiff = candidate.measurement.xform.hostToGhost(hostTime)
+                           - reference.measurement.xform.hostToGhost(hostTime);
+    if (hysteresis != Micros{0})
+    {
+      return ghostDiff > SESSION_EPS + hysteresis;
+    }
+    // If session times too close - fall back to session id order
+    return ghostDiff > SESSION_EPS
+           || (std::abs(ghostDiff.count()) < SESSION_EPS.count()
+                && candidate.sessionId < reference.sessionId);
+  }
+
+  bool isPreferredToCurrent(const Session& session, const Micros hostTime) const
+  {
+    if (mIsObserver && mPeers->uniqueSessionPeerCount(mCurrent.sessionId) == 0)
+    {
+      return true;
+    }
+    return isPreferred(session, mCurrent, hostTime,
+      isRejoin(session, hostTime, switchHoldPeriod()) ? switchHysteresis() : Micros{0});
+  }
+
+  // True if the session was left by the last switch less than the period ago
+  bool isRejoin(const Session& session, const Micros hostTime, const Micros period) const
+  {
+    return mHasSwitched && session.sessionId == mPreviousSessionId
+           && hostTime - mLastSwitchTime < period;
+  }
+
+  void considerSwitch(
+    const typename OtherSessions::iterator session, const Micros measurementTime)
+  {
+    const auto hostTime = mClock.micros();
+    if (!isPreferredToCurrent(*session, hostTime))
+    {
+      return;
+    }
+
+    if (isRejoin(*session, hostTime, minRejoinInterval()))
+    {
+      deferSwitch(mLastSwitchTime + minRejoinInterval() - hostTime);
+      return;
+    }
+
+    // The new session wins, switch over to it
+    auto current = mCurrent;
+    mCurrent = std::move(*session);
+    mOtherSessions.erase(session);
+    mXFormTracker.reset();
+    mXFormTracker.update(measurementTime, mCurrent.measurement.xform);
+    mPreviousSessionId = current.sessionId;
+    mHasSwitched = true;
+    mLastSwitchTime = hostTime;
+    // Put the old current session back into our list of known
+    // sessions so that we won't re-measure it
+    const auto it = std::upper_bound(
+      std::begin(mOtherSessions), std::end(mOtherSessions), current, SessionIdComp{});
+    mOtherSessions.insert(it, std::move(current));
+    // And notify that we have a new session and make sure that
+    // we remeasure it periodically.
+    mCallback(mCurrent);
+    scheduleRemeasurement();
+  }
+
+  // Once the delay has passed, the most preferred of the sessions that have been
+  // measured is considered again with its latest measurement
+  void deferSwitch(const Micros delay)
+  {
+    mCallback.switchDeferred();
+    if (mHasDeferredSwitch)
+    {
+      return;
+    }
+
+    LINK_DEBUG(mIo->log()) << "Deferring session switch by " << delay.count() << "us";
+    mHasDeferredSwitch = true;
+    mSwitchTimer.expires_from_now(delay);
+    mSwitchTimer.async_wait([this](const typename Timer::ErrorCode e) {
+      if (!e)
+      {
+        mHasDeferredSwitch = false;
+        const auto hostTime = mClock.micros();
+        auto best = std::end(mOtherSessions);
+        for (auto it = std::begin(mOtherSessions); it != std::end(mOtherSessions); ++it)
+        {
+          // A measurement in progress decides on its own
+          if (it->measurement.timestamp != Micros{}
+              && (best == std::end(mOtherSessions)
+                   || isPreferred(*it, *best, hostTime, Micros{0})))
+          {
+            best = it;
+          }
+        }
+        if (best != std::end(mOtherSessions))
         {
-          // The new session wins, switch over to it
-          auto current = mCurrent;
-          mCurrent = std::move(*range.first);
-          mOtherSessions.erase(range.first);
-          // Put the old current session back into our list of known
-          // sessions so that we won't re-measure it
-          const auto it = upper_bound(
-            begin(mOtherSessions), end(mOtherSessions), current, SessionIdComp{});
-          mOtherSessions.insert(it, std::move(current));
-          // And notify that we have a new session and make sure that
-          // we remeasure it periodically.
-          mCallback(mCurrent);
-          scheduleRemeasurement();
+          considerSwitch(best, best->measurement.timestamp);
         }
       }
-    }
+    });
   }
 
   void scheduleRemeasurement()
   {
     // set a timer to re-measure the active session after a period
-    mTimer.expires_from_now(std::chrono::microseconds{30000000});
+    mIsRemeasurementDue = false;
+    mTimer.expires_from_now(remeasurementPeriod());
     mTimer.async_wait([this](const typename Timer::ErrorCode e) {
       if (!e)
       {
+        if (mIsRemeasurementSuspended)
+        {
+          mIsRemeasurementDue = true;
+          return;
+        }
         launchSessionMeasurement(mCurrent);
         scheduleRemeasurement();
       }
@@ -198,7 +489,7 @@ private:
   {
     using namespace std;
 
-    debug(mIo->log()) << "Session " << id << " measurement failed.";
+    LINK_DEBUG(mIo->log()) << "Session " << id << " measurement failed.";
 
     // if we failed to measure for our current session, schedule a
     // retry in the future. Otherwise, remove the session from our set
@@ -216,6 +507,7 @@ private:
       {
         mOtherSessions.erase(range.first);
         mPeers->forgetSession(id);
+        mCallback.sessionsChanged();
       }
     }
   }
@@ -225,39 +517,75 @@ private:
     // We use beat origin magnitude to prioritize sessions.
     if (timeline.beatOrigin > session.timeline.beatOrigin)
     {
-      debug(mIo->log()) << "Adopting peer timeline (" << timeline.tempo.bpm() << ", "
-                        << timeline.beatOrigin.floating() << ", "
-                        << timeline.timeOrigin.count() << ")";
+      LINK_DEBUG(mIo->log()) << "Adopting peer timeline (" << timeline.tempo.bpm() << ", "
+                             << timeline.beatOrigin.floating() << ", "
+                             << timeline.timeOrigin.count() << ")";
 
       session.timeline = std::move(timeline);
     }
     else
     {
-      debug(mIo->log()) << "Rejecting peer timeline with beat origin: "
-                        << timeline.beatOrigin.floating()
-                        << ". Current timeline beat origin: "
-                        << session.timeline.beatOrigin.floating();
+      LINK_DEBUG(mIo->log()) << "Rejecting peer timeline with beat origin: "
+                             << timeline.beatOrigin.floating()
+                             << ". Current timeline beat origin: "
+                             << session.timeline.beatOrigin.floating();
     }
   }
 
+  // Results of the measurements of the peers of a session launched together
+  // The quality of a round is the worst one of its measurements
+  struct MeasurementRound
+  {
+    std::size_t numPending;
+    std::vector<double> intercepts;
+    SyncQuality quality;
+    // The highest stratum of the peers that were measured successfully
+    std::uint8_t peerStratum = 0;
+  };
+
   struct MeasurementResultsHandler
   {
-    void operator()(GhostXForm xform) const
+    void operator()(GhostXForm xform, const SyncQuality quality) const
     {
-      Sessions& sessions = mSessions;
-      const SessionId& sessionId = mSessionId;
-      if (xform == GhostXForm{})
+      MeasurementRound& round = *mpRound;
+      if (xform != GhostXForm{})
       {
-        sessions.handleFailedMeasurement(std::move(sessionId));
+        round.intercepts.push_back(static_cast<double>(xform.intercept.count()));
+        round.quality = worstSyncQuality(round.quality, quality);
+        round.peerStratum = (std::max)(round.peerStratum, mPeerStratum);
       }
-      else
+
+      if (--round.numPending == 0)
       {
-        sessions.handleSuccessfulMeasurement(std::move(sessionId), std::move(xform));
+        Sessions& sessions = mSessions;
+        const SessionId& sessionId = mSessionId;
+        if (round.intercepts.empty())
+        {
+          sessions.handleFailedMeasurement(std::move(sessionId));
+        }
+        else
+        {
+          sessions.handleSuccessfulMeasurement(std::move(sessionId),
+            combinedXForm(round.intercepts), round.quality, round.peerStratum);
+        }
       }
     }
 
+    // The median of three or more results is robust against a single outlier
+    static GhostXForm combinedXForm(std::vector<double>& intercepts)
+    {
+      using namespace std;
+      const auto n = intercepts.size();
+      const auto intercept =
+        n > 2 ? median(begin(intercepts), end(intercepts))
+              : (intercepts.front() + intercepts.back()) / 2.;
+      return GhostXForm{1, chrono::microseconds(llround(intercept))};
+    }
+
     Sessions& mSessions;
     SessionId mSessionId;
+    std::shared_ptr<MeasurementRound> mpRound;
+    std::uint8_t mPeerStratum;
   };
 
   struct SessionIdComp
@@ -275,8 +603,21 @@ private:
   Session mCurrent;
   util::Injected<IoContext> mIo;
   Timer mTimer;
+  Timer mSwitchTimer;
   Clock mClock;
-  std::vector<Session> mOtherSessions; // sorted/unique by session id
+  GhostXFormTracker mXFormTracker;
+  OtherSessions mOtherSessions; // sorted/unique by session id
+  std::size_t mMaxOtherSessions;
+  std::size_t mMaxMeasuredOtherSessions;
+  bool mIsObserver;
+  bool mIsRemeasurementSuspended;
+  bool mIsRemeasurementDue;
+  // The session founded by this node, whose id is the id of the node
+  SessionId mFoundedSessionId;
+  bool mHasSwitched;
+  bool mHasDeferredSwitch;
+  SessionId mPreviousSessionId;
+  Micros mLastSwitchTime;
 };
 
 template <typename Peers,
@@ -290,11 +631,14 @@ Sessions<Peers, MeasurePeer, JoinSessionCallback, IoContext, Clock> makeSessions
   MeasurePeer measure,
   JoinSessionCallback join,
   util::Injected<IoContext> io,
-  Clock clock)
+  Clock clock,
+  const std::size_t maxOtherSessions =
+    Sessions<Peers, MeasurePeer, JoinSessionCallback, IoContext, Clock>::
+      kDefaultMaxOtherSessions)
 {
   using namespace std;
   return {std::move(init), std::move(peers), std::move(measure), std::move(join),
-    std::move(io), std::move(clock)};
+    std::move(io), std::move(clock), maxOtherSessions};
 }
 
 } // namespace link
@@ -0,0 +1,243 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/link/Gateway.hpp>
+#include <ableton/platforms/ThreadPolicy.hpp>
+#include <memory>
+
+namespace ableton
+{
+namespace link
+{
+
+// A Gateway that runs either on the io context of its owner or on a shard, an io
+// context of its own, so that the traffic of one interface doesn't delay the
+// handling of the others, e.g. the replies to the pings on them. The interface of
+// a sharded gateway is still used from the io thread of the owner. Calls are
+// posted to the shard and the observations of peers and the results of
+// measurements are posted back, so that the observer and the measurement handlers
+// are only invoked on the io thread of the owner.
+template <typename PeerObserver, typename Clock, typename IoContext>
+class ShardedGateway
+{
+  using IoType = typename util::Injected<IoContext>::type;
+
+  // Only accessed on the io thread of the owner, the observer is reset when the
+  // gateway is closed so that the observations that are still in flight are
+  // dropped
+  struct Target
+  {
+    std::unique_ptr<PeerObserver> pObserver;
+  };
+
+  struct Observer
+  {
+    using GatewayObserverNodeState = typename PeerObserver::GatewayObserverNodeState;
+    using GatewayObserverNodeId = typename PeerObserver::GatewayObserverNodeId;
+
+    template <typename Call>
+    void notify(Call call)
+    {
+      if (!mpOwnerIo)
+      {
+        call(*mpTarget->pObserver);
+        return;
+      }
+      const auto pTarget = mpTarget;
+      mpOwnerIo->async([pTarget, call] {
+        if (pTarget->pObserver)
+        {
+          call(*pTarget->pObserver);
+        }
+      });
+    }
+
+    friend void sawPeer(Observer& observer, const GatewayObserverNodeState& state)
+    {
+      observer.notify([state](PeerObserver& target) { sawPeer(target, state); });
+    }
+
+    friend void peerLeft(Observer& observer, const GatewayObserverNodeId& id)
+    {
+      observer.notify([id](PeerObserver& target) { peerLeft(target, id); });
+    }
+
+    friend void peerTimedOut(Observer& observer, const GatewayObserverNodeId& id)
+    {
+      observer.notify([id](PeerObserver& target) { peerTimedOut(target, id); });
+    }
+
+    std::shared_ptr<Target> mpTarget;
+    // Null if the gateway runs on the io context of the owner
+    IoType* mpOwnerIo;
+  };
+
+  using ShardGateway = Gateway<Observer, Clock, IoType&>;
+
+public:
+  // Runs on the shard if one is given, which is started once the gateway has been
+  // constructed
+  ShardedGateway(util::Injected<IoContext> io,
+    std::unique_ptr<IoType> pShard,
+    asio::ip::address addr,
+    PeerObserver observer,
+    NodeState nodeState,
+    GhostXForm ghostXForm,
+    Clock clock,
+    std::shared_ptr<discovery::GatewayStats> pStats =
+      std::make_shared<discovery::GatewayStats>(),
+    const bool shareResponderSocket = false,
+    const discovery::v1::SessionGroupId groupId = 0,
+    const bool isObserver = false,
+    const std::size_t maxHubs = 0,
+    const std::size_t periodFactor = 1)
+    : mIo(std::move(io))
+    , mpShard(std::move(pShard))
+    , mpTarget(std::make_shared<Target>())
+  {
+    mpTarget->pObserver.reset(new PeerObserver(std::move(observer)));
+    auto& gatewayIo = mpShard ? *mpShard : *mIo;
+    mpGateway = std::make_shared<ShardGateway>(util::injectRef(gatewayIo),
+      std::move(addr),
+      util::injectVal(Observer{mpTarget, mpShard ? &*mIo : nullptr}),
+      std::move(nodeState),
+      std::move(ghostXForm),
+      std::move(clock),
+      std::move(pStats),
+      shareResponderSocket,
+      groupId,
+      isObserver,
+      maxHubs,
+      periodFactor);
+    if (mpShard)
+    {
+      mpShard->start();
+    }
+  }
+
+  ShardedGateway(const ShardedGateway&) = delete;
+  ShardedGateway& operator=(const ShardedGateway&) = delete;
+
+  // Must not be destroyed on the thread of the shard. The shard is stopped before
+  // the gateway is destroyed, so that none of its handlers runs in the meantime.
+  ~ShardedGateway()
+  {
+    if (mpShard)
+    {
+      mpShard->stop();
+    }
+    mpGateway.reset();
+    mpTarget->pObserver.reset();
+  }
+
+  void updateNodeState(std::pair<NodeState, GhostXForm> state,
+    const discovery::StateBroadcast broadcast = discovery::StateBroadcast::Normal)
+  {
+    toGateway([state, broadcast](ShardGateway& gateway) {
+      gateway.updateNodeState(state, broadcast);
+    });
+  }
+
+  void suspend(const bool bSuspend)
+  {
+    toGateway([bSuspend](ShardGateway& gateway) { gateway.suspend(bSuspend); });
+  }
+
+  void enableObserverMode(const bool bEnable)
+  {
+    toGateway([bEnable](ShardGateway& gateway) { gateway.enableObserverMode(bEnable); });
+  }
+
+  void setMaxHubs(const std::size_t maxHubs)
+  {
+    toGateway([maxHubs](ShardGateway& gateway) { gateway.setMaxHubs(maxHubs); });
+  }
+
+  void setPeriodFactor(const std::size_t periodFactor)
+  {
+    toGateway(
+      [periodFactor](ShardGateway& gateway) { gateway.setPeriodFactor(periodFactor); });
+  }
+
+  void setUnicastPeers(std::vector<asio::ip::udp::endpoint> peers)
+  {
+    toGateway([peers](ShardGateway& gateway) { gateway.setUnicastPeers(peers); });
+  }
+
+  void announceTo(const asio::ip::udp::endpoint& to)
+  {
+    toGateway([to](ShardGateway& gateway) { gateway.announceTo(to); });
+  }
+
+  // The handler of a sharded gateway is invoked on the io thread of the owner, unless
+  // the gateway is closed before the measurement is done
+  template <typename Handler>
+  void measurePeer(const PeerState& peer, Handler handler)
+  {
+    if (!mpShard)
+    {
+      mpGateway->measurePeer(peer, std::move(handler));
+      return;
+    }
+    const auto pOwnerIo = &*mIo;
+    toGateway([peer, handler, pOwnerIo](ShardGateway& gateway) {
+      gateway.measurePeer(peer,
+        [handler, pOwnerIo](const GhostXForm xform, const SyncQuality quality) {
+          pOwnerIo->async([handler, xform, quality] { handler(xform, quality); });
+        });
+    });
+  }
+
+  // Only applies to the thread of the shard
+  void setThreadPolicy(const platforms::ThreadPolicy& policy)
+  {
+    if (mpShard)
+    {
+      mpShard->setThreadPolicy(policy);
+    }
+  }
+
+private:
+  template <typename Call>
+  void toGateway(Call call)
+  {
+    if (!mpShard)
+    {
+      call(*mpGateway);
+      return;
+    }
+    const auto pGateway = std::weak_ptr<ShardGateway>{mpGateway};
+    mpShard->async([pGateway, call] {
+      if (const auto pLocked = pGateway.lock())
+      {
+        call(*pLocked);
+      }
+    });
+  }
+
+  util::Injected<IoContext> mIo;
+  std::unique_ptr<IoType> mpShard;
+  std::shared_ptr<Target> mpTarget;
+  std::shared_ptr<ShardGateway> mpGateway;
+};
+
+} // namespace link
+} // namespace ableton
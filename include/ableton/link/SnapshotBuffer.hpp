@@ -0,0 +1,163 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/util/CacheLine.hpp>
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+namespace ableton
+{
+namespace link
+{
+
+// Single writer, multiple reader buffer for values that are too large to be copied
+// on every read. Readers get a reference to the slot of the latest value instead of
+// a copy, and the writer builds the next value in place in a slot that no reader
+// holds. Each of the NumReaders readers has an index and holds at most one slot at
+// a time, so NumReaders + 2 slots are enough for the writer to always find a free
+// one.
+//
+// Reads are lock free but not wait free: a read retries if the slot it found was
+// reused by the writer before the reader could claim it. All operations on a
+// reader index must be made from one thread at a time.
+template <typename T, std::size_t NumReaders>
+struct SnapshotBuffer
+{
+public:
+  static const std::size_t kNumSlots = NumReaders + 2;
+
+  SnapshotBuffer()
+    : SnapshotBuffer(T{})
+  {
+  }
+
+  explicit SnapshotBuffer(const T& initial)
+  {
+    assert(mLatest.is_lock_free());
+    for (auto& slot : mSlots)
+    {
+      slot.value = initial;
+    }
+    for (auto& reader : mReaders)
+    {
+      reader.slot.store(kNoSlot, std::memory_order_relaxed);
+    }
+  }
+
+  SnapshotBuffer(const SnapshotBuffer&) = delete;
+  SnapshotBuffer& operator=(const SnapshotBuffer&) = delete;
+
+  // The reference is valid and its value doesn't change until the reader reads or
+  // releases again
+  const T& read(const std::size_t reader) noexcept
+  {
+    assert(reader < NumReaders);
+    auto& claim = mReaders[reader].slot;
+    auto latest = mLatest.load();
+    for (;;)
+    {
+      claim.store(latest);
+      // The writer only reuses slots that are neither the latest nor claimed, so a
+      // slot that is still the latest after claiming it is safe to read
+      const auto current = mLatest.load();
+      if (current == latest)
+      {
+        return mSlots[latest].value;
+      }
+      latest = current;
+    }
+  }
+
+  // Lets the writer reuse the slot that the reader held
+  void release(const std::size_t reader) noexcept
+  {
+    assert(reader < NumReaders);
+    mReaders[reader].slot.store(kNoSlot, std::memory_order_release);
+  }
+
+  // Must not be called from multiple threads concurrently
+  template <typename U>
+  void write(U&& value)
+  {
+    writeInPlace([&value](T& slot) { slot = std::forward<U>(value); });
+  }
+
+  // Lets fn build the next value in a free slot and then publishes it. The slot
+  // holds an older value, so fn must set all of it. Must not be called from
+  // multiple threads concurrently.
+  template <typename Fn>
+  void writeInPlace(Fn fn)
+  {
+    const auto index = freeSlot();
+    fn(mSlots[index].value);
+    mLatest.store(index);
+  }
+
+private:
+  static const std::uint32_t kNoSlot = UINT32_MAX;
+
+  std::uint32_t freeSlot() const noexcept
+  {
+    const auto latest = mLatest.load(std::memory_order_relaxed);
+    std::array<bool, kNumSlots> isUsed{};
+    isUsed[latest] = true;
+    for (const auto& reader : mReaders)
+    {
+      const auto slot = reader.slot.load();
+      if (slot != kNoSlot)
+      {
+        isUsed[slot] = true;
+      }
+    }
+
+    std::uint32_t index = 0;
+    while (isUsed[index])
+    {
+      ++index;
+    }
+    return index;
+  }
+
+  struct Slot
+  {
+    T value;
+    util::CacheLinePadding padding;
+  };
+
+  struct Reader
+  {
+    std::atomic<std::uint32_t> slot; // The claimed slot or kNoSlot
+    util::CacheLinePadding padding;
+  };
+
+  util::CacheLinePadding mLeadingPadding;
+  std::atomic<std::uint32_t> mLatest{0u}; // Readers and writer
+  util::CacheLinePadding mLatestPadding;
+  std::array<Reader, NumReaders> mReaders;
+  std::array<Slot, kNumSlots> mSlots;
+};
+
+} // namespace link
+} // namespace ableton
@@ -0,0 +1,90 @@
+/* Copyright 2022, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/link/Optional.hpp>
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+
+namespace ableton
+{
+namespace link
+{
+
+// Bounded lock free queue for a single writer and a single reader thread. In
+// contrast to TripleBuffer no intermediate values are dropped as long as the reader
+// keeps up. Writes fail instead of blocking if Capacity values are queued.
+template <typename T, std::size_t Capacity>
+struct SpscRingBuffer
+{
+public:
+  SpscRingBuffer()
+  {
+    assert(mReadIndex.is_lock_free());
+  }
+
+  SpscRingBuffer(const SpscRingBuffer&) = delete;
+  SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+  // Returns false if the buffer is full
+  template <typename U>
+  bool write(U&& value)
+  {
+    const auto writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+    const auto nextIndex = next(writeIndex);
+    if (nextIndex == mReadIndex.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    mValues[writeIndex] = std::forward<U>(value);
+    mWriteIndex.store(nextIndex, std::memory_order_release);
+    return true;
+  }
+
+  Optional<T> read()
+  {
+    const auto readIndex = mReadIndex.load(std::memory_order_relaxed);
+    if (readIndex == mWriteIndex.load(std::memory_order_acquire))
+    {
+      return {};
+    }
+    auto value = Optional<T>(std::move(mValues[readIndex]));
+    mReadIndex.store(next(readIndex), std::memory_order_release);
+    return value;
+  }
+
+private:
+  static constexpr std::size_t next(const std::size_t index)
+  {
+    return (index + 1) % (Capacity + 1);
+  }
+
+  std::atomic<std::size_t> mWriteIndex{0}; // Reader and writer
+  std::atomic<std::size_t> mReadIndex{0};  // Reader and writer
+
+  // One slot more than the capacity to distinguish a full from an empty buffer
+  std::array<T, Capacity + 1> mValues{};
+};
+
+} // namespace link
+} // namespace ableton
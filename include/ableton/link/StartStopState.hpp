@@ -37,6 +37,7 @@ struct StartStopState
 {
   static const std::int32_t key = 'stst';
   static_assert(key == 0x73747374, "Unexpected byte order");
+  static const std::uint8_t compactKey = 3;
 
   using StartStopStateTuple = std::tuple<bool, Beats, std::chrono::microseconds>;
 
@@ -73,16 +74,20 @@ struct StartStopState
     return discovery::toNetworkByteStream(state.asTuple(), std::move(out));
   }
 
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, StartStopState& state)
+  {
+    using discovery::tryDeserialize;
+    return tryDeserialize(begin, end, state.isPlaying)
+           && tryDeserialize(begin, end, state.beats)
+           && tryDeserialize(begin, end, state.timestamp);
+  }
+
   template <typename It>
   static std::pair<StartStopState, It> fromNetworkByteStream(It begin, It end)
   {
-    using namespace std;
-    using namespace discovery;
-    auto result = Deserialize<StartStopStateTuple>::fromNetworkByteStream(
+    return discovery::fromNetworkByteStreamOrThrow<StartStopState>(
       std::move(begin), std::move(end));
-    auto state =
-      StartStopState{get<0>(result.first), get<1>(result.first), get<2>(result.first)};
-    return make_pair(std::move(state), std::move(result.second));
   }
 
   bool isPlaying{false};
@@ -0,0 +1,260 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#pragma once
+
+#include <ableton/discovery/GatewayStats.hpp>
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace ableton
+{
+namespace link
+{
+
+// A snapshot of the counters of a Link instance since it was created
+struct Stats
+{
+  struct Traffic
+  {
+    Traffic()
+      : packetsSent(0)
+      , packetsReceived(0)
+      , parseFailures(0)
+      , sendFailures(0)
+      , handlerTime(0)
+    {
+    }
+
+    std::uint64_t packetsSent;
+    std::uint64_t packetsReceived;
+    std::uint64_t parseFailures;
+    std::uint64_t sendFailures;
+    // Time the io threads spent handling the received packets
+    std::chrono::nanoseconds handlerTime;
+  };
+
+  struct Gateway
+  {
+    asio::ip::address address;
+    Traffic traffic;
+  };
+
+  Stats()
+    : measurementsStarted(0)
+    , measurementsSucceeded(0)
+    , measurementsFailed(0)
+    , sessionJoins(0)
+    , sessionSwitchesDeferred(0)
+    , stateResets(0)
+    , rtCommits(0)
+    , rtCommitsCoalesced(0)
+  {
+  }
+
+  // The traffic of all gateways, including the ones that have been removed
+  Traffic traffic;
+  // The traffic of the currently active gateways
+  std::vector<Gateway> gateways;
+  std::uint64_t measurementsStarted;
+  std::uint64_t measurementsSucceeded;
+  std::uint64_t measurementsFailed;
+  std::uint64_t sessionJoins;
+  // Switches to another session that were held back because they followed the
+  // previous one too closely
+  std::uint64_t sessionSwitchesDeferred;
+  std::uint64_t stateResets;
+  // Client states committed from the audio thread...
+  std::uint64_t rtCommits;
+  // ...and the ones of them that were merged into a later commit before being
+  // applied
+  std::uint64_t rtCommitsCoalesced;
+};
+
+// Collects the counters of a Link instance. Counting is wait-free and may happen
+// on any thread. Taking a snapshot locks a mutex and allocates.
+class StatsCollector
+{
+public:
+  StatsCollector()
+    : mMeasurementsStarted(0)
+    , mMeasurementsSucceeded(0)
+    , mMeasurementsFailed(0)
+    , mSessionJoins(0)
+    , mSessionSwitchesDeferred(0)
+    , mStateResets(0)
+    , mRtCommits(0)
+    , mRtCommitsApplied(0)
+  {
+  }
+
+  StatsCollector(const StatsCollector&) = delete;
+  StatsCollector& operator=(const StatsCollector&) = delete;
+
+  // The counters for a new gateway on the given address
+  std::shared_ptr<discovery::GatewayStats> addGateway(asio::ip::address address)
+  {
+    auto pStats = std::make_shared<discovery::GatewayStats>();
+    std::lock_guard<std::mutex> lock(mGatewaysGuard);
+    retireUnusedGateways();
+    mGateways.emplace_back(std::move(address), pStats);
+    return pStats;
+  }
+
+  void measurementStarted()
+  {
+    increment(mMeasurementsStarted);
+  }
+
+  void measurementFinished(const bool succeeded)
+  {
+    increment(succeeded ? mMeasurementsSucceeded : mMeasurementsFailed);
+  }
+
+  void sessionJoined()
+  {
+    increment(mSessionJoins);
+  }
+
+  void sessionSwitchDeferred()
+  {
+    increment(mSessionSwitchesDeferred);
+  }
+
+  void stateReset()
+  {
+    increment(mStateResets);
+  }
+
+  void rtCommitted()
+  {
+    increment(mRtCommits);
+  }
+
+  void rtCommitApplied()
+  {
+    increment(mRtCommitsApplied);
+  }
+
+  Stats snapshot()
+  {
+    Stats stats;
+    {
+      std::lock_guard<std::mutex> lock(mGatewaysGuard);
+      retireUnusedGateways();
+      stats.traffic = mRetiredTraffic;
+      stats.gateways.reserve(mGateways.size());
+      for (const auto& entry : mGateways)
+      {
+        const auto traffic = read(*entry.second);
+        add(stats.traffic, traffic);
+        stats.gateways.push_back({entry.first, traffic});
+      }
+    }
+    stats.measurementsStarted = read(mMeasurementsStarted);
+    stats.measurementsSucceeded = read(mMeasurementsSucceeded);
+    stats.measurementsFailed = read(mMeasurementsFailed);
+    stats.sessionJoins = read(mSessionJoins);
+    stats.sessionSwitchesDeferred = read(mSessionSwitchesDeferred);
+    stats.stateResets = read(mStateResets);
+    // Read the applied commits first so that they never exceed the commits
+    const auto rtCommitsApplied = read(mRtCommitsApplied);
+    stats.rtCommits = read(mRtCommits);
+    stats.rtCommitsCoalesced =
+      stats.rtCommits > rtCommitsApplied ? stats.rtCommits - rtCommitsApplied : 0;
+    return stats;
+  }
+
+private:
+  using Counter = std::atomic<std::uint64_t>;
+
+  static void increment(Counter& counter)
+  {
+    counter.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static std::uint64_t read(const Counter& counter)
+  {
+    return counter.load(std::memory_order_relaxed);
+  }
+
+  static Stats::Traffic read(const discovery::GatewayStats& gatewayStats)
+  {
+    Stats::Traffic traffic;
+    traffic.packetsSent = read(gatewayStats.packetsSent);
+    traffic.packetsReceived = read(gatewayStats.packetsReceived);
+    traffic.parseFailures = read(gatewayStats.parseFailures);
+    traffic.sendFailures = read(gatewayStats.sendFailures);
+    traffic.handlerTime = std::chrono::nanoseconds{
+      static_cast<std::chrono::nanoseconds::rep>(read(gatewayStats.handlerNanos))};
+    return traffic;
+  }
+
+  static void add(Stats::Traffic& lhs, const Stats::Traffic& rhs)
+  {
+    lhs.packetsSent += rhs.packetsSent;
+    lhs.packetsReceived += rhs.packetsReceived;
+    lhs.parseFailures += rhs.parseFailures;
+    lhs.sendFailures += rhs.sendFailures;
+    lhs.handlerTime += rhs.handlerTime;
+  }
+
+  // Gateways whose counters are only referenced by the collector have been
+  // removed. Their counts are kept in the totals.
+  void retireUnusedGateways()
+  {
+    auto it = mGateways.begin();
+    while (it != mGateways.end())
+    {
+      if (it->second.use_count() == 1)
+      {
+        add(mRetiredTraffic, read(*it->second));
+        it = mGateways.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+
+  Counter mMeasurementsStarted;
+  Counter mMeasurementsSucceeded;
+  Counter mMeasurementsFailed;
+  Counter mSessionJoins;
+  Counter mSessionSwitchesDeferred;
+  Counter mStateResets;
+  Counter mRtCommits;
+  Counter mRtCommitsApplied;
+
+  std::mutex mGatewaysGuard;
+  std::vector<std::pair<asio::ip::address, std::shared_ptr<discovery::GatewayStats>>>
+    mGateways;
+  Stats::Traffic mRetiredTraffic;
+};
+
+} // namespace link
+} // namespace ableton
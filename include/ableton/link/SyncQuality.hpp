@@ -0,0 +1,117 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/link/Median.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace ableton
+{
+namespace link
+{
+
+// The quality of the clock synchronization with a session, as found by the last
+// successful measurement of it
+struct SyncQuality
+{
+  SyncQuality()
+    : roundTripTime(0)
+    , jitter(0)
+    , offsetVariance(0)
+    , measurementTime(0)
+  {
+  }
+
+  bool isMeasured() const
+  {
+    return measurementTime != std::chrono::microseconds{0};
+  }
+
+  // The median round trip time of the pings
+  std::chrono::microseconds roundTripTime;
+  // The mean deviation of the round trip times from their median
+  std::chrono::microseconds jitter;
+  // The variance of the clock offsets that were measured, in square microseconds
+  double offsetVariance;
+  // The host time of the measurement, zero if the session hasn't been measured
+  std::chrono::microseconds measurementTime;
+};
+
+// The quality of a measurement from its offset data points and the round trip
+// times of its pings. Reorders the round trip times.
+inline SyncQuality syncQuality(const std::vector<double>& offsets,
+  std::vector<double>& roundTrips,
+  const std::chrono::microseconds measurementTime)
+{
+  using namespace std;
+
+  auto quality = SyncQuality{};
+  quality.measurementTime = measurementTime;
+
+  if (!roundTrips.empty())
+  {
+    const auto n = roundTrips.size();
+    const auto rtt = n > 2 ? median(roundTrips.begin(), roundTrips.end())
+                           : (roundTrips.front() + roundTrips.back()) / 2.;
+    auto deviation = 0.;
+    for (const auto roundTrip : roundTrips)
+    {
+      deviation += abs(roundTrip - rtt);
+    }
+    quality.roundTripTime = chrono::microseconds{llround(rtt)};
+    quality.jitter =
+      chrono::microseconds{llround(deviation / static_cast<double>(n))};
+  }
+
+  if (offsets.size() > 1)
+  {
+    auto mean = 0.;
+    for (const auto offset : offsets)
+    {
+      mean += offset;
+    }
+    mean /= static_cast<double>(offsets.size());
+    auto variance = 0.;
+    for (const auto offset : offsets)
+    {
+      variance += (offset - mean) * (offset - mean);
+    }
+    quality.offsetVariance = variance / static_cast<double>(offsets.size() - 1);
+  }
+
+  return quality;
+}
+
+// The worse of the two qualities in every respect, as of the later measurement
+inline SyncQuality worstSyncQuality(const SyncQuality& lhs, const SyncQuality& rhs)
+{
+  auto quality = SyncQuality{};
+  quality.roundTripTime = (std::max)(lhs.roundTripTime, rhs.roundTripTime);
+  quality.jitter = (std::max)(lhs.jitter, rhs.jitter);
+  quality.offsetVariance = (std::max)(lhs.offsetVariance, rhs.offsetVariance);
+  quality.measurementTime = (std::max)(lhs.measurementTime, rhs.measurementTime);
+  return quality;
+}
+
+} // namespace link
+} // namespace ableton
@@ -0,0 +1,71 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/discovery/NetworkByteStreamSerializable.hpp>
+#include <cstdint>
+
+namespace ableton
+{
+namespace link
+{
+
+// The number of measurements between a peer and the founder of its session, whose
+// ghost time defines the session. A peer that joined by measuring peers of at most
+// stratum n has stratum n + 1. Errors add up with every measurement, so peers of a
+// low stratum are preferred for measurements. It also serves as a payload entry.
+struct SyncStratum
+{
+  static const std::int32_t key = 'syst';
+  static_assert(key == 0x73797374, "Unexpected byte order");
+  static const std::uint8_t compactKey = 9;
+
+  // The stratum of peers that don't advertise one, except for founders
+  static const std::uint8_t kUnknown = 255;
+
+  // The stratum of a peer that measured peers of at most the given stratum
+  static std::uint8_t above(const std::uint8_t stratum)
+  {
+    return stratum == kUnknown ? stratum : static_cast<std::uint8_t>(stratum + 1);
+  }
+
+  // Model the NetworkByteStreamSerializable concept
+  friend std::uint32_t sizeInByteStream(const SyncStratum& entry)
+  {
+    return discovery::sizeInByteStream(entry.stratum);
+  }
+
+  template <typename It>
+  friend It toNetworkByteStream(const SyncStratum& entry, It out)
+  {
+    return discovery::toNetworkByteStream(entry.stratum, std::move(out));
+  }
+
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, SyncStratum& entry)
+  {
+    return discovery::tryDeserialize(begin, end, entry.stratum);
+  }
+
+  std::uint8_t stratum;
+};
+
+} // namespace link
+} // namespace ableton
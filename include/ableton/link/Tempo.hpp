@@ -32,35 +32,35 @@ struct Tempo
   Tempo() = default;
 
   // Beats per minute
-  explicit Tempo(const double bpm)
+  explicit constexpr Tempo(const double bpm) noexcept
     : mValue(bpm)
   {
   }
 
-  Tempo(const std::chrono::microseconds microsPerBeat)
+  Tempo(const std::chrono::microseconds microsPerBeat) noexcept
     : mValue(60. * 1e6 / static_cast<double>(microsPerBeat.count()))
   {
   }
 
-  double bpm() const
+  constexpr double bpm() const noexcept
   {
     return mValue;
   }
 
-  std::chrono::microseconds microsPerBeat() const
+  std::chrono::microseconds microsPerBeat() const noexcept
   {
     return std::chrono::microseconds{std::llround(60. * 1e6 / bpm())};
   }
 
   // Given the tempo, convert a time to a beat value
-  Beats microsToBeats(const std::chrono::microseconds micros) const
+  Beats microsToBeats(const std::chrono::microseconds micros) const noexcept
   {
     return Beats{
       static_cast<double>(micros.count()) / static_cast<double>(microsPerBeat().count())};
   }
 
   // Given the tempo, convert a beat to a time value
-  std::chrono::microseconds beatsToMicros(const Beats beats) const
+  std::chrono::microseconds beatsToMicros(const Beats beats) const noexcept
   {
     return std::chrono::microseconds{
       std::llround(beats.floating() * static_cast<double>(microsPerBeat().count()))};
@@ -78,41 +78,51 @@ struct Tempo
     return discovery::toNetworkByteStream(tempo.microsPerBeat(), std::move(out));
   }
 
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, Tempo& tempo)
+  {
+    auto microsPerBeat = std::chrono::microseconds{};
+    if (!discovery::tryDeserialize(begin, end, microsPerBeat))
+    {
+      return false;
+    }
+    tempo = Tempo{microsPerBeat};
+    return true;
+  }
+
   template <typename It>
   static std::pair<Tempo, It> fromNetworkByteStream(It begin, It end)
   {
-    auto result =
-      discovery::Deserialize<std::chrono::microseconds>::fromNetworkByteStream(
-        std::move(begin), std::move(end));
-    return std::make_pair(Tempo{std::move(result.first)}, std::move(result.second));
+    return discovery::fromNetworkByteStreamOrThrow<Tempo>(
+      std::move(begin), std::move(end));
   }
 
-  friend bool operator==(const Tempo lhs, const Tempo rhs)
+  friend constexpr bool operator==(const Tempo lhs, const Tempo rhs) noexcept
   {
     return lhs.mValue == rhs.mValue;
   }
 
-  friend bool operator!=(const Tempo lhs, const Tempo rhs)
+  friend constexpr bool operator!=(const Tempo lhs, const Tempo rhs) noexcept
   {
     return lhs.mValue != rhs.mValue;
   }
 
-  friend bool operator<(const Tempo lhs, const Tempo rhs)
+  friend constexpr bool operator<(const Tempo lhs, const Tempo rhs) noexcept
   {
     return lhs.mValue < rhs.mValue;
   }
 
-  friend bool operator>(const Tempo lhs, const Tempo rhs)
+  friend constexpr bool operator>(const Tempo lhs, const Tempo rhs) noexcept
   {
     return lhs.mValue > rhs.mValue;
   }
 
-  friend bool operator<=(const Tempo lhs, const Tempo rhs)
+  friend constexpr bool operator<=(const Tempo lhs, const Tempo rhs) noexcept
   {
     return lhs.mValue <= rhs.mValue;
   }
 
-  friend bool operator>=(const Tempo lhs, const Tempo rhs)
+  friend constexpr bool operator>=(const Tempo lhs, const Tempo rhs) noexcept
   {
     return lhs.mValue >= rhs.mValue;
   }
@@ -0,0 +1,279 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+#pragma once
+
+#include <ableton/discovery/NetworkByteStreamSerializable.hpp>
+#include <ableton/link/Timeline.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+namespace ableton
+{
+namespace link
+{
+
+// The shape of the tempo over the beats of a ramp
+enum class TempoCurve : std::uint8_t
+{
+  // The tempo changes by the same amount on every beat
+  Linear = 0,
+  // The tempo changes by the same factor on every beat
+  Exponential = 1,
+};
+
+// A change of the tempo from the tempo of the timeline to the end tempo over the
+// given number of beats, starting at the origin of the timeline. Times before the
+// ramp are mapped at its start tempo and times after it at its end tempo, such
+// that a ramp is a continuous timeline by itself. The curves can be mapped in both
+// directions analytically, so that every peer computes the same beats from the
+// few values of the ramp. Ramps of zero length take no bytes, see TempoRampEntry
+// for how they are sent.
+struct TempoRamp
+{
+  bool isRamping() const
+  {
+    return length > Beats{INT64_C(0)};
+  }
+
+  Beats endBeat() const
+  {
+    return timeline.beatOrigin + length;
+  }
+
+  std::chrono::microseconds endTime() const
+  {
+    return timeline.timeOrigin
+           + std::chrono::microseconds{std::llround(microsAfterStart(1.))};
+  }
+
+  // The timeline that continues the ramp at its end
+  Timeline endTimeline() const
+  {
+    return {endTempo, endBeat(), endTime()};
+  }
+
+  Beats toBeats(const std::chrono::microseconds time) const
+  {
+    if (time <= timeline.timeOrigin)
+    {
+      return timeline.toBeats(time);
+    }
+    const auto end = endTimeline();
+    if (time >= end.timeOrigin)
+    {
+      return end.toBeats(time);
+    }
+    return timeline.beatOrigin
+           + Beats{length.floating()
+                   * fractionAfterStart(
+                     static_cast<double>((time - timeline.timeOrigin).count()))};
+  }
+
+  std::chrono::microseconds fromBeats(const Beats beats) const
+  {
+    if (!(beats > timeline.beatOrigin))
+    {
+      return timeline.fromBeats(beats);
+    }
+    if (!(beats < endBeat()))
+    {
+      return endTimeline().fromBeats(beats);
+    }
+    const auto fraction = (beats - timeline.beatOrigin).floating() / length.floating();
+    return timeline.timeOrigin
+           + std::chrono::microseconds{std::llround(microsAfterStart(fraction))};
+  }
+
+  Tempo tempoAtTime(const std::chrono::microseconds time) const
+  {
+    if (time <= timeline.timeOrigin)
+    {
+      return timeline.tempo;
+    }
+    if (time >= endTime())
+    {
+      return endTempo;
+    }
+    const auto fraction =
+      fractionAfterStart(static_cast<double>((time - timeline.timeOrigin).count()));
+    const auto v0 = startVelocity();
+    const auto v1 = endVelocity();
+    return Tempo{60. * 1e6
+                 * (curve == TempoCurve::Exponential ? v0 * std::pow(v1 / v0, fraction)
+                                                     : v0 + (v1 - v0) * fraction)};
+  }
+
+  friend bool operator==(const TempoRamp& lhs, const TempoRamp& rhs)
+  {
+    return lhs.timeline == rhs.timeline && lhs.endTempo == rhs.endTempo
+           && lhs.length == rhs.length && lhs.curve == rhs.curve;
+  }
+
+  friend bool operator!=(const TempoRamp& lhs, const TempoRamp& rhs)
+  {
+    return !(lhs == rhs);
+  }
+
+  // Model the NetworkByteStreamSerializable concept
+  friend std::uint32_t sizeInByteStream(const TempoRamp& ramp)
+  {
+    if (!ramp.isRamping())
+    {
+      return 0;
+    }
+    return sizeInByteStream(ramp.timeline) + sizeInByteStream(ramp.endTempo)
+           + sizeInByteStream(ramp.length)
+           + discovery::sizeInByteStream(static_cast<std::uint8_t>(ramp.curve));
+  }
+
+  template <typename It>
+  friend It toNetworkByteStream(const TempoRamp& ramp, It out)
+  {
+    if (!ramp.isRamping())
+    {
+      return out;
+    }
+    return discovery::toNetworkByteStream(static_cast<std::uint8_t>(ramp.curve),
+      toNetworkByteStream(ramp.length,
+        toNetworkByteStream(
+          ramp.endTempo, toNetworkByteStream(ramp.timeline, std::move(out)))));
+  }
+
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, TempoRamp& ramp)
+  {
+    auto curve = std::uint8_t{};
+    if (!Timeline::tryFromNetworkByteStream(begin, end, ramp.timeline)
+        || !Tempo::tryFromNetworkByteStream(begin, end, ramp.endTempo)
+        || !Beats::tryFromNetworkByteStream(begin, end, ramp.length)
+        || !discovery::tryDeserialize(begin, end, curve))
+    {
+      return false;
+    }
+    // Curves that are unknown to this version are mapped linearly
+    ramp.curve = curve == static_cast<std::uint8_t>(TempoCurve::Exponential)
+                   ? TempoCurve::Exponential
+                   : TempoCurve::Linear;
+    return true;
+  }
+
+  Timeline timeline;
+  Tempo endTempo;
+  Beats length;
+  TempoCurve curve;
+
+private:
+  // The curves are computed in beats per microsecond, which like the tempo of a
+  // timeline is derived from the rounded microseconds per beat. Within the ramp
+  // the beat velocity v(x) at the fraction x of its beats is v0 + (v1 - v0) * x
+  // for the linear curve and v0 * (v1 / v0)^x for the exponential one, and the
+  // time is the integral of 1 / v(x) over the beats.
+  double startVelocity() const
+  {
+    return 1. / static_cast<double>(timeline.tempo.microsPerBeat().count());
+  }
+
+  double endVelocity() const
+  {
+    return 1. / static_cast<double>(endTempo.microsPerBeat().count());
+  }
+
+  // The time from the start of the ramp to the given fraction of its beats
+  double microsAfterStart(const double fraction) const
+  {
+    const auto v0 = startVelocity();
+    const auto v1 = endVelocity();
+    const auto beats = length.floating();
+    if (v0 == v1)
+    {
+      return beats * fraction / v0;
+    }
+    if (curve == TempoCurve::Exponential)
+    {
+      const auto k = std::log(v1 / v0);
+      return -beats / (v0 * k) * std::expm1(-k * fraction);
+    }
+    return beats / (v1 - v0) * std::log1p((v1 - v0) * fraction / v0);
+  }
+
+  // The inverse of microsAfterStart
+  double fractionAfterStart(const double micros) const
+  {
+    const auto v0 = startVelocity();
+    const auto v1 = endVelocity();
+    const auto beats = length.floating();
+    if (v0 == v1)
+    {
+      return micros * v0 / beats;
+    }
+    if (curve == TempoCurve::Exponential)
+    {
+      const auto k = std::log(v1 / v0);
+      return -std::log1p(-micros * v0 * k / beats) / k;
+    }
+    return v0 / (v1 - v0) * std::expm1(micros * (v1 - v0) / beats);
+  }
+};
+
+// A timeline that is reached through a tempo ramp. Times and beats before the end
+// of the ramp are mapped by the ramp, all others by the timeline. The beat origin
+// of the timeline stays the reference of the phase, so that the functions of
+// Phase.hpp accept a RampedTimeline like a timeline. It refers to the timeline and
+// the ramp, which must outlive it.
+template <typename T>
+struct RampedTimeline
+{
+  RampedTimeline(const T& tl, const TempoRamp& tempoRamp)
+    : beatOrigin(tl.beatOrigin)
+    , timeline(tl)
+    , ramp(tempoRamp)
+    , isRamping(tempoRamp.isRamping())
+    , endBeat(isRamping ? tempoRamp.endBeat() : Beats{})
+    , endTime(isRamping ? tempoRamp.endTime() : std::chrono::microseconds{})
+  {
+  }
+
+  Beats toBeats(const std::chrono::microseconds time) const
+  {
+    return isRamping && time < endTime ? ramp.toBeats(time) : timeline.toBeats(time);
+  }
+
+  std::chrono::microseconds fromBeats(const Beats beats) const
+  {
+    return isRamping && beats < endBeat ? ramp.fromBeats(beats)
+                                        : timeline.fromBeats(beats);
+  }
+
+  Beats beatOrigin;
+  const T& timeline;
+  const TempoRamp& ramp;
+  bool isRamping;
+  Beats endBeat;
+  std::chrono::microseconds endTime;
+};
+
+template <typename T>
+RampedTimeline<T> rampedTimeline(const T& timeline, const TempoRamp& ramp)
+{
+  return {timeline, ramp};
+}
+
+} // namespace link
+} // namespace ableton
@@ -40,24 +40,25 @@ struct Timeline
 {
   static const std::int32_t key = 'tmln';
   static_assert(key == 0x746d6c6e, "Unexpected byte order");
+  static const std::uint8_t compactKey = 1;
 
-  Beats toBeats(const std::chrono::microseconds time) const
+  Beats toBeats(const std::chrono::microseconds time) const noexcept
   {
     return beatOrigin + tempo.microsToBeats(time - timeOrigin);
   }
 
-  std::chrono::microseconds fromBeats(const Beats beats) const
+  std::chrono::microseconds fromBeats(const Beats beats) const noexcept
   {
     return timeOrigin + tempo.beatsToMicros(beats - beatOrigin);
   }
 
-  friend bool operator==(const Timeline& lhs, const Timeline& rhs)
+  friend constexpr bool operator==(const Timeline& lhs, const Timeline& rhs) noexcept
   {
-    return std::tie(lhs.tempo, lhs.beatOrigin, lhs.timeOrigin)
-           == std::tie(rhs.tempo, rhs.beatOrigin, rhs.timeOrigin);
+    return lhs.tempo == rhs.tempo && lhs.beatOrigin == rhs.beatOrigin
+           && lhs.timeOrigin == rhs.timeOrigin;
   }
 
-  friend bool operator!=(const Timeline& lhs, const Timeline& rhs)
+  friend constexpr bool operator!=(const Timeline& lhs, const Timeline& rhs) noexcept
   {
     return !(lhs == rhs);
   }
@@ -75,18 +76,20 @@ struct Timeline
       std::tie(tl.tempo, tl.beatOrigin, tl.timeOrigin), std::move(out));
   }
 
+  template <typename It>
+  static bool tryFromNetworkByteStream(It& begin, const It end, Timeline& timeline)
+  {
+    using discovery::tryDeserialize;
+    return tryDeserialize(begin, end, timeline.tempo)
+           && tryDeserialize(begin, end, timeline.beatOrigin)
+           && tryDeserialize(begin, end, timeline.timeOrigin);
+  }
+
   template <typename It>
   static std::pair<Timeline, It> fromNetworkByteStream(It begin, It end)
   {
-    using namespace std;
-    using namespace discovery;
-    Timeline timeline;
-    auto result =
-      Deserialize<tuple<Tempo, Beats, chrono::microseconds>>::fromNetworkByteStream(
-        std::move(begin), std::move(end));
-    tie(timeline.tempo, timeline.beatOrigin, timeline.timeOrigin) =
-      std::move(result.first);
-    return make_pair(std::move(timeline), std::move(result.second));
+    return discovery::fromNetworkByteStreamOrThrow<Timeline>(
+      std::move(begin), std::move(end));
   }
 
   Tempo tempo;
@@ -0,0 +1,93 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+#pragma once
+
+#include <ableton/link/Optional.hpp>
+#include <ableton/link/Timeline.hpp>
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+namespace ableton
+{
+namespace link
+{
+
+// The most recent timelines of a client along with the times from which on they
+// were valid. Times before the latest change can thus be mapped with the
+// timeline that was valid at that time, e.g. by an engine that renders audio
+// which is delayed for lookahead. Only the latest Capacity timelines are kept.
+template <std::size_t Capacity>
+class TimelineHistory
+{
+public:
+  TimelineHistory()
+    : mNext(0)
+    , mSize(0)
+  {
+  }
+
+  // The timeline is valid from the given time on. A time before that of the
+  // latest timeline is taken as the time of the latest timeline.
+  void add(const std::chrono::microseconds time, const Timeline timeline)
+  {
+    mEntries[mNext] =
+      Entry{mSize == 0 || time > entry(0).time ? time : entry(0).time, timeline};
+    mNext = (mNext + 1) % Capacity;
+    mSize = mSize < Capacity ? mSize + 1 : Capacity;
+  }
+
+  // The timeline that was valid at the given time if it has been replaced since,
+  // or the oldest one kept if the time is before all of them
+  Optional<Timeline> replacedTimelineAt(const std::chrono::microseconds time) const
+  {
+    if (mSize == 0 || time >= entry(0).time)
+    {
+      return {};
+    }
+    for (std::size_t age = 1; age < mSize; ++age)
+    {
+      if (time >= entry(age).time)
+      {
+        return Optional<Timeline>{entry(age).timeline};
+      }
+    }
+    return Optional<Timeline>{entry(mSize - 1).timeline};
+  }
+
+private:
+  struct Entry
+  {
+    std::chrono::microseconds time;
+    Timeline timeline;
+  };
+
+  // The entry that was added age entries before the latest one
+  const Entry& entry(const std::size_t age) const
+  {
+    return mEntries[(mNext + Capacity - 1 - age) % Capacity];
+  }
+
+  std::array<Entry, Capacity> mEntries;
+  std::size_t mNext;
+  std::size_t mSize;
+};
+
+} // namespace link
+} // namespace ableton
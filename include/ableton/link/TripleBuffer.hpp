@@ -21,6 +21,7 @@
 #pragma once
 
 #include <ableton/link/Optional.hpp>
+#include <ableton/util/CacheLine.hpp>
 
 #include <array>
 #include <atomic>
@@ -43,7 +44,7 @@ public:
   }
 
   explicit TripleBuffer(const T& initial)
-    : mBuffers{{initial, initial, initial}}
+    : mBuffers{{Buffer{initial}, Buffer{initial}, Buffer{initial}}}
   {
     assert(mState.is_lock_free());
   }
@@ -54,14 +55,22 @@ public:
   T read() noexcept
   {
     loadReadBuffer();
-    return mBuffers[mReadIndex];
+    return mBuffers[mReadIndex].value;
+  }
+
+  // Reads without copying. The reference is valid and its value doesn't change until
+  // the reader calls read, readNew or readInPlace again.
+  const T& readInPlace() noexcept
+  {
+    loadReadBuffer();
+    return mBuffers[mReadIndex].value;
   }
 
   Optional<T> readNew()
   {
     if (loadReadBuffer())
     {
-      return Optional<T>(mBuffers[mReadIndex]);
+      return Optional<T>(mBuffers[mReadIndex].value);
     }
     return {};
   }
@@ -69,15 +78,29 @@ public:
   template <typename U>
   void write(U&& value)
   {
-    mBuffers[mWriteIndex] = std::forward<U>(value);
+    mBuffers[mWriteIndex].value = std::forward<U>(value);
+    publishWriteBuffer();
+  }
+
+  // Lets fn build the next value in the buffer of the writer and then publishes it.
+  // The buffer holds an older value, not the one that was written last, so fn must
+  // set all of it.
+  template <typename Fn>
+  void writeInPlace(Fn fn)
+  {
+    fn(mBuffers[mWriteIndex].value);
+    publishWriteBuffer();
+  }
 
+private:
+  void publishWriteBuffer()
+  {
     const auto prevState =
       mState.exchange(makeState(mWriteIndex, true), std::memory_order_acq_rel);
 
     mWriteIndex = backIndex(prevState);
   }
 
-private:
   bool loadReadBuffer()
   {
     auto state = mState.load(std::memory_order_acquire);
@@ -110,11 +133,34 @@ private:
     return (backBufferIndex << 16) | uint32_t(isWrite);
   }
 
+  struct Buffer
+  {
+    Buffer()
+      : value{}
+    {
+    }
+
+    explicit Buffer(const T& initial)
+      : value(initial)
+    {
+    }
+
+    T value;
+    util::CacheLinePadding padding;
+  };
+
+  // The members the reader and the writer use are on cache lines of their own, so
+  // that a write doesn't invalidate the line of a concurrent read. This includes
+  // the three buffers, of which the reader and the writer each own one.
+  util::CacheLinePadding mLeadingPadding;
   std::atomic<BackingState> mState{makeState(1u, false)}; // Reader and writer
-  uint32_t mReadIndex = 0u;                               // Reader only
-  uint32_t mWriteIndex = 2u;                              // Writer only
+  util::CacheLinePadding mStatePadding;
+  uint32_t mReadIndex = 0u; // Reader only
+  util::CacheLinePadding mReadIndexPadding;
+  uint32_t mWriteIndex = 2u; // Writer only
+  util::CacheLinePadding mWriteIndexPadding;
 
-  std::array<T, 3> mBuffers{};
+  std::array<Buffer, 3> mBuffers{};
 };
 
 } // namespace link
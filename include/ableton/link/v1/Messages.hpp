@@ -20,6 +20,7 @@
 #pragma once
 
 #include <ableton/discovery/Payload.hpp>
+#include <ableton/util/Exceptions.hpp>
 #include <array>
 
 namespace ableton
@@ -55,15 +56,16 @@ struct MessageHeader
   }
 
   template <typename It>
-  static std::pair<MessageHeader, It> fromNetworkByteStream(It begin, const It end)
+  static bool tryFromNetworkByteStream(It& begin, const It end, MessageHeader& header)
   {
-    using namespace discovery;
-
-    MessageHeader header;
-    std::tie(header.messageType, begin) =
-      Deserialize<decltype(header.messageType)>::fromNetworkByteStream(begin, end);
+    return discovery::tryDeserialize(begin, end, header.messageType);
+  }
 
-    return std::make_pair(std::move(header), std::move(begin));
+  template <typename It>
+  static std::pair<MessageHeader, It> fromNetworkByteStream(It begin, const It end)
+  {
+    return discovery::fromNetworkByteStreamOrThrow<MessageHeader>(
+      std::move(begin), std::move(end));
   }
 };
 
@@ -92,7 +94,7 @@ It encodeMessage(const MessageType messageType, const Payload& payload, It out)
   }
   else
   {
-    throw range_error("Exceeded maximum message size");
+    LINK_THROW(range_error("Exceeded maximum message size"));
   }
 }
 
@@ -127,8 +129,15 @@ std::pair<MessageHeader, It> parseMessageHeader(It bytesBegin, const It bytesEnd
       && std::equal(
            begin(detail::kProtocolHeader), end(detail::kProtocolHeader), bytesBegin))
   {
-    std::tie(header, bytesBegin) =
-      MessageHeader::fromNetworkByteStream(bytesBegin + protocolHeaderSize, bytesEnd);
+    auto headerEnd = bytesBegin + static_cast<ItDiff>(protocolHeaderSize);
+    if (discovery::tryDeserialize(headerEnd, bytesEnd, header))
+    {
+      bytesBegin = headerEnd;
+    }
+    else
+    {
+      header = {};
+    }
   }
   return std::make_pair(std::move(header), std::move(bytesBegin));
 }
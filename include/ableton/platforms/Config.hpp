@@ -39,6 +39,9 @@
 #elif defined(LINK_PLATFORM_LINUX)
 #include <ableton/platforms/asio/Context.hpp>
 #include <ableton/platforms/linux/Clock.hpp>
+#if defined(LINK_LINUX_TSC_CLOCK)
+#include <ableton/platforms/linux/TscClock.hpp>
+#endif
 #include <ableton/platforms/posix/ScanIpIfAddrs.hpp>
 #include <ableton/platforms/stl/Random.hpp>
 #ifdef __linux__
@@ -65,9 +68,21 @@ using Random = platforms::stl::Random;
 using IoContext = platforms::asio::Context<platforms::windows::ScanIpIfAddrs,
   util::NullLog,
   platforms::windows::ThreadFactory>;
+using SharedIoContext = platforms::asio::Context<platforms::windows::ScanIpIfAddrs,
+  util::NullLog,
+  platforms::windows::ThreadFactory,
+  platforms::asio::DefaultAsioTimer,
+  false,
+  true>;
 #else
 using IoContext =
   platforms::asio::Context<platforms::windows::ScanIpIfAddrs, util::NullLog>;
+using SharedIoContext = platforms::asio::Context<platforms::windows::ScanIpIfAddrs,
+  util::NullLog,
+  platforms::asio::ThreadFactory,
+  platforms::asio::DefaultAsioTimer,
+  false,
+  true>;
 #endif
 
 #elif defined(LINK_PLATFORM_MACOSX)
@@ -75,24 +90,50 @@ using Clock = platforms::darwin::Clock;
 using IoContext = platforms::asio::Context<platforms::posix::ScanIpIfAddrs,
   util::NullLog,
   platforms::darwin::ThreadFactory>;
+using SharedIoContext = platforms::asio::Context<platforms::posix::ScanIpIfAddrs,
+  util::NullLog,
+  platforms::darwin::ThreadFactory,
+  platforms::asio::DefaultAsioTimer,
+  false,
+  true>;
 using Random = platforms::stl::Random;
 
 #elif defined(LINK_PLATFORM_LINUX)
+#if defined(LINK_LINUX_TSC_CLOCK)
+// Reads the counter of the processor instead of calling clock_gettime, which is a
+// system call for CLOCK_MONOTONIC_RAW before kernel 5.3
+using Clock = platforms::linux_::TscClock<platforms::linux_::ClockMonotonicRaw>;
+#else
 using Clock = platforms::linux_::ClockMonotonicRaw;
+#endif
 using Random = platforms::stl::Random;
 #ifdef __linux__
 using IoContext = platforms::asio::Context<platforms::posix::ScanIpIfAddrs,
   util::NullLog,
   platforms::linux_::ThreadFactory>;
+using SharedIoContext = platforms::asio::Context<platforms::posix::ScanIpIfAddrs,
+  util::NullLog,
+  platforms::linux_::ThreadFactory,
+  platforms::asio::DefaultAsioTimer,
+  false,
+  true>;
 #else
 using IoContext =
   platforms::asio::Context<platforms::posix::ScanIpIfAddrs, util::NullLog>;
+using SharedIoContext = platforms::asio::Context<platforms::posix::ScanIpIfAddrs,
+  util::NullLog,
+  platforms::asio::ThreadFactory,
+  platforms::asio::DefaultAsioTimer,
+  false,
+  true>;
 #endif
 
 #elif defined(ESP_PLATFORM)
 using Clock = platforms::esp32::Clock;
 using IoContext =
   platforms::esp32::Context<platforms::esp32::ScanIpIfAddrs, util::NullLog>;
+// All esp32 contexts already share one io task
+using SharedIoContext = IoContext;
 using Random = platforms::esp32::Random;
 #endif
 
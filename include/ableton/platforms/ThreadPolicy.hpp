@@ -0,0 +1,45 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace ableton
+{
+namespace platforms
+{
+
+// How the threads that Link runs its io on are scheduled. The defaults leave the
+// scheduling of the threads as it is.
+struct ThreadPolicy
+{
+  // A real-time priority from 1 to 99, or 0 to keep the current scheduling. On Linux
+  // and other Unix systems the thread is scheduled with SCHED_FIFO at this priority,
+  // limited to the range of the system. On macOS any priority selects the
+  // time-constraint policy. On Windows any priority registers the thread with the
+  // "Pro Audio" task of the multimedia class scheduler service.
+  int realtimePriority = 0;
+  // Bit i allows the thread to run on CPU i, 0 allows all of them. Only supported on
+  // Linux and Windows.
+  std::uint64_t cpuAffinity = 0;
+};
+
+} // namespace platforms
+} // namespace ableton
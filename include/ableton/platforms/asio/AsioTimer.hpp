@@ -21,7 +21,11 @@
 
 #include <ableton/platforms/asio/AsioWrapper.hpp>
 #include <ableton/util/SafeAsyncHandler.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <functional>
+#include <memory>
 
 namespace ableton
 {
@@ -30,27 +34,33 @@ namespace platforms
 namespace asio
 {
 
-// This implementation is based on the boost::asio::system_timer concept.
+// This implementation is based on the boost::asio::basic_waitable_timer concept.
 // Since boost::system_timer doesn't support move semantics, we create a wrapper
 // with a unique_ptr to get a movable type. It also handles an inconvenient
 // aspect of asio timers, which is that you must explicitly guard against the
 // handler firing after cancellation. We handle this by use of the SafeAsyncHandler
 // utility. AsioTimer therefore guarantees that a handler will not be called after
 // the destruction of the timer, or after the timer has been canceled.
+//
+// WaitableTimer determines the clock of the timer. AsioTimer is based on the
+// system clock, SteadyAsioTimer on the monotonic steady clock, which is not
+// affected by adjustments of the wall clock.
 
-class AsioTimer
+template <typename WaitableTimer>
+class BasicAsioTimer
 {
 public:
   using ErrorCode = ::asio::error_code;
-  using TimePoint = std::chrono::system_clock::time_point;
+  using Clock = typename WaitableTimer::clock_type;
+  using TimePoint = typename Clock::time_point;
 
-  AsioTimer(::asio::io_service& io)
-    : mpTimer(new ::asio::system_timer(io))
+  BasicAsioTimer(::asio::io_service& io)
+    : mpTimer(new WaitableTimer(io))
     , mpAsyncHandler(std::make_shared<AsyncHandler>())
   {
   }
 
-  ~AsioTimer()
+  ~BasicAsioTimer()
   {
     // The timer may not be valid anymore if this instance was moved from
     if (mpTimer != nullptr)
@@ -60,18 +70,18 @@ public:
     }
   }
 
-  AsioTimer(const AsioTimer&) = delete;
-  AsioTimer& operator=(const AsioTimer&) = delete;
+  BasicAsioTimer(const BasicAsioTimer&) = delete;
+  BasicAsioTimer& operator=(const BasicAsioTimer&) = delete;
 
   // Enable move construction but not move assignment. Move assignment
   // would get weird - would have to handle outstanding handlers
-  AsioTimer(AsioTimer&& rhs)
+  BasicAsioTimer(BasicAsioTimer&& rhs)
     : mpTimer(std::move(rhs.mpTimer))
     , mpAsyncHandler(std::move(rhs.mpAsyncHandler))
   {
   }
 
-  void expires_at(std::chrono::system_clock::time_point tp)
+  void expires_at(TimePoint tp)
   {
     mpTimer->expires_at(std::move(tp));
   }
@@ -99,7 +109,7 @@ public:
 
   TimePoint now() const
   {
-    return std::chrono::system_clock::now();
+    return Clock::now();
   }
 
 private:
@@ -123,10 +133,74 @@ private:
     std::function<void(const ErrorCode)> mpHandler;
   };
 
-  std::unique_ptr<::asio::system_timer> mpTimer;
+  std::unique_ptr<WaitableTimer> mpTimer;
   std::shared_ptr<AsyncHandler> mpAsyncHandler;
 };
 
+using AsioTimer = BasicAsioTimer<::asio::system_timer>;
+using SteadyAsioTimer = BasicAsioTimer<::asio::steady_timer>;
+
+// A timer that defers its deadlines, so that the timers of all gateways, sessions
+// and measurements on an io thread that expire at about the same time wake the
+// thread once. A deadline is rounded up to the next multiple of its slack on the
+// clock, which is the largest power of two milliseconds that is at most a
+// sixteenth of the delay and at most MaxSlackMs. Slacks being powers of two, the
+// deadlines of timers with different delays still fall onto shared points in
+// time. Deadlines that are less than 16 ms away are kept as they are.
+template <typename WaitableTimer, std::size_t MaxSlackMs>
+class CoalescingAsioTimer : public BasicAsioTimer<WaitableTimer>
+{
+public:
+  using Base = BasicAsioTimer<WaitableTimer>;
+  using typename Base::Clock;
+  using typename Base::TimePoint;
+
+  CoalescingAsioTimer(::asio::io_service& io)
+    : Base(io)
+  {
+  }
+
+  void expires_at(const TimePoint tp)
+  {
+    Base::expires_at(coalescedDeadline(this->now(), tp));
+  }
+
+  template <typename T>
+  void expires_from_now(T duration)
+  {
+    const auto now = this->now();
+    Base::expires_at(coalescedDeadline(now, now + duration));
+  }
+
+  static TimePoint coalescedDeadline(const TimePoint now, const TimePoint deadline)
+  {
+    using namespace std::chrono;
+    using Duration = typename Clock::duration;
+
+    const auto maxSlack =
+      (std::min)(duration_cast<milliseconds>(deadline - now) / 16,
+        milliseconds{MaxSlackMs});
+    if (maxSlack < milliseconds{1})
+    {
+      return deadline;
+    }
+
+    auto slack = milliseconds{1};
+    while (slack * 2 <= maxSlack)
+    {
+      slack *= 2;
+    }
+    const auto period = duration_cast<Duration>(slack);
+    const auto remainder = deadline.time_since_epoch() % period;
+    return remainder == Duration::zero() ? deadline : deadline + (period - remainder);
+  }
+};
+
+// The timer of the contexts by default. Besides the short delays of responses and
+// retries, Link's timers are periodic at hundreds of milliseconds or more, which
+// tolerate deferring them by up to 64 ms.
+using DefaultAsioTimer = CoalescingAsioTimer<::asio::steady_timer, 64>;
+
 } // namespace asio
 } // namespace platforms
 } // namespace ableton
@@ -0,0 +1,449 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <ableton/platforms/asio/Socket.hpp>
+#include <ableton/util/Exceptions.hpp>
+#include <ableton/util/SafeAsyncHandler.hpp>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <functional>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <sys/socket.h>
+#include <type_traits>
+#include <utility>
+
+namespace ableton
+{
+namespace platforms
+{
+namespace asio
+{
+
+// Udp socket with the same interface as Socket that receives and sends
+// datagrams in batches using recvmmsg and sendmmsg. Only available on Linux.
+//
+// When the socket becomes readable, all datagrams that are available (up to
+// BatchSize) are received with a single system call and are then passed to the
+// receive handler one after another. The handler is expected to call receive
+// again to get the next datagram, as with Socket.
+//
+// Datagrams sent from within an io handler are queued and sent with a single
+// system call once the handler has returned. Since sending happens later, the
+// errors of queued datagrams can't be returned by send. They are passed to the
+// send error handler along with the endpoint of the datagram that failed, and the
+// remaining datagrams of the batch are still sent. Pending datagrams are sent
+// before the socket is closed. Datagrams that carry the time at which they are
+// sent, like the measurement pings, must not wait for the end of the handler, so
+// a socket can be set to send right away instead.
+//
+// The kernel timestamps received datagrams (SO_TIMESTAMPNS), so that the time
+// between the reception of a datagram and the invocation of its handler is known
+// while it's being handled.
+//
+// MmsgCallsT provides the static sendmmsg and recvmmsg that the socket calls.
+
+struct MmsgCalls
+{
+  static int sendmmsg(
+    const int fd, mmsghdr* const pHeaders, const unsigned int num, const int flags)
+  {
+    return ::sendmmsg(fd, pHeaders, num, flags);
+  }
+
+  static int recvmmsg(
+    const int fd, mmsghdr* const pHeaders, const unsigned int num, const int flags)
+  {
+    return ::recvmmsg(fd, pHeaders, num, flags, nullptr);
+  }
+};
+
+template <std::size_t MaxPacketSize,
+  std::size_t BatchSize = 16,
+  typename MmsgCallsT = MmsgCalls>
+struct BatchedSocket
+{
+  using SendErrorHandler =
+    std::function<void(const ::asio::ip::udp::endpoint&, const ::asio::error_code&)>;
+
+  BatchedSocket(
+    ::asio::io_service& io, const ::asio::ip::udp protocol = ::asio::ip::udp::v4())
+    : mpImpl(std::make_shared<Impl>(io, protocol))
+  {
+  }
+
+  BatchedSocket(const BatchedSocket&) = delete;
+  BatchedSocket& operator=(const BatchedSocket&) = delete;
+
+  BatchedSocket(BatchedSocket&& rhs)
+    : mpImpl(std::move(rhs.mpImpl))
+  {
+  }
+
+  std::size_t send(const uint8_t* const pData,
+    const size_t numBytes,
+    const ::asio::ip::udp::endpoint& to)
+  {
+    ::asio::error_code ec;
+    const auto numSent = send(pData, numBytes, to, ec);
+    if (ec)
+    {
+      LINK_THROW(::asio::system_error(ec));
+    }
+    return numSent;
+  }
+
+  // Reports an error through ec instead of throwing
+  std::size_t send(const uint8_t* const pData,
+    const size_t numBytes,
+    const ::asio::ip::udp::endpoint& to,
+    ::asio::error_code& ec)
+  {
+    assert(numBytes < MaxPacketSize);
+    return mpImpl->queueSend(pData, numBytes, to, ec);
+  }
+
+  // Send the following datagrams right away instead of queueing them. Their errors
+  // are then returned by send.
+  void setSendsImmediately(const bool bImmediately)
+  {
+    mpImpl->flushSends();
+    mpImpl->mSendsImmediately = bImmediately;
+  }
+
+  // Receives the errors of the queued datagrams that failed to be sent
+  void setSendErrorHandler(SendErrorHandler handler)
+  {
+    mpImpl->mSendErrorHandler = std::move(handler);
+  }
+
+  template <typename Handler>
+  void receive(Handler handler)
+  {
+    mpImpl->mHandler = std::move(handler);
+    mpImpl->mHasHandler = true;
+    mpImpl->receive();
+  }
+
+  ::asio::ip::udp::endpoint endpoint() const
+  {
+    return mpImpl->mSocket.local_endpoint();
+  }
+
+  // The time that passed between the reception of the datagram that is currently
+  // being handled and now. Zero if the kernel didn't provide a timestamp or if no
+  // datagram is being handled.
+  std::chrono::microseconds receiveDelay() const
+  {
+    return mpImpl->receiveDelay();
+  }
+
+  struct Impl : util::EnableAsyncSafe<Impl>
+  {
+    Impl(::asio::io_service& io, const ::asio::ip::udp protocol)
+      : mSocket(openUdpSocket(io, protocol))
+      , mHasHandler(false)
+      , mIsWaiting(false)
+      , mIsDispatching(false)
+      , mNumReceived(0)
+      , mNextMessage(0)
+      , mCurrentReceiveTime{}
+      , mNumQueued(0)
+      , mSendsImmediately(false)
+    {
+      // Timestamps are optional, without them the receive delay is zero
+      const int enable = 1;
+      ::setsockopt(
+        mSocket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+    }
+
+    ~Impl()
+    {
+      flushSends();
+      // Ignore error codes in shutdown and close as the socket may
+      // have already been forcibly closed
+      ::asio::error_code ec;
+      mSocket.shutdown(::asio::ip::udp::socket::shutdown_both, ec);
+      mSocket.close(ec);
+    }
+
+    std::size_t queueSend(const uint8_t* const pData,
+      const size_t numBytes,
+      const ::asio::ip::udp::endpoint& to,
+      ::asio::error_code& ec)
+    {
+      if (mSendsImmediately || !mSocket.is_open())
+      {
+        return mSocket.send_to(::asio::buffer(pData, numBytes), to, 0, ec);
+      }
+
+      if (mNumQueued == BatchSize)
+      {
+        flushSends();
+      }
+      ec = {};
+
+      if (mNumQueued == 0)
+      {
+        std::weak_ptr<Impl> pImpl = this->shared_from_this();
+        ::asio::post(mSocket.get_executor(), [pImpl] {
+          if (auto pSelf = pImpl.lock())
+          {
+            pSelf->flushSends();
+          }
+        });
+      }
+
+      const auto i = mNumQueued++;
+      std::copy(pData, pData + numBytes, begin(mSendBuffers[i]));
+      mSendSizes[i] = numBytes;
+      mReceiverEndpoints[i] = to;
+      return numBytes;
+    }
+
+    void flushSends()
+    {
+      std::array<mmsghdr, BatchSize> headers;
+      std::array<iovec, BatchSize> iovecs;
+      for (std::size_t i = 0; i < mNumQueued; ++i)
+      {
+        iovecs[i].iov_base = mSendBuffers[i].data();
+        iovecs[i].iov_len = mSendSizes[i];
+        headers[i] = {};
+        headers[i].msg_hdr.msg_name = mReceiverEndpoints[i].data();
+        headers[i].msg_hdr.msg_namelen =
+          static_cast<socklen_t>(mReceiverEndpoints[i].size());
+        headers[i].msg_hdr.msg_iov = &iovecs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+      }
+
+      // sendmmsg may send only a part of the datagrams, in which case the
+      // remaining ones are sent with another call. If it fails, the first of them
+      // failed and is dropped, like with a failing send_to.
+      std::array<std::pair<::asio::ip::udp::endpoint, ::asio::error_code>, BatchSize>
+        failures;
+      std::size_t numFailures = 0;
+      std::size_t numSent = 0;
+      while (numSent < mNumQueued)
+      {
+        const auto result = MmsgCallsT::sendmmsg(mSocket.native_handle(),
+          &headers[numSent], static_cast<unsigned int>(mNumQueued - numSent), 0);
+        if (result < 0)
+        {
+          failures[numFailures++] = {mReceiverEndpoints[numSent],
+            ::asio::error_code(errno, ::asio::error::get_system_category())};
+          ++numSent;
+          continue;
+        }
+        numSent += static_cast<std::size_t>(result);
+      }
+      mNumQueued = 0;
+
+      // The handler may send again, which reuses the buffers
+      for (std::size_t i = 0; i < numFailures && mSendErrorHandler; ++i)
+      {
+        mSendErrorHandler(failures[i].first, failures[i].second);
+      }
+    }
+
+    void receive()
+    {
+      if (mIsDispatching)
+      {
+        // The dispatch loop will pass the next datagram to the new handler
+        return;
+      }
+
+      if (mNextMessage < mNumReceived)
+      {
+        // The handler of the previous datagram didn't receive again right
+        // away, so the remaining datagrams of the batch are still pending.
+        // Don't invoke the handler from within receive.
+        std::weak_ptr<Impl> pImpl = this->shared_from_this();
+        ::asio::post(mSocket.get_executor(), [pImpl] {
+          if (auto pSelf = pImpl.lock())
+          {
+            pSelf->dispatch();
+          }
+        });
+        return;
+      }
+
+      wait();
+    }
+
+    void wait()
+    {
+      if (!mIsWaiting)
+      {
+        mIsWaiting = true;
+        mSocket.async_wait(::asio::ip::udp::socket::wait_read,
+          this->asyncSafe());
+      }
+    }
+
+    void operator()(const ::asio::error_code& error)
+    {
+      mIsWaiting = false;
+      if (error)
+      {
+        return;
+      }
+
+      std::array<mmsghdr, BatchSize> headers;
+      std::array<iovec, BatchSize> iovecs;
+      for (std::size_t i = 0; i < BatchSize; ++i)
+      {
+        iovecs[i].iov_base = mReceiveBuffers[i].data();
+        iovecs[i].iov_len = MaxPacketSize;
+        headers[i] = {};
+        headers[i].msg_hdr.msg_name = mSenderEndpoints[i].data();
+        headers[i].msg_hdr.msg_namelen =
+          static_cast<socklen_t>(mSenderEndpoints[i].capacity());
+        headers[i].msg_hdr.msg_iov = &iovecs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+        headers[i].msg_hdr.msg_control = &mControlBuffers[i];
+        headers[i].msg_hdr.msg_controllen = sizeof(ControlBuffer);
+      }
+
+      const auto result = MmsgCallsT::recvmmsg(mSocket.native_handle(),
+        headers.data(), static_cast<unsigned int>(BatchSize), MSG_DONTWAIT);
+      if (result <= 0)
+      {
+        // Nothing available or a transient error such as an icmp error
+        // report, wait for the next datagram
+        if (mHasHandler)
+        {
+          wait();
+        }
+        return;
+      }
+
+      for (std::size_t i = 0; i < static_cast<std::size_t>(result); ++i)
+      {
+        auto& header = headers[i];
+        mSenderEndpoints[i].resize(header.msg_hdr.msg_namelen);
+        // Truncated datagrams are dropped in dispatch
+        mMessageSizes[i] = (header.msg_hdr.msg_flags & MSG_TRUNC)
+                             ? 0
+                             : static_cast<std::size_t>(header.msg_len);
+        mReceiveTimes[i] = receiveTime(header.msg_hdr);
+      }
+      mNumReceived = static_cast<std::size_t>(result);
+      mNextMessage = 0;
+      dispatch();
+    }
+
+    void dispatch()
+    {
+      mIsDispatching = true;
+      while (mHasHandler && mNextMessage < mNumReceived)
+      {
+        const auto i = mNextMessage++;
+        const auto numBytes = mMessageSizes[i];
+        if (numBytes > 0 && numBytes <= MaxPacketSize)
+        {
+          // Handlers must only be called once per call to receive
+          auto handler = std::move(mHandler);
+          mHasHandler = false;
+          const auto bufBegin = begin(mReceiveBuffers[i]);
+          mCurrentReceiveTime = mReceiveTimes[i];
+          handler(
+            mSenderEndpoints[i], bufBegin, bufBegin + static_cast<ptrdiff_t>(numBytes));
+          mCurrentReceiveTime = {};
+        }
+      }
+      mIsDispatching = false;
+
+      if (mHasHandler && mNextMessage == mNumReceived)
+      {
+        wait();
+      }
+    }
+
+    static timespec receiveTime(msghdr& header)
+    {
+      for (auto pCmsg = CMSG_FIRSTHDR(&header); pCmsg != nullptr;
+           pCmsg = CMSG_NXTHDR(&header, pCmsg))
+      {
+        if (pCmsg->cmsg_level == SOL_SOCKET && pCmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+          timespec time;
+          std::copy(CMSG_DATA(pCmsg), CMSG_DATA(pCmsg) + sizeof(time),
+            reinterpret_cast<unsigned char*>(&time));
+          return time;
+        }
+      }
+      return {};
+    }
+
+    std::chrono::microseconds receiveDelay() const
+    {
+      using namespace std::chrono;
+      if (mCurrentReceiveTime.tv_sec == 0 && mCurrentReceiveTime.tv_nsec == 0)
+      {
+        return {};
+      }
+
+      // Kernel timestamps are based on the realtime clock
+      timespec now;
+      ::clock_gettime(CLOCK_REALTIME, &now);
+      const auto delay = duration_cast<microseconds>(
+        seconds{now.tv_sec - mCurrentReceiveTime.tv_sec}
+        + nanoseconds{now.tv_nsec - mCurrentReceiveTime.tv_nsec});
+      return delay > microseconds{0} ? delay : microseconds{0};
+    }
+
+    ::asio::ip::udp::socket mSocket;
+    using Buffer = std::array<uint8_t, MaxPacketSize>;
+    std::array<Buffer, BatchSize> mReceiveBuffers;
+    std::array<::asio::ip::udp::endpoint, BatchSize> mSenderEndpoints;
+    std::array<std::size_t, BatchSize> mMessageSizes;
+    using ByteIt = typename Buffer::const_iterator;
+    std::function<void(const ::asio::ip::udp::endpoint&, ByteIt, ByteIt)> mHandler;
+    bool mHasHandler;
+    bool mIsWaiting;
+    bool mIsDispatching;
+    std::size_t mNumReceived;
+    std::size_t mNextMessage;
+    using ControlBuffer =
+      typename std::aligned_storage<CMSG_SPACE(sizeof(timespec)), alignof(cmsghdr)>::type;
+    std::array<ControlBuffer, BatchSize> mControlBuffers;
+    std::array<timespec, BatchSize> mReceiveTimes;
+    timespec mCurrentReceiveTime;
+    std::array<Buffer, BatchSize> mSendBuffers;
+    std::array<::asio::ip::udp::endpoint, BatchSize> mReceiverEndpoints;
+    std::array<std::size_t, BatchSize> mSendSizes;
+    std::size_t mNumQueued;
+    bool mSendsImmediately;
+    SendErrorHandler mSendErrorHandler;
+  };
+
+  std::shared_ptr<Impl> mpImpl;
+};
+
+} // namespace asio
+} // namespace platforms
+} // namespace ableton
@@ -19,12 +19,40 @@
 
 #pragma once
 
-#include <ableton/discovery/IpV4Interface.hpp>
+#include <ableton/discovery/InterfaceMonitor.hpp>
+#include <ableton/discovery/IpInterface.hpp>
+#include <ableton/discovery/NetworkInterface.hpp>
+#include <ableton/discovery/PacketFilter.hpp>
+#include <ableton/platforms/ThreadPolicy.hpp>
 #include <ableton/platforms/asio/AsioTimer.hpp>
 #include <ableton/platforms/asio/AsioWrapper.hpp>
+#if defined(LINK_PLATFORM_LINUX)
+#include <ableton/platforms/asio/BatchedSocket.hpp>
+#endif
+#if defined(LINK_PLATFORM_UNIX)
+#include <ableton/platforms/asio/EventCallbackDispatcher.hpp>
+#else
 #include <ableton/platforms/asio/LockFreeCallbackDispatcher.hpp>
+#endif
+#include <ableton/platforms/asio/ServiceThread.hpp>
 #include <ableton/platforms/asio/Socket.hpp>
+#include <ableton/platforms/asio/SocketOptions.hpp>
+#include <ableton/util/Exceptions.hpp>
+#include <ableton/util/Trace.hpp>
+#if defined(LINK_PLATFORM_WINDOWS)
+#include <ableton/platforms/windows/InterfaceMonitor.hpp>
+#elif defined(LINK_PLATFORM_MACOSX)
+#include <ableton/platforms/darwin/InterfaceMonitor.hpp>
+#elif defined(LINK_PLATFORM_LINUX) && defined(__linux__)
+#include <ableton/platforms/linux/InterfaceMonitor.hpp>
+#include <ableton/platforms/linux/PacketFilter.hpp>
+#endif
+#include <functional>
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <thread>
+#include <type_traits>
 #include <utility>
 
 namespace ableton
@@ -47,19 +75,124 @@ struct ThreadFactory
 
 } // namespace
 
-template <typename ScanIpIfAddrs, typename LogT, typename ThreadFactoryT = ThreadFactory>
+// The sockets that a context opens by default
+struct DefaultSockets
+{
+#if defined(LINK_PLATFORM_LINUX)
+  // Receives all datagrams that are available at once
+  template <std::size_t BufferSize>
+  using Socket = asio::BatchedSocket<BufferSize>;
+#else
+  template <std::size_t BufferSize>
+  using Socket = asio::Socket<BufferSize>;
+#endif
+};
+
+// TimerT selects the timer type returned by makeTimer. The default uses the
+// monotonic steady clock so that timeouts don't jump with the wall clock, and
+// coalesces the deadlines of the timers within their slack, see
+// CoalescingAsioTimer. SteadyAsioTimer keeps the deadlines exact.
+//
+// With DedicatedResponderThread, the sockets that respond to measurement pings are
+// served by an io_service of their own that runs on a thread with raised priority,
+// so that the replies are not delayed by the handling of other messages. Otherwise
+// the responder context is the context itself.
+//
+// With SharedThread, all contexts of this type run on the same io thread, which
+// exists as long as any of them does. Stopping such a context suspends the shared
+// thread until the context is destroyed, so that its owner can tear down the
+// objects using the context without racing with their handlers. Handlers that
+// were passed to async and are still pending at that point are dropped. Contexts
+// must not be stopped from within a handler of another context of the same type.
+//
+// A context can also run on an io_service that is provided by the application
+// instead of a thread of its own. Stopping and destroying such a context works
+// like with SharedThread. From a handler of that io_service there is nothing to
+// race with, so it's stopped and destroyed without suspending the io_service.
+//
+// TraceT receives the structured events of util/Trace.hpp. The default
+// util::NullTrace compiles them out.
+//
+// SocketOptionsT provides a static options(discovery::TrafficClass) that returns
+// the discovery::SocketOptions of the sockets opened for that traffic class.
+//
+// SocketsT provides the template Socket<BufferSize> of the sockets that the
+// context opens. Like Socket, they must expose their ::asio::ip::udp::socket as
+// mpImpl->mSocket, so that the context can configure and bind it.
+template <typename ScanIpIfAddrs,
+  typename LogT,
+  typename ThreadFactoryT = ThreadFactory,
+  typename TimerT = DefaultAsioTimer,
+  bool DedicatedResponderThread = false,
+  bool SharedThread = false,
+  typename TraceT = util::NullTrace,
+  typename SocketOptionsT = discovery::DefaultSocketOptions,
+  typename SocketsT = DefaultSockets>
 class Context
 {
 public:
-  using Timer = AsioTimer;
+  using Timer = TimerT;
   using Log = LogT;
+  using Trace = TraceT;
+  using ResponderContext = typename std::conditional<DedicatedResponderThread,
+    Context<ScanIpIfAddrs,
+      LogT,
+      ThreadFactoryT,
+      TimerT,
+      false,
+      SharedThread,
+      TraceT,
+      SocketOptionsT,
+      SocketsT>,
+    Context>::type;
+
+#if defined(LINK_PLATFORM_UNIX)
+  // Signals the io thread directly, the fallback period is not needed
+  template <typename Handler, typename Duration>
+  struct LockFreeCallbackDispatcher : EventCallbackDispatcher<Handler>
+  {
+    LockFreeCallbackDispatcher(Handler handler, Duration, Context& context)
+      : EventCallbackDispatcher<Handler>(std::move(handler), *context.mpService)
+    {
+    }
 
+    void setFallbackPeriod(Duration)
+    {
+    }
+  };
+#else
+  // The thread of the dispatcher only passes invocations on to the io thread, so
+  // it's started along with it
   template <typename Handler, typename Duration>
-  using LockFreeCallbackDispatcher =
-    LockFreeCallbackDispatcher<Handler, Duration, ThreadFactoryT>;
+  struct LockFreeCallbackDispatcher
+    : asio::LockFreeCallbackDispatcher<Handler, Duration, ThreadFactoryT>
+  {
+    LockFreeCallbackDispatcher(Handler handler, Duration fallbackPeriod, Context& context)
+      : asio::LockFreeCallbackDispatcher<Handler, Duration, ThreadFactoryT>(
+        std::move(handler), std::move(fallbackPeriod))
+    {
+      context.async([this] { this->start(); });
+    }
+  };
+#endif
 
   template <std::size_t BufferSize>
-  using Socket = asio::Socket<BufferSize>;
+  using Socket = typename SocketsT::template Socket<BufferSize>;
+
+#if defined(LINK_PLATFORM_WINDOWS)
+  using InterfaceMonitor = windows::InterfaceMonitor;
+#elif defined(LINK_PLATFORM_MACOSX)
+  using InterfaceMonitor = darwin::InterfaceMonitor;
+#elif defined(LINK_PLATFORM_LINUX) && defined(__linux__)
+  using InterfaceMonitor = linux_::InterfaceMonitor;
+#else
+  struct InterfaceMonitor : discovery::NullInterfaceMonitor
+  {
+    InterfaceMonitor(::asio::io_service&, std::function<void()>)
+    {
+    }
+  };
+#endif
 
   Context()
     : Context(DefaultHandler{})
@@ -68,108 +201,391 @@ public:
 
   template <typename ExceptionHandler>
   explicit Context(ExceptionHandler exceptHandler)
-    : mpService(new ::asio::io_service())
-    , mpWork(new ::asio::io_service::work(*mpService))
+    : Context(exceptHandler, "Link Main", false)
   {
-    mThread = ThreadFactoryT::makeThread("Link Main",
-      [](::asio::io_service& service, ExceptionHandler handler) {
-        for (;;)
-        {
-          try
-          {
-            service.run();
-            break;
-          }
-          catch (const typename ExceptionHandler::Exception& exception)
-          {
-            handler(exception);
-          }
-        }
-      },
-      std::ref(*mpService), std::move(exceptHandler));
+    if (DedicatedResponderThread)
+    {
+      mpResponderContext.reset(
+        new ResponderContext(std::move(exceptHandler), "Link Responder", true));
+    }
+  }
+
+  // Runs the handlers on the given io_service that is run by the application. The
+  // io_service must not be run by more than one thread at a time and must keep
+  // running until the context is destroyed. As the context doesn't run the
+  // io_service, exceptions that escape a handler are not passed to the exception
+  // handler but propagate out of the function that runs the io_service.
+  template <typename ExceptionHandler>
+  Context(::asio::io_service& service, ExceptionHandler exceptHandler)
+    : mpService(&service)
+    , mExceptionHandlerId(0)
+    , mpLifetime(std::make_shared<Lifetime>())
+    , mErrorHandler(exceptHandler)
+  {
+    if (DedicatedResponderThread)
+    {
+      mpResponderContext.reset(
+        new ResponderContext(std::move(exceptHandler), "Link Responder", true));
+    }
   }
 
   Context(const Context&) = delete;
 
   Context(Context&& rhs)
-    : mpService(std::move(rhs.mpService))
-    , mpWork(std::move(rhs.mpWork))
-    , mThread(std::move(rhs.mThread))
+    : mpServiceThread(std::move(rhs.mpServiceThread))
+    , mpService(rhs.mpService)
+    , mExceptionHandlerId(rhs.mExceptionHandlerId)
+    , mpLifetime(std::move(rhs.mpLifetime))
+    , mErrorHandler(std::move(rhs.mErrorHandler))
+    , mpSuspension(std::move(rhs.mpSuspension))
     , mLog(std::move(rhs.mLog))
+    , mTrace(std::move(rhs.mTrace))
     , mScanIpIfAddrs(std::move(rhs.mScanIpIfAddrs))
+    , mpResponderContext(std::move(rhs.mpResponderContext))
   {
+    rhs.mpService = nullptr;
   }
 
   ~Context()
   {
-    if (mpService && mpWork)
+    if (mpService)
+    {
+      mpLifetime.reset();
+      if (mpServiceThread)
+      {
+        mpServiceThread->removeExceptionHandler(mExceptionHandlerId);
+      }
+      mpSuspension.reset();
+      // Release the io thread before the responder context
+      mpServiceThread.reset();
+    }
+  }
+
+  // Starts the io threads, which don't run until then. Handlers that are posted
+  // before wait for them. A context that runs on an io_service of the application
+  // has no thread of its own to start.
+  void start()
+  {
+    if (mpServiceThread)
+    {
+      mpServiceThread->start();
+    }
+    if (mpResponderContext)
     {
-      mpWork.reset();
-      mThread.join();
+      mpResponderContext->start();
     }
   }
 
   void stop()
   {
-    if (mpService && mpWork)
+    if (mpService && !mpSuspension)
+    {
+      if (!mpServiceThread)
+      {
+        // A handler of the io_service can't wait for the io_service to be suspended
+        if (!runningInThisThread())
+        {
+          mpSuspension.reset(new Suspension(*mpService));
+        }
+      }
+      else if (SharedThread)
+      {
+        mpSuspension.reset(new Suspension(*mpServiceThread));
+      }
+      else
+      {
+        mpServiceThread->stop();
+      }
+    }
+    if (mpResponderContext)
     {
-      mpWork.reset();
-      mpService->stop();
-      mThread.join();
+      mpResponderContext->stop();
     }
   }
 
+  ResponderContext& responderContext()
+  {
+    return responderContext(std::integral_constant<bool, DedicatedResponderThread>{});
+  }
+
+  // Whether the caller is a handler of the context, e.g. of the io_service of the
+  // application
+  bool runningInThisThread() const
+  {
+    return mpService && mpService->get_executor().running_in_this_thread();
+  }
+
+  // A context with an io thread of the given name that takes over a part of the
+  // work of this one, e.g. the gateway of an interface. It has a responder thread
+  // of its own as well if this one has. With SharedThread, the shards of the same
+  // name of all contexts share their threads. Contexts that run on an io_service of
+  // the application make shards with threads of their own.
+  template <typename ExceptionHandler>
+  Context makeShard(ExceptionHandler exceptHandler, const std::string& threadName)
+  {
+    auto shard = Context{exceptHandler, threadName, false};
+    if (DedicatedResponderThread)
+    {
+      shard.mpResponderContext.reset(new ResponderContext(
+        std::move(exceptHandler), threadName + " Responder", true));
+    }
+    return shard;
+  }
 
+  // Sockets are opened for the address family of the given interface address. v6
+  // sockets use the interface of the scope id of the address. Multicast sockets
+  // only carry discovery traffic.
   template <std::size_t BufferSize>
-  Socket<BufferSize> openUnicastSocket(const ::asio::ip::address_v4& addr)
+  Socket<BufferSize> openUnicastSocket(const ::asio::ip::address& addr,
+    const discovery::TrafficClass trafficClass = discovery::TrafficClass::Discovery)
   {
-    auto socket = Socket<BufferSize>{*mpService};
-    socket.mpImpl->mSocket.set_option(
-      ::asio::ip::multicast::enable_loopback(addr.is_loopback()));
-    socket.mpImpl->mSocket.set_option(::asio::ip::multicast::outbound_interface(addr));
-    socket.mpImpl->mSocket.bind(::asio::ip::udp::endpoint{addr, 0});
+    auto socket = Socket<BufferSize>{*mpService, protocol(addr)};
+    auto& udpSocket = socket.mpImpl->mSocket;
+    applySocketOptions(udpSocket, protocol(addr), SocketOptionsT::options(trafficClass));
+    ::asio::error_code ec;
+    setSocketOption(
+      udpSocket, ::asio::ip::multicast::enable_loopback(addr.is_loopback()), ec);
+    if (addr.is_v4())
+    {
+      setSocketOption(
+        udpSocket, ::asio::ip::multicast::outbound_interface(addr.to_v4()), ec);
+    }
+    else
+    {
+      setSocketOption(udpSocket,
+        ::asio::ip::multicast::outbound_interface(
+          static_cast<unsigned int>(addr.to_v6().scope_id())),
+        ec);
+    }
+    bindSocket(udpSocket, ::asio::ip::udp::endpoint{addr, 0}, ec);
+    checkSocketOpened(mLog, udpSocket, addr, ec);
+    configureSends(socket, trafficClass);
     return socket;
   }
 
   template <std::size_t BufferSize>
-  Socket<BufferSize> openMulticastSocket(const ::asio::ip::address_v4& addr)
-  {
-    auto socket = Socket<BufferSize>{*mpService};
-    socket.mpImpl->mSocket.set_option(::asio::ip::udp::socket::reuse_address(true));
-    socket.mpImpl->mSocket.set_option(
-      ::asio::socket_base::broadcast(!addr.is_loopback()));
-    socket.mpImpl->mSocket.set_option(
-      ::asio::ip::multicast::enable_loopback(addr.is_loopback()));
-    socket.mpImpl->mSocket.set_option(::asio::ip::multicast::outbound_interface(addr));
-    socket.mpImpl->mSocket.bind({::asio::ip::address::from_string("0.0.0.0"),
-      discovery::multicastEndpoint().port()});
-    socket.mpImpl->mSocket.set_option(::asio::ip::multicast::join_group(
-      discovery::multicastEndpoint().address().to_v4(), addr));
+  Socket<BufferSize> openMulticastSocket(const ::asio::ip::address& addr)
+  {
+    auto socket = Socket<BufferSize>{*mpService, protocol(addr)};
+    auto& udpSocket = socket.mpImpl->mSocket;
+    applySocketOptions(udpSocket, protocol(addr),
+      SocketOptionsT::options(discovery::TrafficClass::Discovery));
+    // Until the messenger knows its ident, any Link packet may be of interest
+    setPacketFilter(socket, discovery::PacketFilter{});
+    ::asio::error_code ec;
+    setSocketOption(udpSocket, ::asio::ip::udp::socket::reuse_address(true), ec);
+    setSocketOption(
+      udpSocket, ::asio::ip::multicast::enable_loopback(addr.is_loopback()), ec);
+    if (addr.is_v4())
+    {
+      setSocketOption(udpSocket, ::asio::socket_base::broadcast(!addr.is_loopback()), ec);
+      setSocketOption(
+        udpSocket, ::asio::ip::multicast::outbound_interface(addr.to_v4()), ec);
+      bindSocket(udpSocket,
+        {::asio::ip::address_v4::any(), discovery::multicastEndpointV4().port()}, ec);
+      setSocketOption(udpSocket,
+        ::asio::ip::multicast::join_group(
+          discovery::multicastEndpointV4().address().to_v4(), addr.to_v4()),
+        ec);
+    }
+    else
+    {
+      const auto scopeId = addr.to_v6().scope_id();
+      const auto group = discovery::multicastEndpointV6(scopeId);
+      // Without this the socket would also receive the v4 packets to the port
+      setSocketOption(udpSocket, ::asio::ip::v6_only(true), ec);
+      setSocketOption(udpSocket,
+        ::asio::ip::multicast::outbound_interface(static_cast<unsigned int>(scopeId)),
+        ec);
+      bindSocket(udpSocket, {::asio::ip::address_v6::any(), group.port()}, ec);
+      setSocketOption(udpSocket,
+        ::asio::ip::multicast::join_group(group.address().to_v6(), scopeId), ec);
+    }
+    checkSocketOpened(mLog, udpSocket, addr, ec);
+    configureSends(socket, discovery::TrafficClass::Discovery);
     return socket;
   }
 
-  std::vector<::asio::ip::address> scanNetworkInterfaces()
+  // Lets the system drop the packets of a multicast socket that don't pass the
+  // filter, if the socket options ask for it and the platform supports it
+  template <std::size_t BufferSize>
+  void setPacketFilter(Socket<BufferSize>& socket, const discovery::PacketFilter& filter)
+  {
+#if defined(LINK_PLATFORM_LINUX) && defined(__linux__)
+    if (SocketOptionsT::options(discovery::TrafficClass::Discovery).filterPackets)
+    {
+      linux_::attachPacketFilter(socket.mpImpl->mSocket.native_handle(), filter);
+    }
+#else
+    (void)socket;
+    (void)filter;
+#endif
+  }
+
+  std::vector<discovery::NetworkInterface> scanNetworkInterfaces()
   {
     return mScanIpIfAddrs();
   }
 
+  template <typename Handler>
+  InterfaceMonitor makeInterfaceMonitor(Handler handler)
+  {
+    return {*mpService, std::function<void()>(std::move(handler))};
+  }
+
   Timer makeTimer() const
   {
     return {*mpService};
   }
 
+  // Applies the policy to the threads of the context, which for contexts with
+  // SharedThread are also the threads of the other contexts. The thread of an
+  // io_service that is run by the application is left alone.
+  void setThreadPolicy(const ThreadPolicy& policy)
+  {
+    if (mpServiceThread)
+    {
+      mpServiceThread->setPolicy(policy);
+    }
+    setResponderThreadPolicy(
+      policy, std::integral_constant<bool, DedicatedResponderThread>{});
+  }
+
   Log& log()
   {
     return mLog;
   }
 
+  Trace& trace()
+  {
+    return mTrace;
+  }
+
+  // Passes an error to the exception handler of the context if it handles errors of
+  // its type, as if it had been thrown by a handler. This is how errors are reported
+  // without exceptions, see util/Exceptions.hpp, also for contexts that run on an
+  // io_service of the application. Must be called on the io thread.
+  template <typename Error>
+  void handleError(const Error& error)
+  {
+    mErrorHandler(error);
+  }
+
   template <typename Handler>
   void async(Handler handler)
   {
-    mpService->post(std::move(handler));
+    if (SharedThread || !mpServiceThread)
+    {
+      std::weak_ptr<Lifetime> pLifetime = mpLifetime;
+      mpService->post([pLifetime, handler]() mutable {
+        if (pLifetime.lock())
+        {
+          handler();
+        }
+      });
+    }
+    else
+    {
+      mpService->post(std::move(handler));
+    }
   }
 
 private:
+  template <typename,
+    typename,
+    typename,
+    typename,
+    bool,
+    bool,
+    typename,
+    typename,
+    typename>
+  friend class Context;
+
+  using ServiceThreadT = ServiceThread<ThreadFactoryT>;
+  using Suspension = typename ServiceThreadT::Suspension;
+
+  // Only used to track whether the context is alive
+  struct Lifetime
+  {
+  };
+
+  static ::asio::ip::udp protocol(const ::asio::ip::address& addr)
+  {
+    return addr.is_v6() ? ::asio::ip::udp::v6() : ::asio::ip::udp::v4();
+  }
+
+#if defined(LINK_PLATFORM_LINUX)
+  // Timing datagrams carry the host time at which they are sent, so they aren't
+  // queued. The failures of queued datagrams are logged like those of the others.
+  template <std::size_t BufferSize, std::size_t BatchSize, typename MmsgCallsT>
+  void configureSends(asio::BatchedSocket<BufferSize, BatchSize, MmsgCallsT>& socket,
+    const discovery::TrafficClass trafficClass)
+  {
+    socket.setSendsImmediately(trafficClass == discovery::TrafficClass::Timing);
+    auto log = mLog;
+    socket.setSendErrorHandler(
+      [log](const ::asio::ip::udp::endpoint& to, const ::asio::error_code& ec) {
+        LINK_INFO(log) << "Sending to " << to << " failed: " << ec.message();
+      });
+  }
+#endif
+
+  // Other sockets send right away
+  template <typename SocketT>
+  void configureSends(SocketT&, discovery::TrafficClass)
+  {
+  }
+
+  template <typename ExceptionHandler>
+  Context(ExceptionHandler exceptHandler, std::string threadName, bool isHighPriority)
+    : mpServiceThread(SharedThread
+                        ? ServiceThreadT::shared(threadName, isHighPriority)
+                        : std::make_shared<ServiceThreadT>(threadName, isHighPriority))
+    , mpService(&mpServiceThread->service())
+    , mExceptionHandlerId(0)
+    , mpLifetime(std::make_shared<Lifetime>())
+    , mErrorHandler(exceptHandler)
+  {
+#if !defined(LINK_NO_EXCEPTIONS)
+    mExceptionHandlerId = mpServiceThread->addExceptionHandler(
+      [exceptHandler](std::exception_ptr pException) mutable {
+        try
+        {
+          std::rethrow_exception(pException);
+        }
+        catch (const typename ExceptionHandler::Exception& exception)
+        {
+          exceptHandler(exception);
+          return true;
+        }
+        catch (...)
+        {
+          return false;
+        }
+      });
+#endif
+  }
+
+  void setResponderThreadPolicy(const ThreadPolicy& policy, std::true_type)
+  {
+    mpResponderContext->setThreadPolicy(policy);
+  }
+
+  void setResponderThreadPolicy(const ThreadPolicy&, std::false_type)
+  {
+  }
+
+  ResponderContext& responderContext(std::true_type)
+  {
+    return *mpResponderContext;
+  }
+
+  ResponderContext& responderContext(std::false_type)
+  {
+    return *this;
+  }
+
   // Default handler is hidden and defines a hidden exception type
   // that will never be thrown by other code, so it effectively does
   // not catch.
@@ -184,11 +600,16 @@ private:
     }
   };
 
-  std::unique_ptr<::asio::io_service> mpService;
-  std::unique_ptr<::asio::io_service::work> mpWork;
-  std::thread mThread;
+  std::shared_ptr<ServiceThreadT> mpServiceThread; // Null if the service is external
+  ::asio::io_service* mpService;
+  std::uint64_t mExceptionHandlerId;
+  std::shared_ptr<Lifetime> mpLifetime;
+  util::ErrorHandler mErrorHandler;
+  std::unique_ptr<Suspension> mpSuspension;
   Log mLog;
+  Trace mTrace;
   ScanIpIfAddrs mScanIpIfAddrs;
+  std::unique_ptr<ResponderContext> mpResponderContext;
 };
 
 } // namespace asio
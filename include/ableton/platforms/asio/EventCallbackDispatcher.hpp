@@ -0,0 +1,133 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <ableton/util/Exceptions.hpp>
+#include <ableton/util/SafeAsyncHandler.hpp>
+#include <array>
+#include <atomic>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace ableton
+{
+namespace platforms
+{
+namespace asio
+{
+
+// Utility to signal invocation of a callback on the io thread in a lock free manner.
+// In contrast to LockFreeCallbackDispatcher no additional thread is involved and
+// there are no periodic wakeups.
+//
+// The io thread waits for data on a non-blocking pipe. invoke() sets an atomic
+// pending flag and only writes to the pipe if the flag wasn't set already, so
+// invocations that happen before the callback has run are coalesced into a single
+// write.
+
+template <typename Callback>
+class EventCallbackDispatcher
+{
+public:
+  EventCallbackDispatcher(Callback callback, ::asio::io_service& io)
+    : mpImpl(std::make_shared<Impl>(std::move(callback), io))
+  {
+    mpImpl->listen();
+  }
+
+  EventCallbackDispatcher(const EventCallbackDispatcher&) = delete;
+  EventCallbackDispatcher& operator=(const EventCallbackDispatcher&) = delete;
+
+  void invoke()
+  {
+    mpImpl->signal();
+  }
+
+private:
+  struct Impl : util::EnableAsyncSafe<Impl>
+  {
+    Impl(Callback callback, ::asio::io_service& io)
+      : mCallback(std::move(callback))
+      , mPending(false)
+      , mReadDescriptor(io)
+    {
+      int fds[2];
+      if (::pipe(fds) != 0)
+      {
+        LINK_THROW(std::runtime_error("Failed to create callback dispatcher pipe"));
+      }
+      mReadDescriptor.assign(fds[0]);
+      mReadDescriptor.non_blocking(true);
+      mWriteFd = fds[1];
+      ::fcntl(mWriteFd, F_SETFL, ::fcntl(mWriteFd, F_GETFL) | O_NONBLOCK);
+    }
+
+    ~Impl()
+    {
+      ::close(mWriteFd);
+    }
+
+    void listen()
+    {
+      mReadDescriptor.async_read_some(
+        ::asio::buffer(mReadBuffer), this->asyncSafe());
+    }
+
+    void signal()
+    {
+      if (!mPending.exchange(true))
+      {
+        const char byte = 0;
+        if (::write(mWriteFd, &byte, 1) != 1)
+        {
+          // The write can only fail if the pipe is full, in which case the io
+          // thread has not drained it yet and the callback is pending anyway.
+        }
+      }
+    }
+
+    void operator()(const ::asio::error_code& error, std::size_t)
+    {
+      if (!error)
+      {
+        // Reset the flag before invoking the callback so that invocations
+        // during the callback aren't lost
+        mPending = false;
+        mCallback();
+        listen();
+      }
+    }
+
+    Callback mCallback;
+    std::atomic<bool> mPending;
+    ::asio::posix::stream_descriptor mReadDescriptor;
+    int mWriteFd;
+    std::array<char, 16> mReadBuffer;
+  };
+
+  std::shared_ptr<Impl> mpImpl;
+};
+
+} // namespace asio
+} // namespace platforms
+} // namespace ableton
@@ -36,7 +36,8 @@ namespace asio
 // A condition variable is used to notify a waiting thread, but only if the required
 // lock can be acquired immediately. If that fails, we fall back on signaling
 // after a timeout. This gives us a guaranteed minimum signaling rate which is defined
-// by the fallbackPeriod parameter.
+// by the fallbackPeriod parameter. The thread is started on the first call to start,
+// invocations before are passed on once it runs.
 
 template <typename Callback, typename Duration, typename ThreadFactory>
 class LockFreeCallbackDispatcher
@@ -44,9 +45,8 @@ class LockFreeCallbackDispatcher
 public:
   LockFreeCallbackDispatcher(Callback callback, Duration fallbackPeriod)
     : mCallback(std::move(callback))
-    , mFallbackPeriod(std::move(fallbackPeriod))
+    , mFallbackPeriod(fallbackPeriod.count())
     , mRunning(true)
-    , mThread(ThreadFactory::makeThread("Link Dispatcher", [this] { run(); }))
   {
   }
 
@@ -54,7 +54,19 @@ public:
   {
     mRunning = false;
     mCondition.notify_one();
-    mThread.join();
+    if (mThread.joinable())
+    {
+      mThread.join();
+    }
+  }
+
+  // Must not be called concurrently
+  void start()
+  {
+    if (!mThread.joinable())
+    {
+      mThread = ThreadFactory::makeThread("Link Dispatcher", [this] { run(); });
+    }
   }
 
   void invoke()
@@ -62,6 +74,12 @@ public:
     mCondition.notify_one();
   }
 
+  // Thread-safe, takes effect with the next wait
+  void setFallbackPeriod(const Duration fallbackPeriod)
+  {
+    mFallbackPeriod = fallbackPeriod.count();
+  }
+
 private:
   void run()
   {
@@ -69,14 +87,14 @@ private:
     {
       {
         std::unique_lock<std::mutex> lock(mMutex);
-        mCondition.wait_for(lock, mFallbackPeriod);
+        mCondition.wait_for(lock, Duration{mFallbackPeriod.load()});
       }
       mCallback();
     }
   }
 
   Callback mCallback;
-  Duration mFallbackPeriod;
+  std::atomic<typename Duration::rep> mFallbackPeriod;
   std::atomic<bool> mRunning;
   std::mutex mMutex;
   std::condition_variable mCondition;
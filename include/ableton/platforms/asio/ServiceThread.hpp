@@ -0,0 +1,376 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/platforms/ThreadPolicy.hpp>
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#if defined(LINK_PLATFORM_UNIX)
+#include <pthread.h>
+#endif
+#if defined(LINK_PLATFORM_MACOSX)
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#elif defined(LINK_PLATFORM_WINDOWS)
+#include <avrt.h>
+#endif
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ableton
+{
+namespace platforms
+{
+namespace asio
+{
+
+// Raises the priority of the calling thread as far as the system allows without
+// special privileges. Failing to do so is not an error.
+inline void raiseCurrentThreadPriority()
+{
+#if defined(LINK_PLATFORM_WINDOWS)
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#elif defined(LINK_PLATFORM_UNIX)
+  sched_param param{};
+  param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+  pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+}
+
+// Applies the policy to the calling thread. Failing to do so, e.g. for lack of
+// privileges, is not an error.
+inline void applyThreadPolicy(const ThreadPolicy& policy)
+{
+#if defined(LINK_PLATFORM_WINDOWS)
+  if (policy.realtimePriority > 0)
+  {
+    DWORD taskIndex = 0;
+    const auto task = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+    if (task)
+    {
+      AvSetMmThreadPriority(task, AVRT_PRIORITY_HIGH);
+    }
+  }
+  if (policy.cpuAffinity != 0)
+  {
+    SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(policy.cpuAffinity));
+  }
+#elif defined(LINK_PLATFORM_MACOSX)
+  if (policy.realtimePriority > 0)
+  {
+    // The io thread isn't periodic. It asks for half a millisecond of computation
+    // within every millisecond.
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    const auto ticksPerMilli =
+      static_cast<double>(timebase.denom) / static_cast<double>(timebase.numer) * 1e6;
+    thread_time_constraint_policy_data_t constraint;
+    constraint.period = 0;
+    constraint.computation = static_cast<uint32_t>(0.5 * ticksPerMilli);
+    constraint.constraint = static_cast<uint32_t>(ticksPerMilli);
+    constraint.preemptible = true;
+    thread_policy_set(pthread_mach_thread_np(pthread_self()),
+      THREAD_TIME_CONSTRAINT_POLICY, reinterpret_cast<thread_policy_t>(&constraint),
+      THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+  }
+#elif defined(LINK_PLATFORM_UNIX)
+  if (policy.realtimePriority > 0)
+  {
+    sched_param param{};
+    param.sched_priority = (std::min)((std::max)(policy.realtimePriority,
+                                        sched_get_priority_min(SCHED_FIFO)),
+      sched_get_priority_max(SCHED_FIFO));
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+  }
+#if defined(__linux__)
+  if (policy.cpuAffinity != 0)
+  {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (std::size_t cpu = 0; cpu < 64; ++cpu)
+    {
+      if (policy.cpuAffinity & (std::uint64_t{1} << cpu))
+      {
+        CPU_SET(cpu, &cpus);
+      }
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  }
+#endif
+#else
+  (void)policy;
+#endif
+}
+
+// An io_service and the single thread that runs it, which may be shared by several
+// contexts. The thread is started on the first call to start, handlers that are
+// posted before wait for it. An exception that escapes a handler is passed to the
+// exception handlers of all contexts using the thread. If none of them handles it,
+// it is rethrown. Without exceptions, the contexts don't add exception handlers.
+template <typename ThreadFactoryT>
+class ServiceThread
+{
+public:
+  // Returns true if the exception was handled
+  using ExceptionHandler = std::function<bool(std::exception_ptr)>;
+
+  // Blocks the io thread for as long as it exists
+  class Suspension
+  {
+  public:
+    Suspension(::asio::io_service& service)
+    {
+      suspend(service);
+    }
+
+    // A thread that hasn't been started is kept from starting instead
+    Suspension(ServiceThread& thread)
+      : mStartLock(thread.mStartGuard)
+    {
+      if (thread.mThread.joinable())
+      {
+        mStartLock.unlock();
+        suspend(thread.mService);
+      }
+    }
+
+    Suspension(const Suspension&) = delete;
+    Suspension& operator=(const Suspension&) = delete;
+
+    ~Suspension()
+    {
+      if (mpState)
+      {
+        std::lock_guard<std::mutex> lock(mpState->mutex);
+        mpState->isResumed = true;
+        mpState->condition.notify_all();
+      }
+    }
+
+  private:
+    struct State
+    {
+      std::mutex mutex;
+      std::condition_variable condition;
+      bool isSuspended = false;
+      bool isResumed = false;
+    };
+
+    void suspend(::asio::io_service& service)
+    {
+      mpState = std::make_shared<State>();
+      auto pState = mpState;
+      service.post([pState] {
+        std::unique_lock<std::mutex> lock(pState->mutex);
+        pState->isSuspended = true;
+        pState->condition.notify_all();
+        pState->condition.wait(lock, [pState] { return pState->isResumed; });
+      });
+
+      std::unique_lock<std::mutex> lock(mpState->mutex);
+      mpState->condition.wait(lock, [this] { return mpState->isSuspended; });
+    }
+
+    std::shared_ptr<State> mpState;
+    std::unique_lock<std::mutex> mStartLock;
+  };
+
+  ServiceThread(std::string name, const bool isHighPriority)
+    : mService(kConcurrencyHint)
+    , mpWork(new ::asio::io_service::work(mService))
+    , mName(std::move(name))
+    , mIsHighPriority(isHighPriority)
+    , mNextExceptionHandlerId(0)
+  {
+  }
+
+  ServiceThread(const ServiceThread&) = delete;
+  ServiceThread& operator=(const ServiceThread&) = delete;
+
+  ~ServiceThread()
+  {
+    if (mpWork)
+    {
+      mpWork.reset();
+      if (mThread.joinable())
+      {
+        mThread.join();
+      }
+    }
+  }
+
+  // The thread with the given name that is shared by all callers. It's created on
+  // first use and is stopped when the last caller releases it.
+  static std::shared_ptr<ServiceThread> shared(
+    const std::string& name, const bool isHighPriority)
+  {
+    static std::mutex mutex;
+    static std::vector<std::pair<std::string, std::weak_ptr<ServiceThread>>> threads;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : threads)
+    {
+      if (entry.first == name)
+      {
+        auto pThread = entry.second.lock();
+        if (!pThread)
+        {
+          pThread = std::make_shared<ServiceThread>(name, isHighPriority);
+          entry.second = pThread;
+        }
+        return pThread;
+      }
+    }
+    auto pThread = std::make_shared<ServiceThread>(name, isHighPriority);
+    threads.emplace_back(name, pThread);
+    return pThread;
+  }
+
+  ::asio::io_service& service()
+  {
+    return mService;
+  }
+
+  // Does nothing if the thread has been started or stopped before
+  void start()
+  {
+    std::lock_guard<std::mutex> lock(mStartGuard);
+    if (mpWork && !mThread.joinable())
+    {
+      mThread = ThreadFactoryT::makeThread(mName,
+        [](ServiceThread& serviceThread, const bool isHighPriority) {
+          if (isHighPriority)
+          {
+            raiseCurrentThreadPriority();
+          }
+          serviceThread.run();
+        },
+        std::ref(*this), mIsHighPriority);
+    }
+  }
+
+  // Applies the policy to the thread once it has handled what was posted before
+  void setPolicy(const ThreadPolicy& policy)
+  {
+    mService.post([policy] { applyThreadPolicy(policy); });
+  }
+
+  // Must not be called from the io thread
+  void stop()
+  {
+    std::lock_guard<std::mutex> lock(mStartGuard);
+    if (mpWork)
+    {
+      mpWork.reset();
+      mService.stop();
+      if (mThread.joinable())
+      {
+        mThread.join();
+      }
+    }
+  }
+
+  std::uint64_t addExceptionHandler(ExceptionHandler handler)
+  {
+    std::lock_guard<std::mutex> lock(mExceptionHandlerMutex);
+    const auto id = mNextExceptionHandlerId++;
+    mExceptionHandlers.emplace_back(id, std::move(handler));
+    return id;
+  }
+
+  void removeExceptionHandler(const std::uint64_t id)
+  {
+    std::lock_guard<std::mutex> lock(mExceptionHandlerMutex);
+    for (auto it = mExceptionHandlers.begin(); it != mExceptionHandlers.end(); ++it)
+    {
+      if (it->first == id)
+      {
+        mExceptionHandlers.erase(it);
+        return;
+      }
+    }
+  }
+
+private:
+  // The service is only ever run by the thread of this object. Telling asio so lets
+  // it queue the handlers that are posted from that thread, which are most of them,
+  // without taking the lock of the service. The reactor keeps its locks, as
+  // sockets and timers are also set up from the threads of the application.
+  static const int kConcurrencyHint = 1;
+
+  void run()
+  {
+#if defined(LINK_NO_EXCEPTIONS)
+    // Errors are passed to the exception handlers of the contexts directly
+    mService.run();
+#else
+    for (;;)
+    {
+      try
+      {
+        mService.run();
+        break;
+      }
+      catch (...)
+      {
+        if (!handleException(std::current_exception()))
+        {
+          throw;
+        }
+      }
+    }
+#endif
+  }
+
+  bool handleException(const std::exception_ptr pException)
+  {
+    std::lock_guard<std::mutex> lock(mExceptionHandlerMutex);
+    auto isHandled = false;
+    for (auto& entry : mExceptionHandlers)
+    {
+      isHandled = entry.second(pException) || isHandled;
+    }
+    return isHandled;
+  }
+
+  ::asio::io_service mService;
+  std::unique_ptr<::asio::io_service::work> mpWork;
+  std::string mName;
+  bool mIsHighPriority;
+  std::mutex mStartGuard;
+  std::thread mThread;
+  std::mutex mExceptionHandlerMutex;
+  std::vector<std::pair<std::uint64_t, ExceptionHandler>> mExceptionHandlers;
+  std::uint64_t mNextExceptionHandlerId;
+};
+
+} // namespace asio
+} // namespace platforms
+} // namespace ableton
@@ -20,9 +20,11 @@
 #pragma once
 
 #include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <ableton/util/Log.hpp>
 #include <ableton/util/SafeAsyncHandler.hpp>
 #include <array>
 #include <cassert>
+#include <chrono>
 
 namespace ableton
 {
@@ -31,11 +33,74 @@ namespace platforms
 namespace asio
 {
 
+// Opens a socket for the protocol. Without exceptions, a socket that can't be
+// opened stays closed, so that configuring and binding it fail, see Context.
+inline ::asio::ip::udp::socket openUdpSocket(
+  ::asio::io_service& io, const ::asio::ip::udp protocol)
+{
+#if defined(LINK_NO_EXCEPTIONS)
+  auto socket = ::asio::ip::udp::socket{io};
+  ::asio::error_code ec;
+  socket.open(protocol, ec);
+  return socket;
+#else
+  return ::asio::ip::udp::socket{io, protocol};
+#endif
+}
+
+// The functions of a socket that report errors through ec, for opening sockets
+// without exceptions. Once one of them has failed, the following ones are skipped.
+template <typename Option>
+void setSocketOption(
+  ::asio::ip::udp::socket& socket, const Option& option, ::asio::error_code& ec)
+{
+  if (!ec)
+  {
+    socket.set_option(option, ec);
+  }
+}
+
+inline void bindSocket(::asio::ip::udp::socket& socket,
+  const ::asio::ip::udp::endpoint& endpoint,
+  ::asio::error_code& ec)
+{
+  if (!ec)
+  {
+    socket.bind(endpoint, ec);
+  }
+}
+
+// Throws the error of opening a socket on the interface. Without exceptions it's
+// logged and the socket is closed, so that sending with it fails and the gateway is
+// repaired, see UdpMessenger::kMaxSendFailures.
+template <typename Log>
+void checkSocketOpened(Log& log,
+  ::asio::ip::udp::socket& socket,
+  const ::asio::ip::address& addr,
+  const ::asio::error_code& ec)
+{
+  if (!ec)
+  {
+    return;
+  }
+#if defined(LINK_NO_EXCEPTIONS)
+  LINK_WARNING(log) << "opening a socket on interface " << addr
+                    << " failed: " << ec.message();
+  ::asio::error_code ignored;
+  socket.close(ignored);
+#else
+  (void)log;
+  (void)socket;
+  (void)addr;
+  throw ::asio::system_error(ec);
+#endif
+}
+
 template <std::size_t MaxPacketSize>
 struct Socket
 {
-  Socket(::asio::io_service& io)
-    : mpImpl(std::make_shared<Impl>(io))
+  Socket(::asio::io_service& io, const ::asio::ip::udp protocol = ::asio::ip::udp::v4())
+    : mpImpl(std::make_shared<Impl>(io, protocol))
   {
   }
 
@@ -55,6 +120,16 @@ struct Socket
     return mpImpl->mSocket.send_to(::asio::buffer(pData, numBytes), to);
   }
 
+  // Reports an error through ec instead of throwing
+  std::size_t send(const uint8_t* const pData,
+    const size_t numBytes,
+    const ::asio::ip::udp::endpoint& to,
+    ::asio::error_code& ec)
+  {
+    assert(numBytes < MaxPacketSize);
+    return mpImpl->mSocket.send_to(::asio::buffer(pData, numBytes), to, 0, ec);
+  }
+
   template <typename Handler>
   void receive(Handler handler)
   {
@@ -69,10 +144,16 @@ struct Socket
     return mpImpl->mSocket.local_endpoint();
   }
 
+  // Receive timestamps are not supported, see BatchedSocket
+  std::chrono::microseconds receiveDelay() const
+  {
+    return {};
+  }
+
   struct Impl
   {
-    Impl(::asio::io_service& io)
-      : mSocket(io, ::asio::ip::udp::v4())
+    Impl(::asio::io_service& io, const ::asio::ip::udp protocol)
+      : mSocket(openUdpSocket(io, protocol))
     {
     }
 
@@ -0,0 +1,107 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#pragma once
+
+#include <ableton/discovery/SocketOptions.hpp>
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <cstddef>
+
+namespace ableton
+{
+namespace platforms
+{
+namespace asio
+{
+
+// An integer option for setsockopt, for levels and names that asio doesn't
+// provide
+template <int Level, int Name>
+struct IntegerSocketOption
+{
+  template <typename Protocol>
+  int level(const Protocol&) const
+  {
+    return Level;
+  }
+
+  template <typename Protocol>
+  int name(const Protocol&) const
+  {
+    return Name;
+  }
+
+  template <typename Protocol>
+  const int* data(const Protocol&) const
+  {
+    return &value;
+  }
+
+  template <typename Protocol>
+  std::size_t size(const Protocol&) const
+  {
+    return sizeof(value);
+  }
+
+  int value;
+};
+
+// Sets the options on an open socket of the given protocol. Networks and systems
+// that don't support an option are no reason to fail, so errors are ignored.
+inline void applySocketOptions(::asio::ip::udp::socket& socket,
+  const ::asio::ip::udp protocol,
+  const discovery::SocketOptions& options)
+{
+  ::asio::error_code ec;
+  if (options.dscp != 0)
+  {
+    const auto trafficClass = static_cast<int>(options.dscp) << 2;
+    if (protocol == ::asio::ip::udp::v4())
+    {
+      socket.set_option(IntegerSocketOption<IPPROTO_IP, IP_TOS>{trafficClass}, ec);
+    }
+#if defined(IPV6_TCLASS)
+    else
+    {
+      socket.set_option(
+        IntegerSocketOption<IPPROTO_IPV6, IPV6_TCLASS>{trafficClass}, ec);
+    }
+#endif
+  }
+  if (options.receiveBufferSize != 0)
+  {
+    socket.set_option(
+      ::asio::socket_base::receive_buffer_size(options.receiveBufferSize), ec);
+  }
+  if (options.sendBufferSize != 0)
+  {
+    socket.set_option(::asio::socket_base::send_buffer_size(options.sendBufferSize), ec);
+  }
+#if defined(LINK_PLATFORM_LINUX) && defined(__linux__)
+  if (options.priority != 0)
+  {
+    socket.set_option(IntegerSocketOption<SOL_SOCKET, SO_PRIORITY>{options.priority}, ec);
+  }
+#endif
+}
+
+} // namespace asio
+} // namespace platforms
+} // namespace ableton
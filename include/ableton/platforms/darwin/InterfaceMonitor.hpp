@@ -0,0 +1,148 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <ableton/util/SafeAsyncHandler.hpp>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <net/route.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace ableton
+{
+namespace platforms
+{
+namespace darwin
+{
+
+// Reports changes of the network interfaces by listening to the messages of a
+// routing socket. Only messages about interfaces and their addresses are taken
+// into account, changes of the routing tables are ignored. The handler is called
+// on the io thread. If the routing socket can't be opened, the monitor is inactive
+// and the interfaces have to be polled.
+class InterfaceMonitor
+{
+public:
+  InterfaceMonitor(::asio::io_service& io, std::function<void()> handler)
+    : mpImpl(std::make_shared<Impl>(io, std::move(handler)))
+  {
+    if (mpImpl->mDescriptor.is_open())
+    {
+      mpImpl->listen();
+    }
+  }
+
+  InterfaceMonitor(const InterfaceMonitor&) = delete;
+  InterfaceMonitor& operator=(const InterfaceMonitor&) = delete;
+
+  InterfaceMonitor(InterfaceMonitor&& rhs)
+    : mpImpl(std::move(rhs.mpImpl))
+  {
+  }
+
+  bool isActive() const
+  {
+    return mpImpl->mDescriptor.is_open();
+  }
+
+private:
+  struct Impl : util::EnableAsyncSafe<Impl>
+  {
+    Impl(::asio::io_service& io, std::function<void()> handler)
+      : mHandler(std::move(handler))
+      , mDescriptor(io)
+    {
+      const int fd = ::socket(PF_ROUTE, SOCK_RAW, AF_UNSPEC);
+      if (fd < 0)
+      {
+        return;
+      }
+      ::asio::error_code ec;
+      mDescriptor.assign(fd, ec);
+      if (ec)
+      {
+        ::close(fd);
+      }
+    }
+
+    void listen()
+    {
+      mDescriptor.async_read_some(
+        ::asio::buffer(mReadBuffer), this->asyncSafe());
+    }
+
+    void operator()(const ::asio::error_code& error, const std::size_t numBytes)
+    {
+      // Running out of buffer space means that messages were lost, which must be
+      // treated as a change
+      if (error == ::asio::error::no_buffer_space || (!error && isRelevant(numBytes)))
+      {
+        mHandler();
+      }
+      if (!error || error == ::asio::error::no_buffer_space)
+      {
+        listen();
+      }
+    }
+
+    bool isRelevant(const std::size_t numBytes) const
+    {
+      std::size_t offset = 0;
+      while (offset + sizeof(MessageHeader) <= numBytes)
+      {
+        MessageHeader header;
+        std::memcpy(&header, mReadBuffer.data() + offset, sizeof(header));
+        if (header.type == RTM_NEWADDR || header.type == RTM_DELADDR
+            || header.type == RTM_IFINFO)
+        {
+          return true;
+        }
+        if (header.msgLen == 0)
+        {
+          break;
+        }
+        offset += header.msgLen;
+      }
+      return false;
+    }
+
+    // The fields that all routing messages start with
+    struct MessageHeader
+    {
+      unsigned short msgLen;
+      unsigned char version;
+      unsigned char type;
+    };
+
+    std::function<void()> mHandler;
+    ::asio::posix::stream_descriptor mDescriptor;
+    std::array<char, 2048> mReadBuffer;
+  };
+
+  std::shared_ptr<Impl> mpImpl;
+};
+
+} // namespace darwin
+} // namespace platforms
+} // namespace ableton
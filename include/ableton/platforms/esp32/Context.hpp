@@ -19,14 +19,27 @@
 
 #pragma once
 
-#include <ableton/discovery/IpV4Interface.hpp>
+#include <ableton/discovery/InterfaceMonitor.hpp>
+#include <ableton/discovery/IpInterface.hpp>
+#include <ableton/discovery/NetworkInterface.hpp>
+#include <ableton/discovery/PacketFilter.hpp>
+#include <ableton/discovery/SocketOptions.hpp>
+#include <ableton/platforms/ThreadPolicy.hpp>
 #include <ableton/platforms/asio/AsioTimer.hpp>
 #include <ableton/platforms/asio/AsioWrapper.hpp>
 #include <ableton/platforms/asio/Socket.hpp>
 #include <ableton/platforms/esp32/LockFreeCallbackDispatcher.hpp>
+#include <ableton/util/Exceptions.hpp>
+#include <ableton/util/Trace.hpp>
 #include <driver/timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <string>
+
+// The size of the stack of the io task in bytes
+#if !defined(LINK_ESP_TASK_STACK_SIZE)
+#define LINK_ESP_TASK_STACK_SIZE 8192
+#endif
 
 namespace ableton
 {
@@ -35,153 +48,289 @@ namespace platforms
 namespace esp32
 {
 
-template <typename ScanIpIfAddrs, typename LogT>
-class Context
+// Runs the io_service in a task that is woken up every 100 µs by a timer
+// interrupt to handle at most one pending handler.
+class PollingServiceRunner
 {
-  class ServiceRunner
+  static void run(void* userParams)
   {
-
-    static void run(void* userParams)
+    auto runner = static_cast<PollingServiceRunner*>(userParams);
+    for (;;)
     {
-      auto runner = static_cast<ServiceRunner*>(userParams);
-      for (;;)
+#if defined(LINK_NO_EXCEPTIONS)
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      runner->mpService->poll_one();
+#else
+      try
       {
-        try
-        {
-          ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-          runner->mpService->poll_one();
-        }
-        catch (...)
-        {
-        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        runner->mpService->poll_one();
       }
+      catch (...)
+      {
+      }
+#endif
     }
+  }
 
-    static void IRAM_ATTR timerIsr(void* userParam)
+  static void IRAM_ATTR timerIsr(void* userParam)
+  {
+    static BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    timer_group_clr_intr_status_in_isr(TIMER_GROUP_0, TIMER_1);
+    timer_group_enable_alarm_in_isr(TIMER_GROUP_0, TIMER_1);
+
+    vTaskNotifyGiveFromISR(userParam, &xHigherPriorityTaskWoken);
+    if (xHigherPriorityTaskWoken)
     {
-      static BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+      portYIELD_FROM_ISR();
+    }
+  }
+
+public:
+  PollingServiceRunner()
+    : mpService(new ::asio::io_service())
+    , mpWork(new ::asio::io_service::work(*mpService))
+  {
+    xTaskCreatePinnedToCore(run, "link", LINK_ESP_TASK_STACK_SIZE, this,
+      2 | portPRIVILEGE_BIT, &mTaskHandle, LINK_ESP_TASK_CORE_ID);
+
+    timer_config_t config = {.alarm_en = TIMER_ALARM_EN,
+      .counter_en = TIMER_PAUSE,
+      .intr_type = TIMER_INTR_LEVEL,
+      .counter_dir = TIMER_COUNT_UP,
+      .auto_reload = TIMER_AUTORELOAD_EN,
+      .divider = 80};
+
+    timer_init(TIMER_GROUP_0, TIMER_1, &config);
+    timer_set_counter_value(TIMER_GROUP_0, TIMER_1, 0);
+    timer_set_alarm_value(TIMER_GROUP_0, TIMER_1, 100);
+    timer_enable_intr(TIMER_GROUP_0, TIMER_1);
+    timer_isr_register(TIMER_GROUP_0, TIMER_1, &timerIsr, mTaskHandle, 0, nullptr);
+
+    timer_start(TIMER_GROUP_0, TIMER_1);
+  }
+
+  ~PollingServiceRunner()
+  {
+    vTaskDelete(mTaskHandle);
+  }
 
-      timer_group_clr_intr_status_in_isr(TIMER_GROUP_0, TIMER_1);
-      timer_group_enable_alarm_in_isr(TIMER_GROUP_0, TIMER_1);
+  template <typename Handler>
+  void async(Handler handler)
+  {
+    mpService->post(std::move(handler));
+  }
 
-      vTaskNotifyGiveFromISR(userParam, &xHigherPriorityTaskWoken);
-      if (xHigherPriorityTaskWoken)
+  ::asio::io_service& service() const
+  {
+    return *mpService;
+  }
+
+private:
+  TaskHandle_t mTaskHandle;
+  std::unique_ptr<::asio::io_service> mpService;
+  std::unique_ptr<::asio::io_service::work> mpWork;
+};
+
+// Runs the io_service in a task that blocks in the reactor until a socket becomes
+// ready, a timer expires or a handler is posted, so it only wakes up if there is
+// something to do.
+class EventServiceRunner
+{
+  static void run(void* userParams)
+  {
+    auto runner = static_cast<EventServiceRunner*>(userParams);
+    for (;;)
+    {
+#if defined(LINK_NO_EXCEPTIONS)
+      runner->mpService->run();
+#else
+      try
+      {
+        runner->mpService->run();
+      }
+      catch (...)
       {
-        portYIELD_FROM_ISR();
       }
+#endif
     }
+  }
 
-  public:
-    ServiceRunner()
-      : mpService(new ::asio::io_service())
-      , mpWork(new ::asio::io_service::work(*mpService))
-    {
-      xTaskCreatePinnedToCore(run, "link", 8192, this, 2 | portPRIVILEGE_BIT,
-        &mTaskHandle, LINK_ESP_TASK_CORE_ID);
-
-      timer_config_t config = {.alarm_en = TIMER_ALARM_EN,
-        .counter_en = TIMER_PAUSE,
-        .intr_type = TIMER_INTR_LEVEL,
-        .counter_dir = TIMER_COUNT_UP,
-        .auto_reload = TIMER_AUTORELOAD_EN,
-        .divider = 80};
-
-      timer_init(TIMER_GROUP_0, TIMER_1, &config);
-      timer_set_counter_value(TIMER_GROUP_0, TIMER_1, 0);
-      timer_set_alarm_value(TIMER_GROUP_0, TIMER_1, 100);
-      timer_enable_intr(TIMER_GROUP_0, TIMER_1);
-      timer_isr_register(TIMER_GROUP_0, TIMER_1, &timerIsr, mTaskHandle, 0, nullptr);
-
-      timer_start(TIMER_GROUP_0, TIMER_1);
-    }
+public:
+  EventServiceRunner()
+    : mpService(new ::asio::io_service())
+    , mpWork(new ::asio::io_service::work(*mpService))
+  {
+    xTaskCreatePinnedToCore(run, "link", LINK_ESP_TASK_STACK_SIZE, this,
+      2 | portPRIVILEGE_BIT, &mTaskHandle, LINK_ESP_TASK_CORE_ID);
+  }
 
-    ~ServiceRunner()
-    {
-      vTaskDelete(mTaskHandle);
-    }
+  ~EventServiceRunner()
+  {
+    vTaskDelete(mTaskHandle);
+  }
 
-    template <typename Handler>
-    void async(Handler handler)
-    {
-      mpService->post(std::move(handler));
-    }
+  template <typename Handler>
+  void async(Handler handler)
+  {
+    mpService->post(std::move(handler));
+  }
 
-    ::asio::io_service& service() const
-    {
-      return *mpService;
-    }
+  ::asio::io_service& service() const
+  {
+    return *mpService;
+  }
 
-  private:
-    TaskHandle_t mTaskHandle;
-    std::unique_ptr<::asio::io_service> mpService;
-    std::unique_ptr<::asio::io_service::work> mpWork;
-  };
+private:
+  TaskHandle_t mTaskHandle;
+  std::unique_ptr<::asio::io_service> mpService;
+  std::unique_ptr<::asio::io_service::work> mpWork;
+};
 
+// ServiceRunnerT selects how the io_service shared by all contexts is run
+template <typename ScanIpIfAddrs,
+  typename LogT,
+  typename ServiceRunnerT = EventServiceRunner,
+  typename TraceT = util::NullTrace>
+class Context
+{
 public:
-  using Timer = ::ableton::platforms::asio::AsioTimer;
+  using Timer = ::ableton::platforms::asio::DefaultAsioTimer;
   using Log = LogT;
+  using Trace = TraceT;
 
   template <typename Handler, typename Duration>
-  using LockFreeCallbackDispatcher = LockFreeCallbackDispatcher<Handler, Duration>;
+  struct LockFreeCallbackDispatcher : esp32::LockFreeCallbackDispatcher<Handler, Duration>
+  {
+    LockFreeCallbackDispatcher(Handler handler, Duration fallbackPeriod, Context&)
+      : esp32::LockFreeCallbackDispatcher<Handler, Duration>(
+        std::move(handler), std::move(fallbackPeriod))
+    {
+    }
+  };
 
   template <std::size_t BufferSize>
   using Socket = asio::Socket<BufferSize>;
 
+  // Pings are answered on the single io thread
+  using ResponderContext = Context;
+
   Context()
     : Context(DefaultHandler{})
   {
   }
 
+  // Exceptions that escape a handler are dropped by the io task. Errors that are
+  // passed to handleError reach the exception handler.
   template <typename ExceptionHandler>
   explicit Context(ExceptionHandler exceptHandler)
+    : mErrorHandler(std::move(exceptHandler))
   {
   }
 
   Context(const Context&) = delete;
 
   Context(Context&& rhs)
-    : mLog(std::move(rhs.mLog))
+    : mErrorHandler(std::move(rhs.mErrorHandler))
+    , mLog(std::move(rhs.mLog))
+    , mTrace(std::move(rhs.mTrace))
     , mScanIpIfAddrs(std::move(rhs.mScanIpIfAddrs))
   {
   }
 
+  // The io task is shared by all contexts and runs from the first one on
+  void start()
+  {
+  }
+
   void stop()
   {
   }
 
+  bool runningInThisThread() const
+  {
+    return serviceRunner().service().get_executor().running_in_this_thread();
+  }
+
+  // The io task is shared by all contexts and its priority is set when it's created
+  void setThreadPolicy(const ThreadPolicy&)
+  {
+  }
+
+  ResponderContext& responderContext()
+  {
+    return *this;
+  }
+
+  // Shards run on the single io task as well
+  template <typename ExceptionHandler>
+  Context makeShard(ExceptionHandler exceptHandler, const std::string&)
+  {
+    return Context{std::move(exceptHandler)};
+  }
+
+  // Only v4 interfaces are scanned on this platform. The socket options are left to
+  // the defaults of lwIP.
   template <std::size_t BufferSize>
-  Socket<BufferSize> openUnicastSocket(const ::asio::ip::address_v4& addr)
+  Socket<BufferSize> openUnicastSocket(const ::asio::ip::address& addr,
+    discovery::TrafficClass = discovery::TrafficClass::Discovery)
   {
     auto socket = Socket<BufferSize>{serviceRunner().service()};
-    socket.mpImpl->mSocket.set_option(
-      ::asio::ip::multicast::enable_loopback(addr.is_loopback()));
-    socket.mpImpl->mSocket.set_option(::asio::ip::multicast::outbound_interface(addr));
-    socket.mpImpl->mSocket.bind(::asio::ip::udp::endpoint{addr, 0});
+    auto& udpSocket = socket.mpImpl->mSocket;
+    ::asio::error_code ec;
+    asio::setSocketOption(
+      udpSocket, ::asio::ip::multicast::enable_loopback(addr.is_loopback()), ec);
+    asio::setSocketOption(
+      udpSocket, ::asio::ip::multicast::outbound_interface(addr.to_v4()), ec);
+    asio::bindSocket(udpSocket, ::asio::ip::udp::endpoint{addr, 0}, ec);
+    asio::checkSocketOpened(mLog, udpSocket, addr, ec);
     return socket;
   }
 
   template <std::size_t BufferSize>
-  Socket<BufferSize> openMulticastSocket(const ::asio::ip::address_v4& addr)
+  Socket<BufferSize> openMulticastSocket(const ::asio::ip::address& addr)
   {
     auto socket = Socket<BufferSize>{serviceRunner().service()};
-    socket.mpImpl->mSocket.set_option(::asio::ip::udp::socket::reuse_address(true));
-    socket.mpImpl->mSocket.set_option(
-      ::asio::socket_base::broadcast(!addr.is_loopback()));
-    socket.mpImpl->mSocket.set_option(
-      ::asio::ip::multicast::enable_loopback(addr.is_loopback()));
-    socket.mpImpl->mSocket.set_option(::asio::ip::multicast::outbound_interface(addr));
-    socket.mpImpl->mSocket.bind({::asio::ip::address::from_string("0.0.0.0"),
-      discovery::multicastEndpoint().port()});
-    socket.mpImpl->mSocket.set_option(::asio::ip::multicast::join_group(
-      discovery::multicastEndpoint().address().to_v4(), addr));
+    auto& udpSocket = socket.mpImpl->mSocket;
+    ::asio::error_code ec;
+    asio::setSocketOption(udpSocket, ::asio::ip::udp::socket::reuse_address(true), ec);
+    asio::setSocketOption(
+      udpSocket, ::asio::socket_base::broadcast(!addr.is_loopback()), ec);
+    asio::setSocketOption(
+      udpSocket, ::asio::ip::multicast::enable_loopback(addr.is_loopback()), ec);
+    asio::setSocketOption(
+      udpSocket, ::asio::ip::multicast::outbound_interface(addr.to_v4()), ec);
+    asio::bindSocket(udpSocket,
+      {::asio::ip::address_v4::any(), discovery::multicastEndpointV4().port()}, ec);
+    asio::setSocketOption(udpSocket,
+      ::asio::ip::multicast::join_group(
+        discovery::multicastEndpointV4().address().to_v4(), addr.to_v4()),
+      ec);
+    asio::checkSocketOpened(mLog, udpSocket, addr, ec);
     return socket;
   }
 
-  std::vector<::asio::ip::address> scanNetworkInterfaces()
+  // lwIP has no socket filters, the messenger drops the packets itself
+  template <std::size_t BufferSize>
+  void setPacketFilter(Socket<BufferSize>&, const discovery::PacketFilter&)
+  {
+  }
+
+  std::vector<discovery::NetworkInterface> scanNetworkInterfaces()
   {
     return mScanIpIfAddrs();
   }
 
+  // lwIP doesn't report interface changes, so the interfaces are polled
+  using InterfaceMonitor = discovery::NullInterfaceMonitor;
+
+  template <typename Handler>
+  InterfaceMonitor makeInterfaceMonitor(Handler)
+  {
+    return {};
+  }
+
   Timer makeTimer() const
   {
     return {serviceRunner().service()};
@@ -192,6 +341,19 @@ public:
     return mLog;
   }
 
+  Trace& trace()
+  {
+    return mTrace;
+  }
+
+  // Passes an error to the exception handler if it handles errors of its type, see
+  // util/Exceptions.hpp
+  template <typename Error>
+  void handleError(const Error& error)
+  {
+    mErrorHandler(error);
+  }
+
   template <typename Handler>
   void async(Handler handler)
   {
@@ -213,13 +375,15 @@ private:
     }
   };
 
-  static ServiceRunner& serviceRunner()
+  static ServiceRunnerT& serviceRunner()
   {
-    static ServiceRunner runner;
+    static ServiceRunnerT runner;
     return runner;
   }
 
+  util::ErrorHandler mErrorHandler;
   Log mLog;
+  Trace mTrace;
   ScanIpIfAddrs mScanIpIfAddrs;
 };
 
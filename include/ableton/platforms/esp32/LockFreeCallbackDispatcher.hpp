@@ -44,7 +44,7 @@ class LockFreeCallbackDispatcher
 public:
   LockFreeCallbackDispatcher(Callback callback, Duration fallbackPeriod)
     : mCallback(std::move(callback))
-    , mFallbackPeriod(std::move(fallbackPeriod))
+    , mFallbackPeriod(fallbackPeriod.count())
     , mRunning(true)
   {
     xTaskCreate(run, "link", 4096, this, tskIDLE_PRIORITY, &mTaskHandle);
@@ -66,6 +66,12 @@ public:
     }
   }
 
+  // Thread-safe, takes effect with the next wait
+  void setFallbackPeriod(const Duration fallbackPeriod)
+  {
+    mFallbackPeriod = fallbackPeriod.count();
+  }
+
 private:
   static void run(void* userData)
   {
@@ -74,7 +80,8 @@ private:
     {
       {
         std::unique_lock<std::mutex> lock(dispatcher->mMutex);
-        dispatcher->mCondition.wait_for(lock, dispatcher->mFallbackPeriod);
+        dispatcher->mCondition.wait_for(
+          lock, Duration{dispatcher->mFallbackPeriod.load()});
       }
       dispatcher->mCallback();
       vTaskDelay(1);
@@ -82,7 +89,7 @@ private:
   }
 
   Callback mCallback;
-  Duration mFallbackPeriod;
+  std::atomic<typename Duration::rep> mFallbackPeriod;
   std::atomic<bool> mRunning;
   std::mutex mMutex;
   std::condition_variable mCondition;
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <ableton/discovery/NetworkInterface.hpp>
 #include <ableton/platforms/asio/AsioWrapper.hpp>
 #include <arpa/inet.h>
 #include <esp_netif.h>
@@ -33,9 +34,9 @@ namespace esp32
 // ESP32 implementation of ip interface address scanner
 struct ScanIpIfAddrs
 {
-  std::vector<::asio::ip::address> operator()()
+  std::vector<discovery::NetworkInterface> operator()()
   {
-    std::vector<::asio::ip::address> addrs;
+    std::vector<discovery::NetworkInterface> interfaces;
     // Get first network interface
     esp_netif_t* esp_netif = esp_netif_next(NULL);
     while (esp_netif)
@@ -45,12 +46,14 @@ struct ScanIpIfAddrs
       {
         esp_netif_ip_info_t ip_info;
         esp_netif_get_ip_info(esp_netif, &ip_info);
-        addrs.emplace_back(::asio::ip::address_v4(ntohl(ip_info.ip.addr)));
+        interfaces.push_back({esp_netif_get_ifkey(esp_netif),
+          ::asio::ip::address_v4(ntohl(ip_info.ip.addr)),
+          discovery::InterfaceType::Other});
       }
       // Get next network interface
       esp_netif = esp_netif_next(esp_netif);
     }
-    return addrs;
+    return interfaces;
   }
 };
 
@@ -19,9 +19,14 @@
 
 #pragma once
 
+#include <array>
+#include <cctype>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <ctime>
+#include <fstream>
+#include <string>
 
 namespace ableton
 {
@@ -46,6 +51,41 @@ public:
     std::uint64_t ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
     return std::chrono::microseconds(ns / 1000ULL);
   }
+
+  // The clock reads the same in all processes until the next boot, so its domain is
+  // identified by the boot id, combined with the id of the clock. Zero if the boot
+  // id can't be read.
+  std::array<std::uint8_t, 16> clockDomainId() const
+  {
+    static const auto id = readBootClockId();
+    return id;
+  }
+
+private:
+  static std::array<std::uint8_t, 16> readBootClockId()
+  {
+    std::array<std::uint8_t, 16> id{};
+    std::string bootId;
+    std::ifstream("/proc/sys/kernel/random/boot_id") >> bootId;
+    std::size_t numDigits = 0;
+    for (const auto c : bootId)
+    {
+      if (std::isxdigit(static_cast<unsigned char>(c)) && numDigits < 2 * id.size())
+      {
+        const auto digit = static_cast<std::uint8_t>(
+          std::isdigit(static_cast<unsigned char>(c)) ? c - '0'
+                                                      : std::tolower(c) - 'a' + 10);
+        id[numDigits / 2] = static_cast<std::uint8_t>(id[numDigits / 2] << 4 | digit);
+        ++numDigits;
+      }
+    }
+    if (numDigits != 2 * id.size())
+    {
+      return {};
+    }
+    id.back() = static_cast<std::uint8_t>(id.back() ^ (CLOCK + 1));
+    return id;
+  }
 };
 
 using ClockMonotonic = Clock<CLOCK_MONOTONIC>;
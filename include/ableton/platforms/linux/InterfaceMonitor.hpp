@@ -0,0 +1,124 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <ableton/util/SafeAsyncHandler.hpp>
+#include <array>
+#include <functional>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <memory>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace ableton
+{
+namespace platforms
+{
+namespace linux_
+{
+
+// Reports changes of the network interfaces by listening to the rtnetlink
+// notifications about links and their addresses. The handler is called on the io
+// thread. If the netlink socket can't be opened, the monitor is inactive and the
+// interfaces have to be polled.
+class InterfaceMonitor
+{
+public:
+  InterfaceMonitor(::asio::io_service& io, std::function<void()> handler)
+    : mpImpl(std::make_shared<Impl>(io, std::move(handler)))
+  {
+    if (mpImpl->mDescriptor.is_open())
+    {
+      mpImpl->listen();
+    }
+  }
+
+  InterfaceMonitor(const InterfaceMonitor&) = delete;
+  InterfaceMonitor& operator=(const InterfaceMonitor&) = delete;
+
+  InterfaceMonitor(InterfaceMonitor&& rhs)
+    : mpImpl(std::move(rhs.mpImpl))
+  {
+  }
+
+  bool isActive() const
+  {
+    return mpImpl->mDescriptor.is_open();
+  }
+
+private:
+  struct Impl : util::EnableAsyncSafe<Impl>
+  {
+    Impl(::asio::io_service& io, std::function<void()> handler)
+      : mHandler(std::move(handler))
+      , mDescriptor(io)
+    {
+      const int fd = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+      if (fd < 0)
+      {
+        return;
+      }
+      sockaddr_nl addr{};
+      addr.nl_family = AF_NETLINK;
+      addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+      if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+      {
+        ::close(fd);
+        return;
+      }
+      ::asio::error_code ec;
+      mDescriptor.assign(fd, ec);
+      if (ec)
+      {
+        ::close(fd);
+      }
+    }
+
+    void listen()
+    {
+      mDescriptor.async_read_some(
+        ::asio::buffer(mReadBuffer), this->asyncSafe());
+    }
+
+    void operator()(const ::asio::error_code& error, std::size_t)
+    {
+      // The content of the notifications doesn't matter as the interfaces are
+      // rescanned anyway. Running out of buffer space means that notifications
+      // were lost, which must be treated as a change as well.
+      if (!error || error == ::asio::error::no_buffer_space)
+      {
+        mHandler();
+        listen();
+      }
+    }
+
+    std::function<void()> mHandler;
+    ::asio::posix::stream_descriptor mDescriptor;
+    std::array<char, 8192> mReadBuffer;
+  };
+
+  std::shared_ptr<Impl> mpImpl;
+};
+
+} // namespace linux_
+} // namespace platforms
+} // namespace ableton
@@ -0,0 +1,216 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/discovery/PacketFilter.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <linux/filter.h>
+#include <sys/socket.h>
+#include <vector>
+
+namespace ableton
+{
+namespace platforms
+{
+namespace linux_
+{
+namespace detail
+{
+
+// Emits a classic BPF program whose jumps go forward to labels that are placed
+// later in the program
+class PacketFilterCompiler
+{
+public:
+  enum Label
+  {
+    kCompactMessage,
+    kAccept,
+    kDrop,
+    kNumLabels,
+  };
+
+  static const std::uint32_t kAcceptPacket = 0xffffffff;
+  static const std::uint32_t kDropPacket = 0;
+
+  void loadWord(const std::uint32_t offset)
+  {
+    emit(BPF_LD | BPF_W | BPF_ABS, offset);
+  }
+
+  void loadHalfWord(const std::uint32_t offset)
+  {
+    emit(BPF_LD | BPF_H | BPF_ABS, offset);
+  }
+
+  void loadByte(const std::uint32_t offset)
+  {
+    emit(BPF_LD | BPF_B | BPF_ABS, offset);
+  }
+
+  // Continues with the next instruction if the accumulator is k and jumps to the
+  // label otherwise
+  void expect(const std::uint32_t k, const Label otherwise)
+  {
+    mJumps.push_back(Jump{mProgram.size(), otherwise, false});
+    emit(BPF_JMP | BPF_JEQ | BPF_K, k);
+  }
+
+  // Jumps to the label if the accumulator is k
+  void jumpIfEqual(const std::uint32_t k, const Label label)
+  {
+    mJumps.push_back(Jump{mProgram.size(), label, true});
+    emit(BPF_JMP | BPF_JEQ | BPF_K, k);
+  }
+
+  void ret(const std::uint32_t k)
+  {
+    emit(BPF_RET | BPF_K, k);
+  }
+
+  void place(const Label label)
+  {
+    mLabels[label] = mProgram.size();
+  }
+
+  std::vector<sock_filter> finish()
+  {
+    place(kAccept);
+    ret(kAcceptPacket);
+    place(kDrop);
+    ret(kDropPacket);
+    for (const auto& jump : mJumps)
+    {
+      const auto offset =
+        static_cast<std::uint8_t>(mLabels[jump.label] - jump.instruction - 1);
+      auto& instruction = mProgram[jump.instruction];
+      (jump.ifEqual ? instruction.jt : instruction.jf) = offset;
+    }
+    return std::move(mProgram);
+  }
+
+private:
+  struct Jump
+  {
+    std::size_t instruction;
+    Label label;
+    bool ifEqual;
+  };
+
+  void emit(const std::uint16_t code, const std::uint32_t k)
+  {
+    mProgram.push_back(sock_filter{code, 0, 0, k});
+  }
+
+  std::vector<sock_filter> mProgram;
+  std::vector<Jump> mJumps;
+  std::array<std::size_t, kNumLabels> mLabels;
+};
+
+inline std::uint32_t bigEndianWord(const char a, const char b, const char c, const char d)
+{
+  return static_cast<std::uint32_t>(static_cast<std::uint8_t>(a)) << 24
+         | static_cast<std::uint32_t>(static_cast<std::uint8_t>(b)) << 16
+         | static_cast<std::uint32_t>(static_cast<std::uint8_t>(c)) << 8
+         | static_cast<std::uint32_t>(static_cast<std::uint8_t>(d));
+}
+
+// Accepts the packet unless the bytes at the offset are the given ident, in which
+// case it continues with the next instruction
+inline void acceptOtherIdents(PacketFilterCompiler& compiler,
+  std::uint32_t offset,
+  const std::vector<std::uint8_t>& ident)
+{
+  std::size_t i = 0;
+  for (; i + 4 <= ident.size(); i += 4, offset += 4)
+  {
+    compiler.loadWord(offset);
+    compiler.expect(bigEndianWord(static_cast<char>(ident[i]),
+                      static_cast<char>(ident[i + 1]), static_cast<char>(ident[i + 2]),
+                      static_cast<char>(ident[i + 3])),
+      PacketFilterCompiler::kAccept);
+  }
+  for (; i < ident.size(); ++i, ++offset)
+  {
+    compiler.loadByte(offset);
+    compiler.expect(ident[i], PacketFilterCompiler::kAccept);
+  }
+}
+
+} // namespace detail
+
+// Jumps of classic BPF reach at most 255 instructions ahead, longer idents are not
+// compared
+const std::size_t kMaxFilteredIdentSize = 64;
+
+// Compiles the filter to a classic BPF program for UDP sockets, which see the
+// packet from the UDP header on. Loads beyond the end of a packet drop it, like
+// the messenger drops packets that are too short for their header.
+//
+// The protocol header of v1 messages is followed by the type, the ttl, the group
+// and the ident, that of compact v2 messages by the type, the ttl and the ident.
+inline std::vector<sock_filter> compilePacketFilter(const discovery::PacketFilter& filter)
+{
+  using Compiler = detail::PacketFilterCompiler;
+  const std::uint32_t kPayload = 8;
+  const auto& ident =
+    filter.ownIdent.size() <= kMaxFilteredIdentSize ? filter.ownIdent
+                                                    : std::vector<std::uint8_t>{};
+
+  Compiler compiler;
+  compiler.loadWord(kPayload);
+  compiler.expect(detail::bigEndianWord('_', 'a', 's', 'd'), Compiler::kCompactMessage);
+  compiler.loadWord(kPayload + 4);
+  compiler.expect(detail::bigEndianWord('p', '_', 'v', 1), Compiler::kDrop);
+  if (!filter.acceptsAnyGroup)
+  {
+    compiler.loadHalfWord(kPayload + 10);
+    compiler.expect(filter.groupId, Compiler::kDrop);
+  }
+  detail::acceptOtherIdents(compiler, kPayload + 12, ident);
+  compiler.ret(ident.empty() ? Compiler::kAcceptPacket : Compiler::kDropPacket);
+
+  // The accumulator still holds the first word of the packet
+  compiler.place(Compiler::kCompactMessage);
+  if (filter.acceptsCompactMessages)
+  {
+    compiler.expect(detail::bigEndianWord('_', 'a', 's', 2), Compiler::kDrop);
+    detail::acceptOtherIdents(compiler, kPayload + 6, ident);
+  }
+  compiler.ret(ident.empty() && filter.acceptsCompactMessages
+                 ? Compiler::kAcceptPacket
+                 : Compiler::kDropPacket);
+  return compiler.finish();
+}
+
+// Replaces the filter of the socket. Kernels without socket filters deliver all
+// packets, which is no reason to fail, so errors are ignored.
+inline void attachPacketFilter(const int fd, const discovery::PacketFilter& filter)
+{
+  auto program = compilePacketFilter(filter);
+  sock_fprog fprog{static_cast<unsigned short>(program.size()), program.data()};
+  setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+}
+
+} // namespace linux_
+} // namespace platforms
+} // namespace ableton
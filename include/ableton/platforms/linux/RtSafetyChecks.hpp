@@ -0,0 +1,110 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/util/RtSafety.hpp>
+#include <cerrno>
+#include <cstddef>
+#include <dlfcn.h>
+#include <pthread.h>
+
+// Interposes the allocation functions and pthread_mutex_lock of glibc to report
+// their use from the realtime scopes of util::rt. Include this in exactly one
+// translation unit of an executable, which must not use another interposer such as
+// a sanitizer or valgrind. Non-blocking functions like pthread_mutex_trylock stay
+// unchecked. pthread_mutex_lock is looked up with dlsym, so the executable must
+// link ${CMAKE_DL_LIBS}.
+
+namespace ableton
+{
+namespace platforms
+{
+namespace linux_rt
+{
+
+using MutexLock = int (*)(pthread_mutex_t*);
+
+// Resolved during static initialization, so that looking it up doesn't count as an
+// allocation of a realtime scope. Locks of earlier static initializers resolve it
+// on first use.
+inline MutexLock nextMutexLock()
+{
+  static MutexLock next = nullptr;
+  if (!next)
+  {
+    next = reinterpret_cast<MutexLock>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+  }
+  return next;
+}
+
+static const MutexLock kResolvedMutexLock = nextMutexLock();
+
+} // namespace linux_rt
+} // namespace platforms
+} // namespace ableton
+
+extern "C"
+{
+  void* __libc_malloc(std::size_t size);
+  void* __libc_calloc(std::size_t num, std::size_t size);
+  void* __libc_realloc(void* ptr, std::size_t size);
+  void* __libc_memalign(std::size_t alignment, std::size_t size);
+  void __libc_free(void* ptr);
+
+  void* malloc(std::size_t size) noexcept
+  {
+    ::ableton::util::rt::check("malloc");
+    return __libc_malloc(size);
+  }
+
+  void* calloc(std::size_t num, std::size_t size) noexcept
+  {
+    ::ableton::util::rt::check("calloc");
+    return __libc_calloc(num, size);
+  }
+
+  void* realloc(void* ptr, std::size_t size) noexcept
+  {
+    ::ableton::util::rt::check("realloc");
+    return __libc_realloc(ptr, size);
+  }
+
+  int posix_memalign(void** ptr, std::size_t alignment, std::size_t size) noexcept
+  {
+    ::ableton::util::rt::check("posix_memalign");
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+  }
+
+  void free(void* ptr) noexcept
+  {
+    if (ptr)
+    {
+      ::ableton::util::rt::check("free");
+    }
+    __libc_free(ptr);
+  }
+
+  int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+  {
+    ::ableton::util::rt::check("pthread_mutex_lock");
+    return ::ableton::platforms::linux_rt::nextMutexLock()(mutex);
+  }
+}
@@ -0,0 +1,282 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/link/SeqLockBuffer.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace ableton
+{
+namespace platforms
+{
+namespace linux_
+{
+
+// Reads the time from the counter of the processor, the TSC on x86 and the virtual
+// counter on ARM, which takes a few nanoseconds, and maps it to the time of
+// ReferenceClock. Before kernel 5.3 reading CLOCK_MONOTONIC_RAW is a system call.
+//
+// The counter is only used if it is invariant and synchronized between cores: on
+// x86 the kernel must use the TSC as its clocksource, the generic timer of ARM always
+// is. Otherwise, and for other processors, the clock falls back to ReferenceClock.
+//
+// Ticks are scaled to microseconds with a 32 bit fixed-point factor. The factor and
+// the offset are recalibrated against ReferenceClock, at first every millisecond and
+// eventually every second, with the rate measured over the whole lifetime of the
+// process. If a recalibration finds the counter more than maxError() away from
+// ReferenceClock, e.g. because the counter stopped in a suspended virtual machine,
+// the clock falls back to ReferenceClock for the rest of the process.
+template <typename ReferenceClock>
+class TscClock
+{
+public:
+  // Deviations from ReferenceClock up to this are corrected at recalibration
+  static std::chrono::microseconds maxError()
+  {
+    return std::chrono::microseconds{500};
+  }
+
+  TscClock()
+  {
+    state();
+  }
+
+  std::chrono::microseconds micros() const
+  {
+    auto& s = state();
+    if (!s.isValid.load(std::memory_order_relaxed))
+    {
+      return ReferenceClock{}.micros();
+    }
+
+    const auto ticks = readCounter();
+    if (ticks >= s.nextCalibrationTicks.load(std::memory_order_relaxed))
+    {
+      s.recalibrate();
+    }
+    return std::chrono::microseconds{s.calibration.read().micros(ticks)};
+  }
+
+  // The time is that of ReferenceClock to within a few microseconds, so it has the
+  // same clock domain
+  std::array<std::uint8_t, 16> clockDomainId() const
+  {
+    return ReferenceClock{}.clockDomainId();
+  }
+
+  // True if the counter is used, false if the clock falls back to ReferenceClock
+  static bool usesCounter()
+  {
+    return state().isValid.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Calibration
+  {
+    std::int64_t micros(const std::uint64_t now) const
+    {
+      return now >= ticks ? originMicros + static_cast<std::int64_t>(scale(now - ticks))
+                          : originMicros - static_cast<std::int64_t>(scale(ticks - now));
+    }
+
+    // ticks * factor / 2^shift for a factor below 2^32
+    std::uint64_t scale(const std::uint64_t delta) const
+    {
+      return (((delta >> 32) * factor) >> (shift - 32))
+             + (((delta & 0xFFFFFFFFu) * factor) >> shift);
+    }
+
+    std::uint64_t ticks;
+    std::int64_t originMicros;
+    std::uint64_t factor;
+    std::uint32_t shift;
+  };
+
+  // A reading of the counter and ReferenceClock at the same time
+  struct Sample
+  {
+    std::uint64_t ticks;
+    std::int64_t micros;
+  };
+
+  struct State
+  {
+    State()
+      : isRecalibrating(false)
+      , isValid(false)
+      , nextCalibrationTicks(0)
+    {
+      if (!isCounterInvariant())
+      {
+        return;
+      }
+
+      // An initial rate for the first calibrations
+      origin = sample();
+      auto current = origin;
+      while (current.micros - origin.micros < 1000)
+      {
+        current = sample();
+      }
+      const auto ticksPerMicro = static_cast<double>(current.ticks - origin.ticks)
+                                 / static_cast<double>(current.micros - origin.micros);
+      if (ticksPerMicro < 1. || ticksPerMicro > 1e5)
+      {
+        return;
+      }
+      isValid = true;
+      update(current, current.micros);
+    }
+
+    void recalibrate()
+    {
+      if (isRecalibrating.exchange(true, std::memory_order_acquire))
+      {
+        return;
+      }
+
+      const auto current = sample();
+      const auto predicted = calibration.read().micros(current.ticks);
+      if (std::abs(predicted - current.micros) > maxError().count())
+      {
+        isValid = false;
+      }
+      else
+      {
+        // Never step back, so that the time stays monotonic
+        update(current, (std::max)(predicted, current.micros));
+      }
+
+      isRecalibrating.store(false, std::memory_order_release);
+    }
+
+    void update(const Sample& current, const std::int64_t originMicros)
+    {
+      const auto ticksPerMicro = static_cast<double>(current.ticks - origin.ticks)
+                                 / static_cast<double>(current.micros - origin.micros);
+
+      // The largest shift that keeps the factor below 2^32
+      auto shift = std::uint32_t{32};
+      while (shift < 63 && std::ldexp(1., static_cast<int>(shift) + 1) / ticksPerMicro
+                             < 4294967296.)
+      {
+        ++shift;
+      }
+      const auto factor = static_cast<std::uint64_t>(
+        std::llround(std::ldexp(1., static_cast<int>(shift)) / ticksPerMicro));
+      calibration.write(Calibration{current.ticks, originMicros, factor, shift});
+
+      // The rate gets more accurate with the time since the origin, so the
+      // calibrations can be further apart
+      const auto age = current.micros - origin.micros;
+      const auto period = (std::min)((std::max)(age / 16, std::int64_t{1000}),
+        std::int64_t{1000000});
+      nextCalibrationTicks.store(current.ticks
+                                   + static_cast<std::uint64_t>(
+                                     static_cast<double>(period) * ticksPerMicro),
+        std::memory_order_relaxed);
+    }
+
+    // Brackets the read of ReferenceClock with reads of the counter and keeps the
+    // tightest of a few tries
+    static Sample sample()
+    {
+      auto best = Sample{};
+      auto bestWindow = UINT64_MAX;
+      for (auto i = 0; i < 3; ++i)
+      {
+        const auto before = readCounter();
+        const auto micros = ReferenceClock{}.micros().count();
+        const auto after = readCounter();
+        if (after - before < bestWindow)
+        {
+          bestWindow = after - before;
+          best = Sample{before + (after - before) / 2, micros};
+        }
+      }
+      return best;
+    }
+
+    std::atomic<bool> isRecalibrating;
+    std::atomic<bool> isValid;
+    std::atomic<std::uint64_t> nextCalibrationTicks;
+    Sample origin;
+    link::SeqLockBuffer<Calibration> calibration;
+  };
+
+  static State& state()
+  {
+    static State s;
+    return s;
+  }
+
+#if defined(__x86_64__) || defined(__i386__)
+  static std::uint64_t readCounter()
+  {
+    return __rdtsc();
+  }
+
+  static bool isCounterInvariant()
+  {
+    std::string clockSource;
+    std::ifstream("/sys/devices/system/clocksource/clocksource0/current_clocksource")
+      >> clockSource;
+    return clockSource == "tsc";
+  }
+#elif defined(__aarch64__)
+  static std::uint64_t readCounter()
+  {
+    std::uint64_t ticks;
+    asm volatile("isb; mrs %0, cntvct_el0" : "=r"(ticks)::"memory");
+    return ticks;
+  }
+
+  static bool isCounterInvariant()
+  {
+    return true;
+  }
+#else
+  static std::uint64_t readCounter()
+  {
+    return 0;
+  }
+
+  static bool isCounterInvariant()
+  {
+    return false;
+  }
+#endif
+};
+
+} // namespace linux_
+} // namespace platforms
+} // namespace ableton
@@ -0,0 +1,66 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/platforms/asio/Context.hpp>
+#include <ableton/platforms/linux/ThreadFactory.hpp>
+#include <ableton/platforms/linux/UringSocket.hpp>
+#include <ableton/platforms/posix/ScanIpIfAddrs.hpp>
+#include <ableton/util/Log.hpp>
+
+namespace ableton
+{
+namespace platforms
+{
+namespace linux_
+{
+
+struct UringSockets
+{
+  template <std::size_t BufferSize>
+  using Socket = UringSocket<BufferSize>;
+};
+
+// Contexts like link::platform::IoContext and SharedIoContext whose sockets use
+// io_uring, for BasicLink<link::platform::Clock, UringContext>. They can only be
+// used if isUringAvailable().
+using UringContext = asio::Context<posix::ScanIpIfAddrs,
+  util::NullLog,
+  ThreadFactory,
+  asio::DefaultAsioTimer,
+  false,
+  false,
+  util::NullTrace,
+  discovery::DefaultSocketOptions,
+  UringSockets>;
+
+using SharedUringContext = asio::Context<posix::ScanIpIfAddrs,
+  util::NullLog,
+  ThreadFactory,
+  asio::DefaultAsioTimer,
+  false,
+  true,
+  util::NullTrace,
+  discovery::DefaultSocketOptions,
+  UringSockets>;
+
+} // namespace linux_
+} // namespace platforms
+} // namespace ableton
@@ -0,0 +1,944 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <ableton/util/SafeAsyncHandler.hpp>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <linux/io_uring.h>
+#include <memory>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <type_traits>
+#include <unistd.h>
+
+// Setting up io_uring fails with exceptions, which isUringAvailable relies on
+#if defined(LINK_NO_EXCEPTIONS)
+#error "UringSocket is not available with LINK_NO_EXCEPTIONS"
+#endif
+
+namespace ableton
+{
+namespace platforms
+{
+namespace linux_
+{
+namespace detail
+{
+
+inline ::asio::error_code uringError(const int error)
+{
+  return ::asio::error_code(error, ::asio::error::get_system_category());
+}
+
+// A shared memory mapping that is unmapped when destroyed
+struct UringMapping
+{
+  UringMapping()
+    : pData(nullptr)
+    , size(0)
+  {
+  }
+
+  // Maps the given region of the file, or anonymous memory if fd is -1
+  UringMapping(const int fd, const std::size_t mappingSize, const off_t offset)
+    : pData(::mmap(nullptr,
+      mappingSize,
+      PROT_READ | PROT_WRITE,
+      fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED | MAP_POPULATE,
+      fd,
+      offset))
+    , size(mappingSize)
+  {
+    if (pData == MAP_FAILED)
+    {
+      pData = nullptr;
+      throw ::asio::system_error(uringError(errno));
+    }
+  }
+
+  UringMapping(const UringMapping&) = delete;
+  UringMapping& operator=(const UringMapping&) = delete;
+
+  UringMapping& operator=(UringMapping&& rhs)
+  {
+    std::swap(pData, rhs.pData);
+    std::swap(size, rhs.size);
+    return *this;
+  }
+
+  ~UringMapping()
+  {
+    if (pData)
+    {
+      ::munmap(pData, size);
+    }
+  }
+
+  template <typename T>
+  T* at(const std::size_t offset) const
+  {
+    return reinterpret_cast<T*>(static_cast<char*>(pData) + offset);
+  }
+
+  void* pData;
+  std::size_t size;
+};
+
+// An io_uring instance with its submission and completion queues. Submitting and
+// reaping must not happen concurrently.
+class UringQueue
+{
+public:
+  explicit UringQueue(const unsigned numEntries)
+    : mParams{}
+    , mFd(setup(numEntries, mParams))
+    , mNumPrepared(0)
+  {
+    const auto sqSize = mParams.sq_off.array + mParams.sq_entries * sizeof(unsigned);
+    const auto cqSize = mParams.cq_off.cqes + mParams.cq_entries * sizeof(io_uring_cqe);
+    if (mParams.features & IORING_FEAT_SINGLE_MMAP)
+    {
+      mSqRing =
+        UringMapping{mFd.fd, (std::max)(sqSize, cqSize), off_t{IORING_OFF_SQ_RING}};
+    }
+    else
+    {
+      mSqRing = UringMapping{mFd.fd, sqSize, off_t{IORING_OFF_SQ_RING}};
+      mCqRing = UringMapping{mFd.fd, cqSize, off_t{IORING_OFF_CQ_RING}};
+    }
+    mSqes = UringMapping{
+      mFd.fd, mParams.sq_entries * sizeof(io_uring_sqe), off_t{IORING_OFF_SQES}};
+
+    // Submission queue entries are always submitted in order
+    const auto pArray = mSqRing.at<unsigned>(mParams.sq_off.array);
+    for (unsigned i = 0; i < mParams.sq_entries; ++i)
+    {
+      pArray[i] = i;
+    }
+  }
+
+  UringQueue(const UringQueue&) = delete;
+  UringQueue& operator=(const UringQueue&) = delete;
+
+  int fd() const
+  {
+    return mFd.fd;
+  }
+
+  // A cleared entry to be submitted with the next call to submit, or null if the
+  // submission queue is full
+  io_uring_sqe* prepare()
+  {
+    const auto head =
+      __atomic_load_n(mSqRing.at<unsigned>(mParams.sq_off.head), __ATOMIC_ACQUIRE);
+    const auto tail = *mSqRing.at<unsigned>(mParams.sq_off.tail) + mNumPrepared;
+    if (tail - head >= mParams.sq_entries)
+    {
+      return nullptr;
+    }
+    ++mNumPrepared;
+    const auto pSqe = mSqes.at<io_uring_sqe>(0) + (tail & ringMask(mParams.sq_off));
+    std::memset(pSqe, 0, sizeof(io_uring_sqe));
+    return pSqe;
+  }
+
+  // Submits the prepared entries with a single system call. If wait is set, blocks
+  // until at least one completion is available.
+  ::asio::error_code submit(const bool wait = false)
+  {
+    const auto pTail = mSqRing.at<unsigned>(mParams.sq_off.tail);
+    __atomic_store_n(pTail, *pTail + mNumPrepared, __ATOMIC_RELEASE);
+    auto numToSubmit = mNumPrepared;
+    mNumPrepared = 0;
+    for (;;)
+    {
+      const auto result = ::syscall(__NR_io_uring_enter, mFd.fd, numToSubmit,
+        wait ? 1u : 0u, wait ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+      if (result >= 0)
+      {
+        return {};
+      }
+      if (errno != EINTR)
+      {
+        return uringError(errno);
+      }
+      // The entries submitted before the interruption are not submitted again
+      numToSubmit = 0;
+    }
+  }
+
+  bool hasCompletions() const
+  {
+    return *mCqHead() != __atomic_load_n(mCqTail(), __ATOMIC_ACQUIRE);
+  }
+
+  // Passes all available completions to the handler
+  template <typename Handler>
+  void reap(Handler handler)
+  {
+    const auto pCqes = cqRing().template at<io_uring_cqe>(mParams.cq_off.cqes);
+    const auto mask = *cqRing().template at<unsigned>(mParams.cq_off.ring_mask);
+    auto head = *mCqHead();
+    const auto tail = __atomic_load_n(mCqTail(), __ATOMIC_ACQUIRE);
+    while (head != tail)
+    {
+      const auto cqe = pCqes[head & mask];
+      // Release the entry before handling it, as handling may reap again
+      __atomic_store_n(mCqHead(), ++head, __ATOMIC_RELEASE);
+      handler(cqe);
+    }
+  }
+
+  ::asio::error_code registerResource(
+    const unsigned opcode, void* const pArg, const unsigned numArgs)
+  {
+    if (::syscall(__NR_io_uring_register, mFd.fd, opcode, pArg, numArgs) < 0)
+    {
+      return uringError(errno);
+    }
+    return {};
+  }
+
+private:
+  struct Fd
+  {
+    Fd(const int descriptor)
+      : fd(descriptor)
+    {
+    }
+
+    Fd(const Fd&) = delete;
+    Fd& operator=(const Fd&) = delete;
+
+    Fd(Fd&& rhs)
+      : fd(rhs.fd)
+    {
+      rhs.fd = -1;
+    }
+
+    ~Fd()
+    {
+      if (fd >= 0)
+      {
+        ::close(fd);
+      }
+    }
+
+    int fd;
+  };
+
+  static Fd setup(const unsigned numEntries, io_uring_params& params)
+  {
+    const auto fd = static_cast<int>(::syscall(__NR_io_uring_setup, numEntries, &params));
+    if (fd < 0)
+    {
+      throw ::asio::system_error(uringError(errno));
+    }
+    return {fd};
+  }
+
+  unsigned ringMask(const io_sqring_offsets& offsets) const
+  {
+    return *mSqRing.at<unsigned>(offsets.ring_mask);
+  }
+
+  const UringMapping& cqRing() const
+  {
+    return mCqRing.pData ? mCqRing : mSqRing;
+  }
+
+  unsigned* mCqHead() const
+  {
+    return cqRing().at<unsigned>(mParams.cq_off.head);
+  }
+
+  unsigned* mCqTail() const
+  {
+    return cqRing().at<unsigned>(mParams.cq_off.tail);
+  }
+
+  io_uring_params mParams;
+  Fd mFd;
+  UringMapping mSqRing;
+  UringMapping mCqRing;
+  UringMapping mSqes;
+  unsigned mNumPrepared;
+};
+
+// A ring of buffers that is registered with a UringQueue, from which the kernel
+// picks the buffers for received datagrams
+class UringBufferRing
+{
+public:
+  static const std::uint16_t kGroup = 0;
+
+  UringBufferRing(UringQueue& queue, const std::uint16_t numBuffers)
+    : mQueue(queue)
+    , mRing(-1, numBuffers * sizeof(io_uring_buf), 0)
+    , mNumBuffers(numBuffers)
+    , mTail(0)
+  {
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<std::uint64_t>(mRing.pData);
+    reg.ring_entries = numBuffers;
+    reg.bgid = kGroup;
+    const auto error = mQueue.registerResource(IORING_REGISTER_PBUF_RING, &reg, 1);
+    if (error)
+    {
+      throw ::asio::system_error(error);
+    }
+  }
+
+  UringBufferRing(const UringBufferRing&) = delete;
+  UringBufferRing& operator=(const UringBufferRing&) = delete;
+
+  ~UringBufferRing()
+  {
+    io_uring_buf_reg reg{};
+    reg.bgid = kGroup;
+    mQueue.registerResource(IORING_UNREGISTER_PBUF_RING, &reg, 1);
+  }
+
+  // Hands the buffer over to the kernel
+  void add(std::uint8_t* const pData, const std::size_t size, const std::uint16_t id)
+  {
+    // The tail overlays the reserved field of the first entry, which must not be
+    // written with the other fields
+    auto& entry = mRing.at<io_uring_buf>(0)[mTail & (mNumBuffers - 1)];
+    entry.addr = reinterpret_cast<std::uint64_t>(pData);
+    entry.len = static_cast<std::uint32_t>(size);
+    entry.bid = id;
+    __atomic_store_n(&mRing.at<io_uring_buf>(0)->resv, ++mTail, __ATOMIC_RELEASE);
+  }
+
+private:
+  UringQueue& mQueue;
+  UringMapping mRing;
+  std::uint16_t mNumBuffers;
+  std::uint16_t mTail;
+};
+
+} // namespace detail
+
+// Whether the kernel supports the io_uring features that UringSocket needs, which
+// requires Linux 5.19 and may be prevented by seccomp filters, e.g. of containers
+inline bool isUringAvailable()
+{
+  static const bool isAvailable = [] {
+    try
+    {
+      detail::UringQueue queue{2};
+      detail::UringBufferRing buffers{queue, 2};
+      return true;
+    }
+    catch (const ::asio::system_error&)
+    {
+      return false;
+    }
+  }();
+  return isAvailable;
+}
+
+// Udp socket with the same interface as asio::Socket that receives and sends
+// datagrams through an io_uring instance of its own. Opening the socket throws if
+// io_uring is not available, see isUringAvailable.
+//
+// A single multishot receive keeps receiving datagrams into BatchSize buffers that
+// are registered with the kernel, so that receiving takes no system call per
+// datagram. Once the io_uring signals completions to the io_service, all
+// datagrams that have arrived are passed to the receive handler one after another.
+// The handler is expected to call receive again to get the next datagram, as with
+// Socket. Kernels before 6.0 don't support multishot receives, in which case each
+// datagram is received with one receive request.
+//
+// Datagrams sent from within an io handler are queued and submitted with a single
+// system call once the handler has returned. Since sending happens later, an
+// error is reported by the next call to send. Pending datagrams are
+// sent before the socket is closed.
+//
+// As with asio::BatchedSocket, the kernel timestamps received datagrams, so that
+// the receive delay of the datagram that is being handled is known.
+
+template <std::size_t MaxPacketSize, std::size_t BatchSize = 16>
+struct UringSocket
+{
+  static_assert(BatchSize >= 2 && BatchSize <= 32768
+                  && (BatchSize & (BatchSize - 1)) == 0,
+    "BatchSize must be a power of two");
+
+  UringSocket(
+    ::asio::io_service& io, const ::asio::ip::udp protocol = ::asio::ip::udp::v4())
+    : mpImpl(std::make_shared<Impl>(io, protocol))
+  {
+  }
+
+  UringSocket(const UringSocket&) = delete;
+  UringSocket& operator=(const UringSocket&) = delete;
+
+  UringSocket(UringSocket&& rhs)
+    : mpImpl(std::move(rhs.mpImpl))
+  {
+  }
+
+  std::size_t send(const uint8_t* const pData,
+    const size_t numBytes,
+    const ::asio::ip::udp::endpoint& to)
+  {
+    ::asio::error_code ec;
+    const auto numSent = send(pData, numBytes, to, ec);
+    if (ec)
+    {
+      throw ::asio::system_error(ec);
+    }
+    return numSent;
+  }
+
+  // Reports an error through ec instead of throwing
+  std::size_t send(const uint8_t* const pData,
+    const size_t numBytes,
+    const ::asio::ip::udp::endpoint& to,
+    ::asio::error_code& ec)
+  {
+    assert(numBytes < MaxPacketSize);
+    return mpImpl->queueSend(pData, numBytes, to, ec);
+  }
+
+  template <typename Handler>
+  void receive(Handler handler)
+  {
+    mpImpl->mHandler = std::move(handler);
+    mpImpl->mHasHandler = true;
+    mpImpl->receive();
+  }
+
+  ::asio::ip::udp::endpoint endpoint() const
+  {
+    return mpImpl->mSocket.local_endpoint();
+  }
+
+  // The time that passed between the reception of the datagram that is currently
+  // being handled and now. Zero if the kernel didn't provide a timestamp or if no
+  // datagram is being handled.
+  std::chrono::microseconds receiveDelay() const
+  {
+    return mpImpl->receiveDelay();
+  }
+
+  struct Impl : util::EnableAsyncSafe<Impl>
+  {
+    // A multishot receive puts a header, the sender address and the control
+    // messages in front of the payload of each datagram
+    using ControlBuffer =
+      typename std::aligned_storage<CMSG_SPACE(sizeof(timespec)), alignof(cmsghdr)>::type;
+    static const std::size_t kNameSize = sizeof(sockaddr_in6);
+    static const std::size_t kPayloadOffset =
+      sizeof(io_uring_recvmsg_out) + kNameSize + sizeof(ControlBuffer);
+    using ReceiveBuffer = std::array<uint8_t, kPayloadOffset + MaxPacketSize>;
+
+    static const std::uint64_t kReceiveTag = 1ull << 62;
+    static const std::uint64_t kSendTag = 1ull << 61;
+    static const std::uint64_t kCancelTag = 1ull << 60;
+
+    Impl(::asio::io_service& io, const ::asio::ip::udp protocol)
+      : mQueue(static_cast<unsigned>(2 * BatchSize))
+      , mBufferRing(mQueue, static_cast<std::uint16_t>(BatchSize))
+      , mReceiveHeader{}
+      , mIsMultishot(true)
+      , mIsReceiving(false)
+      , mIsOutOfBuffers(false)
+      , mIsClosing(false)
+      , mFirstReceived(0)
+      , mNumReceived(0)
+      , mHasHandler(false)
+      , mIsWaiting(false)
+      , mIsDispatching(false)
+      , mIsDispatchPosted(false)
+      , mCurrentReceiveTime{}
+      , mNumQueued(0)
+      , mNumFreeSlots(BatchSize)
+      , mSocket(io, protocol)
+      , mRingDescriptor(io, mQueue.fd())
+    {
+      // Timestamps are optional, without them the receive delay is zero
+      const int enable = 1;
+      ::setsockopt(
+        mSocket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+
+      for (std::size_t i = 0; i < BatchSize; ++i)
+      {
+        mBufferRing.add(mReceiveBuffers[i].data(), mReceiveBuffers[i].size(),
+          static_cast<std::uint16_t>(i));
+        mFreeSlots[i] = i;
+      }
+      mReceiveHeader.msg_namelen = static_cast<socklen_t>(kNameSize);
+      mReceiveHeader.msg_controllen = sizeof(ControlBuffer);
+    }
+
+    ~Impl()
+    {
+      mIsClosing = true;
+      flushSends();
+      // Cancel the receive and the sends that are still in flight, and wait for
+      // the kernel to let go of their buffers
+      if (auto pSqe = mQueue.prepare())
+      {
+        pSqe->opcode = IORING_OP_ASYNC_CANCEL;
+        pSqe->fd = -1;
+        pSqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+        pSqe->user_data = kCancelTag;
+      }
+      auto error = mQueue.submit();
+      while (!error && (mIsReceiving || mNumFreeSlots + mNumQueued < BatchSize))
+      {
+        error = mQueue.submit(true);
+        processCompletions();
+      }
+      ::asio::error_code ec;
+      mRingDescriptor.release();
+      // Ignore error codes in shutdown and close as the socket may
+      // have already been forcibly closed
+      mSocket.shutdown(::asio::ip::udp::socket::shutdown_both, ec);
+      mSocket.close(ec);
+    }
+
+    std::size_t queueSend(const uint8_t* const pData,
+      const size_t numBytes,
+      const ::asio::ip::udp::endpoint& to,
+      ::asio::error_code& ec)
+    {
+      if (!mSendError && mNumFreeSlots == 0)
+      {
+        flushSends();
+        while (mNumFreeSlots == 0 && !mSendError)
+        {
+          mSendError = mQueue.submit(true);
+          processCompletions();
+        }
+      }
+
+      if (mSendError)
+      {
+        ec = mSendError;
+        mSendError = {};
+        return 0;
+      }
+      ec = {};
+
+      if (mNumQueued == 0)
+      {
+        std::weak_ptr<Impl> pImpl = this->shared_from_this();
+        ::asio::post(mSocket.get_executor(), [pImpl] {
+          if (auto pSelf = pImpl.lock())
+          {
+            pSelf->flushSends();
+          }
+        });
+      }
+
+      const auto i = mFreeSlots[--mNumFreeSlots];
+      auto& slot = mSendSlots[i];
+      std::copy(pData, pData + numBytes, begin(slot.buffer));
+      slot.to = to;
+      slot.iov.iov_base = slot.buffer.data();
+      slot.iov.iov_len = numBytes;
+      slot.header = {};
+      slot.header.msg_name = slot.to.data();
+      slot.header.msg_namelen = static_cast<socklen_t>(slot.to.size());
+      slot.header.msg_iov = &slot.iov;
+      slot.header.msg_iovlen = 1;
+      mQueued[mNumQueued++] = i;
+      return numBytes;
+    }
+
+    void flushSends()
+    {
+      if (mNumQueued == 0)
+      {
+        return;
+      }
+
+      // The submission queue has room for a full batch besides the receive
+      for (std::size_t i = 0; i < mNumQueued; ++i)
+      {
+        const auto pSqe = mQueue.prepare();
+        assert(pSqe);
+        pSqe->opcode = IORING_OP_SENDMSG;
+        pSqe->fd = mSocket.native_handle();
+        pSqe->addr = reinterpret_cast<std::uint64_t>(&mSendSlots[mQueued[i]].header);
+        pSqe->len = 1;
+        pSqe->user_data = kSendTag | mQueued[i];
+      }
+      mNumQueued = 0;
+      const auto error = mQueue.submit();
+      if (error)
+      {
+        mSendError = error;
+      }
+      // Sends to udp sockets mostly complete right away
+      processCompletions();
+    }
+
+    void receive()
+    {
+      if (!mIsReceiving && !mIsOutOfBuffers)
+      {
+        startReceiving();
+      }
+
+      if (mIsDispatching)
+      {
+        // The dispatch loop will pass the next datagram to the new handler
+        return;
+      }
+
+      if (mNumReceived > 0)
+      {
+        // The handler of the previous datagram didn't receive again right away,
+        // so further datagrams are pending. Don't invoke the handler from within
+        // receive.
+        postDispatch();
+        return;
+      }
+
+      wait();
+    }
+
+    void startReceiving()
+    {
+      const auto pSqe = mQueue.prepare();
+      if (!pSqe)
+      {
+        return;
+      }
+      pSqe->opcode = IORING_OP_RECVMSG;
+      pSqe->fd = mSocket.native_handle();
+      pSqe->addr = reinterpret_cast<std::uint64_t>(&mReceiveHeader);
+      pSqe->len = 1;
+      pSqe->flags = static_cast<std::uint8_t>(IOSQE_BUFFER_SELECT);
+      pSqe->buf_group = detail::UringBufferRing::kGroup;
+      pSqe->ioprio = static_cast<std::uint16_t>(mIsMultishot ? IORING_RECV_MULTISHOT : 0);
+      pSqe->user_data = kReceiveTag;
+      mIsReceiving = !mQueue.submit();
+    }
+
+    void wait()
+    {
+      if (mIsWaiting)
+      {
+        return;
+      }
+      mIsWaiting = true;
+      if (mQueue.hasCompletions())
+      {
+        // Completions that were left by reaping outside of the io handler don't
+        // signal the descriptor again
+        std::weak_ptr<Impl> pImpl = this->shared_from_this();
+        ::asio::post(mSocket.get_executor(), [pImpl] {
+          if (auto pSelf = pImpl.lock())
+          {
+            (*pSelf)(::asio::error_code{});
+          }
+        });
+      }
+      else
+      {
+        mRingDescriptor.async_wait(::asio::posix::stream_descriptor::wait_read,
+          this->asyncSafe());
+      }
+    }
+
+    void operator()(const ::asio::error_code& error)
+    {
+      mIsWaiting = false;
+      if (error)
+      {
+        return;
+      }
+      processCompletions();
+      dispatch();
+    }
+
+    void postDispatch()
+    {
+      if (mIsDispatchPosted)
+      {
+        return;
+      }
+      mIsDispatchPosted = true;
+      std::weak_ptr<Impl> pImpl = this->shared_from_this();
+      ::asio::post(mSocket.get_executor(), [pImpl] {
+        if (auto pSelf = pImpl.lock())
+        {
+          pSelf->mIsDispatchPosted = false;
+          pSelf->dispatch();
+        }
+      });
+    }
+
+    void processCompletions()
+    {
+      mQueue.reap([this](const io_uring_cqe& cqe) {
+        if (cqe.user_data == kReceiveTag)
+        {
+          handleReceive(cqe);
+        }
+        else if (cqe.user_data & kSendTag)
+        {
+          mFreeSlots[mNumFreeSlots++] =
+            static_cast<std::size_t>(cqe.user_data & ~kSendTag);
+          if (cqe.res < 0 && !mSendError && cqe.res != -ECANCELED)
+          {
+            // Drop the datagram, like a failing send_to would
+            mSendError = detail::uringError(-cqe.res);
+          }
+        }
+      });
+
+      if (mIsClosing)
+      {
+        return;
+      }
+      if (!mIsReceiving && !mIsOutOfBuffers)
+      {
+        startReceiving();
+      }
+      // Reaping outside of the io handler may have consumed the signal of the
+      // descriptor for these datagrams
+      if (mHasHandler && mNumReceived > 0 && !mIsDispatching)
+      {
+        postDispatch();
+      }
+    }
+
+    void handleReceive(const io_uring_cqe& cqe)
+    {
+      if (!(cqe.flags & IORING_CQE_F_MORE))
+      {
+        mIsReceiving = false;
+      }
+
+      if (cqe.res < 0)
+      {
+        if (cqe.res == -EINVAL && mIsMultishot)
+        {
+          // Multishot receives are not supported by this kernel. Single receives
+          // write the sender and control messages to the header instead.
+          mIsMultishot = false;
+          mReceiveHeader.msg_name = &mSingleReceiveName;
+          mReceiveHeader.msg_controllen = 0;
+        }
+        mIsOutOfBuffers = cqe.res == -ENOBUFS;
+        return;
+      }
+
+      if (!(cqe.flags & IORING_CQE_F_BUFFER))
+      {
+        return;
+      }
+
+      const auto id = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+      const auto size = static_cast<std::size_t>(cqe.res);
+      Datagram datagram{};
+      datagram.bufferId = id;
+      if (mIsMultishot)
+      {
+        const auto pBuffer = mReceiveBuffers[id].data();
+        io_uring_recvmsg_out out;
+        std::memcpy(&out, pBuffer, sizeof(out));
+        const auto pName = pBuffer + sizeof(out);
+        datagram.from = toEndpoint(pName);
+        datagram.offset = kPayloadOffset;
+        // Truncated datagrams are dropped in dispatch
+        datagram.size = (out.flags & MSG_TRUNC) || size < kPayloadOffset + out.payloadlen
+                          ? 0
+                          : static_cast<std::size_t>(out.payloadlen);
+        if (!(out.flags & MSG_CTRUNC))
+        {
+          datagram.time = receiveTime(pName + kNameSize, out.controllen);
+        }
+      }
+      else
+      {
+        datagram.from = toEndpoint(reinterpret_cast<const uint8_t*>(&mSingleReceiveName));
+        datagram.offset = 0;
+        datagram.size = size;
+      }
+
+      if (datagram.size == 0 || datagram.size > MaxPacketSize)
+      {
+        returnBuffer(id);
+        return;
+      }
+      mReceived[(mFirstReceived + mNumReceived++) % BatchSize] = datagram;
+    }
+
+    void returnBuffer(const std::uint16_t id)
+    {
+      mBufferRing.add(mReceiveBuffers[id].data(), mReceiveBuffers[id].size(), id);
+      if (mIsOutOfBuffers)
+      {
+        mIsOutOfBuffers = false;
+        if (!mIsReceiving && !mIsClosing)
+        {
+          startReceiving();
+        }
+      }
+    }
+
+    void dispatch()
+    {
+      mIsDispatching = true;
+      while (mHasHandler && mNumReceived > 0)
+      {
+        // Copied, as the handler may reap further datagrams into the queue
+        const auto datagram = mReceived[mFirstReceived];
+        mFirstReceived = (mFirstReceived + 1) % BatchSize;
+        --mNumReceived;
+        // Handlers must only be called once per call to receive
+        auto handler = std::move(mHandler);
+        mHasHandler = false;
+        const auto bufBegin = mReceiveBuffers[datagram.bufferId].data() + datagram.offset;
+        mCurrentReceiveTime = datagram.time;
+        handler(datagram.from, bufBegin, bufBegin + datagram.size);
+        mCurrentReceiveTime = {};
+        returnBuffer(datagram.bufferId);
+      }
+      mIsDispatching = false;
+
+      if (mHasHandler && mNumReceived == 0)
+      {
+        wait();
+      }
+    }
+
+    static ::asio::ip::udp::endpoint toEndpoint(const uint8_t* const pName)
+    {
+      sockaddr address;
+      std::memcpy(&address, pName, sizeof(address));
+      const auto size =
+        address.sa_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+      ::asio::ip::udp::endpoint endpoint;
+      std::memcpy(endpoint.data(), pName, size);
+      endpoint.resize(size);
+      return endpoint;
+    }
+
+    static timespec receiveTime(const uint8_t* const pControl, const std::size_t size)
+    {
+      // The control messages in the buffer are not aligned
+      ControlBuffer control;
+      std::memcpy(&control, pControl, (std::min)(size, sizeof(control)));
+      msghdr header{};
+      header.msg_control = &control;
+      header.msg_controllen = (std::min)(size, sizeof(control));
+      for (auto pCmsg = CMSG_FIRSTHDR(&header); pCmsg != nullptr;
+           pCmsg = CMSG_NXTHDR(&header, pCmsg))
+      {
+        if (pCmsg->cmsg_level == SOL_SOCKET && pCmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+          timespec time;
+          std::copy(CMSG_DATA(pCmsg), CMSG_DATA(pCmsg) + sizeof(time),
+            reinterpret_cast<unsigned char*>(&time));
+          return time;
+        }
+      }
+      return {};
+    }
+
+    std::chrono::microseconds receiveDelay() const
+    {
+      using namespace std::chrono;
+      if (mCurrentReceiveTime.tv_sec == 0 && mCurrentReceiveTime.tv_nsec == 0)
+      {
+        return {};
+      }
+
+      // Kernel timestamps are based on the realtime clock
+      timespec now;
+      ::clock_gettime(CLOCK_REALTIME, &now);
+      const auto delay = duration_cast<microseconds>(
+        seconds{now.tv_sec - mCurrentReceiveTime.tv_sec}
+        + nanoseconds{now.tv_nsec - mCurrentReceiveTime.tv_nsec});
+      return delay > microseconds{0} ? delay : microseconds{0};
+    }
+
+    struct Datagram
+    {
+      std::uint16_t bufferId;
+      std::size_t offset;
+      std::size_t size;
+      ::asio::ip::udp::endpoint from;
+      timespec time;
+    };
+
+    struct SendSlot
+    {
+      std::array<uint8_t, MaxPacketSize> buffer;
+      ::asio::ip::udp::endpoint to;
+      iovec iov;
+      msghdr header;
+    };
+
+    detail::UringQueue mQueue;
+    detail::UringBufferRing mBufferRing;
+    std::array<ReceiveBuffer, BatchSize> mReceiveBuffers;
+    msghdr mReceiveHeader;
+    sockaddr_in6 mSingleReceiveName;
+    bool mIsMultishot;
+    bool mIsReceiving;
+    bool mIsOutOfBuffers;
+    bool mIsClosing;
+    std::array<Datagram, BatchSize> mReceived;
+    std::size_t mFirstReceived;
+    std::size_t mNumReceived;
+    using ByteIt = const uint8_t*;
+    std::function<void(const ::asio::ip::udp::endpoint&, ByteIt, ByteIt)> mHandler;
+    bool mHasHandler;
+    bool mIsWaiting;
+    bool mIsDispatching;
+    bool mIsDispatchPosted;
+    timespec mCurrentReceiveTime;
+    std::array<SendSlot, BatchSize> mSendSlots;
+    std::array<std::size_t, BatchSize> mQueued;
+    std::size_t mNumQueued;
+    std::array<std::size_t, BatchSize> mFreeSlots;
+    std::size_t mNumFreeSlots;
+    ::asio::error_code mSendError;
+    ::asio::ip::udp::socket mSocket;
+    ::asio::posix::stream_descriptor mRingDescriptor;
+  };
+
+  std::shared_ptr<Impl> mpImpl;
+};
+
+} // namespace linux_
+} // namespace platforms
+} // namespace ableton
@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <ableton/discovery/NetworkInterface.hpp>
 #include <ableton/platforms/asio/AsioWrapper.hpp>
 #include <ableton/platforms/asio/Util.hpp>
 #include <arpa/inet.h>
@@ -75,33 +76,42 @@ struct ScanIpIfAddrs
 {
   // Scan active network interfaces and return corresponding addresses
   // for all ip-based interfaces.
-  std::vector<::asio::ip::address> operator()()
+  std::vector<discovery::NetworkInterface> operator()()
   {
-    std::vector<::asio::ip::address> addrs;
+    std::vector<discovery::NetworkInterface> interfaces;
 
     detail::GetIfAddrs getIfAddrs;
-    getIfAddrs.withIfAddrs([&addrs](const struct ifaddrs& interfaces) {
+    getIfAddrs.withIfAddrs([&interfaces](const struct ifaddrs& ifAddrs) {
       const struct ifaddrs* interface;
-      for (interface = &interfaces; interface; interface = interface->ifa_next)
+      for (interface = &ifAddrs; interface; interface = interface->ifa_next)
       {
         auto addr = reinterpret_cast<const struct sockaddr_in*>(interface->ifa_addr);
         if (addr && interface->ifa_flags & IFF_UP)
         {
+          const auto type = interface->ifa_flags & IFF_LOOPBACK
+                              ? discovery::InterfaceType::Loopback
+                            : interface->ifa_flags & IFF_POINTOPOINT
+                              ? discovery::InterfaceType::PointToPoint
+                              : discovery::InterfaceType::Other;
           if (addr->sin_family == AF_INET)
           {
             auto bytes = reinterpret_cast<const char*>(&addr->sin_addr);
-            addrs.emplace_back(asio::makeAddress<::asio::ip::address_v4>(bytes));
+            interfaces.push_back({interface->ifa_name,
+              asio::makeAddress<::asio::ip::address_v4>(bytes), type});
           }
           else if (addr->sin_family == AF_INET6)
           {
             auto addr6 = reinterpret_cast<const struct sockaddr_in6*>(addr);
             auto bytes = reinterpret_cast<const char*>(&addr6->sin6_addr);
-            addrs.emplace_back(asio::makeAddress<::asio::ip::address_v6>(bytes));
+            auto addrV6 = asio::makeAddress<::asio::ip::address_v6>(bytes);
+            // Link-local addresses are only usable together with their interface
+            addrV6.scope_id(addr6->sin6_scope_id);
+            interfaces.push_back({interface->ifa_name, std::move(addrV6), type});
           }
         }
       }
     });
-    return addrs;
+    return interfaces;
   }
 };
 
@@ -0,0 +1,155 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <atomic>
+#include <functional>
+#include <iphlpapi.h>
+#include <memory>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#pragma comment(lib, "iphlpapi.lib")
+
+namespace ableton
+{
+namespace platforms
+{
+namespace windows
+{
+
+// Reports changes of the network interfaces and their unicast addresses using the
+// IP Helper notifications. The notifications arrive on a system thread and are
+// posted to the io thread, where the handler is called. Notifications that arrive
+// before the handler has run are coalesced. If the notifications can't be
+// registered, the monitor is inactive and the interfaces have to be polled.
+class InterfaceMonitor
+{
+public:
+  InterfaceMonitor(::asio::io_service& io, std::function<void()> handler)
+    : mpImpl(std::make_shared<Impl>(io, std::move(handler)))
+  {
+    mpImpl->mpSelf = mpImpl;
+    mpImpl->registerNotifications();
+  }
+
+  InterfaceMonitor(const InterfaceMonitor&) = delete;
+  InterfaceMonitor& operator=(const InterfaceMonitor&) = delete;
+
+  InterfaceMonitor(InterfaceMonitor&& rhs)
+    : mpImpl(std::move(rhs.mpImpl))
+  {
+  }
+
+  bool isActive() const
+  {
+    return mpImpl->mInterfaceHandle && mpImpl->mAddressHandle;
+  }
+
+private:
+  struct Impl
+  {
+    Impl(::asio::io_service& io, std::function<void()> handler)
+      : mService(io)
+      , mHandler(std::move(handler))
+      , mPending(false)
+      , mInterfaceHandle(NULL)
+      , mAddressHandle(NULL)
+    {
+    }
+
+    ~Impl()
+    {
+      // Blocks until callbacks that are in progress have returned
+      cancelNotifications();
+    }
+
+    void registerNotifications()
+    {
+      if (NotifyIpInterfaceChange(
+            AF_UNSPEC, &Impl::onInterfaceChange, this, FALSE, &mInterfaceHandle)
+            != NO_ERROR
+          || NotifyUnicastIpAddressChange(
+               AF_UNSPEC, &Impl::onAddressChange, this, FALSE, &mAddressHandle)
+               != NO_ERROR)
+      {
+        cancelNotifications();
+      }
+    }
+
+    void cancelNotifications()
+    {
+      if (mInterfaceHandle)
+      {
+        CancelMibChangeNotify2(mInterfaceHandle);
+        mInterfaceHandle = NULL;
+      }
+      if (mAddressHandle)
+      {
+        CancelMibChangeNotify2(mAddressHandle);
+        mAddressHandle = NULL;
+      }
+    }
+
+    static VOID NETIOAPI_API_ onInterfaceChange(
+      PVOID context, PMIB_IPINTERFACE_ROW, MIB_NOTIFICATION_TYPE)
+    {
+      static_cast<Impl*>(context)->notify();
+    }
+
+    static VOID NETIOAPI_API_ onAddressChange(
+      PVOID context, PMIB_UNICASTIPADDRESS_ROW, MIB_NOTIFICATION_TYPE)
+    {
+      static_cast<Impl*>(context)->notify();
+    }
+
+    // Called on a system thread
+    void notify()
+    {
+      if (!mPending.exchange(true))
+      {
+        std::weak_ptr<Impl> pSelf = mpSelf;
+        mService.post([pSelf] {
+          if (auto pImpl = pSelf.lock())
+          {
+            // Reset the flag before invoking the handler so that notifications
+            // during the handler aren't lost
+            pImpl->mPending = false;
+            pImpl->mHandler();
+          }
+        });
+      }
+    }
+
+    ::asio::io_service& mService;
+    std::function<void()> mHandler;
+    std::weak_ptr<Impl> mpSelf;
+    std::atomic<bool> mPending;
+    HANDLE mInterfaceHandle;
+    HANDLE mAddressHandle;
+  };
+
+  std::shared_ptr<Impl> mpImpl;
+};
+
+} // namespace windows
+} // namespace platforms
+} // namespace ableton
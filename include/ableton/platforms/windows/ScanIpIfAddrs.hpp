@@ -19,10 +19,12 @@
 
 #pragma once
 
+#include <ableton/discovery/NetworkInterface.hpp>
 #include <ableton/platforms/asio/AsioWrapper.hpp>
 #include <ableton/platforms/asio/Util.hpp>
 #include <iphlpapi.h>
 #include <stdio.h>
+#include <string>
 #include <vector>
 #include <winsock2.h>
 #include <ws2tcpip.h>
@@ -54,8 +56,7 @@ public:
       assert(adapter_addrs);
 
       DWORD error = ::GetAdaptersAddresses(AF_UNSPEC,
-        GAA_FLAG_SKIP_ANYCAST | GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER
-          | GAA_FLAG_SKIP_FRIENDLY_NAME,
+        GAA_FLAG_SKIP_ANYCAST | GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER,
         NULL, adapter_addrs, &adapter_addrs_buffer_size);
 
       if (error == ERROR_SUCCESS)
@@ -93,22 +94,51 @@ private:
   IP_ADAPTER_ADDRESSES* adapter;
 };
 
+inline std::string toUtf8(const wchar_t* pWide)
+{
+  const int size = WideCharToMultiByte(CP_UTF8, 0, pWide, -1, NULL, 0, NULL, NULL);
+  if (size <= 1)
+  {
+    return {};
+  }
+  std::string utf8(static_cast<std::size_t>(size), '\0');
+  WideCharToMultiByte(CP_UTF8, 0, pWide, -1, &utf8[0], size, NULL, NULL);
+  utf8.resize(static_cast<std::size_t>(size - 1));
+  return utf8;
+}
+
+inline discovery::InterfaceType interfaceType(const IP_ADAPTER_ADDRESSES& adapter)
+{
+  switch (adapter.IfType)
+  {
+  case IF_TYPE_SOFTWARE_LOOPBACK:
+    return discovery::InterfaceType::Loopback;
+  case IF_TYPE_PPP:
+  case IF_TYPE_TUNNEL:
+    return discovery::InterfaceType::PointToPoint;
+  default:
+    return discovery::InterfaceType::Other;
+  }
+}
+
 } // namespace detail
 
 struct ScanIpIfAddrs
 {
   // Scan active network interfaces and return corresponding addresses
   // for all ip-based interfaces.
-  std::vector<::asio::ip::address> operator()()
+  std::vector<discovery::NetworkInterface> operator()()
   {
-    std::vector<::asio::ip::address> addrs;
+    std::vector<discovery::NetworkInterface> interfaces;
 
     detail::GetIfAddrs getIfAddrs;
-    getIfAddrs.withIfAddrs([&addrs](const IP_ADAPTER_ADDRESSES& interfaces) {
+    getIfAddrs.withIfAddrs([&interfaces](const IP_ADAPTER_ADDRESSES& adapters) {
       const IP_ADAPTER_ADDRESSES* networkInterface;
-      for (networkInterface = &interfaces; networkInterface;
+      for (networkInterface = &adapters; networkInterface;
            networkInterface = networkInterface->Next)
       {
+        const auto name = detail::toUtf8(networkInterface->FriendlyName);
+        const auto type = detail::interfaceType(*networkInterface);
         for (IP_ADAPTER_UNICAST_ADDRESS* address = networkInterface->FirstUnicastAddress;
              NULL != address; address = address->Next)
         {
@@ -119,19 +149,23 @@ struct ScanIpIfAddrs
             SOCKADDR_IN* addr4 =
               reinterpret_cast<SOCKADDR_IN*>(address->Address.lpSockaddr);
             auto bytes = reinterpret_cast<const char*>(&addr4->sin_addr);
-            addrs.emplace_back(asio::makeAddress<::asio::ip::address_v4>(bytes));
+            interfaces.push_back(
+              {name, asio::makeAddress<::asio::ip::address_v4>(bytes), type});
           }
           else if (AF_INET6 == family)
           {
             SOCKADDR_IN6* addr6 =
               reinterpret_cast<SOCKADDR_IN6*>(address->Address.lpSockaddr);
             auto bytes = reinterpret_cast<const char*>(&addr6->sin6_addr);
-            addrs.emplace_back(asio::makeAddress<::asio::ip::address_v6>(bytes));
+            auto addrV6 = asio::makeAddress<::asio::ip::address_v6>(bytes);
+            // Link-local addresses are only usable together with their interface
+            addrV6.scope_id(addr6->sin6_scope_id);
+            interfaces.push_back({name, std::move(addrV6), type});
           }
         }
       }
     });
-    return addrs;
+    return interfaces;
   }
 };
 
@@ -19,12 +19,17 @@
 
 #pragma once
 
+#include <ableton/discovery/NetworkInterface.hpp>
 #include <ableton/platforms/asio/AsioWrapper.hpp>
 #include <ableton/test/serial_io/SchedulerTree.hpp>
 #include <ableton/test/serial_io/Timer.hpp>
 #include <ableton/util/Log.hpp>
+#include <ableton/util/Trace.hpp>
 #include <chrono>
+#include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace ableton
 {
@@ -33,15 +38,48 @@ namespace test
 namespace serial_io
 {
 
+// The interface monitors of all contexts of a fixture. Monitoring is disabled by
+// default, so that the interfaces have to be polled.
+struct InterfaceMonitors
+{
+  using Handler = std::function<void()>;
+
+  bool isEnabled = false;
+  std::vector<std::weak_ptr<Handler>> handlers;
+};
+
+class InterfaceMonitor
+{
+public:
+  InterfaceMonitor() = default;
+
+  InterfaceMonitor(std::shared_ptr<InterfaceMonitors::Handler> pHandler)
+    : mpHandler(std::move(pHandler))
+  {
+  }
+
+  bool isActive() const
+  {
+    return mpHandler != nullptr;
+  }
+
+private:
+  std::shared_ptr<InterfaceMonitors::Handler> mpHandler;
+};
+
 class Context
 {
 public:
   Context(const SchedulerTree::TimePoint& now,
-    const std::vector<::asio::ip::address>& ifAddrs,
-    std::shared_ptr<SchedulerTree> pScheduler)
+    const std::vector<discovery::NetworkInterface>& interfaces,
+    std::shared_ptr<SchedulerTree> pScheduler,
+    std::shared_ptr<InterfaceMonitors> pInterfaceMonitors,
+    std::shared_ptr<std::vector<std::string>> pErrors)
     : mNow(now)
-    , mIfAddrs(ifAddrs)
+    , mInterfaces(interfaces)
     , mpScheduler(std::move(pScheduler))
+    , mpInterfaceMonitors(std::move(pInterfaceMonitors))
+    , mpErrors(std::move(pErrors))
     , mNextTimerId(0)
   {
   }
@@ -60,23 +98,43 @@ public:
 
   Context(Context&& rhs)
     : mNow(rhs.mNow)
-    , mIfAddrs(rhs.mIfAddrs)
+    , mInterfaces(rhs.mInterfaces)
     , mpScheduler(std::move(rhs.mpScheduler))
+    , mpInterfaceMonitors(std::move(rhs.mpInterfaceMonitors))
+    , mpErrors(std::move(rhs.mpErrors))
     , mLog(std::move(rhs.mLog))
     , mNextTimerId(rhs.mNextTimerId)
   {
   }
 
+  void start()
+  {
+  }
+
   void stop()
   {
   }
 
+  // The handlers are run by the scheduler of the test, see Fixture
+  bool runningInThisThread() const
+  {
+    return false;
+  }
+
   template <typename Handler>
   void async(Handler handler)
   {
     mpScheduler->async(std::move(handler));
   }
 
+  // There is no exception handler, the messages of the errors are kept for the
+  // tests, see Fixture::errors
+  template <typename Error>
+  void handleError(const Error& error)
+  {
+    mpErrors->push_back(error.what());
+  }
+
   using Timer = serial_io::Timer;
 
   Timer makeTimer()
@@ -91,16 +149,40 @@ public:
     return mLog;
   }
 
-  std::vector<::asio::ip::address> scanNetworkInterfaces()
+  using Trace = util::NullTrace;
+
+  Trace& trace()
+  {
+    return mTrace;
+  }
+
+  std::vector<discovery::NetworkInterface> scanNetworkInterfaces()
   {
-    return mIfAddrs;
+    return mInterfaces;
+  }
+
+  using InterfaceMonitor = serial_io::InterfaceMonitor;
+
+  template <typename Handler>
+  InterfaceMonitor makeInterfaceMonitor(Handler handler)
+  {
+    if (!mpInterfaceMonitors->isEnabled)
+    {
+      return {};
+    }
+    auto pHandler = std::make_shared<InterfaceMonitors::Handler>(std::move(handler));
+    mpInterfaceMonitors->handlers.push_back(pHandler);
+    return {std::move(pHandler)};
   }
 
 private:
   const SchedulerTree::TimePoint& mNow;
-  const std::vector<::asio::ip::address>& mIfAddrs;
+  const std::vector<discovery::NetworkInterface>& mInterfaces;
   std::shared_ptr<SchedulerTree> mpScheduler;
+  std::shared_ptr<InterfaceMonitors> mpInterfaceMonitors;
+  std::shared_ptr<std::vector<std::string>> mpErrors;
   Log mLog;
+  Trace mTrace;
   SchedulerTree::TimerId mNextTimerId;
 };
 
@@ -23,6 +23,8 @@
 #include <ableton/test/serial_io/Context.hpp>
 #include <chrono>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace ableton
 {
@@ -36,6 +38,8 @@ class Fixture
 public:
   Fixture()
     : mpScheduler(std::make_shared<SchedulerTree>())
+    , mpInterfaceMonitors(std::make_shared<InterfaceMonitors>())
+    , mpErrors(std::make_shared<std::vector<std::string>>())
     , mNow(std::chrono::milliseconds{123456789})
   {
   }
@@ -50,14 +54,46 @@ public:
   Fixture(Fixture&&) = delete;
   Fixture& operator=(Fixture&&) = delete;
 
-  void setNetworkInterfaces(std::vector<::asio::ip::address> ifAddrs)
+  // Changes of the network interfaces are reported to the interface monitors that
+  // are made afterwards
+  void enableInterfaceMonitoring()
   {
-    mIfAddrs = std::move(ifAddrs);
+    mpInterfaceMonitors->isEnabled = true;
+  }
+
+  void setNetworkInterfaces(const std::vector<::asio::ip::address>& ifAddrs)
+  {
+    std::vector<discovery::NetworkInterface> interfaces;
+    for (const auto& addr : ifAddrs)
+    {
+      interfaces.push_back({"", addr, discovery::InterfaceType::Other});
+    }
+    setNetworkInterfaceDetails(std::move(interfaces));
+  }
+
+  void setNetworkInterfaceDetails(std::vector<discovery::NetworkInterface> interfaces)
+  {
+    mInterfaces = std::move(interfaces);
+    for (const auto& pWeakHandler : mpInterfaceMonitors->handlers)
+    {
+      mpScheduler->async([pWeakHandler] {
+        if (auto pHandler = pWeakHandler.lock())
+        {
+          (*pHandler)();
+        }
+      });
+    }
   }
 
   Context makeIoContext()
   {
-    return {mNow, mIfAddrs, mpScheduler};
+    return {mNow, mInterfaces, mpScheduler, mpInterfaceMonitors, mpErrors};
+  }
+
+  // The errors that were passed to handleError of the contexts
+  const std::vector<std::string>& errors() const
+  {
+    return *mpErrors;
   }
 
   void flush()
@@ -83,8 +119,10 @@ public:
 
 private:
   std::shared_ptr<SchedulerTree> mpScheduler;
+  std::shared_ptr<InterfaceMonitors> mpInterfaceMonitors;
+  std::shared_ptr<std::vector<std::string>> mpErrors;
   SchedulerTree::TimePoint mNow;
-  std::vector<::asio::ip::address> mIfAddrs;
+  std::vector<discovery::NetworkInterface> mInterfaces;
 };
 
 } // namespace serial_io
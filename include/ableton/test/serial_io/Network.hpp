@@ -0,0 +1,724 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/discovery/InterfaceMonitor.hpp>
+#include <ableton/discovery/IpInterface.hpp>
+#include <ableton/discovery/NetworkInterface.hpp>
+#include <ableton/discovery/PacketFilter.hpp>
+#include <ableton/discovery/SocketOptions.hpp>
+#include <ableton/platforms/ThreadPolicy.hpp>
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <ableton/test/serial_io/SchedulerTree.hpp>
+#include <ableton/test/serial_io/Timer.hpp>
+#include <ableton/util/Exceptions.hpp>
+#include <ableton/util/Log.hpp>
+#include <ableton/util/Trace.hpp>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace ableton
+{
+namespace test
+{
+namespace serial_io
+{
+
+// An in-memory udp network of simulated hosts on a virtual clock. Datagrams are
+// delivered with the configured latency, jitter and loss, drawn from a seeded
+// generator so that a simulation runs the same way every time. All hosts share one
+// scheduler, which the network runs like a Fixture.
+class Network
+{
+public:
+  using TimePoint = SchedulerTree::TimePoint;
+
+  struct Config
+  {
+    std::chrono::microseconds latency{500};
+    // The maximum delay added to the latency, drawn uniformly for each datagram
+    std::chrono::microseconds jitter{0};
+    // The probability that a datagram is dropped
+    double lossRate = 0.;
+    // Drop all multicast datagrams, like networks that filter multicast
+    bool dropsMulticast = false;
+    // Datagrams arriving within the same interval are delivered together at its
+    // end, which keeps the number of scheduler steps bounded in large simulations
+    std::chrono::microseconds resolution{50};
+    std::uint32_t seed = 0;
+  };
+
+  // Multicast datagrams are sent once, but received and lost once per receiver
+  struct Traffic
+  {
+    friend Traffic operator-(Traffic lhs, const Traffic& rhs)
+    {
+      lhs.packetsSent -= rhs.packetsSent;
+      lhs.bytesSent -= rhs.bytesSent;
+      lhs.multicastPacketsSent -= rhs.multicastPacketsSent;
+      lhs.multicastBytesSent -= rhs.multicastBytesSent;
+      lhs.packetsReceived -= rhs.packetsReceived;
+      lhs.packetsLost -= rhs.packetsLost;
+      return lhs;
+    }
+
+    std::size_t packetsSent = 0;
+    std::size_t bytesSent = 0;
+    // The part of the sent traffic that was multicast
+    std::size_t multicastPacketsSent = 0;
+    std::size_t multicastBytesSent = 0;
+    std::size_t packetsReceived = 0;
+    std::size_t packetsLost = 0;
+  };
+
+  class Host
+  {
+  public:
+    Host(Network& network, const asio::ip::address_v4& address)
+      : mNetwork(network)
+      , mAddress(address)
+      , mNextPort(49152)
+    {
+    }
+
+    Host(const Host&) = delete;
+    Host& operator=(const Host&) = delete;
+
+    Network& network()
+    {
+      return mNetwork;
+    }
+
+    const asio::ip::address_v4& address() const
+    {
+      return mAddress;
+    }
+
+    const Traffic& traffic() const
+    {
+      return mTraffic;
+    }
+
+    // The filter changes each datagram that the host receives before its sockets
+    // see it, e.g. to hide what another version wouldn't understand
+    void setReceiveFilter(std::function<void(std::vector<uint8_t>&)> filter)
+    {
+      mReceiveFilter = std::move(filter);
+    }
+
+  private:
+    friend class Network;
+
+    Network& mNetwork;
+    asio::ip::address_v4 mAddress;
+    unsigned short mNextPort;
+    Traffic mTraffic;
+    std::function<void(std::vector<uint8_t>&)> mReceiveFilter;
+  };
+
+private:
+  // The receiving end of a socket
+  struct Receiver
+  {
+    Receiver(Host& host)
+      : mHost(host)
+    {
+    }
+
+    virtual ~Receiver() = default;
+
+    // Returns false if the socket isn't receiving
+    virtual bool deliver(
+      const asio::ip::udp::endpoint& from, const std::vector<uint8_t>& datagram) = 0;
+
+    Host& mHost;
+  };
+
+public:
+  template <std::size_t MaxPacketSize>
+  class Socket
+  {
+  public:
+    Socket(Host& host, const asio::ip::udp::endpoint& endpoint)
+      : mpImpl(std::make_shared<Impl>(host, endpoint))
+    {
+    }
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    Socket(Socket&& rhs)
+      : mpImpl(std::move(rhs.mpImpl))
+    {
+    }
+
+    std::size_t send(const uint8_t* const pData,
+      const size_t numBytes,
+      const asio::ip::udp::endpoint& to)
+    {
+      assert(numBytes < MaxPacketSize);
+      mpImpl->mHost.network().send(
+        mpImpl->mHost, mpImpl->mEndpoint, pData, numBytes, to);
+      return numBytes;
+    }
+
+    std::size_t send(const uint8_t* const pData,
+      const size_t numBytes,
+      const asio::ip::udp::endpoint& to,
+      asio::error_code& ec)
+    {
+      ec = {};
+      return send(pData, numBytes, to);
+    }
+
+    template <typename Handler>
+    void receive(Handler handler)
+    {
+      mpImpl->mHandler = std::move(handler);
+    }
+
+    asio::ip::udp::endpoint endpoint() const
+    {
+      return mpImpl->mEndpoint;
+    }
+
+    std::chrono::microseconds receiveDelay() const
+    {
+      return {};
+    }
+
+  private:
+    friend class Network;
+
+    struct Impl : Network::Receiver
+    {
+      Impl(Host& host, const asio::ip::udp::endpoint& endpoint)
+        : Receiver(host)
+        , mEndpoint(endpoint)
+      {
+      }
+
+      bool deliver(const asio::ip::udp::endpoint& from,
+        const std::vector<uint8_t>& datagram) override
+      {
+        if (!mHandler || datagram.size() > MaxPacketSize)
+        {
+          return false;
+        }
+        if (mHost.mReceiveFilter)
+        {
+          auto filtered = datagram;
+          mHost.mReceiveFilter(filtered);
+          mHandler(from, filtered.data(), filtered.data() + filtered.size());
+          return true;
+        }
+        mHandler(from, datagram.data(), datagram.data() + datagram.size());
+        return true;
+      }
+
+      asio::ip::udp::endpoint mEndpoint;
+      std::function<void(const asio::ip::udp::endpoint&, const uint8_t*, const uint8_t*)>
+        mHandler;
+    };
+
+    std::shared_ptr<Impl> mpImpl;
+  };
+
+  Network(Config config)
+    : mConfig(std::move(config))
+    , mRandom(mConfig.seed)
+    , mpScheduler(std::make_shared<SchedulerTree>())
+    , mNow(std::chrono::milliseconds{123456789})
+    , mNextTimerId(0)
+    , mNextDatagramId(0)
+    , mIsRunning(false)
+    , mDeliveryTimer(makeTimer())
+    , mIsDeliveryScheduled(false)
+  {
+  }
+
+  ~Network()
+  {
+    flush();
+  }
+
+  Network(const Network&) = delete;
+  Network& operator=(const Network&) = delete;
+
+  // Hosts live as long as the network
+  Host& addHost(const asio::ip::address_v4& address)
+  {
+    mHosts.emplace_back(new Host{*this, address});
+    return *mHosts.back();
+  }
+
+  const TimePoint& now() const
+  {
+    return mNow;
+  }
+
+  Timer makeTimer()
+  {
+    return {mNextTimerId++, mNow, mpScheduler};
+  }
+
+  template <typename Handler>
+  void async(Handler handler)
+  {
+    mpScheduler->async(std::move(handler));
+    // Calls from outside a handler are processed right away, as if the io thread
+    // had been waiting for them
+    if (!mIsRunning)
+    {
+      flush();
+    }
+  }
+
+  // Applies to the datagrams sent from now on, e.g. 1 cuts the network off
+  void setLossRate(const double lossRate)
+  {
+    mConfig.lossRate = lossRate;
+  }
+
+  void flush()
+  {
+    const RunningGuard guard{*this};
+    mpScheduler->run();
+  }
+
+  template <typename T, typename Rep>
+  void advanceTime(std::chrono::duration<T, Rep> duration)
+  {
+    const RunningGuard guard{*this};
+    const auto target = mNow + duration;
+    mpScheduler->run();
+    auto nextTimer = mpScheduler->nextTimerExpiration();
+    while (nextTimer <= target)
+    {
+      mNow = nextTimer;
+      mpScheduler->triggerTimersUntil(mNow);
+      mpScheduler->run();
+      nextTimer = mpScheduler->nextTimerExpiration();
+    }
+    mNow = target;
+  }
+
+  template <std::size_t MaxPacketSize>
+  Socket<MaxPacketSize> openUnicastSocket(Host& host)
+  {
+    const auto endpoint = asio::ip::udp::endpoint{host.mAddress, host.mNextPort++};
+    auto socket = Socket<MaxPacketSize>{host, endpoint};
+    mUnicastReceivers[socket.endpoint()] = socket.mpImpl;
+    return socket;
+  }
+
+  template <std::size_t MaxPacketSize>
+  Socket<MaxPacketSize> openMulticastSocket(Host& host)
+  {
+    auto socket = Socket<MaxPacketSize>{host, discovery::multicastEndpointV4()};
+    mMulticastReceivers.push_back(socket.mpImpl);
+    // Like a socket bound to the discovery port of all addresses, it also receives
+    // unicast datagrams sent to that port of its host
+    mUnicastReceivers[asio::ip::udp::endpoint{
+      host.mAddress, discovery::multicastEndpointV4().port()}] = socket.mpImpl;
+    return socket;
+  }
+
+  // Delivers a datagram that comes from outside of the simulated hosts, e.g. one
+  // that was captured on a real network, right away. Datagrams to the multicast
+  // endpoint reach all multicast sockets. The traffic of the receiving hosts counts
+  // them as received.
+  void inject(const asio::ip::udp::endpoint& from,
+    const asio::ip::udp::endpoint& to,
+    const std::vector<uint8_t>& datagram)
+  {
+    const RunningGuard guard{*this};
+    const auto deliverTo = [&](const std::weak_ptr<Receiver>& pWeakReceiver) {
+      const auto pReceiver = pWeakReceiver.lock();
+      if (pReceiver && pReceiver->deliver(from, datagram))
+      {
+        ++pReceiver->mHost.mTraffic.packetsReceived;
+      }
+    };
+
+    if (to == discovery::multicastEndpointV4())
+    {
+      // The handlers may open sockets, so the receivers are copied first
+      const auto receivers = mMulticastReceivers;
+      for (const auto& pReceiver : receivers)
+      {
+        deliverTo(pReceiver);
+      }
+    }
+    else
+    {
+      const auto it = mUnicastReceivers.find(to);
+      if (it != mUnicastReceivers.end())
+      {
+        deliverTo(it->second);
+      }
+    }
+    mpScheduler->run();
+  }
+
+  // The sum of the traffic of all hosts
+  Traffic traffic() const
+  {
+    auto total = Traffic{};
+    for (const auto& pHost : mHosts)
+    {
+      total.packetsSent += pHost->mTraffic.packetsSent;
+      total.bytesSent += pHost->mTraffic.bytesSent;
+      total.multicastPacketsSent += pHost->mTraffic.multicastPacketsSent;
+      total.multicastBytesSent += pHost->mTraffic.multicastBytesSent;
+      total.packetsReceived += pHost->mTraffic.packetsReceived;
+      total.packetsLost += pHost->mTraffic.packetsLost;
+    }
+    return total;
+  }
+
+private:
+  struct Datagram
+  {
+    friend bool operator>(const Datagram& lhs, const Datagram& rhs)
+    {
+      return std::tie(lhs.arrival, lhs.id) > std::tie(rhs.arrival, rhs.id);
+    }
+
+    TimePoint arrival;
+    std::uint64_t id;
+    std::weak_ptr<Receiver> pReceiver;
+    asio::ip::udp::endpoint from;
+    std::shared_ptr<const std::vector<uint8_t>> pData;
+  };
+
+  struct RunningGuard
+  {
+    RunningGuard(Network& network)
+      : mNetwork(network)
+      , mWasRunning(network.mIsRunning)
+    {
+      mNetwork.mIsRunning = true;
+    }
+
+    ~RunningGuard()
+    {
+      mNetwork.mIsRunning = mWasRunning;
+    }
+
+    Network& mNetwork;
+    bool mWasRunning;
+  };
+
+  void send(Host& host,
+    const asio::ip::udp::endpoint& from,
+    const uint8_t* const pData,
+    const size_t numBytes,
+    const asio::ip::udp::endpoint& to)
+  {
+    ++host.mTraffic.packetsSent;
+    host.mTraffic.bytesSent += numBytes;
+
+    const auto pDatagram =
+      std::make_shared<const std::vector<uint8_t>>(pData, pData + numBytes);
+    if (to == discovery::multicastEndpointV4())
+    {
+      ++host.mTraffic.multicastPacketsSent;
+      host.mTraffic.multicastBytesSent += numBytes;
+      // Like with multicast loopback, the sending host receives its own datagrams
+      auto it = mMulticastReceivers.begin();
+      while (it != mMulticastReceivers.end())
+      {
+        if (it->expired())
+        {
+          it = mMulticastReceivers.erase(it);
+        }
+        else if (mConfig.dropsMulticast)
+        {
+          ++host.mTraffic.packetsLost;
+          ++it;
+        }
+        else
+        {
+          transmit(host, from, pDatagram, *it++);
+        }
+      }
+    }
+    else
+    {
+      const auto it = mUnicastReceivers.find(to);
+      if (it != mUnicastReceivers.end())
+      {
+        transmit(host, from, pDatagram, it->second);
+      }
+    }
+  }
+
+  void transmit(Host& host,
+    const asio::ip::udp::endpoint& from,
+    std::shared_ptr<const std::vector<uint8_t>> pData,
+    std::weak_ptr<Receiver> pReceiver)
+  {
+    using namespace std::chrono;
+
+    if (mConfig.lossRate > 0. && std::bernoulli_distribution{mConfig.lossRate}(mRandom))
+    {
+      ++host.mTraffic.packetsLost;
+      return;
+    }
+
+    auto delay = mConfig.latency;
+    if (mConfig.jitter > microseconds{0})
+    {
+      delay += microseconds{
+        std::uniform_int_distribution<microseconds::rep>{0, mConfig.jitter.count()}(
+          mRandom)};
+    }
+
+    // Round the arrival up to the resolution of the network. Datagrams always take
+    // some time, so that exchanges between hosts can't stall the clock.
+    const auto resolution = (std::max)(mConfig.resolution.count(), microseconds::rep{1});
+    const auto now = duration_cast<microseconds>(mNow.time_since_epoch()).count();
+    const auto arrival = now + delay.count();
+    const auto slot =
+      (std::max)(now / resolution + 1, (arrival + resolution - 1) / resolution);
+    mInFlight.push(Datagram{TimePoint{duration_cast<TimePoint::duration>(
+                              microseconds{slot * resolution})},
+      mNextDatagramId++, std::move(pReceiver), from, std::move(pData)});
+    scheduleDelivery();
+  }
+
+  void scheduleDelivery()
+  {
+    if (mInFlight.empty())
+    {
+      return;
+    }
+
+    const auto nextArrival = mInFlight.top().arrival;
+    if (!mIsDeliveryScheduled || nextArrival < mScheduledDelivery)
+    {
+      mIsDeliveryScheduled = true;
+      mScheduledDelivery = nextArrival;
+      mDeliveryTimer.expires_at(nextArrival);
+      mDeliveryTimer.async_wait([this](const Timer::ErrorCode e) {
+        if (!e)
+        {
+          mIsDeliveryScheduled = false;
+          deliver();
+        }
+      });
+    }
+  }
+
+  void deliver()
+  {
+    while (!mInFlight.empty() && mInFlight.top().arrival <= mNow)
+    {
+      const auto datagram = mInFlight.top();
+      mInFlight.pop();
+      const auto pReceiver = datagram.pReceiver.lock();
+      if (pReceiver && pReceiver->deliver(datagram.from, *datagram.pData))
+      {
+        ++pReceiver->mHost.mTraffic.packetsReceived;
+      }
+    }
+    scheduleDelivery();
+  }
+
+  Config mConfig;
+  std::mt19937 mRandom;
+  std::shared_ptr<SchedulerTree> mpScheduler;
+  TimePoint mNow;
+  SchedulerTree::TimerId mNextTimerId;
+  std::uint64_t mNextDatagramId;
+  bool mIsRunning;
+  std::vector<std::unique_ptr<Host>> mHosts;
+  std::map<asio::ip::udp::endpoint, std::weak_ptr<Receiver>> mUnicastReceivers;
+  std::vector<std::weak_ptr<Receiver>> mMulticastReceivers;
+  std::priority_queue<Datagram, std::vector<Datagram>, std::greater<Datagram>> mInFlight;
+  Timer mDeliveryTimer;
+  bool mIsDeliveryScheduled;
+  TimePoint mScheduledDelivery;
+};
+
+// The io context of a simulated host. All hosts run on the scheduler of their
+// network, which takes the place of the io thread.
+class HostContext
+{
+public:
+  template <typename ExceptionHandler>
+  HostContext(Network::Host& host, ExceptionHandler handler)
+    : mHost(host)
+    , mErrorHandler(std::move(handler))
+  {
+  }
+
+  HostContext(const HostContext&) = delete;
+  HostContext& operator=(const HostContext&) = delete;
+
+  HostContext(HostContext&& rhs)
+    : mHost(rhs.mHost)
+    , mErrorHandler(std::move(rhs.mErrorHandler))
+  {
+  }
+
+  void start()
+  {
+  }
+
+  void stop()
+  {
+  }
+
+  bool runningInThisThread() const
+  {
+    return false;
+  }
+
+  template <typename Handler>
+  void async(Handler handler)
+  {
+    mHost.network().async(std::move(handler));
+  }
+
+  // Exceptions that escape a handler escape the scheduler of the network, errors
+  // that are passed here reach the exception handler
+  template <typename Error>
+  void handleError(const Error& error)
+  {
+    mErrorHandler(error);
+  }
+
+  using Timer = serial_io::Timer;
+
+  Timer makeTimer()
+  {
+    return mHost.network().makeTimer();
+  }
+
+  template <typename Callback, typename Duration>
+  struct LockFreeCallbackDispatcher
+  {
+    LockFreeCallbackDispatcher(Callback callback, Duration, HostContext&)
+      : mCallback(std::move(callback))
+    {
+    }
+
+    void invoke()
+    {
+      mCallback();
+    }
+
+    void setFallbackPeriod(Duration)
+    {
+    }
+
+    Callback mCallback;
+  };
+
+  using Log = util::NullLog;
+
+  Log& log()
+  {
+    return mLog;
+  }
+
+  using Trace = util::NullTrace;
+
+  Trace& trace()
+  {
+    return mTrace;
+  }
+
+  template <std::size_t MaxPacketSize>
+  using Socket = Network::Socket<MaxPacketSize>;
+
+  template <std::size_t MaxPacketSize>
+  Socket<MaxPacketSize> openUnicastSocket(const asio::ip::address&,
+    discovery::TrafficClass = discovery::TrafficClass::Discovery)
+  {
+    return mHost.network().openUnicastSocket<MaxPacketSize>(mHost);
+  }
+
+  template <std::size_t MaxPacketSize>
+  Socket<MaxPacketSize> openMulticastSocket(const asio::ip::address&)
+  {
+    return mHost.network().openMulticastSocket<MaxPacketSize>(mHost);
+  }
+
+  // The simulated network delivers all packets, the messenger drops them itself
+  template <std::size_t MaxPacketSize>
+  void setPacketFilter(Socket<MaxPacketSize>&, const discovery::PacketFilter&)
+  {
+  }
+
+  using ResponderContext = HostContext;
+
+  ResponderContext& responderContext()
+  {
+    return *this;
+  }
+
+  // Shards run on the scheduler of the network as well, so the handlers that they
+  // post to each other interleave like they would on different threads
+  template <typename ExceptionHandler>
+  HostContext makeShard(ExceptionHandler handler, const std::string&)
+  {
+    return HostContext{mHost, std::move(handler)};
+  }
+
+  // The simulated hosts have no threads to apply the policy to
+  void setThreadPolicy(const platforms::ThreadPolicy&)
+  {
+  }
+
+  std::vector<discovery::NetworkInterface> scanNetworkInterfaces()
+  {
+    return {{"sim0", mHost.address(), discovery::InterfaceType::Other}};
+  }
+
+  using InterfaceMonitor = discovery::NullInterfaceMonitor;
+
+  template <typename Handler>
+  InterfaceMonitor makeInterfaceMonitor(Handler)
+  {
+    return {};
+  }
+
+private:
+  Network::Host& mHost;
+  util::ErrorHandler mErrorHandler;
+  Log mLog;
+  Trace mTrace;
+};
+
+} // namespace serial_io
+} // namespace test
+} // namespace ableton
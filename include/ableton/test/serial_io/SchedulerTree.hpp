@@ -53,7 +53,8 @@ public:
   void setTimer(const TimerId timerId, const TimePoint expiration, Handler handler)
   {
     using namespace std;
-    mTimers[make_pair(std::move(expiration), timerId)] = std::move(handler);
+    mTimers[make_pair(expiration, timerId)] = std::move(handler);
+    mTimerExpirations[timerId] = expiration;
   }
 
   void cancelTimer(const TimerId timerId);
@@ -95,6 +96,8 @@ private:
   using TimerHandler = std::function<void(TimerErrorCode)>;
   using TimerMap = std::map<std::pair<TimePoint, TimerId>, TimerHandler>;
   TimerMap mTimers;
+  // The expiration of each timer in mTimers, so that cancelling doesn't need a search
+  std::map<TimerId, TimePoint> mTimerExpirations;
   std::list<std::function<void()>> mPendingHandlers;
   std::list<std::weak_ptr<SchedulerTree>> mChildren;
 };
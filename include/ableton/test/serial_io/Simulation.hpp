@@ -0,0 +1,403 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/discovery/v1/Messages.hpp>
+#include <ableton/link/Controller.hpp>
+#include <ableton/link/ClockDomain.hpp>
+#include <ableton/link/Optional.hpp>
+#include <ableton/link/Phase.hpp>
+#include <ableton/test/serial_io/Network.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace ableton
+{
+namespace test
+{
+namespace serial_io
+{
+
+// Runs a session of complete Link controllers, each on its own host of a simulated
+// network. The simulation is deterministic for a given config, so that changes to
+// the protocol can be compared by their effect on convergence, traffic and
+// accuracy.
+class Simulation
+{
+public:
+  struct Config
+  {
+    std::size_t numPeers = 100;
+    Network::Config network;
+    // The clock of each host runs fast or slow by up to this rate, e.g. 5e-5 for
+    // 50 ppm
+    double maxClockDrift = 5e-5;
+    // Each reading of a host clock is late by up to this much, like the reading of
+    // a thread that may be preempted right after it
+    std::chrono::microseconds clockJitter{0};
+    // Each peer is enabled this long after the previous one
+    std::chrono::microseconds joinInterval{0};
+    // Peers are in sync when their phases are at most this far apart
+    std::chrono::microseconds phaseTolerance{1000};
+    // The quantum at which the phases of the peers are compared
+    double quantum = 4.;
+    // All peers read clocks of one identified clock domain, like apps on the same
+    // machine or hosts that are disciplined by PTP, so that they don't need to
+    // measure each other
+    bool sharedClockDomain = false;
+    // The last of the peers receive discovery messages like versions that don't
+    // know tempo ramps, which skip the entries that carry them
+    std::size_t numLegacyPeers = 0;
+  };
+
+  struct Report
+  {
+    std::size_t numPeers;
+    std::chrono::microseconds duration;
+    // The time from enabling the last peer until all peers were in one session
+    // and in sync, if that has happened by the end of the run
+    link::Optional<std::chrono::microseconds> convergenceTime;
+    Network::Traffic traffic;
+    // The spread of the phases of all peers at the end, in microseconds at the
+    // tempo of the first peer
+    std::chrono::microseconds phaseError;
+    // The spread of the ghost time of all peers at the end
+    std::chrono::microseconds ghostTimeError;
+
+    double packetsPerPeerPerSecond() const
+    {
+      return perPeerPerSecond(traffic.packetsSent);
+    }
+
+    double bytesPerPeerPerSecond() const
+    {
+      return perPeerPerSecond(traffic.bytesSent);
+    }
+
+    double perPeerPerSecond(const std::size_t count) const
+    {
+      const auto seconds = static_cast<double>(duration.count()) / 1e6;
+      return static_cast<double>(count) / static_cast<double>(numPeers) / seconds;
+    }
+  };
+
+  // The clock of a host, which drifts relative to the time of the network
+  struct Clock
+  {
+    std::chrono::microseconds micros() const
+    {
+      using namespace std::chrono;
+      const auto elapsed = duration_cast<microseconds>(pNetwork->now() - origin);
+      const auto late = pJitter
+                          ? microseconds{std::uniform_int_distribution<microseconds::rep>{
+                            0, jitter.count()}(*pJitter)}
+                          : microseconds{0};
+      return offset + elapsed + late
+             + microseconds{std::llround(static_cast<double>(elapsed.count()) * drift)};
+    }
+
+    link::ClockDomainId clockDomainId() const
+    {
+      return id;
+    }
+
+    const Network* pNetwork;
+    Network::TimePoint origin;
+    std::chrono::microseconds offset;
+    double drift;
+    link::ClockDomainId id;
+    // Shared by the copies of the clock, so that the readings of the controller
+    // and of the simulation draw from one sequence
+    std::shared_ptr<std::mt19937> pJitter;
+    std::chrono::microseconds jitter;
+  };
+
+  // Node ids are drawn from the generator of the simulation that is running, so
+  // that they don't depend on other simulations in the same process
+  struct Random
+  {
+    static std::mt19937*& generator()
+    {
+      static std::mt19937 outsideOfSimulations;
+      static std::mt19937* pGenerator = &outsideOfSimulations;
+      return pGenerator;
+    }
+
+    uint8_t operator()()
+    {
+      return static_cast<uint8_t>(
+        std::uniform_int_distribution<unsigned>{33, 126}(*generator()));
+    }
+  };
+
+  using Controller = link::Controller<link::PeerCountCallback,
+    link::TempoCallback,
+    link::StartStopStateCallback,
+    Clock,
+    Random,
+    HostContext>;
+
+  Simulation(Config config)
+    : mConfig(std::move(config))
+    , mNetwork(mConfig.network)
+    , mNodeIdGenerator(mConfig.network.seed)
+    , mNumEnabled(0)
+    , mElapsed(0)
+    , mLastJoin(0)
+  {
+    using namespace std::chrono;
+
+    const Running running{*this};
+    std::mt19937 random(mConfig.network.seed);
+    std::uniform_real_distribution<double> drift{-mConfig.maxClockDrift,
+      mConfig.maxClockDrift};
+    std::uniform_int_distribution<microseconds::rep> offset{0, 3600 * 1000 * 1000LL};
+    std::uniform_real_distribution<double> tempo{60., 180.};
+
+    for (std::size_t i = 0; i < mConfig.numPeers; ++i)
+    {
+      auto& host = mNetwork.addHost(asio::ip::address_v4{
+        static_cast<asio::ip::address_v4::uint_type>((10u << 24) + 1u + i)});
+      mClocks.push_back(Clock{
+        &mNetwork, mNetwork.now(), microseconds{offset(random)}, drift(random), {}, {},
+        mConfig.clockJitter});
+      if (mConfig.sharedClockDomain)
+      {
+        mClocks.back() = mClocks.front();
+        mClocks.back().id = link::ClockDomainId{{1}};
+      }
+      if (mConfig.clockJitter > microseconds{0})
+      {
+        mClocks.back().pJitter = std::make_shared<std::mt19937>(random());
+      }
+      if (i + mConfig.numLegacyPeers >= mConfig.numPeers)
+      {
+        host.setReceiveFilter([](std::vector<uint8_t>& datagram) {
+          removeEntries(datagram, link::TempoRampEntry::key);
+        });
+      }
+      mControllers.emplace_back(new Controller{link::Tempo{tempo(random)},
+        [](std::size_t) {}, [](link::Tempo) {}, [](bool) {}, mClocks.back(), host});
+    }
+  }
+
+  ~Simulation()
+  {
+    // The remaining peers reset their state when the others leave
+    const Running running{*this};
+    mControllers.clear();
+  }
+
+  Simulation(const Simulation&) = delete;
+  Simulation& operator=(const Simulation&) = delete;
+
+  Network& network()
+  {
+    return mNetwork;
+  }
+
+  Controller& controller(const std::size_t i)
+  {
+    return *mControllers[i];
+  }
+
+  const Clock& clock(const std::size_t i) const
+  {
+    return mClocks[i];
+  }
+
+  // Runs the simulation for the given duration, continuing where a previous run
+  // stopped. The traffic of the report is the traffic of this run.
+  Report run(const std::chrono::microseconds duration,
+    const std::chrono::microseconds samplePeriod = std::chrono::milliseconds{10})
+  {
+    using namespace std::chrono;
+
+    const Running running{*this};
+    const auto trafficBefore = mNetwork.traffic();
+    const auto end = mElapsed + duration;
+    while (mElapsed < end)
+    {
+      while (mNumEnabled < mControllers.size()
+             && static_cast<microseconds::rep>(mNumEnabled) * mConfig.joinInterval.count()
+                  <= mElapsed.count())
+      {
+        mControllers[mNumEnabled++]->enable(true);
+        mLastJoin = mElapsed;
+        mConvergenceTime = {};
+      }
+
+      if (!mConvergenceTime && mNumEnabled == mControllers.size() && isInSync())
+      {
+        mConvergenceTime = link::Optional<microseconds>{mElapsed - mLastJoin};
+      }
+
+      mNetwork.advanceTime(samplePeriod);
+      mElapsed += samplePeriod;
+    }
+
+    auto report = Report{};
+    report.numPeers = mConfig.numPeers;
+    report.duration = duration;
+    report.convergenceTime = mConvergenceTime;
+    report.traffic = mNetwork.traffic() - trafficBefore;
+    report.phaseError = phaseError();
+    report.ghostTimeError = ghostTimeError();
+    return report;
+  }
+
+  // True if all peers are enabled, in one session and in sync
+  bool isInSync() const
+  {
+    const auto allInSession = std::all_of(mControllers.begin(), mControllers.end(),
+      [this](const std::unique_ptr<Controller>& pController) {
+        return pController->isEnabled()
+               && pController->numPeers() + 1 == mControllers.size();
+      });
+    return allInSession && phaseError() <= mConfig.phaseTolerance;
+  }
+
+  // The spread of the phases of all peers at the current time of the network, in
+  // microseconds at the tempo of the first peer
+  std::chrono::microseconds phaseError() const
+  {
+    if (mControllers.empty())
+    {
+      return {};
+    }
+
+    // Phases are compared relative to the first peer, wrapped into half a quantum
+    const auto quantum = link::Beats{mConfig.quantum};
+    const auto halfQuantum = 0.5 * mConfig.quantum;
+    auto reference = 0.;
+    auto minDiff = 0.;
+    auto maxDiff = 0.;
+    for (std::size_t i = 0; i < mControllers.size(); ++i)
+    {
+      const auto timeline = mControllers[i]->clientState().timeline;
+      const auto phase =
+        link::phase(link::toPhaseEncodedBeats(timeline, mClocks[i].micros(), quantum),
+          quantum)
+          .floating();
+      if (i == 0)
+      {
+        reference = phase;
+        continue;
+      }
+      auto diff = phase - reference;
+      diff -= mConfig.quantum * std::floor((diff + halfQuantum) / mConfig.quantum);
+      minDiff = (std::min)(minDiff, diff);
+      maxDiff = (std::max)(maxDiff, diff);
+    }
+
+    const auto tempo = mControllers.front()->clientState().timeline.tempo;
+    return std::chrono::microseconds{std::llround(
+      (maxDiff - minDiff) * static_cast<double>(tempo.microsPerBeat().count()))};
+  }
+
+  // The spread of the ghost times of all peers at the current time of the network.
+  // The peers of a session should all map this moment to the same ghost time, so
+  // this is the error of their GhostXForms against the ground truth.
+  std::chrono::microseconds ghostTimeError() const
+  {
+    using namespace std::chrono;
+
+    auto minGhost = microseconds::max();
+    auto maxGhost = microseconds::min();
+    for (std::size_t i = 0; i < mControllers.size(); ++i)
+    {
+      const auto ghost = mControllers[i]->ghostXForm().hostToGhost(mClocks[i].micros());
+      minGhost = (std::min)(minGhost, ghost);
+      maxGhost = (std::max)(maxGhost, ghost);
+    }
+    return mControllers.empty() ? microseconds{0} : maxGhost - minGhost;
+  }
+
+private:
+  // Removes the payload entries with the key from a v1 discovery message
+  static void removeEntries(std::vector<uint8_t>& datagram, const std::int32_t key)
+  {
+    const auto header = discovery::v1::parseMessageHeader<link::NodeId>(
+      datagram.cbegin(), datagram.cend());
+    if (header.first.messageType == discovery::v1::kInvalid)
+    {
+      return;
+    }
+
+    auto entryBegin = header.second - datagram.cbegin();
+    while (entryBegin < static_cast<std::ptrdiff_t>(datagram.size()))
+    {
+      auto entry = discovery::PayloadEntryHeader{};
+      auto valueBegin = datagram.cbegin() + entryBegin;
+      if (!discovery::PayloadEntryHeader::tryFromNetworkByteStream(
+            valueBegin, datagram.cend(), entry)
+          || entry.size > static_cast<std::size_t>(datagram.cend() - valueBegin))
+      {
+        return;
+      }
+
+      const auto valueEnd = valueBegin + entry.size;
+      if (entry.key == static_cast<discovery::PayloadEntryHeader::Key>(key))
+      {
+        datagram.erase(datagram.cbegin() + entryBegin, valueEnd);
+      }
+      else
+      {
+        entryBegin = valueEnd - datagram.cbegin();
+      }
+    }
+  }
+
+  struct Running
+  {
+    Running(Simulation& simulation)
+      : mpPrevious(Random::generator())
+    {
+      Random::generator() = &simulation.mNodeIdGenerator;
+    }
+
+    ~Running()
+    {
+      Random::generator() = mpPrevious;
+    }
+
+    std::mt19937* mpPrevious;
+  };
+
+  Config mConfig;
+  Network mNetwork;
+  std::mt19937 mNodeIdGenerator;
+  std::vector<Clock> mClocks;
+  std::vector<std::unique_ptr<Controller>> mControllers;
+  std::size_t mNumEnabled;
+  std::chrono::microseconds mElapsed;
+  std::chrono::microseconds mLastJoin;
+  link::Optional<std::chrono::microseconds> mConvergenceTime;
+};
+
+} // namespace serial_io
+} // namespace test
+} // namespace ableton
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <ableton/test/serial_io/SchedulerTree.hpp>
+#include <ableton/util/Exceptions.hpp>
 
 namespace ableton
 {
@@ -65,7 +66,7 @@ struct Timer
   {
     if (t < mNow)
     {
-      throw std::runtime_error("Setting timer in the past");
+      LINK_THROW(std::runtime_error("Setting timer in the past"));
     }
     else
     {
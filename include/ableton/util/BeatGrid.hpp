@@ -0,0 +1,143 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#pragma once
+
+#include <ableton/util/SampleTiming.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+namespace ableton
+{
+namespace util
+{
+
+/*! A grid of events that occur every interval beats with respect to the
+ *  given quantum, shifted by offset beats. The events are at the beat
+ *  values offset + k * interval of SessionState::beatAtTime(t, quantum)
+ *  for all integers k, so if the quantum is a multiple of the interval,
+ *  the grid is aligned to the session phase. For example, every 1/16 note
+ *  of a 4/4 bar is BeatGrid{0.25, 4.}.
+ */
+struct BeatGrid
+{
+  BeatGrid(const double interval_, const double quantum_, const double offset_ = 0.)
+    : interval(interval_)
+    , quantum(quantum_)
+    , offset(offset_)
+  {
+  }
+
+  double interval;
+  double quantum;
+  double offset;
+};
+
+/*! An event of the grid with the given index in the list of grids, at the
+ *  given sample of a buffer and with the grid beat value it represents.
+ */
+struct BeatGridEvent
+{
+  std::size_t grid;
+  std::size_t sample;
+  double beat;
+};
+
+/*! Write the events of the given grids that fall into a buffer of numSamples
+ *  samples starting at timing.mBufferBegin to out and return the end of the
+ *  output. Sample i of the buffer is at the time
+ *  mBufferBegin + round(i * 1e6 / mSampleRate) microseconds, like in
+ *  SessionState::beatsAndPhasesAtTimes, and an event is reported at the
+ *  first sample that reaches its beat. The sample preceding the first one
+ *  is at mBufferBegin - round(1e6 / mSampleRate). This gives the same
+ *  samples as detecting the event by evaluating every sample, but the
+ *  timeline is only evaluated a few times per grid and event. Events are
+ *  written grid by grid, each grid in ascending order. Grids with an
+ *  interval that is not positive are skipped.
+ */
+template <typename SessionState, typename GridIt, typename OutputIt>
+OutputIt beatGridEvents(const SessionState& sessionState,
+  const SampleTiming timing,
+  const std::size_t numSamples,
+  const GridIt gridsBegin,
+  const GridIt gridsEnd,
+  OutputIt out)
+{
+  using namespace std::chrono;
+
+  if (numSamples == 0)
+  {
+    return out;
+  }
+
+  const auto microsPerSample = 1e6 / timing.mSampleRate;
+  const auto timeAt = [&](const std::ptrdiff_t sample) {
+    return timing.mBufferBegin
+           + microseconds{std::llround(static_cast<double>(sample) * microsPerSample)};
+  };
+  const auto lastSample = static_cast<std::ptrdiff_t>(numSamples) - 1;
+
+  std::size_t gridIndex = 0;
+  for (auto it = gridsBegin; it != gridsEnd; ++it, ++gridIndex)
+  {
+    const BeatGrid& grid = *it;
+    if (!(grid.interval > 0.))
+    {
+      continue;
+    }
+    const auto beatAt = [&](const std::ptrdiff_t sample) {
+      return sessionState.beatAtTime(timeAt(sample), grid.quantum);
+    };
+
+    // Events with beats in (beatAt(-1), beatAt(lastSample)] fall into the buffer
+    const auto beginBeat = beatAt(-1);
+    const auto endBeat = beatAt(lastSample);
+    auto k = std::floor((beginBeat - grid.offset) / grid.interval);
+    while (grid.offset + k * grid.interval <= beginBeat)
+    {
+      ++k;
+    }
+    for (auto beat = grid.offset + k * grid.interval; beat <= endBeat;
+         ++k, beat = grid.offset + k * grid.interval)
+    {
+      // Estimate the sample from the time of the beat and correct the
+      // estimate by the few samples it may be off due to rounding
+      const auto time = sessionState.timeAtBeat(beat, grid.quantum);
+      auto sample = static_cast<std::ptrdiff_t>(std::ceil(
+        static_cast<double>((time - timing.mBufferBegin).count()) / microsPerSample));
+      sample = sample < 0 ? 0 : (sample > lastSample ? lastSample : sample);
+      while (sample > 0 && beatAt(sample - 1) >= beat)
+      {
+        --sample;
+      }
+      while (beatAt(sample) < beat)
+      {
+        ++sample;
+      }
+      *out = BeatGridEvent{gridIndex, static_cast<std::size_t>(sample), beat};
+      ++out;
+    }
+  }
+  return out;
+}
+
+} // namespace util
+} // namespace ableton
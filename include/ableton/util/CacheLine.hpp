@@ -0,0 +1,44 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace ableton
+{
+namespace util
+{
+
+// The size of the cache lines of the processors Link runs on. C++11 has no
+// std::hardware_destructive_interference_size.
+static constexpr std::size_t kCacheLineSize = 64;
+
+// Separates the members of an object that are written by different threads, so
+// that they don't share a cache line. Members on either side of the padding are
+// at least a cache line apart whatever the alignment of the object. Aligning the
+// members instead would need an operator new for over-aligned types, which only
+// exists since C++17.
+struct CacheLinePadding
+{
+  char bytes[kCacheLineSize];
+};
+
+} // namespace util
+} // namespace ableton
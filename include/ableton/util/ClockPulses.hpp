@@ -0,0 +1,222 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/util/BeatGrid.hpp>
+#include <ableton/util/SampleTiming.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+namespace ableton
+{
+namespace util
+{
+
+/*! A clock pulse of a ClockPulseGenerator, or the start or stop of the
+ *  transport at the given sample of a buffer. The beat of a pulse is its
+ *  grid beat, the beat of a start is the one of the pulse it precedes and
+ *  the beat of a stop is the beat at its sample.
+ */
+struct ClockEvent
+{
+  enum class Type
+  {
+    Pulse,
+    Start,
+    Stop
+  };
+
+  Type type;
+  std::size_t sample;
+  double beat;
+};
+
+namespace detail
+{
+
+// Passes the events that beatGridEvents writes to a function
+template <typename Fn>
+struct BeatGridEventSink
+{
+  BeatGridEventSink& operator*()
+  {
+    return *this;
+  }
+
+  BeatGridEventSink& operator++()
+  {
+    return *this;
+  }
+
+  BeatGridEventSink& operator=(const BeatGridEvent& event)
+  {
+    (*pFn)(event);
+    return *this;
+  }
+
+  Fn* pFn;
+};
+
+} // namespace detail
+
+/*! Turns the timeline and the start/stop state of a SessionState into the
+ *  clock pulses of ppqn pulses per quarter note, e.g. 24 for MIDI clock, for
+ *  a buffer at a time. The pulses are aligned to the phase of the quantum
+ *  and are reported at the same samples as beatGridEvents would report
+ *  them, which only evaluates the timeline a few times per pulse. Each
+ *  buffer is placed by its own SampleTiming, so there is no error that
+ *  accumulates over long runs as with counting samples.
+ *
+ *  A Start event is reported right before the first pulse at or after the
+ *  time when the transport starts playing, like a MIDI Start followed by the
+ *  first clock, and a Stop event at the first sample at or after the time
+ *  when it stops. By default, pulses are only reported while playing, with
+ *  pulsesWhileStopped they run all the time, like a MIDI clock that keeps
+ *  running for the tempo. Processing is realtime-safe, but one generator
+ *  must only be used by one thread at a time.
+ */
+class ClockPulseGenerator
+{
+public:
+  ClockPulseGenerator(const double ppqn = 24.,
+    const double quantum = 4.,
+    const bool pulsesWhileStopped = false)
+    : mGrid(ppqn > 0. ? 1. / ppqn : 0., quantum)
+    , mPulsesWhileStopped(pulsesWhileStopped)
+    , mIsPlaying(false)
+    , mIsStartPending(false)
+  {
+  }
+
+  /*! Write the events of the buffer of numSamples samples starting at
+   *  timing.mBufferBegin to out, ordered by sample, and return the end of
+   *  the output. Each pulse may be preceded by a Start at the same sample.
+   */
+  template <typename SessionState, typename OutputIt>
+  OutputIt operator()(const SessionState& sessionState,
+    const SampleTiming timing,
+    const std::size_t numSamples,
+    OutputIt out)
+  {
+    using namespace std::chrono;
+
+    if (numSamples == 0)
+    {
+      return out;
+    }
+
+    const auto microsPerSample = 1e6 / timing.mSampleRate;
+    const auto timeAt = [&](const std::ptrdiff_t sample) {
+      return timing.mBufferBegin
+             + microseconds{std::llround(static_cast<double>(sample) * microsPerSample)};
+    };
+    const auto lastSample = static_cast<std::ptrdiff_t>(numSamples) - 1;
+
+    // The transport changes at the first sample that reaches the time of the change,
+    // changes after the buffer are handled with a later one
+    const auto isPlaying = sessionState.isPlaying();
+    const auto changeTime = sessionState.timeForIsPlaying();
+    const auto changes = isPlaying != mIsPlaying && changeTime <= timeAt(lastSample);
+    auto changeSample = std::ptrdiff_t{0};
+    if (changes && changeTime > timing.mBufferBegin)
+    {
+      changeSample = static_cast<std::ptrdiff_t>(std::ceil(
+        static_cast<double>((changeTime - timing.mBufferBegin).count())
+        / microsPerSample));
+      changeSample = changeSample > lastSample ? lastSample : changeSample;
+      while (changeSample > 0 && timeAt(changeSample - 1) >= changeTime)
+      {
+        --changeSample;
+      }
+      while (timeAt(changeSample) < changeTime)
+      {
+        ++changeSample;
+      }
+    }
+
+    auto isStopPending = false;
+    if (changes)
+    {
+      if (isPlaying)
+      {
+        mIsStartPending = true;
+      }
+      else
+      {
+        // A start that no pulse followed yet isn't stopped
+        isStopPending = !mIsStartPending;
+        mIsStartPending = false;
+      }
+    }
+
+    const auto stop = [&] {
+      *out = ClockEvent{ClockEvent::Type::Stop, static_cast<std::size_t>(changeSample),
+        sessionState.beatAtTime(timeAt(changeSample), mGrid.quantum)};
+      ++out;
+      isStopPending = false;
+    };
+
+    auto pulse = [&](const BeatGridEvent& event) {
+      const auto sample = static_cast<std::ptrdiff_t>(event.sample);
+      const auto isPlayingAtSample =
+        changes ? (isPlaying == (sample >= changeSample)) : mIsPlaying;
+      if (isStopPending && sample >= changeSample)
+      {
+        stop();
+      }
+      if (!isPlayingAtSample && !mPulsesWhileStopped)
+      {
+        return;
+      }
+      if (isPlayingAtSample && mIsStartPending)
+      {
+        *out = ClockEvent{ClockEvent::Type::Start, event.sample, event.beat};
+        ++out;
+        mIsStartPending = false;
+      }
+      *out = ClockEvent{ClockEvent::Type::Pulse, event.sample, event.beat};
+      ++out;
+    };
+    beatGridEvents(sessionState, timing, numSamples, &mGrid, &mGrid + 1,
+      detail::BeatGridEventSink<decltype(pulse)>{&pulse});
+
+    if (isStopPending)
+    {
+      stop();
+    }
+    if (changes)
+    {
+      mIsPlaying = isPlaying;
+    }
+    return out;
+  }
+
+private:
+  BeatGrid mGrid;
+  bool mPulsesWhileStopped;
+  // The state of the transport at the end of the last buffer
+  bool mIsPlaying;
+  // Started, but the first pulse hasn't been reported yet
+  bool mIsStartPending;
+};
+
+} // namespace util
+} // namespace ableton
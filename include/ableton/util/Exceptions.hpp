@@ -0,0 +1,131 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+// Building with LINK_NO_EXCEPTIONS defined, along with -fno-exceptions, keeps Link
+// from throwing and catching. This is meant for embedded targets and for hosts that
+// are built without exceptions, e.g. game engines. The errors that Link recovers
+// from are passed on as error codes instead:
+//
+//   - Datagrams that don't parse are dropped, the receive path only uses the try
+//     functions of the parsers
+//   - Sockets that can't be opened or bound are logged and stay closed, so that
+//     sending with them fails
+//   - A messenger that keeps failing to send passes its UdpSendException to
+//     handleError of its io context, which invokes the exception handler of the
+//     context right away, so that the gateway is repaired as before
+//
+// The remaining throws are programming errors or exhausted resources, e.g. the
+// throwing parse functions that are kept for other clients, encoding a message
+// beyond the maximum size or a full StaticVector. They terminate the process through
+// util::fatalError. asio must be built with ASIO_NO_EXCEPTIONS, which leaves the
+// definition of asio::detail::throw_exception to the application.
+
+#if defined(LINK_NO_EXCEPTIONS)
+#define LINK_THROW(...) ::ableton::util::fatalError((__VA_ARGS__).what())
+#else
+#define LINK_THROW(...) throw __VA_ARGS__
+#endif
+
+namespace ableton
+{
+namespace util
+{
+
+// Reports an error that would be thrown with exceptions and terminates
+[[noreturn]] inline void fatalError(const char* const what)
+{
+  std::fprintf(stderr, "Link: %s\n", what);
+  std::abort();
+}
+
+// Invokes call and passes an exception of the given type that escapes it to
+// onError. Without exceptions only call is invoked, the errors that onError would
+// handle are reported in other ways then.
+template <typename Exception, typename Call, typename OnError>
+void invokeCatching(Call call, OnError onError)
+{
+#if defined(LINK_NO_EXCEPTIONS)
+  (void)onError;
+  call();
+#else
+  try
+  {
+    call();
+  }
+  catch (const Exception& exception)
+  {
+    onError(exception);
+  }
+#endif
+}
+
+namespace detail
+{
+
+// Identifies a type without RTTI, which is often disabled along with exceptions
+template <typename T>
+const void* typeTag()
+{
+  static const char tag = 0;
+  return &tag;
+}
+
+} // namespace detail
+
+// The exception handler of an io context, for passing errors to it without
+// throwing them. Errors of the type ExceptionHandler::Exception are passed on to
+// the handler, others are ignored.
+class ErrorHandler
+{
+public:
+  ErrorHandler() = default;
+
+  template <typename ExceptionHandler>
+  explicit ErrorHandler(ExceptionHandler handler)
+    : mHandler([handler](const void* const tag, const void* const pError) mutable {
+      using Exception = typename ExceptionHandler::Exception;
+      if (tag == detail::typeTag<Exception>())
+      {
+        handler(*static_cast<const Exception*>(pError));
+      }
+    })
+  {
+  }
+
+  template <typename Error>
+  void operator()(const Error& error)
+  {
+    if (mHandler)
+    {
+      mHandler(detail::typeTag<Error>(), &error);
+    }
+  }
+
+private:
+  std::function<void(const void*, const void*)> mHandler;
+};
+
+} // namespace util
+} // namespace ableton
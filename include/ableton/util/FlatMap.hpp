@@ -0,0 +1,165 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace ableton
+{
+namespace util
+{
+
+// A map that keeps its entries sorted by key in one contiguous vector. For the few
+// entries of the maps of the io thread, searching the vector is faster than
+// following the nodes of a tree and takes no allocation per entry. Unlike the
+// iterators of std::map, all iterators are invalidated by inserting or erasing.
+// The entries can be kept in a StaticVector instead of a std::vector, so that the
+// map never allocates.
+template <typename Key,
+  typename T,
+  typename Compare = std::less<Key>,
+  typename Container = std::vector<std::pair<Key, T>>>
+class FlatMap
+{
+public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<Key, T>;
+  using iterator = typename Container::iterator;
+  using const_iterator = typename Container::const_iterator;
+
+  iterator begin()
+  {
+    return mEntries.begin();
+  }
+
+  iterator end()
+  {
+    return mEntries.end();
+  }
+
+  const_iterator begin() const
+  {
+    return mEntries.begin();
+  }
+
+  const_iterator end() const
+  {
+    return mEntries.end();
+  }
+
+  bool empty() const
+  {
+    return mEntries.empty();
+  }
+
+  std::size_t size() const
+  {
+    return mEntries.size();
+  }
+
+  std::size_t max_size() const
+  {
+    return mEntries.max_size();
+  }
+
+  void reserve(const std::size_t capacity)
+  {
+    mEntries.reserve(capacity);
+  }
+
+  void clear()
+  {
+    mEntries.clear();
+  }
+
+  iterator find(const Key& key)
+  {
+    const auto it = lowerBound(key);
+    return it != mEntries.end() && !Compare{}(key, it->first) ? it : mEntries.end();
+  }
+
+  const_iterator find(const Key& key) const
+  {
+    return const_cast<FlatMap&>(*this).find(key);
+  }
+
+  std::size_t count(const Key& key) const
+  {
+    return find(key) == end() ? 0 : 1;
+  }
+
+  // Like std::map::emplace, doesn't replace the value of an existing key
+  template <typename K, typename V>
+  std::pair<iterator, bool> emplace(K&& key, V&& value)
+  {
+    const auto it = lowerBound(key);
+    if (it != mEntries.end() && !Compare{}(key, it->first))
+    {
+      return {it, false};
+    }
+    return {mEntries.emplace(it, std::forward<K>(key), std::forward<V>(value)), true};
+  }
+
+  // A missing value is constructed in place
+  T& operator[](const Key& key)
+  {
+    const auto it = lowerBound(key);
+    if (it != mEntries.end() && !Compare{}(key, it->first))
+    {
+      return it->second;
+    }
+    return mEntries
+      .emplace(it, std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>{})
+      ->second;
+  }
+
+  iterator erase(const_iterator it)
+  {
+    return mEntries.erase(it);
+  }
+
+  std::size_t erase(const Key& key)
+  {
+    const auto it = find(key);
+    if (it == mEntries.end())
+    {
+      return 0;
+    }
+    mEntries.erase(it);
+    return 1;
+  }
+
+private:
+  iterator lowerBound(const Key& key)
+  {
+    return std::lower_bound(mEntries.begin(), mEntries.end(), key,
+      [](const value_type& entry, const Key& k) { return Compare{}(entry.first, k); });
+  }
+
+  Container mEntries;
+};
+
+} // namespace util
+} // namespace ableton
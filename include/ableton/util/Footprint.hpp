@@ -0,0 +1,110 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/util/FlatMap.hpp>
+#include <ableton/util/StaticVector.hpp>
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Building with LINK_STATIC_FOOTPRINT defined keeps the tables of the peers, the
+// sessions, the gateways and the measurements in containers of a fixed capacity
+// that are allocated along with their owners, so that the churn of peers doesn't
+// allocate and doesn't fragment the heap of devices that run for days. This is
+// meant for embedded targets like the ESP32. The capacities can be set with
+// these definitions:
+//
+//   LINK_MAX_PEERS         peers per gateway, the least recently heard from peer
+//                          is dropped for a new one (default 8)
+//   LINK_MAX_GATEWAYS      network interfaces that Link runs on (default 2)
+//   LINK_MAX_SESSIONS      other sessions that are remembered (default 4)
+//   LINK_MAX_MEASUREMENTS  measurements in progress per gateway (default 4)
+//
+// Tables that are full drop the peers, sessions and interfaces that don't fit
+// them, instead of growing. See examples/esp32/README.md for the RAM that the
+// tables take.
+
+#if !defined(LINK_MAX_PEERS)
+#define LINK_MAX_PEERS 8
+#endif
+
+#if !defined(LINK_MAX_GATEWAYS)
+#define LINK_MAX_GATEWAYS 2
+#endif
+
+#if !defined(LINK_MAX_SESSIONS)
+#define LINK_MAX_SESSIONS 4
+#endif
+
+#if !defined(LINK_MAX_MEASUREMENTS)
+#define LINK_MAX_MEASUREMENTS 4
+#endif
+
+namespace ableton
+{
+namespace util
+{
+
+#if defined(LINK_STATIC_FOOTPRINT)
+const bool kStaticFootprint = true;
+#else
+const bool kStaticFootprint = false;
+#endif
+
+// The capacities of the static footprint, they don't limit the default build
+const std::size_t kMaxPeers = LINK_MAX_PEERS;
+const std::size_t kMaxGateways = LINK_MAX_GATEWAYS;
+const std::size_t kMaxSessions = LINK_MAX_SESSIONS;
+const std::size_t kMaxMeasurements = LINK_MAX_MEASUREMENTS;
+
+// Containers that hold at most Capacity elements with a static footprint and
+// grow as needed otherwise. Code that uses them checks max_size() before adding
+// an element, which is only reached with a static footprint.
+#if defined(LINK_STATIC_FOOTPRINT)
+
+template <typename T, std::size_t Capacity>
+using FootprintVector = StaticVector<T, Capacity>;
+
+template <typename Key, typename T, std::size_t Capacity>
+using FootprintFlatMap =
+  FlatMap<Key, T, std::less<Key>, StaticVector<std::pair<Key, T>, Capacity>>;
+
+// Unordered with the default footprint, ordered by key with a static one
+template <typename Key, typename T, std::size_t Capacity, typename Hash = std::hash<Key>>
+using FootprintHashMap = FootprintFlatMap<Key, T, Capacity>;
+
+#else
+
+template <typename T, std::size_t>
+using FootprintVector = std::vector<T>;
+
+template <typename Key, typename T, std::size_t>
+using FootprintFlatMap = FlatMap<Key, T>;
+
+template <typename Key, typename T, std::size_t, typename Hash = std::hash<Key>>
+using FootprintHashMap = std::unordered_map<Key, T, Hash>;
+
+#endif
+
+} // namespace util
+} // namespace ableton
@@ -0,0 +1,92 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+#pragma once
+
+#include <chrono>
+#include <utility>
+
+namespace ableton
+{
+namespace util
+{
+
+/*! Provides the host time of the buffers of an audio driver. Drivers that
+ *  time stamp their buffers are used as is, which is cheaper and more
+ *  accurate than estimating the time. For drivers that don't, or for
+ *  buffers without a valid time stamp, the given HostTimeFilter estimates
+ *  the time from a running sample count. The filter is restarted whenever
+ *  it takes over from the driver, so that it doesn't extrapolate from
+ *  stale points.
+ */
+template <typename Clock, typename HostTimeFilter>
+class HostTimeSource
+{
+public:
+  HostTimeSource(Clock clock = {})
+    : mClock(std::move(clock))
+    , mIsFiltering(false)
+  {
+  }
+
+  // The host time of an event that the driver stamped with driverTime on its
+  // own clock, which currently reads driverNow. The offset between the clocks
+  // is taken anew with each call, so they needn't share an origin.
+  std::chrono::microseconds fromDriverTime(
+    const std::chrono::microseconds driverTime, const std::chrono::microseconds driverNow)
+  {
+    mIsFiltering = false;
+    return mClock.micros() - (driverNow - driverTime);
+  }
+
+  // The host time of an event that the driver stamped with the ticks of the
+  // clock of Link
+  template <typename Ticks>
+  std::chrono::microseconds fromTicks(const Ticks ticks)
+  {
+    mIsFiltering = false;
+    return mClock.ticksToMicros(ticks);
+  }
+
+  // The host time of an event that the driver stamped with the time of the
+  // clock of Link
+  std::chrono::microseconds fromHostTime(const std::chrono::microseconds hostTime)
+  {
+    mIsFiltering = false;
+    return hostTime;
+  }
+
+  // The estimated host time of the given sample
+  std::chrono::microseconds fromSampleTime(const double sampleTime)
+  {
+    if (!mIsFiltering)
+    {
+      mFilter.reset();
+      mIsFiltering = true;
+    }
+    return mFilter.sampleTimeToHostTime(sampleTime);
+  }
+
+private:
+  Clock mClock;
+  HostTimeFilter mFilter;
+  bool mIsFiltering;
+};
+
+} // namespace util
+} // namespace ableton
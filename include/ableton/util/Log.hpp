@@ -3,17 +3,83 @@
 #pragma once
 
 #include <ableton/util/Injected.hpp>
+#include <atomic>
 #include <iostream>
 #include <string>
 
+// Stream into a log only if its level is enabled. Unlike with debug(log) << ...,
+// the streamed expressions are not evaluated otherwise:
+//
+//   LINK_DEBUG(log) << "Received message from " << from.address().to_string();
+#define LINK_LOG_AT_LEVEL(log, level, function)                                        \
+  if (!::ableton::util::isLogLevelEnabled(log, ::ableton::util::LogLevel::level))    \
+  {                                                                                    \
+  }                                                                                    \
+  else                                                                                 \
+    function(log)
+
+#define LINK_DEBUG(log) LINK_LOG_AT_LEVEL(log, Debug, debug)
+#define LINK_INFO(log) LINK_LOG_AT_LEVEL(log, Info, info)
+#define LINK_WARNING(log) LINK_LOG_AT_LEVEL(log, Warning, warning)
+#define LINK_ERROR(log) LINK_LOG_AT_LEVEL(log, Error, error)
+
 namespace ableton
 {
 namespace util
 {
 
+enum class LogLevel
+{
+  Debug,
+  Info,
+  Warning,
+  Error,
+};
+
+namespace detail
+{
+
+template <typename Log>
+auto isLogLevelEnabled(const Log& log, const LogLevel level, int)
+  -> decltype(isEnabled(log, level))
+{
+  return isEnabled(log, level);
+}
+
+template <typename Log>
+bool isLogLevelEnabled(const Log&, LogLevel, long)
+{
+  return true;
+}
+
+} // namespace detail
+
+// Logs can tell which levels they write by providing
+// bool isEnabled(const Log&, LogLevel). All levels of other logs are enabled.
+template <typename Log>
+bool isLogLevelEnabled(const Log& log, const LogLevel level)
+{
+  return detail::isLogLevelEnabled(log, level, 0);
+}
+
+// A channel of the log whose name is only built if the log writes any level,
+// so that disabled logs don't pay for concatenating it
+template <typename Log, typename MakeName>
+auto lazyChannel(const Log& log, MakeName makeName)
+  -> decltype(channel(log, makeName()))
+{
+  return isLogLevelEnabled(log, LogLevel::Error) ? channel(log, makeName())
+                                                 : channel(log, std::string{});
+}
+
 // Null object for the Log concept
 struct NullLog
 {
+  friend constexpr bool isEnabled(const NullLog&, LogLevel)
+  {
+    return false;
+  }
+
   template <typename T>
   friend const NullLog& operator<<(const NullLog& log, const T&)
   {
@@ -135,6 +201,11 @@ struct Timestamped
 
   util::Injected<Log> mLog;
 
+  friend bool isEnabled(const Timestamped& log, const LogLevel level)
+  {
+    return isLogLevelEnabled(*log.mLog, level);
+  }
+
   friend decltype(debug(std::declval<InnerLog>())) debug(const Timestamped& log)
   {
     return log.logTimestamp(debug(*log.mLog));
@@ -172,5 +243,70 @@ struct Timestamped
   }
 };
 
+// Log adapter that drops the messages below a level that can be changed at
+// runtime. The level is shared by all logs of the same type and is
+// LogLevel::Info by default.
+template <typename Log>
+struct LevelFilter
+{
+  using InnerLog = typename util::Injected<Log>::type;
+
+  LevelFilter() = default;
+
+  LevelFilter(util::Injected<Log> log)
+    : mLog(std::move(log))
+  {
+  }
+
+  static void setLevel(const LogLevel level)
+  {
+    levelRef().store(level, std::memory_order_relaxed);
+  }
+
+  static LogLevel level()
+  {
+    return levelRef().load(std::memory_order_relaxed);
+  }
+
+  util::Injected<Log> mLog;
+
+  friend bool isEnabled(const LevelFilter& log, const LogLevel level)
+  {
+    return level >= LevelFilter::level() && isLogLevelEnabled(*log.mLog, level);
+  }
+
+  friend decltype(debug(std::declval<InnerLog>())) debug(const LevelFilter& log)
+  {
+    return debug(*log.mLog);
+  }
+
+  friend decltype(info(std::declval<InnerLog>())) info(const LevelFilter& log)
+  {
+    return info(*log.mLog);
+  }
+
+  friend decltype(warning(std::declval<InnerLog>())) warning(const LevelFilter& log)
+  {
+    return warning(*log.mLog);
+  }
+
+  friend decltype(error(std::declval<InnerLog>())) error(const LevelFilter& log)
+  {
+    return error(*log.mLog);
+  }
+
+  friend LevelFilter channel(const LevelFilter& log, const std::string& channelName)
+  {
+    return LevelFilter{util::injectVal(channel(*log.mLog, channelName))};
+  }
+
+private:
+  static std::atomic<LogLevel>& levelRef()
+  {
+    static std::atomic<LogLevel> level(LogLevel::Info);
+    return level;
+  }
+};
+
 } // namespace util
 } // namespace ableton
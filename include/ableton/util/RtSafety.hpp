@@ -0,0 +1,106 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <atomic>
+
+// With LINK_RT_SAFETY_CHECKS defined, the realtime-safe functions of Link mark the
+// threads that call them as realtime for the duration of the call. Functions that
+// must not be called from a realtime thread, such as the allocation functions,
+// report a violation by calling util::rt::check, see
+// platforms/linux/RtSafetyChecks.hpp. Meant for debug builds and tests.
+#if defined(LINK_RT_SAFETY_CHECKS)
+#define LINK_RT_SAFE_SCOPE const ::ableton::util::rt::Scope linkRtSafeScope
+#else
+#define LINK_RT_SAFE_SCOPE
+#endif
+
+namespace ableton
+{
+namespace util
+{
+namespace rt
+{
+
+// Invoked with the name of the function that was called from a realtime scope
+using ViolationHandler = void (*)(const char* function);
+
+inline std::atomic<ViolationHandler>& violationHandler()
+{
+  static std::atomic<ViolationHandler> handler{nullptr};
+  return handler;
+}
+
+// Marks the calling thread as realtime for the lifetime of the scope. Scopes nest.
+class Scope
+{
+public:
+  Scope()
+  {
+    ++depth();
+  }
+
+  ~Scope()
+  {
+    --depth();
+  }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+  static int& depth()
+  {
+    static thread_local int depth = 0;
+    return depth;
+  }
+};
+
+inline bool isInScope()
+{
+  return Scope::depth() > 0;
+}
+
+// Not thread-safe with respect to the checks; set it before the realtime threads
+// start
+inline void setViolationHandler(const ViolationHandler handler)
+{
+  violationHandler().store(handler);
+}
+
+// Reports a violation if the calling thread is in a realtime scope. The handler is
+// invoked outside of all scopes, so that it may allocate or lock itself.
+inline void check(const char* function)
+{
+  auto& depth = Scope::depth();
+  if (depth > 0)
+  {
+    if (const auto handler = violationHandler().load())
+    {
+      const auto outerDepth = depth;
+      depth = 0;
+      handler(function);
+      depth = outerDepth;
+    }
+  }
+}
+
+} // namespace rt
+} // namespace util
+} // namespace ableton
@@ -42,6 +42,11 @@ struct SafeAsyncHandler
   {
   }
 
+  SafeAsyncHandler(const std::weak_ptr<Delegate>& pDelegate)
+    : mpDelegate(pDelegate)
+  {
+  }
+
   template <typename... T>
   void operator()(T&&... t) const
   {
@@ -62,5 +67,28 @@ SafeAsyncHandler<Delegate> makeAsyncSafe(const std::shared_ptr<Delegate>& pDeleg
   return {pDelegate};
 }
 
+// Like std::enable_shared_from_this, for objects that start async operations with
+// a SafeAsyncHandler of themselves again and again, e.g. for every received
+// packet. The weak reference of the handler is taken once, so that starting an
+// operation only copies it instead of also locking the object and releasing it
+// again, which saves atomic reference count operations.
+template <typename Delegate>
+struct EnableAsyncSafe : std::enable_shared_from_this<Delegate>
+{
+  SafeAsyncHandler<Delegate> asyncSafe()
+  {
+    if (!mHasSelf)
+    {
+      mpSelf = this->shared_from_this();
+      mHasSelf = true;
+    }
+    return {mpSelf};
+  }
+
+private:
+  std::weak_ptr<Delegate> mpSelf;
+  bool mHasSelf = false;
+};
+
 } // namespace util
 } // namespace ableton
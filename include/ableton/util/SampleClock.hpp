@@ -0,0 +1,128 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace ableton
+{
+namespace util
+{
+
+/*! Maps sample indices to host time exactly for sample rates that are
+ *  rational numbers of samples per second. The time of sample n is
+ *  origin + round(n * 1e6 / sampleRate) microseconds, without rounding
+ *  errors that accumulate over long renders. The clock is advanced
+ *  sample by sample or block by block. Advancing by a single sample
+ *  needs no division or float conversion.
+ *
+ *  To follow the output of a HostTimeFilter, sync the clock with the
+ *  filtered host time at the beginning of each buffer and use the clock
+ *  for the samples within the buffer.
+ */
+class SampleClock
+{
+public:
+  SampleClock(const std::chrono::microseconds origin, const std::uint32_t sampleRate)
+    : SampleClock(origin, sampleRate, 1u)
+  {
+  }
+
+  // A sample rate of sampleRateNumerator / sampleRateDenominator samples
+  // per second
+  SampleClock(const std::chrono::microseconds origin,
+    const std::uint64_t sampleRateNumerator,
+    const std::uint64_t sampleRateDenominator)
+    : mNumerator(sampleRateNumerator)
+    , mMicrosNumerator(kMicrosPerSecond * sampleRateDenominator)
+    , mStepMicros(static_cast<std::int64_t>(mMicrosNumerator / mNumerator))
+    , mStepRemainder(mMicrosNumerator % mNumerator)
+    , mSample(0)
+    , mMicros(origin.count())
+    , mRemainder(0)
+  {
+    sync(origin);
+  }
+
+  std::int64_t sample() const
+  {
+    return mSample;
+  }
+
+  // The time of the current sample
+  std::chrono::microseconds time() const
+  {
+    return std::chrono::microseconds{mMicros};
+  }
+
+  // The time of the sample numSamples after the current one
+  std::chrono::microseconds timeAtSample(const std::uint64_t numSamples) const
+  {
+    const auto numerator = mRemainder + numSamples * mMicrosNumerator;
+    return std::chrono::microseconds{
+      mMicros + static_cast<std::int64_t>(numerator / mNumerator)};
+  }
+
+  void advance()
+  {
+    ++mSample;
+    mMicros += mStepMicros;
+    mRemainder += mStepRemainder;
+    if (mRemainder >= mNumerator)
+    {
+      ++mMicros;
+      mRemainder -= mNumerator;
+    }
+  }
+
+  void advance(const std::uint64_t numSamples)
+  {
+    mSample += static_cast<std::int64_t>(numSamples);
+    const auto numerator = mRemainder + numSamples * mMicrosNumerator;
+    mMicros += static_cast<std::int64_t>(numerator / mNumerator);
+    mRemainder = numerator % mNumerator;
+  }
+
+  // Make the current sample occur at the given time, e.g. the output of a
+  // HostTimeFilter for the first sample of a buffer. The following samples
+  // are timed relative to it.
+  void sync(const std::chrono::microseconds time)
+  {
+    mMicros = time.count();
+    // Starting halfway between two microseconds rounds to the nearest one
+    mRemainder = mNumerator / 2;
+  }
+
+private:
+  static const std::uint64_t kMicrosPerSecond = 1000000u;
+
+  std::uint64_t mNumerator;
+  std::uint64_t mMicrosNumerator;
+  std::int64_t mStepMicros;
+  std::uint64_t mStepRemainder;
+  std::int64_t mSample;
+  std::int64_t mMicros;
+  std::uint64_t mRemainder;
+};
+
+} // namespace util
+} // namespace ableton
@@ -0,0 +1,318 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#pragma once
+
+#include <ableton/util/Exceptions.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace ableton
+{
+namespace util
+{
+
+// A vector with the storage for Capacity elements in place, so that it never
+// allocates. Like std::vector it throws std::length_error if an element is added
+// to it when it's full, callers that mustn't fail check max_size() beforehand.
+// Iterators are plain pointers and are invalidated like those of std::vector.
+template <typename T, std::size_t Capacity>
+class StaticVector
+{
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  StaticVector()
+    : mSize(0)
+  {
+  }
+
+  StaticVector(const StaticVector& rhs)
+    : mSize(0)
+  {
+    for (const auto& value : rhs)
+    {
+      emplace_back(value);
+    }
+  }
+
+  StaticVector(StaticVector&& rhs)
+    : mSize(0)
+  {
+    for (auto& value : rhs)
+    {
+      emplace_back(std::move(value));
+    }
+    rhs.clear();
+  }
+
+  StaticVector& operator=(const StaticVector& rhs)
+  {
+    if (this != &rhs)
+    {
+      clear();
+      for (const auto& value : rhs)
+      {
+        emplace_back(value);
+      }
+    }
+    return *this;
+  }
+
+  StaticVector& operator=(StaticVector&& rhs)
+  {
+    if (this != &rhs)
+    {
+      clear();
+      for (auto& value : rhs)
+      {
+        emplace_back(std::move(value));
+      }
+      rhs.clear();
+    }
+    return *this;
+  }
+
+  ~StaticVector()
+  {
+    clear();
+  }
+
+  iterator begin()
+  {
+    return data();
+  }
+
+  iterator end()
+  {
+    return data() + mSize;
+  }
+
+  const_iterator begin() const
+  {
+    return data();
+  }
+
+  const_iterator end() const
+  {
+    return data() + mSize;
+  }
+
+  T* data()
+  {
+    return reinterpret_cast<T*>(mStorage);
+  }
+
+  const T* data() const
+  {
+    return reinterpret_cast<const T*>(mStorage);
+  }
+
+  bool empty() const
+  {
+    return mSize == 0;
+  }
+
+  std::size_t size() const
+  {
+    return mSize;
+  }
+
+  std::size_t max_size() const
+  {
+    return Capacity;
+  }
+
+  std::size_t capacity() const
+  {
+    return Capacity;
+  }
+
+  // The storage is in place, a capacity beyond it can't be reserved
+  void reserve(const std::size_t capacity)
+  {
+    if (capacity > Capacity)
+    {
+      LINK_THROW(std::length_error("StaticVector can't grow beyond its capacity"));
+    }
+  }
+
+  T& operator[](const std::size_t pos)
+  {
+    return data()[pos];
+  }
+
+  const T& operator[](const std::size_t pos) const
+  {
+    return data()[pos];
+  }
+
+  T& front()
+  {
+    return *begin();
+  }
+
+  const T& front() const
+  {
+    return *begin();
+  }
+
+  T& back()
+  {
+    return *(end() - 1);
+  }
+
+  const T& back() const
+  {
+    return *(end() - 1);
+  }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args)
+  {
+    checkRoom();
+    new (end()) T(std::forward<Args>(args)...);
+    ++mSize;
+  }
+
+  void push_back(const T& value)
+  {
+    emplace_back(value);
+  }
+
+  void push_back(T&& value)
+  {
+    emplace_back(std::move(value));
+  }
+
+  void pop_back()
+  {
+    back().~T();
+    --mSize;
+  }
+
+  // Constructs the element in its place, without a temporary of T, which matters
+  // for large elements on the small stacks of embedded targets
+  template <typename... Args>
+  iterator emplace(const_iterator pos, Args&&... args)
+  {
+    const auto index = pos - begin();
+    if (pos == end())
+    {
+      emplace_back(std::forward<Args>(args)...);
+      return begin() + index;
+    }
+
+    checkRoom();
+    const auto p = begin() + index;
+    new (end()) T(std::move(back()));
+    ++mSize;
+    std::move_backward(p, end() - 2, end() - 1);
+    p->~T();
+#if defined(LINK_NO_EXCEPTIONS)
+    new (p) T(std::forward<Args>(args)...);
+#else
+    try
+    {
+      new (p) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+      // Move the elements back into the gap
+      new (p) T(std::move(*(p + 1)));
+      std::move(p + 2, end(), p + 1);
+      pop_back();
+      throw;
+    }
+#endif
+    return p;
+  }
+
+  iterator insert(const_iterator pos, const T& value)
+  {
+    return emplace(pos, value);
+  }
+
+  iterator insert(const_iterator pos, T&& value)
+  {
+    return emplace(pos, std::move(value));
+  }
+
+  iterator erase(const_iterator first, const_iterator last)
+  {
+    const auto p = begin() + (first - begin());
+    const auto numErased = static_cast<std::size_t>(last - first);
+    std::move(p + numErased, end(), p);
+    for (std::size_t i = 0; i < numErased; ++i)
+    {
+      pop_back();
+    }
+    return p;
+  }
+
+  iterator erase(const_iterator pos)
+  {
+    return erase(pos, pos + 1);
+  }
+
+  void assign(const std::size_t count, const T& value)
+  {
+    clear();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      emplace_back(value);
+    }
+  }
+
+  void clear()
+  {
+    while (mSize > 0)
+    {
+      pop_back();
+    }
+  }
+
+private:
+  void checkRoom() const
+  {
+    if (mSize == Capacity)
+    {
+      LINK_THROW(std::length_error("StaticVector is full"));
+    }
+  }
+
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type mStorage[Capacity];
+  std::size_t mSize;
+};
+
+} // namespace util
+} // namespace ableton
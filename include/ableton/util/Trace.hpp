@@ -0,0 +1,341 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#pragma once
+
+#include <ableton/platforms/asio/AsioWrapper.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace ableton
+{
+namespace util
+{
+
+// Structured events of the io threads. Each event carries two arguments:
+//
+// PacketReceived, PacketSent: the remote endpoint and the size in bytes
+// MeasurementStarted, MeasurementFinished: the endpoint of the measured peer and,
+//   when finished, whether the measurement succeeded
+// SessionJoined: the session id
+// GatewayAdded, GatewayRemoved: the address of the interface
+//
+// Endpoints and addresses are encoded with traceEndpoint and traceAddress, ids
+// with traceId.
+enum class TraceEvent : std::uint8_t
+{
+  PacketReceived,
+  PacketSent,
+  MeasurementStarted,
+  MeasurementFinished,
+  SessionJoined,
+  GatewayAdded,
+  GatewayRemoved,
+};
+
+inline const char* traceEventName(const TraceEvent event)
+{
+  switch (event)
+  {
+  case TraceEvent::PacketReceived:
+    return "PacketReceived";
+  case TraceEvent::PacketSent:
+    return "PacketSent";
+  case TraceEvent::MeasurementStarted:
+    return "MeasurementStarted";
+  case TraceEvent::MeasurementFinished:
+    return "MeasurementFinished";
+  case TraceEvent::SessionJoined:
+    return "SessionJoined";
+  case TraceEvent::GatewayAdded:
+    return "GatewayAdded";
+  case TraceEvent::GatewayRemoved:
+    return "GatewayRemoved";
+  }
+  return "Unknown";
+}
+
+// Only IPv4 addresses are encoded, others are traced as 0
+inline std::uint64_t traceAddress(const asio::ip::address& address)
+{
+  return address.is_v4() ? address.to_v4().to_ulong() : 0;
+}
+
+inline std::uint64_t traceEndpoint(const asio::ip::udp::endpoint& endpoint)
+{
+  return (traceAddress(endpoint.address()) << 16) | endpoint.port();
+}
+
+// Encodes the first 8 bytes of an id such as a NodeId
+template <typename Id>
+std::uint64_t traceId(const Id& id)
+{
+  std::uint64_t result = 0;
+  const auto n = std::min(id.size(), sizeof(result));
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    result = (result << 8) | static_cast<std::uint8_t>(id[i]);
+  }
+  return result;
+}
+
+// Trace that compiles to nothing
+struct NullTrace
+{
+  friend void trace(
+    const NullTrace&, TraceEvent, const std::uint64_t = 0, const std::uint64_t = 0)
+  {
+  }
+};
+
+struct TraceRecord
+{
+  // Time of the steady clock
+  std::chrono::nanoseconds time;
+  TraceEvent event;
+  std::uint32_t thread;
+  std::uint64_t arg0;
+  std::uint64_t arg1;
+};
+
+// A lock-free ring of the most recent Capacity trace events. Writing is wait-free
+// and may happen on any number of threads. Events that are overwritten while being
+// read are skipped by the reader.
+template <std::size_t Capacity>
+class TraceRing
+{
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+    "Capacity must be a power of two");
+
+public:
+  TraceRing()
+    : mNextIndex(0)
+  {
+    for (auto& slot : mSlots)
+    {
+      slot.sequence.store(0, std::memory_order_relaxed);
+      slot.time.store(0, std::memory_order_relaxed);
+      slot.eventAndThread.store(0, std::memory_order_relaxed);
+      slot.arg0.store(0, std::memory_order_relaxed);
+      slot.arg1.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  TraceRing(const TraceRing&) = delete;
+  TraceRing& operator=(const TraceRing&) = delete;
+
+  void write(const TraceEvent event, const std::uint64_t arg0, const std::uint64_t arg1)
+  {
+    using namespace std::chrono;
+    const auto time =
+      duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    const auto thread = static_cast<std::uint32_t>(
+      std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+    const auto index = mNextIndex.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = mSlots[index & (Capacity - 1)];
+    slot.sequence.store(kBusy, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time.store(static_cast<std::int64_t>(time), std::memory_order_relaxed);
+    slot.eventAndThread.store(
+      (static_cast<std::uint64_t>(event) << 32) | thread, std::memory_order_relaxed);
+    slot.arg0.store(arg0, std::memory_order_relaxed);
+    slot.arg1.store(arg1, std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+  }
+
+  // The recorded events from the oldest to the newest
+  std::vector<TraceRecord> records() const
+  {
+    std::vector<std::pair<std::uint64_t, TraceRecord>> indexed;
+    indexed.reserve(Capacity);
+    for (const auto& slot : mSlots)
+    {
+      const auto sequence = slot.sequence.load(std::memory_order_acquire);
+      TraceRecord record;
+      record.time =
+        std::chrono::nanoseconds{slot.time.load(std::memory_order_relaxed)};
+      const auto eventAndThread = slot.eventAndThread.load(std::memory_order_relaxed);
+      record.event = static_cast<TraceEvent>(eventAndThread >> 32);
+      record.thread = static_cast<std::uint32_t>(eventAndThread);
+      record.arg0 = slot.arg0.load(std::memory_order_relaxed);
+      record.arg1 = slot.arg1.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence != 0 && sequence != kBusy
+          && sequence == slot.sequence.load(std::memory_order_relaxed))
+      {
+        indexed.emplace_back(sequence, record);
+      }
+    }
+
+    std::sort(indexed.begin(), indexed.end(),
+      [](const std::pair<std::uint64_t, TraceRecord>& lhs,
+        const std::pair<std::uint64_t, TraceRecord>& rhs) {
+        return lhs.first < rhs.first;
+      });
+    std::vector<TraceRecord> result;
+    result.reserve(indexed.size());
+    for (const auto& entry : indexed)
+    {
+      result.push_back(entry.second);
+    }
+    return result;
+  }
+
+  // Writes the recorded events in the Chrome trace event format, which can be
+  // loaded into chrome://tracing or Perfetto. Measurements are shown as async
+  // slices per peer, all other events as instant events.
+  void writeChromeTrace(std::ostream& stream) const
+  {
+    writeChromeTrace(stream, records());
+  }
+
+  static void writeChromeTrace(std::ostream& stream, const std::vector<TraceRecord>& rs)
+  {
+    const auto flags = stream.flags();
+    const auto precision = stream.precision();
+    stream.setf(std::ios::fixed, std::ios::floatfield);
+    stream.precision(3);
+
+    const auto origin = rs.empty() ? std::chrono::nanoseconds{0} : rs.front().time;
+    stream << "{\"traceEvents\":[";
+    for (auto it = rs.begin(); it != rs.end(); ++it)
+    {
+      if (it != rs.begin())
+      {
+        stream << ",";
+      }
+      writeChromeTraceEvent(stream, *it, origin);
+    }
+    stream << "]}\n";
+
+    stream.flags(flags);
+    stream.precision(precision);
+  }
+
+private:
+  static const std::uint64_t kBusy = std::numeric_limits<std::uint64_t>::max();
+
+  struct Slot
+  {
+    std::atomic<std::uint64_t> sequence;
+    std::atomic<std::int64_t> time;
+    std::atomic<std::uint64_t> eventAndThread;
+    std::atomic<std::uint64_t> arg0;
+    std::atomic<std::uint64_t> arg1;
+  };
+
+  static void writeAddress(std::ostream& stream, const std::uint64_t address)
+  {
+    stream << ((address >> 24) & 0xff) << "." << ((address >> 16) & 0xff) << "."
+           << ((address >> 8) & 0xff) << "." << (address & 0xff);
+  }
+
+  static void writeEndpoint(std::ostream& stream, const std::uint64_t endpoint)
+  {
+    stream << "\"";
+    writeAddress(stream, endpoint >> 16);
+    stream << ":" << (endpoint & 0xffff) << "\"";
+  }
+
+  static void writeChromeTraceEvent(std::ostream& stream,
+    const TraceRecord& record,
+    const std::chrono::nanoseconds origin)
+  {
+    stream << "{\"name\":\"" << traceEventName(record.event) << "\",\"cat\":\"link\"";
+    switch (record.event)
+    {
+    case TraceEvent::MeasurementStarted:
+      stream << ",\"ph\":\"b\",\"id\":" << record.arg0;
+      break;
+    case TraceEvent::MeasurementFinished:
+      stream << ",\"ph\":\"e\",\"id\":" << record.arg0;
+      break;
+    default:
+      stream << ",\"ph\":\"i\",\"s\":\"t\"";
+    }
+    stream << ",\"ts\":" << static_cast<double>((record.time - origin).count()) / 1000.
+           << ",\"pid\":0,\"tid\":" << record.thread << ",\"args\":{";
+    switch (record.event)
+    {
+    case TraceEvent::PacketReceived:
+    case TraceEvent::PacketSent:
+      stream << "\"endpoint\":";
+      writeEndpoint(stream, record.arg0);
+      stream << ",\"bytes\":" << record.arg1;
+      break;
+    case TraceEvent::MeasurementStarted:
+      stream << "\"peer\":";
+      writeEndpoint(stream, record.arg0);
+      break;
+    case TraceEvent::MeasurementFinished:
+      stream << "\"peer\":";
+      writeEndpoint(stream, record.arg0);
+      stream << ",\"success\":" << (record.arg1 != 0 ? "true" : "false");
+      break;
+    case TraceEvent::SessionJoined:
+      stream << "\"session\":\"" << std::hex << record.arg0 << std::dec << "\"";
+      break;
+    case TraceEvent::GatewayAdded:
+    case TraceEvent::GatewayRemoved:
+      stream << "\"address\":\"";
+      writeAddress(stream, record.arg0);
+      stream << "\"";
+      break;
+    }
+    stream << "}}";
+  }
+
+  std::atomic<std::uint64_t> mNextIndex;
+  std::array<Slot, Capacity> mSlots;
+};
+
+// Trace that records into a process-wide TraceRing, which is shared by all
+// contexts using this type. Dump it with RingTrace<>::ring().writeChromeTrace().
+template <std::size_t Capacity = 4096>
+struct RingTrace
+{
+  using Ring = TraceRing<Capacity>;
+
+  static Ring& ring()
+  {
+    static Ring ring;
+    return ring;
+  }
+
+  friend void trace(const RingTrace&,
+    const TraceEvent event,
+    const std::uint64_t arg0 = 0,
+    const std::uint64_t arg1 = 0)
+  {
+    ring().write(event, arg0, arg1);
+  }
+};
+
+} // namespace util
+} // namespace ableton
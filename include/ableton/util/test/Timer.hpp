@@ -21,6 +21,7 @@
 
 #include <chrono>
 #include <functional>
+#include <utility>
 
 namespace ableton
 {
@@ -81,8 +82,10 @@ struct Timer
     mNow += duration;
     if (mHandler && mFireAt < mNow)
     {
-      mHandler(0);
+      // The handler may wait on the timer again
+      auto handler = std::move(mHandler);
       mHandler = nullptr;
+      handler(0);
     }
   }
 
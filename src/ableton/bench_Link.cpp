@@ -0,0 +1,78 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#include <ableton/Link.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+namespace ableton
+{
+
+TEST_CASE("Link audio thread API", "[benchmark]")
+{
+  Link link(120.);
+  const auto now = link.clock().micros();
+  auto offset = std::chrono::microseconds{0};
+
+  BENCHMARK("Clock::micros")
+  {
+    return link.clock().micros();
+  };
+
+  BENCHMARK("captureAudioSessionState")
+  {
+    return link.captureAudioSessionState();
+  };
+
+  BENCHMARK("captureAudioSessionState/commitAudioSessionState")
+  {
+    auto sessionState = link.captureAudioSessionState();
+    link.commitAudioSessionState(sessionState);
+  };
+
+  BENCHMARK("captureAudioSessionState/setTempo/commitAudioSessionState")
+  {
+    auto sessionState = link.captureAudioSessionState();
+    offset += std::chrono::microseconds{1};
+    sessionState.setTempo(120. + static_cast<double>(offset.count() % 2), now + offset);
+    link.commitAudioSessionState(sessionState);
+  };
+
+  const auto sessionState = link.captureAudioSessionState();
+
+  BENCHMARK("SessionState::beatAtTime")
+  {
+    offset += std::chrono::microseconds{1};
+    return sessionState.beatAtTime(now + offset, 4.);
+  };
+
+  BENCHMARK("SessionState::phaseAtTime")
+  {
+    offset += std::chrono::microseconds{1};
+    return sessionState.phaseAtTime(now + offset, 4.);
+  };
+
+  BENCHMARK("SessionState::timeAtBeat")
+  {
+    offset += std::chrono::microseconds{1};
+    return sessionState.timeAtBeat(static_cast<double>(offset.count()) * 1e-3, 4.);
+  };
+}
+
+} // namespace ableton
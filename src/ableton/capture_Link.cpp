@@ -0,0 +1,170 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/discovery/PacketCapture.hpp>
+#include <ableton/discovery/v1/Messages.hpp>
+#include <ableton/platforms/Config.hpp>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Records the discovery traffic of the Link sessions on the network into a file
+// that LinkReplay can feed through the discovery stack later, e.g.
+//
+//   LinkCapture --output show.lcap --duration 600
+//
+// The datagrams are received by multicast sockets on the discovery port of each
+// interface, like the ones of a Link peer, so the capture holds the multicast
+// announcements of all peers and the states that are sent to this host directly.
+// The measurement traffic between other hosts isn't seen. Capturing stops after the
+// duration, given in seconds, or when the process is interrupted.
+
+namespace
+{
+
+using IoContext = ableton::link::platform::IoContext;
+using MulticastSocket = IoContext::Socket<ableton::discovery::v1::kMaxMessageSize>;
+
+void printUsage()
+{
+  std::cout << "usage: LinkCapture --output file [--duration s]\n";
+}
+
+// Exceptions escape from the run of the io_service in main
+struct NoExceptionHandler
+{
+  struct Exception
+  {
+  };
+
+  void operator()(const Exception&)
+  {
+  }
+};
+
+// Writes each datagram of its socket to the capture and waits for the next one
+struct Recorder
+{
+  template <typename It>
+  void operator()(const asio::ip::udp::endpoint& from, const It begin, const It end)
+  {
+    using namespace std::chrono;
+
+    const auto time =
+      duration_cast<microseconds>(steady_clock::now().time_since_epoch());
+    pWriter->write({time, interfaceAddr, from, {begin, end}});
+    ++*pNumPackets;
+    pSocket->receive(*this);
+  }
+
+  ableton::discovery::PacketCaptureWriter* pWriter;
+  asio::ip::address interfaceAddr;
+  MulticastSocket* pSocket;
+  std::size_t* pNumPackets;
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  auto output = std::string{};
+  auto duration = std::chrono::seconds{60};
+  for (int i = 1; i < argc; ++i)
+  {
+    const auto hasValue = i + 1 < argc;
+    if (std::strcmp(argv[i], "--output") == 0 && hasValue)
+    {
+      output = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "--duration") == 0 && hasValue)
+    {
+      duration = std::chrono::seconds{std::strtoll(argv[++i], nullptr, 10)};
+    }
+    else
+    {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (output.empty())
+  {
+    printUsage();
+    return 1;
+  }
+
+  std::ofstream file{output, std::ios::binary};
+  if (!file)
+  {
+    std::cerr << "can't open " << output << "\n";
+    return 1;
+  }
+  ableton::discovery::PacketCaptureWriter writer{file};
+
+  ::asio::io_service service;
+  IoContext context{service, NoExceptionHandler{}};
+
+  // The sockets keep their addresses, as the recorders refer to them
+  auto numPackets = std::size_t{0};
+  std::vector<std::unique_ptr<MulticastSocket>> sockets;
+  for (const auto& interface : context.scanNetworkInterfaces())
+  {
+    try
+    {
+      sockets.emplace_back(new MulticastSocket{
+        context.openMulticastSocket<ableton::discovery::v1::kMaxMessageSize>(
+          interface.address)});
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr << "can't capture on " << interface.name << " "
+                << interface.address.to_string() << ": " << e.what() << "\n";
+      continue;
+    }
+    std::cout << "capturing on " << interface.name << " "
+              << interface.address.to_string() << "\n";
+    sockets.back()->receive(
+      Recorder{&writer, interface.address, sockets.back().get(), &numPackets});
+  }
+
+  if (sockets.empty())
+  {
+    std::cerr << "no interface to capture on\n";
+    return 1;
+  }
+
+  ::asio::steady_timer timer{service};
+  timer.expires_from_now(duration);
+  timer.async_wait([&service](const ::asio::error_code&) { service.stop(); });
+  ::asio::signal_set signals{service, SIGINT, SIGTERM};
+  signals.async_wait([&service](const ::asio::error_code&, int) { service.stop(); });
+  service.run();
+
+  sockets.clear();
+  writer.flush();
+  std::cout << "captured " << numPackets << " packets\n";
+  return file ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/discovery/InterfaceFilter.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+namespace ableton
+{
+namespace discovery
+{
+namespace
+{
+
+NetworkInterface makeInterface(
+  std::string name, const std::string& addr, const InterfaceType type)
+{
+  return {std::move(name), asio::ip::address::from_string(addr), type};
+}
+
+const auto eth0 = makeInterface("eth0", "192.168.1.10", InterfaceType::Other);
+const auto docker0 = makeInterface("docker0", "172.17.0.1", InterfaceType::Other);
+const auto tun0 = makeInterface("tun0", "10.8.0.2", InterfaceType::PointToPoint);
+const auto lo = makeInterface("lo", "127.0.0.1", InterfaceType::Loopback);
+
+} // anonymous namespace
+
+TEST_CASE("InterfaceFilter")
+{
+  InterfaceFilter filter;
+
+  SECTION("AcceptsAllByDefault")
+  {
+    CHECK(filter(eth0));
+    CHECK(filter(docker0));
+    CHECK(filter(tun0));
+    CHECK(filter(lo));
+  }
+
+  SECTION("DeniesByNamePrefix")
+  {
+    filter.denied.names = {"docker*", "br-*"};
+    CHECK(filter(eth0));
+    CHECK(!filter(docker0));
+    CHECK(filter(makeInterface("br", "172.18.0.1", InterfaceType::Other)));
+    CHECK(!filter(makeInterface("br-1234", "172.18.0.1", InterfaceType::Other)));
+  }
+
+  SECTION("DeniesByExactName")
+  {
+    filter.denied.names = {"eth"};
+    CHECK(filter(eth0));
+    filter.denied.names = {"eth0"};
+    CHECK(!filter(eth0));
+  }
+
+  SECTION("DeniesByType")
+  {
+    filter.denied.types = {InterfaceType::PointToPoint};
+    CHECK(filter(eth0));
+    CHECK(!filter(tun0));
+  }
+
+  SECTION("AllowsOnlyMatchingSubnets")
+  {
+    filter.allowed.subnets = {{asio::ip::address_v4::from_string("192.168.0.0"), 16}};
+    CHECK(filter(eth0));
+    CHECK(!filter(docker0));
+    CHECK(!filter(tun0));
+    CHECK(!filter(lo));
+  }
+
+  SECTION("SubnetsDontMatchV6Addresses")
+  {
+    filter.allowed.subnets = {{asio::ip::address_v4::from_string("0.0.0.0"), 0}};
+    CHECK(filter(eth0));
+    CHECK(!filter(makeInterface("eth0", "fe80::1", InterfaceType::Other)));
+  }
+
+  SECTION("DenyTakesPrecedenceOverAllow")
+  {
+    filter.allowed.types = {InterfaceType::Other, InterfaceType::Loopback};
+    filter.denied.names = {"docker*"};
+    CHECK(filter(eth0));
+    CHECK(!filter(docker0));
+    CHECK(!filter(tun0));
+    CHECK(filter(lo));
+  }
+}
+
+} // namespace discovery
+} // namespace ableton
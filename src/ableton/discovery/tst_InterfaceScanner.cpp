@@ -84,6 +84,109 @@ TEST_CASE("InterfaceScanner")
     CHECK(addr1 == callback.addrRanges[0].front());
     CHECK(0 == callback.addrRanges[1].size());
   }
+
+  SECTION("FilteredInterfacesAreSkipped")
+  {
+    io.setNetworkInterfaceDetails({{"eth0", addr1, discovery::InterfaceType::Other},
+      {"docker0", addr2, discovery::InterfaceType::Other}});
+    {
+      auto scanner = discovery::makeInterfaceScanner(std::chrono::seconds(2),
+        util::injectRef(callback), util::injectVal(io.makeIoContext()));
+      auto filter = discovery::InterfaceFilter{};
+      filter.denied.names = {"docker*"};
+      scanner.setFilter(filter);
+      scanner.enable(true);
+    }
+    REQUIRE(1 == callback.addrRanges.size());
+    REQUIRE(1 == callback.addrRanges[0].size());
+    CHECK(addr1 == callback.addrRanges[0].front());
+  }
+
+  SECTION("ChangingTheFilterRescans")
+  {
+    io.setNetworkInterfaceDetails({{"eth0", addr1, discovery::InterfaceType::Other},
+      {"docker0", addr2, discovery::InterfaceType::Other}});
+    {
+      auto scanner = discovery::makeInterfaceScanner(std::chrono::seconds(2),
+        util::injectRef(callback), util::injectVal(io.makeIoContext()));
+      scanner.enable(true);
+      auto filter = discovery::InterfaceFilter{};
+      filter.allowed.names = {"docker0"};
+      scanner.setFilter(filter);
+    }
+    REQUIRE(2 == callback.addrRanges.size());
+    CHECK(2 == callback.addrRanges[0].size());
+    REQUIRE(1 == callback.addrRanges[1].size());
+    CHECK(addr2 == callback.addrRanges[1].front());
+  }
+
+  SECTION("ChangingThePeriod")
+  {
+    {
+      auto scanner = discovery::makeInterfaceScanner(std::chrono::seconds(2),
+        util::injectRef(callback), util::injectVal(io.makeIoContext()));
+      scanner.enable(true);
+      // A longer period applies from the next scan on
+      scanner.setPeriod(std::chrono::seconds(8));
+      io.advanceTime(std::chrono::seconds(2));
+      CHECK(2 == callback.addrRanges.size());
+      io.advanceTime(std::chrono::seconds(7));
+      CHECK(2 == callback.addrRanges.size());
+      // A shorter one rescans right away
+      scanner.setPeriod(std::chrono::seconds(2));
+      CHECK(3 == callback.addrRanges.size());
+      io.advanceTime(std::chrono::seconds(2));
+      CHECK(4 == callback.addrRanges.size());
+    }
+  }
+
+  SECTION("MonitoredInterfacesAreNotPolled")
+  {
+    io.enableInterfaceMonitoring();
+    {
+      auto scanner = discovery::makeInterfaceScanner(std::chrono::seconds(2),
+        util::injectRef(callback), util::injectVal(io.makeIoContext()));
+      scanner.enable(true);
+      io.advanceTime(std::chrono::seconds(10));
+    }
+    CHECK(1 == callback.addrRanges.size());
+  }
+
+  SECTION("MonitoredChangesAreScannedOnceSettled")
+  {
+    io.enableInterfaceMonitoring();
+    {
+      auto scanner = discovery::makeInterfaceScanner(std::chrono::seconds(2),
+        util::injectRef(callback), util::injectVal(io.makeIoContext()));
+      scanner.enable(true);
+      io.setNetworkInterfaces({addr1});
+      io.flush();
+      io.setNetworkInterfaces({addr1, addr2});
+      io.advanceTime(std::chrono::milliseconds(200));
+      io.setNetworkInterfaces({addr2});
+      io.advanceTime(std::chrono::milliseconds(200));
+    }
+    REQUIRE(3 == callback.addrRanges.size());
+    REQUIRE(2 == callback.addrRanges[1].size());
+    CHECK(addr1 == callback.addrRanges[1].front());
+    CHECK(addr2 == callback.addrRanges[1].back());
+    REQUIRE(1 == callback.addrRanges[2].size());
+    CHECK(addr2 == callback.addrRanges[2].front());
+  }
+
+  SECTION("DisabledScannerIgnoresMonitoredChanges")
+  {
+    io.enableInterfaceMonitoring();
+    {
+      auto scanner = discovery::makeInterfaceScanner(std::chrono::seconds(2),
+        util::injectRef(callback), util::injectVal(io.makeIoContext()));
+      scanner.enable(true);
+      scanner.enable(false);
+      io.setNetworkInterfaces({addr1});
+      io.advanceTime(std::chrono::seconds(1));
+    }
+    CHECK(1 == callback.addrRanges.size());
+  }
 }
 
 } // namespace link
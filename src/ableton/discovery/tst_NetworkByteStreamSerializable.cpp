@@ -0,0 +1,87 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/discovery/NetworkByteStreamSerializable.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <array>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace ableton
+{
+namespace discovery
+{
+
+TEST_CASE("NetworkByteStreamSerializable")
+{
+  using Value = std::tuple<std::uint64_t, std::array<std::uint8_t, 4>, bool>;
+  const auto value = Value{0x0102030405060708, {{9, 10, 11, 12}}, true};
+
+  SECTION("PointersAndIteratorsEncodeAlike")
+  {
+    std::array<std::uint8_t, 13> bytes{};
+    std::vector<char> chars(bytes.size());
+    const auto bytesEnd = toNetworkByteStream(value, bytes.data());
+    const auto charsEnd = toNetworkByteStream(value, begin(chars));
+
+    CHECK(bytes.data() + bytes.size() == bytesEnd);
+    CHECK(end(chars) == charsEnd);
+    CHECK(std::equal(begin(bytes), end(bytes), begin(chars)));
+    CHECK(1 == bytes[0]);
+    CHECK(12 == bytes[11]);
+  }
+
+  SECTION("PointersAndIteratorsDecodeAlike")
+  {
+    std::vector<char> chars(sizeInByteStream(value));
+    toNetworkByteStream(value, begin(chars));
+    const std::vector<std::uint8_t> bytes(begin(chars), end(chars));
+    const std::uint8_t* const bytesBegin = bytes.data();
+    const std::uint8_t* const bytesEnd = bytesBegin + bytes.size();
+
+    const auto fromChars =
+      Deserialize<Value>::fromNetworkByteStream(begin(chars), end(chars));
+    const auto fromBytes =
+      Deserialize<Value>::fromNetworkByteStream(bytesBegin, bytesEnd);
+    CHECK(value == fromChars.first);
+    CHECK(value == fromBytes.first);
+    CHECK(end(chars) == fromChars.second);
+    CHECK(bytesEnd == fromBytes.second);
+  }
+
+  SECTION("TruncatedValues")
+  {
+    const auto bytes = std::array<std::uint8_t, 2>{{1, 2}};
+
+    const std::uint8_t* it = bytes.data();
+    auto number = std::uint32_t{};
+    CHECK_FALSE(tryDeserialize(it, bytes.data() + bytes.size(), number));
+
+    // Like other containers, an array takes the remaining bytes
+    it = bytes.data();
+    auto array = std::array<std::uint8_t, 4>{};
+    CHECK(tryDeserialize(it, bytes.data() + bytes.size(), array));
+    CHECK((std::array<std::uint8_t, 4>{{1, 2, 0, 0}}) == array);
+    CHECK(bytes.data() + bytes.size() == it);
+  }
+}
+
+} // namespace discovery
+} // namespace ableton
@@ -0,0 +1,83 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/discovery/PacketCapture.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <sstream>
+
+namespace ableton
+{
+namespace discovery
+{
+
+TEST_CASE("PacketCapture")
+{
+  const auto v4Packet = CapturedPacket{std::chrono::microseconds{1234567},
+    asio::ip::address_v4::from_string("192.168.0.2"),
+    {asio::ip::address_v4::from_string("192.168.0.7"), 20808}, {1, 2, 3}};
+  const auto v6Packet = CapturedPacket{std::chrono::microseconds{1234999},
+    asio::ip::address_v6::from_string("fe80::1%1"),
+    {asio::ip::address_v6::from_string("fe80::2%1"), 49152}, {}};
+
+  SECTION("ReadsThePacketsThatWereWritten")
+  {
+    std::stringstream stream;
+    PacketCaptureWriter writer{stream};
+    writer.write(v4Packet);
+    writer.write(v6Packet);
+
+    const auto packets = readPacketCapture(stream);
+    REQUIRE(2 == packets.size());
+    CHECK(v4Packet.time == packets[0].time);
+    CHECK(v4Packet.interfaceAddr == packets[0].interfaceAddr);
+    CHECK(v4Packet.from == packets[0].from);
+    CHECK(v4Packet.bytes == packets[0].bytes);
+    CHECK(v6Packet.interfaceAddr == packets[1].interfaceAddr);
+    CHECK(1 == packets[1].from.address().to_v6().scope_id());
+    CHECK(v6Packet.from == packets[1].from);
+    CHECK(packets[1].bytes.empty());
+  }
+
+  SECTION("EmptyCaptureHasNoPackets")
+  {
+    std::stringstream stream;
+    PacketCaptureWriter writer{stream};
+    CHECK(readPacketCapture(stream).empty());
+  }
+
+  SECTION("ThrowsIfTheStreamIsNoCapture")
+  {
+    std::stringstream stream{"_asdp_v\x01"};
+    CHECK_THROWS_AS(readPacketCapture(stream), std::runtime_error);
+  }
+
+  SECTION("ThrowsIfThePacketIsCutOff")
+  {
+    std::stringstream stream;
+    PacketCaptureWriter writer{stream};
+    writer.write(v4Packet);
+    auto data = stream.str();
+    data.pop_back();
+    std::stringstream truncated{data};
+    CHECK_THROWS_AS(readPacketCapture(truncated), std::runtime_error);
+  }
+}
+
+} // namespace discovery
+} // namespace ableton
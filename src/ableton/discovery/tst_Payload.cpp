@@ -164,6 +164,36 @@ TEST_CASE("Payload")
     CHECK(expectedBar.barVals == actualBar.barVals);
   }
 
+  SECTION("TryParseTruncatedEntry")
+  {
+    const auto expectedBar = test::Bar{{0, 1, 2}};
+    const auto payload = makePayload(expectedBar, test::Foo{1});
+    std::vector<char> bytes(sizeInByteStream(payload));
+    const auto end = toNetworkByteStream(payload, begin(bytes));
+
+    test::Foo actualFoo{};
+    test::Bar actualBar{};
+
+    CHECK_FALSE(tryParsePayload<test::Foo, test::Bar>(begin(bytes), end - 1,
+      [&actualFoo](const test::Foo& foo) { actualFoo = foo; },
+      [&actualBar](const test::Bar& bar) { actualBar = bar; }));
+    CHECK(0 == actualFoo.fooVal);
+    CHECK(expectedBar.barVals == actualBar.barVals);
+  }
+
+  SECTION("TryParseEntryWithTrailingBytes")
+  {
+    // An entry that doesn't consume all of its bytes is malformed
+    const auto header = PayloadEntryHeader{test::Foo::key, 5};
+    std::vector<char> bytes(sizeInByteStream(header) + 5);
+    toNetworkByteStream(test::Foo{1}, toNetworkByteStream(header, begin(bytes)));
+
+    auto isParsed = false;
+    CHECK_FALSE(tryParsePayload<test::Foo>(
+      begin(bytes), end(bytes), [&isParsed](const test::Foo&) { isParsed = true; }));
+    CHECK_FALSE(isParsed);
+  }
+
   SECTION("AddPayloads")
   {
     // The sum of a foo payload and a bar payload should be equal in
@@ -45,13 +45,19 @@ struct TestNodeState : std::tuple<std::string, double>
 struct TestMessenger
 {
   template <typename Handler>
-  void receive(Handler handler)
+  void listen(Handler handler)
   {
     receivePeerState = [handler](const PeerState<TestNodeState>& msg) { handler(msg); };
 
     receiveByeBye = [handler](const ByeBye<std::string>& msg) { handler(msg); };
   }
 
+  void suspend(const bool bSuspend)
+  {
+    isSuspended = bSuspend;
+  }
+
+  bool isSuspended = false;
   std::function<void(const PeerState<TestNodeState>&)> receivePeerState;
   std::function<void(const ByeBye<std::string>&)> receiveByeBye;
 };
@@ -119,6 +125,28 @@ TEST_CASE("PeerGateway")
     CHECK(observer.mPeersTimedOut.empty());
   }
 
+  SECTION("PeerHeardFromLeastRecentlyIsEvicted")
+  {
+    const auto peerC = TestNodeState{"peerC", 90};
+    TestMessenger cappedMessenger;
+    auto cappedListener = makePeerGateway(util::injectRef(cappedMessenger),
+      util::injectRef(observer), util::injectVal(io.makeIoContext()), 2);
+
+    cappedMessenger.receivePeerState({peerA, 5});
+    cappedMessenger.receivePeerState({peerB, 5});
+    io.advanceTime(std::chrono::seconds(1));
+    cappedMessenger.receivePeerState({peerA, 5});
+    expectPeersTimedOut({}, observer);
+
+    cappedMessenger.receivePeerState({peerC, 5});
+    expectPeersSeen({peerA, peerB, peerA, peerC}, observer);
+    expectPeersTimedOut({peerB.ident()}, observer);
+
+    // The evicted peer does not time out a second time
+    io.advanceTime(std::chrono::seconds(10));
+    expectPeersTimedOut({peerB.ident(), peerA.ident(), peerC.ident()}, observer);
+  }
+
   TestMessenger messenger;
   auto listener = makePeerGateway(util::injectRef(messenger), util::injectRef(observer),
     util::injectVal(io.makeIoContext()));
@@ -166,6 +194,44 @@ TEST_CASE("PeerGateway")
     expectPeersSeen({peerA, peerA}, observer);
     expectPeersTimedOut({peerA.ident()}, observer);
   }
+
+  SECTION("RefreshedPeerDoesNotTimeOut")
+  {
+    const auto peerC = TestNodeState{"peerC", 90};
+    messenger.receivePeerState({peerA, 5});
+    messenger.receivePeerState({peerB, 5});
+    messenger.receivePeerState({peerC, 2});
+
+    // Keep peerA alive while peerC and then peerB time out
+    for (int i = 0; i < 4; ++i)
+    {
+      io.advanceTime(std::chrono::seconds(2));
+      messenger.receivePeerState({peerA, 5});
+    }
+    expectPeersTimedOut({peerC.ident(), peerB.ident()}, observer);
+
+    io.advanceTime(std::chrono::seconds(7));
+    expectPeersTimedOut({peerC.ident(), peerB.ident(), peerA.ident()}, observer);
+  }
+
+  SECTION("SuspendedPeersLeaveAndDontTimeOut")
+  {
+    messenger.receivePeerState({peerA, 5});
+    messenger.receivePeerState({peerB, 10});
+    listener.suspend(true);
+
+    CHECK(messenger.isSuspended);
+    expectPeersLeft({peerA.ident(), peerB.ident()}, observer);
+    io.advanceTime(std::chrono::seconds(20));
+    expectPeersTimedOut({}, observer);
+
+    listener.suspend(false);
+    CHECK(!messenger.isSuspended);
+    messenger.receivePeerState({peerA, 5});
+    expectPeersSeen({peerA, peerB, peerA}, observer);
+    io.advanceTime(std::chrono::seconds(7));
+    expectPeersTimedOut({peerA.ident()}, observer);
+  }
 }
 
 } // namespace discovery
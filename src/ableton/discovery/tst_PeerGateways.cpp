@@ -126,6 +126,15 @@ TEST_CASE("PeerGateways")
     io.advanceTime(std::chrono::seconds(3));
     expectGateways(*pGateways, io, {addr2});
   }
+
+  SECTION("GatewaysOnV4AndLinkLocalV6Addresses")
+  {
+    const auto linkLocal = asio::ip::address::from_string("fe80::1");
+    const auto global = asio::ip::address::from_string("2001:db8::1");
+    io.setNetworkInterfaces({addr1, linkLocal, global});
+    pGateways->enable(true);
+    expectGateways(*pGateways, io, {addr1, linkLocal});
+  }
 }
 
 } // namespace discovery
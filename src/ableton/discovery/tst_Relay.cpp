@@ -0,0 +1,131 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/discovery/Relay.hpp>
+#include <ableton/discovery/test/Interface.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/test/serial_io/Fixture.hpp>
+
+namespace ableton
+{
+namespace discovery
+{
+namespace
+{
+
+using TestRelay = Relay<test::Interface&, uint8_t, ::ableton::test::serial_io::Context>;
+
+Subnet subnet(const char* address)
+{
+  return {asio::ip::address_v4::from_string(address), 24};
+}
+
+asio::ip::udp::endpoint endpoint(const char* address, const unsigned short port)
+{
+  return {asio::ip::address::from_string(address), port};
+}
+
+} // anonymous namespace
+
+TEST_CASE("Relay")
+{
+  ::ableton::test::serial_io::Fixture io;
+  auto iface1 = test::Interface{};
+  auto iface2 = test::Interface{};
+  auto iface3 = test::Interface{};
+  const auto peer1 = endpoint("10.0.1.5", 5000);
+  const auto remoteRelay = endpoint("10.0.9.1", 20808);
+
+  auto networks = std::vector<TestRelay::Network>{};
+  networks.push_back({util::injectRef(iface1), subnet("10.0.1.1")});
+  networks.push_back({util::injectRef(iface2), subnet("10.0.2.1")});
+  networks.push_back({util::injectRef(iface3), subnet("10.0.3.1")});
+  auto relay =
+    TestRelay{std::move(networks), {remoteRelay}, util::injectVal(io.makeIoContext())};
+
+  v1::MessageBuffer buffer;
+
+  SECTION("RepeatsAliveOnOtherNetworksAndToRemoteRelays")
+  {
+    const auto end = v1::aliveMessage(uint8_t{1}, 5, makePayload(), begin(buffer));
+    iface1.incomingMessage(peer1, begin(buffer), end);
+
+    CHECK(iface1.sentMessages.size() == 1);
+    REQUIRE(iface2.sentMessages.size() == 1);
+    REQUIRE(iface3.sentMessages.size() == 1);
+    CHECK(remoteRelay == iface1.sentMessages[0].second);
+    CHECK(multicastEndpointV4() == iface2.sentMessages[0].second);
+    CHECK(multicastEndpointV4() == iface3.sentMessages[0].second);
+    CHECK(std::vector<uint8_t>(begin(buffer), end) == iface2.sentMessages[0].first);
+    CHECK(1 == relay.metrics().messagesForwarded);
+  }
+
+  SECTION("RepeatsByeBye")
+  {
+    const auto end = v1::byeByeMessage(uint8_t{1}, begin(buffer));
+    iface1.incomingMessage(peer1, begin(buffer), end);
+
+    CHECK(1 == iface2.sentMessages.size());
+    CHECK(1 == relay.metrics().messagesForwarded);
+  }
+
+  SECTION("MessagesFromRemoteRelaysAreOnlyRepeatedLocally")
+  {
+    const auto end = v1::aliveMessage(uint8_t{1}, 5, makePayload(), begin(buffer));
+    iface2.incomingMessage(remoteRelay, begin(buffer), end);
+
+    CHECK(1 == iface1.sentMessages.size());
+    CHECK(1 == iface2.sentMessages.size());
+    CHECK(1 == iface3.sentMessages.size());
+    CHECK(multicastEndpointV4() == iface1.sentMessages[0].second);
+  }
+
+  SECTION("MessagesFromOtherNetworksAreNotRepeatedTwice")
+  {
+    // The multicast socket of the second network receives the message of the first
+    const auto end = v1::aliveMessage(uint8_t{1}, 5, makePayload(), begin(buffer));
+    iface2.incomingMessage(peer1, begin(buffer), end);
+
+    CHECK(iface1.sentMessages.empty());
+    CHECK(iface3.sentMessages.empty());
+    CHECK(1 == relay.metrics().messagesDropped);
+  }
+
+  SECTION("ResponsesAreNotRepeated")
+  {
+    const auto end = v1::responseMessage(uint8_t{1}, 5, makePayload(), begin(buffer));
+    iface1.incomingMessage(peer1, begin(buffer), end);
+
+    CHECK(iface2.sentMessages.empty());
+    CHECK(1 == relay.metrics().messagesDropped);
+  }
+
+  SECTION("KeepsListening")
+  {
+    const auto end = v1::aliveMessage(uint8_t{1}, 5, makePayload(), begin(buffer));
+    iface1.incomingMessage(peer1, begin(buffer), end);
+    iface1.incomingMessage(peer1, begin(buffer), end);
+
+    CHECK(2 == iface2.sentMessages.size());
+    CHECK(2 == relay.metrics().messagesForwarded);
+  }
+}
+
+} // namespace discovery
+} // namespace ableton
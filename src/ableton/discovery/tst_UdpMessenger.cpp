@@ -22,6 +22,7 @@
 #include <ableton/discovery/test/PayloadEntries.hpp>
 #include <ableton/test/CatchWrapper.hpp>
 #include <ableton/test/serial_io/Fixture.hpp>
+#include <algorithm>
 #include <array>
 
 namespace ableton
@@ -45,6 +46,14 @@ struct TestNodeState
     return makePayload(test::Foo{state.fooVal});
   }
 
+  template <typename It>
+  static bool tryFromPayload(const uint8_t id, It begin, It end, TestNodeState& state)
+  {
+    state = {id, 0};
+    return tryParsePayload<test::Foo>(
+      begin, end, [&state](const test::Foo& foo) { state.fooVal = foo.fooVal; });
+  }
+
   template <typename It>
   static TestNodeState fromPayload(const uint8_t id, It begin, It end)
   {
@@ -58,6 +67,18 @@ struct TestNodeState
   int32_t fooVal;
 };
 
+// The default policy with the given broadcast period and merging of unchanged states
+BroadcastPolicy broadcastPolicy(const std::chrono::milliseconds minBroadcastPeriod,
+  const bool skipUnchangedStates,
+  const std::chrono::milliseconds responseSuppressionPeriod = {})
+{
+  auto policy = defaultBroadcastPolicy();
+  policy.minBroadcastPeriod = minBroadcastPeriod;
+  policy.skipUnchangedStates = skipUnchangedStates;
+  policy.responseSuppressionPeriod = responseSuppressionPeriod;
+  return policy;
+}
+
 struct TestHandler
 {
   void operator()(PeerState<TestNodeState> state)
@@ -119,7 +140,7 @@ TEST_CASE("UdpMessenger")
     CHECK(state2.nodeId == result.first.ident);
     CHECK(1 == result.first.ttl);
     // Sent to the multicast endpoint
-    CHECK(multicastEndpoint() == sentTo);
+    CHECK(multicastEndpointV4() == sentTo);
 
     // And the payload should parse to equal to the original state
     const auto actualState =
@@ -138,6 +159,97 @@ TEST_CASE("UdpMessenger")
     CHECK(2 == iface.sentMessages.size());
   }
 
+  SECTION("UnchangedStateIsNotBroadcast")
+  {
+    auto messenger = makeUdpMessenger(
+      util::injectRef(iface), state2, util::injectVal(io.makeIoContext()), 4, 2);
+
+    io.advanceTime(std::chrono::milliseconds(100));
+    messenger.updateState(state2);
+    messenger.broadcastState();
+    CHECK(1 == iface.sentMessages.size());
+
+    messenger.updateState(TestNodeState{state2.nodeId, 11});
+    messenger.broadcastState();
+    CHECK(2 == iface.sentMessages.size());
+  }
+
+  SECTION("StateChangesWithinMinBroadcastPeriodAreMerged")
+  {
+    auto messenger = makeUdpMessenger(
+      util::injectRef(iface), state2, util::injectVal(io.makeIoContext()), 4, 2);
+
+    for (int32_t fooVal = 11; fooVal < 14; ++fooVal)
+    {
+      io.advanceTime(std::chrono::milliseconds(10));
+      messenger.updateState(TestNodeState{state2.nodeId, fooVal});
+      messenger.broadcastState();
+    }
+    CHECK(1 == iface.sentMessages.size());
+
+    io.advanceTime(std::chrono::milliseconds(30));
+    REQUIRE(2 == iface.sentMessages.size());
+    const auto messageBuffer = iface.sentMessages[1].first;
+    const auto result = v1::parseMessageHeader<TestNodeState::IdType>(
+      begin(messageBuffer), end(messageBuffer));
+    CHECK(v1::kAlive == result.first.messageType);
+    const auto actualState =
+      TestNodeState::fromPayload(state2.nodeId, result.second, end(messageBuffer));
+    CHECK(13 == actualState.fooVal);
+  }
+
+  SECTION("CustomBroadcastPolicy")
+  {
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 4, 2,
+      broadcastPolicy(std::chrono::milliseconds{200}, false));
+
+    io.advanceTime(std::chrono::milliseconds(100));
+    messenger.broadcastState();
+    CHECK(1 == iface.sentMessages.size());
+
+    // Unchanged states are broadcast as well
+    io.advanceTime(std::chrono::milliseconds(101));
+    CHECK(2 == iface.sentMessages.size());
+  }
+
+  SECTION("UrgentBroadcastsSkipTheRateLimit")
+  {
+    auto policy = defaultBroadcastPolicy();
+    policy.maxUrgentBroadcasts = 2;
+    auto messenger = makeUdpMessenger(
+      util::injectRef(iface), state2, util::injectVal(io.makeIoContext()), 4, 2, policy);
+    REQUIRE(1 == iface.sentMessages.size());
+
+    io.advanceTime(std::chrono::milliseconds(10));
+    messenger.updateState(TestNodeState{state2.nodeId, 1});
+    messenger.broadcastState();
+    CHECK(1 == iface.sentMessages.size());
+
+    // Urgent broadcasts go out within the rate limit until they are used up
+    messenger.updateState(TestNodeState{state2.nodeId, 2});
+    messenger.broadcastState(true);
+    CHECK(2 == iface.sentMessages.size());
+    messenger.updateState(TestNodeState{state2.nodeId, 3});
+    messenger.broadcastState(true);
+    CHECK(3 == iface.sentMessages.size());
+    messenger.updateState(TestNodeState{state2.nodeId, 4});
+    messenger.broadcastState(true);
+    CHECK(3 == iface.sentMessages.size());
+    CHECK(2 == messenger.broadcastMetrics().urgentBroadcastsSent);
+
+    io.advanceTime(std::chrono::milliseconds(51));
+    CHECK(4 == iface.sentMessages.size());
+
+    // One of them is available again after the minimum broadcast period
+    messenger.updateState(TestNodeState{state2.nodeId, 5});
+    messenger.broadcastState(true);
+    CHECK(5 == iface.sentMessages.size());
+    messenger.updateState(TestNodeState{state2.nodeId, 6});
+    messenger.broadcastState(true);
+    CHECK(5 == iface.sentMessages.size());
+  }
+
   SECTION("Response")
   {
     auto messenger = makeUdpMessenger(
@@ -163,6 +275,245 @@ TEST_CASE("UdpMessenger")
     CHECK(peerEndpoint == sentTo);
   }
 
+  SECTION("ResponseReflectsUpdatedState")
+  {
+    auto messenger = makeUdpMessenger(
+      util::injectRef(iface), state2, util::injectVal(io.makeIoContext()), 1, 1);
+
+    v1::MessageBuffer buffer;
+    const auto messageEnd =
+      v1::aliveMessage(state1.ident(), 0, makePayload(), begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd);
+    messenger.updateState(TestNodeState{state2.nodeId, 11});
+    iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd);
+
+    // Both responses are sent with the state at the time of the response
+    REQUIRE(3 == iface.sentMessages.size());
+    const auto firstResponse = iface.sentMessages[1].first;
+    const auto secondResponse = iface.sentMessages[2].first;
+    const auto firstResult = v1::parseMessageHeader<TestNodeState::IdType>(
+      begin(firstResponse), end(firstResponse));
+    const auto secondResult = v1::parseMessageHeader<TestNodeState::IdType>(
+      begin(secondResponse), end(secondResponse));
+    CHECK(v1::kResponse == secondResult.first.messageType);
+    CHECK(state2.fooVal
+          == TestNodeState::fromPayload(
+            state2.nodeId, firstResult.second, end(firstResponse))
+               .fooVal);
+    CHECK(11
+          == TestNodeState::fromPayload(
+            state2.nodeId, secondResult.second, end(secondResponse))
+               .fooVal);
+  }
+
+  SECTION("JitteredBroadcastPeriod")
+  {
+    auto policy = defaultBroadcastPolicy();
+    policy.periodJitter = 0.5;
+    auto messenger = makeUdpMessenger(
+      util::injectRef(iface), state2, util::injectVal(io.makeIoContext()), 4, 2, policy);
+
+    auto elapsed = std::chrono::milliseconds{0};
+    auto lastBroadcast = elapsed;
+    std::vector<std::chrono::milliseconds> periods;
+    while (periods.size() < 10)
+    {
+      const auto numSent = iface.sentMessages.size();
+      io.advanceTime(std::chrono::milliseconds(10));
+      elapsed += std::chrono::milliseconds(10);
+      if (iface.sentMessages.size() > numSent)
+      {
+        periods.push_back(elapsed - lastBroadcast);
+        lastBroadcast = elapsed;
+      }
+    }
+
+    // The nominal period of two seconds is spread by half of it
+    for (const auto period : periods)
+    {
+      CHECK(period >= std::chrono::milliseconds(1500));
+      CHECK(period <= std::chrono::milliseconds(2500));
+    }
+    CHECK(std::count(begin(periods), end(periods), periods.front()) < 10);
+  }
+
+  SECTION("BroadcastPeriodAdaptsToNumberOfNodes")
+  {
+    auto policy = defaultBroadcastPolicy();
+    policy.maxNodesAtNominalPeriod = 1;
+    auto messenger = makeUdpMessenger(
+      util::injectRef(iface), state2, util::injectVal(io.makeIoContext()), 4, 2, policy);
+
+    v1::MessageBuffer buffer;
+    const auto messageEnd =
+      v1::aliveMessage(state1.ident(), 5, makePayload(), begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd);
+    REQUIRE(2 == iface.sentMessages.size());
+
+    const auto ttlOfLastMessage = [&iface] {
+      const auto& message = iface.sentMessages.back().first;
+      return v1::parseMessageHeader<TestNodeState::IdType>(begin(message), end(message))
+        .first.ttl;
+    };
+
+    // With two nodes, the ttl and the broadcast period double
+    io.advanceTime(std::chrono::seconds(2));
+    REQUIRE(3 == iface.sentMessages.size());
+    CHECK(8 == ttlOfLastMessage());
+    io.advanceTime(std::chrono::milliseconds(3990));
+    CHECK(3 == iface.sentMessages.size());
+
+    // The peer has timed out by the next broadcast
+    io.advanceTime(std::chrono::milliseconds(10));
+    REQUIRE(4 == iface.sentMessages.size());
+    CHECK(4 == ttlOfLastMessage());
+  }
+
+  SECTION("PeriodFactorStretchesTheTtlAndTheBroadcastPeriod")
+  {
+    auto messenger = makeUdpMessenger(
+      util::injectRef(iface), state2, util::injectVal(io.makeIoContext()), 4, 2);
+    REQUIRE(1 == iface.sentMessages.size());
+
+    const auto ttlOfLastMessage = [&iface] {
+      const auto& message = iface.sentMessages.back().first;
+      return v1::parseMessageHeader<TestNodeState::IdType>(begin(message), end(message))
+        .first.ttl;
+    };
+
+    // The new ttl is broadcast right away, the next broadcast follows a period later
+    auto policy = defaultBroadcastPolicy();
+    policy.periodFactor = 4;
+    io.advanceTime(std::chrono::milliseconds(100));
+    messenger.setBroadcastPolicy(policy);
+    REQUIRE(2 == iface.sentMessages.size());
+    CHECK(16 == ttlOfLastMessage());
+    io.advanceTime(std::chrono::milliseconds(7990));
+    CHECK(2 == iface.sentMessages.size());
+    io.advanceTime(std::chrono::milliseconds(10));
+    REQUIRE(3 == iface.sentMessages.size());
+
+    // Returning to the nominal period doesn't wait for the stretched one
+    policy.periodFactor = 1;
+    io.advanceTime(std::chrono::milliseconds(100));
+    messenger.setBroadcastPolicy(policy);
+    REQUIRE(4 == iface.sentMessages.size());
+    CHECK(4 == ttlOfLastMessage());
+    io.advanceTime(std::chrono::seconds(2));
+    CHECK(5 == iface.sentMessages.size());
+  }
+
+  SECTION("ResponseSuppression")
+  {
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 1, 1,
+      broadcastPolicy(std::chrono::milliseconds{50}, true, std::chrono::seconds{5}));
+
+    v1::MessageBuffer buffer;
+    const auto messageEnd =
+      v1::aliveMessage(state1.ident(), 0, makePayload(), begin(buffer));
+
+    // The first alive message of a peer is answered, repeated ones are not
+    iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd);
+    iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd);
+    CHECK(2 == iface.sentMessages.size());
+
+    // Until our state changes
+    messenger.updateState(TestNodeState{state2.nodeId, 11});
+    iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd);
+    CHECK(3 == iface.sentMessages.size());
+
+    const auto metrics = messenger.broadcastMetrics();
+    CHECK(1 == metrics.broadcastsSent);
+    CHECK(2 == metrics.responsesSent);
+    CHECK(1 == metrics.responsesSuppressed);
+  }
+
+  SECTION("Stats")
+  {
+    auto pStats = std::make_shared<GatewayStats>();
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 1, 1, defaultBroadcastPolicy(), pStats);
+    CHECK(&*pStats == &messenger.stats());
+
+    v1::MessageBuffer buffer;
+    const auto messageEnd =
+      v1::aliveMessage(state1.ident(), 0, makePayload(), begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd);
+    const auto garbage = std::array<uint8_t, 4>{{1, 2, 3, 4}};
+    iface.incomingMessage(peerEndpoint, begin(garbage), end(garbage));
+
+    CHECK(2 == pStats->packetsSent);
+    CHECK(2 == pStats->packetsReceived);
+    CHECK(1 == pStats->parseFailures);
+  }
+
+  SECTION("TruncatedPeerStatesAreIgnored")
+  {
+    auto pStats = std::make_shared<GatewayStats>();
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 1, 1, defaultBroadcastPolicy(), pStats);
+    auto handler = TestHandler{};
+    messenger.listen(std::ref(handler));
+
+    v1::MessageBuffer buffer;
+    const auto messageEnd =
+      v1::aliveMessage(state1.ident(), 3, toPayload(state1), begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd - 1);
+
+    CHECK(handler.peerStates.empty());
+    CHECK(1 == pStats->parseFailures);
+  }
+
+  SECTION("SendFailuresDelayBroadcasts")
+  {
+    auto pStats = std::make_shared<GatewayStats>();
+    iface.sendError = asio::error::network_unreachable;
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 4, 2, defaultBroadcastPolicy(), pStats);
+    CHECK(1 == pStats->sendFailures);
+
+    // The failed broadcast is retried after a delay, which fails again
+    const auto retryPeriod = decltype(messenger)::minSendRetryPeriod();
+    io.advanceTime(retryPeriod);
+    CHECK(iface.sentMessages.empty());
+    CHECK(2 == pStats->sendFailures);
+
+    // State changes are merged into the retry, which has doubled its period
+    iface.sendError = {};
+    messenger.updateState(TestNodeState{state2.nodeId, 11});
+    messenger.broadcastState();
+    io.advanceTime(2 * retryPeriod - std::chrono::milliseconds(1));
+    CHECK(iface.sentMessages.empty());
+    io.advanceTime(std::chrono::milliseconds(1));
+    REQUIRE(1 == iface.sentMessages.size());
+    const auto messageBuffer = iface.sentMessages[0].first;
+    const auto result = v1::parseMessageHeader<TestNodeState::IdType>(
+      begin(messageBuffer), end(messageBuffer));
+    const auto actualState =
+      TestNodeState::fromPayload(state2.nodeId, result.second, end(messageBuffer));
+    CHECK(11 == actualState.fooVal);
+
+    // Succeeding resets the backoff
+    io.advanceTime(std::chrono::milliseconds(100));
+    messenger.updateState(TestNodeState{state2.nodeId, 12});
+    messenger.broadcastState();
+    CHECK(2 == iface.sentMessages.size());
+  }
+
+  SECTION("RepeatedSendFailuresAreThrown")
+  {
+    iface.sendError = asio::error::network_unreachable;
+    auto pStats = std::make_shared<GatewayStats>();
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 4, 2, defaultBroadcastPolicy(), pStats);
+
+    // Retries back off up to the nominal broadcast period of two seconds
+    CHECK_NOTHROW(io.advanceTime(std::chrono::seconds(3)));
+    CHECK(decltype(messenger)::kMaxSendFailures - 2 == pStats->sendFailures);
+    CHECK_THROWS_AS(io.advanceTime(std::chrono::seconds(3)), UdpSendException);
+  }
+
   SECTION("Receive")
   {
     auto tmpMessenger = makeUdpMessenger(
@@ -188,6 +539,473 @@ TEST_CASE("UdpMessenger")
     CHECK(state1.nodeId == handler.byeByes[0].peerId);
   }
 
+  SECTION("Listen")
+  {
+    auto messenger = makeUdpMessenger(
+      util::injectRef(iface), TestNodeState{}, util::injectVal(io.makeIoContext()), 1, 1);
+    auto handler = TestHandler{};
+    messenger.listen(std::ref(handler));
+
+    // The handler receives all messages without being set again
+    v1::MessageBuffer buffer;
+    auto end = v1::aliveMessage(state1.nodeId, 3, toPayload(state1), begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), end);
+    iface.incomingMessage(peerEndpoint, begin(buffer), end);
+    end = v1::byeByeMessage(state1.nodeId, begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), end);
+
+    CHECK(2 == handler.peerStates.size());
+    REQUIRE(1 == handler.byeByes.size());
+    CHECK(state1.nodeId == handler.byeByes[0].peerId);
+  }
+
+  SECTION("SessionGroups")
+  {
+    auto policy = defaultBroadcastPolicy();
+    policy.groupId = 7;
+    policy.useCompactMessages = true;
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 1, 1, policy);
+    auto handler = TestHandler{};
+    messenger.listen(std::ref(handler));
+
+    // All messages carry the group and v2 isn't advertised, as v2 messages don't
+    REQUIRE(1 == iface.sentMessages.size());
+    for (const auto& message : iface.sentMessages)
+    {
+      const auto result = v1::parseMessageHeader<TestNodeState::IdType>(
+        begin(message.first), end(message.first));
+      CHECK(7 == result.first.groupId);
+      auto hasCapabilities = false;
+      parsePayload<v2::Capabilities>(result.second, end(message.first),
+        [&hasCapabilities](const v2::Capabilities&) { hasCapabilities = true; });
+      CHECK_FALSE(hasCapabilities);
+    }
+
+    // Messages of other groups are ignored
+    v1::MessageBuffer buffer;
+    auto end = v1::aliveMessage(state1.nodeId, 3, toPayload(state1), begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), end);
+    CHECK(handler.peerStates.empty());
+    CHECK(1 == iface.sentMessages.size());
+
+    end = v1::detail::encodeMessage(state1.nodeId, 3, v1::kAlive, v1::SessionGroupId{7},
+      toPayload(state1), begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), end);
+    REQUIRE(1 == handler.peerStates.size());
+    CHECK(state1.nodeId == handler.peerStates[0].peerState.nodeId);
+    // The response is sent in the group as well
+    REQUIRE(2 == iface.sentMessages.size());
+    const auto response = v1::parseMessageHeader<TestNodeState::IdType>(
+      begin(iface.sentMessages[1].first), std::end(iface.sentMessages[1].first));
+    CHECK(v1::kResponse == response.first.messageType);
+    CHECK(7 == response.first.groupId);
+  }
+
+  SECTION("ListenOnly")
+  {
+    auto policy = defaultBroadcastPolicy();
+    policy.listenOnly = true;
+    {
+      auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+        util::injectVal(io.makeIoContext()), 1, 1, policy);
+      auto handler = TestHandler{};
+      messenger.listen(std::ref(handler));
+      messenger.setUnicastPeers({peerEndpoint});
+      messenger.announceTo(peerEndpoint);
+
+      // Peers aren't answered, but their states are delivered
+      v1::MessageBuffer buffer;
+      const auto end =
+        v1::aliveMessage(state1.nodeId, 3, toPayload(state1), begin(buffer));
+      iface.incomingMessage(peerEndpoint, begin(buffer), end);
+      io.advanceTime(std::chrono::seconds(3));
+      messenger.updateState(TestNodeState{state2.nodeId, 20});
+      messenger.broadcastState();
+      CHECK(1 == handler.peerStates.size());
+      CHECK(iface.sentMessages.empty());
+
+      // Switching back announces the current state, also to the unicast peer
+      policy.listenOnly = false;
+      messenger.setBroadcastPolicy(policy);
+      REQUIRE(2 == iface.sentMessages.size());
+      CHECK(v1::kAlive
+            == v1::parseMessageHeader<TestNodeState::IdType>(
+              begin(iface.sentMessages[0].first), std::end(iface.sentMessages[0].first))
+                 .first.messageType);
+
+      // And switching on again says bye bye
+      policy.listenOnly = true;
+      messenger.setBroadcastPolicy(policy);
+      REQUIRE(4 == iface.sentMessages.size());
+    }
+    // But not again on destruction
+    CHECK(4 == iface.sentMessages.size());
+  }
+
+  SECTION("HubsCountTheirLeavesAndLeavesOnlyTalkToTheirHub")
+  {
+    const auto leafEndpoint =
+      asio::ip::udp::endpoint{asio::ip::address::from_string("123.123.234.1"), 1900};
+    const auto hubEndpoint =
+      asio::ip::udp::endpoint{asio::ip::address::from_string("123.123.234.2"), 1900};
+    const auto leafCount = [](const test::Interface::SentMessage& message) {
+      const auto result = v1::parseMessageHeader<TestNodeState::IdType>(
+        begin(message.first), end(message.first));
+      auto count = LeafCount{0};
+      parsePayload<LeafCount>(result.second, end(message.first),
+        [&count](const LeafCount& entry) { count = entry; });
+      return count.count;
+    };
+    const auto messageType = [](const test::Interface::SentMessage& message) {
+      return v1::parseMessageHeader<TestNodeState::IdType>(
+        begin(message.first), end(message.first))
+        .first.messageType;
+    };
+
+    auto policy = defaultBroadcastPolicy();
+    policy.maxHubs = 1;
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 1, 1, policy);
+    auto handler = TestHandler{};
+    messenger.listen(std::ref(handler));
+
+    // Without known hubs the node is a hub, which answers its leaves and counts them
+    REQUIRE(1 == iface.sentMessages.size());
+    CHECK(multicastEndpointV4() == iface.sentMessages[0].second);
+    v1::MessageBuffer buffer;
+    auto end = v1::aliveMessage(state1.nodeId, 5, toPayload(state1), begin(buffer));
+    iface.incomingMessage(leafEndpoint, begin(buffer), end);
+    REQUIRE(2 == iface.sentMessages.size());
+    CHECK(v1::kResponse == messageType(iface.sentMessages[1]));
+    CHECK(leafEndpoint == iface.sentMessages[1].second);
+    CHECK(1 == leafCount(iface.sentMessages[1]));
+
+    // A hub with a lower id makes it a leaf, which doesn't answer multicasts
+    const auto hubState = TestNodeState{1, 20};
+    end = v1::aliveMessage(hubState.nodeId, 5, toPayload(hubState), begin(buffer));
+    iface.incomingMulticastMessage(hubEndpoint, begin(buffer), end);
+    io.advanceTime(std::chrono::milliseconds{20});
+    CHECK(2 == iface.sentMessages.size());
+    CHECK(2 == handler.peerStates.size());
+
+    // It says bye bye to all nodes and then sends its state to the hub instead of
+    // multicasting it, without a count. Its former leaf is gone.
+    io.advanceTime(std::chrono::seconds{1});
+    REQUIRE(4 == iface.sentMessages.size());
+    CHECK(v1::kByeBye == messageType(iface.sentMessages[2]));
+    CHECK(multicastEndpointV4() == iface.sentMessages[2].second);
+    CHECK(v1::kAlive == messageType(iface.sentMessages[3]));
+    CHECK(hubEndpoint == iface.sentMessages[3].second);
+    CHECK(0 == leafCount(iface.sentMessages[3]));
+    REQUIRE(1 == handler.byeByes.size());
+    CHECK(state1.nodeId == handler.byeByes[0].peerId);
+
+    // When the hub is gone, it multicasts again
+    end = v1::byeByeMessage(hubState.nodeId, begin(buffer));
+    iface.incomingMulticastMessage(hubEndpoint, begin(buffer), end);
+    io.advanceTime(std::chrono::seconds{1});
+    REQUIRE(5 == iface.sentMessages.size());
+    CHECK(v1::kAlive == messageType(iface.sentMessages[4]));
+    CHECK(multicastEndpointV4() == iface.sentMessages[4].second);
+  }
+
+  SECTION("PacketFilterFollowsIdentAndGroup")
+  {
+    auto policy = defaultBroadcastPolicy();
+    policy.useCompactMessages = true;
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 1, 1, policy);
+
+    CHECK(1 == iface.numPacketFiltersSet);
+    CHECK_FALSE(iface.packetFilter.acceptsAnyGroup);
+    CHECK(0 == iface.packetFilter.groupId);
+    CHECK(iface.packetFilter.acceptsCompactMessages);
+    CHECK(std::vector<uint8_t>{state2.nodeId} == iface.packetFilter.ownIdent);
+
+    // Compact messages are only understood in group 0
+    policy.groupId = 7;
+    messenger.setBroadcastPolicy(policy);
+    CHECK(2 == iface.numPacketFiltersSet);
+    CHECK(7 == iface.packetFilter.groupId);
+    CHECK_FALSE(iface.packetFilter.acceptsCompactMessages);
+
+    // The filter is only replaced if it changes
+    messenger.updateState({state2.nodeId, 11});
+    CHECK(2 == iface.numPacketFiltersSet);
+    messenger.updateState(state1);
+    CHECK(3 == iface.numPacketFiltersSet);
+    CHECK(std::vector<uint8_t>{state1.nodeId} == iface.packetFilter.ownIdent);
+  }
+
+  SECTION("CompactMessagesAreAdvertised")
+  {
+    auto policy = defaultBroadcastPolicy();
+    policy.useCompactMessages = true;
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 4, 2, policy);
+
+    // Without known peers the state is broadcast as v1 alive message
+    REQUIRE(1 == iface.sentMessages.size());
+    const auto messageBuffer = iface.sentMessages[0].first;
+    const auto result = v1::parseMessageHeader<TestNodeState::IdType>(
+      begin(messageBuffer), end(messageBuffer));
+    CHECK(v1::kAlive == result.first.messageType);
+    auto capabilities = v2::Capabilities{0};
+    parsePayload<v2::Capabilities>(result.second, end(messageBuffer),
+      [&capabilities](const v2::Capabilities& c) { capabilities = c; });
+    CHECK(v2::kCompactMessages == capabilities.flags);
+    CHECK(state2.fooVal
+          == TestNodeState::fromPayload(state2.nodeId, result.second, end(messageBuffer))
+               .fooVal);
+  }
+
+  SECTION("CompactMessagesWithCompactPeers")
+  {
+    auto policy = defaultBroadcastPolicy();
+    policy.useCompactMessages = true;
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 4, 2, policy);
+    auto handler = TestHandler{};
+    messenger.receive(std::ref(handler));
+
+    v2::MessageBuffer buffer;
+    const auto aliveEnd =
+      v2::aliveMessage(state1.nodeId, 10, 7, toPayload(state1), begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), aliveEnd);
+
+    // The state is received and answered with a v2 response
+    REQUIRE(1 == handler.peerStates.size());
+    CHECK(state1.fooVal == handler.peerStates[0].peerState.fooVal);
+    REQUIRE(2 == iface.sentMessages.size());
+    const auto response = iface.sentMessages[1].first;
+    CHECK(v2::kResponse
+          == v2::parseMessageHeader<TestNodeState::IdType>(begin(response), end(response))
+               .first.messageType);
+    CHECK(peerEndpoint == iface.sentMessages[1].second);
+
+    // The next broadcast is a v2 alive message, followed by heartbeats
+    io.advanceTime(std::chrono::seconds(2));
+    io.advanceTime(std::chrono::seconds(2));
+    REQUIRE(4 == iface.sentMessages.size());
+    const auto alive = iface.sentMessages[2].first;
+    const auto heartbeat = iface.sentMessages[3].first;
+    const auto aliveHeader =
+      v2::parseMessageHeader<TestNodeState::IdType>(begin(alive), end(alive)).first;
+    const auto heartbeatHeader =
+      v2::parseMessageHeader<TestNodeState::IdType>(begin(heartbeat), end(heartbeat))
+        .first;
+    CHECK(v2::kAlive == aliveHeader.messageType);
+    CHECK(v2::kHeartbeat == heartbeatHeader.messageType);
+    CHECK(aliveHeader.sequence == heartbeatHeader.sequence);
+    CHECK(heartbeat.size() < alive.size());
+    CHECK(multicastEndpointV4() == iface.sentMessages[3].second);
+    CHECK(1 == messenger.broadcastMetrics().heartbeatsSent);
+
+    // A changed state is broadcast in full again
+    messenger.updateState(TestNodeState{state2.nodeId, 11});
+    messenger.broadcastState();
+    io.advanceTime(std::chrono::milliseconds(50));
+    REQUIRE(5 == iface.sentMessages.size());
+    const auto changed = iface.sentMessages[4].first;
+    const auto changedHeader =
+      v2::parseMessageHeader<TestNodeState::IdType>(begin(changed), end(changed)).first;
+    CHECK(v2::kAlive == changedHeader.messageType);
+    CHECK(aliveHeader.sequence != changedHeader.sequence);
+  }
+
+  SECTION("ReceiveHeartbeat")
+  {
+    auto policy = defaultBroadcastPolicy();
+    policy.useCompactMessages = true;
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 4, 2, policy);
+    auto handler = TestHandler{};
+    messenger.receive(std::ref(handler));
+
+    // The heartbeat of a peer whose state we don't know is answered with a probe
+    v2::MessageBuffer buffer;
+    auto end = v2::heartbeatMessage(state1.nodeId, 4, 7, begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), end);
+    CHECK(handler.peerStates.empty());
+    REQUIRE(3 == iface.sentMessages.size());
+    const auto probe = iface.sentMessages[2].first;
+    CHECK(v2::kProbe
+          == v2::parseMessageHeader<TestNodeState::IdType>(
+            std::begin(probe), std::end(probe))
+               .first.messageType);
+    CHECK(peerEndpoint == iface.sentMessages[2].second);
+
+    // Once we have the state, heartbeats with its sequence number repeat it
+    end = v2::responseMessage(state1.nodeId, 4, 7, toPayload(state1), begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), end);
+    messenger.receive(std::ref(handler));
+    end = v2::heartbeatMessage(state1.nodeId, 3, 7, begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), end);
+
+    REQUIRE(2 == handler.peerStates.size());
+    CHECK(3 == handler.peerStates[1].ttl);
+    CHECK(state1.nodeId == handler.peerStates[1].peerState.nodeId);
+    CHECK(state1.fooVal == handler.peerStates[1].peerState.fooVal);
+  }
+
+  SECTION("CompactProbeIsAnsweredRightAway")
+  {
+    auto policy =
+      broadcastPolicy(std::chrono::milliseconds{50}, true, std::chrono::seconds{5});
+    policy.useCompactMessages = true;
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 4, 2, policy);
+
+    v2::MessageBuffer buffer;
+    auto messageEnd =
+      v2::aliveMessage(state1.nodeId, 4, 7, toPayload(state1), begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd);
+    REQUIRE(2 == iface.sentMessages.size());
+
+    // The peer missed the response, so its probe is answered despite the suppression
+    messageEnd = v2::probeMessage(state1.nodeId, 4, begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd);
+    REQUIRE(3 == iface.sentMessages.size());
+    const auto response = iface.sentMessages[2].first;
+    CHECK(v2::kResponse
+          == v2::parseMessageHeader<TestNodeState::IdType>(begin(response), end(response))
+               .first.messageType);
+    CHECK(peerEndpoint == iface.sentMessages[2].second);
+  }
+
+  SECTION("V1PeersKeepMulticastOnV1")
+  {
+    auto policy = defaultBroadcastPolicy();
+    policy.useCompactMessages = true;
+    auto messenger = makeUdpMessenger(util::injectRef(iface), state2,
+      util::injectVal(io.makeIoContext()), 4, 2, policy);
+
+    v2::MessageBuffer compactBuffer;
+    const auto compactEnd =
+      v2::aliveMessage(state1.nodeId, 4, 7, toPayload(state1), begin(compactBuffer));
+    iface.incomingMessage(peerEndpoint, begin(compactBuffer), compactEnd);
+    v1::MessageBuffer buffer;
+    const auto aliveEnd =
+      v1::aliveMessage(uint8_t{9}, 4, toPayload(state1), begin(buffer));
+    iface.incomingMessage(peerEndpoint, begin(buffer), aliveEnd);
+
+    // The v1 peer is answered with a v1 response
+    REQUIRE(3 == iface.sentMessages.size());
+    const auto response = iface.sentMessages[2].first;
+    CHECK(v1::kResponse
+          == v1::parseMessageHeader<TestNodeState::IdType>(begin(response), end(response))
+               .first.messageType);
+
+    io.advanceTime(std::chrono::seconds(2));
+    REQUIRE(4 == iface.sentMessages.size());
+    const auto alive = iface.sentMessages[3].first;
+    CHECK(v1::kAlive
+          == v1::parseMessageHeader<TestNodeState::IdType>(begin(alive), end(alive))
+               .first.messageType);
+  }
+
+  SECTION("UnicastPeers")
+  {
+    const auto relayEndpoint =
+      asio::ip::udp::endpoint{asio::ip::address::from_string("123.123.234.235"), 20808};
+    {
+      auto messenger = makeUdpMessenger(
+        util::injectRef(iface), state2, util::injectVal(io.makeIoContext()), 4, 2);
+      REQUIRE(1 == iface.sentMessages.size());
+
+      // The peers are sent the state right away...
+      messenger.setUnicastPeers({peerEndpoint, relayEndpoint});
+      REQUIRE(3 == iface.sentMessages.size());
+      CHECK(peerEndpoint == iface.sentMessages[1].second);
+      CHECK(relayEndpoint == iface.sentMessages[2].second);
+
+      // ...and with every broadcast
+      io.advanceTime(std::chrono::seconds(3));
+      REQUIRE(6 == iface.sentMessages.size());
+      CHECK(multicastEndpointV4() == iface.sentMessages[3].second);
+      CHECK(peerEndpoint == iface.sentMessages[4].second);
+      CHECK(relayEndpoint == iface.sentMessages[5].second);
+      const auto alive = iface.sentMessages[5].first;
+      CHECK(v1::kAlive
+            == v1::parseMessageHeader<TestNodeState::IdType>(begin(alive), end(alive))
+                 .first.messageType);
+    }
+
+    // They are told when the messenger goes away
+    REQUIRE(9 == iface.sentMessages.size());
+    CHECK(relayEndpoint == iface.sentMessages[8].second);
+    const auto byeBye = iface.sentMessages[8].first;
+    CHECK(v1::kByeBye
+          == v1::parseMessageHeader<TestNodeState::IdType>(begin(byeBye), end(byeBye))
+               .first.messageType);
+  }
+
+  SECTION("AnnounceTo")
+  {
+    auto messenger = makeUdpMessenger(
+      util::injectRef(iface), state2, util::injectVal(io.makeIoContext()), 4, 2);
+    REQUIRE(1 == iface.sentMessages.size());
+
+    messenger.announceTo(peerEndpoint);
+    REQUIRE(2 == iface.sentMessages.size());
+    CHECK(peerEndpoint == iface.sentMessages[1].second);
+    const auto alive = iface.sentMessages[1].first;
+    CHECK(v1::kAlive
+          == v1::parseMessageHeader<TestNodeState::IdType>(begin(alive), end(alive))
+               .first.messageType);
+
+    messenger.suspend(true);
+    messenger.announceTo(peerEndpoint);
+    CHECK(3 == iface.sentMessages.size());
+  }
+
+  SECTION("SuspendSaysByeByeAndResumeAnnouncesState")
+  {
+    {
+      auto messenger = makeUdpMessenger(
+        util::injectRef(iface), state2, util::injectVal(io.makeIoContext()), 4, 2);
+      auto handler = TestHandler{};
+      messenger.receive(std::ref(handler));
+      REQUIRE(1 == iface.sentMessages.size());
+
+      messenger.suspend(true);
+      REQUIRE(2 == iface.sentMessages.size());
+      const auto byeBye = iface.sentMessages[1].first;
+      CHECK(v1::kByeBye
+            == v1::parseMessageHeader<TestNodeState::IdType>(begin(byeBye), end(byeBye))
+                 .first.messageType);
+
+      // Neither the heartbeat nor state changes are broadcast, and peers are ignored
+      io.advanceTime(std::chrono::seconds(5));
+      messenger.updateState(TestNodeState{state2.nodeId, 20});
+      messenger.broadcastState();
+      v1::MessageBuffer buffer;
+      const auto messageEnd =
+        v1::aliveMessage(state1.nodeId, 3, toPayload(state1), begin(buffer));
+      iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd);
+      CHECK(2 == iface.sentMessages.size());
+      CHECK(handler.peerStates.empty());
+
+      // Resuming broadcasts the current state without delay
+      messenger.suspend(false);
+      REQUIRE(3 == iface.sentMessages.size());
+      const auto alive = iface.sentMessages[2].first;
+      const auto result =
+        v1::parseMessageHeader<TestNodeState::IdType>(begin(alive), end(alive));
+      CHECK(v1::kAlive == result.first.messageType);
+      CHECK(20
+            == TestNodeState::fromPayload(state2.nodeId, result.second, end(alive))
+                 .fooVal);
+
+      iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd);
+      CHECK(1 == handler.peerStates.size());
+      messenger.suspend(true);
+    }
+    // A suspended messenger doesn't say bye bye again on destruction
+    CHECK(5 == iface.sentMessages.size());
+  }
+
   SECTION("SendByeByeOnDestruction")
   {
     {
@@ -200,7 +1018,7 @@ TEST_CASE("UdpMessenger")
     const auto result = v1::parseMessageHeader<TestNodeState::IdType>(
       begin(messageBuffer), end(messageBuffer));
     CHECK(v1::kByeBye == result.first.messageType);
-    CHECK(multicastEndpoint() == sentTo);
+    CHECK(multicastEndpointV4() == sentTo);
   }
 
   SECTION("MovingMessengerDoesntSendByeBye")
@@ -0,0 +1,191 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/discovery/test/PayloadEntries.hpp>
+#include <ableton/discovery/v2/Messages.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <array>
+#include <vector>
+
+namespace ableton
+{
+namespace discovery
+{
+namespace v2
+{
+namespace
+{
+
+// For testing just use a single byte identifier
+using NodeId = uint8_t;
+
+// An entry with a compact key
+struct Compact
+{
+  static const std::int32_t key = '_cmp';
+  static_assert(key == 0x5f636d70, "Unexpected byte order");
+  static const std::uint8_t compactKey = 1;
+
+  friend std::uint32_t sizeInByteStream(const Compact& compact)
+  {
+    return discovery::sizeInByteStream(compact.value);
+  }
+
+  template <typename It>
+  friend It toNetworkByteStream(const Compact& compact, It out)
+  {
+    return discovery::toNetworkByteStream(compact.value, std::move(out));
+  }
+
+  template <typename It>
+  static std::pair<Compact, It> fromNetworkByteStream(It begin, It end)
+  {
+    auto result = Deserialize<decltype(value)>::fromNetworkByteStream(
+      std::move(begin), std::move(end));
+    return std::make_pair(Compact{result.first}, std::move(result.second));
+  }
+
+  std::int64_t value;
+};
+
+} // anonymous namespace
+
+TEST_CASE("Varint", "[Messages]")
+{
+  std::array<uint8_t, 5> buffer{};
+  for (const auto value : {0u, 1u, 127u, 128u, 300u, 16384u, 0xffffffffu})
+  {
+    const auto end = encodeVarint(value, begin(buffer));
+    const auto size = static_cast<uint32_t>(std::distance(begin(buffer), end));
+    CHECK(sizeOfVarint(value) == size);
+    const auto result = decodeVarint(begin(buffer), end);
+    CHECK(value == result.first);
+    CHECK(end == result.second);
+  }
+
+  const auto truncatedEnd = encodeVarint(300u, begin(buffer)) - 1;
+  CHECK_THROWS_AS(decodeVarint(begin(buffer), truncatedEnd), std::range_error);
+
+  const std::array<uint8_t, 5> tooLarge = {{0xff, 0xff, 0xff, 0xff, 0x1f}};
+  CHECK_THROWS_AS(decodeVarint(begin(tooLarge), end(tooLarge)), std::range_error);
+}
+
+TEST_CASE("ParseV1Message", "[Messages]")
+{
+  std::array<char, 32> buffer{};
+  const auto endAlive = v1::aliveMessage(NodeId{1}, 5, makePayload(), begin(buffer));
+  const auto result = parseMessageHeader<NodeId>(begin(buffer), endAlive);
+  CHECK(kInvalid == result.first.messageType);
+  CHECK(begin(buffer) == result.second);
+}
+
+TEST_CASE("V1IgnoresV2Messages", "[Messages]")
+{
+  std::array<char, 32> buffer{};
+  const auto endAlive = aliveMessage(NodeId{1}, 5, 7, makePayload(), begin(buffer));
+  const auto result = v1::parseMessageHeader<NodeId>(begin(buffer), endAlive);
+  CHECK(v1::kInvalid == result.first.messageType);
+}
+
+TEST_CASE("ParseTruncatedSequence", "[Messages]")
+{
+  std::array<char, 32> buffer{};
+  const auto endHeartbeat = heartbeatMessage(NodeId{1}, 5, 300, begin(buffer));
+  const auto result = parseMessageHeader<NodeId>(begin(buffer), endHeartbeat - 1);
+  CHECK(kInvalid == result.first.messageType);
+  CHECK(begin(buffer) == result.second);
+}
+
+TEST_CASE("RoundtripHeartbeat", "[Messages]")
+{
+  std::array<char, 32> buffer{};
+  const uint8_t ident = 1;
+  const auto endHeartbeat = heartbeatMessage(ident, 5, 300, begin(buffer));
+  // Protocol header, type, ttl, ident and a two byte sequence number
+  CHECK(9 == std::distance(begin(buffer), endHeartbeat));
+  const auto result = parseMessageHeader<NodeId>(begin(buffer), endHeartbeat);
+  CHECK(endHeartbeat == result.second);
+  CHECK(kHeartbeat == result.first.messageType);
+  CHECK(5 == result.first.ttl);
+  CHECK(ident == result.first.ident);
+  CHECK(300 == result.first.sequence);
+}
+
+TEST_CASE("RoundtripAliveWithPayload", "[Messages]")
+{
+  using Payload = decltype(makePayload(Compact{}, test::Foo{}));
+  const auto payload = makePayload(Compact{-3}, test::Foo{42});
+
+  MessageBuffer buffer{};
+  const auto endAlive = aliveMessage(NodeId{1}, 5, 7, payload, begin(buffer));
+  const auto result = parseMessageHeader<NodeId>(begin(buffer), endAlive);
+  REQUIRE(kAlive == result.first.messageType);
+  CHECK(7 == result.first.sequence);
+
+  // The compact entry takes a two byte header, the escaped one six bytes
+  CHECK(2 + 8 + 6 + 4
+        == static_cast<std::size_t>(std::distance(result.second, endAlive)));
+  CHECK(sizeInByteStream(payload) - 8
+        == static_cast<std::size_t>(std::distance(result.second, endAlive)));
+
+  const auto compactSize =
+    static_cast<std::size_t>(std::distance(result.second, endAlive));
+  std::vector<uint8_t> expanded(kMaxPayloadExpansion * compactSize);
+  const auto expandedEnd =
+    expandPayload<Payload>(result.second, endAlive, expanded.data());
+  CHECK(sizeInByteStream(payload)
+        == static_cast<std::size_t>(std::distance(expanded.data(), expandedEnd)));
+
+  auto compactValue = std::int64_t{0};
+  auto fooValue = std::int32_t{0};
+  parsePayload<Compact, test::Foo>(
+    expanded.data(), expandedEnd, [&](const Compact& c) { compactValue = c.value; },
+    [&](const test::Foo& foo) { fooValue = foo.fooVal; });
+  CHECK(-3 == compactValue);
+  CHECK(42 == fooValue);
+}
+
+TEST_CASE("ExpandDropsUnknownCompactKeys", "[Messages]")
+{
+  std::array<uint8_t, 64> compact{};
+  const auto compactEnd =
+    toCompactByteStream(makePayload(Compact{-3}, test::Foo{42}), begin(compact));
+
+  // A payload type without the Compact entry keeps the escaped Foo entry only
+  std::array<uint8_t, 256> expanded{};
+  const auto expandedEnd = expandPayload<decltype(makePayload(test::Foo{}))>(
+    begin(compact), compactEnd, begin(expanded));
+  CHECK(sizeInByteStream(makePayload(test::Foo{42}))
+        == static_cast<std::size_t>(std::distance(begin(expanded), expandedEnd)));
+}
+
+TEST_CASE("ExpandThrowsOnIncorrectSize", "[Messages]")
+{
+  std::array<uint8_t, 64> compact{};
+  const auto compactEnd = toCompactByteStream(makePayload(Compact{-3}), begin(compact));
+
+  std::array<uint8_t, 256> expanded{};
+  CHECK_THROWS_AS(expandPayload<decltype(makePayload(Compact{}))>(
+                    begin(compact), compactEnd - 1, begin(expanded)),
+    std::range_error);
+}
+
+} // namespace v2
+} // namespace discovery
+} // namespace ableton
@@ -0,0 +1,262 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/Link.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Measures how long it takes from committing a change with commitAudioSessionState
+// on one Link instance until the other instances see it with
+// captureAudioSessionState, e.g.
+//
+//   LinkLatency --peers 4 --changes 200 --interval 100
+//
+// The instances run in this process and find each other on the network interfaces
+// of the host like separate apps would, so every stage of the pipeline is included:
+// the hand-over from the audio thread, the io thread, the broadcast and its rate
+// limit, and the handling of the received state. The first instance alternates
+// between changing the tempo and starting or stopping the transport. The other
+// instances are polled from the same thread, which plays the audio thread of all
+// of them. The interval is given in milliseconds, the wait for the session and the
+// timeout of a change in seconds. With --thread-per-interface, the instances handle
+// each interface on a thread of its own.
+
+namespace
+{
+
+using namespace std::chrono;
+
+void printUsage()
+{
+  std::cout << "usage: LinkLatency [--peers n] [--changes n] [--interval ms]\n"
+               "                   [--poll us] [--timeout s] [--thread-per-interface]\n";
+}
+
+struct Config
+{
+  std::size_t numPeers = 2;
+  std::size_t numChanges = 100;
+  milliseconds interval{200};
+  microseconds pollPeriod{50};
+  seconds timeout{5};
+  bool threadPerInterface = false;
+};
+
+// The latencies of all instances but the first for one kind of change
+struct Latencies
+{
+  std::vector<microseconds> samples;
+  std::size_t numTimeouts = 0;
+
+  void print(const std::string& name)
+  {
+    std::cout << name << ":";
+    if (samples.empty())
+    {
+      std::cout << " no samples";
+    }
+    else
+    {
+      std::sort(samples.begin(), samples.end());
+      std::cout << " p50 " << percentile(0.5).count() << " us, p99 "
+                << percentile(0.99).count() << " us, max " << samples.back().count()
+                << " us (" << samples.size() << " samples)";
+    }
+    if (numTimeouts > 0)
+    {
+      std::cout << ", " << numTimeouts << " timed out";
+    }
+    std::cout << "\n";
+  }
+
+  microseconds percentile(const double p) const
+  {
+    const auto rank = static_cast<std::size_t>(
+      std::ceil(p * static_cast<double>(samples.size())));
+    return samples[(std::max)(rank, std::size_t{1}) - 1];
+  }
+};
+
+bool waitForSession(
+  std::vector<std::unique_ptr<ableton::Link>>& links, const seconds timeout)
+{
+  const auto deadline = steady_clock::now() + timeout;
+  while (steady_clock::now() < deadline)
+  {
+    if (std::all_of(links.begin(), links.end(),
+          [&links](const std::unique_ptr<ableton::Link>& pLink) {
+            return pLink->numPeers() + 1 == links.size();
+          }))
+    {
+      return true;
+    }
+    std::this_thread::sleep_for(milliseconds{10});
+  }
+  return false;
+}
+
+// Commits a change on the first instance and polls the others until all of them
+// see it or the timeout has passed
+template <typename Commit, typename IsVisible>
+void measureChange(std::vector<std::unique_ptr<ableton::Link>>& links,
+  const Config& config,
+  Commit commit,
+  IsVisible isVisible,
+  Latencies& latencies)
+{
+  auto& source = *links.front();
+  auto sessionState = source.captureAudioSessionState();
+  const auto start = source.clock().micros();
+  commit(sessionState, start);
+  source.commitAudioSessionState(sessionState);
+
+  std::vector<bool> hasSeen(links.size(), false);
+  auto numPending = links.size() - 1;
+  while (numPending > 0)
+  {
+    const auto now = source.clock().micros();
+    for (std::size_t i = 1; i < links.size(); ++i)
+    {
+      if (!hasSeen[i] && isVisible(links[i]->captureAudioSessionState()))
+      {
+        hasSeen[i] = true;
+        --numPending;
+        latencies.samples.push_back(links[i]->clock().micros() - start);
+      }
+    }
+    if (now - start > config.timeout)
+    {
+      latencies.numTimeouts += numPending;
+      return;
+    }
+    std::this_thread::sleep_for(config.pollPeriod);
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  Config config;
+  for (int i = 1; i < argc; ++i)
+  {
+    const auto hasValue = i + 1 < argc;
+    if (std::strcmp(argv[i], "--peers") == 0 && hasValue)
+    {
+      config.numPeers = std::strtoul(argv[++i], nullptr, 10);
+    }
+    else if (std::strcmp(argv[i], "--changes") == 0 && hasValue)
+    {
+      config.numChanges = std::strtoul(argv[++i], nullptr, 10);
+    }
+    else if (std::strcmp(argv[i], "--interval") == 0 && hasValue)
+    {
+      config.interval = milliseconds{std::strtoll(argv[++i], nullptr, 10)};
+    }
+    else if (std::strcmp(argv[i], "--poll") == 0 && hasValue)
+    {
+      config.pollPeriod = microseconds{std::strtoll(argv[++i], nullptr, 10)};
+    }
+    else if (std::strcmp(argv[i], "--timeout") == 0 && hasValue)
+    {
+      config.timeout = seconds{std::strtoll(argv[++i], nullptr, 10)};
+    }
+    else if (std::strcmp(argv[i], "--thread-per-interface") == 0)
+    {
+      config.threadPerInterface = true;
+    }
+    else
+    {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (config.numPeers < 2)
+  {
+    std::cerr << "at least two peers are needed\n";
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<ableton::Link>> links;
+  for (std::size_t i = 0; i < config.numPeers; ++i)
+  {
+    links.emplace_back(new ableton::Link(120.));
+    links.back()->enableStartStopSync(true);
+    links.back()->enableThreadPerInterface(config.threadPerInterface);
+    links.back()->enable(true);
+  }
+
+  if (!waitForSession(links, config.timeout))
+  {
+    std::cerr << "the instances didn't find each other within "
+              << config.timeout.count() << " s\n";
+    return 1;
+  }
+  std::this_thread::sleep_for(milliseconds{500});
+
+  Latencies tempoLatencies;
+  Latencies startStopLatencies;
+  auto tempo = 120.;
+  auto isPlaying = false;
+  for (std::size_t i = 0; i < config.numChanges; ++i)
+  {
+    if (i % 2 == 0)
+    {
+      tempo = tempo == 120. ? 121. : 120.;
+      measureChange(
+        links, config,
+        [tempo](ableton::Link::SessionState& state, const microseconds time) {
+          state.setTempo(tempo, time);
+        },
+        // The tempo is sent as an integral number of microseconds per beat
+        [tempo](const ableton::Link::SessionState& state) {
+          return std::abs(state.tempo() - tempo) < 1e-3;
+        },
+        tempoLatencies);
+    }
+    else
+    {
+      isPlaying = !isPlaying;
+      measureChange(
+        links, config,
+        [isPlaying](ableton::Link::SessionState& state, const microseconds time) {
+          state.setIsPlaying(isPlaying, time);
+        },
+        [isPlaying](const ableton::Link::SessionState& state) {
+          return state.isPlaying() == isPlaying;
+        },
+        startStopLatencies);
+    }
+    std::this_thread::sleep_for(config.interval);
+  }
+
+  std::cout << "peers: " << config.numPeers << "\n";
+  tempoLatencies.print("tempo");
+  startStopLatencies.print("start/stop");
+  return 0;
+}
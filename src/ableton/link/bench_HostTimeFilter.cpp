@@ -0,0 +1,75 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#include <ableton/link/HostTimeFilter.hpp>
+#include <ableton/platforms/Config.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+namespace ableton
+{
+namespace link
+{
+
+TEST_CASE("HostTimeFilter", "[benchmark]")
+{
+  using Clock = platform::Clock;
+
+  // Start with full filters, as they are after the first buffers of a stream
+  auto sampleTime = 0.;
+  BasicHostTimeFilter<Clock, double> filter;
+  BasicIncrementalHostTimeFilter<Clock, double> incrementalFilter;
+  BasicRobustHostTimeFilter<Clock, double> robustFilter;
+  BasicRobustHostTimeFilter<Clock, float> robustFloatFilter;
+  for (auto i = 0; i < 1024; ++i)
+  {
+    sampleTime += 512.;
+    filter.sampleTimeToHostTime(sampleTime);
+    incrementalFilter.sampleTimeToHostTime(sampleTime);
+    robustFilter.sampleTimeToHostTime(sampleTime);
+    robustFloatFilter.sampleTimeToHostTime(sampleTime);
+  }
+
+  BENCHMARK("BasicHostTimeFilter::sampleTimeToHostTime")
+  {
+    sampleTime += 512.;
+    return filter.sampleTimeToHostTime(sampleTime);
+  };
+
+  BENCHMARK("BasicIncrementalHostTimeFilter::sampleTimeToHostTime")
+  {
+    sampleTime += 512.;
+    return incrementalFilter.sampleTimeToHostTime(sampleTime);
+  };
+
+  BENCHMARK("BasicRobustHostTimeFilter<double>::sampleTimeToHostTime")
+  {
+    sampleTime += 512.;
+    return robustFilter.sampleTimeToHostTime(sampleTime);
+  };
+
+  BENCHMARK("BasicRobustHostTimeFilter<float>::sampleTimeToHostTime")
+  {
+    sampleTime += 512.;
+    return robustFloatFilter.sampleTimeToHostTime(sampleTime);
+  };
+}
+
+} // namespace link
+} // namespace ableton
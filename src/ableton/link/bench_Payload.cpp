@@ -0,0 +1,54 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#include <ableton/link/NodeState.hpp>
+#include <ableton/link/v1/Messages.hpp>
+#include <ableton/platforms/stl/Random.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+namespace ableton
+{
+namespace link
+{
+
+TEST_CASE("NodeState payload", "[benchmark]")
+{
+  using Random = platforms::stl::Random;
+
+  const auto state = NodeState{NodeId::random<Random>(), NodeId::random<Random>(),
+    Timeline{Tempo{120.}, Beats{1.}, std::chrono::microseconds{1234}},
+    StartStopState{true, Beats{0.}, std::chrono::microseconds{2345}}};
+  v1::MessageBuffer buffer;
+  const uint8_t* const begin = buffer.data();
+  const uint8_t* const end = toNetworkByteStream(toPayload(state), buffer.data());
+
+  BENCHMARK("encode")
+  {
+    return toNetworkByteStream(toPayload(state), buffer.begin());
+  };
+
+  BENCHMARK("parsePayload")
+  {
+    return NodeState::fromPayload(state.nodeId, begin, end);
+  };
+}
+
+} // namespace link
+} // namespace ableton
@@ -0,0 +1,83 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#include <ableton/link/Peers.hpp>
+#include <ableton/platforms/stl/Random.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/test/serial_io/Fixture.hpp>
+#include <string>
+#include <vector>
+
+namespace ableton
+{
+namespace link
+{
+namespace
+{
+
+struct NullCallback
+{
+  template <typename... Args>
+  void operator()(Args&&...) const
+  {
+  }
+};
+
+} // namespace
+
+TEST_CASE("Peers::sawPeerOnGateway", "[benchmark]")
+{
+  using Random = platforms::stl::Random;
+
+  const auto gateway = asio::ip::address::from_string("123.123.123.123");
+  const auto sessionId = NodeId::random<Random>();
+
+  for (const auto numPeers : {10, 100, 1000})
+  {
+    test::serial_io::Fixture io;
+    auto peers = makePeers(util::injectVal(io.makeIoContext()), NullCallback{},
+      NullCallback{}, NullCallback{});
+    auto observer = makeGatewayObserver(peers, gateway);
+
+    // All peers are in the same session, the common case
+    const auto timeline = Timeline{Tempo{120.}, Beats{0.}, std::chrono::microseconds{0}};
+    std::vector<PeerState> states;
+    for (auto i = 0; i < numPeers; ++i)
+    {
+      states.push_back(PeerState{
+        {NodeId::random<Random>(), sessionId, timeline, StartStopState{},
+          PendingTimeline{}, TempoRamp{}, 0, Timeline{}},
+        {},
+        ClockDomain{}, 0});
+      sawPeer(observer, states.back());
+    }
+    io.flush();
+
+    auto i = std::size_t{0};
+    BENCHMARK(std::to_string(numPeers) + " peers")
+    {
+      sawPeer(observer, states[i++ % states.size()]);
+      io.flush();
+    };
+  }
+}
+
+} // namespace link
+} // namespace ableton
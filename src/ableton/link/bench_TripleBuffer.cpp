@@ -0,0 +1,103 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#include <ableton/link/Timeline.hpp>
+#include <ableton/link/TripleBuffer.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <atomic>
+#include <thread>
+
+namespace ableton
+{
+namespace link
+{
+
+TEST_CASE("TripleBuffer", "[benchmark]")
+{
+  TripleBuffer<Timeline> buffer;
+  auto timeline = Timeline{Tempo{120.}, Beats{0.}, std::chrono::microseconds{0}};
+
+  BENCHMARK("write")
+  {
+    timeline.timeOrigin += std::chrono::microseconds{1};
+    buffer.write(timeline);
+  };
+
+  BENCHMARK("read")
+  {
+    return buffer.read();
+  };
+
+  BENCHMARK("write/readNew")
+  {
+    timeline.timeOrigin += std::chrono::microseconds{1};
+    buffer.write(timeline);
+    return buffer.readNew();
+  };
+}
+
+TEST_CASE("TripleBuffer | Contended", "[benchmark]")
+{
+  TripleBuffer<Timeline> buffer;
+  auto timeline = Timeline{Tempo{120.}, Beats{0.}, std::chrono::microseconds{0}};
+  std::atomic<bool> isRunning{true};
+
+  SECTION("ReadWhileWriting")
+  {
+    std::thread writer([&] {
+      auto written = timeline;
+      while (isRunning.load(std::memory_order_relaxed))
+      {
+        written.timeOrigin += std::chrono::microseconds{1};
+        buffer.write(written);
+      }
+    });
+
+    BENCHMARK("read")
+    {
+      return buffer.read();
+    };
+
+    isRunning = false;
+    writer.join();
+  }
+
+  SECTION("WriteWhileReading")
+  {
+    std::thread reader([&] {
+      while (isRunning.load(std::memory_order_relaxed))
+      {
+        buffer.read();
+      }
+    });
+
+    BENCHMARK("write")
+    {
+      timeline.timeOrigin += std::chrono::microseconds{1};
+      buffer.write(timeline);
+    };
+
+    isRunning = false;
+    reader.join();
+  }
+}
+
+} // namespace link
+} // namespace ableton
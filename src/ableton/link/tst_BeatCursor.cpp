@@ -0,0 +1,152 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#include <ableton/link/BeatCursor.hpp>
+#include <ableton/link/TempoRamp.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <cmath>
+
+namespace ableton
+{
+namespace link
+{
+
+TEST_CASE("BeatCursor")
+{
+  using std::chrono::microseconds;
+
+  const auto tl0 = Timeline{Tempo{120.}, Beats{1.}, microseconds{0}};
+  const auto tl1 = Timeline{Tempo{97.3}, Beats{-9.5}, microseconds{2000000}};
+  const auto sampleRate = 44100.;
+  // A micro beat plus the beats of half a microsecond at 120 bpm
+  const auto tolerance = 1e-6 + 1e-6;
+
+  SECTION("StartsAtPhaseEncodedBeats")
+  {
+    for (const auto quantum : {Beats{0.}, Beats{1.}, Beats{2.4}, Beats{4.}})
+    {
+      const auto time = microseconds{-1234567};
+      const auto cursor = BeatCursor{tl1, time, sampleRate, quantum};
+      const auto expected = toPhaseEncodedBeats(tl1, time, quantum);
+      CHECK(std::abs(expected.floating() - cursor.beats()) < tolerance);
+      CHECK(std::abs(phase(expected, quantum).floating() - cursor.phase()) < tolerance);
+      CHECK(time == cursor.time());
+    }
+  }
+
+  SECTION("FollowsTheTimeline")
+  {
+    for (const auto& tl : {tl0, tl1})
+    {
+      for (const auto quantum : {Beats{0.}, Beats{1.}, Beats{2.4}, Beats{4.}})
+      {
+        auto cursor = BeatCursor{tl, microseconds{-3000000}, sampleRate, quantum};
+        // Render an hour in blocks of 512 samples and check every 100th block
+        for (auto block = 0; block < 310000; ++block)
+        {
+          if (block % 100 == 0)
+          {
+            const auto expected = toPhaseEncodedBeats(tl, cursor.time(), quantum);
+            CHECK(std::abs(expected.floating() - cursor.beats()) < tolerance);
+            const auto expectedPhase = phase(expected, quantum).floating();
+            const auto phaseDiff = std::abs(expectedPhase - cursor.phase());
+            // Close to a quantum boundary the phases may be on different sides
+            CHECK((phaseDiff < tolerance
+                   || std::abs(phaseDiff - quantum.floating()) < tolerance));
+            CHECK(cursor.phase() >= 0.);
+            CHECK((cursor.phase() < quantum.floating() || quantum == Beats{0.}));
+          }
+          cursor.advance(512);
+        }
+      }
+    }
+  }
+
+  SECTION("FollowsTempoRamp")
+  {
+    // The timeline continues the ramp at its end
+    const auto ramp =
+      TempoRamp{Timeline{Tempo{120.}, tl0.toBeats(microseconds{1000000}),
+                  microseconds{1000000}},
+        Tempo{180.}, Beats{8.}, TempoCurve::Exponential};
+    const auto endTl = ramp.endTimeline();
+    const auto tl =
+      Timeline{endTl.tempo, tl0.beatOrigin, endTl.fromBeats(tl0.beatOrigin)};
+    const auto ramped = rampedTimeline(tl, ramp);
+    const auto quantum = Beats{4.};
+
+    auto cursor = BeatCursor{tl, ramp, microseconds{0}, sampleRate, quantum};
+    CHECK_FALSE(cursor.sync(tl, ramp));
+    // Render past the end of the ramp in blocks of 512 samples
+    for (auto block = 0; block < 1000; ++block)
+    {
+      const auto expected = toPhaseEncodedBeats(ramped, cursor.time(), quantum);
+      CHECK(std::abs(expected.floating() - cursor.beats()) < tolerance);
+      // Within a block the cursor misses the change of the tempo
+      const auto ahead =
+        toPhaseEncodedBeats(ramped, cursor.time() + microseconds{11610}, quantum);
+      CHECK(std::abs(ahead.floating() - cursor.beatsAtSample(512)) < 1e-4);
+      cursor.advance(512);
+    }
+    CHECK(cursor.time() > ramp.endTime());
+  }
+
+  SECTION("BeatsAtSampleLookAhead")
+  {
+    auto cursor = BeatCursor{tl0, microseconds{0}, sampleRate, Beats{4.}};
+    const auto ahead = cursor.beatsAtSample(1000);
+    const auto phaseAhead = cursor.phaseAtSample(1000);
+    cursor.advance(1000);
+    CHECK(ahead == cursor.beats());
+    CHECK(phaseAhead == cursor.phase());
+  }
+
+  SECTION("SyncToSameTimelineDoesNothing")
+  {
+    auto cursor = BeatCursor{tl0, microseconds{0}, sampleRate, Beats{4.}};
+    cursor.advance(12345);
+    const auto beats = cursor.beats();
+    CHECK_FALSE(cursor.sync(tl0));
+    CHECK(beats == cursor.beats());
+  }
+
+  SECTION("SyncToChangedTimeline")
+  {
+    const auto quantum = Beats{4.};
+    auto cursor = BeatCursor{tl0, microseconds{0}, sampleRate, quantum};
+    cursor.advance(44100 * 10);
+    const auto time = cursor.time();
+    CHECK(microseconds{10000000} == time);
+
+    CHECK(cursor.sync(tl1));
+    CHECK(time == cursor.time());
+    CHECK(std::abs(toPhaseEncodedBeats(tl1, time, quantum).floating() - cursor.beats())
+          < tolerance);
+
+    cursor.advance(44100);
+    CHECK(std::abs(
+            toPhaseEncodedBeats(tl1, time + microseconds{1000000}, quantum).floating()
+            - cursor.beats())
+          < tolerance);
+  }
+}
+
+} // namespace link
+} // namespace ableton
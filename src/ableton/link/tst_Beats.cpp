@@ -25,6 +25,14 @@ namespace ableton
 namespace link
 {
 
+// The integral arithmetic can be evaluated at compile time
+static_assert((Beats{INT64_C(700000)} - Beats{INT64_C(200000)}) % Beats{INT64_C(300000)}
+                == abs(-Beats{INT64_C(200000)}),
+  "Beats arithmetic is not constexpr");
+static_assert(Beats{INT64_C(0)} % Beats{INT64_C(0)} == Beats{INT64_C(0)},
+  "Beats modulo is not constexpr");
+static_assert(noexcept(Beats{0.5}), "Constructing Beats may throw");
+
 TEST_CASE("Beats")
 {
   SECTION("ConstructFromFloating")
@@ -0,0 +1,251 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#include <ableton/link/CallbackMailbox.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace ableton
+{
+namespace link
+{
+
+namespace
+{
+
+struct Received
+{
+  bool take(CallbackMailbox& mailbox)
+  {
+    return mailbox.take([this](const std::size_t n) { numPeers.push_back(n); },
+      [this](const Tempo t) { tempos.push_back(t); },
+      [this](const bool b) { isPlaying.push_back(b); });
+  }
+
+  std::vector<std::size_t> numPeers;
+  std::vector<Tempo> tempos;
+  std::vector<bool> isPlaying;
+};
+
+} // namespace
+
+TEST_CASE("CallbackMailbox")
+{
+  CallbackMailbox mailbox;
+  Received received;
+
+  SECTION("NothingPending")
+  {
+    CHECK_FALSE(received.take(mailbox));
+    CHECK(received.numPeers.empty());
+    CHECK(received.tempos.empty());
+    CHECK(received.isPlaying.empty());
+  }
+
+  SECTION("DeliversEachKindOfNotification")
+  {
+    mailbox.postNumPeers(3);
+    mailbox.postTempo(Tempo{133.});
+    mailbox.postIsPlaying(true);
+    CHECK(received.take(mailbox));
+    CHECK(std::vector<std::size_t>{3} == received.numPeers);
+    CHECK(std::vector<Tempo>{Tempo{133.}} == received.tempos);
+    CHECK(std::vector<bool>{true} == received.isPlaying);
+    CHECK_FALSE(received.take(mailbox));
+  }
+
+  SECTION("CoalescesToTheLatestValue")
+  {
+    mailbox.postTempo(Tempo{100.});
+    mailbox.postTempo(Tempo{110.});
+    mailbox.postNumPeers(1);
+    mailbox.postNumPeers(2);
+    CHECK(received.take(mailbox));
+    CHECK(std::vector<std::size_t>{2} == received.numPeers);
+    CHECK(std::vector<Tempo>{Tempo{110.}} == received.tempos);
+    CHECK(received.isPlaying.empty());
+  }
+}
+
+TEST_CASE("RateLimiter")
+{
+  using std::chrono::microseconds;
+  RateLimiter<double> limiter;
+  auto value = 0.;
+
+  SECTION("DeliversEverythingWithoutAnInterval")
+  {
+    CHECK(limiter.offer(1., microseconds{0}));
+    CHECK(limiter.offer(2., microseconds{0}));
+    CHECK(!limiter.hasHeld());
+  }
+
+  SECTION("HoldsBackTheLatestValueUntilTheIntervalHasPassed")
+  {
+    limiter.setMinInterval(microseconds{100});
+    CHECK(limiter.offer(1., microseconds{1000}));
+    CHECK(!limiter.offer(2., microseconds{1010}));
+    CHECK(!limiter.offer(3., microseconds{1020}));
+    CHECK(limiter.hasHeld());
+    CHECK(microseconds{1100} == limiter.dueTime());
+    CHECK(!limiter.takeDue(microseconds{1099}, value));
+    CHECK(limiter.takeDue(microseconds{1100}, value));
+    CHECK(3. == value);
+    CHECK(!limiter.hasHeld());
+    CHECK(!limiter.takeDue(microseconds{2000}, value));
+  }
+
+  SECTION("ANewValueReplacesADueHeldOne")
+  {
+    limiter.setMinInterval(microseconds{100});
+    CHECK(limiter.offer(1., microseconds{1000}));
+    CHECK(!limiter.offer(2., microseconds{1050}));
+    CHECK(limiter.offer(3., microseconds{1200}));
+    CHECK(!limiter.hasHeld());
+  }
+}
+
+TEST_CASE("AtomicCallback")
+{
+  auto calls = std::vector<int>{};
+  AtomicCallback<std::function<void(int)>> callback(
+    [&calls](const int value) { calls.push_back(value); });
+
+  SECTION("InvokesTheLatestCallback")
+  {
+    callback(1);
+    callback.set([&calls](const int value) { calls.push_back(-value); });
+    callback(2);
+    CHECK((std::vector<int>{1, -2}) == calls);
+  }
+
+  SECTION("ReplacingWhileInvokingFromAnotherThread")
+  {
+    std::atomic<int> numCalls{0};
+    std::atomic<bool> isDone{false};
+    callback.set([&numCalls](int) { ++numCalls; });
+    std::thread invoker([&] {
+      while (!isDone)
+      {
+        callback(0);
+      }
+    });
+    for (int i = 0; i < 1000; ++i)
+    {
+      callback.set([&numCalls](int) { ++numCalls; });
+    }
+    isDone = true;
+    invoker.join();
+    const auto numCallsBefore = numCalls.load();
+    callback(0);
+    CHECK(numCallsBefore + 1 == numCalls);
+    CHECK(calls.empty());
+  }
+
+  SECTION("ReplacingWaitsForTheInvocationOfThePreviousCallback")
+  {
+    std::atomic<bool> isInvoking{false};
+    std::atomic<bool> isReleased{false};
+    std::atomic<bool> isReplaced{false};
+    callback.set([&](int) {
+      isInvoking = true;
+      while (!isReleased)
+      {
+        std::this_thread::yield();
+      }
+    });
+    std::thread invoker([&] { callback(0); });
+    while (!isInvoking)
+    {
+      std::this_thread::yield();
+    }
+    std::thread replacer([&] {
+      callback.set([](int) {});
+      isReplaced = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(!isReplaced);
+    isReleased = true;
+    invoker.join();
+    replacer.join();
+    CHECK(isReplaced);
+  }
+
+  SECTION("ReplacingFromWithinTheCallback")
+  {
+    callback.set([&](const int value) {
+      callback.set([&calls](const int value) { calls.push_back(-value); });
+      calls.push_back(value);
+    });
+    callback(1);
+    callback(2);
+    CHECK((std::vector<int>{1, -2}) == calls);
+  }
+}
+
+TEST_CASE("CallbackNotifier")
+{
+  std::mutex mutex;
+  std::condition_variable condition;
+  auto numRuns = 0;
+
+  CallbackNotifier notifier([&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++numRuns;
+    condition.notify_one();
+  });
+
+  SECTION("RunsOnNotify")
+  {
+    notifier.start();
+    notifier.notify();
+    std::unique_lock<std::mutex> lock(mutex);
+    CHECK(condition.wait_for(lock, std::chrono::seconds(5), [&] { return numRuns > 0; }));
+  }
+
+  SECTION("NotifyBeforeStartIsNotLost")
+  {
+    notifier.notify();
+    notifier.start();
+    std::unique_lock<std::mutex> lock(mutex);
+    CHECK(condition.wait_for(lock, std::chrono::seconds(5), [&] { return numRuns > 0; }));
+  }
+
+  SECTION("RunsAfterTheDelay")
+  {
+    notifier.start();
+    notifier.notifyAfter(std::chrono::milliseconds(10));
+    std::unique_lock<std::mutex> lock(mutex);
+    CHECK(condition.wait_for(lock, std::chrono::seconds(5), [&] { return numRuns > 0; }));
+  }
+
+  SECTION("DestroyWithoutStart")
+  {
+    notifier.notify();
+    CHECK(0 == numRuns);
+  }
+}
+
+} // namespace link
+} // namespace ableton
@@ -0,0 +1,70 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+#include <ableton/link/CompiledTimeline.hpp>
+#include <ableton/link/Phase.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+namespace ableton
+{
+namespace link
+{
+
+TEST_CASE("CompiledTimeline")
+{
+  using std::chrono::microseconds;
+
+  const auto tl60 = Timeline{Tempo{60.}, Beats{-1.}, microseconds{1000000}};
+  const auto tlOdd = Timeline{Tempo{133.7}, Beats{5.5}, microseconds{12558940}};
+
+  SECTION("TimeToBeats")
+  {
+    CHECK(Beats{2.5} == CompiledTimeline{tl60}.toBeats(microseconds{4500000}));
+  }
+
+  SECTION("BeatsToTime")
+  {
+    CHECK(microseconds{5200000} == CompiledTimeline{tl60}.fromBeats(Beats{3.2}));
+  }
+
+  SECTION("MatchesTimeline")
+  {
+    for (const auto& tl : {tl60, tlOdd})
+    {
+      const auto compiled = CompiledTimeline{tl};
+      CHECK(tl.tempo.microsPerBeat() == compiled.microsPerBeat);
+      for (auto t = microseconds{-20000000}; t < microseconds{20000000};
+           t += microseconds{7919})
+      {
+        CHECK(tl.toBeats(t) == compiled.toBeats(t));
+        const auto beats = tl.toBeats(t) + Beats{INT64_C(1)};
+        CHECK(tl.fromBeats(beats) == compiled.fromBeats(beats));
+        for (const auto quantum : {Beats{0.}, Beats{1.}, Beats{2.4}, Beats{4.}})
+        {
+          const auto encoded = toPhaseEncodedBeats(tl, t, quantum);
+          CHECK(encoded == toPhaseEncodedBeats(compiled, t, quantum));
+          CHECK(fromPhaseEncodedBeats(tl, encoded, quantum)
+                == fromPhaseEncodedBeats(compiled, encoded, quantum));
+        }
+      }
+    }
+  }
+}
+
+} // namespace link
+} // namespace ableton
@@ -23,6 +23,9 @@
 #include <ableton/test/CatchWrapper.hpp>
 #include <ableton/util/Log.hpp>
 #include <ableton/util/test/Timer.hpp>
+#include <functional>
+#include <string>
+#include <vector>
 
 namespace ableton
 {
@@ -82,6 +85,15 @@ struct MockIoContext
       return numBytes;
     }
 
+    std::size_t send(const uint8_t* const,
+      const size_t numBytes,
+      const asio::ip::udp::endpoint&,
+      asio::error_code& ec)
+    {
+      ec = {};
+      return numBytes;
+    }
+
     template <typename Handler>
     void receive(Handler)
     {
@@ -91,25 +103,82 @@ struct MockIoContext
     {
       return {};
     }
+
+    std::chrono::microseconds receiveDelay() const
+    {
+      return {};
+    }
   };
 
+  void start()
+  {
+    ++numStarts();
+  }
+
+  static std::size_t& numStarts()
+  {
+    static std::size_t numStarts = 0;
+    return numStarts;
+  }
+
   void stop()
   {
   }
 
+  bool runningInThisThread() const
+  {
+    return false;
+  }
+
+  using ResponderContext = MockIoContext;
+
+  ResponderContext& responderContext()
+  {
+    return *this;
+  }
+
+  template <typename ExceptionHandler>
+  MockIoContext makeShard(ExceptionHandler, const std::string&)
+  {
+    return {};
+  }
+
+  void setThreadPolicy(const platforms::ThreadPolicy&)
+  {
+  }
+
+  template <typename Error>
+  void handleError(const Error&)
+  {
+  }
+
+  template <std::size_t BufferSize>
+  Socket<BufferSize> openUnicastSocket(const asio::ip::address&,
+    discovery::TrafficClass = discovery::TrafficClass::Discovery)
+  {
+    return {};
+  }
+
   template <std::size_t BufferSize>
-  Socket<BufferSize> openUnicastSocket(const asio::ip::address_v4&)
+  Socket<BufferSize> openMulticastSocket(const asio::ip::address&)
   {
     return {};
   }
 
   template <std::size_t BufferSize>
-  Socket<BufferSize> openMulticastSocket(const asio::ip::address_v4&)
+  void setPacketFilter(Socket<BufferSize>&, const discovery::PacketFilter&)
+  {
+  }
+
+  std::vector<discovery::NetworkInterface> scanNetworkInterfaces()
   {
     return {};
   }
 
-  std::vector<asio::ip::address> scanNetworkInterfaces()
+  using InterfaceMonitor = discovery::NullInterfaceMonitor;
+
+  template <typename Handler>
+  InterfaceMonitor makeInterfaceMonitor(Handler)
   {
     return {};
   }
@@ -124,7 +193,7 @@ struct MockIoContext
   template <typename Callback, typename Duration>
   struct LockFreeCallbackDispatcher
   {
-    LockFreeCallbackDispatcher(Callback callback, Duration)
+    LockFreeCallbackDispatcher(Callback callback, Duration, MockIoContext&)
       : mCallback(std::move(callback))
     {
     }
@@ -134,6 +203,10 @@ struct MockIoContext
       mCallback();
     }
 
+    void setFallbackPeriod(Duration)
+    {
+    }
+
     Callback mCallback;
   };
 
@@ -144,10 +217,31 @@ struct MockIoContext
     return {};
   }
 
+  using Trace = util::NullTrace;
+
+  Trace trace() const
+  {
+    return {};
+  }
+
+  // While set, handlers are collected instead of being run right away
+  static std::vector<std::function<void()>>*& deferredHandlers()
+  {
+    static std::vector<std::function<void()>>* pHandlers = nullptr;
+    return pHandlers;
+  }
+
   template <typename Handler>
   void async(Handler handler) const
   {
-    handler();
+    if (deferredHandlers())
+    {
+      deferredHandlers()->push_back(std::move(handler));
+    }
+    else
+    {
+      handler();
+    }
   }
 };
 
@@ -196,7 +290,7 @@ void testSetAndGetClientState(
   const auto initialStartStopState =
     Optional<ClientStartStopState>{ClientStartStopState{false, kAnyTime, clock.micros()}};
   const auto initialClientState =
-    IncomingClientState{initialTimeline, initialStartStopState, clock.micros()};
+    IncomingClientState{initialTimeline, initialStartStopState, clock.micros(), {}};
 
   setClientState(controller, initialClientState);
 
@@ -211,8 +305,8 @@ void testSetAndGetClientState(
     // StartStopState - don't advance clock
     const auto outdatedStartStopState = Optional<ClientStartStopState>{
       ClientStartStopState{false, kAnyTime, clock.micros()}};
-    setClientState(controller,
-      IncomingClientState{Optional<Timeline>{}, outdatedStartStopState, clock.micros()});
+    setClientState(controller, IncomingClientState{Optional<Timeline>{},
+                                 outdatedStartStopState, clock.micros(), {}});
     CHECK(initialClientState == getClientState(controller));
   }
 
@@ -222,15 +316,15 @@ void testSetAndGetClientState(
   {
     const auto outdatedStartStopState = Optional<ClientStartStopState>{
       ClientStartStopState{false, kAnyTime, microseconds{0}}};
-    setClientState(controller,
-      IncomingClientState{Optional<Timeline>{}, outdatedStartStopState, clock.micros()});
+    setClientState(controller, IncomingClientState{Optional<Timeline>{},
+                                 outdatedStartStopState, clock.micros(), {}});
     CHECK(initialClientState == getClientState(controller));
   }
 
   SECTION("Set empty client state")
   {
     setClientState(controller, IncomingClientState{Optional<Timeline>{},
-                                 Optional<ClientStartStopState>{}, clock.micros()});
+                                 Optional<ClientStartStopState>{}, clock.micros(), {}});
     CHECK(initialClientState == getClientState(controller));
   }
 
@@ -241,7 +335,7 @@ void testSetAndGetClientState(
     const auto expectedStartStopState = Optional<ClientStartStopState>{
       ClientStartStopState{false, kAnyTime, clock.micros()}};
     const auto expectedClientState =
-      IncomingClientState{expectedTimeline, expectedStartStopState, clock.micros()};
+      IncomingClientState{expectedTimeline, expectedStartStopState, clock.micros(), {}};
     setClientState(controller, expectedClientState);
     CHECK(expectedClientState == getClientState(controller));
   }
@@ -268,7 +362,8 @@ void testCallbackInvocation(SetClientStateFunctionT setClientState)
     Optional<Timeline>{Timeline{initialTempo, Beats{0.}, kAnyTime}};
   const auto initialStartStopState = Optional<ClientStartStopState>{
     ClientStartStopState{initialIsPlaying, kAnyTime, clock.micros()}};
-  setClientState(controller, {initialTimeline, initialStartStopState, clock.micros()});
+  setClientState(
+    controller, {initialTimeline, initialStartStopState, clock.micros(), {}});
 
   SECTION("Callbacks are called when setting new client state")
   {
@@ -285,7 +380,7 @@ void testCallbackInvocation(SetClientStateFunctionT setClientState)
         Optional<Timeline>{Timeline{initialTempo, Beats{1.}, kAnyTime}};
       const auto startStopState = Optional<ClientStartStopState>{
         ClientStartStopState{initialIsPlaying, kAnyTime, clock.micros()}};
-      setClientState(controller, {timeline, startStopState, clock.micros()});
+      setClientState(controller, {timeline, startStopState, clock.micros(), {}});
       CHECK(tempoCallback.tempos.empty());
       CHECK(startStopStateCallback.startStopStates.empty());
     }
@@ -332,6 +427,60 @@ TEST_CASE("Controller")
     CHECK(!controller.isEnabled());
   }
 
+  SECTION("ShutDown")
+  {
+    MockController controller(
+      Tempo{100.0}, [](std::size_t) {}, [](Tempo) {}, [](bool) {}, MockClock{});
+
+    controller.enable(true);
+    auto done = controller.shutdown();
+    CHECK(!controller.isEnabled());
+    CHECK(std::future_status::ready == done.wait_for(std::chrono::seconds{0}));
+
+    // A controller that has been shut down can be enabled again
+    controller.enable(true);
+    CHECK(controller.isEnabled());
+  }
+
+  SECTION("IoContextIsStartedByTheFirstEnable")
+  {
+    MockIoContext::numStarts() = 0;
+    MockController controller(
+      Tempo{100.0}, [](std::size_t) {}, [](Tempo) {}, [](bool) {}, MockClock{});
+    CHECK(0 == MockIoContext::numStarts());
+
+    // Shutting down a controller that has never been enabled doesn't start it
+    auto done = controller.shutdown();
+    CHECK(std::future_status::ready == done.wait_for(std::chrono::seconds{0}));
+    CHECK(0 == MockIoContext::numStarts());
+
+    controller.enable(true);
+    CHECK(1 == MockIoContext::numStarts());
+    controller.enable(false);
+    controller.enable(true);
+    CHECK(1 == MockIoContext::numStarts());
+  }
+
+  SECTION("KnownPeerAddresses")
+  {
+    MockController controller(
+      Tempo{100.0}, [](std::size_t) {}, [](Tempo) {}, [](bool) {}, MockClock{});
+    CHECK(controller.knownPeerAddresses().empty());
+
+    auto addresses = std::vector<asio::ip::address>{};
+    for (std::size_t i = 0; i < detail::kMaxKnownPeerAddresses + 2; ++i)
+    {
+      addresses.push_back(
+        asio::ip::address_v4{static_cast<asio::ip::address_v4::uint_type>(i)});
+    }
+    controller.setKnownPeerAddresses(addresses);
+
+    // Only the most recent addresses are kept
+    const auto expected =
+      std::vector<asio::ip::address>(addresses.begin() + 2, addresses.end());
+    CHECK(expected == controller.knownPeerAddresses());
+  }
+
   SECTION("EnableDisableStartStopSync")
   {
     MockController controller(
@@ -370,6 +519,15 @@ TEST_CASE("Controller")
       [](MockController& controller) { return controller.clientState(); });
   }
 
+  SECTION("SetClientStateRealtimeSharedAndGetItThreadSafe")
+  {
+    testSetAndGetClientState(
+      [](MockController& controller, IncomingClientState clientState) {
+        controller.setClientStateRtShared(clientState);
+      },
+      [](MockController& controller) { return controller.clientState(); });
+  }
+
   SECTION("SetClientStateThreadSafeAndGetItRealtimeSafe")
   {
     testSetAndGetClientState(
@@ -382,6 +540,15 @@ TEST_CASE("Controller")
       });
   }
 
+  SECTION("SetClientStateThreadSafeAndGetItRealtimeShared")
+  {
+    testSetAndGetClientState(
+      [](MockController& controller, IncomingClientState clientState) {
+        controller.setClientState(clientState);
+      },
+      [](MockController& controller) { return controller.clientStateRtShared(); });
+  }
+
   SECTION("CallbacksCalledBySettingClientStateThreadSafe")
   {
     testCallbackInvocation(
@@ -398,6 +565,125 @@ TEST_CASE("Controller")
       });
   }
 
+  SECTION("CallbacksCalledBySettingClientStateRealtimeShared")
+  {
+    testCallbackInvocation(
+      [](MockController& controller, IncomingClientState clientState) {
+        controller.setClientStateRtShared(clientState);
+      });
+  }
+
+  SECTION("RealtimeSharedClientStatesOfTheLatestTimestampWin")
+  {
+    using namespace std::chrono;
+
+    auto clock = MockClock{};
+    MockController controller(
+      Tempo{100.0}, [](std::size_t) {}, [](Tempo) {}, [](bool) {}, clock);
+
+    clock.advance(microseconds{2});
+    const auto timeline = [](const double bpm) {
+      return Optional<Timeline>{Timeline{Tempo{bpm}, Beats{0.}, kAnyTime}};
+    };
+    CHECK(controller.setClientStateRtShared({timeline(60.), {}, clock.micros(), {}}));
+    // Committed by a thread that took its timestamp before the previous commit
+    CHECK(controller.setClientStateRtShared(
+      {timeline(70.), {}, clock.micros() - microseconds{1}, {}}));
+    CHECK(Tempo{60.} == controller.clientState().timeline.tempo);
+
+    clock.advance(microseconds{1});
+    CHECK(controller.setClientStateRtShared({timeline(80.), {}, clock.micros(), {}}));
+    CHECK(Tempo{80.} == controller.clientState().timeline.tempo);
+    CHECK(3 == controller.stats().rtCommits);
+  }
+
+  SECTION("ThreadSafeClientStatesAreMergedUntilTheIoThreadPicksThemUp")
+  {
+    auto clock = MockClock{};
+    auto tempoCallback = TempoClientCallback{};
+    auto startStopStateCallback = StartStopStateClientCallback{};
+    MockController controller(Tempo{100.0}, [](std::size_t) {}, std::ref(tempoCallback),
+      std::ref(startStopStateCallback), clock);
+    controller.enableStartStopSync(true);
+    // Before the io thread is started, the client states are handled right away
+    controller.enable(true);
+
+    std::vector<std::function<void()>> handlers;
+    MockIoContext::deferredHandlers() = &handlers;
+    for (const auto bpm : {60., 70., 80.})
+    {
+      clock.advance(microseconds{1});
+      controller.setClientState(IncomingClientState{
+        Optional<Timeline>{Timeline{Tempo{bpm}, Beats{0.}, clock.micros()}}, {},
+        clock.micros(), {}});
+    }
+    clock.advance(microseconds{1});
+    controller.setClientState(IncomingClientState{{},
+      Optional<ClientStartStopState>{
+        ClientStartStopState{true, kAnyTime, clock.micros()}},
+      kAnyTime, {}});
+    MockIoContext::deferredHandlers() = nullptr;
+
+    CHECK(1 == handlers.size());
+    CHECK(Tempo{80.} == controller.clientState().timeline.tempo);
+    CHECK(tempoCallback.tempos.empty());
+
+    handlers.front()();
+    CHECK(std::vector<Tempo>{Tempo{80.}} == tempoCallback.tempos);
+    CHECK(std::vector<bool>{true} == startStopStateCallback.startStopStates);
+
+    // Once picked up, the next client state is passed on by itself
+    controller.setClientState(IncomingClientState{
+      Optional<Timeline>{Timeline{Tempo{90.}, Beats{0.}, clock.micros()}}, {},
+      clock.micros(), {}});
+    CHECK(2 == tempoCallback.tempos.size());
+  }
+
+  SECTION("ClientStateVersionIncreasesWhenTheClientStateChanges")
+  {
+    auto clock = MockClock{};
+    MockController controller(
+      Tempo{100.0}, [](std::size_t) {}, [](Tempo) {}, [](bool) {}, clock);
+
+    const auto initialVersion = controller.clientStateVersion();
+    const auto clientState = IncomingClientState{
+      Optional<Timeline>{Timeline{Tempo{60.}, Beats{0.}, clock.micros()}}, {},
+      clock.micros(), {}};
+    controller.setClientState(clientState);
+    const auto version = controller.clientStateVersion();
+    CHECK(version > initialVersion);
+
+    // Committing the same state again isn't a change
+    controller.setClientState(clientState);
+    CHECK(version == controller.clientStateVersion());
+
+    controller.setClientStateRtSafe(IncomingClientState{
+      Optional<Timeline>{Timeline{Tempo{70.}, Beats{0.}, clock.micros()}}, {},
+      clock.micros(), {}});
+    CHECK(controller.clientStateVersion() > version);
+  }
+
+  SECTION("StatsCountRtCommits")
+  {
+    auto clock = MockClock{};
+    MockController controller(
+      Tempo{100.0}, [](std::size_t) {}, [](Tempo) {}, [](bool) {}, clock);
+
+    for (const auto bpm : {60., 70.})
+    {
+      controller.setClientStateRtSafe(IncomingClientState{
+        Optional<Timeline>{Timeline{Tempo{bpm}, Beats{0.}, kAnyTime}}, {}, kAnyTime, {}});
+    }
+    // Empty client states aren't commits
+    controller.setClientStateRtSafe({});
+
+    const auto stats = controller.stats();
+    CHECK(2 == stats.rtCommits);
+    CHECK(0 == stats.rtCommitsCoalesced);
+    CHECK(0 == stats.measurementsStarted);
+    CHECK(stats.gateways.empty());
+  }
+
   SECTION("GetClientStateRtSafeGracePeriod")
   {
     using namespace std::chrono;
@@ -415,10 +701,10 @@ TEST_CASE("Controller")
     const auto initialStartStopState = Optional<ClientStartStopState>{
       ClientStartStopState{true, kAnyTime, clock.micros()}};
     const auto initialState =
-      IncomingClientState{initialTimeline, initialStartStopState, clock.micros()};
+      IncomingClientState{initialTimeline, initialStartStopState, clock.micros(), {}};
 
     controller.setClientStateRtSafe(
-      {initialTimeline, initialStartStopState, clock.micros()});
+      {initialTimeline, initialStartStopState, clock.micros(), {}});
     REQUIRE(initialState == controller.clientState());
     REQUIRE(initialState == controller.clientStateRtSafe());
 
@@ -428,9 +714,9 @@ TEST_CASE("Controller")
     const auto newStartStopState = Optional<ClientStartStopState>{
       ClientStartStopState{false, kAnyTime, clock.micros()}};
     const auto newState =
-      IncomingClientState{newTimeline, newStartStopState, clock.micros()};
+      IncomingClientState{newTimeline, newStartStopState, clock.micros(), {}};
 
-    controller.setClientState({newTimeline, newStartStopState, clock.micros()});
+    controller.setClientState({newTimeline, newStartStopState, clock.micros(), {}});
     clock.advance(milliseconds{500});
     CHECK(newState == controller.clientState());
     CHECK(initialState == controller.clientStateRtSafe());
@@ -439,6 +725,198 @@ TEST_CASE("Controller")
     CHECK(newState == controller.clientState());
     CHECK(newState == controller.clientStateRtSafe());
   }
+
+  SECTION("QueuedRtTimelineCommits")
+  {
+    using namespace std::chrono;
+
+    auto clock = MockClock{};
+    auto tempoCallback = TempoClientCallback{};
+    MockController controller(Tempo{100.0}, [](std::size_t) {}, std::ref(tempoCallback),
+      [](bool) {}, clock);
+    controller.enableRtTimelineCommitQueue(true);
+    CHECK(controller.isRtTimelineCommitQueueEnabled());
+
+    const auto tempos = std::vector<Tempo>{Tempo{120.}, Tempo{121.}, Tempo{122.}};
+    for (const auto tempo : tempos)
+    {
+      clock.advance(microseconds{1});
+      controller.setClientStateRtSafe(
+        {Optional<Timeline>{Timeline{tempo, Beats{0.}, clock.micros()}}, {},
+          clock.micros(), {}});
+    }
+
+    CHECK(tempos == tempoCallback.tempos);
+    CHECK(Tempo{122.} == controller.clientState().timeline.tempo);
+  }
+
+  SECTION("QueuedRtTimelineCommitsKeepTheirRamps")
+  {
+    using namespace std::chrono;
+
+    auto clock = MockClock{};
+    MockController queued(
+      Tempo{100.0}, [](std::size_t) {}, [](Tempo) {}, [](bool) {}, clock);
+    MockController unqueued(
+      Tempo{100.0}, [](std::size_t) {}, [](Tempo) {}, [](bool) {}, clock);
+    queued.enableRtTimelineCommitQueue(true);
+
+    clock.advance(microseconds{1});
+    const auto ramp =
+      TempoRamp{Timeline{Tempo{120.}, Beats{0.}, clock.micros()}, Tempo{180.},
+        Beats{8.}, TempoCurve::Linear};
+    const auto endTl = ramp.endTimeline();
+    const auto clientState =
+      IncomingClientState{Optional<Timeline>{Timeline{
+                            endTl.tempo, Beats{0.}, endTl.fromBeats(Beats{0.})}},
+        {}, clock.micros(), ramp};
+    queued.setClientStateRtSafe(clientState);
+    unqueued.setClientStateRtSafe(clientState);
+
+    CHECK(queued.clientState().tempoRamp.isRamping());
+    CHECK(unqueued.clientState() == queued.clientState());
+  }
+
+  SECTION("SessionEventQueue")
+  {
+    using namespace std::chrono;
+
+    auto clock = MockClock{};
+    MockController controller(
+      Tempo{100.0}, [](std::size_t) {}, [](Tempo) {}, [](bool) {}, clock);
+    controller.enableStartStopSync(true);
+
+    clock.advance(microseconds{1});
+    controller.setClientState(
+      {Optional<Timeline>{Timeline{Tempo{110.}, Beats{0.}, clock.micros()}}, {},
+        clock.micros(), {}});
+    CHECK_FALSE(controller.readSessionEventRtSafe());
+
+    controller.enableSessionEventQueue(true);
+    CHECK(controller.isSessionEventQueueEnabled());
+
+    clock.advance(microseconds{1});
+    const auto startTime = clock.micros() + microseconds{500};
+    controller.setClientState(
+      {Optional<Timeline>{Timeline{Tempo{120.}, Beats{0.}, clock.micros()}},
+        Optional<ClientStartStopState>{
+          ClientStartStopState{true, startTime, clock.micros()}},
+        clock.micros(), {}});
+
+    auto event = controller.readSessionEventRtSafe();
+    REQUIRE(event);
+    CHECK(SessionEvent::tempoChange(clock.micros(), Tempo{120.}) == *event);
+    event = controller.readSessionEventRtSafe();
+    REQUIRE(event);
+    CHECK(SessionEvent::startStopChange(startTime, true) == *event);
+    CHECK_FALSE(controller.readSessionEventRtSafe());
+
+    // An unchanged tempo doesn't produce an event
+    clock.advance(microseconds{1});
+    controller.setClientStateRtSafe(
+      {Optional<Timeline>{Timeline{Tempo{120.}, Beats{1.}, clock.micros()}}, {},
+        clock.micros(), {}});
+    CHECK_FALSE(controller.readSessionEventRtSafe());
+
+    // Events are dropped instead of blocking once the queue is full
+    for (auto i = 0; i < 2 * static_cast<int>(detail::kSessionEventQueueSize); ++i)
+    {
+      clock.advance(microseconds{1});
+      controller.setClientState(
+        {Optional<Timeline>{Timeline{Tempo{60. + i}, Beats{0.}, clock.micros()}}, {},
+          clock.micros(), {}});
+    }
+    std::size_t numEvents = 0;
+    while (controller.readSessionEventRtSafe())
+    {
+      ++numEvents;
+    }
+    CHECK(detail::kSessionEventQueueSize == numEvents);
+  }
+
+  SECTION("GetClientStateRtSafeAtPastTime")
+  {
+    using namespace std::chrono;
+
+    auto clock = MockClock{};
+    MockController controller(
+      Tempo{100.0}, [](std::size_t) {}, [](Tempo) {}, [](bool) {}, clock);
+    const auto initialTimeline = controller.clientStateRtSafe().timeline;
+
+    clock.advance(milliseconds{100});
+    const auto firstChange = clock.micros();
+    controller.setClientState(
+      {Optional<Timeline>{Timeline{Tempo{110.}, Beats{0.}, firstChange}}, {},
+        firstChange, {}});
+
+    clock.advance(milliseconds{100});
+    const auto secondChange = clock.micros();
+    controller.setClientState(
+      {Optional<Timeline>{Timeline{Tempo{120.}, Beats{0.}, secondChange}}, {},
+        secondChange, {}});
+
+    CHECK(initialTimeline
+          == controller.clientStateRtSafeAt(firstChange - microseconds{1}).timeline);
+    CHECK(Tempo{110.} == controller.clientStateRtSafeAt(firstChange).timeline.tempo);
+    CHECK(Tempo{110.}
+          == controller.clientStateRtSafeAt(secondChange - microseconds{1})
+               .timeline.tempo);
+    CHECK(controller.clientStateRtSafe()
+          == controller.clientStateRtSafeAt(secondChange));
+    CHECK(
+      controller.clientStateRtSafe() == controller.clientStateRtSafeAt(clock.micros()));
+  }
+
+  SECTION("GetClientStateRtSafeWithinRtBlock")
+  {
+    using namespace std::chrono;
+
+    auto clock = MockClock{};
+    auto tempoCallback = TempoClientCallback{};
+    auto startStopStateCallback = StartStopStateClientCallback{};
+    MockController controller(Tempo{100.0}, [](std::size_t) {}, std::ref(tempoCallback),
+      std::ref(startStopStateCallback), clock);
+    controller.enable(true);
+
+    clock.advance(microseconds{1});
+    const auto initialTimeline =
+      Optional<Timeline>{Timeline{Tempo{50.}, Beats{0.}, clock.micros()}};
+    const auto initialStartStopState = Optional<ClientStartStopState>{
+      ClientStartStopState{true, kAnyTime, clock.micros()}};
+    const auto initialState =
+      IncomingClientState{initialTimeline, initialStartStopState, clock.micros(), {}};
+
+    controller.setClientStateRtSafe(
+      {initialTimeline, initialStartStopState, clock.micros(), {}});
+
+    clock.advance(microseconds{1});
+    const auto newTimeline =
+      Optional<Timeline>{Timeline{Tempo{70.}, Beats{1.}, clock.micros()}};
+    const auto newStartStopState = Optional<ClientStartStopState>{
+      ClientStartStopState{false, kAnyTime, clock.micros()}};
+    const auto newState =
+      IncomingClientState{newTimeline, newStartStopState, clock.micros(), {}};
+    controller.setClientState({newTimeline, newStartStopState, clock.micros(), {}});
+
+    controller.beginRtBlock();
+    CHECK(initialState == controller.clientStateRtSafe());
+
+    // The grace period is only resolved at the beginning of the block
+    clock.advance(seconds{1});
+    CHECK(initialState == controller.clientStateRtSafe());
+    controller.endRtBlock();
+
+    controller.beginRtBlock();
+    CHECK(newState == controller.clientStateRtSafe());
+
+    // Client states set within the block are served back immediately
+    const auto rtTimeline =
+      Optional<Timeline>{Timeline{Tempo{90.}, Beats{2.}, clock.micros()}};
+    controller.setClientStateRtSafe({rtTimeline, {}, clock.micros(), {}});
+    CHECK(IncomingClientState{rtTimeline, newStartStopState, clock.micros(), {}}
+          == controller.clientStateRtSafe());
+    controller.endRtBlock();
+  }
 }
 
 } // namespace link
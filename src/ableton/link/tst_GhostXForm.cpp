@@ -0,0 +1,84 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/link/GhostXForm.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <cstdint>
+
+namespace ableton
+{
+namespace link
+{
+
+TEST_CASE("GhostXForm")
+{
+  using std::chrono::microseconds;
+
+  SECTION("UnitSlopeIsIdenticalToDivision")
+  {
+    const auto xform = GhostXForm{1., microseconds{-123456789}};
+    for (std::int64_t t = -5000000000; t < 5000000000; t += 7654321)
+    {
+      const auto ghostTime = microseconds{t};
+      CHECK(microseconds{llround(
+              static_cast<double>((ghostTime - xform.intercept).count()) / xform.slope)}
+            == xform.ghostToHost(ghostTime));
+    }
+  }
+
+  SECTION("NonUnitSlopeRoundtrip")
+  {
+    // A host clock that runs 50 ppm slow relative to the ghost time
+    const auto xform = GhostXForm{1.00005, microseconds{987654}};
+    CHECK(1. / 1.00005 == xform.inverseSlope());
+    for (std::int64_t t = 0; t < 100000000000; t += 98765432)
+    {
+      const auto hostTime = microseconds{t};
+      const auto roundtrip = xform.ghostToHost(xform.hostToGhost(hostTime));
+      CHECK(std::abs((roundtrip - hostTime).count()) <= 1);
+    }
+  }
+
+  SECTION("SlewedXFormIsContinuousAndMeetsTheTarget")
+  {
+    const auto from = GhostXForm{1., microseconds{-5000000000}};
+    const auto to = GhostXForm{1.00002, microseconds{-5000150000}};
+    const auto hostTime = microseconds{4000000000};
+    const auto duration = microseconds{2000000};
+    const auto slewed = slewedXForm(from, to, hostTime, duration);
+
+    CHECK(from.hostToGhost(hostTime) == slewed.hostToGhost(hostTime));
+    const auto end = hostTime + duration;
+    CHECK(std::abs((to.hostToGhost(end) - slewed.hostToGhost(end)).count()) <= 1);
+    // Between the two, the ghost time moves steadily towards the target
+    const auto middle = hostTime + duration / 2;
+    const auto offset = to.hostToGhost(middle) - slewed.hostToGhost(middle);
+    const auto startOffset = to.hostToGhost(hostTime) - from.hostToGhost(hostTime);
+    CHECK(std::abs((2 * offset - startOffset).count()) <= 2);
+  }
+
+  SECTION("DefaultIsTheInvalidXForm")
+  {
+    CHECK(GhostXForm{} == GhostXForm(0., microseconds{0}));
+    CHECK(0. == GhostXForm{}.inverseSlope());
+  }
+}
+
+} // namespace link
+} // namespace ableton
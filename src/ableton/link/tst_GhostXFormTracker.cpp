@@ -0,0 +1,84 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/link/GhostXFormTracker.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+namespace ableton
+{
+namespace link
+{
+
+TEST_CASE("GhostXFormTracker")
+{
+  using std::chrono::microseconds;
+
+  GhostXFormTracker tracker;
+  // A host clock that runs 20ppm slow relative to the ghost time
+  const auto ghostTime = [](const microseconds hostTime) {
+    return microseconds{llround(1.00002 * static_cast<double>(hostTime.count()))}
+           + microseconds{-123456789};
+  };
+  // Measurements only determine the offset at the time of the measurement
+  const auto measure = [&ghostTime](const microseconds hostTime) {
+    return GhostXForm{1., ghostTime(hostTime) - hostTime};
+  };
+  const auto start = microseconds{86400000000};
+
+  SECTION("FirstMeasurementIsUsedAsIs")
+  {
+    const auto xform = tracker.update(start, measure(start));
+    CHECK(measure(start) == xform);
+  }
+
+  SECTION("TracksDrift")
+  {
+    GhostXForm xform{};
+    for (int i = 0; i < 12; ++i)
+    {
+      const auto hostTime = start + microseconds{i * 10000000};
+      xform = tracker.update(hostTime, measure(hostTime));
+    }
+    CHECK_THAT(xform.slope, Catch::Matchers::WithinAbs(1.00002, 1e-9));
+
+    // Between measurements the xform follows the ghost time, whereas the last
+    // measurement alone is off by 20ppm
+    const auto later = start + microseconds{120000000};
+    const auto lastMeasurement = measure(start + microseconds{110000000});
+    CHECK(std::abs((xform.hostToGhost(later) - ghostTime(later)).count()) <= 2);
+    CHECK(std::abs((lastMeasurement.hostToGhost(later) - ghostTime(later)).count())
+          >= 199);
+  }
+
+  SECTION("Reset")
+  {
+    for (int i = 0; i < 5; ++i)
+    {
+      const auto hostTime = start + microseconds{i * 10000000};
+      tracker.update(hostTime, measure(hostTime));
+    }
+    tracker.reset();
+    const auto hostTime = start + microseconds{50000000};
+    CHECK(GhostXForm{1., microseconds{42}}
+          == tracker.update(hostTime, GhostXForm{1., microseconds{42}}));
+  }
+}
+
+} // namespace link
+} // namespace ableton
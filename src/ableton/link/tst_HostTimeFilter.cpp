@@ -20,6 +20,7 @@
 #include <ableton/link/HostTimeFilter.hpp>
 #include <ableton/test/CatchWrapper.hpp>
 #include <chrono>
+#include <cstdlib>
 
 namespace ableton
 {
@@ -43,6 +44,21 @@ struct MockClock
   std::chrono::microseconds time;
 };
 
+// A clock that reads whatever time the test sets
+struct SettableClock
+{
+  static std::chrono::microseconds& time()
+  {
+    static std::chrono::microseconds current{0};
+    return current;
+  }
+
+  std::chrono::microseconds micros() const
+  {
+    return time();
+  }
+};
+
 TEST_CASE("HostTimeFilter")
 {
   using Filter = ableton::link::HostTimeFilter<MockClock>;
@@ -80,5 +96,165 @@ TEST_CASE("HostTimeFilter")
   }
 }
 
+TEST_CASE("IncrementalHostTimeFilter")
+{
+  using Filter = ableton::link::IncrementalHostTimeFilter<MockClock>;
+  Filter filter;
+
+  SECTION("OneValue")
+  {
+    const auto ht = filter.sampleTimeToHostTime(5);
+    CHECK(0 == ht.count());
+  }
+
+  SECTION("MultipleValues")
+  {
+    const auto numValues = 600;
+    auto ht = std::chrono::microseconds(0);
+
+    for (int i = 0; i <= numValues; ++i)
+    {
+      ht = filter.sampleTimeToHostTime(i);
+    }
+
+    CHECK(numValues == ht.count());
+  }
+
+  SECTION("Reset")
+  {
+    auto ht = filter.sampleTimeToHostTime(0);
+    ht = filter.sampleTimeToHostTime(-230);
+    ht = filter.sampleTimeToHostTime(40);
+    REQUIRE(2 != ht.count());
+
+    filter.reset();
+    ht = filter.sampleTimeToHostTime(0);
+    CHECK(3 == ht.count());
+  }
+
+  SECTION("MatchesHostTimeFilter")
+  {
+    HostTimeFilter<MockClock> reference;
+
+    for (int i = 0; i < 2000; ++i)
+    {
+      // Irregular sample times so that the fit is not trivially exact
+      const auto sampleTime = static_cast<double>(i * 64 + (i % 7) * 3);
+      CHECK(reference.sampleTimeToHostTime(sampleTime)
+            == filter.sampleTimeToHostTime(sampleTime));
+    }
+  }
+}
+
+TEST_CASE("RobustHostTimeFilter")
+{
+  using std::chrono::microseconds;
+
+  SECTION("OneValue")
+  {
+    RobustHostTimeFilter<MockClock> filter;
+    const auto ht = filter.sampleTimeToHostTime(5);
+    CHECK(0 == ht.count());
+  }
+
+  SECTION("MultipleValues")
+  {
+    RobustHostTimeFilter<MockClock> filter;
+    const auto numValues = 600;
+    auto ht = microseconds(0);
+
+    for (int i = 0; i <= numValues; ++i)
+    {
+      ht = filter.sampleTimeToHostTime(i);
+    }
+
+    CHECK(numValues == ht.count());
+  }
+
+  SECTION("Reset")
+  {
+    RobustHostTimeFilter<MockClock> filter;
+    auto ht = filter.sampleTimeToHostTime(0);
+    ht = filter.sampleTimeToHostTime(-230);
+    ht = filter.sampleTimeToHostTime(40);
+    REQUIRE(2 != ht.count());
+
+    filter.reset();
+    ht = filter.sampleTimeToHostTime(0);
+    CHECK(3 == ht.count());
+  }
+
+  // Buffers of 512 samples at 44.1kHz, which are 11610us apart, with callbacks
+  // that are up to 300us late. The ideal host time of buffer i is origin + i * 11610.
+  const auto origin = microseconds{1000000000000}; // Eleven days of uptime
+  const auto firstSample = 100000000000.;
+  const auto jitter = [](const int i) { return microseconds{(i * 7919) % 301}; };
+
+  SECTION("LongUptimeInFloat")
+  {
+    BasicRobustHostTimeFilter<SettableClock, float> filter;
+    for (int i = 0; i < 2000; ++i)
+    {
+      SettableClock::time() = origin + microseconds{i * 11610} + jitter(i);
+      const auto ht = filter.sampleTimeToHostTime(firstSample + i * 512.);
+      if (i >= 512)
+      {
+        // Once the filter is full, the fit follows the mean lateness of 150us
+        const auto error = ht - (origin + microseconds{i * 11610 + 150});
+        if (std::abs(error.count()) > 10)
+        {
+          FAIL("Error of " << error.count() << "us at buffer " << i);
+        }
+      }
+    }
+  }
+
+  SECTION("LateCallbackIsIgnored")
+  {
+    RobustHostTimeFilter<SettableClock> filter;
+    auto i = 0;
+    for (; i < 100; ++i)
+    {
+      SettableClock::time() = origin + microseconds{i * 11610};
+      filter.sampleTimeToHostTime(firstSample + i * 512.);
+    }
+
+    SettableClock::time() = origin + microseconds{i * 11610 + 20000};
+    CHECK(origin + microseconds{i * 11610}
+          == filter.sampleTimeToHostTime(firstSample + i * 512.));
+    ++i;
+    SettableClock::time() = origin + microseconds{i * 11610};
+    CHECK(origin + microseconds{i * 11610}
+          == filter.sampleTimeToHostTime(firstSample + i * 512.));
+  }
+
+  SECTION("RestartsWhenTheTimingChanges")
+  {
+    RobustHostTimeFilter<SettableClock> filter;
+    auto i = 0;
+    for (; i < 100; ++i)
+    {
+      SettableClock::time() = origin + microseconds{i * 11610};
+      filter.sampleTimeToHostTime(firstSample + i * 512.);
+    }
+
+    // The host time jumps by a second, e.g. after the system was suspended
+    const auto jumped = origin + microseconds{1000000};
+    for (std::size_t k = 0; k < RobustHostTimeFilter<SettableClock>::kMaxOutliers;
+         ++k, ++i)
+    {
+      SettableClock::time() = jumped + microseconds{i * 11610};
+      CHECK(origin + microseconds{i * 11610}
+            == filter.sampleTimeToHostTime(firstSample + i * 512.));
+    }
+    for (auto k = 0; k < 20; ++k, ++i)
+    {
+      SettableClock::time() = jumped + microseconds{i * 11610};
+      CHECK(jumped + microseconds{i * 11610}
+            == filter.sampleTimeToHostTime(firstSample + i * 512.));
+    }
+  }
+}
+
 } // namespace link
 } // namespace ableton
@@ -48,7 +48,8 @@ struct MockIoContext
   using Socket = discovery::test::Socket;
 
   template <std::size_t BufferSize>
-  Socket<BufferSize> openUnicastSocket(const asio::ip::address_v4&)
+  Socket<BufferSize> openUnicastSocket(const asio::ip::address&,
+    discovery::TrafficClass = discovery::TrafficClass::Discovery)
   {
     return Socket<BufferSize>(mIo);
   }
@@ -67,6 +68,13 @@ struct MockIoContext
     return {};
   }
 
+  using Trace = util::NullTrace;
+
+  Trace trace() const
+  {
+    return {};
+  }
+
   ableton::util::test::IoService mIo;
 };
 
@@ -75,7 +83,7 @@ struct TFixture
   TFixture()
     : mMeasurement(mStateQuery(),
         [](std::vector<double>) {},
-        {},
+        asio::ip::address_v4{},
         MockClock{},
         util::Injected<MockIoContext>(MockIoContext{}))
   {
@@ -170,6 +178,156 @@ TEST_CASE("PeerMeasurement")
     CHECK(2 == fixture.socket().sentMessages.size());
     CHECK(2 == fixture.mMeasurement.mpImpl->mData.size());
   }
+
+  SECTION("PipelinedPings")
+  {
+    Measurement<MockClock, MockIoContext> measurement(fixture.mStateQuery(),
+      [](std::vector<double>) {}, asio::ip::address_v4{}, MockClock{},
+      util::Injected<MockIoContext>(MockIoContext{}), 4);
+    CHECK(4 == measurement.mpImpl->mSocket.sentMessages.size());
+
+    // Every pong is answered with a new ping
+    const auto id = SessionMembership{fixture.mStateQuery.mState.nodeState.sessionId};
+    const auto payload =
+      discovery::makePayload(id, GHostTime{Micros(3)}, HostTime{Micros(2)});
+    v1::MessageBuffer buffer;
+    const auto msgBegin = std::begin(buffer);
+    const auto msgEnd = v1::pongMessage(payload, msgBegin);
+    measurement.mpImpl->mSocket.incomingMessage(endpoint, msgBegin, msgEnd);
+    CHECK(5 == measurement.mpImpl->mSocket.sentMessages.size());
+    CHECK(1 == measurement.mpImpl->mData.size());
+  }
+
+  SECTION("FinishEarlyWithPreciseMedian")
+  {
+    const auto id = SessionMembership{fixture.mStateQuery.mState.nodeState.sessionId};
+    const auto ht = HostTime{Micros(2)};
+    const auto gt = GHostTime{Micros(3)};
+    const auto pgt = PrevGHostTime{Micros(1)};
+    const auto payload = discovery::makePayload(id, gt, ht, pgt);
+
+    v1::MessageBuffer buffer;
+    const auto msgBegin = std::begin(buffer);
+    const auto msgEnd = v1::pongMessage(payload, msgBegin);
+
+    // Every pong results in two identical data points
+    const auto numPongs =
+      Measurement<MockClock, MockIoContext>::kMinNumberDataPoints / 2;
+    for (std::size_t i = 0; i < numPongs - 1; ++i)
+    {
+      fixture.socket().incomingMessage(endpoint, msgBegin, msgEnd);
+    }
+    CHECK(!fixture.mMeasurement.mpImpl->mSuccess);
+
+    fixture.socket().incomingMessage(endpoint, msgBegin, msgEnd);
+    CHECK(fixture.mMeasurement.mpImpl->mSuccess);
+  }
+
+  SECTION("BackOffAfterLostPings")
+  {
+    using Millis = std::chrono::milliseconds;
+    auto& timer = fixture.mMeasurement.mpImpl->mTimer;
+    CHECK(1 == fixture.socket().sentMessages.size());
+
+    // The timeout doubles with every consecutive loss
+    timer.advance(Millis{51});
+    CHECK(2 == fixture.socket().sentMessages.size());
+    timer.advance(Millis{60});
+    CHECK(2 == fixture.socket().sentMessages.size());
+    timer.advance(Millis{41});
+    CHECK(3 == fixture.socket().sentMessages.size());
+    timer.advance(Millis{201});
+    CHECK(4 == fixture.socket().sentMessages.size());
+
+    // A pong resets it
+    const auto id = SessionMembership{fixture.mStateQuery.mState.nodeState.sessionId};
+    const auto payload =
+      discovery::makePayload(id, GHostTime{Micros(3)}, HostTime{Micros(2)});
+    v1::MessageBuffer buffer;
+    const auto msgBegin = std::begin(buffer);
+    const auto msgEnd = v1::pongMessage(payload, msgBegin);
+    fixture.socket().incomingMessage(endpoint, msgBegin, msgEnd);
+    CHECK(5 == fixture.socket().sentMessages.size());
+    timer.advance(Millis{51});
+    CHECK(6 == fixture.socket().sentMessages.size());
+  }
+
+  SECTION("FinishWithPartialDataAfterLostPings")
+  {
+    using Measurement = Measurement<MockClock, MockIoContext>;
+    using Millis = std::chrono::milliseconds;
+    const auto id = SessionMembership{fixture.mStateQuery.mState.nodeState.sessionId};
+    const auto payload = discovery::makePayload(
+      id, GHostTime{Micros(3)}, HostTime{Micros(2)}, PrevGHostTime{Micros(1)});
+    v1::MessageBuffer buffer;
+    const auto msgBegin = std::begin(buffer);
+    const auto msgEnd = v1::pongMessage(payload, msgBegin);
+
+    const auto runOutOfRetries = [](Measurement& measurement) {
+      for (std::size_t i = 0; i <= Measurement::kNumberMeasurements; ++i)
+      {
+        measurement.mpImpl->mTimer.advance(Millis{1000});
+      }
+    };
+
+    // Every pong results in two data points
+    std::size_t numDataPoints = 0;
+    Measurement enough(fixture.mStateQuery(),
+      [&numDataPoints](std::vector<double>& data) { numDataPoints = data.size(); },
+      asio::ip::address_v4{}, MockClock{},
+      util::Injected<MockIoContext>(MockIoContext{}));
+    for (std::size_t i = 0; i < Measurement::kMinPartialDataPoints / 2; ++i)
+    {
+      enough.mpImpl->mSocket.incomingMessage(endpoint, msgBegin, msgEnd);
+    }
+    runOutOfRetries(enough);
+    CHECK(enough.mpImpl->mSuccess);
+    CHECK(std::size_t{Measurement::kMinPartialDataPoints} == numDataPoints);
+
+    numDataPoints = 1;
+    Measurement tooFew(fixture.mStateQuery(),
+      [&numDataPoints](std::vector<double>& data) { numDataPoints = data.size(); },
+      asio::ip::address_v4{}, MockClock{},
+      util::Injected<MockIoContext>(MockIoContext{}));
+    tooFew.mpImpl->mSocket.incomingMessage(endpoint, msgBegin, msgEnd);
+    runOutOfRetries(tooFew);
+    CHECK(!tooFew.mpImpl->mSuccess);
+    CHECK(0 == numDataPoints);
+  }
+
+  SECTION("ReuseResources")
+  {
+    const auto id = SessionMembership{fixture.mStateQuery.mState.nodeState.sessionId};
+    const auto payload = discovery::makePayload(
+      id, GHostTime{Micros(3)}, HostTime{Micros(2)}, PrevGHostTime{Micros(1)});
+    v1::MessageBuffer buffer;
+    const auto msgBegin = std::begin(buffer);
+    const auto msgEnd = v1::pongMessage(payload, msgBegin);
+    fixture.socket().incomingMessage(endpoint, msgBegin, msgEnd);
+    CHECK(2 == fixture.socket().sentMessages.size());
+
+    // Measure a peer of another session with the socket and buffers of the first
+    // measurement
+    using Random = ableton::platforms::stl::Random;
+    auto state = fixture.mStateQuery();
+    state.nodeState.sessionId = NodeId::random<Random>();
+    state.endpoint =
+      asio::ip::udp::endpoint(asio::ip::address_v4::from_string("127.0.0.1"), 7777);
+    auto numCallbacks = 0;
+    Measurement<MockClock, MockIoContext> measurement(state,
+      [&numCallbacks](std::vector<double>) { ++numCallbacks; },
+      fixture.mMeasurement.resources(), MockClock{},
+      util::Injected<MockIoContext>(MockIoContext{}));
+    CHECK(3 == measurement.mpImpl->mSocket.sentMessages.size());
+    CHECK(0 == measurement.mpImpl->mData.size());
+
+    // A late pong for the first measurement neither fails the second one nor is
+    // passed to the first one
+    measurement.mpImpl->mSocket.incomingMessage(endpoint, msgBegin, msgEnd);
+    CHECK(3 == measurement.mpImpl->mSocket.sentMessages.size());
+    CHECK(0 == measurement.mpImpl->mData.size());
+    CHECK(0 == numCallbacks);
+  }
 }
 
 } // namespace link
@@ -19,6 +19,7 @@
 
 #include <ableton/link/Median.hpp>
 #include <ableton/test/CatchWrapper.hpp>
+#include <algorithm>
 #include <array>
 #include <vector>
 
@@ -61,6 +62,63 @@ TEST_CASE("Median")
     CHECK_THAT(slope * 5000 + intercept,
       Catch::Matchers::WithinAbs(median(data.begin(), data.end()), 1e-10));
   }
+
+  SECTION("ConfidenceIntervalOfConstantData")
+  {
+    auto data = Vector(20, 3.);
+    CHECK(0. == medianConfidenceIntervalWidth(data.begin(), data.end()));
+  }
+
+  SECTION("ConfidenceIntervalIgnoresOutliers")
+  {
+    // 100 points with values 0..99 and two outliers
+    Vector data;
+    for (int i = 0; i < 100; ++i)
+    {
+      data.emplace_back(i);
+    }
+    data.front() = -1e6;
+    data.back() = 1e6;
+    // The interval spans about 2 * 0.98 * sqrt(100) ranks around the median
+    CHECK_THAT(20.0, Catch::Matchers::WithinAbs(
+                       medianConfidenceIntervalWidth(data.begin(), data.end()), 1e-10));
+  }
+
+  SECTION("ConfidenceIntervalNarrowsWithMoreData")
+  {
+    Vector few, many;
+    for (int i = 0; i < 10; ++i)
+    {
+      few.emplace_back(i % 2);
+    }
+    for (int i = 0; i < 100; ++i)
+    {
+      many.emplace_back(i % 2 == 0 ? 0.5 : (i % 4 == 1 ? 0. : 1.));
+    }
+    CHECK(medianConfidenceIntervalWidth(many.begin(), many.end())
+          < medianConfidenceIntervalWidth(few.begin(), few.end()));
+  }
+
+  SECTION("InsertSortedKeepsTheMedianUpToDate")
+  {
+    Vector sorted;
+    Vector unsorted;
+    for (int i = 0; i < 100; ++i)
+    {
+      const auto value = static_cast<double>((i * 37) % 101) - (i % 3 == 0 ? 1e4 : 0.);
+      insertSorted(sorted, value);
+      unsorted.push_back(value);
+      if (unsorted.size() > 2)
+      {
+        auto copy = unsorted;
+        CHECK(
+          median(copy.begin(), copy.end()) == sortedMedian(sorted.begin(), sorted.end()));
+        CHECK(medianConfidenceIntervalWidth(copy.begin(), copy.end())
+              == sortedMedianConfidenceIntervalWidth(sorted.begin(), sorted.end()));
+      }
+    }
+    CHECK(std::is_sorted(sorted.begin(), sorted.end()));
+  }
 }
 
 } // namespace link
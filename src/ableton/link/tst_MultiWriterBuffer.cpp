@@ -0,0 +1,138 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/link/MultiWriterBuffer.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ableton
+{
+namespace link
+{
+namespace
+{
+
+using Buffer = MultiWriterBuffer<int64_t, 4>;
+
+constexpr auto kNumTestOps = 1u << 14u;
+constexpr auto kNumWriters = 4u;
+
+std::chrono::microseconds micros(const int64_t count)
+{
+  return std::chrono::microseconds{count};
+}
+
+// Each value is its timestamp, taken from a counter shared by the writers
+void writeValues(Buffer& buffer, std::atomic<int64_t>& counter, const uint32_t numOps)
+{
+  auto numDropped = 0u;
+  for (uint32_t i = 0; i < numOps; ++i)
+  {
+    const auto timestamp = ++counter;
+    if (!buffer.write(micros(timestamp), timestamp))
+    {
+      ++numDropped;
+    }
+  }
+
+  // Catch assertions are not thread-safe, so only check the results here
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  CHECK(0 == numDropped);
+}
+
+} // namespace
+
+TEST_CASE("MultiWriterBuffer")
+{
+  SECTION("Reads nothing before any writes")
+  {
+    Buffer buffer;
+
+    CHECK(!buffer.readNew());
+  }
+
+  SECTION("Reads each written value once")
+  {
+    Buffer buffer;
+
+    CHECK(buffer.write(micros(1), 42));
+    CHECK(42 == *buffer.readNew());
+    CHECK(!buffer.readNew());
+  }
+
+  SECTION("Drops values older than the latest one")
+  {
+    Buffer buffer;
+
+    buffer.write(micros(2), 42);
+    buffer.write(micros(1), 43);
+    CHECK(42 == *buffer.readNew());
+
+    buffer.write(micros(2), 44);
+    CHECK(!buffer.readNew());
+
+    buffer.write(micros(3), 45);
+    CHECK(45 == *buffer.readNew());
+  }
+
+  SECTION("Threaded writes with multiple writers")
+  {
+    Buffer buffer;
+    std::atomic<int64_t> counter{0};
+    std::vector<std::thread> writers;
+    for (auto i = 0u; i < kNumWriters; ++i)
+    {
+      writers.emplace_back(
+        writeValues, std::ref(buffer), std::ref(counter), kNumTestOps);
+    }
+
+    // The values only increase and the latest one is passed on
+    auto latest = int64_t{0};
+    auto isMonotonic = true;
+    const auto read = [&] {
+      if (const auto value = buffer.readNew())
+      {
+        isMonotonic = isMonotonic && *value > latest;
+        latest = *value;
+      }
+    };
+    while (latest < int64_t{kNumWriters * kNumTestOps} / 2)
+    {
+      read();
+    }
+    for (auto& writer : writers)
+    {
+      writer.join();
+    }
+    read();
+
+    CHECK(isMonotonic);
+    CHECK(int64_t{kNumWriters * kNumTestOps} == latest);
+  }
+}
+
+} // namespace link
+} // namespace ableton
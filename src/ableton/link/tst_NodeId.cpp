@@ -0,0 +1,75 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/link/NodeId.hpp>
+#include <ableton/platforms/stl/Random.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <array>
+#include <vector>
+
+namespace ableton
+{
+namespace link
+{
+
+TEST_CASE("NodeId")
+{
+  SECTION("ValueIsBigEndian")
+  {
+    const auto id = NodeId{{{1, 2, 3, 4, 5, 6, 7, 8}}};
+    CHECK(0x0102030405060708u == id.value());
+  }
+
+  SECTION("OrderedLikeBytes")
+  {
+    using Random = platforms::stl::Random;
+    std::vector<NodeId> ids;
+    for (auto i = 0; i < 100; ++i)
+    {
+      ids.push_back(NodeId::random<Random>());
+    }
+    ids.push_back(NodeId{{{1, 255, 0, 0, 0, 0, 0, 0}}});
+    ids.push_back(NodeId{{{2, 0, 0, 0, 0, 0, 0, 0}}});
+
+    for (const auto& lhs : ids)
+    {
+      for (const auto& rhs : ids)
+      {
+        const NodeIdArray& lhsBytes = lhs;
+        const NodeIdArray& rhsBytes = rhs;
+        CHECK((lhsBytes == rhsBytes) == (lhs == rhs));
+        CHECK((lhsBytes != rhsBytes) == (lhs != rhs));
+        CHECK((lhsBytes < rhsBytes) == (lhs < rhs));
+        CHECK((lhsBytes > rhsBytes) == (lhs > rhs));
+        CHECK((lhsBytes <= rhsBytes) == (lhs <= rhs));
+        CHECK((lhsBytes >= rhsBytes) == (lhs >= rhs));
+      }
+    }
+  }
+
+  SECTION("EqualIdsHaveEqualHashes")
+  {
+    const auto id = NodeId{{{'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h'}}};
+    const auto copy = NodeId{NodeIdArray{{'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h'}}};
+    CHECK(std::hash<NodeId>{}(id) == std::hash<NodeId>{}(copy));
+  }
+}
+
+} // namespace link
+} // namespace ableton
@@ -0,0 +1,163 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#include <ableton/discovery/v2/Messages.hpp>
+#include <ableton/link/PeerState.hpp>
+#include <ableton/platforms/stl/Random.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <array>
+#include <vector>
+
+namespace ableton
+{
+namespace link
+{
+namespace
+{
+
+PeerState makePeerState(asio::ip::udp::endpoint endpoint)
+{
+  using Random = platforms::stl::Random;
+  return {NodeState{NodeId::random<Random>(), NodeId::random<Random>(),
+            Timeline{Tempo{120.}, Beats{1.}, std::chrono::microseconds{1234}},
+            StartStopState{true, Beats{0.}, std::chrono::microseconds{2345}},
+            PendingTimeline{}, TempoRamp{}, 0, Timeline{}},
+    std::move(endpoint), ClockDomain{}, 0};
+}
+
+PeerState roundtrip(const PeerState& state)
+{
+  std::vector<std::uint8_t> bytes(sizeInByteStream(toPayload(state)));
+  const auto end = toNetworkByteStream(toPayload(state), begin(bytes));
+  CHECK(end == bytes.end());
+  return PeerState::fromPayload(state.ident(), bytes.cbegin(), bytes.cend());
+}
+
+} // namespace
+
+TEST_CASE("PeerState")
+{
+  const auto headerSize = std::size_t{8};
+  const auto v4 = makePeerState({asio::ip::address::from_string("10.0.0.1"), 1234});
+  const auto v6 = makePeerState({asio::ip::address::from_string("fe80::1"), 1234});
+
+  SECTION("V4EndpointIsEncodedByMeasurementEndpointV4Only")
+  {
+    CHECK(sizeInByteStream(toPayload(v4))
+          == sizeInByteStream(toPayload(v4.nodeState)) + headerSize + 6);
+    CHECK(v4 == roundtrip(v4));
+  }
+
+  SECTION("V6EndpointIsEncodedByMeasurementEndpointV6Only")
+  {
+    CHECK(sizeInByteStream(toPayload(v6))
+          == sizeInByteStream(toPayload(v6.nodeState)) + headerSize + 18);
+    CHECK(v6 == roundtrip(v6));
+  }
+
+  SECTION("ClockDomainIsOnlyEncodedIfIdentified")
+  {
+    auto identified = v4;
+    identified.clockDomain = ClockDomain{
+      ClockDomainId{{1, 2, 3}}, GhostXForm{1.5, std::chrono::microseconds{-42}}};
+    CHECK(sizeInByteStream(toPayload(identified))
+          == sizeInByteStream(toPayload(v4)) + headerSize + 32);
+    CHECK(identified == roundtrip(identified));
+    CHECK(!roundtrip(v4).clockDomain.isIdentified());
+  }
+
+  SECTION("PendingTimelineIsOnlyEncodedIfPending")
+  {
+    auto scheduling = v4;
+    scheduling.nodeState.pendingTimeline = PendingTimeline{
+      Timeline{Tempo{60.}, Beats{8.}, std::chrono::microseconds{5678}},
+      std::chrono::microseconds{5678}};
+    CHECK(sizeInByteStream(toPayload(scheduling))
+          == sizeInByteStream(toPayload(v4)) + headerSize + 32);
+    CHECK(scheduling == roundtrip(scheduling));
+    CHECK(!roundtrip(v4).nodeState.pendingTimeline.isPending());
+  }
+
+  SECTION("TempoRampIsOnlyEncodedIfRamping")
+  {
+    auto ramping = v4;
+    ramping.nodeState.tempoRamp =
+      TempoRamp{Timeline{Tempo{60.}, Beats{8.}, std::chrono::microseconds{5678}},
+        Tempo{120.}, Beats{4.}, TempoCurve::Exponential};
+    ramping.nodeState.rampTangent =
+      Timeline{Tempo{80.}, Beats{10.}, std::chrono::microseconds{7000}};
+    CHECK(sizeInByteStream(toPayload(ramping))
+          == sizeInByteStream(toPayload(v4)) + headerSize + 65);
+    CHECK(ramping == roundtrip(ramping));
+    CHECK(!roundtrip(v4).nodeState.tempoRamp.isRamping());
+
+    // Peers of older versions only see the tangent of the ramp
+    const auto payload = toPayload(ramping.nodeState);
+    std::vector<std::uint8_t> bytes(sizeInByteStream(payload));
+    toNetworkByteStream(payload, begin(bytes));
+    auto timeline = Timeline{};
+    CHECK(discovery::tryParsePayload<Timeline>(bytes.cbegin(), bytes.cend(),
+      [&timeline](Timeline tl) { timeline = std::move(tl); }));
+    CHECK(ramping.nodeState.rampTangent == timeline);
+  }
+
+  SECTION("StratumIsUnknownIfNotAdvertised")
+  {
+    auto joined = v4;
+    joined.nodeState.stratum = 2;
+    CHECK(joined == roundtrip(joined));
+
+    // Peers of older versions don't send the entry
+    const auto payload = discovery::makePayload(
+      v4.nodeState.timeline, SessionMembership{v4.nodeState.sessionId});
+    std::vector<std::uint8_t> bytes(sizeInByteStream(payload));
+    toNetworkByteStream(payload, begin(bytes));
+    const auto nodeState =
+      NodeState::fromPayload(v4.ident(), bytes.cbegin(), bytes.cend());
+    CHECK(std::uint8_t{SyncStratum::kUnknown} == nodeState.stratum);
+  }
+
+  SECTION("PtpClockDomainsAreIdentifiedByGrandmasterAndDomain")
+  {
+    const auto grandmaster = std::array<std::uint8_t, 8>{{0, 1, 2, 0xff, 0xfe, 3, 4, 5}};
+    const auto id = ptpClockDomainId(grandmaster, 0);
+    CHECK(ClockDomain{id, {}}.isIdentified());
+    CHECK(id == ptpClockDomainId(grandmaster, 0));
+    CHECK(id != ptpClockDomainId(grandmaster, 1));
+    CHECK(id != ptpClockDomainId(std::array<std::uint8_t, 8>{{0, 1, 2}}, 0));
+  }
+
+  SECTION("V6EndpointRoundtripsThroughCompactPayload")
+  {
+    using Payload = decltype(toPayload(v6));
+    const auto payload = toPayload(v6);
+    std::vector<std::uint8_t> compact(discovery::v2::sizeInCompactByteStream(payload));
+    CHECK(discovery::v2::toCompactByteStream(payload, compact.begin()) == compact.end());
+
+    std::vector<std::uint8_t> expanded(
+      compact.size() * discovery::v2::kMaxPayloadExpansion);
+    const auto expandedEnd = discovery::v2::expandPayload<Payload>(
+      compact.cbegin(), compact.cend(), expanded.begin());
+    CHECK(v6 == PeerState::fromPayload(v6.ident(), expanded.begin(), expandedEnd));
+  }
+}
+
+} // namespace link
+} // namespace ableton
@@ -43,12 +43,21 @@ struct SessionMembershipCallback
 
 struct SessionTimelineCallback
 {
-  void operator()(const SessionId& sessionId, const Timeline& timeline)
+  void operator()(
+    const SessionId& sessionId, const Timeline& timeline, const TempoRamp& ramp)
   {
     sessionTimelines.push_back(std::make_pair(sessionId, timeline));
+    tempoRamps.push_back(ramp);
+  }
+
+  void operator()(const SessionId& sessionId, const PendingTimeline& pending)
+  {
+    pendingTimelines.push_back(std::make_pair(sessionId, pending));
   }
 
   std::vector<std::pair<SessionId, Timeline>> sessionTimelines;
+  std::vector<std::pair<SessionId, PendingTimeline>> pendingTimelines;
+  std::vector<TempoRamp> tempoRamps;
 };
 
 struct SessionStartStopStateCallback
@@ -91,18 +100,21 @@ TEST_CASE("Peers")
   const auto fooPeer =
     PeerState{{NodeId::random<Random>(), NodeId::random<Random>(),
                 Timeline{Tempo{60.}, Beats{1.}, std::chrono::microseconds{1234}},
-                StartStopState{false, Beats{0.}, std::chrono::microseconds{2345}}},
-      {}};
+                StartStopState{false, Beats{0.}, std::chrono::microseconds{2345}},
+                PendingTimeline{}, TempoRamp{}, 0, Timeline{}},
+      {}, ClockDomain{}, 0};
 
   const auto barPeer =
     PeerState{{NodeId::random<Random>(), NodeId::random<Random>(),
-                Timeline{Tempo{120.}, Beats{10.}, std::chrono::microseconds{500}}, {}},
-      {}};
+                Timeline{Tempo{120.}, Beats{10.}, std::chrono::microseconds{500}}, {},
+                PendingTimeline{}, TempoRamp{}, 0, Timeline{}},
+      {}, ClockDomain{}, 0};
 
   const auto bazPeer =
     PeerState{{NodeId::random<Random>(), NodeId::random<Random>(),
-                Timeline{Tempo{100.}, Beats{4.}, std::chrono::microseconds{100}}, {}},
-      {}};
+                Timeline{Tempo{100.}, Beats{4.}, std::chrono::microseconds{100}}, {},
+                PendingTimeline{}, TempoRamp{}, 0, Timeline{}},
+      {}, ClockDomain{}, 0};
 
   const auto gateway1 = asio::ip::address::from_string("123.123.123.123");
   const auto gateway2 = asio::ip::address::from_string("210.210.210.210");
@@ -137,6 +149,36 @@ TEST_CASE("Peers")
       {make_pair(fooPeer.sessionId(), fooPeer.startStopState())}, startStops);
   }
 
+  SECTION("RepeatedState")
+  {
+    auto observer = makeGatewayObserver(peers, gateway1);
+
+    sawPeer(observer, fooPeer);
+    sawPeer(observer, fooPeer);
+    io.flush();
+    CHECK(1u == membership.calls);
+    CHECK(1u == sessions.sessionTimelines.size());
+    CHECK(1u == startStops.sessionStartStopStates.size());
+
+    // The repeated state reports the timeline of the peer again after the cached
+    // one has been replaced
+    peers.setSessionTimeline(fooPeer.sessionId(),
+      Timeline{Tempo{80.}, Beats{2.}, std::chrono::microseconds{4321}});
+    sawPeer(observer, fooPeer);
+    io.flush();
+    expectSessionTimelines({make_pair(fooPeer.sessionId(), fooPeer.timeline()),
+                             make_pair(fooPeer.sessionId(), fooPeer.timeline())},
+      sessions);
+    expectPeers({{fooPeer, gateway1}}, peers.sessionPeers(fooPeer.sessionId()));
+
+    // And a forgotten peer is added again
+    peers.forgetSession(fooPeer.sessionId());
+    sawPeer(observer, fooPeer);
+    io.flush();
+    CHECK(2u == membership.calls);
+    expectPeers({{fooPeer, gateway1}}, peers.sessionPeers(fooPeer.sessionId()));
+  }
+
   SECTION("AddAndRemovePeer")
   {
     auto observer = makeGatewayObserver(peers, gateway1);
@@ -180,6 +222,73 @@ TEST_CASE("Peers")
     CHECK(3 == membership.calls);
   }
 
+  SECTION("SessionPeerCountIncludesTheLeavesOfHubs")
+  {
+    auto observer1 = makeGatewayObserver(peers, gateway1);
+    auto observer2 = makeGatewayObserver(peers, gateway2);
+
+    // A hub is counted with its largest number of leaves across gateways
+    auto hub = fooPeer;
+    hub.numLeaves = 3;
+    auto hubOnGateway2 = hub;
+    hubOnGateway2.numLeaves = 2;
+    auto member = barPeer;
+    member.nodeState.sessionId = fooPeer.sessionId();
+    sawPeer(observer1, hub);
+    sawPeer(observer2, hubOnGateway2);
+    sawPeer(observer1, member);
+    io.flush();
+    CHECK(5 == peers.uniqueSessionPeerCount(fooPeer.sessionId()));
+
+    // A change of the count changes the membership of the session
+    const auto numMembershipCalls = membership.calls;
+    hub.numLeaves = 4;
+    sawPeer(observer1, hub);
+    io.flush();
+    CHECK(numMembershipCalls + 1 == membership.calls);
+    CHECK(6 == peers.uniqueSessionPeerCount(fooPeer.sessionId()));
+
+    peerLeft(observer1, hub.ident());
+    io.flush();
+    CHECK(4 == peers.uniqueSessionPeerCount(fooPeer.sessionId()));
+  }
+
+  SECTION("StateSeenOnSeveralGateways")
+  {
+    auto observer1 = makeGatewayObserver(peers, gateway1);
+    auto observer2 = makeGatewayObserver(peers, gateway2);
+
+    // The copies of a state differ in their measurement endpoints
+    auto fooOnGateway2 = fooPeer;
+    fooOnGateway2.endpoint = asio::ip::udp::endpoint{gateway2, 4321};
+    sawPeer(observer1, fooPeer);
+    sawPeer(observer2, fooOnGateway2);
+
+    auto updatedFoo = fooPeer;
+    updatedFoo.nodeState.timeline =
+      Timeline{Tempo{90.}, Beats{2.}, std::chrono::microseconds{5678}};
+    auto updatedFooOnGateway2 = fooOnGateway2;
+    updatedFooOnGateway2.nodeState = updatedFoo.nodeState;
+    sawPeer(observer1, updatedFoo);
+    sawPeer(observer2, updatedFooOnGateway2);
+    io.flush();
+
+    CHECK(1u == membership.calls);
+    expectSessionTimelines({make_pair(fooPeer.sessionId(), fooPeer.timeline()),
+                             make_pair(fooPeer.sessionId(), updatedFoo.timeline())},
+      sessions);
+    CHECK(1u == startStops.sessionStartStopStates.size());
+    expectPeers({{updatedFoo, gateway1}, {updatedFooOnGateway2, gateway2}},
+      peers.sessionPeers(fooPeer.sessionId()));
+
+    // The entry of the other gateway is still indexed
+    peerLeft(observer1, fooPeer.ident());
+    io.flush();
+    expectPeers({{updatedFooOnGateway2, gateway2}},
+      peers.sessionPeers(fooPeer.sessionId()));
+    CHECK(1u == peers.uniqueSessionPeerCount(fooPeer.sessionId()));
+  }
+
   SECTION("CloseGateway")
   {
     auto observer1 = makeGatewayObserver(peers, gateway1);
@@ -196,6 +305,198 @@ TEST_CASE("Peers")
     expectPeers({{fooPeer, gateway1}}, peers.sessionPeers(fooPeer.sessionId()));
     CHECK(4 == membership.calls);
   }
+
+  SECTION("UniqueSessionPeerCount")
+  {
+    auto observer1 = makeGatewayObserver(peers, gateway1);
+    auto observer2 = makeGatewayObserver(peers, gateway2);
+
+    // A second peer in the session of fooPeer
+    auto fooSessionPeer = barPeer;
+    fooSessionPeer.nodeState.sessionId = fooPeer.sessionId();
+
+    sawPeer(observer1, fooPeer);
+    sawPeer(observer2, fooPeer);
+    sawPeer(observer1, fooSessionPeer);
+    io.flush();
+    CHECK(2 == peers.uniqueSessionPeerCount(fooPeer.sessionId()));
+    CHECK(0 == peers.uniqueSessionPeerCount(barPeer.sessionId()));
+
+    peerLeft(observer1, fooPeer.ident());
+    io.flush();
+    CHECK(2 == peers.uniqueSessionPeerCount(fooPeer.sessionId()));
+
+    // fooSessionPeer moves to another session
+    sawPeer(observer1, barPeer);
+    io.flush();
+    CHECK(1 == peers.uniqueSessionPeerCount(fooPeer.sessionId()));
+    CHECK(1 == peers.uniqueSessionPeerCount(barPeer.sessionId()));
+
+    peers.forgetSession(fooPeer.sessionId());
+    CHECK(0 == peers.uniqueSessionPeerCount(fooPeer.sessionId()));
+    CHECK(1 == peers.uniqueSessionPeerCount(barPeer.sessionId()));
+  }
+
+  SECTION("UniqueSessionPeers")
+  {
+    auto observer1 = makeGatewayObserver(peers, gateway1);
+    auto observer2 = makeGatewayObserver(peers, gateway2);
+
+    // The founder of the session of fooPeer and another member
+    auto founder = bazPeer;
+    founder.nodeState.nodeId = fooPeer.sessionId();
+    founder.nodeState.sessionId = fooPeer.sessionId();
+    auto fooSessionPeer = barPeer;
+    fooSessionPeer.nodeState.sessionId = fooPeer.sessionId();
+
+    sawPeer(observer1, fooPeer);
+    sawPeer(observer2, fooPeer);
+    sawPeer(observer1, fooSessionPeer);
+    sawPeer(observer2, founder);
+    sawPeer(observer1, bazPeer);
+    io.flush();
+
+    PeerVector result(4);
+    auto resultEnd =
+      peers.uniqueSessionPeers(fooPeer.sessionId(), result.size(), begin(result));
+    REQUIRE(3 == distance(begin(result), resultEnd));
+    CHECK(founder == result[0].first);
+    CHECK(gateway2 == result[0].second);
+    const auto fooIt = find_if(begin(result), resultEnd,
+      [&](const PeerVector::value_type& peer) { return peer.first == fooPeer; });
+    REQUIRE(fooIt != resultEnd);
+    CHECK(gateway1 == fooIt->second);
+
+    resultEnd = peers.uniqueSessionPeers(fooPeer.sessionId(), 1, begin(result));
+    REQUIRE(1 == distance(begin(result), resultEnd));
+    CHECK(founder == result[0].first);
+
+    resultEnd = peers.uniqueSessionPeers(barPeer.sessionId(), 4, begin(result));
+    CHECK(resultEnd == begin(result));
+  }
+
+  SECTION("SessionPeersToMeasure")
+  {
+    auto observer = makeGatewayObserver(peers, gateway1);
+
+    // The founder doesn't advertise a stratum, like peers of older versions
+    const auto sessionId = fooPeer.sessionId();
+    auto founder = fooPeer;
+    founder.nodeState.nodeId = sessionId;
+    founder.nodeState.stratum = SyncStratum::kUnknown;
+    sawPeer(observer, founder);
+    std::vector<PeerState> members;
+    for (const auto stratum : {1, 2, 5, 4, int{SyncStratum::kUnknown}})
+    {
+      auto member = fooPeer;
+      member.nodeState.nodeId = NodeId::random<Random>();
+      member.nodeState.stratum = static_cast<std::uint8_t>(stratum);
+      sawPeer(observer, member);
+      members.push_back(member);
+    }
+    sawPeer(observer, barPeer);
+    io.flush();
+
+    // The founder and the peers of strata 1 and 2 come first in any order
+    PeerVector result(8);
+    auto resultEnd = peers.sessionPeersToMeasure(sessionId, 8, 0, begin(result));
+    REQUIRE(6 == distance(begin(result), resultEnd));
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+      CHECK((result[i].first == founder || result[i].first == members[0]
+             || result[i].first == members[1]));
+    }
+    CHECK(members[3] == result[3].first);
+    CHECK(members[2] == result[4].first);
+    CHECK(members[4] == result[5].first);
+
+    // The seed spreads the choice over the preferred peers
+    auto numFounderFirst = 0;
+    for (std::size_t seed = 0; seed < 64; ++seed)
+    {
+      resultEnd = peers.sessionPeersToMeasure(sessionId, 1, seed, begin(result));
+      REQUIRE(1 == distance(begin(result), resultEnd));
+      if (result[0].first == founder)
+      {
+        ++numFounderFirst;
+      }
+      else
+      {
+        CHECK(result[0].first.nodeState.stratum < 3);
+      }
+    }
+    CHECK(numFounderFirst > 0);
+    CHECK(numFounderFirst < 64);
+
+    resultEnd = peers.sessionPeersToMeasure(barPeer.sessionId(), 0, 0, begin(result));
+    CHECK(resultEnd == begin(result));
+  }
+
+  SECTION("SetSessionTimeline")
+  {
+    auto observer = makeGatewayObserver(peers, gateway1);
+    sawPeer(observer, fooPeer);
+    io.flush();
+
+    // Seeing the peer again with the timeline that has been set doesn't report
+    // it as a new timeline
+    const auto timeline =
+      Timeline{Tempo{80.}, Beats{2.}, std::chrono::microseconds{4321}};
+    peers.setSessionTimeline(fooPeer.sessionId(), timeline);
+    auto updatedPeer = fooPeer;
+    updatedPeer.nodeState.timeline = timeline;
+    sawPeer(observer, updatedPeer);
+    io.flush();
+
+    expectPeers({{updatedPeer, gateway1}}, peers.sessionPeers(fooPeer.sessionId()));
+    expectSessionTimelines(
+      {make_pair(fooPeer.sessionId(), fooPeer.timeline())}, sessions);
+  }
+
+  SECTION("PendingTimeline")
+  {
+    auto observer1 = makeGatewayObserver(peers, gateway1);
+    auto observer2 = makeGatewayObserver(peers, gateway2);
+    sawPeer(observer1, fooPeer);
+    io.flush();
+    CHECK(sessions.pendingTimelines.empty());
+
+    // A pending timeline is reported once for its session, also when other peers
+    // of the session relay it
+    const auto pending = PendingTimeline{
+      Timeline{Tempo{90.}, Beats{3.}, std::chrono::microseconds{5000}},
+      std::chrono::microseconds{5000}};
+    auto scheduling = fooPeer;
+    scheduling.nodeState.pendingTimeline = pending;
+    auto relaying = barPeer;
+    relaying.nodeState.sessionId = fooPeer.sessionId();
+    relaying.nodeState.pendingTimeline = pending;
+    sawPeer(observer1, scheduling);
+    sawPeer(observer2, scheduling);
+    sawPeer(observer1, relaying);
+    io.flush();
+
+    CHECK(1 == sessions.pendingTimelines.size());
+    CHECK(make_pair(fooPeer.sessionId(), pending) == sessions.pendingTimelines.front());
+    expectSessionTimelines({make_pair(fooPeer.sessionId(), fooPeer.timeline()),
+                             make_pair(fooPeer.sessionId(), barPeer.timeline())},
+      sessions);
+  }
+
+  SECTION("TempoRampIsPassedWithItsTimeline")
+  {
+    auto observer = makeGatewayObserver(peers, gateway1);
+    auto ramping = fooPeer;
+    ramping.nodeState.tempoRamp =
+      TempoRamp{Timeline{Tempo{60.}, Beats{1.}, std::chrono::microseconds{1000}},
+        Tempo{120.}, Beats{4.}, TempoCurve::Linear};
+    sawPeer(observer, ramping);
+    io.flush();
+
+    expectSessionTimelines(
+      {make_pair(fooPeer.sessionId(), fooPeer.timeline())}, sessions);
+    CHECK(std::vector<TempoRamp>{ramping.tempoRamp()} == sessions.tempoRamps);
+  }
 }
 
 } // namespace link
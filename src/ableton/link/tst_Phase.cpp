@@ -19,6 +19,7 @@
 
 #include <ableton/link/Phase.hpp>
 #include <ableton/test/CatchWrapper.hpp>
+#include <vector>
 
 namespace ableton
 {
@@ -33,6 +34,31 @@ std::chrono::microseconds phaseEncodingRoundtrip(
 {
   return fromPhaseEncodedBeats(tl, toPhaseEncodedBeats(tl, t, quantum), quantum);
 }
+
+// The implementation of phase before it became constexpr
+Beats referencePhase(const Beats beats, const Beats quantum)
+{
+  if (quantum == Beats{INT64_C(0)})
+  {
+    return Beats{INT64_C(0)};
+  }
+  const auto quantumMicros = quantum.microBeats();
+  const auto quantumBins = (llabs(beats.microBeats()) + quantumMicros) / quantumMicros;
+  const std::int64_t quantumBeats{quantumBins * quantumMicros};
+  return (beats + Beats{quantumBeats}) % quantum;
+}
+
+// Phases can be evaluated at compile time
+static_assert(phase(Beats{INT64_C(-1500000)}, Beats{INT64_C(4000000)})
+                == Beats{INT64_C(2500000)},
+  "phase is not constexpr");
+static_assert(nextPhaseMatch(Beats{INT64_C(4100000)}, Beats{INT64_C(-500000)},
+                Beats{INT64_C(1000000)})
+                == Beats{INT64_C(4500000)},
+  "nextPhaseMatch is not constexpr");
+static_assert(noexcept(closestPhaseMatch(Beats{}, Beats{}, Beats{})),
+  "closestPhaseMatch may throw");
+
 } // namespace
 
 
@@ -56,6 +82,20 @@ TEST_CASE("Phase")
     CHECK(phase(-one, zero) == zero);
   }
 
+  SECTION("phase is bit-identical to the reference implementation")
+  {
+    const auto quanta =
+      std::vector<std::int64_t>{1, 3, 999999, 1000000, 4000000, 7777777, -4000000};
+    for (const auto quantum : quanta)
+    {
+      for (std::int64_t x = -20000000; x <= 20000000; x += 12347)
+      {
+        const auto q = Beats{quantum};
+        CHECK(phase(Beats{x}, q) == referencePhase(Beats{x}, q));
+      }
+    }
+  }
+
   SECTION("phase(x, y) == x % y when x and y >= 0")
   {
     CHECK(phase(zero, zero) == zero % zero);
@@ -128,6 +168,23 @@ TEST_CASE("Phase")
     CHECK(toPhaseEncodedBeats(tl1, microseconds{1500000}, Beats{2.4}) == Beats{-10.1});
   }
 
+  SECTION("phaseEncodingOffset | toPhaseEncodedBeats == tl.toBeats + offset")
+  {
+    const auto quanta = {zero, one, two, three, four, Beats{2.4}, Beats{0.3}};
+    for (const auto quantum : quanta)
+    {
+      for (const auto& tl : {tl0, tl1})
+      {
+        const auto offset = phaseEncodingOffset(tl, quantum);
+        for (auto t = microseconds{-5000000}; t < microseconds{5000000};
+             t += microseconds{12345})
+        {
+          CHECK(toPhaseEncodedBeats(tl, t, quantum) == tl.toBeats(t) + offset);
+        }
+      }
+    }
+  }
+
   SECTION("fromPhaseEncodedBeats | inverse of toPhaseEncodedBeats")
   {
     using std::chrono::microseconds;
@@ -177,6 +234,73 @@ TEST_CASE("Phase")
     CHECK(phaseEncodingRoundtrip(tl1, t2, three) == t2);
     CHECK(phaseEncodingRoundtrip(tl1, t3, three) == t3);
   }
+
+  SECTION("Batch functions match the scalar functions")
+  {
+    // Quanta include zero, negative and odd micro beat values as well as
+    // values that cause ties in closestPhaseMatch
+    const auto quantumValues = {INT64_C(0), INT64_C(1), INT64_C(3), INT64_C(-4),
+      INT64_C(300000), INT64_C(1000000), INT64_C(2400000), INT64_C(4000000),
+      INT64_C(7000001)};
+    std::vector<Beats> xs;
+    std::vector<Beats> targets;
+    std::vector<Beats> quanta;
+    auto value = INT64_C(-9876543);
+    for (const auto quantum : quantumValues)
+    {
+      for (auto i = 0; i < 200; ++i)
+      {
+        xs.push_back(Beats{value});
+        targets.push_back(Beats{value * 7 / 3 - 12345});
+        quanta.push_back(Beats{quantum});
+        value += i % 2 == 0 ? INT64_C(98765) : quantum / 2;
+      }
+    }
+
+    std::vector<Beats> result(xs.size());
+
+    phases(xs.begin(), xs.end(), quanta.begin(), result.begin());
+    for (auto i = 0u; i < xs.size(); ++i)
+    {
+      CHECK(result[i] == phase(xs[i], quanta[i]));
+    }
+
+    nextPhaseMatches(
+      xs.begin(), xs.end(), targets.begin(), quanta.begin(), result.begin());
+    for (auto i = 0u; i < xs.size(); ++i)
+    {
+      CHECK(result[i] == nextPhaseMatch(xs[i], targets[i], quanta[i]));
+    }
+
+    closestPhaseMatches(
+      xs.begin(), xs.end(), targets.begin(), quanta.begin(), result.begin());
+    for (auto i = 0u; i < xs.size(); ++i)
+    {
+      CHECK(result[i] == closestPhaseMatch(xs[i], targets[i], quanta[i]));
+    }
+
+    for (const auto& tl : {tl0, tl1})
+    {
+      for (auto t = microseconds{-5000000}; t < microseconds{5000000};
+           t += microseconds{123457})
+      {
+        toPhaseEncodedBeats(tl, t, quanta.begin(), quanta.end(), result.begin());
+        for (auto i = 0u; i < quanta.size(); i += 37)
+        {
+          CHECK(result[i] == toPhaseEncodedBeats(tl, t, quanta[i]));
+        }
+      }
+    }
+
+    // The output may alias the input
+    auto inPlace = xs;
+    nextPhaseMatches(
+      inPlace.begin(), inPlace.end(), targets.begin(), quanta.begin(), inPlace.begin());
+    for (auto i = 0u; i < xs.size(); ++i)
+    {
+      CHECK(inPlace[i] == nextPhaseMatch(xs[i], targets[i], quanta[i]));
+    }
+  }
 }
 
 } // namespace link
@@ -52,7 +52,8 @@ struct MockIoContext
   using Socket = discovery::test::Socket;
 
   template <std::size_t BufferSize>
-  Socket<BufferSize> openUnicastSocket(const asio::ip::address_v4&)
+  Socket<BufferSize> openUnicastSocket(const asio::ip::address&,
+    discovery::TrafficClass = discovery::TrafficClass::Discovery)
   {
     return Socket<BufferSize>(mIo);
   }
@@ -64,6 +65,19 @@ struct MockIoContext
     return {};
   }
 
+  using Trace = util::NullTrace;
+
+  Trace trace() const
+  {
+    return {};
+  }
+
+  template <typename Handler>
+  void async(Handler handler)
+  {
+    handler();
+  }
+
   ableton::util::test::IoService mIo;
 };
 
@@ -137,6 +151,43 @@ TEST_CASE("PingResponder")
     CHECK(std::chrono::microseconds{4} == ghostTime);
   }
 
+  SECTION("ReplyReflectsUpdatedNodeState")
+  {
+    const auto sessionId = NodeId::random<Random>();
+    fixture.mResponder.updateNodeState(
+      sessionId, GhostXForm{2.0, std::chrono::microseconds{10}});
+
+    const auto payload = discovery::makePayload(HostTime{microseconds(2)});
+    v1::MessageBuffer buffer;
+    const auto msgBegin = std::begin(buffer);
+    const auto msgEnd = v1::pingMessage(payload, msgBegin);
+    const auto endpoint = asio::ip::udp::endpoint(fixture.mAddress, 8888);
+
+    fixture.responderSocket().incomingMessage(endpoint, msgBegin, msgEnd);
+    fixture.responderSocket().incomingMessage(endpoint, msgBegin, msgEnd);
+
+    REQUIRE(2 == fixture.numSentMessages());
+    CHECK(fixture.responderSocket().sentMessages[0].first
+          == fixture.responderSocket().sentMessages[1].first);
+
+    const auto messageBuffer = fixture.responderSocket().sentMessages[0].first;
+    const auto result = v1::parseMessageHeader(begin(messageBuffer), end(messageBuffer));
+
+    SessionId replySessionId;
+    std::chrono::microseconds ghostTime{0};
+    std::chrono::microseconds hostTime{0};
+    discovery::parsePayload<SessionMembership, GHostTime, HostTime>(result.second,
+      std::end(messageBuffer),
+      [&replySessionId](SessionMembership sm) { replySessionId = std::move(sm.sessionId); },
+      [&ghostTime](GHostTime gt) { ghostTime = std::move(gt.time); },
+      [&hostTime](HostTime ht) { hostTime = std::move(ht.time); });
+
+    CHECK(v1::kPong == result.first.messageType);
+    CHECK(sessionId == replySessionId);
+    CHECK(std::chrono::microseconds{18} == ghostTime);
+    CHECK(std::chrono::microseconds{2} == hostTime);
+  }
+
   SECTION("PingSizeExceeding")
   {
     const auto ht = HostTime{microseconds(2)};
@@ -152,6 +203,32 @@ TEST_CASE("PingResponder")
 
     CHECK(0 == fixture.numSentMessages());
   }
+
+  SECTION("PassPongsToHandler")
+  {
+    const auto payload = discovery::makePayload(
+      SessionMembership{NodeId::random<Random>()}, GHostTime{microseconds(3)});
+    v1::MessageBuffer buffer;
+    const auto msgBegin = std::begin(buffer);
+    const auto msgEnd = v1::pongMessage(payload, msgBegin);
+    const auto endpoint = asio::ip::udp::endpoint(fixture.mAddress, 8888);
+
+    // Without a handler, pongs are invalid messages
+    fixture.responderSocket().incomingMessage(endpoint, msgBegin, msgEnd);
+
+    auto numPongs = 0;
+    fixture.mResponder.setPongHandler(
+      [&](const asio::ip::udp::endpoint& from, const uint8_t* begin, const uint8_t* end) {
+        ++numPongs;
+        CHECK(endpoint == from);
+        CHECK(
+          std::vector<uint8_t>(msgBegin, msgEnd) == std::vector<uint8_t>(begin, end));
+      });
+    fixture.responderSocket().incomingMessage(endpoint, msgBegin, msgEnd);
+
+    CHECK(1 == numPongs);
+    CHECK(0 == fixture.numSentMessages());
+  }
 }
 
 } // namespace link
@@ -0,0 +1,150 @@
+/* Copyright 2022, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+#include <ableton/link/SeqLockBuffer.hpp>
+#include <ableton/link/SessionState.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace ableton
+{
+namespace link
+{
+namespace
+{
+
+// The client state is published to the realtime readers through a SeqLockBuffer
+static_assert(std::is_trivially_copyable<ClientState>::value,
+  "ClientState must be trivially copyable");
+
+constexpr auto kNumTestOps = 1u << 16u;
+constexpr auto kNumReaders = 4u;
+
+struct BigValue
+{
+  BigValue() = default;
+
+  BigValue(const uint32_t s)
+    : seed{s}
+  {
+    // Generate random values to take some time and test read/write consistency.
+    std::minstd_rand generator{s};
+    std::generate(values.begin(), values.end(), generator);
+  }
+
+  uint32_t seed;                   // Seed that identifies this value
+  std::array<uint32_t, 40> values; // Seed-derived data larger than a cache line
+};
+
+void writeValues(SeqLockBuffer<BigValue>& buffer, const uint32_t numOps)
+{
+  for (uint32_t i = 0; i < numOps; ++i)
+  {
+    buffer.write(i);
+  }
+}
+
+void readValues(const SeqLockBuffer<BigValue>& buffer, const uint32_t numOps)
+{
+  auto prevValueSeed = 0u;
+  auto isConsistent = true;
+  auto isMonotonic = true;
+
+  for (uint32_t i = 0; i < numOps; ++i)
+  {
+    const auto thisValue = buffer.read();
+
+    isMonotonic = isMonotonic && thisValue.seed >= prevValueSeed;
+    isConsistent = isConsistent && thisValue.values == BigValue{thisValue.seed}.values;
+
+    prevValueSeed = thisValue.seed;
+  }
+
+  // Catch assertions are not thread-safe, so only check the results here
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  CHECK(isMonotonic);
+  CHECK(isConsistent);
+}
+
+} // namespace
+
+TEST_CASE("SeqLockBuffer")
+{
+  SECTION("Reads default value before any writes")
+  {
+    SeqLockBuffer<int> buffer;
+
+    CHECK(buffer.read() == int{});
+    CHECK(buffer.read() == int{});
+  }
+
+  SECTION("Reads initial value before any writes")
+  {
+    SeqLockBuffer<int> buffer{42};
+
+    CHECK(buffer.read() == 42);
+    CHECK(buffer.read() == 42);
+  }
+
+  SECTION("Reads last written value")
+  {
+    SeqLockBuffer<int> buffer;
+
+    buffer.write(42);
+    CHECK(buffer.read() == 42);
+    CHECK(buffer.read() == 42);
+
+    buffer.write(43);
+    CHECK(buffer.read() == 43);
+
+    buffer.write(44);
+    buffer.write(45);
+    CHECK(buffer.read() == 45);
+    CHECK(buffer.read() == 45);
+  }
+
+  SECTION("Threaded read and write with multiple readers")
+  {
+    SeqLockBuffer<BigValue> buffer{0u};
+    std::thread writer{writeValues, std::ref(buffer), kNumTestOps};
+    std::vector<std::thread> readers;
+    for (auto i = 0u; i < kNumReaders; ++i)
+    {
+      readers.emplace_back(readValues, std::cref(buffer), kNumTestOps);
+    }
+
+    writer.join();
+    for (auto& reader : readers)
+    {
+      reader.join();
+    }
+  }
+}
+
+} // namespace link
+} // namespace ableton
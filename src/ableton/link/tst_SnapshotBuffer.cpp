@@ -0,0 +1,157 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/link/SnapshotBuffer.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace ableton
+{
+namespace link
+{
+namespace
+{
+
+constexpr auto kNumTestOps = 1u << 16u;
+constexpr std::size_t kNumReaders = 4u;
+
+struct BigValue
+{
+  BigValue() = default;
+
+  BigValue(const uint32_t s)
+    : seed{s}
+  {
+    // Generate random values to take some time and test read/write consistency.
+    std::minstd_rand generator{s};
+    std::generate(values.begin(), values.end(), generator);
+  }
+
+  uint32_t seed;                   // Seed that identifies this value
+  std::array<uint32_t, 40> values; // Seed-derived data larger than a cache line
+};
+
+using Buffer = SnapshotBuffer<BigValue, kNumReaders>;
+
+void writeValues(Buffer& buffer, const uint32_t numOps)
+{
+  for (uint32_t i = 0; i < numOps; ++i)
+  {
+    buffer.writeInPlace([i](BigValue& value) { value = BigValue{i}; });
+  }
+}
+
+void readValues(Buffer& buffer, const std::size_t reader, const uint32_t numOps)
+{
+  auto prevValueSeed = 0u;
+  auto isConsistent = true;
+  auto isMonotonic = true;
+
+  for (uint32_t i = 0; i < numOps; ++i)
+  {
+    const auto& thisValue = buffer.read(reader);
+
+    isMonotonic = isMonotonic && thisValue.seed >= prevValueSeed;
+    isConsistent = isConsistent && thisValue.values == BigValue{thisValue.seed}.values;
+
+    prevValueSeed = thisValue.seed;
+    if (i % 2 == 0)
+    {
+      buffer.release(reader);
+    }
+  }
+
+  // Catch assertions are not thread-safe, so only check the results here
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  CHECK(isMonotonic);
+  CHECK(isConsistent);
+}
+
+} // namespace
+
+TEST_CASE("SnapshotBuffer")
+{
+  SECTION("Reads initial value before any writes")
+  {
+    SnapshotBuffer<int, 2> buffer{42};
+
+    CHECK(buffer.read(0) == 42);
+    CHECK(buffer.read(1) == 42);
+  }
+
+  SECTION("Reads last written value")
+  {
+    SnapshotBuffer<int, 2> buffer;
+
+    buffer.write(42);
+    CHECK(buffer.read(0) == 42);
+
+    buffer.write(43);
+    buffer.write(44);
+    CHECK(buffer.read(0) == 44);
+    CHECK(buffer.read(1) == 44);
+  }
+
+  SECTION("Held values don't change")
+  {
+    SnapshotBuffer<int, 2> buffer;
+
+    buffer.write(42);
+    const auto& first = buffer.read(0);
+    buffer.write(43);
+    const auto& second = buffer.read(1);
+    for (auto i = 44; i < 50; ++i)
+    {
+      buffer.write(i);
+    }
+
+    CHECK(first == 42);
+    CHECK(second == 43);
+    CHECK(buffer.read(0) == 49);
+  }
+
+  SECTION("Threaded read and write with multiple readers")
+  {
+    Buffer buffer{0u};
+    std::thread writer{writeValues, std::ref(buffer), kNumTestOps};
+    std::vector<std::thread> readers;
+    for (auto i = std::size_t{0}; i < kNumReaders; ++i)
+    {
+      readers.emplace_back(readValues, std::ref(buffer), i, kNumTestOps);
+    }
+
+    writer.join();
+    for (auto& reader : readers)
+    {
+      reader.join();
+    }
+  }
+}
+
+} // namespace link
+} // namespace ableton
@@ -0,0 +1,114 @@
+/* Copyright 2022, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+#include <ableton/link/SpscRingBuffer.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace ableton
+{
+namespace link
+{
+namespace
+{
+
+constexpr auto kNumTestOps = 1u << 18u;
+
+using TestBuffer = SpscRingBuffer<uint32_t, 16>;
+
+void writeValues(TestBuffer& buffer, const uint32_t numOps)
+{
+  for (uint32_t i = 0; i < numOps; ++i)
+  {
+    while (!buffer.write(i))
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void readValues(TestBuffer& buffer, const uint32_t numOps)
+{
+  auto isInOrder = true;
+  for (uint32_t i = 0; i < numOps; ++i)
+  {
+    auto value = buffer.read();
+    while (!value)
+    {
+      std::this_thread::yield();
+      value = buffer.read();
+    }
+    isInOrder = isInOrder && *value == i;
+  }
+  CHECK(isInOrder);
+}
+
+} // namespace
+
+TEST_CASE("SpscRingBuffer")
+{
+  SECTION("Reads nothing before any writes")
+  {
+    TestBuffer buffer;
+
+    CHECK(!buffer.read());
+  }
+
+  SECTION("Reads values in the order they were written")
+  {
+    TestBuffer buffer;
+
+    CHECK(buffer.write(42u));
+    CHECK(buffer.write(43u));
+    CHECK(*buffer.read() == 42u);
+    CHECK(buffer.write(44u));
+    CHECK(*buffer.read() == 43u);
+    CHECK(*buffer.read() == 44u);
+    CHECK(!buffer.read());
+  }
+
+  SECTION("Writes fail when full")
+  {
+    SpscRingBuffer<int, 2> buffer;
+
+    CHECK(buffer.write(1));
+    CHECK(buffer.write(2));
+    CHECK(!buffer.write(3));
+    CHECK(*buffer.read() == 1);
+    CHECK(buffer.write(4));
+    CHECK(*buffer.read() == 2);
+    CHECK(*buffer.read() == 4);
+    CHECK(!buffer.read());
+  }
+
+  SECTION("Threaded read and write")
+  {
+    TestBuffer buffer;
+    std::thread writer{writeValues, std::ref(buffer), kNumTestOps};
+    std::thread reader{readValues, std::ref(buffer), kNumTestOps};
+
+    writer.join();
+    reader.join();
+  }
+}
+
+} // namespace link
+} // namespace ableton
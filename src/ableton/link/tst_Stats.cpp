@@ -0,0 +1,114 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#include <ableton/link/Stats.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+namespace ableton
+{
+namespace link
+{
+
+TEST_CASE("StatsCollector")
+{
+  StatsCollector collector;
+  const auto addr1 = asio::ip::address::from_string("10.0.0.1");
+  const auto addr2 = asio::ip::address::from_string("10.0.0.2");
+
+  SECTION("IsInitiallyEmpty")
+  {
+    const auto stats = collector.snapshot();
+    CHECK(0 == stats.traffic.packetsSent);
+    CHECK(0 == stats.traffic.packetsReceived);
+    CHECK(0 == stats.traffic.parseFailures);
+    CHECK(std::chrono::nanoseconds{0} == stats.traffic.handlerTime);
+    CHECK(stats.gateways.empty());
+    CHECK(0 == stats.measurementsStarted);
+    CHECK(0 == stats.sessionJoins);
+    CHECK(0 == stats.rtCommits);
+  }
+
+  SECTION("SumsTheTrafficOfAllGateways")
+  {
+    auto pStats1 = collector.addGateway(addr1);
+    auto pStats2 = collector.addGateway(addr2);
+    discovery::GatewayStats::increment(pStats1->packetsSent, 3);
+    discovery::GatewayStats::increment(pStats2->packetsSent, 2);
+    discovery::GatewayStats::increment(pStats2->parseFailures);
+    {
+      const discovery::ScopedPacketHandler packetHandler(*pStats1);
+    }
+
+    const auto stats = collector.snapshot();
+    REQUIRE(2 == stats.gateways.size());
+    CHECK(addr1 == stats.gateways[0].address);
+    CHECK(3 == stats.gateways[0].traffic.packetsSent);
+    CHECK(1 == stats.gateways[0].traffic.packetsReceived);
+    CHECK(addr2 == stats.gateways[1].address);
+    CHECK(1 == stats.gateways[1].traffic.parseFailures);
+    CHECK(5 == stats.traffic.packetsSent);
+    CHECK(1 == stats.traffic.packetsReceived);
+    CHECK(1 == stats.traffic.parseFailures);
+    CHECK(stats.gateways[0].traffic.handlerTime == stats.traffic.handlerTime);
+  }
+
+  SECTION("KeepsTheTrafficOfRemovedGateways")
+  {
+    auto pStats1 = collector.addGateway(addr1);
+    auto pStats2 = collector.addGateway(addr2);
+    discovery::GatewayStats::increment(pStats1->packetsSent, 3);
+    discovery::GatewayStats::increment(pStats2->packetsSent, 2);
+    pStats1.reset();
+
+    const auto stats = collector.snapshot();
+    REQUIRE(1 == stats.gateways.size());
+    CHECK(addr2 == stats.gateways[0].address);
+    CHECK(5 == stats.traffic.packetsSent);
+  }
+
+  SECTION("CountsEvents")
+  {
+    collector.measurementStarted();
+    collector.measurementStarted();
+    collector.measurementFinished(true);
+    collector.measurementFinished(false);
+    collector.sessionJoined();
+    collector.sessionSwitchDeferred();
+    collector.sessionSwitchDeferred();
+    collector.stateReset();
+    collector.rtCommitted();
+    collector.rtCommitted();
+    collector.rtCommitted();
+    collector.rtCommitApplied();
+
+    const auto stats = collector.snapshot();
+    CHECK(2 == stats.measurementsStarted);
+    CHECK(1 == stats.measurementsSucceeded);
+    CHECK(1 == stats.measurementsFailed);
+    CHECK(1 == stats.sessionJoins);
+    CHECK(2 == stats.sessionSwitchesDeferred);
+    CHECK(1 == stats.stateResets);
+    CHECK(3 == stats.rtCommits);
+    CHECK(2 == stats.rtCommitsCoalesced);
+  }
+}
+
+} // namespace link
+} // namespace ableton
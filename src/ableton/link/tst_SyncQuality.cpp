@@ -0,0 +1,71 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/link/SyncQuality.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+namespace ableton
+{
+namespace link
+{
+
+using namespace std::chrono;
+
+TEST_CASE("SyncQuality")
+{
+  SECTION("IsNotMeasuredByDefault")
+  {
+    CHECK(!SyncQuality{}.isMeasured());
+  }
+
+  SECTION("SummarizesAMeasurement")
+  {
+    const auto offsets = std::vector<double>{10., 12., 14.};
+    auto roundTrips = std::vector<double>{1300., 900., 1000., 1100., 1000.};
+    const auto quality = syncQuality(offsets, roundTrips, microseconds{42});
+    CHECK(quality.isMeasured());
+    CHECK(microseconds{1000} == quality.roundTripTime);
+    // (300 + 100 + 0 + 100 + 0) / 5
+    CHECK(microseconds{100} == quality.jitter);
+    CHECK(4. == Approx(quality.offsetVariance));
+    CHECK(microseconds{42} == quality.measurementTime);
+  }
+
+  SECTION("WorstOfTwo")
+  {
+    auto lhs = SyncQuality{};
+    lhs.roundTripTime = microseconds{1000};
+    lhs.jitter = microseconds{10};
+    lhs.offsetVariance = 4.;
+    lhs.measurementTime = microseconds{5};
+    auto rhs = SyncQuality{};
+    rhs.roundTripTime = microseconds{500};
+    rhs.jitter = microseconds{50};
+    rhs.offsetVariance = 1.;
+    rhs.measurementTime = microseconds{7};
+    const auto worst = worstSyncQuality(lhs, rhs);
+    CHECK(microseconds{1000} == worst.roundTripTime);
+    CHECK(microseconds{50} == worst.jitter);
+    CHECK(4. == worst.offsetVariance);
+    CHECK(microseconds{7} == worst.measurementTime);
+  }
+}
+
+} // namespace link
+} // namespace ableton
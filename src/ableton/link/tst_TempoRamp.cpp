@@ -0,0 +1,127 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/link/TempoRamp.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <vector>
+
+namespace ableton
+{
+namespace link
+{
+
+using namespace std::chrono;
+
+TEST_CASE("TempoRamp")
+{
+  const auto start = Timeline{Tempo{60.}, Beats{8.}, microseconds{1000000}};
+  const auto linear = TempoRamp{start, Tempo{120.}, Beats{4.}, TempoCurve::Linear};
+  const auto exponential =
+    TempoRamp{start, Tempo{120.}, Beats{4.}, TempoCurve::Exponential};
+
+  SECTION("Duration")
+  {
+    // 4 s * ln(2) for the linear curve and 2 s / ln(2) for the exponential one
+    CHECK(microseconds{3772589} == linear.endTime());
+    CHECK(microseconds{3885390} == exponential.endTime());
+    CHECK(Beats{12.} == linear.endBeat());
+  }
+
+  SECTION("IsContinuousAtItsEnds")
+  {
+    for (const auto& ramp : {linear, exponential})
+    {
+      CHECK(start.toBeats(microseconds{0}) == ramp.toBeats(microseconds{0}));
+      CHECK(Beats{8.} == ramp.toBeats(start.timeOrigin));
+      CHECK(ramp.toBeats(ramp.endTime() - microseconds{1}).floating()
+            == Approx(12.).epsilon(1e-6));
+      CHECK(Beats{13.} == ramp.toBeats(ramp.endTime() + microseconds{500000}));
+      CHECK(ramp.endTime() + microseconds{500000} == ramp.fromBeats(Beats{13.}));
+      CHECK(microseconds{0} == ramp.fromBeats(Beats{7.}));
+    }
+  }
+
+  SECTION("RoundtripBeatsAndTime")
+  {
+    for (const auto& ramp : {linear, exponential})
+    {
+      for (auto beat = 8.; beat < 12.; beat += 0.25)
+      {
+        const auto time = ramp.fromBeats(Beats{beat});
+        CHECK(ramp.toBeats(time).floating() == Approx(beat).epsilon(1e-6));
+      }
+    }
+  }
+
+  SECTION("AcceleratesMonotonically")
+  {
+    for (const auto& ramp : {linear, exponential})
+    {
+      auto lastTempo = 0.;
+      for (auto time = start.timeOrigin; time < ramp.endTime();
+           time += microseconds{100000})
+      {
+        const auto tempo = ramp.tempoAtTime(time).bpm();
+        CHECK(tempo > lastTempo);
+        lastTempo = tempo;
+      }
+    }
+  }
+
+  SECTION("TempoAtTime")
+  {
+    CHECK(60. == linear.tempoAtTime(microseconds{0}).bpm());
+    CHECK(120. == linear.tempoAtTime(linear.endTime()).bpm());
+    // The exponential curve reaches the geometric mean of the tempos halfway
+    // through its beats
+    CHECK(exponential.tempoAtTime(exponential.fromBeats(Beats{10.})).bpm()
+          == Approx(60. * std::sqrt(2.)).epsilon(1e-6));
+  }
+
+  SECTION("RampedTimeline")
+  {
+    const auto endTl = linear.endTimeline();
+    const auto ramped = rampedTimeline(endTl, linear);
+    CHECK(Beats{8.} == ramped.toBeats(start.timeOrigin));
+    CHECK(endTl.toBeats(microseconds{5000000}) == ramped.toBeats(microseconds{5000000}));
+    CHECK(linear.fromBeats(Beats{10.}) == ramped.fromBeats(Beats{10.}));
+
+    const auto unramped = rampedTimeline(start, TempoRamp{});
+    CHECK(
+      start.toBeats(microseconds{5000000}) == unramped.toBeats(microseconds{5000000}));
+  }
+
+  SECTION("RoundtripByteStreamEncoding")
+  {
+    std::vector<std::uint8_t> bytes(sizeInByteStream(exponential));
+    const auto end = toNetworkByteStream(exponential, begin(bytes));
+    const auto result =
+      discovery::Deserialize<TempoRamp>::fromNetworkByteStream(begin(bytes), end);
+    CHECK(exponential == result.first);
+  }
+
+  SECTION("IsOnlyEncodedIfRamping")
+  {
+    CHECK(0u == sizeInByteStream(TempoRamp{}));
+    CHECK(0u < sizeInByteStream(linear));
+  }
+}
+
+} // namespace link
+} // namespace ableton
@@ -0,0 +1,80 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/link/TimelineHistory.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+
+namespace ableton
+{
+namespace link
+{
+
+TEST_CASE("TimelineHistory")
+{
+  using std::chrono::microseconds;
+
+  const auto timeline = [](const double bpm) {
+    return Timeline{Tempo{bpm}, Beats{0.}, microseconds{0}};
+  };
+
+  TimelineHistory<4> history;
+
+  SECTION("Empty")
+  {
+    CHECK(!history.replacedTimelineAt(microseconds{0}));
+  }
+
+  SECTION("TimelineValidAtTime")
+  {
+    history.add(microseconds{100}, timeline(100.));
+    history.add(microseconds{200}, timeline(110.));
+    history.add(microseconds{300}, timeline(120.));
+
+    CHECK(!history.replacedTimelineAt(microseconds{300}));
+    CHECK(!history.replacedTimelineAt(microseconds{400}));
+    CHECK(timeline(110.) == *history.replacedTimelineAt(microseconds{299}));
+    CHECK(timeline(110.) == *history.replacedTimelineAt(microseconds{200}));
+    CHECK(timeline(100.) == *history.replacedTimelineAt(microseconds{150}));
+    // Before all kept timelines, the oldest one is the best guess
+    CHECK(timeline(100.) == *history.replacedTimelineAt(microseconds{0}));
+  }
+
+  SECTION("OldestTimelinesAreDropped")
+  {
+    for (auto i = 0; i < 6; ++i)
+    {
+      history.add(microseconds{100 * i}, timeline(100. + i));
+    }
+
+    CHECK(timeline(104.) == *history.replacedTimelineAt(microseconds{450}));
+    CHECK(timeline(102.) == *history.replacedTimelineAt(microseconds{0}));
+  }
+
+  SECTION("TimesDontDecrease")
+  {
+    history.add(microseconds{200}, timeline(100.));
+    history.add(microseconds{100}, timeline(110.));
+
+    CHECK(!history.replacedTimelineAt(microseconds{200}));
+    CHECK(timeline(100.) == *history.replacedTimelineAt(microseconds{199}));
+  }
+}
+
+} // namespace link
+} // namespace ableton
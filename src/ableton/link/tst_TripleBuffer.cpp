@@ -150,6 +150,21 @@ TEST_CASE("TripleBuffer")
     CHECK(buffer.read() == 45);
   }
 
+  SECTION("Reads and writes in place")
+  {
+    TripleBuffer<int> buffer;
+
+    buffer.writeInPlace([](int& value) { value = 42; });
+    const auto& value = buffer.readInPlace();
+    CHECK(value == 42);
+
+    // The buffer of the reader isn't touched by the writer
+    buffer.writeInPlace([](int& next) { next = 43; });
+    buffer.writeInPlace([](int& next) { next = 44; });
+    CHECK(value == 42);
+    CHECK(buffer.readInPlace() == 44);
+  }
+
   SECTION("Threaded read and write")
   {
     TripleBuffer<BigValue> buffer{0u};
@@ -0,0 +1,332 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/platforms/asio/BatchedSocket.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace ableton
+{
+namespace platforms
+{
+namespace asio
+{
+namespace
+{
+
+// Forwards to the system calls, optionally sending fewer datagrams per call or
+// failing calls, and records the calls
+struct TestMmsgCalls
+{
+  static void reset()
+  {
+    maxSentPerCall = 1024;
+    numFailingSends = 0;
+    sendCalls.clear();
+    numReceiveCalls = 0;
+  }
+
+  static int sendmmsg(
+    const int fd, mmsghdr* const pHeaders, const unsigned int num, const int flags)
+  {
+    sendCalls.push_back(num);
+    if (numFailingSends > 0)
+    {
+      --numFailingSends;
+      errno = EPERM;
+      return -1;
+    }
+    return ::sendmmsg(fd, pHeaders, (std::min)(num, maxSentPerCall), flags);
+  }
+
+  static int recvmmsg(
+    const int fd, mmsghdr* const pHeaders, const unsigned int num, const int flags)
+  {
+    ++numReceiveCalls;
+    return ::recvmmsg(fd, pHeaders, num, flags, nullptr);
+  }
+
+  static unsigned int maxSentPerCall;
+  static std::size_t numFailingSends;
+  static std::vector<unsigned int> sendCalls;
+  static std::size_t numReceiveCalls;
+};
+
+unsigned int TestMmsgCalls::maxSentPerCall = 1024;
+std::size_t TestMmsgCalls::numFailingSends = 0;
+std::vector<unsigned int> TestMmsgCalls::sendCalls;
+std::size_t TestMmsgCalls::numReceiveCalls = 0;
+
+using TestSocket = BatchedSocket<64, 4, TestMmsgCalls>;
+using Endpoint = ::asio::ip::udp::endpoint;
+
+Endpoint loopback()
+{
+  return {::asio::ip::address_v4::loopback(), 0};
+}
+
+TestSocket openSocket(::asio::io_service& io)
+{
+  TestSocket socket{io};
+  socket.mpImpl->mSocket.bind(loopback());
+  return socket;
+}
+
+// A plain socket on the loopback interface that the tested socket talks to
+struct Peer
+{
+  Peer(::asio::io_service& io)
+    : socket(io, loopback())
+  {
+    socket.non_blocking(true);
+  }
+
+  // The first byte of each datagram that has arrived so far
+  std::vector<uint8_t> receivedBytes()
+  {
+    std::vector<uint8_t> result;
+    std::array<uint8_t, 64> buffer;
+    Endpoint from;
+    ::asio::error_code ec;
+    for (;;)
+    {
+      const auto size = socket.receive_from(::asio::buffer(buffer), from, 0, ec);
+      if (ec)
+      {
+        return result;
+      }
+      if (size > 0)
+      {
+        result.push_back(buffer[0]);
+      }
+    }
+  }
+
+  void send(const uint8_t value, const Endpoint& to)
+  {
+    socket.send_to(::asio::buffer(&value, 1), to);
+  }
+
+  ::asio::ip::udp::socket socket;
+};
+
+// Receives again after each datagram, unless it's told to stop
+struct Receiver
+{
+  void operator()(const Endpoint&,
+    const TestSocket::Impl::ByteIt begin,
+    const TestSocket::Impl::ByteIt end)
+  {
+    values.push_back(*begin);
+    sizes.push_back(static_cast<std::size_t>(end - begin));
+    delays.push_back(pSocket->receiveDelay());
+    if (receivesAgain)
+    {
+      pSocket->receive(std::ref(*this));
+    }
+  }
+
+  TestSocket* pSocket;
+  bool receivesAgain;
+  std::vector<uint8_t> values;
+  std::vector<std::size_t> sizes;
+  std::vector<std::chrono::microseconds> delays;
+};
+
+template <typename Condition>
+void pollUntil(::asio::io_service& io, Condition condition)
+{
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+  while (!condition() && std::chrono::steady_clock::now() < deadline)
+  {
+    io.poll();
+    io.restart();
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  }
+}
+
+} // namespace
+
+TEST_CASE("BatchedSocket")
+{
+  TestMmsgCalls::reset();
+  ::asio::io_service io;
+  auto socket = openSocket(io);
+  Peer peer{io};
+  const auto to = peer.socket.local_endpoint();
+
+  const auto sendFromHandler = [&](const std::vector<uint8_t> values) {
+    ::asio::post(io, [&socket, values, to] {
+      for (const auto value : values)
+      {
+        socket.send(&value, 1, to);
+      }
+    });
+  };
+
+  SECTION("DatagramsSentFromAHandlerAreSentTogetherAfterIt")
+  {
+    ::asio::post(io, [&] {
+      for (uint8_t value = 0; value < 3; ++value)
+      {
+        socket.send(&value, 1, to);
+      }
+      CHECK(TestMmsgCalls::sendCalls.empty());
+    });
+    io.run();
+    CHECK(std::vector<unsigned int>{3} == TestMmsgCalls::sendCalls);
+    CHECK((std::vector<uint8_t>{0, 1, 2}) == peer.receivedBytes());
+  }
+
+  SECTION("PartialSendsAreContinued")
+  {
+    TestMmsgCalls::maxSentPerCall = 1;
+    sendFromHandler({0, 1, 2});
+    io.run();
+    CHECK((std::vector<unsigned int>{3, 2, 1}) == TestMmsgCalls::sendCalls);
+    CHECK((std::vector<uint8_t>{0, 1, 2}) == peer.receivedBytes());
+  }
+
+  SECTION("AFullBatchIsSentRightAway")
+  {
+    ::asio::post(io, [&] {
+      for (uint8_t value = 0; value < 5; ++value)
+      {
+        socket.send(&value, 1, to);
+      }
+      CHECK(std::vector<unsigned int>{4} == TestMmsgCalls::sendCalls);
+    });
+    io.run();
+    CHECK((std::vector<unsigned int>{4, 1}) == TestMmsgCalls::sendCalls);
+    CHECK((std::vector<uint8_t>{0, 1, 2, 3, 4}) == peer.receivedBytes());
+  }
+
+  SECTION("FailedDatagramsAreReportedToTheErrorHandler")
+  {
+    Peer otherPeer{io};
+    const auto otherTo = otherPeer.socket.local_endpoint();
+    std::vector<Endpoint> failedEndpoints;
+    socket.setSendErrorHandler(
+      [&](const Endpoint& failedTo, const ::asio::error_code& ec) {
+        CHECK(ec.value() == EPERM);
+        failedEndpoints.push_back(failedTo);
+      });
+    TestMmsgCalls::numFailingSends = 1;
+    ::asio::post(io, [&] {
+      const uint8_t values[] = {0, 1, 2};
+      socket.send(&values[0], 1, otherTo);
+      socket.send(&values[1], 1, to);
+      socket.send(&values[2], 1, to);
+    });
+    io.run();
+    CHECK(std::vector<Endpoint>{otherTo} == failedEndpoints);
+    CHECK(otherPeer.receivedBytes().empty());
+    CHECK((std::vector<uint8_t>{1, 2}) == peer.receivedBytes());
+
+    // The failure isn't passed on to later sends
+    io.restart();
+    sendFromHandler({3});
+    io.run();
+    CHECK(std::vector<uint8_t>{3} == peer.receivedBytes());
+    CHECK(1 == failedEndpoints.size());
+  }
+
+  SECTION("ImmediateSendsArentQueued")
+  {
+    socket.setSendsImmediately(true);
+    ::asio::post(io, [&] {
+      const uint8_t value = 7;
+      socket.send(&value, 1, to);
+      CHECK(std::vector<uint8_t>{7} == peer.receivedBytes());
+    });
+    io.run();
+    CHECK(TestMmsgCalls::sendCalls.empty());
+  }
+
+  SECTION("PendingDatagramsAreSentWhenTheSocketIsDestroyed")
+  {
+    {
+      auto other = openSocket(io);
+      const uint8_t value = 9;
+      other.send(&value, 1, to);
+    }
+    CHECK(std::vector<uint8_t>{9} == peer.receivedBytes());
+  }
+
+  SECTION("AvailableDatagramsAreReceivedTogether")
+  {
+    const auto endpoint = socket.endpoint();
+    for (uint8_t value = 0; value < 3; ++value)
+    {
+      peer.send(value, endpoint);
+    }
+    Receiver receiver{&socket, true, {}, {}, {}};
+    socket.receive(std::ref(receiver));
+    pollUntil(io, [&] { return receiver.values.size() == 3; });
+    CHECK((std::vector<uint8_t>{0, 1, 2}) == receiver.values);
+    CHECK((std::vector<std::size_t>{1, 1, 1}) == receiver.sizes);
+    CHECK(1 == TestMmsgCalls::numReceiveCalls);
+  }
+
+  SECTION("RemainingDatagramsWaitForTheNextReceive")
+  {
+    const auto endpoint = socket.endpoint();
+    for (uint8_t value = 0; value < 3; ++value)
+    {
+      peer.send(value, endpoint);
+    }
+    Receiver receiver{&socket, false, {}, {}, {}};
+    socket.receive(std::ref(receiver));
+    pollUntil(io, [&] { return receiver.values.size() == 1; });
+    io.poll();
+    CHECK(std::vector<uint8_t>{0} == receiver.values);
+
+    // Receiving again outside of a handler dispatches the next one from a handler
+    receiver.receivesAgain = true;
+    socket.receive(std::ref(receiver));
+    CHECK(1 == receiver.values.size());
+    pollUntil(io, [&] { return receiver.values.size() == 3; });
+    CHECK((std::vector<uint8_t>{0, 1, 2}) == receiver.values);
+    CHECK(1 == TestMmsgCalls::numReceiveCalls);
+  }
+
+  SECTION("TheReceiveDelayIsKnownWhileHandlingADatagram")
+  {
+    peer.send(0, socket.endpoint());
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    Receiver receiver{&socket, false, {}, {}, {}};
+    socket.receive(std::ref(receiver));
+    pollUntil(io, [&] { return receiver.values.size() == 1; });
+    REQUIRE(1 == receiver.delays.size());
+    CHECK(receiver.delays[0] >= std::chrono::milliseconds{15});
+    CHECK(receiver.delays[0] < std::chrono::seconds{5});
+    CHECK(std::chrono::microseconds{0} == socket.receiveDelay());
+  }
+}
+
+} // namespace asio
+} // namespace platforms
+} // namespace ableton
@@ -0,0 +1,32 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+// Compiles all members of a Link that runs on the io_uring sockets. Nothing is run,
+// see tst_UringSocket.cpp for the sockets themselves.
+
+#include <ableton/Link.hpp>
+#include <ableton/platforms/linux/UringContext.hpp>
+
+namespace ableton
+{
+
+template class BasicLink<link::platform::Clock, platforms::linux_::UringContext>;
+template class BasicLink<link::platform::Clock, platforms::linux_::SharedUringContext>;
+
+} // namespace ableton
@@ -0,0 +1,211 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/platforms/linux/UringSocket.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace ableton
+{
+namespace platforms
+{
+namespace linux_
+{
+namespace
+{
+
+// Few buffers, so that receiving a handful of datagrams already reuses them
+using TestSocket = UringSocket<64, 4>;
+using Endpoint = ::asio::ip::udp::endpoint;
+
+Endpoint loopback()
+{
+  return {::asio::ip::address_v4::loopback(), 0};
+}
+
+// A plain socket on the loopback interface that the tested socket talks to
+struct Peer
+{
+  Peer(::asio::io_service& io)
+    : socket(io, loopback())
+  {
+    socket.non_blocking(true);
+  }
+
+  // The first byte of each datagram that has arrived so far
+  std::vector<uint8_t> receivedBytes()
+  {
+    std::vector<uint8_t> result;
+    std::array<uint8_t, 64> buffer;
+    Endpoint from;
+    ::asio::error_code ec;
+    for (;;)
+    {
+      const auto size = socket.receive_from(::asio::buffer(buffer), from, 0, ec);
+      if (ec)
+      {
+        return result;
+      }
+      if (size > 0)
+      {
+        result.push_back(buffer[0]);
+      }
+    }
+  }
+
+  void send(const uint8_t value, const Endpoint& to)
+  {
+    socket.send_to(::asio::buffer(&value, 1), to);
+  }
+
+  ::asio::ip::udp::socket socket;
+};
+
+// Receives again after each datagram
+struct Receiver
+{
+  void operator()(const Endpoint& from,
+    const TestSocket::Impl::ByteIt begin,
+    const TestSocket::Impl::ByteIt end)
+  {
+    senders.push_back(from);
+    values.push_back(*begin);
+    sizes.push_back(static_cast<std::size_t>(end - begin));
+    pSocket->receive(std::ref(*this));
+  }
+
+  TestSocket* pSocket;
+  std::vector<Endpoint> senders;
+  std::vector<uint8_t> values;
+  std::vector<std::size_t> sizes;
+};
+
+template <typename Condition>
+void pollUntil(::asio::io_service& io, Condition condition)
+{
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+  while (!condition() && std::chrono::steady_clock::now() < deadline)
+  {
+    io.poll();
+    io.restart();
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  }
+}
+
+} // namespace
+
+TEST_CASE("UringSocket")
+{
+  // The kernel may lack io_uring or a seccomp filter may block it, e.g. in containers
+  if (!isUringAvailable())
+  {
+    WARN("io_uring is not available, skipping the UringSocket tests");
+    return;
+  }
+
+  ::asio::io_service io;
+  TestSocket socket{io};
+  socket.mpImpl->mSocket.bind(loopback());
+  Peer peer{io};
+  const auto to = peer.socket.local_endpoint();
+
+  SECTION("SendsTheDatagramsOfAHandlerToTheLoopbackInterface")
+  {
+    const std::vector<uint8_t> values{0, 1, 2, 3, 4, 5, 6, 7};
+    ::asio::post(io, [&] {
+      for (const auto value : values)
+      {
+        socket.send(&value, 1, to);
+      }
+    });
+    std::vector<uint8_t> received;
+    pollUntil(io, [&] {
+      const auto bytes = peer.receivedBytes();
+      received.insert(received.end(), bytes.begin(), bytes.end());
+      return received.size() >= values.size();
+    });
+    CHECK(values == received);
+  }
+
+  SECTION("ReceivesMoreDatagramsFromTheLoopbackInterfaceThanItHasBuffers")
+  {
+    Receiver receiver{&socket, {}, {}, {}};
+    socket.receive(std::ref(receiver));
+    const auto numDatagrams = std::size_t{16};
+    for (std::size_t i = 0; i < numDatagrams; ++i)
+    {
+      peer.send(static_cast<uint8_t>(i), socket.endpoint());
+      // Let the socket catch up now and then, the loopback interface doesn't queue
+      // datagrams without limit
+      if (i % 4 == 3)
+      {
+        pollUntil(io, [&] { return receiver.values.size() == i + 1; });
+      }
+    }
+    pollUntil(io, [&] { return receiver.values.size() == numDatagrams; });
+
+    REQUIRE(numDatagrams == receiver.values.size());
+    for (std::size_t i = 0; i < numDatagrams; ++i)
+    {
+      CHECK(static_cast<uint8_t>(i) == receiver.values[i]);
+      CHECK(1 == receiver.sizes[i]);
+      CHECK(to == receiver.senders[i]);
+    }
+  }
+
+  SECTION("AnswersTheDatagramsThatItReceives")
+  {
+    struct Echo
+    {
+      void operator()(const Endpoint& from,
+        const TestSocket::Impl::ByteIt begin,
+        const TestSocket::Impl::ByteIt)
+      {
+        const auto value = static_cast<uint8_t>(*begin + 1);
+        pSocket->send(&value, 1, from);
+        pSocket->receive(std::ref(*this));
+      }
+
+      TestSocket* pSocket;
+    };
+
+    Echo echo{&socket};
+    socket.receive(std::ref(echo));
+    std::vector<uint8_t> received;
+    for (uint8_t value = 0; value < 3; ++value)
+    {
+      peer.send(value, socket.endpoint());
+      pollUntil(io, [&] {
+        const auto bytes = peer.receivedBytes();
+        received.insert(received.end(), bytes.begin(), bytes.end());
+        return received.size() > value;
+      });
+    }
+    CHECK((std::vector<uint8_t>{1, 2, 3}) == received);
+  }
+}
+
+} // namespace linux_
+} // namespace platforms
+} // namespace ableton
@@ -0,0 +1,180 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/discovery/PacketCapture.hpp>
+#include <ableton/test/serial_io/Simulation.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Feeds a capture of LinkCapture to a Link controller on a simulated host, as fast
+// as possible, e.g.
+//
+//   LinkReplay --input show.lcap --repeat 10
+//
+// The datagrams pass through the whole receive path, from the messenger and the
+// peer gateway to the peers and the sessions, so that it can be profiled and
+// benchmarked with the traffic of a real show. The virtual clock of the host
+// follows the times of the capture, so that timeouts expire as they did while
+// capturing. The replies of the controller, e.g. its measurement pings, don't reach
+// the captured peers. Only the v4 datagrams are replayed, those of all interfaces
+// unless one is given with --interface. With --repeat n, the capture is replayed n
+// times in a row.
+
+namespace
+{
+
+using namespace ableton;
+using Simulation = test::serial_io::Simulation;
+
+void printUsage()
+{
+  std::cout << "usage: LinkReplay --input file [--interface address] [--repeat n]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  using namespace std::chrono;
+
+  auto input = std::string{};
+  auto interfaceAddr = asio::ip::address{};
+  auto numRepeats = std::size_t{1};
+  for (int i = 1; i < argc; ++i)
+  {
+    const auto hasValue = i + 1 < argc;
+    if (std::strcmp(argv[i], "--input") == 0 && hasValue)
+    {
+      input = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "--interface") == 0 && hasValue)
+    {
+      interfaceAddr = asio::ip::address::from_string(argv[++i]);
+    }
+    else if (std::strcmp(argv[i], "--repeat") == 0 && hasValue)
+    {
+      numRepeats = std::strtoul(argv[++i], nullptr, 10);
+    }
+    else
+    {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (input.empty())
+  {
+    printUsage();
+    return 1;
+  }
+
+  std::ifstream file{input, std::ios::binary};
+  if (!file)
+  {
+    std::cerr << "can't open " << input << "\n";
+    return 1;
+  }
+
+  auto packets = std::vector<discovery::CapturedPacket>{};
+  try
+  {
+    packets = discovery::readPacketCapture(file);
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << input << ": " << e.what() << "\n";
+    return 1;
+  }
+
+  auto replayed = std::vector<const discovery::CapturedPacket*>{};
+  for (const auto& packet : packets)
+  {
+    if (packet.from.address().is_v4()
+        && (interfaceAddr.is_unspecified() || packet.interfaceAddr == interfaceAddr))
+    {
+      replayed.push_back(&packet);
+    }
+  }
+  if (replayed.empty())
+  {
+    std::cerr << "no packets to replay\n";
+    return 1;
+  }
+
+  test::serial_io::Network network{test::serial_io::Network::Config{}};
+  auto& host = network.addHost(asio::ip::address_v4::from_string("10.255.255.1"));
+  const auto clock =
+    Simulation::Clock{&network, network.now(), microseconds{0}, 0., {}, {}, {}};
+  Simulation::Controller controller{link::Tempo{120.}, [](std::size_t) {},
+    [](link::Tempo) {}, [](bool) {}, clock, host};
+  controller.enableStartStopSync(true);
+  controller.enable(true);
+
+  const auto to = asio::ip::udp::endpoint{
+    host.address(), discovery::multicastEndpointV4().port()};
+  const auto captureStart = replayed.front()->time;
+  // Repetitions start a millisecond after the end of the previous one
+  const auto span = replayed.back()->time - captureStart + milliseconds{1};
+  const auto replayStart = clock.micros();
+  auto numBytes = std::size_t{0};
+
+  const auto wallStart = steady_clock::now();
+  for (std::size_t repeat = 0; repeat < numRepeats; ++repeat)
+  {
+    for (const auto pPacket : replayed)
+    {
+      const auto time = replayStart + static_cast<microseconds::rep>(repeat) * span
+                        + (pPacket->time - captureStart);
+      const auto now = clock.micros();
+      if (time > now)
+      {
+        network.advanceTime(time - now);
+      }
+      network.inject(pPacket->from, to, pPacket->bytes);
+      numBytes += pPacket->bytes.size();
+    }
+  }
+  const auto wallTime = duration_cast<microseconds>(steady_clock::now() - wallStart);
+
+  const auto numReplayed = replayed.size() * numRepeats;
+  const auto wallSeconds = static_cast<double>(wallTime.count()) / 1e6;
+  const auto stats = controller.stats();
+  std::cout << "packets in capture:      " << packets.size() << "\n"
+            << "packets replayed:        " << numReplayed << " (" << numBytes
+            << " bytes)\n"
+            << "captured time:           "
+            << duration_cast<milliseconds>(span * numRepeats).count() << " ms\n"
+            << "replay time:             "
+            << duration_cast<milliseconds>(wallTime).count() << " ms\n"
+            << "packets per s:           "
+            << static_cast<double>(numReplayed) / wallSeconds << "\n"
+            << "us per packet:           "
+            << static_cast<double>(wallTime.count()) / static_cast<double>(numReplayed)
+            << "\n"
+            << "packets received:        " << stats.traffic.packetsReceived << "\n"
+            << "parse failures:          " << stats.traffic.parseFailures << "\n"
+            << "measurements started:    " << stats.measurementsStarted << "\n";
+  return 0;
+}
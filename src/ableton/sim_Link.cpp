@@ -0,0 +1,297 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/link/Stats.hpp>
+#include <ableton/test/serial_io/Simulation.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Runs a Link session on a simulated network and reports how it converged, e.g.
+//
+//   LinkSimulation --peers 500 --duration 60 --latency 2000 --jitter 1000 --loss 0.01
+//
+// With --network-load n, prints a table of the traffic per peer for sessions of
+// 2, 4, ... n peers instead. The join burst is the traffic while all peers join at
+// once and the steady state is the traffic during the following duration, which
+// should span at least one remeasurement of the session (30 s).
+//
+// With --sample-period ms, prints how accurately the peers agree on the time of the
+// session every sample period instead, next to the joins and measurements of that
+// period. The clocks of the simulation derive from the time of the network, which
+// is the ground truth the errors are measured against. To see the effect of
+// remeasurements, the duration should span several of them, e.g.
+//
+//   LinkSimulation --peers 8 --duration 120 --join-interval 1000 --drift 1e-4
+//                  --clock-jitter 200 --jitter 1000 --loss 0.05 --sample-period 1000
+//
+// Times are given in microseconds, except for the durations, the join interval and
+// the sample period, which are given in seconds and milliseconds.
+
+namespace
+{
+
+using namespace ableton::test::serial_io;
+
+void printUsage()
+{
+  std::cout << "usage: LinkSimulation [--peers n] [--duration s] [--latency us]\n"
+               "                      [--jitter us] [--loss p] [--drift rate]\n"
+               "                      [--clock-jitter us] [--join-interval ms]\n"
+               "                      [--seed n] [--network-load max-peers]\n"
+               "                      [--join-window s] [--sample-period ms]\n";
+}
+
+void printReport(const Simulation::Report& report)
+{
+  using namespace std::chrono;
+
+  std::cout << "peers:                   " << report.numPeers << "\n"
+            << "simulated time:          "
+            << duration_cast<seconds>(report.duration).count() << " s\n"
+            << "convergence time:        ";
+  if (report.convergenceTime)
+  {
+    std::cout << duration_cast<milliseconds>(*report.convergenceTime).count() << " ms\n";
+  }
+  else
+  {
+    std::cout << "not converged\n";
+  }
+  std::cout << "packets per peer per s:  " << report.packetsPerPeerPerSecond() << "\n"
+            << "bytes per peer per s:    " << report.bytesPerPeerPerSecond() << "\n"
+            << "packets lost:            " << report.traffic.packetsLost << "\n"
+            << "final phase error:       " << report.phaseError.count() << " us\n"
+            << "final ghost time error:  " << report.ghostTimeError.count() << " us\n";
+}
+
+// Sent packets and bytes, sent multicast packets and received packets, each per
+// peer and second
+void printLoadRow(const Simulation::Report& report)
+{
+  std::printf(" %8.1f %10.0f %8.1f %8.1f", report.packetsPerPeerPerSecond(),
+    report.bytesPerPeerPerSecond(),
+    report.perPeerPerSecond(report.traffic.multicastPacketsSent),
+    report.perPeerPerSecond(report.traffic.packetsReceived));
+}
+
+// Returns false if a session didn't converge within the join window
+bool printNetworkLoad(Simulation::Config config,
+  const std::size_t maxNumPeers,
+  const std::chrono::microseconds joinWindow,
+  const std::chrono::microseconds steadyWindow)
+{
+  std::printf("%5s | %-37s | %-37s |\n", "", "join burst", "steady state");
+  std::printf("%5s | %8s %10s %8s %8s | %8s %10s %8s %8s | %s\n", "peers", "tx pkt/s",
+    "tx B/s", "mcast/s", "rx pkt/s", "tx pkt/s", "tx B/s", "mcast/s", "rx pkt/s",
+    "converged");
+
+  auto allConverged = true;
+  for (std::size_t numPeers = 2; numPeers <= maxNumPeers; numPeers *= 2)
+  {
+    config.numPeers = numPeers;
+    Simulation simulation{config};
+    const auto join = simulation.run(joinWindow);
+    const auto steady = simulation.run(steadyWindow);
+
+    std::printf("%5zu |", numPeers);
+    printLoadRow(join);
+    std::printf(" |");
+    printLoadRow(steady);
+    if (join.convergenceTime)
+    {
+      std::printf(" | %lld ms\n",
+        static_cast<long long>((*join.convergenceTime).count() / 1000));
+    }
+    else
+    {
+      std::printf(" | no\n");
+    }
+    std::fflush(stdout);
+    allConverged = allConverged && join.convergenceTime;
+  }
+  return allConverged;
+}
+
+// The sums of the counters of all peers
+ableton::link::Stats sumOfStats(Simulation& simulation, const std::size_t numPeers)
+{
+  auto sum = ableton::link::Stats{};
+  for (std::size_t i = 0; i < numPeers; ++i)
+  {
+    const auto stats = simulation.controller(i).stats();
+    sum.sessionJoins += stats.sessionJoins;
+    sum.measurementsSucceeded += stats.measurementsSucceeded;
+    sum.measurementsFailed += stats.measurementsFailed;
+  }
+  return sum;
+}
+
+// Returns false if the session didn't converge by the end of the duration
+bool printAccuracy(const Simulation::Config& config,
+  const std::chrono::microseconds duration,
+  const std::chrono::microseconds samplePeriod)
+{
+  using namespace std::chrono;
+
+  std::printf("%8s | %7s | %5s %8s %6s | %10s %10s\n", "time s", "enabled", "joins",
+    "measured", "failed", "phase us", "ghost us");
+
+  Simulation simulation{config};
+  auto before = ableton::link::Stats{};
+  auto maxErrorInSync = microseconds{0};
+  auto elapsed = microseconds{0};
+  while (elapsed < duration)
+  {
+    const auto report = simulation.run(samplePeriod);
+    elapsed += samplePeriod;
+
+    auto numEnabled = std::size_t{0};
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      numEnabled += simulation.controller(i).isEnabled() ? 1 : 0;
+    }
+    const auto stats = sumOfStats(simulation, config.numPeers);
+    std::printf("%8.1f | %7zu | %5llu %8llu %6llu | %10lld %10lld\n",
+      static_cast<double>(elapsed.count()) / 1e6, numEnabled,
+      static_cast<unsigned long long>(stats.sessionJoins - before.sessionJoins),
+      static_cast<unsigned long long>(
+        stats.measurementsSucceeded - before.measurementsSucceeded),
+      static_cast<unsigned long long>(
+        stats.measurementsFailed - before.measurementsFailed),
+      static_cast<long long>(report.phaseError.count()),
+      static_cast<long long>(report.ghostTimeError.count()));
+    std::fflush(stdout);
+    before = stats;
+
+    if (simulation.isInSync())
+    {
+      maxErrorInSync = (std::max)(maxErrorInSync, report.ghostTimeError);
+    }
+  }
+
+  const auto report = simulation.run(microseconds{0});
+  if (!report.convergenceTime)
+  {
+    std::printf("not converged\n");
+    return false;
+  }
+  std::printf("converged %lld ms after the last join, max ghost time error in sync "
+              "%lld us\n",
+    static_cast<long long>((*report.convergenceTime).count() / 1000),
+    static_cast<long long>(maxErrorInSync.count()));
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  using namespace std::chrono;
+
+  auto config = Simulation::Config{};
+  auto duration = seconds{30};
+  auto joinWindow = seconds{5};
+  auto maxNumPeers = std::size_t{0};
+  auto samplePeriod = milliseconds{0};
+  for (int i = 1; i < argc; ++i)
+  {
+    const auto hasValue = i + 1 < argc;
+    const char* const value = hasValue ? argv[i + 1] : "";
+    if (!hasValue || std::strncmp(argv[i], "--", 2) != 0)
+    {
+      printUsage();
+      return 1;
+    }
+
+    const auto option = std::string{argv[i] + 2};
+    if (option == "peers")
+    {
+      config.numPeers = static_cast<std::size_t>(std::strtoul(value, nullptr, 10));
+    }
+    else if (option == "duration")
+    {
+      duration = seconds{std::strtol(value, nullptr, 10)};
+    }
+    else if (option == "latency")
+    {
+      config.network.latency = microseconds{std::strtol(value, nullptr, 10)};
+    }
+    else if (option == "jitter")
+    {
+      config.network.jitter = microseconds{std::strtol(value, nullptr, 10)};
+    }
+    else if (option == "loss")
+    {
+      config.network.lossRate = std::strtod(value, nullptr);
+    }
+    else if (option == "drift")
+    {
+      config.maxClockDrift = std::strtod(value, nullptr);
+    }
+    else if (option == "clock-jitter")
+    {
+      config.clockJitter = microseconds{std::strtol(value, nullptr, 10)};
+    }
+    else if (option == "join-interval")
+    {
+      config.joinInterval = milliseconds{std::strtol(value, nullptr, 10)};
+    }
+    else if (option == "seed")
+    {
+      config.network.seed = static_cast<std::uint32_t>(std::strtoul(value, nullptr, 10));
+    }
+    else if (option == "network-load")
+    {
+      maxNumPeers = static_cast<std::size_t>(std::strtoul(value, nullptr, 10));
+    }
+    else if (option == "join-window")
+    {
+      joinWindow = seconds{std::strtol(value, nullptr, 10)};
+    }
+    else if (option == "sample-period")
+    {
+      samplePeriod = milliseconds{std::strtol(value, nullptr, 10)};
+    }
+    else
+    {
+      printUsage();
+      return 1;
+    }
+    ++i;
+  }
+
+  if (maxNumPeers > 0)
+  {
+    return printNetworkLoad(config, maxNumPeers, joinWindow, duration) ? 0 : 2;
+  }
+
+  if (samplePeriod > milliseconds{0})
+  {
+    return printAccuracy(config, duration, samplePeriod) ? 0 : 2;
+  }
+
+  Simulation simulation{config};
+  const auto report = simulation.run(duration);
+  printReport(report);
+  return report.convergenceTime ? 0 : 2;
+}
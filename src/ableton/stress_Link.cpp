@@ -0,0 +1,299 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/Link.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(LINK_PLATFORM_UNIX)
+#include <sys/resource.h>
+#endif
+#if defined(LINK_PLATFORM_LINUX)
+#include <dirent.h>
+#include <fstream>
+#include <unistd.h>
+#endif
+
+// Measures what many Link instances in one process cost, like the instances of a
+// plugin in a host, e.g.
+//
+//   LinkStress --instances 32 --block-rate 375 --duration 10
+//
+// The instances are created and enabled one after the other and then run for the
+// duration, given in seconds. A single thread plays the audio thread of the host:
+// at the block rate, it captures the session state of each instance, evaluates it
+// and commits it back, with a change of tempo on one of the instances every second.
+// The threads, sockets and resident memory of the process are reported before the
+// instances are created and once they're running, along with the differences per
+// instance, the CPU time of the process during the run and the time the audio
+// thread spent in Link per block. Threads, sockets and memory are read from /proc
+// and only reported on Linux, CPU time only on Unix.
+
+namespace
+{
+
+using namespace std::chrono;
+
+void printUsage()
+{
+  std::cout << "usage: LinkStress [--instances n] [--block-rate hz] [--duration s]\n"
+               "                  [--quantum q]\n";
+}
+
+struct Config
+{
+  std::size_t numInstances = 32;
+  double blockRate = 375.;
+  seconds duration{10};
+  double quantum = 4.;
+};
+
+// The resources of the process at a point in time, negative if unknown
+struct Usage
+{
+  long numThreads = -1;
+  long numSockets = -1;
+  long rssKiB = -1;
+  microseconds cpuTime{-1};
+};
+
+#if defined(LINK_PLATFORM_LINUX)
+long statusValue(const std::string& key)
+{
+  std::ifstream status{"/proc/self/status"};
+  std::string line;
+  while (std::getline(status, line))
+  {
+    if (line.compare(0, key.size(), key) == 0 && line.size() > key.size()
+        && line[key.size()] == ':')
+    {
+      return std::strtol(line.c_str() + key.size() + 1, nullptr, 10);
+    }
+  }
+  return -1;
+}
+
+long numSockets()
+{
+  const auto pDir = opendir("/proc/self/fd");
+  if (!pDir)
+  {
+    return -1;
+  }
+  auto count = long{0};
+  while (const auto pEntry = readdir(pDir))
+  {
+    const auto path = std::string{"/proc/self/fd/"} + pEntry->d_name;
+    char target[64];
+    const auto size = readlink(path.c_str(), target, sizeof(target) - 1);
+    if (size >= 7 && std::strncmp(target, "socket:", 7) == 0)
+    {
+      ++count;
+    }
+  }
+  closedir(pDir);
+  return count;
+}
+#endif
+
+Usage usage()
+{
+  Usage result;
+#if defined(LINK_PLATFORM_LINUX)
+  result.numThreads = statusValue("Threads");
+  result.numSockets = numSockets();
+  result.rssKiB = statusValue("VmRSS");
+#endif
+#if defined(LINK_PLATFORM_UNIX)
+  rusage self;
+  if (getrusage(RUSAGE_SELF, &self) == 0)
+  {
+    const auto toMicros = [](const timeval& time) {
+      return seconds{time.tv_sec} + microseconds{time.tv_usec};
+    };
+    result.cpuTime = toMicros(self.ru_utime) + toMicros(self.ru_stime);
+  }
+#endif
+  return result;
+}
+
+void printResource(const std::string& name,
+  const long before,
+  const long after,
+  const std::size_t numInstances,
+  const std::string& unit)
+{
+  std::cout << std::left << std::setw(10) << (name + ":");
+  if (before < 0 || after < 0)
+  {
+    std::cout << "unknown\n";
+    return;
+  }
+  const auto perInstance =
+    static_cast<double>(after - before) / static_cast<double>(numInstances);
+  std::cout << before << unit << " -> " << after << unit << " (" << std::fixed
+            << std::setprecision(1) << perInstance << unit << " per instance)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  Config config;
+  for (int i = 1; i < argc; ++i)
+  {
+    const auto hasValue = i + 1 < argc;
+    if (std::strcmp(argv[i], "--instances") == 0 && hasValue)
+    {
+      config.numInstances = std::strtoul(argv[++i], nullptr, 10);
+    }
+    else if (std::strcmp(argv[i], "--block-rate") == 0 && hasValue)
+    {
+      config.blockRate = std::strtod(argv[++i], nullptr);
+    }
+    else if (std::strcmp(argv[i], "--duration") == 0 && hasValue)
+    {
+      config.duration = seconds{std::strtoll(argv[++i], nullptr, 10)};
+    }
+    else if (std::strcmp(argv[i], "--quantum") == 0 && hasValue)
+    {
+      config.quantum = std::strtod(argv[++i], nullptr);
+    }
+    else
+    {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (config.numInstances == 0 || !(config.blockRate > 0.)
+      || config.duration <= seconds{0} || !(config.quantum > 0.))
+  {
+    printUsage();
+    return 1;
+  }
+
+  const auto before = usage();
+  std::vector<std::unique_ptr<ableton::Link>> links;
+  for (std::size_t i = 0; i < config.numInstances; ++i)
+  {
+    links.emplace_back(new ableton::Link(120.));
+    links.back()->enableStartStopSync(true);
+    links.back()->enable(true);
+  }
+
+  const auto blockPeriod = duration_cast<steady_clock::duration>(
+    duration<double>{1. / config.blockRate});
+  const auto start = steady_clock::now();
+  const auto end = start + config.duration;
+  const auto runStart = usage();
+  auto nextBlock = start;
+  auto nextChange = start + seconds{1};
+  auto numBlocks = std::size_t{0};
+  auto numLateBlocks = std::size_t{0};
+  auto numChanges = std::size_t{0};
+  auto audioTime = nanoseconds{0};
+  auto maxAudioTime = nanoseconds{0};
+  // Keeps the evaluation of the session states from being optimized out
+  volatile double beat = 0.;
+  while (nextBlock < end)
+  {
+    std::this_thread::sleep_until(nextBlock);
+    const auto blockStart = steady_clock::now();
+    const auto changeTempo = blockStart >= nextChange;
+    for (std::size_t i = 0; i < links.size(); ++i)
+    {
+      auto& link = *links[i];
+      const auto time = link.clock().micros();
+      auto sessionState = link.captureAudioSessionState();
+      beat = sessionState.beatAtTime(time, config.quantum);
+      if (changeTempo && i == numChanges % links.size())
+      {
+        sessionState.setTempo(sessionState.tempo() == 120. ? 121. : 120., time);
+      }
+      link.commitAudioSessionState(sessionState);
+    }
+    const auto blockEnd = steady_clock::now();
+    const auto blockTime = duration_cast<nanoseconds>(blockEnd - blockStart);
+    audioTime += blockTime;
+    maxAudioTime = (std::max)(maxAudioTime, blockTime);
+    if (changeTempo)
+    {
+      ++numChanges;
+      nextChange += seconds{1};
+    }
+    ++numBlocks;
+    nextBlock += blockPeriod;
+    if (blockEnd > nextBlock)
+    {
+      ++numLateBlocks;
+    }
+  }
+  static_cast<void>(beat);
+  const auto runEnd = usage();
+  const auto runTime = duration_cast<microseconds>(steady_clock::now() - start);
+
+  auto numPeers = std::size_t{0};
+  for (const auto& pLink : links)
+  {
+    numPeers += pLink->numPeers();
+  }
+
+  std::cout << "instances: " << config.numInstances << "\n"
+            << "mean peers per instance: " << std::fixed << std::setprecision(1)
+            << static_cast<double>(numPeers) / static_cast<double>(links.size())
+            << "\n";
+  printResource(
+    "threads", before.numThreads, runEnd.numThreads, config.numInstances, "");
+  printResource(
+    "sockets", before.numSockets, runEnd.numSockets, config.numInstances, "");
+  printResource("rss", before.rssKiB, runEnd.rssKiB, config.numInstances, " KiB");
+
+  std::cout << std::left << std::setw(10) << "cpu:";
+  if (runStart.cpuTime < microseconds{0} || runEnd.cpuTime < microseconds{0})
+  {
+    std::cout << "unknown\n";
+  }
+  else
+  {
+    // Includes the audio thread
+    const auto cpuTime = runEnd.cpuTime - runStart.cpuTime;
+    const auto load = 100. * static_cast<double>(cpuTime.count())
+                      / static_cast<double>(runTime.count());
+    std::cout << std::setprecision(2) << load << " % of a core ("
+              << load / static_cast<double>(config.numInstances) << " % per instance)\n";
+  }
+
+  const auto meanAudioTime = numBlocks > 0 ? static_cast<double>(audioTime.count())
+                                               / static_cast<double>(numBlocks)
+                                           : 0.;
+  std::cout << std::left << std::setw(10) << "audio:" << numBlocks << " blocks, mean "
+            << std::setprecision(1) << meanAudioTime / 1e3 << " us, max "
+            << static_cast<double>(maxAudioTime.count()) / 1e3 << " us per block ("
+            << meanAudioTime / 1e3 / static_cast<double>(config.numInstances)
+            << " us per instance), " << numLateBlocks << " late\n";
+  return 0;
+}
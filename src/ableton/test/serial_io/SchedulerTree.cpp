@@ -43,10 +43,14 @@ std::shared_ptr<SchedulerTree> SchedulerTree::makeChild()
 
 void SchedulerTree::cancelTimer(const TimerId timerId)
 {
-  const auto it = std::find_if(
-    begin(mTimers), end(mTimers), [timerId](const TimerMap::value_type& timer) {
-      return timer.first.second == timerId;
-    });
+  const auto expirationIt = mTimerExpirations.find(timerId);
+  if (expirationIt == end(mTimerExpirations))
+  {
+    return;
+  }
+
+  const auto it = mTimers.find(std::make_pair(expirationIt->second, timerId));
+  mTimerExpirations.erase(expirationIt);
   if (it != end(mTimers))
   {
     auto handler = std::move(it->second);
@@ -73,6 +77,12 @@ void SchedulerTree::triggerTimersUntil(const TimePoint t)
 
   const auto it = mTimers.upper_bound(make_pair(t, numeric_limits<TimerId>::max()));
   for_each(begin(mTimers), it, [this](const TimerMap::value_type& timer) {
+    const auto expirationIt = mTimerExpirations.find(timer.first.second);
+    if (expirationIt != end(mTimerExpirations)
+        && expirationIt->second == timer.first.first)
+    {
+      mTimerExpirations.erase(expirationIt);
+    }
     mPendingHandlers.push_back([timer]() {
       timer.second(0); // 0 indicates no error
     });
@@ -0,0 +1,172 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/test/serial_io/Network.hpp>
+#include <vector>
+
+namespace ableton
+{
+namespace test
+{
+namespace serial_io
+{
+namespace
+{
+
+using Socket = Network::Socket<512>;
+
+struct Received
+{
+  Network::TimePoint time;
+  asio::ip::udp::endpoint from;
+  std::vector<uint8_t> data;
+};
+
+void receiveInto(Socket& socket, const Network& network, std::vector<Received>& received)
+{
+  socket.receive([&network, &received](const asio::ip::udp::endpoint& from,
+                   const uint8_t* begin, const uint8_t* end) {
+    received.push_back({network.now(), from, {begin, end}});
+  });
+}
+
+} // namespace
+
+TEST_CASE("Network")
+{
+  auto config = Network::Config{};
+  config.latency = std::chrono::microseconds{1000};
+  config.resolution = std::chrono::microseconds{1};
+  Network network{config};
+  auto& host1 = network.addHost(asio::ip::address_v4::from_string("10.0.0.1"));
+  auto& host2 = network.addHost(asio::ip::address_v4::from_string("10.0.0.2"));
+  const auto data = std::vector<uint8_t>{1, 2, 3};
+  std::vector<Received> received;
+
+  SECTION("DeliversUnicastAfterLatency")
+  {
+    auto sender = network.openUnicastSocket<512>(host1);
+    auto receiver = network.openUnicastSocket<512>(host2);
+    receiveInto(receiver, network, received);
+    const auto sendTime = network.now();
+    sender.send(data.data(), data.size(), receiver.endpoint());
+
+    network.advanceTime(std::chrono::microseconds{999});
+    CHECK(received.empty());
+    network.advanceTime(std::chrono::microseconds{1});
+    REQUIRE(1 == received.size());
+    CHECK(sendTime + std::chrono::microseconds{1000} == received[0].time);
+    CHECK(sender.endpoint() == received[0].from);
+    CHECK(data == received[0].data);
+    CHECK(1 == host1.traffic().packetsSent);
+    CHECK(3 == host1.traffic().bytesSent);
+    CHECK(1 == host2.traffic().packetsReceived);
+  }
+
+  SECTION("DeliversMulticastToAllHosts")
+  {
+    auto sender = network.openUnicastSocket<512>(host1);
+    auto receiver1 = network.openMulticastSocket<512>(host1);
+    auto receiver2 = network.openMulticastSocket<512>(host2);
+    receiveInto(receiver1, network, received);
+    receiveInto(receiver2, network, received);
+    sender.send(data.data(), data.size(), discovery::multicastEndpointV4());
+
+    network.advanceTime(std::chrono::milliseconds{1});
+    CHECK(2 == received.size());
+    CHECK(1 == network.traffic().packetsSent);
+    CHECK(1 == network.traffic().multicastPacketsSent);
+    CHECK(2 == network.traffic().packetsReceived);
+  }
+
+  SECTION("DropsDatagramsForClosedSockets")
+  {
+    auto sender = network.openUnicastSocket<512>(host1);
+    auto endpoint = asio::ip::udp::endpoint{};
+    {
+      auto receiver = network.openUnicastSocket<512>(host2);
+      receiveInto(receiver, network, received);
+      endpoint = receiver.endpoint();
+      sender.send(data.data(), data.size(), endpoint);
+    }
+
+    network.advanceTime(std::chrono::milliseconds{1});
+    CHECK(received.empty());
+    CHECK(0 == host2.traffic().packetsReceived);
+  }
+
+  SECTION("DeliversInjectedDatagramsRightAway")
+  {
+    auto receiver1 = network.openMulticastSocket<512>(host1);
+    auto receiver2 = network.openMulticastSocket<512>(host2);
+    receiveInto(receiver1, network, received);
+    receiveInto(receiver2, network, received);
+    const auto from =
+      asio::ip::udp::endpoint{asio::ip::address_v4::from_string("192.168.0.1"), 20808};
+
+    network.inject(from, discovery::multicastEndpointV4(), data);
+    REQUIRE(2 == received.size());
+    CHECK(from == received[0].from);
+    CHECK(data == received[0].data);
+
+    network.inject(from, {host2.address(), 20808}, data);
+    CHECK(3 == received.size());
+    CHECK(0 == network.traffic().packetsSent);
+    CHECK(2 == host2.traffic().packetsReceived);
+  }
+
+  SECTION("RunsHandlersPostedFromOutsideRightAway")
+  {
+    auto numCalls = 0;
+    network.async([&network, &numCalls] {
+      ++numCalls;
+      network.async([&numCalls] { ++numCalls; });
+      // Handlers posted from handlers are queued
+      CHECK(1 == numCalls);
+    });
+    CHECK(2 == numCalls);
+  }
+}
+
+TEST_CASE("Network | Loss")
+{
+  auto config = Network::Config{};
+  config.lossRate = 1.;
+  Network network{config};
+  auto& host1 = network.addHost(asio::ip::address_v4::from_string("10.0.0.1"));
+  auto& host2 = network.addHost(asio::ip::address_v4::from_string("10.0.0.2"));
+  std::vector<Received> received;
+
+  auto sender = network.openUnicastSocket<512>(host1);
+  auto receiver = network.openUnicastSocket<512>(host2);
+  receiveInto(receiver, network, received);
+  const auto data = std::vector<uint8_t>{1, 2, 3};
+  sender.send(data.data(), data.size(), receiver.endpoint());
+  sender.send(data.data(), data.size(), receiver.endpoint());
+
+  network.advanceTime(std::chrono::milliseconds{10});
+  CHECK(received.empty());
+  CHECK(2 == host1.traffic().packetsSent);
+  CHECK(2 == host1.traffic().packetsLost);
+}
+
+} // namespace serial_io
+} // namespace test
+} // namespace ableton
@@ -0,0 +1,710 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/test/serial_io/Simulation.hpp>
+#include <vector>
+
+namespace ableton
+{
+namespace test
+{
+namespace serial_io
+{
+
+TEST_CASE("Simulation")
+{
+  auto config = Simulation::Config{};
+  config.numPeers = 8;
+
+  SECTION("ConvergesOnAPerfectNetwork")
+  {
+    config.maxClockDrift = 0.;
+    Simulation simulation{config};
+    const auto report = simulation.run(std::chrono::seconds{2});
+
+    REQUIRE(report.convergenceTime);
+    CHECK(*report.convergenceTime < std::chrono::seconds{1});
+    CHECK(report.phaseError <= config.network.resolution);
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(config.numPeers - 1 == simulation.controller(i).numPeers());
+    }
+    CHECK(0 == report.traffic.packetsLost);
+    CHECK(report.packetsPerPeerPerSecond() > 0.);
+  }
+
+  SECTION("ConvergesDespiteJitterAndLoss")
+  {
+    config.network.jitter = std::chrono::microseconds{1000};
+    config.network.lossRate = 0.1;
+    config.joinInterval = std::chrono::milliseconds{100};
+    Simulation simulation{config};
+    const auto report = simulation.run(std::chrono::seconds{5});
+
+    REQUIRE(report.convergenceTime);
+    CHECK(report.phaseError <= config.phaseTolerance);
+    CHECK(report.traffic.packetsLost > 0);
+  }
+
+  SECTION("GhostTimesAgreeWithJitteryClocksAcrossRemeasurements")
+  {
+    config.clockJitter = std::chrono::microseconds{200};
+    config.network.jitter = std::chrono::microseconds{500};
+    Simulation simulation{config};
+    const auto join = simulation.run(std::chrono::seconds{2});
+    REQUIRE(join.convergenceTime);
+    CHECK(join.ghostTimeError <= config.phaseTolerance);
+
+    // Spans two remeasurements of the session
+    const auto steady = simulation.run(std::chrono::seconds{25});
+    CHECK(steady.ghostTimeError <= config.phaseTolerance);
+  }
+
+  SECTION("GhostTimesDontJumpOnRemeasurementsWithClockSlewing")
+  {
+    config.clockJitter = std::chrono::microseconds{200};
+    config.network.jitter = std::chrono::microseconds{500};
+    Simulation simulation{config};
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      simulation.controller(i).enableClockSlewing(true);
+    }
+    const auto join = simulation.run(std::chrono::seconds{2});
+    REQUIRE(join.convergenceTime);
+
+    // Spans two remeasurements of the session. A change of the xform must not move
+    // the ghost time at the moment it's applied.
+    auto xforms = std::vector<link::GhostXForm>{};
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      xforms.push_back(simulation.controller(i).ghostXForm());
+    }
+    auto maxJump = std::chrono::microseconds{0};
+    for (int step = 0; step < 2500; ++step)
+    {
+      simulation.run(std::chrono::milliseconds{10});
+      for (std::size_t i = 0; i < config.numPeers; ++i)
+      {
+        const auto now = simulation.clock(i).micros();
+        const auto xform = simulation.controller(i).ghostXForm();
+        maxJump = (std::max)(maxJump,
+          std::chrono::microseconds{
+            std::abs((xform.hostToGhost(now) - xforms[i].hostToGhost(now)).count())});
+        xforms[i] = xform;
+      }
+    }
+    CHECK(maxJump <= std::chrono::microseconds{20});
+    CHECK(simulation.run(std::chrono::seconds{1}).ghostTimeError
+          <= config.phaseTolerance);
+  }
+
+  SECTION("ContinuesWhereThePreviousRunStopped")
+  {
+    Simulation simulation{config};
+    const auto join = simulation.run(std::chrono::seconds{1});
+    const auto steady = simulation.run(std::chrono::seconds{1});
+
+    REQUIRE(join.convergenceTime);
+    REQUIRE(steady.convergenceTime);
+    CHECK(*join.convergenceTime == *steady.convergenceTime);
+    CHECK(steady.traffic.packetsSent > 0);
+    CHECK(steady.traffic.packetsSent + join.traffic.packetsSent
+          == simulation.network().traffic().packetsSent);
+  }
+
+  SECTION("SuspendedPeerLeavesAndRejoins")
+  {
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{1});
+
+    simulation.controller(0).suspend();
+    simulation.run(std::chrono::milliseconds{500});
+    CHECK(!simulation.controller(0).isEnabled());
+    CHECK(0 == simulation.controller(0).numPeers());
+    for (std::size_t i = 1; i < config.numPeers; ++i)
+    {
+      CHECK(config.numPeers - 2 == simulation.controller(i).numPeers());
+    }
+
+    simulation.controller(0).enable(true);
+    simulation.run(std::chrono::milliseconds{500});
+    CHECK(simulation.isInSync());
+  }
+
+  SECTION("ShutDownPeerLeavesRightAway")
+  {
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{1});
+
+    auto done = simulation.controller(0).shutdown();
+    simulation.run(std::chrono::milliseconds{100});
+    CHECK(std::future_status::ready == done.wait_for(std::chrono::seconds{0}));
+    for (std::size_t i = 1; i < config.numPeers; ++i)
+    {
+      CHECK(config.numPeers - 2 == simulation.controller(i).numPeers());
+    }
+  }
+
+  SECTION("PeersKeepTheirStateThroughAShortOutage")
+  {
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{1});
+    REQUIRE(simulation.isInSync());
+    const auto measurementsBefore = simulation.controller(0).stats().measurementsStarted;
+
+    // The peers time out after 5 s, the network is back before the grace period ends
+    simulation.network().setLossRate(1.);
+    simulation.run(std::chrono::milliseconds{6000});
+    CHECK(0 == simulation.controller(0).numPeers());
+    simulation.network().setLossRate(0.);
+    simulation.run(std::chrono::seconds{1});
+
+    CHECK(simulation.isInSync());
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      // Only the reset when enabling
+      CHECK(1 == simulation.controller(i).stats().stateResets);
+      CHECK(config.numPeers - 1 == simulation.controller(i).numPeers());
+    }
+    CHECK(measurementsBefore == simulation.controller(0).stats().measurementsStarted);
+  }
+
+  SECTION("PeersResetTheirStateAfterALongOutage")
+  {
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{1});
+
+    simulation.network().setLossRate(1.);
+    simulation.run(std::chrono::seconds{10});
+    simulation.network().setLossRate(0.);
+    simulation.run(std::chrono::seconds{2});
+
+    CHECK(simulation.isInSync());
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(2 == simulation.controller(i).stats().stateResets);
+    }
+  }
+
+  SECTION("PeersOnlyJoinThePeersOfTheirGroup")
+  {
+    Simulation simulation{config};
+    for (std::size_t i = config.numPeers / 2; i < config.numPeers; ++i)
+    {
+      simulation.controller(i).setSessionGroup(1);
+    }
+    simulation.run(std::chrono::seconds{1});
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(config.numPeers / 2 - 1 == simulation.controller(i).numPeers());
+    }
+
+    // Changing the group leaves the peers of the previous one
+    simulation.controller(0).setSessionGroup(1);
+    simulation.run(std::chrono::seconds{1});
+    CHECK(config.numPeers / 2 == simulation.controller(0).numPeers());
+    CHECK(config.numPeers / 2 - 2 == simulation.controller(1).numPeers());
+  }
+
+  SECTION("ObserverFollowsTheSessionWithoutBeingSeen")
+  {
+    Simulation simulation{config};
+    simulation.controller(0).enableObserverMode(true);
+    simulation.run(std::chrono::seconds{1});
+    CHECK(config.numPeers - 1 == simulation.controller(0).numPeers());
+    for (std::size_t i = 1; i < config.numPeers; ++i)
+    {
+      CHECK(config.numPeers - 2 == simulation.controller(i).numPeers());
+    }
+    CHECK(simulation.phaseError() <= config.phaseTolerance);
+
+    // Leaving the mode announces the peer
+    simulation.controller(0).enableObserverMode(false);
+    simulation.run(std::chrono::seconds{1});
+    CHECK(simulation.isInSync());
+  }
+
+  SECTION("ConvergesWithTheGatewaysOnShards")
+  {
+    Simulation simulation{config};
+    for (std::size_t i = 0; i < config.numPeers / 2; ++i)
+    {
+      simulation.controller(i).enableThreadPerInterface(true);
+    }
+    const auto report = simulation.run(std::chrono::seconds{2});
+    REQUIRE(report.convergenceTime);
+    CHECK(report.phaseError <= config.phaseTolerance);
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(config.numPeers - 1 == simulation.controller(i).numPeers());
+    }
+
+    // Switching replaces the gateways. Losing all peers for a moment resets the
+    // state of the switching peers, the others keep their previous node ids until
+    // they time out.
+    simulation.controller(0).enableThreadPerInterface(false);
+    simulation.controller(config.numPeers - 1).enableThreadPerInterface(true);
+    simulation.run(std::chrono::seconds{2});
+    CHECK(config.numPeers - 1 == simulation.controller(0).numPeers());
+    CHECK(config.numPeers - 1 == simulation.controller(config.numPeers - 1).numPeers());
+    CHECK(simulation.phaseError() <= config.phaseTolerance);
+    simulation.run(std::chrono::seconds{6});
+    CHECK(simulation.isInSync());
+  }
+
+  SECTION("BackgroundPeersStayInTheSessionWithLessTraffic")
+  {
+    config.maxClockDrift = 0.;
+    Simulation full{config};
+    full.run(std::chrono::seconds{5});
+    const auto fullReport = full.run(std::chrono::seconds{20});
+
+    Simulation background{config};
+    background.run(std::chrono::seconds{5});
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      background.controller(i).setPowerProfile(link::PowerProfile::Background);
+    }
+    const auto report = background.run(std::chrono::seconds{20});
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(config.numPeers - 1 == background.controller(i).numPeers());
+    }
+    CHECK(background.isInSync());
+    CHECK(report.traffic.multicastPacketsSent * 2
+          < fullReport.traffic.multicastPacketsSent);
+
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      background.controller(i).setPowerProfile(link::PowerProfile::Full);
+    }
+    background.run(std::chrono::seconds{5});
+    CHECK(background.isInSync());
+  }
+
+  SECTION("HubsCutTheTrafficAndStillCountAllPeers")
+  {
+    config.numPeers = 24;
+    config.maxClockDrift = 0.;
+    Simulation fullMesh{config};
+    fullMesh.run(std::chrono::seconds{10});
+    const auto fullMeshReport = fullMesh.run(std::chrono::seconds{5});
+
+    Simulation hierarchical{config};
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      hierarchical.controller(i).setMaxDiscoveryHubs(4);
+    }
+    hierarchical.run(std::chrono::seconds{10});
+    const auto report = hierarchical.run(std::chrono::seconds{5});
+
+    CHECK(hierarchical.isInSync());
+    CHECK(report.traffic.multicastPacketsSent * 2
+          < fullMeshReport.traffic.multicastPacketsSent);
+    CHECK(report.traffic.packetsReceived * 2 < fullMeshReport.traffic.packetsReceived);
+  }
+
+  SECTION("PeersRememberTheAddressesOfTheirSessionPeers")
+  {
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{1});
+
+    const auto addresses = simulation.controller(0).knownPeerAddresses();
+    CHECK(config.numPeers - 1 == addresses.size());
+    CHECK(addresses.end()
+          == std::find(addresses.begin(), addresses.end(),
+            asio::ip::address{asio::ip::address_v4{(10u << 24) + 1u}}));
+  }
+
+  SECTION("PeersListTheOtherPeers")
+  {
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{2});
+    REQUIRE(simulation.isInSync());
+
+    const auto pPeers = simulation.controller(0).peerList();
+    REQUIRE(config.numPeers - 1 == pPeers->size());
+    const auto now = simulation.clock(0).micros();
+    const auto xform = simulation.controller(0).ghostXForm();
+    for (const auto& peer : *pPeers)
+    {
+      CHECK(pPeers->front().sessionId == peer.sessionId);
+      CHECK(xform == peer.xform);
+      CHECK(peer.lastSeen > std::chrono::microseconds{0});
+      CHECK(peer.lastSeen <= now);
+      CHECK(now - peer.lastSeen <= std::chrono::seconds{2});
+    }
+
+    // A published list stays as it is
+    simulation.controller(1).suspend();
+    simulation.run(std::chrono::milliseconds{500});
+    CHECK(config.numPeers - 1 == pPeers->size());
+    CHECK(config.numPeers - 2 == simulation.controller(0).peerList()->size());
+  }
+
+  SECTION("PeersListTheirSession")
+  {
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{2});
+    REQUIRE(simulation.isInSync());
+
+    const auto pSessions = simulation.controller(0).sessionList();
+    REQUIRE(!pSessions->empty());
+    CHECK(pSessions->front().isCurrent);
+    CHECK(config.numPeers - 1 == pSessions->front().numPeers);
+    CHECK(simulation.controller(0).ghostXForm() == pSessions->front().measurement.xform);
+    for (auto it = pSessions->begin() + 1; it != pSessions->end(); ++it)
+    {
+      CHECK(!it->isCurrent);
+      CHECK(0 == it->numPeers);
+    }
+  }
+
+  SECTION("SessionsPastTheLimitArentMeasured")
+  {
+    Simulation simulation{config};
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      simulation.controller(i).setMaxMeasuredOtherSessions(0);
+    }
+    simulation.run(std::chrono::seconds{2});
+
+    // Nobody measures the others, so every peer stays in the session it founded
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(0 == simulation.controller(i).numPeers());
+      CHECK(0 == simulation.controller(i).stats().measurementsStarted);
+      const auto pSessions = simulation.controller(i).sessionList();
+      REQUIRE(config.numPeers == pSessions->size());
+      for (auto it = pSessions->begin() + 1; it != pSessions->end(); ++it)
+      {
+        CHECK(1 == it->numPeers);
+        CHECK(std::chrono::microseconds{0} == it->measurement.timestamp);
+      }
+    }
+  }
+
+  SECTION("ConvergesWithUnicastPeersIfMulticastIsDropped")
+  {
+    config.network.dropsMulticast = true;
+    Simulation simulation{config};
+    auto peers = std::vector<asio::ip::udp::endpoint>{};
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      peers.emplace_back(
+        asio::ip::address_v4{
+          static_cast<asio::ip::address_v4::uint_type>((10u << 24) + 1u + i)},
+        discovery::multicastEndpointV4().port());
+    }
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      simulation.controller(i).setUnicastPeers(peers);
+    }
+    const auto report = simulation.run(std::chrono::seconds{2});
+
+    REQUIRE(report.convergenceTime);
+    CHECK(*report.convergenceTime < std::chrono::seconds{1});
+    CHECK(report.traffic.packetsLost > 0);
+  }
+
+  SECTION("PeersOnASharedClockDomainDontMeasureEachOther")
+  {
+    const auto measured = Simulation{config}.run(std::chrono::seconds{2});
+    config.sharedClockDomain = true;
+    Simulation simulation{config};
+    const auto report = simulation.run(std::chrono::seconds{2});
+
+    REQUIRE(report.convergenceTime);
+    CHECK(*report.convergenceTime < std::chrono::seconds{1});
+    CHECK(report.phaseError <= config.network.resolution);
+    CHECK(report.traffic.packetsSent * 2 < measured.traffic.packetsSent);
+  }
+
+  SECTION("JoiningPeersAreOnlyMeasuredOnceTheyAnnounceTheirPingResponder")
+  {
+    config.joinInterval = std::chrono::milliseconds{100};
+    Simulation simulation{config};
+    const auto report = simulation.run(std::chrono::seconds{2});
+
+    REQUIRE(report.convergenceTime);
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(0 == simulation.controller(i).stats().measurementsFailed);
+    }
+  }
+
+  SECTION("ScheduledTempoChangeIsAppliedByAllPeersAtOnce")
+  {
+    config.network.jitter = std::chrono::microseconds{500};
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{1});
+    REQUIRE(simulation.isInSync());
+
+    const auto oldTempo = simulation.controller(0).clientState().timeline.tempo;
+    const auto time = simulation.clock(0).micros() + std::chrono::milliseconds{500};
+    const auto timeline = simulation.controller(0).clientState().timeline;
+    const auto newTempo = link::Tempo{oldTempo.bpm() + 10.};
+    const auto atTime = link::Timeline{newTempo, timeline.toBeats(time), time};
+    simulation.controller(0).scheduleClientTimeline(
+      {newTempo, timeline.beatOrigin, atTime.fromBeats(timeline.beatOrigin)}, time);
+
+    // The change is known to all peers before it takes effect
+    simulation.run(std::chrono::milliseconds{490});
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(oldTempo.bpm()
+            == Approx(simulation.controller(i).clientState().timeline.tempo.bpm()));
+    }
+    CHECK(simulation.isInSync());
+
+    const auto report = simulation.run(std::chrono::milliseconds{20});
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(newTempo.bpm()
+            == Approx(simulation.controller(i).clientState().timeline.tempo.bpm()));
+    }
+    CHECK(report.phaseError <= config.phaseTolerance);
+  }
+
+  SECTION("TempoRampIsFollowedByAllPeers")
+  {
+    config.network.jitter = std::chrono::microseconds{500};
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{1});
+    REQUIRE(simulation.isInSync());
+
+    const auto time = simulation.clock(0).micros();
+    const auto timeline = simulation.controller(0).clientState().timeline;
+    const auto ramp = link::TempoRamp{
+      link::Timeline{timeline.tempo, timeline.toBeats(time), time},
+      link::Tempo{timeline.tempo.bpm() + 30.}, link::Beats{8.}, link::TempoCurve::Linear};
+    const auto endTl = ramp.endTimeline();
+    simulation.controller(0).setClientState({link::OptionalTimeline{{endTl.tempo,
+                                               timeline.beatOrigin,
+                                               endTl.fromBeats(timeline.beatOrigin)}},
+      {}, time, ramp});
+
+    simulation.run(std::chrono::seconds{1});
+    const auto quantum = link::Beats{config.quantum};
+    const auto stateAt = [&](const std::size_t i) {
+      const auto clientState = simulation.controller(i).clientState();
+      const auto micros = simulation.clock(i).micros();
+      const auto phase = link::phase(
+        link::toPhaseEncodedBeats(
+          link::rampedTimeline(clientState.timeline, clientState.tempoRamp), micros,
+          quantum),
+        quantum);
+      return std::make_pair(clientState.tempoRamp.tempoAtTime(micros).bpm(), phase);
+    };
+    const auto reference = stateAt(0);
+    CHECK(reference.first > timeline.tempo.bpm());
+    CHECK(reference.first < timeline.tempo.bpm() + 30.);
+    for (std::size_t i = 1; i < config.numPeers; ++i)
+    {
+      const auto state = stateAt(i);
+      CHECK(reference.first == Approx(state.first).epsilon(1e-4));
+      const auto diff = std::fabs((state.second - reference.second).floating());
+      CHECK((std::min)(diff, config.quantum - diff) < 0.01);
+    }
+  }
+
+  SECTION("TempoRampIsTakenOverByLateJoiners")
+  {
+    config.network.jitter = std::chrono::microseconds{500};
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{1});
+    REQUIRE(simulation.isInSync());
+
+    const auto late = config.numPeers - 1;
+    simulation.controller(late).enable(false);
+    simulation.run(std::chrono::milliseconds{100});
+
+    const auto time = simulation.clock(0).micros();
+    const auto timeline = simulation.controller(0).clientState().timeline;
+    const auto ramp = link::TempoRamp{
+      link::Timeline{timeline.tempo, timeline.toBeats(time), time},
+      link::Tempo{timeline.tempo.bpm() + 30.}, link::Beats{16.},
+      link::TempoCurve::Linear};
+    const auto endTl = ramp.endTimeline();
+    simulation.controller(0).setClientState({link::OptionalTimeline{{endTl.tempo,
+                                               timeline.beatOrigin,
+                                               endTl.fromBeats(timeline.beatOrigin)}},
+      {}, time, ramp});
+    simulation.run(std::chrono::milliseconds{500});
+
+    simulation.controller(late).enable(true);
+    simulation.run(std::chrono::seconds{1});
+    REQUIRE(config.numPeers - 1 == simulation.controller(late).numPeers());
+
+    const auto quantum = link::Beats{config.quantum};
+    const auto stateAt = [&](const std::size_t i) {
+      const auto clientState = simulation.controller(i).clientState();
+      const auto micros = simulation.clock(i).micros();
+      const auto phase = link::phase(
+        link::toPhaseEncodedBeats(
+          link::rampedTimeline(clientState.timeline, clientState.tempoRamp), micros,
+          quantum),
+        quantum);
+      return std::make_pair(clientState.tempoRamp.tempoAtTime(micros).bpm(), phase);
+    };
+    const auto reference = stateAt(0);
+    const auto state = stateAt(late);
+    REQUIRE(reference.first < timeline.tempo.bpm() + 30.);
+    CHECK(reference.first == Approx(state.first).epsilon(1e-4));
+    const auto diff = std::fabs((state.second - reference.second).floating());
+    CHECK((std::min)(diff, config.quantum - diff) < 0.01);
+  }
+
+  SECTION("TempoRampIsFollowedByLegacyPeers")
+  {
+    config.network.jitter = std::chrono::microseconds{500};
+    config.numLegacyPeers = 1;
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{1});
+    REQUIRE(simulation.isInSync());
+
+    const auto time = simulation.clock(0).micros();
+    const auto timeline = simulation.controller(0).clientState().timeline;
+    const auto ramp = link::TempoRamp{
+      link::Timeline{timeline.tempo, timeline.toBeats(time), time},
+      link::Tempo{timeline.tempo.bpm() + 30.}, link::Beats{8.}, link::TempoCurve::Linear};
+    const auto endTl = ramp.endTimeline();
+    simulation.controller(0).setClientState({link::OptionalTimeline{{endTl.tempo,
+                                               timeline.beatOrigin,
+                                               endTl.fromBeats(timeline.beatOrigin)}},
+      {}, time, ramp});
+
+    // Legacy peers follow the timelines along the ramp, which leave the ramp of the
+    // others in place
+    simulation.run(std::chrono::seconds{1});
+    const auto legacy = config.numPeers - 1;
+    const auto quantum = link::Beats{config.quantum};
+    const auto stateAt = [&](const std::size_t i) {
+      const auto clientState = simulation.controller(i).clientState();
+      const auto micros = simulation.clock(i).micros();
+      const auto phase = link::phase(
+        link::toPhaseEncodedBeats(
+          link::rampedTimeline(clientState.timeline, clientState.tempoRamp), micros,
+          quantum),
+        quantum);
+      const auto tempo = clientState.tempoRamp.isRamping()
+                           ? clientState.tempoRamp.tempoAtTime(micros)
+                           : clientState.timeline.tempo;
+      return std::make_pair(tempo.bpm(), phase);
+    };
+    const auto reference = stateAt(0);
+    REQUIRE(reference.first < timeline.tempo.bpm() + 30.);
+    for (std::size_t i = 1; i < config.numPeers; ++i)
+    {
+      const auto isRamping = simulation.controller(i).clientState().tempoRamp.isRamping();
+      CHECK(isRamping == (i != legacy));
+      const auto state = stateAt(i);
+      CHECK(reference.first == Approx(state.first).epsilon(1e-2));
+      const auto diff = std::fabs((state.second - reference.second).floating());
+      CHECK((std::min)(diff, config.quantum - diff) < 0.01);
+    }
+
+    // The ramps of 8 beats are over within 7 seconds from 60 bpm on
+    simulation.run(std::chrono::seconds{7});
+    CHECK(simulation.isInSync());
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(endTl.tempo.bpm()
+            == Approx(simulation.controller(i).clientState().timeline.tempo.bpm()));
+    }
+  }
+
+  SECTION("StartStopStateIsRelayedByFewPeers")
+  {
+    config.numPeers = 24;
+    config.maxClockDrift = 0.;
+    Simulation simulation{config};
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      simulation.controller(i).enableStartStopSync(true);
+    }
+    simulation.run(std::chrono::seconds{2});
+    REQUIRE(simulation.isInSync());
+    const auto before = simulation.run(std::chrono::milliseconds{100});
+
+    const auto now = simulation.clock(0).micros();
+    simulation.controller(0).setClientState(
+      {{}, link::OptionalClientStartStopState{link::ClientStartStopState{true, now, now}},
+        {}, {}});
+    const auto after = simulation.run(std::chrono::milliseconds{100});
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(simulation.controller(i).clientState().startStopState.isPlaying);
+    }
+    // Rather than all peers, only the first relays rebroadcast the state
+    CHECK(after.traffic.multicastPacketsSent
+          < before.traffic.multicastPacketsSent + config.numPeers / 2);
+  }
+
+  SECTION("PeersReportTheQualityOfTheirSync")
+  {
+    config.network.jitter = std::chrono::microseconds{500};
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{2});
+    REQUIRE(simulation.isInSync());
+
+    // All peers but the founder of the session measure it
+    std::size_t numMeasured = 0;
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      const auto quality = simulation.controller(i).syncQuality();
+      if (quality.isMeasured())
+      {
+        ++numMeasured;
+        CHECK(quality.roundTripTime >= 2 * config.network.latency);
+        CHECK(quality.roundTripTime
+              <= 2 * (config.network.latency + config.network.jitter
+                       + config.network.resolution));
+        CHECK(quality.jitter > std::chrono::microseconds{0});
+        CHECK(quality.offsetVariance > 0.);
+        CHECK(quality.measurementTime <= simulation.clock(i).micros());
+      }
+    }
+    CHECK(config.numPeers - 1 == numMeasured);
+  }
+
+  SECTION("IsDeterministic")
+  {
+    config.network.jitter = std::chrono::microseconds{500};
+    config.network.lossRate = 0.05;
+    config.network.seed = 42;
+    Simulation simulation1{config};
+    Simulation simulation2{config};
+    const auto report1 = simulation1.run(std::chrono::seconds{2});
+    const auto report2 = simulation2.run(std::chrono::seconds{2});
+
+    REQUIRE(report1.convergenceTime);
+    REQUIRE(report2.convergenceTime);
+    CHECK(*report1.convergenceTime == *report2.convergenceTime);
+    CHECK(report1.traffic.packetsSent == report2.traffic.packetsSent);
+    CHECK(report1.traffic.bytesSent == report2.traffic.bytesSent);
+    CHECK(report1.traffic.packetsLost == report2.traffic.packetsLost);
+    CHECK(report1.phaseError == report2.phaseError);
+  }
+}
+
+} // namespace serial_io
+} // namespace test
+} // namespace ableton
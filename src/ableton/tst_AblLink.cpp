@@ -0,0 +1,212 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/test/CatchWrapper.hpp>
+#include <abl_link.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ableton
+{
+namespace
+{
+
+// The events that the registered callbacks saw, in the order of the invocations
+struct CallbackEvents
+{
+  void add(const abl_link_event &event)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(event);
+  }
+
+  std::size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return events.size();
+  }
+
+  std::vector<abl_link_event> get() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return events;
+  }
+
+  mutable std::mutex mutex;
+  std::vector<abl_link_event> events;
+};
+
+void onNumPeers(const uint64_t numPeers, void *context)
+{
+  static_cast<CallbackEvents *>(context)->add(
+    {abl_link_event_num_peers, 0, numPeers, 0., false});
+}
+
+void onTempo(const double tempo, void *context)
+{
+  static_cast<CallbackEvents *>(context)->add(
+    {abl_link_event_tempo, 0, 0, tempo, false});
+}
+
+void onStartStop(const bool isPlaying, void *context)
+{
+  static_cast<CallbackEvents *>(context)->add(
+    {abl_link_event_start_stop, 0, 0, 0., isPlaying});
+}
+
+// An enabled instance with all callbacks registered, whose callbacks are invoked on
+// the io thread. The session group keeps the instance apart from other Link peers
+// on the network of the host.
+abl_link createLink(const std::size_t eventQueueSize, CallbackEvents &callbackEvents)
+{
+  const auto link = abl_link_create_with_event_queue(120., eventQueueSize);
+  abl_link_set_session_group(link, 0x7ab1);
+  abl_link_enable_start_stop_sync(link, true);
+  abl_link_set_num_peers_callback(link, &onNumPeers, &callbackEvents);
+  abl_link_set_tempo_callback(link, &onTempo, &callbackEvents);
+  abl_link_set_start_stop_callback(link, &onStartStop, &callbackEvents);
+  abl_link_enable(link, true);
+  return link;
+}
+
+template <typename Condition>
+bool eventually(Condition condition)
+{
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!condition())
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+    {
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+// Commits numChanges tempos from the application thread and toggles the transport
+// with every change. Link merges the commits that it hasn't handled yet, so each
+// change is committed once the callbacks have seen the previous one. Returns false
+// if a change doesn't reach the callbacks.
+bool commitChanges(
+  abl_link link, const CallbackEvents &callbackEvents, const std::size_t numChanges)
+{
+  const auto sessionState = abl_link_create_session_state();
+  auto isSeen = true;
+  for (std::size_t i = 0; isSeen && i < numChanges; ++i)
+  {
+    abl_link_capture_app_session_state(link, sessionState);
+    const auto now = abl_link_clock_micros(link);
+    abl_link_set_tempo(sessionState, 60. + static_cast<double>(i) * 0.1, now);
+    abl_link_set_is_playing(sessionState, i % 2 == 0, static_cast<uint64_t>(now));
+    abl_link_commit_app_session_state(link, sessionState);
+    // A tempo and a start/stop event per change
+    isSeen = eventually([&] { return callbackEvents.size() >= 2 * (i + 1); });
+  }
+  abl_link_destroy_session_state(sessionState);
+  return isSeen;
+}
+
+void requireSameEvents(
+  const std::vector<abl_link_event> &polled, const std::vector<abl_link_event> &seen)
+{
+  REQUIRE(polled.size() == seen.size());
+  for (std::size_t i = 0; i < polled.size(); ++i)
+  {
+    CHECK(polled[i].type == seen[i].type);
+    CHECK(polled[i].num_peers == seen[i].num_peers);
+    CHECK(polled[i].tempo == seen[i].tempo);
+    CHECK(polled[i].is_playing == seen[i].is_playing);
+    if (i > 0)
+    {
+      CHECK(polled[i - 1].time <= polled[i].time);
+    }
+  }
+}
+
+} // namespace
+
+TEST_CASE("abl_link_poll_events")
+{
+  SECTION("Returns nothing without an event queue")
+  {
+    const auto link = abl_link_create(120.);
+    abl_link_set_tempo_callback(link, &onTempo, nullptr);
+    abl_link_event event;
+    CHECK(abl_link_poll_events(link, &event, 1) == 0);
+    abl_link_destroy(link);
+  }
+
+  SECTION("Delivers the events of the callbacks in order while committing")
+  {
+    const std::size_t numChanges = 1000;
+    // The events of all changes fit without polling
+    CallbackEvents callbackEvents;
+    const auto link = createLink(2 * numChanges, callbackEvents);
+
+    std::atomic<bool> polling{true};
+    std::vector<abl_link_event> polled;
+    std::thread poller([&] {
+      abl_link_event events[16];
+      while (polling)
+      {
+        const auto numEvents = abl_link_poll_events(link, events, 16);
+        polled.insert(polled.end(), events, events + numEvents);
+      }
+    });
+
+    const auto isSeen = commitChanges(link, callbackEvents, numChanges);
+    polling = false;
+    poller.join();
+    REQUIRE(isSeen);
+    abl_link_event event;
+    while (abl_link_poll_events(link, &event, 1) == 1)
+    {
+      polled.push_back(event);
+    }
+
+    const auto seen = callbackEvents.get();
+    CHECK(seen.size() >= 2 * numChanges);
+    requireSameEvents(polled, seen);
+    abl_link_destroy(link);
+  }
+
+  SECTION("Keeps the oldest events while the queue is full")
+  {
+    const std::size_t queueSize = 8;
+    CallbackEvents callbackEvents;
+    const auto link = createLink(queueSize, callbackEvents);
+
+    REQUIRE(commitChanges(link, callbackEvents, 100));
+
+    std::vector<abl_link_event> polled(2 * queueSize);
+    polled.resize(abl_link_poll_events(link, polled.data(), polled.size()));
+    auto seen = callbackEvents.get();
+    REQUIRE(seen.size() > queueSize);
+    seen.resize(queueSize);
+    requireSameEvents(polled, seen);
+    abl_link_destroy(link);
+  }
+}
+
+} // namespace ableton
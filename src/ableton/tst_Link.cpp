@@ -0,0 +1,582 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+#include <ableton/Link.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/util/BeatGrid.hpp>
+#include <ableton/util/ClockPulses.hpp>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace ableton
+{
+
+TEST_CASE("Link::SessionState")
+{
+  using namespace std::chrono;
+  using SessionState = Link::SessionState;
+
+  const auto tl0 = link::Timeline{link::Tempo{120.}, link::Beats{1.}, microseconds{0}};
+  const auto tl1 =
+    link::Timeline{link::Tempo{97.3}, link::Beats{-9.5}, microseconds{2000000}};
+
+  SECTION("beatsAndPhasesAtTimes matches beatAtTime and phaseAtTime")
+  {
+    const std::size_t numSamples = 4096;
+    // Coarse sample spacing so that the buffer spans several bars
+    const auto microsPerSample = 1e6 / 441.;
+    const auto beginTime = microseconds{-1234567};
+
+    for (const auto& tl : {tl0, tl1})
+    {
+      const auto sessionState = SessionState{{tl, {}, {}}, false};
+      for (const auto quantum : {0., 1., 2.4, 4.})
+      {
+        std::vector<double> beats(numSamples);
+        std::vector<double> phases(numSamples);
+        std::vector<std::size_t> wraps(numSamples);
+        const auto numWraps = sessionState.beatsAndPhasesAtTimes(beginTime,
+          microsPerSample, numSamples, quantum, beats.data(), phases.data(), wraps.data());
+
+        std::vector<std::size_t> expectedWraps;
+        auto lastPhase = sessionState.phaseAtTime(
+          beginTime - microseconds{llround(microsPerSample)}, quantum);
+        for (std::size_t i = 0; i < numSamples; ++i)
+        {
+          const auto time =
+            beginTime + microseconds{llround(static_cast<double>(i) * microsPerSample)};
+          CHECK(sessionState.beatAtTime(time, quantum) == beats[i]);
+          CHECK(sessionState.phaseAtTime(time, quantum) == phases[i]);
+          if (phases[i] < lastPhase)
+          {
+            expectedWraps.push_back(i);
+          }
+          lastPhase = phases[i];
+        }
+
+        wraps.resize(numWraps);
+        CHECK(expectedWraps == wraps);
+        CHECK((quantum == 0. || !wraps.empty()));
+      }
+    }
+  }
+
+  SECTION("beatsAndPhasesAtTimes accepts null outputs")
+  {
+    const auto sessionState = SessionState{{tl0, {}, {}}, false};
+    // Beat 1 falls just before the first sample and beat 2 at 500ms
+    const auto numWraps = sessionState.beatsAndPhasesAtTimes(
+      microseconds{100}, 1000., 1000, 1., nullptr, nullptr, nullptr);
+    CHECK(2 == numWraps);
+  }
+
+  SECTION("beatCursorAtTime follows beatAtTime and resyncs on changes")
+  {
+    auto sessionState = SessionState{{tl0, {}, {}}, false};
+    auto cursor = sessionState.beatCursorAtTime(microseconds{0}, 48000., 4.);
+    CHECK(sessionState.beatAtTime(microseconds{0}, 4.) == Approx(cursor.beats()));
+
+    cursor.advance(48000);
+    CHECK(sessionState.beatAtTime(microseconds{1000000}, 4.) == Approx(cursor.beats()));
+    CHECK_FALSE(sessionState.syncBeatCursor(cursor));
+
+    sessionState.setTempo(60., microseconds{1000000});
+    CHECK(sessionState.syncBeatCursor(cursor));
+    cursor.advance(48000);
+    CHECK(sessionState.beatAtTime(microseconds{2000000}, 4.) == Approx(cursor.beats()));
+    CHECK(sessionState.phaseAtTime(microseconds{2000000}, 4.) == Approx(cursor.phase()));
+
+    // The cursor follows a ramp and the tempo after it
+    sessionState.setTempoRamp(
+      60., 120., microseconds{2000000}, 4., Link::TempoCurve::Linear);
+    CHECK(sessionState.syncBeatCursor(cursor));
+    for (auto block = 0; block < 400; ++block)
+    {
+      cursor.advance(480);
+      CHECK(sessionState.beatAtTime(cursor.time(), 4.) == Approx(cursor.beats()));
+    }
+  }
+}
+
+TEST_CASE("util::beatGridEvents")
+{
+  using namespace std::chrono;
+  using SessionState = Link::SessionState;
+
+  const auto tl =
+    link::Timeline{link::Tempo{97.3}, link::Beats{-9.5}, microseconds{20000}};
+  const auto sessionState = SessionState{{tl, {}, {}}, false};
+  const auto grids = std::vector<util::BeatGrid>{{1., 1.}, {0.25, 4.}, {1. / 3., 4.},
+    {0.5, 4., 0.125}, {1.5, 2.4}, {0., 4.}};
+
+  SECTION("Events match a scan of every sample")
+  {
+    const auto sampleRate = 44100.;
+    const auto microsPerSample = 1e6 / sampleRate;
+    const std::size_t numSamples = 512;
+    for (auto begin = microseconds{-1000000}; begin < microseconds{3000000};
+         begin += microseconds{11610})
+    {
+      std::vector<util::BeatGridEvent> events;
+      util::beatGridEvents(sessionState, util::SampleTiming{begin, sampleRate},
+        numSamples, grids.begin(), grids.end(), std::back_inserter(events));
+
+      std::vector<util::BeatGridEvent> expected;
+      for (std::size_t g = 0; g < grids.size(); ++g)
+      {
+        const auto& grid = grids[g];
+        if (grid.interval <= 0.)
+        {
+          continue;
+        }
+        const auto beatAt = [&](const double sample) {
+          return sessionState.beatAtTime(
+            begin + microseconds{llround(sample * microsPerSample)}, grid.quantum);
+        };
+        for (std::size_t i = 0; i < numSamples; ++i)
+        {
+          const auto previous = beatAt(static_cast<double>(i) - 1.);
+          const auto current = beatAt(static_cast<double>(i));
+          auto k = std::floor((previous - grid.offset) / grid.interval) - 1.;
+          for (auto beat = grid.offset + k * grid.interval; beat <= current;
+               ++k, beat = grid.offset + k * grid.interval)
+          {
+            if (beat > previous)
+            {
+              expected.push_back({g, i, beat});
+            }
+          }
+        }
+      }
+
+      REQUIRE(expected.size() == events.size());
+      for (std::size_t i = 0; i < events.size(); ++i)
+      {
+        CHECK(expected[i].grid == events[i].grid);
+        CHECK(expected[i].sample == events[i].sample);
+        CHECK(expected[i].beat == events[i].beat);
+      }
+    }
+  }
+
+  SECTION("Beat wraps match beatsAndPhasesAtTimes")
+  {
+    const auto begin = microseconds{-123456};
+    const std::size_t numSamples = 4096;
+    const auto microsPerSample = 1e6 / 441.;
+    std::vector<std::size_t> wraps(numSamples);
+    const auto numWraps = sessionState.beatsAndPhasesAtTimes(
+      begin, microsPerSample, numSamples, 1., nullptr, nullptr, wraps.data());
+
+    std::vector<util::BeatGridEvent> events;
+    util::beatGridEvents(sessionState, util::SampleTiming{begin, 441.}, numSamples,
+      grids.begin(), grids.begin() + 1, std::back_inserter(events));
+    REQUIRE(numWraps == events.size());
+    for (std::size_t i = 0; i < numWraps; ++i)
+    {
+      CHECK(wraps[i] == events[i].sample);
+    }
+  }
+}
+
+TEST_CASE("util::ClockPulseGenerator")
+{
+  using namespace std::chrono;
+  using SessionState = Link::SessionState;
+  using Type = util::ClockEvent::Type;
+
+  const auto tl =
+    link::Timeline{link::Tempo{97.3}, link::Beats{-9.5}, microseconds{20000}};
+  const auto sampleRate = 44100.;
+  const std::size_t numSamples = 512;
+  const auto bufferDuration = microseconds{llround(512. * 1e6 / sampleRate)};
+  const auto timingAt = [&](const std::size_t buffer) {
+    return util::SampleTiming{
+      microseconds{llround(static_cast<double>(buffer * numSamples) * 1e6 / sampleRate)},
+      sampleRate};
+  };
+
+  SECTION("Pulses match the grid of the PPQN while playing")
+  {
+    auto sessionState = SessionState{{tl, {true, microseconds{-1}}, {}}, false};
+    util::ClockPulseGenerator generator;
+    auto isStartPending = true;
+    for (std::size_t buffer = 0; buffer < 100; ++buffer)
+    {
+      std::vector<util::ClockEvent> events;
+      generator(sessionState, timingAt(buffer), numSamples, std::back_inserter(events));
+
+      const auto grid = util::BeatGrid{1. / 24., 4.};
+      std::vector<util::BeatGridEvent> expected;
+      util::beatGridEvents(sessionState, timingAt(buffer), numSamples, &grid,
+        &grid + 1, std::back_inserter(expected));
+
+      const auto hasStart = isStartPending && !expected.empty();
+      isStartPending = isStartPending && !hasStart;
+      REQUIRE(expected.size() + (hasStart ? 1 : 0) == events.size());
+      if (hasStart)
+      {
+        CHECK(Type::Start == events.front().type);
+        CHECK(expected.front().sample == events.front().sample);
+        events.erase(events.begin());
+      }
+      for (std::size_t i = 0; i < events.size(); ++i)
+      {
+        CHECK(Type::Pulse == events[i].type);
+        CHECK(expected[i].sample == events[i].sample);
+        CHECK(expected[i].beat == events[i].beat);
+      }
+    }
+  }
+
+  SECTION("Pulses are continuous across buffers")
+  {
+    auto sessionState = SessionState{{tl, {true, microseconds{-1}}, {}}, false};
+    util::ClockPulseGenerator generator{96.};
+    std::vector<util::ClockEvent> events;
+    for (std::size_t buffer = 0; buffer < 200; ++buffer)
+    {
+      generator(sessionState, timingAt(buffer), numSamples, std::back_inserter(events));
+    }
+    REQUIRE(events.size() > 2);
+    CHECK(Type::Start == events[0].type);
+    for (std::size_t i = 2; i < events.size(); ++i)
+    {
+      CHECK(Type::Pulse == events[i].type);
+      CHECK(std::abs(events[i].beat - events[i - 1].beat - 1. / 96.) < 1e-9);
+    }
+  }
+
+  SECTION("Nothing is reported while stopped")
+  {
+    auto sessionState = SessionState{{tl, {}, {}}, false};
+    util::ClockPulseGenerator generator;
+    std::vector<util::ClockEvent> events;
+    for (std::size_t buffer = 0; buffer < 10; ++buffer)
+    {
+      generator(sessionState, timingAt(buffer), numSamples, std::back_inserter(events));
+    }
+    CHECK(events.empty());
+  }
+
+  SECTION("Start precedes the first pulse after it and stop is sample accurate")
+  {
+    auto sessionState = SessionState{{tl, {}, {}}, false};
+    util::ClockPulseGenerator generator;
+    const auto startTime = timingAt(3).mBufferBegin + microseconds{5000};
+    const auto stopTime = timingAt(8).mBufferBegin + microseconds{1234};
+    std::vector<util::ClockEvent> events;
+    for (std::size_t buffer = 0; buffer < 12; ++buffer)
+    {
+      if (buffer == 2)
+      {
+        sessionState.setIsPlaying(true, startTime);
+      }
+      if (buffer == 7)
+      {
+        sessionState.setIsPlaying(false, stopTime);
+      }
+      const auto begin = events.size();
+      generator(sessionState, timingAt(buffer), numSamples, std::back_inserter(events));
+      for (auto i = begin; i < events.size(); ++i)
+      {
+        const auto time = timingAt(buffer).mBufferBegin
+                          + microseconds{llround(static_cast<double>(events[i].sample)
+                                                 * 1e6 / sampleRate)};
+        const auto previous = time - microseconds{llround(1e6 / sampleRate)};
+        if (events[i].type == Type::Stop)
+        {
+          CHECK(time >= stopTime);
+          CHECK(previous < stopTime);
+        }
+        else
+        {
+          CHECK(time >= startTime);
+          CHECK(time <= stopTime);
+        }
+      }
+    }
+
+    REQUIRE(events.size() > 3);
+    CHECK(Type::Start == events.front().type);
+    CHECK(Type::Pulse == events[1].type);
+    CHECK(events[0].sample == events[1].sample);
+    CHECK(events[1].beat >= sessionState.beatAtTime(startTime, 4.));
+    CHECK(Type::Stop == events.back().type);
+    for (std::size_t i = 1; i + 1 < events.size(); ++i)
+    {
+      CHECK(Type::Pulse == events[i].type);
+    }
+  }
+
+  SECTION("A start that is stopped before its first pulse isn't reported")
+  {
+    auto sessionState = SessionState{{tl, {}, {}}, false};
+    util::ClockPulseGenerator generator{1.};
+    const auto begin = timingAt(0).mBufferBegin;
+    sessionState.setIsPlaying(true, begin + microseconds{1000});
+    std::vector<util::ClockEvent> events;
+    generator(sessionState, timingAt(0), numSamples, std::back_inserter(events));
+    sessionState.setIsPlaying(false, begin + bufferDuration + microseconds{1000});
+    generator(sessionState, timingAt(1), numSamples, std::back_inserter(events));
+    CHECK(events.empty());
+  }
+
+  SECTION("Pulses run while stopped if requested")
+  {
+    auto sessionState = SessionState{{tl, {}, {}}, false};
+    util::ClockPulseGenerator generator{24., 4., true};
+    const auto timing = util::SampleTiming{microseconds{0}, sampleRate};
+    std::vector<util::ClockEvent> events;
+    generator(sessionState, timing, 44100, std::back_inserter(events));
+    const auto grid = util::BeatGrid{1. / 24., 4.};
+    std::vector<util::BeatGridEvent> expected;
+    util::beatGridEvents(
+      sessionState, timing, 44100, &grid, &grid + 1, std::back_inserter(expected));
+    REQUIRE(!expected.empty());
+    CHECK(expected.size() == events.size());
+  }
+}
+
+TEST_CASE("Link commits")
+{
+  Link link(120.);
+  const auto time = link.clock().micros();
+  const auto unmodified = link.captureAppSessionState();
+
+  auto state = link.captureAppSessionState();
+  state.setIsPlaying(true, time);
+  link.commitAppSessionState(state);
+  REQUIRE(link.captureAppSessionState().isPlaying());
+  const auto version = link.appSessionStateVersion();
+
+  SECTION("Unmodified session states change nothing")
+  {
+    link.commitAppSessionState(unmodified);
+    link.commitAudioSessionState(unmodified);
+    CHECK(version == link.appSessionStateVersion());
+    CHECK(link.captureAppSessionState().isPlaying());
+  }
+
+  SECTION("Only the modified parts are passed on")
+  {
+    auto tempoState = unmodified;
+    tempoState.setTempo(90., time);
+    link.commitAppSessionState(tempoState);
+
+    const auto committed = link.captureAppSessionState();
+    CHECK(90. == committed.tempo());
+    CHECK(committed.isPlaying());
+  }
+}
+
+TEST_CASE("Link that is never enabled")
+{
+  // Its threads are never started, the app thread handles the commits instead
+  Link link(120.);
+  auto tempos = std::vector<double>{};
+  link.setTempoCallback([&tempos](const double bpm) { tempos.push_back(bpm); });
+  const auto time = link.clock().micros();
+
+  SECTION("Audio thread commits reach the app session state")
+  {
+    const auto version = link.appSessionStateVersion();
+    auto state = link.captureAudioSessionState();
+    state.setTempo(90., time);
+    state.setIsPlaying(true, time);
+    link.commitAudioSessionState(state);
+    CHECK(version < link.appSessionStateVersion());
+
+    const auto captured = link.captureAppSessionState();
+    CHECK(90. == captured.tempo());
+    CHECK(captured.isPlaying());
+    CHECK(std::vector<double>{90.} == tempos);
+  }
+
+  SECTION("App thread commits reach the audio session state")
+  {
+    auto state = link.captureAppSessionState();
+    state.setTempo(150., time);
+    link.commitAppSessionState(state);
+
+    CHECK(150. == link.captureAudioSessionState().tempo());
+    CHECK(std::vector<double>{150.} == tempos);
+  }
+}
+
+TEST_CASE("Link freewheel")
+{
+  using namespace std::chrono;
+
+  Link link(120.);
+  const auto time = link.clock().micros();
+
+  link.enableFreewheel(true);
+  CHECK(link.isFreewheelEnabled());
+
+  SECTION("The session doesn't affect the frozen state")
+  {
+    auto appState = link.captureAppSessionState();
+    appState.setTempo(90., time);
+    link.commitAppSessionState(appState);
+
+    CHECK(120. == link.captureAudioSessionState().tempo());
+    CHECK(90. == link.captureAppSessionState().tempo());
+  }
+
+  SECTION("Commits only replace the frozen state")
+  {
+    auto state = link.captureAudioSessionState();
+    // A render at ten times real time
+    const auto beat = state.beatAtTime(time + seconds{10}, 4.);
+    state.setTempo(140., time + seconds{10});
+    link.commitAudioSessionState(state);
+
+    const auto frozen = link.captureAudioSessionState();
+    CHECK(140. == frozen.tempo());
+    // The tempo changes without a jump, up to the rounding of the timeline to
+    // microseconds
+    CHECK(std::abs(beat - frozen.beatAtTime(time + seconds{10}, 4.)) < 1e-5);
+    CHECK(120. == link.captureAppSessionState().tempo());
+  }
+
+  SECTION("Disabling follows the session again")
+  {
+    auto state = link.captureAudioSessionState();
+    state.setTempo(140., time);
+    link.commitAudioSessionState(state);
+
+    link.enableFreewheel(false);
+    CHECK(!link.isFreewheelEnabled());
+    CHECK(120. == link.captureAudioSessionState().tempo());
+  }
+}
+
+namespace
+{
+
+template <typename Condition>
+bool eventually(Condition condition)
+{
+  using namespace std::chrono;
+
+  const auto deadline = steady_clock::now() + seconds{10};
+  while (!condition())
+  {
+    if (steady_clock::now() > deadline)
+    {
+      return false;
+    }
+    std::this_thread::sleep_for(milliseconds{10});
+  }
+  return true;
+}
+
+template <typename Links>
+bool allHaveTempo(const Links& links, const double tempo)
+{
+  // The tempo is sent as microseconds per beat, so peers only agree up to rounding
+  for (const auto& pLink : links)
+  {
+    if (pLink && std::abs(pLink->captureAppSessionState().tempo() - tempo) > 1e-3)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+TEST_CASE("SharedLink")
+{
+  // All instances in this process run on the same io thread
+  std::vector<std::unique_ptr<SharedLink>> links;
+  for (auto i = 0; i < 3; ++i)
+  {
+    links.emplace_back(new SharedLink(120.));
+    links.back()->enable(true);
+  }
+
+  const auto allHavePeers = [&links](const std::size_t numPeers) {
+    for (const auto& pLink : links)
+    {
+      if (pLink && pLink->numPeers() != numPeers)
+      {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  REQUIRE(eventually([&] { return allHavePeers(2); }));
+
+  SECTION("Tempo changes reach the other instances")
+  {
+    auto state = links[0]->captureAppSessionState();
+    state.setTempo(133., links[0]->clock().micros());
+    links[0]->commitAppSessionState(state);
+
+    CHECK(eventually([&] { return allHaveTempo(links, 133.); }));
+  }
+
+  SECTION("The other instances keep running when one is destroyed")
+  {
+    links[1].reset();
+    REQUIRE(eventually([&] { return allHavePeers(1); }));
+
+    auto state = links[2]->captureAppSessionState();
+    state.setTempo(87., links[2]->clock().micros());
+    links[2]->commitAppSessionState(state);
+
+    CHECK(eventually([&] { return allHaveTempo(links, 87.); }));
+  }
+}
+
+TEST_CASE("Link on an io_service of the application")
+{
+  ::asio::io_service service;
+  std::unique_ptr<Link> pLink(new Link(120., service));
+
+  SECTION("Can be destroyed from a handler of the io_service")
+  {
+    pLink->enable(true);
+    service.post([&] {
+      pLink.reset();
+      service.stop();
+    });
+    service.run();
+    CHECK(!pLink);
+  }
+
+  SECTION("Can be destroyed from a handler before it's enabled")
+  {
+    service.post([&] {
+      pLink.reset();
+      service.stop();
+    });
+    service.run();
+    CHECK(!pLink);
+  }
+}
+
+} // namespace ableton
@@ -0,0 +1,212 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+// Built with LINK_NO_EXCEPTIONS and -fno-exceptions, see util/Exceptions.hpp
+#include <ableton/Link.hpp>
+#include <ableton/discovery/UdpMessenger.hpp>
+#include <ableton/discovery/test/Interface.hpp>
+#include <ableton/link/Timeline.hpp>
+#include <ableton/platforms/stl/Random.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/test/serial_io/Fixture.hpp>
+#include <ableton/test/serial_io/Simulation.hpp>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#if defined(ASIO_NO_EXCEPTIONS)
+// Standalone asio leaves its errors to the application
+namespace asio
+{
+namespace detail
+{
+
+template <typename Exception>
+void throw_exception(const Exception& e)
+{
+  ableton::util::fatalError(e.what());
+}
+
+} // namespace detail
+} // namespace asio
+#endif
+
+namespace ableton
+{
+namespace
+{
+
+using Random = platforms::stl::Random;
+using Simulation = test::serial_io::Simulation;
+
+struct SendFailureHandler
+{
+  using Exception = discovery::UdpSendException;
+
+  void operator()(const Exception& exception)
+  {
+    pAddrs->push_back(exception.interfaceAddr);
+  }
+
+  std::shared_ptr<std::vector<asio::ip::address>> pAddrs;
+};
+
+// Parsed with the try functions only, like the states of Link
+struct TestNodeState
+{
+  using IdType = uint8_t;
+
+  IdType ident() const
+  {
+    return nodeId;
+  }
+
+  friend auto toPayload(const TestNodeState& state)
+    -> decltype(discovery::makePayload(link::Timeline{}))
+  {
+    return discovery::makePayload(state.timeline);
+  }
+
+  template <typename It>
+  static bool tryFromPayload(const uint8_t id, It begin, It end, TestNodeState& state)
+  {
+    state = {id, {}};
+    return discovery::tryParsePayload<link::Timeline>(begin, end,
+      [&state](const link::Timeline& timeline) { state.timeline = timeline; });
+  }
+
+  IdType nodeId;
+  link::Timeline timeline;
+};
+
+struct TestHandler
+{
+  void operator()(discovery::PeerState<TestNodeState> state)
+  {
+    peerStates.push_back(std::move(state));
+  }
+
+  void operator()(discovery::ByeBye<TestNodeState::IdType>)
+  {
+  }
+
+  std::vector<discovery::PeerState<TestNodeState>> peerStates;
+};
+
+TestNodeState makeNodeState(const uint8_t nodeId)
+{
+  return {nodeId,
+    link::Timeline{link::Tempo{120.}, link::Beats{0.}, std::chrono::microseconds{0}}};
+}
+
+} // namespace
+
+TEST_CASE("NoExceptions")
+{
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+  static_assert(false, "Built with exceptions");
+#endif
+
+  const auto interfaceAddr = asio::ip::address::from_string("10.0.0.1");
+  const auto peerEndpoint =
+    asio::ip::udp::endpoint{asio::ip::address::from_string("10.0.0.2"), 20808};
+
+  SECTION("ErrorsArePassedToAHandlerOfTheirType")
+  {
+    const auto pAddrs = std::make_shared<std::vector<asio::ip::address>>();
+    auto handler = util::ErrorHandler{SendFailureHandler{pAddrs}};
+    handler(std::runtime_error{"unrelated"});
+    CHECK(pAddrs->empty());
+    handler(discovery::UdpSendException{
+      asio::system_error{asio::error::network_unreachable}, interfaceAddr});
+    REQUIRE(1 == pAddrs->size());
+    CHECK(interfaceAddr == pAddrs->front());
+  }
+
+  SECTION("MalformedMessagesAreDropped")
+  {
+    test::serial_io::Fixture io;
+    auto iface = discovery::test::Interface{};
+    auto pStats = std::make_shared<discovery::GatewayStats>();
+    auto messenger = discovery::makeUdpMessenger(util::injectRef(iface),
+      makeNodeState(1), util::injectVal(io.makeIoContext()), 5, 2,
+      discovery::defaultBroadcastPolicy(), pStats);
+    auto handler = TestHandler{};
+    messenger.listen(std::ref(handler));
+
+    const auto peerState = makeNodeState(2);
+    discovery::v1::MessageBuffer buffer;
+    const auto messageEnd = discovery::v1::aliveMessage(
+      peerState.ident(), 5, toPayload(peerState), begin(buffer));
+    const auto garbage = std::array<uint8_t, 4>{{1, 2, 3, 4}};
+    iface.incomingMessage(peerEndpoint, begin(garbage), end(garbage));
+    iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd - 1);
+    CHECK(handler.peerStates.empty());
+    CHECK(2 == pStats->parseFailures);
+
+    iface.incomingMessage(peerEndpoint, begin(buffer), messageEnd);
+    REQUIRE(1 == handler.peerStates.size());
+    CHECK(peerState.timeline == handler.peerStates.front().peerState.timeline);
+  }
+
+  SECTION("RepeatedSendFailuresArePassedToTheContext")
+  {
+    test::serial_io::Fixture io;
+    auto iface = discovery::test::Interface{};
+    iface.sendError = asio::error::network_unreachable;
+    auto messenger = discovery::makeUdpMessenger(util::injectRef(iface),
+      makeNodeState(1), util::injectVal(io.makeIoContext()), 5, 2);
+
+    // Retries back off up to the nominal broadcast period of two seconds
+    io.advanceTime(std::chrono::seconds(3));
+    CHECK(io.errors().empty());
+    io.advanceTime(std::chrono::seconds(3));
+    CHECK(1 == io.errors().size());
+  }
+
+  SECTION("SocketsThatCantBeBoundAreClosed")
+  {
+    auto io = link::platform::IoContext{};
+    // An address of the documentation range that no interface has
+    auto socket = io.openUnicastSocket<discovery::v1::kMaxMessageSize>(
+      asio::ip::address::from_string("192.0.2.1"));
+    CHECK(!socket.mpImpl->mSocket.is_open());
+  }
+
+  SECTION("PeersJoinTheSession")
+  {
+    auto config = Simulation::Config{};
+    config.numPeers = 3;
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{5});
+    CHECK(simulation.isInSync());
+    CHECK(2 == simulation.controller(0).numPeers());
+  }
+
+  SECTION("LinkIsConstructedDisabled")
+  {
+    Link link{120.};
+    CHECK(!link.isEnabled());
+    CHECK(0 == link.numPeers());
+  }
+}
+
+} // namespace ableton
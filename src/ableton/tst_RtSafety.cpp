@@ -0,0 +1,169 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+// Built with LINK_RT_SAFETY_CHECKS, see util/RtSafety.hpp. The interposed functions
+// may only be defined in a single translation unit of the executable.
+#include <ableton/Link.hpp>
+#include <ableton/platforms/linux/RtSafetyChecks.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace ableton
+{
+namespace
+{
+
+std::atomic<std::size_t> gNumViolations{0};
+std::atomic<const char*> gFirstViolation{nullptr};
+
+void recordViolation(const char* function)
+{
+  const char* expected = nullptr;
+  gFirstViolation.compare_exchange_strong(expected, function);
+  ++gNumViolations;
+}
+
+void resetViolations()
+{
+  gNumViolations = 0;
+  gFirstViolation = nullptr;
+}
+
+// Calls the realtime-safe functions of the link instance like an audio callback
+void renderAudioBlock(Link& link, const std::size_t block)
+{
+  using namespace std::chrono;
+
+  link.beginAudioBlock();
+  const auto now = link.clock().micros();
+  auto state = link.captureAudioSessionState();
+  state.beatAtTime(now, 4.);
+  state.phaseAtTime(now, 4.);
+  state.timeAtBeat(16., 4.);
+  state.isPlaying();
+  if (block % 16 == 0)
+  {
+    state.setTempo(block % 32 == 0 ? 121. : 119., now);
+  }
+  if (block % 64 == 0)
+  {
+    state.setIsPlaying(block % 128 == 0, now);
+  }
+  link.commitAudioSessionState(state);
+  link.captureAudioSessionStateAt(now - milliseconds{5}).beatAtTime(now, 4.);
+  auto sharedState = link.captureSharedAudioSessionState();
+  if (block % 16 == 8)
+  {
+    sharedState.setTempo(block % 32 == 8 ? 122. : 118., now);
+    link.commitSharedAudioSessionState(sharedState);
+  }
+  Link::SessionEvent event;
+  while (link.readSessionEvent(event))
+  {
+  }
+  link.endAudioBlock();
+}
+
+} // namespace
+
+TEST_CASE("Link | RtSafety")
+{
+  using namespace std::chrono;
+
+  util::rt::setViolationHandler(recordViolation);
+  resetViolations();
+
+  SECTION("AllocationsInARealtimeScopeAreReported")
+  {
+    {
+      const util::rt::Scope scope;
+      std::unique_ptr<int> pInt(new int(0));
+    }
+    CHECK(gNumViolations > 0);
+    CHECK(std::string{gFirstViolation.load()} == "malloc");
+  }
+
+  SECTION("LocksInARealtimeScopeAreReported")
+  {
+    std::mutex mutex;
+    {
+      const util::rt::Scope scope;
+      std::lock_guard<std::mutex> lock(mutex);
+    }
+    CHECK(gNumViolations == 1);
+    CHECK(std::string{gFirstViolation.load()} == "pthread_mutex_lock");
+  }
+
+  SECTION("AllocationsOutsideOfRealtimeScopesAreNotReported")
+  {
+    std::unique_ptr<int> pInt(new int(0));
+    CHECK(gNumViolations == 0);
+  }
+
+  SECTION("TheAudioThreadFunctionsDontAllocateOrLockWhileTheSessionChanges")
+  {
+    Link link(120.);
+    Link peer(90.);
+    link.enableSessionEventQueue(true);
+    link.enable(true);
+
+    std::atomic<bool> isRunning{true};
+    std::thread audioThread([&] {
+      std::size_t block = 0;
+      while (isRunning)
+      {
+        {
+          const util::rt::Scope scope;
+          renderAudioBlock(link, block++);
+        }
+        std::this_thread::sleep_for(milliseconds{1});
+      }
+    });
+
+    for (auto i = 0; i < 50; ++i)
+    {
+      peer.enable(i % 4 != 3);
+      link.enableStartStopSync(i % 2 == 0);
+      link.enableAudioTimelineCommitQueue(i % 3 == 0);
+      auto state = link.captureAppSessionState();
+      state.setTempo(100. + i, link.clock().micros());
+      link.commitAppSessionState(state);
+      if (i == 25)
+      {
+        link.enable(false);
+        link.enable(true);
+      }
+      std::this_thread::sleep_for(milliseconds{20});
+    }
+
+    isRunning = false;
+    audioThread.join();
+    INFO((gFirstViolation.load() ? gFirstViolation.load() : ""));
+    CHECK(gNumViolations == 0);
+  }
+
+  util::rt::setViolationHandler(nullptr);
+}
+
+} // namespace ableton
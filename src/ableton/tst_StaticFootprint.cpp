@@ -0,0 +1,140 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+// Built with LINK_STATIC_FOOTPRINT, see util/Footprint.hpp
+#include <ableton/link/Peers.hpp>
+#include <ableton/platforms/stl/Random.hpp>
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/test/serial_io/Fixture.hpp>
+#include <ableton/test/serial_io/Simulation.hpp>
+#include <chrono>
+#include <vector>
+
+namespace ableton
+{
+namespace
+{
+
+using Random = platforms::stl::Random;
+using Simulation = test::serial_io::Simulation;
+
+struct NullCallback
+{
+  template <typename... Args>
+  void operator()(Args&&...)
+  {
+  }
+};
+
+link::PeerState makePeerState(const link::SessionId& sessionId)
+{
+  return {{link::NodeId::random<Random>(), sessionId,
+            link::Timeline{link::Tempo{120.}, link::Beats{0.},
+              std::chrono::microseconds{0}},
+            {}},
+    {}};
+}
+
+} // namespace
+
+TEST_CASE("StaticFootprint")
+{
+  static_assert(util::kStaticFootprint, "Built without LINK_STATIC_FOOTPRINT");
+
+  SECTION("PeersDropTheEntriesThatDontFit")
+  {
+    using Peers = link::Peers<test::serial_io::Context, NullCallback, NullCallback,
+      NullCallback>;
+    test::serial_io::Fixture io;
+    auto peers = link::makePeers(util::injectVal(io.makeIoContext()), NullCallback{},
+      NullCallback{}, NullCallback{});
+    auto observer =
+      makeGatewayObserver(peers, asio::ip::address::from_string("10.0.0.1"));
+
+    const auto sessionId = link::NodeId::random<Random>();
+    auto states = std::vector<link::PeerState>{};
+    for (std::size_t i = 0; i < Peers::kMaxPeerEntries + 1; ++i)
+    {
+      states.push_back(makePeerState(sessionId));
+      sawPeer(observer, states.back());
+    }
+    io.flush();
+    CHECK(std::size_t{Peers::kMaxPeerEntries} == peers.uniqueSessionPeerCount(sessionId));
+
+    // A peer that leaves makes room for the next one
+    peerLeft(observer, states.front().ident());
+    sawPeer(observer, states.back());
+    io.flush();
+    CHECK(std::size_t{Peers::kMaxPeerEntries} == peers.uniqueSessionPeerCount(sessionId));
+    const auto sessionPeers = peers.sessionPeers(sessionId);
+    CHECK(sessionPeers.end()
+          != std::find_if(sessionPeers.begin(), sessionPeers.end(),
+            [&states](const Peers::Peer& peer) {
+              return peer.first.ident() == states.back().ident();
+            }));
+  }
+
+  SECTION("PeersDropTheSessionsThatDontFit")
+  {
+    using Peers = link::Peers<test::serial_io::Context, NullCallback, NullCallback,
+      NullCallback>;
+    test::serial_io::Fixture io;
+    auto peers = link::makePeers(util::injectVal(io.makeIoContext()), NullCallback{},
+      NullCallback{}, NullCallback{});
+    auto observer =
+      makeGatewayObserver(peers, asio::ip::address::from_string("10.0.0.1"));
+
+    auto sessionIds = std::vector<link::SessionId>{};
+    for (std::size_t i = 0; i < Peers::kMaxIndexedSessions + 1; ++i)
+    {
+      sessionIds.push_back(link::NodeId::random<Random>());
+      sawPeer(observer, makePeerState(sessionIds.back()));
+    }
+    io.flush();
+    CHECK(1u == peers.uniqueSessionPeerCount(sessionIds.front()));
+    CHECK(0u == peers.uniqueSessionPeerCount(sessionIds.back()));
+  }
+
+  SECTION("ConvergesWithinTheCapacity")
+  {
+    auto config = Simulation::Config{};
+    config.numPeers = util::kMaxPeers + 1;
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{5});
+    CHECK(simulation.isInSync());
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(util::kMaxPeers == simulation.controller(i).numPeers());
+    }
+  }
+
+  SECTION("KeepsRunningBeyondTheCapacity")
+  {
+    auto config = Simulation::Config{};
+    config.numPeers = 2 * util::kMaxPeers;
+    Simulation simulation{config};
+    simulation.run(std::chrono::seconds{10});
+    for (std::size_t i = 0; i < config.numPeers; ++i)
+    {
+      CHECK(simulation.controller(i).numPeers() <= util::kMaxPeers);
+    }
+  }
+}
+
+} // namespace ableton
@@ -0,0 +1,109 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/util/FlatMap.hpp>
+#include <ableton/util/StaticVector.hpp>
+#include <memory>
+#include <string>
+
+namespace ableton
+{
+namespace util
+{
+
+TEST_CASE("FlatMap")
+{
+  FlatMap<int, std::string> map;
+  map.emplace(3, "c");
+  map.emplace(1, "a");
+  map.emplace(2, "b");
+
+  SECTION("EntriesAreSortedByKey")
+  {
+    REQUIRE(3u == map.size());
+    auto key = 1;
+    for (const auto& entry : map)
+    {
+      CHECK(key == entry.first);
+      ++key;
+    }
+  }
+
+  SECTION("Find")
+  {
+    CHECK("b" == map.find(2)->second);
+    CHECK(map.end() == map.find(0));
+    CHECK(map.end() == map.find(4));
+  }
+
+  SECTION("EmplaceKeepsExistingValue")
+  {
+    const auto result = map.emplace(2, "x");
+    CHECK(!result.second);
+    CHECK("b" == result.first->second);
+    CHECK(3u == map.size());
+  }
+
+  SECTION("Subscript")
+  {
+    map[4] = "d";
+    map[1] = "x";
+    CHECK("d" == map.find(4)->second);
+    CHECK("x" == map.find(1)->second);
+    CHECK(4u == map.size());
+  }
+
+  SECTION("Erase")
+  {
+    CHECK(1u == map.erase(2));
+    CHECK(0u == map.erase(2));
+    CHECK(map.end() == map.find(2));
+    const auto it = map.erase(map.find(1));
+    CHECK(3 == it->first);
+    CHECK(1u == map.size());
+  }
+
+  SECTION("MoveOnlyValues")
+  {
+    FlatMap<int, std::unique_ptr<int>> pointers;
+    pointers.emplace(2, std::unique_ptr<int>(new int{2}));
+    pointers.emplace(1, std::unique_ptr<int>(new int{1}));
+    CHECK(1 == *pointers.begin()->second);
+    CHECK(2 == *pointers.find(2)->second);
+  }
+
+  SECTION("EntriesInAStaticVector")
+  {
+    using Entries = StaticVector<std::pair<int, std::string>, 3>;
+    FlatMap<int, std::string, std::less<int>, Entries> staticMap;
+    staticMap[2] = "b";
+    staticMap.emplace(1, "a");
+    staticMap[3] = "c";
+    CHECK(staticMap.size() == staticMap.max_size());
+    CHECK(1 == staticMap.begin()->first);
+    CHECK(1u == staticMap.count(3));
+    CHECK(1u == staticMap.erase(2));
+    CHECK(0u == staticMap.count(2));
+    CHECK("c" == staticMap.find(3)->second);
+  }
+}
+
+} // namespace util
+} // namespace ableton
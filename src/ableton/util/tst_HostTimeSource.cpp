@@ -0,0 +1,107 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/util/HostTimeSource.hpp>
+
+namespace ableton
+{
+namespace util
+{
+
+namespace
+{
+
+struct MockClock
+{
+  std::chrono::microseconds micros() const
+  {
+    return std::chrono::microseconds{*pNow};
+  }
+
+  std::chrono::microseconds ticksToMicros(const std::int64_t ticks) const
+  {
+    return std::chrono::microseconds{ticks / 10};
+  }
+
+  const std::int64_t* pNow;
+};
+
+// Maps sample times to host times one to one and counts its resets
+struct MockFilter
+{
+  static int& numResets()
+  {
+    static int count = 0;
+    return count;
+  }
+
+  void reset()
+  {
+    ++numResets();
+  }
+
+  std::chrono::microseconds sampleTimeToHostTime(const double sampleTime)
+  {
+    return std::chrono::microseconds{static_cast<std::int64_t>(sampleTime)};
+  }
+};
+
+} // namespace
+
+TEST_CASE("HostTimeSource")
+{
+  using std::chrono::microseconds;
+
+  std::int64_t now = 1000000;
+  auto source = HostTimeSource<MockClock, MockFilter>{MockClock{&now}};
+  MockFilter::numResets() = 0;
+
+  SECTION("DriverTimeIsRelativeToTheDriverClock")
+  {
+    CHECK(microseconds{999000} == source.fromDriverTime(microseconds{4000},
+                                    microseconds{5000}));
+    now += 500;
+    CHECK(microseconds{1000500} == source.fromDriverTime(microseconds{7000},
+                                     microseconds{7000}));
+  }
+
+  SECTION("TicksAreConvertedByTheClock")
+  {
+    CHECK(microseconds{1234} == source.fromTicks(std::int64_t{12345}));
+  }
+
+  SECTION("HostTimeIsUsedAsIs")
+  {
+    CHECK(microseconds{42} == source.fromHostTime(microseconds{42}));
+  }
+
+  SECTION("FilterRestartsWhenTakingOverFromTheDriver")
+  {
+    CHECK(microseconds{10} == source.fromSampleTime(10.));
+    CHECK(microseconds{20} == source.fromSampleTime(20.));
+    CHECK(1 == MockFilter::numResets());
+    source.fromHostTime(microseconds{42});
+    CHECK(microseconds{30} == source.fromSampleTime(30.));
+    CHECK(2 == MockFilter::numResets());
+  }
+}
+
+} // namespace util
+} // namespace ableton
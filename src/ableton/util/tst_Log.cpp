@@ -0,0 +1,155 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/util/Log.hpp>
+#include <memory>
+#include <sstream>
+
+namespace ableton
+{
+namespace util
+{
+namespace
+{
+
+struct StreamLog
+{
+  StreamLog()
+    : mpStream(std::make_shared<std::ostringstream>())
+  {
+  }
+
+  friend std::ostream& debug(const StreamLog& log)
+  {
+    return *log.mpStream << "D:" << log.mName;
+  }
+
+  friend std::ostream& info(const StreamLog& log)
+  {
+    return *log.mpStream << "I:" << log.mName;
+  }
+
+  friend std::ostream& warning(const StreamLog& log)
+  {
+    return *log.mpStream << "W:" << log.mName;
+  }
+
+  friend std::ostream& error(const StreamLog& log)
+  {
+    return *log.mpStream << "E:" << log.mName;
+  }
+
+  friend StreamLog channel(const StreamLog& log, const std::string& name)
+  {
+    auto result = log;
+    result.mName = name;
+    return result;
+  }
+
+  std::string str() const
+  {
+    return mpStream->str();
+  }
+
+  std::shared_ptr<std::ostringstream> mpStream;
+  std::string mName;
+};
+
+struct Counter
+{
+  int operator()()
+  {
+    return ++count;
+  }
+
+  int count = 0;
+};
+
+} // namespace
+
+TEST_CASE("Log")
+{
+  Counter counter;
+
+  SECTION("NullLogDoesNotEvaluateArguments")
+  {
+    const auto log = NullLog{};
+    CHECK_FALSE(isLogLevelEnabled(log, LogLevel::Error));
+    LINK_DEBUG(log) << counter();
+    LINK_ERROR(log) << counter();
+    CHECK(0 == counter.count);
+  }
+
+  SECTION("LogsWithoutLevelsWriteAllLevels")
+  {
+    const auto log = StreamLog{};
+    CHECK(isLogLevelEnabled(log, LogLevel::Debug));
+    LINK_DEBUG(log) << counter();
+    LINK_INFO(log) << counter();
+    LINK_WARNING(log) << counter();
+    LINK_ERROR(log) << counter();
+    CHECK(4 == counter.count);
+    CHECK("D:1I:2W:3E:4" == log.str());
+  }
+
+  SECTION("LevelFilterSelectsLevelAtRuntime")
+  {
+    using Log = LevelFilter<StreamLog>;
+    const auto log = Log{};
+    CHECK(LogLevel::Info == Log::level());
+
+    LINK_DEBUG(log) << counter();
+    LINK_INFO(log) << counter();
+    CHECK(1 == counter.count);
+
+    Log::setLevel(LogLevel::Error);
+    LINK_WARNING(log) << counter();
+    LINK_ERROR(log) << counter();
+    CHECK(2 == counter.count);
+
+    Log::setLevel(LogLevel::Debug);
+    LINK_DEBUG(channel(log, "ch")) << counter();
+    CHECK(3 == counter.count);
+    CHECK("I:1E:2D:ch3" == log.mLog->str());
+
+    Log::setLevel(LogLevel::Info);
+  }
+
+  SECTION("TimestampedForwardsLevels")
+  {
+    CHECK_FALSE(isLogLevelEnabled(Timestamped<NullLog>{}, LogLevel::Error));
+    CHECK(isLogLevelEnabled(Timestamped<StreamLog>{}, LogLevel::Debug));
+  }
+
+  SECTION("LazyChannelOnlyBuildsNameForEnabledLogs")
+  {
+    lazyChannel(NullLog{}, [&counter] { return std::to_string(counter()); });
+    CHECK(0 == counter.count);
+
+    const auto log = StreamLog{};
+    const auto ch = lazyChannel(log, [&counter] { return std::to_string(counter()); });
+    CHECK(1 == counter.count);
+    CHECK("1" == ch.mName);
+  }
+}
+
+} // namespace util
+} // namespace ableton
@@ -0,0 +1,68 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/util/SafeAsyncHandler.hpp>
+#include <memory>
+
+namespace ableton
+{
+namespace util
+{
+
+namespace
+{
+
+struct Counter : EnableAsyncSafe<Counter>
+{
+  void operator()(const int n)
+  {
+    count += n;
+  }
+
+  int count = 0;
+};
+
+} // namespace
+
+TEST_CASE("SafeAsyncHandler")
+{
+  auto pCounter = std::make_shared<Counter>();
+
+  SECTION("AsyncSafeHandlersInvokeTheObject")
+  {
+    const auto handler1 = pCounter->asyncSafe();
+    const auto handler2 = pCounter->asyncSafe();
+    handler1(1);
+    handler2(2);
+    CHECK(3 == pCounter->count);
+  }
+
+  SECTION("HandlersOfDestroyedObjectsDoNothing")
+  {
+    const auto handler = pCounter->asyncSafe();
+    const std::weak_ptr<Counter> pWeak = pCounter;
+    pCounter.reset();
+    handler(1);
+    CHECK(pWeak.expired());
+  }
+}
+
+} // namespace util
+} // namespace ableton
@@ -0,0 +1,116 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/util/SampleClock.hpp>
+
+namespace ableton
+{
+namespace util
+{
+
+namespace
+{
+
+// origin + round(sample * 1e6 * denominator / numerator)
+std::chrono::microseconds expectedTime(const std::chrono::microseconds origin,
+  const std::int64_t sample,
+  const std::int64_t numerator,
+  const std::int64_t denominator)
+{
+  return origin
+         + std::chrono::microseconds{
+           (2 * sample * 1000000 * denominator + numerator) / (2 * numerator)};
+}
+
+} // namespace
+
+TEST_CASE("SampleClock")
+{
+  using std::chrono::microseconds;
+
+  const auto origin = microseconds{-1234567};
+
+  SECTION("AdvanceBySingleSamples")
+  {
+    for (const auto sampleRate : {44100u, 48000u, 96000u, 22050u})
+    {
+      auto clock = SampleClock{origin, sampleRate};
+      // Ten minutes of audio
+      for (std::int64_t sample = 0; sample < 600 * sampleRate; ++sample)
+      {
+        if (clock.time() != expectedTime(origin, sample, sampleRate, 1))
+        {
+          FAIL("Unexpected time at sample " << sample << " with rate " << sampleRate);
+        }
+        clock.advance();
+      }
+      CHECK(600 * sampleRate == clock.sample());
+      CHECK(origin + microseconds{600000000} == clock.time());
+    }
+  }
+
+  SECTION("AdvanceByBlocks")
+  {
+    // 48000 / 1.001 samples per second, as used for pulled down video
+    auto clock = SampleClock{origin, 48000000u, 1001u};
+    std::int64_t sample = 0;
+    for (auto block = 0; block < 100000; ++block)
+    {
+      const auto numSamples = static_cast<std::uint64_t>(block % 7 == 0 ? 1 : 441);
+      CHECK(expectedTime(origin, sample + 17, 48000000, 1001) == clock.timeAtSample(17));
+      clock.advance(numSamples);
+      sample += static_cast<std::int64_t>(numSamples);
+      CHECK(expectedTime(origin, sample, 48000000, 1001) == clock.time());
+    }
+    CHECK(sample == clock.sample());
+  }
+
+  SECTION("SingleSamplesAndBlocksAgree")
+  {
+    auto bySample = SampleClock{origin, 44100u};
+    auto byBlock = SampleClock{origin, 44100u};
+    for (auto block = 0; block < 1000; ++block)
+    {
+      for (auto i = 0; i < 512; ++i)
+      {
+        bySample.advance();
+      }
+      byBlock.advance(512u);
+      CHECK(byBlock.time() == bySample.time());
+    }
+  }
+
+  SECTION("SyncToHostTime")
+  {
+    auto clock = SampleClock{origin, 44100u};
+    clock.advance(44100u * 3);
+    const auto hostTime = microseconds{5000000};
+    clock.sync(hostTime);
+    CHECK(44100 * 3 == clock.sample());
+    CHECK(hostTime == clock.time());
+    clock.advance(441u);
+    CHECK(hostTime + microseconds{10000} == clock.time());
+    CHECK(expectedTime(hostTime, 441 + 3, 44100, 1) == clock.timeAtSample(3));
+  }
+}
+
+} // namespace util
+} // namespace ableton
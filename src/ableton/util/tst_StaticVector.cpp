@@ -0,0 +1,114 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/util/StaticVector.hpp>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace ableton
+{
+namespace util
+{
+
+TEST_CASE("StaticVector")
+{
+  StaticVector<std::string, 4> vector;
+  vector.push_back("a");
+  vector.push_back("c");
+
+  SECTION("EmplaceInTheMiddle")
+  {
+    const auto it = vector.emplace(vector.begin() + 1, 1, 'b');
+    CHECK("b" == *it);
+    REQUIRE(3u == vector.size());
+    CHECK("a" == vector[0]);
+    CHECK("b" == vector[1]);
+    CHECK("c" == vector[2]);
+  }
+
+  SECTION("InsertAtTheEnds")
+  {
+    vector.insert(vector.begin(), "0");
+    vector.insert(vector.end(), "d");
+    REQUIRE(4u == vector.size());
+    CHECK("0" == vector.front());
+    CHECK("d" == vector.back());
+  }
+
+  SECTION("Erase")
+  {
+    vector.push_back("d");
+    const auto it = vector.erase(vector.begin());
+    CHECK("c" == *it);
+    vector.erase(vector.begin() + 1, vector.end());
+    REQUIRE(1u == vector.size());
+    CHECK("c" == vector.front());
+  }
+
+  SECTION("ThrowsIfFull")
+  {
+    vector.push_back("d");
+    vector.push_back("e");
+    CHECK(vector.size() == vector.max_size());
+    CHECK_THROWS_AS(vector.push_back("f"), std::length_error);
+    CHECK_THROWS_AS(vector.insert(vector.begin(), "f"), std::length_error);
+    CHECK_THROWS_AS(vector.reserve(5), std::length_error);
+    CHECK(4u == vector.size());
+    CHECK("a" == vector.front());
+  }
+
+  SECTION("CopyAndMove")
+  {
+    auto copy = vector;
+    CHECK(2u == copy.size());
+    CHECK("c" == copy.back());
+    auto moved = std::move(copy);
+    CHECK(copy.empty());
+    CHECK(2u == moved.size());
+    vector.clear();
+    vector = moved;
+    CHECK(2u == vector.size());
+    CHECK("a" == vector.front());
+  }
+
+  SECTION("Assign")
+  {
+    vector.assign(3, "x");
+    REQUIRE(3u == vector.size());
+    CHECK("x" == vector[2]);
+  }
+
+  SECTION("DestroysItsElements")
+  {
+    const auto pValue = std::make_shared<int>(1);
+    {
+      StaticVector<std::shared_ptr<int>, 2> pointers;
+      pointers.push_back(pValue);
+      pointers.push_back(pValue);
+      pointers.erase(pointers.begin());
+      CHECK(2 == pValue.use_count());
+    }
+    CHECK(1 == pValue.use_count());
+  }
+}
+
+} // namespace util
+} // namespace ableton
@@ -0,0 +1,144 @@
+/* Copyright 2016, Ableton AG, Berlin. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  If you would like to incorporate Link into a proprietary software application,
+ *  please contact <link-devs@ableton.com>.
+ */
+
+
+#include <ableton/test/CatchWrapper.hpp>
+#include <ableton/util/Trace.hpp>
+#include <array>
+#include <sstream>
+#include <thread>
+
+namespace ableton
+{
+namespace util
+{
+
+TEST_CASE("Trace")
+{
+  const auto endpoint =
+    asio::ip::udp::endpoint{asio::ip::address::from_string("10.0.0.2"), 20808};
+
+  SECTION("EncodesEndpoints")
+  {
+    CHECK(0x0a000002u == traceAddress(endpoint.address()));
+    CHECK((0x0a000002ull << 16 | 20808) == traceEndpoint(endpoint));
+    CHECK(0 == traceAddress(asio::ip::address::from_string("::1")));
+  }
+
+  SECTION("EncodesIds")
+  {
+    const auto id = std::array<std::uint8_t, 8>{{1, 2, 3, 4, 5, 6, 7, 8}};
+    CHECK(0x0102030405060708ull == traceId(id));
+  }
+
+  SECTION("RecordsEventsInOrder")
+  {
+    TraceRing<8> ring;
+    CHECK(ring.records().empty());
+
+    ring.write(TraceEvent::PacketReceived, 1, 10);
+    ring.write(TraceEvent::PacketSent, 2, 20);
+
+    const auto records = ring.records();
+    REQUIRE(2 == records.size());
+    CHECK(TraceEvent::PacketReceived == records[0].event);
+    CHECK(1 == records[0].arg0);
+    CHECK(10 == records[0].arg1);
+    CHECK(TraceEvent::PacketSent == records[1].event);
+    CHECK(records[0].time <= records[1].time);
+  }
+
+  SECTION("KeepsTheMostRecentEvents")
+  {
+    TraceRing<4> ring;
+    for (std::uint64_t i = 0; i < 10; ++i)
+    {
+      ring.write(TraceEvent::PacketSent, i, 0);
+    }
+
+    const auto records = ring.records();
+    REQUIRE(4 == records.size());
+    for (std::size_t i = 0; i < records.size(); ++i)
+    {
+      CHECK(6 + i == records[i].arg0);
+    }
+  }
+
+  SECTION("RecordsFromSeveralThreads")
+  {
+    TraceRing<1024> ring;
+    auto writeEvents = [&ring] {
+      for (std::uint64_t i = 0; i < 100; ++i)
+      {
+        ring.write(TraceEvent::PacketReceived, i, 0);
+      }
+    };
+    std::thread thread(writeEvents);
+    writeEvents();
+    thread.join();
+
+    const auto records = ring.records();
+    CHECK(200 == records.size());
+    CHECK(records.front().thread != records.back().thread);
+  }
+
+  SECTION("WritesChromeTrace")
+  {
+    TraceRing<8> ring;
+    ring.write(TraceEvent::MeasurementStarted, traceEndpoint(endpoint), 0);
+    ring.write(TraceEvent::PacketSent, traceEndpoint(endpoint), 42);
+    ring.write(TraceEvent::MeasurementFinished, traceEndpoint(endpoint), 1);
+    ring.write(TraceEvent::GatewayAdded, traceAddress(endpoint.address()), 0);
+
+    std::ostringstream stream;
+    ring.writeChromeTrace(stream);
+    const auto json = stream.str();
+
+    CHECK(0 == json.find("{\"traceEvents\":[{\"name\":\"MeasurementStarted\""));
+    CHECK(std::string::npos != json.find("\"ph\":\"b\",\"id\":"));
+    CHECK(std::string::npos != json.find("\"ph\":\"e\",\"id\":"));
+    CHECK(std::string::npos != json.find("\"ts\":0.000,"));
+    CHECK(std::string::npos
+          != json.find("\"args\":{\"endpoint\":\"10.0.0.2:20808\",\"bytes\":42}"));
+    CHECK(std::string::npos != json.find("\"success\":true"));
+    CHECK(std::string::npos != json.find("\"args\":{\"address\":\"10.0.0.2\"}"));
+    CHECK("]}\n" == json.substr(json.size() - 3));
+  }
+
+  SECTION("RingTraceSharesOneRing")
+  {
+    const auto before = RingTrace<16>::ring().records().size();
+    trace(RingTrace<16>{}, TraceEvent::SessionJoined, 7);
+    trace(RingTrace<16>{}, TraceEvent::SessionJoined);
+    const auto records = RingTrace<16>::ring().records();
+    REQUIRE(before + 2 == records.size());
+    CHECK(7 == records[records.size() - 2].arg0);
+    CHECK(0 == records.back().arg1);
+  }
+
+  SECTION("NullTraceIsEmpty")
+  {
+    trace(NullTrace{}, TraceEvent::PacketReceived, 1, 2);
+    CHECK(std::is_empty<NullTrace>::value);
+    CHECK(std::is_empty<RingTrace<>>::value);
+  }
+}
+
+} // namespace util
+} // namespace ableton